@@ -8,6 +8,9 @@ glslc.exe src/prefilterspecularcube.comp -o bin/prefilterspecularcube.comp.spv
 glslc.exe src/taa.comp -o bin/taa.comp.spv
 glslc.exe src/taa_sharpen.comp -o bin/taa_sharpen.comp.spv
 glslc.exe src/downsample.comp -o bin/downsample.comp.spv
+glslc.exe src/hzb.comp -o bin/hzb.comp.spv
+glslc.exe src/vsm_mark.comp -o bin/vsm_mark.comp.spv
+glslc.exe src/pmx_skinning.comp -o bin/pmx_skinning.comp.spv
 glslc.exe src/blur.frag -o bin/blur.frag.spv
 glslc.exe src/blend.frag -o bin/blend.frag.spv
 ::glslc.exe src/fxaa.comp -o bin/fxaa.comp.spv
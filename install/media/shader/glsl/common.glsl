@@ -3,6 +3,7 @@
 
 const float g_pi = 3.14159265f;
 const float g_max_mipmap = 12.0f;
+const uint g_meshMaxLodCount = 5; // MESH_MAX_LOD_COUNT in mesh_lod.h
 
 struct PerObjectData   // SSBO upload each draw call mesh data
 {
@@ -19,7 +20,32 @@ struct PerObjectData   // SSBO upload each draw call mesh data
     uint indexCount;    
 	uint firstIndex;    
 	uint vertexOffset;  
-	uint firstInstance; 
+	uint batchId;       // index into the draw batch buffer
+
+    // cluster culling, zero meshletCount culls the whole object
+    uint meshletStart;  // absolute in the meshlet heap
+    uint meshletCount;
+    uint bIndex16;
+    uint clusterVisibilityStart; // first occlusion visibility bit of the meshlets
+
+    uint bShadowDynamic; // drawn over the cached static cascade depth every frame
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+struct Meshlet // Cluster of a submesh, see meshlet.h
+{
+    vec4 sphere;        // .xyz object space center
+                        // .w   radius
+
+    vec4 cone;          // .xyz axis
+                        // .w   cutoff, 1 never culls
+
+    uint firstIndex;    // relative to the first index of the submesh
+    uint indexCount;
+    uint vertexCount;
+    uint pad;
 };
 
 struct PerObjectMaterialData // SSBO upload each draw call material data
@@ -42,9 +68,40 @@ struct IndexedIndirectCommand // Gpu culling result
     uint materialId;
 };
 
+struct DrawBatchData // Objects with the same mesh and material, one instanced draw
+{
+    uint indexCount;
+    uint firstIndex;
+    uint vertexOffset;
+    uint firstInstance; // start of the batch in the instance id buffer
+
+    uint materialId;
+    uint lodCount;      // simplified lods are the batches right after lod #0
+    float lodError;     // quadric error relative to the submesh radius
+    uint pad0;
+};
+
 struct OutIndirectDrawCount
 {
     uint outDrawCount;
+
+    uint visibleObjectCount; // draw count before instance batching
+    uint visibleBatchCount;  // draw count after instance batching
+
+    uint clusterDrawCount;   // cluster draws with 32 bit indices
+    uint clusterDrawCount16; // cluster draws with 16 bit indices
+
+    uint testedClusterCount;
+    uint frustumCulledClusterCount;
+    uint coneCulledClusterCount;
+
+    uint frustumCulledObjectCount;
+    uint occlusionCulledObjectCount;  // early phase: not visible last frame
+    uint occlusionCulledClusterCount;
+
+    uint lodTriangleCount;  // appended batch instances with their selected lod
+    uint fullTriangleCount; // the same instances with lod #0
+    uint lodObjectCounts[g_meshMaxLodCount];
 };
 
 struct CascadeInfo
@@ -28,4 +28,33 @@ layout(set = 4, binding = 0, std430) readonly buffer DrawIndirectBuffer
 	IndexedIndirectCommand indirectDraws[];
 } drawIndirectBuffer;
 
+// gl_InstanceIndex of a batch draw indexes the visible object ids of the batch
+layout(set = 4, binding = 1, std430) readonly buffer InstanceIdBuffer
+{
+	uint ids[];
+} instanceIdBuffer;
+
+// Static mesh vertices are quantized at bake time, see PackedMeshVertex.
+// Position is unorm16 inside the render bounds of the submesh, w is the bitangent sign.
+vec3 decodeMeshPosition(vec4 packedPosition,PerObjectData object)
+{
+	return object.sphereBounds.xyz + (packedPosition.xyz * 2.0f - 1.0f) * object.extents.xyz;
+}
+
+// Octahedral snorm16x2 to unit vector.
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	if(n.z < 0.0f)
+	{
+		n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return normalize(n);
+}
+
+vec4 decodeMeshTangent(vec2 packedTangent,vec4 packedPosition)
+{
+	return vec4(decodeOctahedral(packedTangent), packedPosition.w > 0.5f ? 1.0f : -1.0f);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef COMMON_VSM_GLSL
+#define COMMON_VSM_GLSL
+
+// Virtual shadow map of the directional light, see virtual_shadow_map.h
+const uint g_vsmPageSize = 128;      // VirtualShadowMap::PAGE_SIZE
+const uint g_vsmPageTableSize = 128; // VirtualShadowMap::PAGE_TABLE_SIZE
+const uint g_vsmLevelCount = 8;      // VirtualShadowMap::LEVEL_COUNT
+const uint g_vsmPoolSize = 32;       // VirtualShadowMap::POOL_SIZE
+const uint g_vsmInvalidPage = 0xFFFFFFFFu;
+
+struct VirtualShadowInfo
+{
+    mat4 lightMatrix;        // .xy light space position in world units, .z page depth
+    ivec4 levelOrigins[8];   // .xy first page of the level window
+
+    float pageWorldSize;     // world size of a level #0 page
+    float pixelAngle;        // world size of a screen pixel at distance one
+    float lodBias;
+    float depthRange;        // world size of the page depth range
+
+    float filterTexels;      // pcf radius in texels of the sampled level
+    uint bEnable;
+    uint pad0;
+    uint pad1;
+};
+
+float vsmPageWorldSize(float pageWorldSize0, uint level)
+{
+    return pageWorldSize0 * float(1u << level);
+}
+
+// Finest level whose texels still cover the screen pixel at that view distance.
+uint vsmSelectLevel(float pageWorldSize0, float pixelAngle, float lodBias, float viewDistance)
+{
+    float texelWorldSize = pageWorldSize0 / float(g_vsmPageSize);
+    float footprint = pixelAngle * viewDistance;
+    float level = ceil(log2(max(footprint / texelWorldSize, 1.0f)) + lodBias);
+    return uint(clamp(level, 0.0f, float(g_vsmLevelCount - 1)));
+}
+
+bool vsmPageInWindow(ivec2 levelOrigin, ivec2 page)
+{
+    ivec2 local = page - levelOrigin;
+    return all(greaterThanEqual(local, ivec2(0))) && all(lessThan(local, ivec2(g_vsmPageTableSize)));
+}
+
+// The level windows wrap in the page table, a slot holds one page of the window.
+uint vsmPageTableIndex(uint level, ivec2 page)
+{
+    uvec2 wrapped = uvec2(page & ivec2(g_vsmPageTableSize - 1));
+    return level * g_vsmPageTableSize * g_vsmPageTableSize + wrapped.y * g_vsmPageTableSize + wrapped.x;
+}
+
+#endif
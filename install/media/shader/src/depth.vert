@@ -5,10 +5,11 @@
 #include "../glsl/common_framedata.glsl"
 #include "../glsl/common_mesh.glsl"
 
-layout (location = 0) in vec3 inPosition;
+// Quantized vertex, decoded with the helpers of common_mesh.glsl.
+layout (location = 0) in vec4 inPackedPosition;
 layout (location = 1) in vec2 inUV0;
-layout (location = 2) in vec3 inNormal;
-layout (location = 3) in vec4 inTangent;
+layout (location = 2) in vec2 inPackedNormal;
+layout (location = 3) in vec2 inPackedTangent;
 
 layout (location = 0) out vec2 outUV0;
 layout (location = 1) out flat uint outBaseColorTexId;
@@ -32,13 +33,16 @@ void main()
 {
 	outUV0 = inUV0;
 
-	uint objId = drawIndirectBuffer.indirectDraws[gl_DrawID].objectId;
-	uint materialId = drawIndirectBuffer.indirectDraws[gl_DrawID].materialId;
+	uint objId = instanceIdBuffer.ids[gl_InstanceIndex];
+	PerObjectData object = perObjectBuffer.objects[objId];
 
-	mat4 modelMatrix  = perObjectBuffer.objects[objId].model;
+	// Batches are drawn in one range per index width, gl_DrawID restarts in each.
+	uint materialId = drawIndirectBuffer.indirectDraws[object.batchId].materialId;
+
+	mat4 modelMatrix  = object.model;
 	mat4 mvp = cascadeInfosbuffer[cascadeInfos.cascadeIndex].cascadeViewProjMatrix * modelMatrix;
 
-	gl_Position = mvp * vec4(inPosition, 1.0f);
+	gl_Position = mvp * vec4(decodeMeshPosition(inPackedPosition,object), 1.0f);
 
 	PerObjectMaterialData matData = perObjectMaterial.materials[materialId];
 	outBaseColorTexId = matData.baseColorTexId;
@@ -5,10 +5,11 @@
 #include "../glsl/common_mesh.glsl"
 #include "../glsl/common_framedata.glsl"
 
-layout (location = 0) in vec3 inPosition;
+// Quantized vertex, decoded with the helpers of common_mesh.glsl.
+layout (location = 0) in vec4 inPackedPosition;
 layout (location = 1) in vec2 inUV0;
-layout (location = 2) in vec3 inNormal;
-layout (location = 3) in vec4 inTangent;
+layout (location = 2) in vec2 inPackedNormal;
+layout (location = 3) in vec2 inPackedTangent;
 
 layout (location = 0) out vec3 outWorldNormal;
 layout (location = 1) out vec2 outUV0;
@@ -27,11 +28,18 @@ void main()
 	curJitterMat[3][0] += frameData.jitterData.x;
 	curJitterMat[3][1] += frameData.jitterData.y;
 
-	uint objId = drawIndirectBuffer.indirectDraws[gl_DrawID].objectId;
-	uint materialId = drawIndirectBuffer.indirectDraws[gl_DrawID].materialId;
+	uint objId = instanceIdBuffer.ids[gl_InstanceIndex];
+	PerObjectData object = perObjectBuffer.objects[objId];
+
+	// Batches are drawn in one range per index width, gl_DrawID restarts in each.
+	uint materialId = drawIndirectBuffer.indirectDraws[object.batchId].materialId;
 	outMaterialId = materialId;
 
-    mat4 modelMatrix  = perObjectBuffer.objects[objId].model;
+	vec3 inPosition = decodeMeshPosition(inPackedPosition,object);
+	vec3 inNormal = decodeOctahedral(inPackedNormal);
+	vec4 inTangent = decodeMeshTangent(inPackedTangent,inPackedPosition);
+
+    mat4 modelMatrix  = object.model;
 	vec4 worldPos = modelMatrix * vec4(inPosition,1.0f);
 
 	outWorldPos = vec3(worldPos);
@@ -44,7 +52,7 @@ void main()
 	outWorldNormal = normalMatrix * normalize(inNormal);
 	outTangent =  vec4(normalMatrix * normalize(inTangent.xyz),inTangent.w);
 
-	mat4 prevTransMatrix = perObjectBuffer.objects[objId].preModel;
+	mat4 prevTransMatrix = object.preModel;
 	vec3 worldPrevPos = (prevTransMatrix * vec4(inPosition, 1.0f)).xyz;
 	outPrevPosNoJitter = frameData.camViewProjLast * vec4(worldPrevPos, 1);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "../glsl/common.glsl"
 #include "../glsl/common_shadow.glsl"
 #include "../glsl/common_framedata.glsl"
+#include "../glsl/common_vsm.glsl"
 #include "../glsl/brdf.glsl"
 
 layout (set = 1, binding = 0) uniform sampler2D inGbufferBaseColorMetal;
@@ -14,12 +15,23 @@ layout (set = 1, binding = 4) uniform sampler2DArray inShadowDepthBilinearTextur
 layout (set = 1, binding = 5) uniform sampler2D inBRDFLut;
 layout (set = 1, binding = 6) uniform samplerCube inIrradiancePrefilter;
 layout (set = 1, binding = 7) uniform samplerCube inEnvSpecularPrefilter;
+layout (set = 1, binding = 8) uniform sampler2DArray inVirtualShadowPool;
 
 layout(set = 2, binding = 0) readonly buffer CascadeInfoBuffer
 {
 	CascadeInfo cascadeInfosbuffer[];
 };
 
+layout(set = 3, binding = 0) readonly buffer VirtualShadowInfoBuffer
+{
+    VirtualShadowInfo vsmInfo;
+};
+
+layout(set = 3, binding = 1) readonly buffer VirtualShadowPageTableBuffer
+{
+    uint vsmPageTable[]; // physical page of each page table slot
+};
+
 struct LightingPushConstants
 {
 	float pcfDilation;
@@ -213,6 +225,69 @@ float evaluateDirectShadow(
     return shadowFactor;
 }
 
+// Returns -1 when a tap has no resident page, the cascades shade the pixel then.
+float evaluateVirtualShadow(vec3 fragWorldPos, vec3 vertexNormal, vec3 lightDirection)
+{
+    if(vsmInfo.bEnable == 0)
+    {
+        return -1.0f;
+    }
+
+    uint level = vsmSelectLevel(
+        vsmInfo.pageWorldSize,
+        vsmInfo.pixelAngle,
+        vsmInfo.lodBias,
+        distance(fragWorldPos, frameData.camWorldPos.xyz));
+    float pageWorldSize = vsmPageWorldSize(vsmInfo.pageWorldSize, level);
+    float texelWorldSize = pageWorldSize / float(g_vsmPageSize);
+
+    float VertexNoLSafe = clamp(dot(vertexNormal, lightDirection), 0.0f, 1.0f);
+
+    // Keep the normal offset within the page margin marked by vsm_mark.comp.
+    vec3 worldPosProcess = fragWorldPos + vertexNormal * (1.0f - VertexNoLSafe) * 2.0f * texelWorldSize;
+    vec3 lightPos = (vsmInfo.lightMatrix * vec4(worldPosProcess, 1.0f)).xyz;
+    if(lightPos.z < 0.0f || lightPos.z > 1.0f)
+    {
+        return -1.0f;
+    }
+
+    // Slope scaled by the filter radius, one texel of the level at least.
+    float tanNoL = sqrt(max(1.0f - VertexNoLSafe * VertexNoLSafe, 0.0f)) / max(VertexNoLSafe, 0.001f);
+    float bias = texelWorldSize * (1.0f + (1.0f + vsmInfo.filterTexels) * min(tanNoL, 8.0f)) / vsmInfo.depthRange;
+
+    const bool bReverseZOpen = true; // Now always reverse z
+    float receiverZ = bReverseZOpen ? lightPos.z + bias : lightPos.z - bias;
+
+    float shadowFactor = 0.0f;
+    for(uint i = 0; i < 25; i++)
+    {
+        vec2 tapPos = lightPos.xy + poisson_disk_25[i] * vsmInfo.filterTexels * texelWorldSize;
+        vec2 pagePos = tapPos / pageWorldSize;
+        ivec2 page = ivec2(floor(pagePos));
+        if(!vsmPageInWindow(vsmInfo.levelOrigins[level].xy, page))
+        {
+            return -1.0f;
+        }
+
+        uint physicalPage = vsmPageTable[vsmPageTableIndex(level, page)];
+        if(physicalPage == g_vsmInvalidPage)
+        {
+            return -1.0f;
+        }
+
+        // Page content is rendered with the viewport flipped like the cascades.
+        vec2 pageUv = pagePos - vec2(page);
+        pageUv.y = 1.0f - pageUv.y;
+
+        ivec2 tile = ivec2(physicalPage % g_vsmPoolSize, physicalPage / g_vsmPoolSize) * int(g_vsmPageSize);
+        ivec2 texel = tile + clamp(ivec2(pageUv * float(g_vsmPageSize)), ivec2(0), ivec2(g_vsmPageSize - 1));
+
+        float mapDepth = texelFetch(inVirtualShadowPool, ivec3(texel, 0), 0).r;
+        shadowFactor += (bReverseZOpen ? mapDepth < receiverZ : mapDepth > receiverZ) ? 1.0f : 0.0f;
+    }
+    return shadowFactor / 25.0f;
+}
+
 void main()
 {
     GbufferData gData = loadGbufferData();
@@ -234,15 +309,19 @@ void main()
     vec3 F0   = gData.F0; 
 
     uint cascadeIndex = 0;
-    float directShadow = evaluateDirectShadow(
-        gData.linearZ, 
-        NoL, 
-        gData.worldPos,
-        n,
-        cascadeIndex,
-        l,
-        gData.worldNormal
-    );  
+    float directShadow = evaluateVirtualShadow(gData.worldPos, gData.worldNormal, l);
+    if(directShadow < 0.0f)
+    {
+        directShadow = evaluateDirectShadow(
+            gData.linearZ, 
+            NoL, 
+            gData.worldPos,
+            n,
+            cascadeIndex,
+            l,
+            gData.worldNormal
+        );  
+    }
     vec3 debugColor = getCascadeDebugColor(cascadeIndex);
     directShadow = max(0.0,directShadow);
 
@@ -12,6 +12,8 @@
 #include "widget/dockspace.h"
 #include "widget/widget_filebrower.h"
 #include "widget/widget_assetInspector.h"
+#include "widget/widget_renderstats.h"
+#include "widget/widget_profiler.h"
 
 using namespace engine;
 
@@ -30,6 +32,8 @@ void Editor::init()
     m_widgets.push_back(new WidgetHierarchy(engine));
     m_widgets.push_back(new WidgetDetail(engine)); // DetailӦ÷Hierarchy
 	m_widgets.push_back(new WidgetAssetInspector(engine));
+	m_widgets.push_back(new WidgetRenderStats(engine));
+	m_widgets.push_back(new WidgetProfiler(engine));
 
     // NOTE: file brower ŵ
     m_widgets.push_back(new WidgetFileBrowser(engine));
@@ -85,6 +85,18 @@ void DockSpace::showDockSpace()
                 g_fileDialogInstance.Open();
             }
 
+            if(ImGui::MenuItem(u8"Load Sub Scene",NULL,false,!m_sceneManager->isSceneLoading()))
+            {
+                EditorFileBrowser::g_action = EFileBrowserAction::LoadSubScene;
+                g_fileDialogInstance.Open();
+            }
+
+            if(ImGui::MenuItem(u8"Export Scene Json",NULL,false,true))
+            {
+                EditorFileBrowser::g_action = EFileBrowserAction::ExportScene;
+                g_fileDialogInstance.Open();
+            }
+
             ImGui::Separator();
 
             if(ImGui::MenuItem(u8"Close",NULL,false,g_engineLoop.getRun()!=NULL))
@@ -21,7 +21,10 @@ std::vector<std::string> getActionFilterString()
 	case EFileBrowserAction::LoadScene:
 	case EFileBrowserAction::SaveScene_LoadScene:
 	case EFileBrowserAction::SaveScene_Close:
+	case EFileBrowserAction::LoadSubScene:
 		return {".flower"};
+	case EFileBrowserAction::ExportScene:
+		return {".json"};
 	case EFileBrowserAction::PMXMesh_Select:
 		return {".pmx"};
 	}
@@ -48,12 +51,27 @@ void WidgetFileBrowser::onVisibleTick(size_t)
 		}
 	};
 
+	auto exportScene = [&](std::string path)
+	{
+		if(m_sceneManager->exportScene(path))
+		{
+			LOG_INFO("Exported project path {0}.",path);
+		}
+	};
+
 	auto loadScene = [&](std::string path)
 	{
-		m_sceneManager->unloadScene();
-		if(m_sceneManager->loadScene(path))
+		if(m_sceneManager->loadSceneAsync(path))
+		{
+			LOG_INFO("Loading project path {0}.",path);
+		}
+	};
+
+	auto loadSubScene = [&](std::string path)
+	{
+		if(m_sceneManager->addSubScene(path) != 0)
 		{
-			LOG_INFO("Loaded project path {0}.",path);
+			LOG_INFO("Loading sub scene path {0}.",path);
 		}
 	};
 
@@ -88,6 +106,14 @@ void WidgetFileBrowser::onVisibleTick(size_t)
 		{
 			// todo:
 		}
+		else if(EditorFileBrowser::g_action == EFileBrowserAction::ExportScene)
+		{
+			exportScene(path);
+		}
+		else if(EditorFileBrowser::g_action == EFileBrowserAction::LoadSubScene)
+		{
+			loadSubScene(path);
+		}
 		else if(EditorFileBrowser::g_action == EFileBrowserAction::PMXMesh_Select)
 		{
 			selectPMX(path);
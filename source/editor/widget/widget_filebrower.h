@@ -853,6 +853,8 @@ enum class EFileBrowserAction
     LoadScene,
     SaveScene_LoadScene,
     SaveScene_Close,
+    ExportScene,
+    LoadSubScene,
 
     PMXMesh_Select,
 };
@@ -0,0 +1,138 @@
+#include "widget_profiler.h"
+#include "../../imgui/imgui.h"
+#include <string_view>
+
+using namespace engine;
+
+WidgetProfiler::WidgetProfiler(engine::Ref<engine::Engine> engine)
+	: Widget(engine)
+{
+	m_title = "Profiler";
+}
+
+void WidgetProfiler::onVisibleTick(size_t)
+{
+	ImGui::SetNextWindowSize(ImVec2(720, 360), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin(m_title.c_str(), &m_visible))
+	{
+		ImGui::End();
+		return;
+	}
+
+#ifndef ENABLE_CPU_PROFILER
+	ImGui::Text("CPU profiler is compiled out, define ENABLE_CPU_PROFILER in core.h.");
+#else
+	if(int32* enable = CVarSystem::get()->getInt32CVar("r.Profiler.Cpu"))
+	{
+		bool bEnable = *enable != 0;
+		if(ImGui::Checkbox("Enable",&bEnable))
+		{
+			*enable = bEnable ? 1 : 0;
+		}
+	}
+	ImGui::SameLine();
+	ImGui::Checkbox("Pause",&m_bPause);
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(160.0f);
+	ImGui::SliderFloat("Zoom",&m_zoom,1.0f,32.0f,"%.1fx",ImGuiSliderFlags_Logarithmic);
+	ImGui::SameLine();
+	if(ImGui::Button("Export trace"))
+	{
+		CVarSystem::get()->setInt32CVar("r.Profiler.TraceExport",1);
+	}
+
+	if(!m_bPause)
+	{
+		refresh();
+	}
+
+	if(m_frame.index == 0)
+	{
+		ImGui::Text("No frames yet.");
+	}
+	else
+	{
+		char overlay[64];
+		snprintf(overlay,sizeof(overlay),"CPU %.3f ms (frame %llu)",CpuProfiler::ticksToMs(m_frame.endTicks - m_frame.beginTicks),(unsigned long long)m_frame.index);
+		ImGui::PlotLines("##CpuFrameHistory",m_frameHistory.data(),(int)m_frameHistory.size(),0,overlay,0.0f,FLT_MAX,ImVec2(-FLT_MIN,50.0f));
+
+		drawTimeline();
+	}
+#endif
+
+	ImGui::End();
+}
+
+void WidgetProfiler::refresh()
+{
+	const auto frames = CpuProfiler::get()->getFrames();
+	if(frames.empty())
+	{
+		return;
+	}
+
+	m_frameHistory.clear();
+	for(const auto& frame : frames)
+	{
+		m_frameHistory.push_back((float)CpuProfiler::ticksToMs(frame.endTicks - frame.beginTicks));
+	}
+
+	m_frame = frames.back();
+	CpuProfiler::get()->collect(m_frame.beginTicks,m_frame.endTicks,m_threads);
+}
+
+void WidgetProfiler::drawTimeline()
+{
+	const float labelWidth = 110.0f;
+	const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+	const double frameMs = glm::max(CpuProfiler::ticksToMs(m_frame.endTicks - m_frame.beginTicks),1e-3);
+
+	ImGui::BeginChild("Timeline",ImVec2(0,0),true,ImGuiWindowFlags_HorizontalScrollbar);
+
+	const float width = glm::max(ImGui::GetContentRegionAvail().x - labelWidth,64.0f) * m_zoom;
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+	for(const auto& thread : m_threads)
+	{
+		uint32 maxDepth = 0;
+		for(const auto& event : thread.events)
+		{
+			maxDepth = glm::max(maxDepth,event.depth);
+		}
+
+		const ImVec2 origin = ImGui::GetCursorScreenPos();
+		drawList->AddText(origin,ImGui::GetColorU32(ImGuiCol_Text),thread.threadName.c_str());
+
+		for(const auto& event : thread.events)
+		{
+			// Events overlapping the frame edges are clamped to it.
+			const double beginMs = glm::max(CpuProfiler::ticksToMs(event.beginTicks - m_frame.beginTicks),0.0);
+			const double endMs = glm::min(CpuProfiler::ticksToMs(event.endTicks - m_frame.beginTicks),frameMs);
+
+			ImVec2 min(origin.x + labelWidth + float(beginMs / frameMs) * width,origin.y + event.depth * rowHeight);
+			ImVec2 max(origin.x + labelWidth + float(endMs / frameMs) * width,min.y + rowHeight - 1.0f);
+			max.x = glm::max(max.x,min.x + 1.0f);
+
+			const float hue = float(std::hash<std::string_view>{}(event.name) % 360) / 360.0f;
+			drawList->AddRectFilled(min,max,ImColor::HSV(hue,0.45f,0.75f));
+
+			drawList->PushClipRect(min,max,true);
+			drawList->AddText(ImVec2(min.x + 2.0f,min.y),IM_COL32(0,0,0,255),event.name);
+			drawList->PopClipRect();
+
+			if(ImGui::IsMouseHoveringRect(min,max))
+			{
+				ImGui::SetTooltip("%s\n%.3f ms",event.name,CpuProfiler::ticksToMs(event.endTicks - event.beginTicks));
+			}
+		}
+
+		ImGui::Dummy(ImVec2(labelWidth + width,(maxDepth + 1) * rowHeight + 4.0f));
+	}
+
+	ImGui::EndChild();
+}
+
+WidgetProfiler::~WidgetProfiler()
+{
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "widget.h"
+#include "../../engine/core/cpu_profiler.h"
+
+class WidgetProfiler : public Widget
+{
+public:
+	WidgetProfiler(engine::Ref<engine::Engine> engine);
+	virtual void onVisibleTick(size_t) override;
+	~WidgetProfiler();
+
+private:
+	void refresh();
+	void drawTimeline();
+
+	// Snapshot of the last completed frame, kept while paused.
+	engine::CpuProfiler::Frame m_frame = {};
+	std::vector<engine::CpuProfiler::ThreadEvents> m_threads = {};
+	std::vector<float> m_frameHistory = {};
+
+	bool m_bPause = false;
+	float m_zoom = 1.0f;
+};
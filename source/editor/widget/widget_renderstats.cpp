@@ -0,0 +1,335 @@
+#include "widget_renderstats.h"
+#include "../../imgui/imgui.h"
+#include "../../engine/core/timer.h"
+#include "../../engine/renderer/mesh.h"
+
+using namespace engine;
+
+WidgetRenderStats::WidgetRenderStats(engine::Ref<engine::Engine> engine)
+	: Widget(engine)
+{
+	m_title = "RenderStats";
+}
+
+void WidgetRenderStats::onVisibleTick(size_t)
+{
+	ImGui::SetNextWindowSize(ImVec2(420, 360), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin(m_title.c_str(), &m_visible))
+	{
+		ImGui::End();
+		return;
+	}
+
+	if(ImGui::CollapsingHeader("Frame Pacing",ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		drawPacingStats();
+	}
+
+	if(ImGui::CollapsingHeader("Command Recording",ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		drawRecordStats();
+	}
+
+	if(ImGui::CollapsingHeader("Descriptors"))
+	{
+		drawDescriptorStats();
+	}
+
+	if(ImGui::CollapsingHeader("Geometry Heaps"))
+	{
+		drawGeometryStats();
+	}
+
+	if(ImGui::CollapsingHeader("GPU Timings",ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		drawGpuStats();
+	}
+
+	ImGui::End();
+}
+
+void WidgetRenderStats::drawPacingStats()
+{
+	auto* rhi = VulkanRHI::get();
+	ImGui::Text("FPS: %.1f  Frames in flight: %u", g_timer.getCurrentSmoothFps(), rhi->getMaxFramesInFlight());
+	ImGui::Text("Input to present: %.2f ms (avg %.2f ms)", rhi->getInputToPresentMs(), rhi->getSmoothInputToPresentMs());
+
+	if(int32* maxFps = CVarSystem::get()->getInt32CVar("r.Window.MaxFps"))
+	{
+		ImGui::SetNextItemWidth(120.0f);
+		ImGui::DragInt("Max FPS (0 off)",maxFps,1.0f,0,1000);
+	}
+	ImGui::SameLine();
+	if(int32* lowLatency = CVarSystem::get()->getInt32CVar("r.Window.LowLatency"))
+	{
+		bool bLowLatency = *lowLatency != 0;
+		if(ImGui::Checkbox("Low latency",&bLowLatency))
+		{
+			*lowLatency = bLowLatency ? 1 : 0;
+		}
+	}
+}
+
+void WidgetRenderStats::drawRecordStats()
+{
+	const auto& stats = m_renderer->getRecordStats();
+
+	float sumMs = 0.0f;
+	float maxMs = 0.0f;
+	for(const auto& pass : stats.passes)
+	{
+		sumMs += pass.recordMs;
+		maxMs = glm::max(maxMs,pass.recordMs);
+	}
+
+	// Sum of the passes is what a single thread would spend, wall is what the frame paid.
+	ImGui::Text("Jobs: %u", stats.jobCount);
+	ImGui::Text("Wall: %.3f ms  Pass sum: %.3f ms  Speedup: %.2fx", stats.wallMs, sumMs, stats.wallMs > 0.0f ? sumMs / stats.wallMs : 1.0f);
+
+	const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp;
+	if(ImGui::BeginTable("PassRecordTimes",3,flags))
+	{
+		ImGui::TableSetupColumn("Pass");
+		ImGui::TableSetupColumn("Record ms");
+		ImGui::TableSetupColumn("");
+		ImGui::TableHeadersRow();
+
+		for(const auto& pass : stats.passes)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			ImGui::Text("%s", pass.name.c_str());
+			ImGui::TableSetColumnIndex(1);
+			ImGui::Text("%.3f", pass.recordMs);
+			ImGui::TableSetColumnIndex(2);
+			ImGui::ProgressBar(maxMs > 0.0f ? pass.recordMs / maxMs : 0.0f, ImVec2(-FLT_MIN, 0), "");
+		}
+		ImGui::EndTable();
+	}
+}
+
+void WidgetRenderStats::drawDescriptorStats()
+{
+	auto* rhi = VulkanRHI::get();
+
+	VulkanDescriptorAllocator::Stats dynamicStats { };
+	for(uint32 i = 0; i < (uint32)rhi->getSwapchainImageViews().size(); i++)
+	{
+		const auto stats = m_renderer->getDynamicDescriptorAllocator(i).getStats();
+		dynamicStats.setCount += stats.setCount;
+		dynamicStats.usedPoolCount += stats.usedPoolCount;
+		dynamicStats.freePoolCount += stats.freePoolCount;
+	}
+
+	const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp;
+	if(ImGui::BeginTable("DescriptorAllocators",4,flags))
+	{
+		ImGui::TableSetupColumn("Allocator");
+		ImGui::TableSetupColumn("Sets");
+		ImGui::TableSetupColumn("Used pools");
+		ImGui::TableSetupColumn("Free pools");
+		ImGui::TableHeadersRow();
+
+		const auto drawRow = [](const char* name,const VulkanDescriptorAllocator::Stats& stats)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			ImGui::Text("%s", name);
+			ImGui::TableSetColumnIndex(1);
+			ImGui::Text("%u", stats.setCount);
+			ImGui::TableSetColumnIndex(2);
+			ImGui::Text("%u", stats.usedPoolCount);
+			ImGui::TableSetColumnIndex(3);
+			ImGui::Text("%u", stats.freePoolCount);
+		};
+		drawRow("Static",rhi->getStaticDescriptorStats());
+		drawRow("Per back buffer",dynamicStats);
+		drawRow("Per frame (last)",rhi->getFrameDescriptorStats());
+		ImGui::EndTable();
+	}
+
+	const auto cacheStats = rhi->getDescriptorSetCacheStats();
+	const uint64 lookups = cacheStats.hitCount + cacheStats.missCount;
+	ImGui::Text("Set cache: %u sets in %u pools, %llu hits / %llu lookups (%.1f%%)",
+		cacheStats.setCount,
+		cacheStats.poolCount,
+		(unsigned long long)cacheStats.hitCount,
+		(unsigned long long)lookups,
+		lookups > 0 ? 100.0 * cacheStats.hitCount / lookups : 0.0);
+	ImGui::Text("Push descriptors: %s", rhi->isPushDescriptorEnabled() ? "enabled" : "disabled");
+}
+
+void WidgetRenderStats::drawGeometryStats()
+{
+	const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp;
+	if(ImGui::BeginTable("GeometryHeaps",6,flags))
+	{
+		ImGui::TableSetupColumn("Heap");
+		ImGui::TableSetupColumn("Used / size mb");
+		ImGui::TableSetupColumn("Ranges");
+		ImGui::TableSetupColumn("Free blocks");
+		ImGui::TableSetupColumn("Fragmentation");
+		ImGui::TableSetupColumn("Grows / moves");
+		ImGui::TableHeadersRow();
+
+		const auto drawRow = [](const char* name,const GeometryHeap::Stats& stats)
+		{
+			constexpr double toMb = 1.0 / (1024.0 * 1024.0);
+
+			ImGui::TableNextRow();
+			ImGui::TableSetColumnIndex(0);
+			ImGui::Text("%s", name);
+			ImGui::TableSetColumnIndex(1);
+			ImGui::Text("%.1f / %.1f", stats.usedBytes * toMb, stats.bufferBytes * toMb);
+			ImGui::TableSetColumnIndex(2);
+			ImGui::Text("%u (%u pending free)", stats.allocationCount, stats.pendingFreeCount);
+			ImGui::TableSetColumnIndex(3);
+			ImGui::Text("%u, largest %.1f mb", stats.freeBlockCount, stats.largestFreeBytes * toMb);
+			ImGui::TableSetColumnIndex(4);
+			ImGui::Text("%.1f%%", stats.fragmentation * 100.0f);
+			ImGui::TableSetColumnIndex(5);
+			ImGui::Text("%u / %u", stats.growCount, stats.moveCount);
+		};
+		drawRow("Vertex",MeshLibrary::get()->getVertexHeapStats());
+		drawRow("Index",MeshLibrary::get()->getIndexHeapStats());
+		drawRow("Index16",MeshLibrary::get()->getIndex16HeapStats());
+		drawRow("Meshlet",MeshLibrary::get()->getMeshletHeapStats());
+		ImGui::EndTable();
+	}
+
+	if(int32* mirror = CVarSystem::get()->getInt32CVar("r.Mesh.CpuMirror"))
+	{
+		bool bMirror = *mirror != 0;
+		if(ImGui::Checkbox("Cpu mirror for new meshes",&bMirror))
+		{
+			*mirror = bMirror ? 1 : 0;
+		}
+	}
+}
+
+void WidgetRenderStats::drawGpuStats()
+{
+	auto* profiler = GpuProfiler::get();
+	const auto& result = profiler->getLatestResult();
+	const auto& history = profiler->getFrameHistory();
+
+	if(int32* enable = CVarSystem::get()->getInt32CVar("r.Profiler.Gpu"))
+	{
+		bool bEnable = *enable != 0;
+		if(ImGui::Checkbox("Enable",&bEnable))
+		{
+			*enable = bEnable ? 1 : 0;
+		}
+	}
+	ImGui::SameLine();
+	if(int32* statistics = CVarSystem::get()->getInt32CVar("r.Profiler.GpuStatistics"))
+	{
+		bool bStatistics = *statistics != 0;
+		if(ImGui::Checkbox("Pipeline statistics",&bStatistics))
+		{
+			*statistics = bStatistics ? 1 : 0;
+		}
+	}
+	ImGui::SameLine();
+	if(ImGui::Button("Export trace"))
+	{
+		CVarSystem::get()->setInt32CVar("r.Profiler.TraceExport",1);
+	}
+
+	if(result.scopes.empty())
+	{
+		ImGui::Text("No results yet.");
+		return;
+	}
+
+	char overlay[64];
+	snprintf(overlay,sizeof(overlay),"GPU %.3f ms (frame %llu)",result.gpuMs,(unsigned long long)result.frameIndex);
+	ImGui::PlotLines("##GpuFrameHistory",history.data(),(int)history.size(),0,overlay,0.0f,FLT_MAX,ImVec2(-FLT_MIN,60.0f));
+
+	float maxMs = 0.0f;
+	bool bStatistics = false;
+	for(const auto& scope : result.scopes)
+	{
+		maxMs = glm::max(maxMs,scope.smoothedMs);
+		bStatistics |= scope.bStatistics;
+	}
+
+	const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp;
+	if(ImGui::BeginTable("GpuScopeTimes",bStatistics ? 8 : 4,flags))
+	{
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("Queue");
+		ImGui::TableSetupColumn("GPU ms");
+		ImGui::TableSetupColumn("");
+		if(bStatistics)
+		{
+			ImGui::TableSetupColumn("Prims");
+			ImGui::TableSetupColumn("VS");
+			ImGui::TableSetupColumn("FS");
+			ImGui::TableSetupColumn("CS");
+		}
+		ImGui::TableHeadersRow();
+
+		for(size_t i = 0; i < result.scopes.size();)
+		{
+			i = drawGpuScope(result.scopes,i,maxMs,bStatistics);
+		}
+		ImGui::EndTable();
+	}
+}
+
+size_t WidgetRenderStats::drawGpuScope(const std::vector<GpuProfiler::ScopeResult>& scopes,size_t index,float maxMs,bool bStatistics)
+{
+	const auto& scope = scopes[index];
+	size_t next = index + 1;
+	const bool bLeaf = next >= scopes.size() || scopes[next].depth <= scope.depth;
+
+	ImGui::TableNextRow();
+	ImGui::TableSetColumnIndex(0);
+	ImGuiTreeNodeFlags nodeFlags = ImGuiTreeNodeFlags_SpanFullWidth;
+	if(bLeaf)
+	{
+		nodeFlags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+	}
+	const bool bOpen = ImGui::TreeNodeEx(scope.name.c_str(),nodeFlags,"%s",scope.name.c_str());
+
+	ImGui::TableSetColumnIndex(1);
+	ImGui::Text("%s",scope.queue == frame_graph::EQueueType::AsyncCompute ? "Compute" : "Graphics");
+	ImGui::TableSetColumnIndex(2);
+	ImGui::Text("%.3f",scope.smoothedMs);
+	ImGui::TableSetColumnIndex(3);
+	ImGui::ProgressBar(maxMs > 0.0f ? scope.smoothedMs / maxMs : 0.0f,ImVec2(-FLT_MIN,0),"");
+
+	if(bStatistics && scope.bStatistics)
+	{
+		ImGui::TableSetColumnIndex(4);
+		ImGui::Text("%llu",(unsigned long long)scope.statistics[GpuProfiler::ClippingPrimitives]);
+		ImGui::TableSetColumnIndex(5);
+		ImGui::Text("%llu",(unsigned long long)scope.statistics[GpuProfiler::VertexShaderInvocations]);
+		ImGui::TableSetColumnIndex(6);
+		ImGui::Text("%llu",(unsigned long long)scope.statistics[GpuProfiler::FragmentShaderInvocations]);
+		ImGui::TableSetColumnIndex(7);
+		ImGui::Text("%llu",(unsigned long long)scope.statistics[GpuProfiler::ComputeShaderInvocations]);
+	}
+
+	if(bLeaf)
+	{
+		return next;
+	}
+
+	// Children follow their parent, closed nodes skip them.
+	while(next < scopes.size() && scopes[next].depth > scope.depth)
+	{
+		next = bOpen ? drawGpuScope(scopes,next,maxMs,bStatistics) : next + 1;
+	}
+	if(bOpen)
+	{
+		ImGui::TreePop();
+	}
+	return next;
+}
+
+WidgetRenderStats::~WidgetRenderStats()
+{
+
+}
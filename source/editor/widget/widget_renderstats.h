@@ -0,0 +1,20 @@
+#pragma once
+#include "widget.h"
+#include "../../engine/renderer/gpu_profiler.h"
+#include "../../engine/renderer/geometry_heap.h"
+
+class WidgetRenderStats : public Widget
+{
+public:
+	WidgetRenderStats(engine::Ref<engine::Engine> engine);
+	virtual void onVisibleTick(size_t) override;
+	~WidgetRenderStats();
+
+private:
+	void drawPacingStats();
+	void drawRecordStats();
+	void drawDescriptorStats();
+	void drawGeometryStats();
+	void drawGpuStats();
+	size_t drawGpuScope(const std::vector<engine::GpuProfiler::ScopeResult>& scopes,size_t index,float maxMs,bool bStatistics);
+};
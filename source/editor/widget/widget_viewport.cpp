@@ -42,11 +42,42 @@ void WidgetViewport::onVisibleTick(size_t i)
 	
 	ImGui::Image(m_cacheImageInfo.getId(uint32_t(i)),ImVec2(width,height));
 	Input::setMouseInViewport(ImGui::IsItemHovered());
+
+	// NOTE: Left click picks the closest static mesh under the cursor.
+	if(ImGui::IsItemHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+	{
+		const ImVec2 itemMin = ImGui::GetItemRectMin();
+		const ImVec2 mousePos = ImGui::GetMousePos();
+		pickSceneNode(glm::vec2((mousePos.x - itemMin.x) / width,(mousePos.y - itemMin.y) / height));
+	}
 	//ImGui::Image((ImTextureID)EngineAsset::get()->iconFile.getId(),ImVec2(width,height));
 	ImGui::End();
 	if(!mini_window)ImGui::PopStyleVar(1);
 }
 
+void WidgetViewport::pickSceneNode(const glm::vec2& uv)
+{
+	// NOTE: Mesh raster flips y with a negative viewport height, so uv.y = 0 is ndc.y = 1.
+	const glm::vec2 ndc = glm::vec2(uv.x * 2.0f - 1.0f,1.0f - uv.y * 2.0f);
+	const float nearZ = reverseZOpen() ? 1.0f : 0.0f;
+	const float farZ  = reverseZOpen() ? 0.0f : 1.0f;
+
+	const glm::mat4& invViewProj = m_renderer->getGPUFrameData().camInvertViewProj;
+	glm::vec4 nearPos = invViewProj * glm::vec4(ndc,nearZ,1.0f);
+	glm::vec4 farPos  = invViewProj * glm::vec4(ndc,farZ,1.0f);
+	nearPos /= nearPos.w;
+	farPos  /= farPos.w;
+
+	const glm::vec3 origin = glm::vec3(nearPos);
+	const glm::vec3 dir = glm::normalize(glm::vec3(farPos) - origin);
+
+	auto hitNode = m_renderer->getRenderScene().pick(origin,dir);
+	if(hitNode.lock())
+	{
+		EditorScene::get().rightClickNode = hitNode;
+	}
+}
+
 WidgetViewport::~WidgetViewport()
 {
 
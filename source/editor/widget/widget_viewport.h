@@ -8,6 +8,9 @@ public:
 	virtual void onVisibleTick(size_t) override;
 	~WidgetViewport();
 
+private:
+	void pickSceneNode(const glm::vec2& uv);
+
 private:
 	float m_sceneViewWidth = 0.0f;
 	float m_sceneViewHeight = 0.0f;
@@ -7,6 +7,8 @@
 #include "../core/timer.h"
 #include <algorithm>
 #include <unordered_map>
+#include <limits>
+#include <glm/gtc/packing.hpp>
 #include "../renderer/material.h"
 
 #include <assimp/Importer.hpp>
@@ -72,6 +74,10 @@ MeshInfo readMeshInfo(AssetFile* file)
 
 	info.vertCount = metadata["vertNum"];
 	info.subMeshCount = metadata["subMeshCount"];
+	if(metadata.contains("meshletCount"))
+	{
+		info.meshletCount = metadata["meshletCount"];
+	}
 	info.originalFile = metadata["originalFile"];
 
 	std::string compressionString = metadata["compression"];
@@ -91,6 +97,42 @@ MeshInfo readMeshInfo(AssetFile* file)
         subMeshInfo.vertexCount = metadata[subMeshPreStr+"VertexCount"];
         subMeshInfo.indexStartPosition = metadata[subMeshPreStr+"IndexStartPosition"];
 
+        // NOTE: Meshes baked before quantization keep every index 32 bit and relative to the mesh.
+        if(metadata.contains(subMeshPreStr+"BaseVertex"))
+        {
+            subMeshInfo.baseVertex = metadata[subMeshPreStr+"BaseVertex"];
+            subMeshInfo.bIndex16 = metadata[subMeshPreStr+"IndexFormat"] == 16;
+        }
+
+        // NOTE: Meshes baked before meshlets have none, they are culled per submesh.
+        if(metadata.contains(subMeshPreStr+"MeshletCount"))
+        {
+            subMeshInfo.meshletStart = metadata[subMeshPreStr+"MeshletStart"];
+            subMeshInfo.meshletCount = metadata[subMeshPreStr+"MeshletCount"];
+        }
+
+        // NOTE: Meshes baked before lods only have the full level.
+        if(metadata.contains(subMeshPreStr+"LodRanges"))
+        {
+            const std::vector<uint32> ranges = metadata[subMeshPreStr+"LodRanges"].get<std::vector<uint32>>();
+            const std::vector<float> errors = metadata[subMeshPreStr+"LodErrors"].get<std::vector<float>>();
+            CHECK(ranges.size() == errors.size() * 2 && errors.size() <= MESH_MAX_LOD_COUNT);
+
+            subMeshInfo.lods.resize(errors.size());
+            for(size_t lod = 0; lod < errors.size(); lod++)
+            {
+                subMeshInfo.lods[lod].firstIndex = ranges[lod * 2 + 0];
+                subMeshInfo.lods[lod].indexCount = ranges[lod * 2 + 1];
+                subMeshInfo.lods[lod].error = errors[lod];
+            }
+        }
+        else
+        {
+            MeshLod fullLod {};
+            fullLod.indexCount = subMeshInfo.indexCount;
+            subMeshInfo.lods = { fullLod };
+        }
+
 		std::vector<float> subBoundsData;
 		subBoundsData.reserve(7);
 		subBoundsData = metadata[subMeshPreStr+"Bounds"].get<std::vector<float>>();
@@ -107,7 +149,292 @@ MeshInfo readMeshInfo(AssetFile* file)
 	return info;
 }
 
-AssetFile packMesh(MeshInfo* info,char* vertexData,char* indexData,bool compress)
+namespace
+{
+    // NOTE: Keep the decode in sync with common_mesh.glsl.
+    glm::vec2 encodeOctahedral(glm::vec3 n)
+    {
+        n = glm::length(n) > 1e-8f ? n / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z)) : glm::vec3(0.0f,0.0f,1.0f);
+
+        glm::vec2 p = glm::vec2(n.x,n.y);
+        if(n.z < 0.0f)
+        {
+            const glm::vec2 s = glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f,p.y >= 0.0f ? 1.0f : -1.0f);
+            p = (1.0f - glm::abs(glm::vec2(p.y,p.x))) * s;
+        }
+        return p;
+    }
+
+    glm::vec3 decodeOctahedral(glm::vec2 e)
+    {
+        glm::vec3 n = glm::vec3(e.x,e.y,1.0f - std::abs(e.x) - std::abs(e.y));
+        if(n.z < 0.0f)
+        {
+            const glm::vec2 s = glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f,n.y >= 0.0f ? 1.0f : -1.0f);
+            const glm::vec2 xy = (1.0f - glm::abs(glm::vec2(n.y,n.x))) * s;
+            n.x = xy.x;
+            n.y = xy.y;
+        }
+        return glm::normalize(n);
+    }
+
+    // NOTE: Same conversions as the vulkan unorm and snorm vertex formats.
+    uint16 toUnorm16(float v) { return (uint16)std::lround(glm::clamp(v,0.0f,1.0f) * 65535.0f); }
+    float fromUnorm16(uint16 v) { return float(v) / 65535.0f; }
+    int16 toSnorm16(float v) { return (int16)std::lround(glm::clamp(v,-1.0f,1.0f) * 32767.0f); }
+    float fromSnorm16(int16 v) { return glm::max(float(v) / 32767.0f,-1.0f); }
+
+    float angleDegrees(glm::vec3 a,glm::vec3 b)
+    {
+        return glm::degrees(std::acos(glm::clamp(glm::dot(a,b),-1.0f,1.0f)));
+    }
+
+    // v is one vertex in the standard layout.
+    PackedMeshVertex packVertex(const float* v,const glm::vec3& origin,const glm::vec3& extents,MeshQuantizationReport* report)
+    {
+        const glm::vec3 pos = glm::vec3(v[0],v[1],v[2]);
+        const glm::vec2 uv = glm::vec2(v[3],v[4]);
+        const glm::vec3 normal = glm::vec3(v[5],v[6],v[7]);
+        const glm::vec4 tangent = glm::vec4(v[8],v[9],v[10],v[11]);
+
+        PackedMeshVertex packed {};
+        for(uint32 i = 0; i < 3; i++)
+        {
+            const float t = extents[i] > 0.0f ? (pos[i] - origin[i]) / extents[i] * 0.5f + 0.5f : 0.5f;
+            packed.position[i] = toUnorm16(t);
+        }
+        packed.position[3] = tangent.w < 0.0f ? 0 : 65535;
+
+        packed.uv0[0] = glm::packHalf1x16(uv.x);
+        packed.uv0[1] = glm::packHalf1x16(uv.y);
+
+        const glm::vec2 octNormal = encodeOctahedral(normal);
+        packed.normal[0] = toSnorm16(octNormal.x);
+        packed.normal[1] = toSnorm16(octNormal.y);
+
+        const glm::vec2 octTangent = encodeOctahedral(glm::vec3(tangent));
+        packed.tangent[0] = toSnorm16(octTangent.x);
+        packed.tangent[1] = toSnorm16(octTangent.y);
+
+        if(report)
+        {
+            glm::vec3 decodedPos;
+            for(uint32 i = 0; i < 3; i++)
+            {
+                decodedPos[i] = origin[i] + (fromUnorm16(packed.position[i]) * 2.0f - 1.0f) * extents[i];
+            }
+            report->maxPositionError = glm::max(report->maxPositionError,glm::distance(decodedPos,pos));
+
+            const glm::vec2 decodedUv = glm::vec2(glm::unpackHalf1x16(packed.uv0[0]),glm::unpackHalf1x16(packed.uv0[1]));
+            report->maxUvError = glm::max(report->maxUvError,glm::max(std::abs(decodedUv.x - uv.x),std::abs(decodedUv.y - uv.y)));
+
+            // Missing normals and tangents are zero in the source, nothing to compare.
+            if(glm::length(normal) > 1e-8f)
+            {
+                const glm::vec3 decoded = decodeOctahedral(glm::vec2(fromSnorm16(packed.normal[0]),fromSnorm16(packed.normal[1])));
+                report->maxNormalErrorDegrees = glm::max(report->maxNormalErrorDegrees,angleDegrees(decoded,glm::normalize(normal)));
+            }
+
+            if(glm::length(glm::vec3(tangent)) > 1e-8f)
+            {
+                const glm::vec3 decoded = decodeOctahedral(glm::vec2(fromSnorm16(packed.tangent[0]),fromSnorm16(packed.tangent[1])));
+                report->maxTangentErrorDegrees = glm::max(report->maxTangentErrorDegrees,angleDegrees(decoded,glm::normalize(glm::vec3(tangent))));
+            }
+        }
+
+        return packed;
+    }
+}
+
+void quantizeMesh(MeshInfo& info,const std::vector<float>& vertices,const std::vector<VertexIndexType>& indices,QuantizedMesh& out,MeshQuantizationReport* report)
+{
+    const uint32 floatCount = getStandardMeshAttributesVertexCount();
+    CHECK(vertices.size() % floatCount == 0);
+    const uint32 vertexCount = uint32(vertices.size() / floatCount);
+
+    out.vertices.assign(vertexCount,PackedMeshVertex{});
+    out.indices.clear();
+    out.indices16.clear();
+
+    if(report)
+    {
+        *report = {};
+    }
+
+    // NOTE: Positions are quantized inside the bounds of one submesh, a vertex remembers which one.
+    constexpr uint32 kNoOwner = ~0u;
+    std::vector<uint32> owners(vertexCount,kNoOwner);
+    float maxSize = 0.0f;
+
+    for(uint32 subMeshIndex = 0; subMeshIndex < info.subMeshCount; subMeshIndex++)
+    {
+        auto& subMeshInfo = info.subMeshInfos[subMeshIndex];
+        const VertexIndexType* subIndices = indices.data() + subMeshInfo.indexStartPosition;
+        const uint32 indexCount = subMeshInfo.getIndexRangeCount(); // lods reference the same vertices.
+
+        if(indexCount == 0)
+        {
+            subMeshInfo.baseVertex = 0;
+            subMeshInfo.bIndex16 = false;
+            subMeshInfo.indexStartPosition = (uint32)out.indices.size();
+            continue;
+        }
+
+        uint32 minIndex = ~0u;
+        uint32 maxIndex = 0;
+        glm::vec3 minPos = glm::vec3( std::numeric_limits<float>::max());
+        glm::vec3 maxPos = glm::vec3(-std::numeric_limits<float>::max());
+        bool bShared = false;
+        for(uint32 i = 0; i < indexCount; i++)
+        {
+            const uint32 index = subIndices[i];
+            CHECK(index < vertexCount);
+
+            minIndex = glm::min(minIndex,index);
+            maxIndex = glm::max(maxIndex,index);
+
+            const float* v = &vertices[size_t(index) * floatCount];
+            minPos = glm::min(minPos,glm::vec3(v[0],v[1],v[2]));
+            maxPos = glm::max(maxPos,glm::vec3(v[0],v[1],v[2]));
+
+            bShared |= owners[index] != kNoOwner && owners[index] != subMeshIndex;
+        }
+
+        // NOTE: Tight bounds, the shader decodes positions with the render bounds of the submesh.
+        const glm::vec3 origin = (maxPos + minPos) * 0.5f;
+        const glm::vec3 extents = (maxPos - minPos) * 0.5f;
+        for(uint32 i = 0; i < 3; i++)
+        {
+            subMeshInfo.bounds.origin[i] = origin[i];
+            subMeshInfo.bounds.extents[i] = extents[i];
+            maxSize = glm::max(maxSize,extents[i] * 2.0f);
+        }
+        subMeshInfo.bounds.radius = glm::length(extents);
+
+        if(bShared)
+        {
+            // A vertex range already quantized for another submesh gets a private copy in these bounds.
+            subMeshInfo.baseVertex = (uint32)out.vertices.size();
+            for(uint32 index = minIndex; index <= maxIndex; index++)
+            {
+                out.vertices.push_back(packVertex(&vertices[size_t(index) * floatCount],origin,extents,report));
+            }
+
+            if(report)
+            {
+                report->duplicatedVertexCount += maxIndex - minIndex + 1;
+            }
+        }
+        else
+        {
+            subMeshInfo.baseVertex = minIndex;
+            for(uint32 i = 0; i < indexCount; i++)
+            {
+                const uint32 index = subIndices[i];
+                if(owners[index] == kNoOwner)
+                {
+                    owners[index] = subMeshIndex;
+                    out.vertices[index] = packVertex(&vertices[size_t(index) * floatCount],origin,extents,report);
+                }
+            }
+        }
+
+        subMeshInfo.bIndex16 = maxIndex - minIndex <= 0xFFFFu;
+        if(subMeshInfo.bIndex16)
+        {
+            subMeshInfo.indexStartPosition = (uint32)out.indices16.size();
+            for(uint32 i = 0; i < indexCount; i++)
+            {
+                out.indices16.push_back(uint16(subIndices[i] - minIndex));
+            }
+
+            if(report)
+            {
+                report->index16SubMeshCount ++;
+            }
+        }
+        else
+        {
+            subMeshInfo.indexStartPosition = (uint32)out.indices.size();
+            for(uint32 i = 0; i < indexCount; i++)
+            {
+                out.indices.push_back(subIndices[i] - minIndex);
+            }
+        }
+    }
+
+    info.vertCount = (uint32)out.vertices.size();
+    info.attributeLayout = getPackedMeshAttributes();
+
+    if(report)
+    {
+        report->maxPositionErrorRelative = maxSize > 0.0f ? report->maxPositionError / maxSize : 0.0f;
+        report->sourceBytes = uint64(vertices.size()) * sizeof(float) + uint64(indices.size()) * sizeof(VertexIndexType);
+        report->packedBytes = 
+            uint64(out.vertices.size()) * sizeof(PackedMeshVertex) + 
+            uint64(out.indices.size()) * sizeof(VertexIndexType) + 
+            uint64(out.indices16.size()) * sizeof(uint16);
+    }
+}
+
+void buildMeshMeshlets(MeshInfo& info,const std::vector<float>& vertices,std::vector<VertexIndexType>& indices,std::vector<Meshlet>& out)
+{
+    const uint32 floatCount = getStandardMeshAttributesVertexCount();
+    CHECK(vertices.size() % floatCount == 0);
+    const uint32 vertexCount = uint32(vertices.size() / floatCount);
+
+    out.clear();
+
+    std::vector<uint32> subIndices {};
+    std::vector<Meshlet> subMeshlets {};
+    for(auto& subMeshInfo : info.subMeshInfos)
+    {
+        subMeshInfo.meshletStart = (uint32)out.size();
+        subMeshInfo.meshletCount = 0;
+        if(subMeshInfo.indexCount < 3)
+        {
+            continue;
+        }
+
+        const auto begin = indices.begin() + subMeshInfo.indexStartPosition;
+        subIndices.assign(begin,begin + subMeshInfo.indexCount);
+        buildMeshlets(vertices.data(),floatCount,vertexCount,subIndices,subMeshlets);
+
+        // Same triangles in meshlet order, quantizeMesh keeps the order so firstIndex stays valid.
+        std::copy(subIndices.begin(),subIndices.end(),begin);
+        out.insert(out.end(),subMeshlets.begin(),subMeshlets.end());
+        subMeshInfo.meshletCount = (uint32)subMeshlets.size();
+    }
+
+    info.meshletCount = (uint32)out.size();
+}
+
+void buildMeshLevelsOfDetail(MeshInfo& info,const std::vector<float>& vertices,std::vector<VertexIndexType>& indices)
+{
+    const uint32 floatCount = getStandardMeshAttributesVertexCount();
+    CHECK(vertices.size() % floatCount == 0);
+    const uint32 vertexCount = uint32(vertices.size() / floatCount);
+
+    std::vector<VertexIndexType> lodIndices {};
+    lodIndices.reserve(indices.size() * 2);
+
+    std::vector<uint32> subIndices {};
+    for(auto& subMeshInfo : info.subMeshInfos)
+    {
+        CHECK(subMeshInfo.lods.empty());
+
+        const auto begin = indices.begin() + subMeshInfo.indexStartPosition;
+        subIndices.assign(begin,begin + subMeshInfo.indexCount);
+        buildMeshLods(vertices.data(),floatCount,vertexCount,subIndices,subMeshInfo.lods);
+
+        subMeshInfo.indexStartPosition = (uint32)lodIndices.size();
+        lodIndices.insert(lodIndices.end(),subIndices.begin(),subIndices.end());
+    }
+
+    indices.swap(lodIndices);
+}
+
+AssetFile packMesh(MeshInfo* info,const QuantizedMesh& mesh,const MeshQuantizationReport* report,bool compress)
 {
 	AssetFile file;
 
@@ -116,17 +443,19 @@ AssetFile packMesh(MeshInfo* info,char* vertexData,char* indexData,bool compress
 	file.type[1] = 'E';
 	file.type[2] = 'S';
 	file.type[3] = 'H';
-	file.version = 1;
+	file.version = 4;
+	CHECK(info->attributeLayout == getPackedMeshAttributes() && info->vertCount == mesh.vertices.size());
+	CHECK(info->meshletCount == mesh.meshlets.size());
 
 	// meta data 
 	nlohmann::json meshMetadata;
 	meshMetadata["subMeshCount"] = info->subMeshCount;
+	meshMetadata["meshletCount"] = info->meshletCount;
 	meshMetadata["vertexAttributes"] = toString(info->attributeLayout);
 
 	//  subMesh 
 	uint32 vertNum = info->vertCount;
 	meshMetadata["vertNum"] = vertNum;
-	uint32 indicesNum = 0;
 	for(uint32 i = 0; i<info->subMeshCount; i++)
 	{
 		auto& subMeshInfo = info->subMeshInfos[i];
@@ -137,8 +466,24 @@ AssetFile packMesh(MeshInfo* info,char* vertexData,char* indexData,bool compress
 		meshMetadata[subMeshPreStr+"IndexCount"] = subMeshInfo.indexCount;
         meshMetadata[subMeshPreStr+"VertexCount"] = subMeshInfo.vertexCount;
         meshMetadata[subMeshPreStr+"IndexStartPosition"] = subMeshInfo.indexStartPosition;
-        
-		indicesNum += subMeshInfo.indexCount;
+        meshMetadata[subMeshPreStr+"BaseVertex"] = subMeshInfo.baseVertex;
+        meshMetadata[subMeshPreStr+"IndexFormat"] = subMeshInfo.bIndex16 ? 16 : 32;
+        meshMetadata[subMeshPreStr+"MeshletStart"] = subMeshInfo.meshletStart;
+        meshMetadata[subMeshPreStr+"MeshletCount"] = subMeshInfo.meshletCount;
+
+        if(!subMeshInfo.lods.empty())
+        {
+            std::vector<uint32> lodRanges;
+            std::vector<float> lodErrors;
+            for(const auto& lod : subMeshInfo.lods)
+            {
+                lodRanges.push_back(lod.firstIndex);
+                lodRanges.push_back(lod.indexCount);
+                lodErrors.push_back(lod.error);
+            }
+            meshMetadata[subMeshPreStr+"LodRanges"] = lodRanges;
+            meshMetadata[subMeshPreStr+"LodErrors"] = lodErrors;
+        }
 
 		std::vector<float> subBoundsData;
 		subBoundsData.resize(7);
@@ -155,15 +500,34 @@ AssetFile packMesh(MeshInfo* info,char* vertexData,char* indexData,bool compress
 
 	meshMetadata["originalFile"] = info->originalFile;
 
+	if(report)
+	{
+		nlohmann::json quantization;
+		quantization["maxPositionError"] = report->maxPositionError;
+		quantization["maxPositionErrorRelative"] = report->maxPositionErrorRelative;
+		quantization["maxNormalErrorDegrees"] = report->maxNormalErrorDegrees;
+		quantization["maxTangentErrorDegrees"] = report->maxTangentErrorDegrees;
+		quantization["maxUvError"] = report->maxUvError;
+		quantization["index16SubMeshCount"] = report->index16SubMeshCount;
+		quantization["duplicatedVertexCount"] = report->duplicatedVertexCount;
+		quantization["sourceBytes"] = report->sourceBytes;
+		quantization["packedBytes"] = report->packedBytes;
+		meshMetadata["quantization"] = quantization;
+	}
+
 	// ݰÿsubmesh
 	uint32 vertBufferSize = vertNum*getSize(info->attributeLayout);
-	uint32 indicesBufferSize = indicesNum*sizeof(VertexIndexType);
-	uint32 fullSize = vertBufferSize+indicesBufferSize;
+	uint32 indicesBufferSize = uint32(mesh.indices.size()*sizeof(VertexIndexType));
+	uint32 indices16BufferSize = uint32(mesh.indices16.size()*sizeof(uint16));
+	uint32 meshletBufferSize = uint32(mesh.meshlets.size()*sizeof(Meshlet));
+	uint32 fullSize = vertBufferSize+indicesBufferSize+indices16BufferSize+meshletBufferSize;
 	std::vector<char> mergedBuffer;
 	mergedBuffer.resize(fullSize);
 
-	memcpy(mergedBuffer.data(),vertexData,vertBufferSize);
-	memcpy(mergedBuffer.data()+vertBufferSize,indexData,indicesBufferSize);
+	memcpy(mergedBuffer.data(),mesh.vertices.data(),vertBufferSize);
+	memcpy(mergedBuffer.data()+vertBufferSize,mesh.indices.data(),indicesBufferSize);
+	memcpy(mergedBuffer.data()+vertBufferSize+indicesBufferSize,mesh.indices16.data(),indices16BufferSize);
+	memcpy(mergedBuffer.data()+vertBufferSize+indicesBufferSize+indices16BufferSize,mesh.meshlets.data(),meshletBufferSize);
 
 	if(compress)
 	{
@@ -190,21 +554,22 @@ AssetFile packMesh(MeshInfo* info,char* vertexData,char* indexData,bool compress
 	return file;
 }
 
-void unpackMesh(MeshInfo* info,const char* sourcebuffer,size_t sourceSize,std::vector<float>& vertexBufer,std::vector<VertexIndexType>& indexBuffer)
+void unpackMesh(MeshInfo* info,const char* sourcebuffer,size_t sourceSize,QuantizedMesh& out)
 {
 	uint32 indicesCount = 0;
+	uint32 indices16Count = 0;
 	for(auto& subInfo:info->subMeshInfos)
 	{
-		indicesCount += subInfo.indexCount;
+		(subInfo.bIndex16 ? indices16Count : indicesCount) += subInfo.getIndexRangeCount();
 	}
-	indexBuffer.resize(indicesCount);
-	vertexBufer.resize(info->vertCount * getCount(info->attributeLayout));
 
 	uint32 vertBufferSize = info->vertCount*getSize(info->attributeLayout);
 	uint32 indicesBufferSize = indicesCount*sizeof(VertexIndexType);
+	uint32 indices16BufferSize = indices16Count*sizeof(uint16);
+	uint32 meshletBufferSize = info->meshletCount*sizeof(Meshlet);
 
 	std::vector<char> packBuffer;
-	packBuffer.resize(vertBufferSize+indicesBufferSize);
+	packBuffer.resize(vertBufferSize+indicesBufferSize+indices16BufferSize+meshletBufferSize);
 
 	if(info->compressMode==ECompressMode::LZ4)
 	{
@@ -220,8 +585,32 @@ void unpackMesh(MeshInfo* info,const char* sourcebuffer,size_t sourceSize,std::v
 		memcpy(packBuffer.data(),sourcebuffer,sourceSize);
 	}
 
-	memcpy((char*)vertexBufer.data(),packBuffer.data(),vertBufferSize);
-	memcpy((char*)indexBuffer.data(),packBuffer.data()+vertBufferSize,indicesBufferSize);
+	if(info->attributeLayout == getPackedMeshAttributes())
+	{
+		out.vertices.resize(info->vertCount);
+		out.indices.resize(indicesCount);
+		out.indices16.resize(indices16Count);
+		out.meshlets.resize(info->meshletCount);
+
+		memcpy((char*)out.vertices.data(),packBuffer.data(),vertBufferSize);
+		memcpy((char*)out.indices.data(),packBuffer.data()+vertBufferSize,indicesBufferSize);
+		memcpy((char*)out.indices16.data(),packBuffer.data()+vertBufferSize+indicesBufferSize,indices16BufferSize);
+		memcpy((char*)out.meshlets.data(),packBuffer.data()+vertBufferSize+indicesBufferSize+indices16BufferSize,meshletBufferSize);
+	}
+	else
+	{
+		// NOTE: Float mesh baked before quantization, bake it again to skip this.
+		CHECK(info->attributeLayout == getStandardMeshAttributes() && indices16Count == 0);
+
+		std::vector<float> vertices(info->vertCount * getCount(info->attributeLayout));
+		std::vector<VertexIndexType> indices(indicesCount);
+		memcpy((char*)vertices.data(),packBuffer.data(),vertBufferSize);
+		memcpy((char*)indices.data(),packBuffer.data()+vertBufferSize,indicesBufferSize);
+
+		buildMeshMeshlets(*info,vertices,indices,out.meshlets);
+		quantizeMesh(*info,vertices,indices,out);
+		LOG_INFO("Mesh {0} is not quantized, quantized and clustered at load. Bake it again for lods.",info->originalFile);
+	}
 }
 
 struct AssimpModelProcess
@@ -482,12 +871,66 @@ bool bakeAssimpMesh(const char* pathIn,const char* pathOut,bool compress)
         vertices.push_back(vertex.tangent.z);
         vertices.push_back(vertex.tangent.w);
     }
-    asset_system::AssetFile newMesh = asset_system::packMesh(
-        &info,
-        (char*)vertices.data(),
-        (char*)processor.m_indices.data(),
-        compress
+
+    QuantizedMesh quantized {};
+    buildMeshMeshlets(info,vertices,processor.m_indices,quantized.meshlets);
+
+    uint32 meshletTriangleCount = 0;
+    for(const auto& meshlet : quantized.meshlets)
+    {
+        meshletTriangleCount += meshlet.indexCount / 3;
+    }
+    LOG_INFO("Mesh {0} split into {1} meshlets, {2} triangles per meshlet on average.",
+        pathIn,
+        info.meshletCount,
+        info.meshletCount > 0 ? float(meshletTriangleCount) / float(info.meshletCount) : 0.0f
+    );
+
+    buildMeshLevelsOfDetail(info,vertices,processor.m_indices);
+
+    std::array<uint64,MESH_MAX_LOD_COUNT> lodTriangleCounts {};
+    std::array<float,MESH_MAX_LOD_COUNT> lodMaxErrors {};
+    uint32 lodCount = 0;
+    for(const auto& subMeshInfo : info.subMeshInfos)
+    {
+        // A submesh with a shorter chain draws its last level at the coarser ones.
+        for(uint32 lod = 0; lod < MESH_MAX_LOD_COUNT; lod++)
+        {
+            const auto& level = subMeshInfo.lods[glm::min(lod,(uint32)subMeshInfo.lods.size() - 1)];
+            lodTriangleCounts[lod] += level.indexCount / 3;
+            lodMaxErrors[lod] = glm::max(lodMaxErrors[lod],level.error);
+        }
+        lodCount = glm::max(lodCount,(uint32)subMeshInfo.lods.size());
+    }
+
+    LOG_INFO("Mesh {0} has {1} lods, errors are relative to the submesh radius.",pathIn,lodCount);
+    for(uint32 lod = 0; lod < lodCount; lod++)
+    {
+        LOG_INFO("  Lod #{0}: {1} triangles ({2}%), max error {3}.",
+            lod,
+            lodTriangleCounts[lod],
+            lodTriangleCounts[0] > 0 ? 100.0f * float(lodTriangleCounts[lod]) / float(lodTriangleCounts[0]) : 0.0f,
+            lodMaxErrors[lod]);
+    }
+
+    MeshQuantizationReport report {};
+    quantizeMesh(info,vertices,processor.m_indices,quantized,&report);
+
+    LOG_INFO("Mesh {0} quantized {1} kb -> {2} kb. Max error: position {3} ({4}% of the largest submesh), normal {5} deg, tangent {6} deg, uv {7}. {8}/{9} submeshes use 16 bit indices, {10} vertices duplicated.",
+        pathIn,
+        report.sourceBytes / 1024,
+        report.packedBytes / 1024,
+        report.maxPositionError,
+        report.maxPositionErrorRelative * 100.0f,
+        report.maxNormalErrorDegrees,
+        report.maxTangentErrorDegrees,
+        report.maxUvError,
+        report.index16SubMeshCount,
+        info.subMeshCount,
+        report.duplicatedVertexCount
     );
+
+    asset_system::AssetFile newMesh = asset_system::packMesh(&info,quantized,&report,compress);
     bool res = asset_system::saveBinFile(pathOut,newMesh);
 
     std::string pathMtl = engine::FileSystem::getFileRawName(pathIn) + ".mtl";
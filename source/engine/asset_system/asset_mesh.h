@@ -19,24 +19,83 @@ struct MeshInfo
         std::string materialPath;
         MeshBounds bounds = {};
         uint32 indexCount; 
-        uint32 indexStartPosition;
+        uint32 indexStartPosition; // in the index stream of its width.
         uint32 vertexCount;
+
+        // NOTE: Indices are relative to baseVertex, 16 bit when the submesh reaches less than 65536 vertices.
+        uint32 baseVertex = 0;
+        bool bIndex16 = false;
+
+        // NOTE: Range in the meshlets of the mesh, the meshlets cover the indices of the submesh in order.
+        uint32 meshletStart = 0;
+        uint32 meshletCount = 0;
+
+        // NOTE: lods[0] is the full level over indexCount, the simplified levels follow it in the index
+        //       range of the submesh. Empty until buildMeshLevelsOfDetail, one level for old meshes.
+        std::vector<MeshLod> lods = {};
+
+        // Indices of the submesh in its index stream, every lod included.
+        uint32 getIndexRangeCount() const
+        {
+            return lods.empty() ? indexCount : lods.back().firstIndex + lods.back().indexCount;
+        }
     };
 
     uint32 subMeshCount = 0;
     std::vector<SubMeshInfo> subMeshInfos = {};
     uint32 vertCount;
+    uint32 meshletCount = 0;
     std::vector<EVertexAttribute> attributeLayout = {};
 
     ECompressMode compressMode;
     std::string originalFile;
 };
 
+// NOTE: Static mesh data in the gpu layout, see PackedMeshVertex.
+struct QuantizedMesh
+{
+    std::vector<PackedMeshVertex> vertices = {};
+    std::vector<VertexIndexType> indices = {};
+    std::vector<uint16> indices16 = {};
+    std::vector<Meshlet> meshlets = {};
+};
+
+// NOTE: Worst error of the quantization against the float source, logged at bake time and kept in the asset.
+struct MeshQuantizationReport
+{
+    float maxPositionError = 0.0f;         // object space.
+    float maxPositionErrorRelative = 0.0f; // of the largest submesh extent.
+    float maxNormalErrorDegrees = 0.0f;
+    float maxTangentErrorDegrees = 0.0f;
+    float maxUvError = 0.0f;
+
+    uint32 index16SubMeshCount = 0;
+    uint32 duplicatedVertexCount = 0;      // vertices shared by submeshes get one copy per submesh bounds.
+
+    uint64 sourceBytes = 0;
+    uint64 packedBytes = 0;
+};
+
 extern int32 getSize(const std::vector<EVertexAttribute>& layouts);
 extern int32 getCount(const std::vector<EVertexAttribute>& layouts);
 extern MeshInfo readMeshInfo(AssetFile* file);
-extern AssetFile packMesh(MeshInfo* info,char* vertexData,char* indexData,bool compress = true);
-extern void unpackMesh(MeshInfo* info, const char* sourcebuffer,size_t sourceSize, std::vector<float>& vertexBufer, std::vector<VertexIndexType>& indexBuffer);
+
+// NOTE: vertices are in the standard layout and indices relative to the mesh. Submesh bounds, base vertex,
+//       index width and index start of info are rewritten, the bounds fit the referenced vertices exactly.
+extern void quantizeMesh(MeshInfo& info,const std::vector<float>& vertices,const std::vector<VertexIndexType>& indices,QuantizedMesh& out,MeshQuantizationReport* report = nullptr);
+
+// NOTE: Splits every submesh into meshlets before quantizeMesh, indices is reordered in place so each meshlet
+//       is a contiguous index range. Meshlet range of the submeshes and the meshlet count of info are written.
+extern void buildMeshMeshlets(MeshInfo& info,const std::vector<float>& vertices,std::vector<VertexIndexType>& indices,std::vector<Meshlet>& out);
+
+// NOTE: Simplified levels of every submesh after buildMeshMeshlets, see buildMeshLods. indices is rebuilt with
+//       the levels of a submesh after its full level, index start and lods of the submeshes are written.
+extern void buildMeshLevelsOfDetail(MeshInfo& info,const std::vector<float>& vertices,std::vector<VertexIndexType>& indices);
+
+extern AssetFile packMesh(MeshInfo* info,const QuantizedMesh& mesh,const MeshQuantizationReport* report = nullptr,bool compress = true);
+
+// NOTE: Meshes baked before quantization are quantized here.
+extern void unpackMesh(MeshInfo* info,const char* sourcebuffer,size_t sourceSize,QuantizedMesh& out);
 
 extern bool bakeAssimpMesh(const char* pathIn,const char* pathOut,bool compress = true);
 }}
\ No newline at end of file
@@ -1,11 +1,10 @@
 #include <stdexcept>
 #include <string>
 #include <array>
-#include "../core/file_system.h"
-#include "unicode.h"
 #include <iostream>
 #include <fstream>
-#include <string>
+#include <filesystem>
+#include <type_traits>
 #include "asset_pmx.h"
 #include "../core/file_system.h"
 
@@ -13,90 +12,219 @@ using namespace engine::asset_system;
 
 constexpr bool print_debug = true;
 
-void read_string(PMXFile* pmx, std::string* val,std::ifstream& file,std::u16string* string_16 = nullptr)
+namespace {
+
+// NOTE: Cursor over the whole file in memory. Every read is bounds checked, a truncated or corrupt
+//       file flips m_bOk instead of reading past the end, and later reads become no-ops.
+class PMXReader
 {
-	uint32_t buf_size;
-	// 1. ȡbufferС
-	file.read((char*)&buf_size,sizeof(uint32_t));
+public:
+	PMXReader(const uint8_t* data,size_t size) : m_data(data),m_size(size) { }
 
-	if(buf_size>0)
+	template<typename T>
+	bool read(T& v)
 	{
-		if(pmx->m_header.m_encode==0)
+		static_assert(std::is_trivially_copyable_v<T>);
+		if(!m_bOk || m_size - m_pos < sizeof(T))
 		{
-			// utf-16
-			std::u16string utf16_str(buf_size/2,u'\0');
-			file.read((char*)&utf16_str[0],sizeof(utf16_str[0])*utf16_str.size());
+			m_bOk = false;
+			memset(&v,0,sizeof(T));
+			return false;
+		}
+		memcpy(&v,m_data + m_pos,sizeof(T));
+		m_pos += sizeof(T);
+		return true;
+	}
 
-			if(string_16!=nullptr)
-			{
-				*string_16 = utf16_str;
-			}
+	// glm vectors may be padded with aligned gentypes, the file stores tightly packed floats.
+	template<glm::length_t N,glm::qualifier Q>
+	bool read(glm::vec<N,float,Q>& v)
+	{
+		const uint8_t* src = readBytes(sizeof(float) * N);
+		if(src == nullptr) return false;
+		memcpy(&v[0],src,sizeof(float) * N);
+		return true;
+	}
 
-			engine::asset_system::unicode::ConvU16ToU8(utf16_str,*val);
-		}
-		else if(pmx->m_header.m_encode==1)
+	bool read(glm::quat& q)
+	{
+		const uint8_t* src = readBytes(sizeof(float) * 4);
+		if(src == nullptr) return false;
+		memcpy(&q[0],src,sizeof(float) * 4);
+		return true;
+	}
+
+	const uint8_t* readBytes(size_t size)
+	{
+		if(!m_bOk || m_size - m_pos < size)
 		{
-			// utf-8
-			std::string utf8_str(buf_size,'\0');
-			file.read((char*)&utf8_str[0],sizeof(utf8_str[0])*buf_size);
-			*val = utf8_str;
+			m_bOk = false;
+			return nullptr;
 		}
-		else
+		const uint8_t* ptr = m_data + m_pos;
+		m_pos += size;
+		return ptr;
+	}
+
+	// NOTE: Counts come from the file, reject the ones the rest of the file can't hold before
+	//       anything is reserved for them.
+	bool readCount(int32_t& count,size_t minElementSize)
+	{
+		if(!read(count)) return false;
+		if(count < 0 || uint64_t(count) * minElementSize > remaining())
 		{
-			LOG_IO_ERROR("unknown PMX encode formatEncode = {0}",pmx->m_header.m_encode);
+			m_bOk = false;
+			count = 0;
+			return false;
 		}
+		return true;
 	}
-}
 
-void read_index(int32_t* index,uint8_t index_size,std::ifstream& file)
-{
-	switch(index_size)
+	bool readIndex(int32_t& index,uint8_t indexSize)
 	{
-	case 1:
-	{
-		uint8_t idx;
-		file.read((char*)&idx,sizeof(uint8_t));
-		if(idx!=0xFF)
+		switch(indexSize)
+		{
+		case 1:
 		{
-			*index = (int32_t)idx;
+			uint8_t idx;
+			read(idx);
+			index = idx != 0xFF ? (int32_t)idx : -1;
 		}
-		else
+		break;
+		case 2:
+		{
+			uint16_t idx;
+			read(idx);
+			index = idx != 0xFFFF ? (int32_t)idx : -1;
+		}
+		break;
+		case 4:
 		{
-			*index = -1;
+			uint32_t idx;
+			read(idx);
+			index = (int32_t)idx;
 		}
+		break;
+		default:
+			LOG_IO_ERROR("PMXС{0}",indexSize);
+			m_bOk = false;
+			index = -1;
+		}
+		return m_bOk;
 	}
-	break;
-	case 2:
+
+	// NOTE: Utf-16 strings are converted straight from the file buffer, most pmx strings are ascii
+	//       or a few kana so the output is sized once and only trimmed at the end.
+	bool readString(uint8_t encode,std::string& str,std::u16string* u16str = nullptr)
 	{
-		uint16_t idx;
-		file.read((char*)&idx,sizeof(uint16_t));
-		if(idx!=0xFFFF)
+		uint32_t size;
+		if(!read(size)) return false;
+		const uint8_t* src = readBytes(size);
+		if(src == nullptr) return false;
+
+		if(encode == 0)
+		{
+			const size_t length = size / 2;
+			if(u16str != nullptr)
+			{
+				u16str->resize(length);
+				memcpy(u16str->data(),src,length * sizeof(char16_t));
+			}
+			convertU16ToU8(src,length,str);
+		}
+		else if(encode == 1)
 		{
-			*index = (int32_t)idx;
+			str.assign((const char*)src,size);
 		}
 		else
 		{
-			*index = -1;
+			LOG_IO_ERROR("unknown PMX encode formatEncode = {0}",encode);
+			m_bOk = false;
 		}
+		return m_bOk;
 	}
-	break;
-	case 4:
+
+	void fail() { m_bOk = false; }
+
+	size_t remaining() const { return m_size - m_pos; }
+	bool ok() const { return m_bOk; }
+
+private:
+	static void convertU16ToU8(const uint8_t* src,size_t length,std::string& str)
 	{
-		uint32_t idx;
-		file.read((char*)&idx,sizeof(uint32_t));
-		*index = (int32_t)idx;
-	}
-	break;
-	default:
-		LOG_IO_ERROR("PMXС{0}",index_size);
-		return;
+		str.resize(length * 3);
+		char* dst = str.data();
+		size_t out = 0;
+		for(size_t i = 0; i < length; i++)
+		{
+			uint32_t ch = uint32_t(src[i * 2]) | (uint32_t(src[i * 2 + 1]) << 8);
+			if(ch < 0x80)
+			{
+				dst[out++] = (char)ch;
+				continue;
+			}
+
+			if(ch >= 0xD800 && ch < 0xDC00 && i + 1 < length)
+			{
+				const uint32_t low = uint32_t(src[i * 2 + 2]) | (uint32_t(src[i * 2 + 3]) << 8);
+				if(low >= 0xDC00 && low < 0xE000)
+				{
+					ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+					i++;
+				}
+			}
+			if(ch >= 0xD800 && ch < 0xE000)
+			{
+				ch = 0xFFFD; // unpaired surrogate.
+			}
+
+			// 4 byte sequences come from two utf-16 units, 6 bytes of room.
+			if(ch < 0x800)
+			{
+				dst[out++] = char(0xC0 | (ch >> 6));
+				dst[out++] = char(0x80 | (ch & 0x3F));
+			}
+			else if(ch < 0x10000)
+			{
+				dst[out++] = char(0xE0 | (ch >> 12));
+				dst[out++] = char(0x80 | ((ch >> 6) & 0x3F));
+				dst[out++] = char(0x80 | (ch & 0x3F));
+			}
+			else
+			{
+				dst[out++] = char(0xF0 | (ch >> 18));
+				dst[out++] = char(0x80 | ((ch >> 12) & 0x3F));
+				dst[out++] = char(0x80 | ((ch >> 6) & 0x3F));
+				dst[out++] = char(0x80 | (ch & 0x3F));
+			}
+		}
+		str.resize(out);
 	}
+
+private:
+	const uint8_t* m_data;
+	size_t m_size;
+	size_t m_pos = 0;
+	bool m_bOk = true;
+};
+
+bool read_string(PMXFile* pmx,std::string* val,PMXReader& file,std::u16string* string_16 = nullptr)
+{
+	return file.readString(pmx->m_header.m_encode,*val,string_16);
 }
 
-void read_vertex(PMXFile* pmx,std::ifstream& file)
+bool read_vertex(PMXFile* pmx,PMXReader& file)
 {
+	const auto& header = pmx->m_header;
+
+	// position, normal, uv, add uv, weight type, one bone index and the edge scale.
+	const size_t minVertexSize = sizeof(float) * (9 + 4 * header.m_addUVNum) + 1 + header.m_boneIndexSize;
+
 	int32_t vertex_count;
-	file.read((char*)&vertex_count,sizeof(int32_t));
+	if(!file.readCount(vertex_count,minVertexSize))
+	{
+		return false;
+	}
 	if constexpr(print_debug)
 	{
 		LOG_IO_TRACE("vertex count: {0}",vertex_count);
@@ -107,123 +235,132 @@ void read_vertex(PMXFile* pmx,std::ifstream& file)
 
 	for(auto& vertex:vertices)
 	{
-		file.read((char*)&vertex.m_position[0],sizeof(float)*3);
-		file.read((char*)&vertex.m_normal[0],sizeof(float)*3);
-		file.read((char*)&vertex.m_uv[0],sizeof(float)*2);
+		file.read(vertex.m_position);
+		file.read(vertex.m_normal);
+		file.read(vertex.m_uv);
 
-		for(uint8_t i = 0; i<pmx->m_header.m_addUVNum; i++)
+		for(uint8_t i = 0; i<header.m_addUVNum; i++)
 		{
-			file.read((char*)&vertex.m_addUV[i][0],sizeof(float)*4);
+			file.read(vertex.m_addUV[i]);
 		}
 
-		file.read((char*)&vertex.m_weightType,sizeof(uint8_t));
+		file.read(vertex.m_weightType);
 
 		switch(vertex.m_weightType)
 		{
 		case PMXVertexWeight::BDEF1:
-			read_index(&vertex.m_boneIndices[0],pmx->m_header.m_boneIndexSize,file);
+			file.readIndex(vertex.m_boneIndices[0],header.m_boneIndexSize);
 			break;
 		case PMXVertexWeight::BDEF2:
-			read_index(&vertex.m_boneIndices[0],pmx->m_header.m_boneIndexSize,file);
-			read_index(&vertex.m_boneIndices[1],pmx->m_header.m_boneIndexSize,file);
-			file.read((char*)&vertex.m_boneWeights[0],sizeof(float));
+			file.readIndex(vertex.m_boneIndices[0],header.m_boneIndexSize);
+			file.readIndex(vertex.m_boneIndices[1],header.m_boneIndexSize);
+			file.read(vertex.m_boneWeights[0]);
 			break;
 		case PMXVertexWeight::BDEF4:
-			read_index(&vertex.m_boneIndices[0],pmx->m_header.m_boneIndexSize,file);
-			read_index(&vertex.m_boneIndices[1],pmx->m_header.m_boneIndexSize,file);
-			read_index(&vertex.m_boneIndices[2],pmx->m_header.m_boneIndexSize,file);
-			read_index(&vertex.m_boneIndices[3],pmx->m_header.m_boneIndexSize,file);
-			file.read((char*)&vertex.m_boneWeights[0],sizeof(float));
-			file.read((char*)&vertex.m_boneWeights[1],sizeof(float));
-			file.read((char*)&vertex.m_boneWeights[2],sizeof(float));
-			file.read((char*)&vertex.m_boneWeights[3],sizeof(float));
+		case PMXVertexWeight::QDEF:
+			file.readIndex(vertex.m_boneIndices[0],header.m_boneIndexSize);
+			file.readIndex(vertex.m_boneIndices[1],header.m_boneIndexSize);
+			file.readIndex(vertex.m_boneIndices[2],header.m_boneIndexSize);
+			file.readIndex(vertex.m_boneIndices[3],header.m_boneIndexSize);
+			file.read(vertex.m_boneWeights);
 			break;
 		case PMXVertexWeight::SDEF:
-			read_index(&vertex.m_boneIndices[0],pmx->m_header.m_boneIndexSize,file);
-			read_index(&vertex.m_boneIndices[1],pmx->m_header.m_boneIndexSize,file);
-			file.read((char*)&vertex.m_boneWeights[0],sizeof(float));
-			file.read((char*)&vertex.m_sdefC[0],sizeof(float)*3);
-			file.read((char*)&vertex.m_sdefR0[0],sizeof(float)*3);
-			file.read((char*)&vertex.m_sdefR1[0],sizeof(float)*3);
-			break;
-		case PMXVertexWeight::QDEF:
-			read_index(&vertex.m_boneIndices[0],pmx->m_header.m_boneIndexSize,file);
-			read_index(&vertex.m_boneIndices[1],pmx->m_header.m_boneIndexSize,file);
-			read_index(&vertex.m_boneIndices[2],pmx->m_header.m_boneIndexSize,file);
-			read_index(&vertex.m_boneIndices[3],pmx->m_header.m_boneIndexSize,file);
-			file.read((char*)&vertex.m_boneWeights[0],sizeof(float));
-			file.read((char*)&vertex.m_boneWeights[1],sizeof(float));
-			file.read((char*)&vertex.m_boneWeights[2],sizeof(float));
-			file.read((char*)&vertex.m_boneWeights[3],sizeof(float));
+			file.readIndex(vertex.m_boneIndices[0],header.m_boneIndexSize);
+			file.readIndex(vertex.m_boneIndices[1],header.m_boneIndexSize);
+			file.read(vertex.m_boneWeights[0]);
+			file.read(vertex.m_sdefC);
+			file.read(vertex.m_sdefR0);
+			file.read(vertex.m_sdefR1);
 			break;
 		default:
 			LOG_IO_ERROR("δ֪PMXʽ{0}.",vertex.m_weightType);
-			return;
-			break;
+			return false;
 		}
-		file.read((char*)&vertex.m_edgeMag,sizeof(float));
+		file.read(vertex.m_edgeMag);
 	}
+	return file.ok();
 }
 
-void read_face(PMXFile* pmx,std::ifstream& file)
+bool read_face(PMXFile* pmx,PMXReader& file)
 {
-	int32_t face_count;
-	file.read((char*)&face_count,sizeof(int32_t));
-	face_count /= 3;
+	const uint8_t indexSize = pmx->m_header.m_vertexIndexSize;
+	if(indexSize != 1 && indexSize != 2 && indexSize != 4)
+	{
+		LOG_IO_ERROR("δ֪PMX: {0}",indexSize);
+		return false;
+	}
+
+	int32_t index_count;
+	if(!file.readCount(index_count,indexSize))
+	{
+		return false;
+	}
+	const int32_t face_count = index_count / 3;
 	if constexpr(print_debug)
 	{
 		LOG_IO_TRACE("face count: {0}",face_count);
 	}
 
+	// the whole index block in one go, a trailing partial face is skipped.
+	const uint8_t* src = file.readBytes(size_t(index_count) * indexSize);
+	if(src == nullptr)
+	{
+		return false;
+	}
+	const size_t indexCount = size_t(face_count) * 3;
+
 	pmx->m_faces.resize(face_count);
-	switch(pmx->m_header.m_vertexIndexSize)
+	switch(indexSize)
 	{
 	case 1:
 	{
-		std::vector<uint8_t> vertices(face_count*3);
-		file.read((char*)vertices.data(),sizeof(uint8_t)*vertices.size());
-		for(int32_t faceIdx = 0; faceIdx<face_count; faceIdx++)
+		for(size_t i = 0; i<indexCount; i++)
 		{
-			pmx->m_faces[faceIdx].m_vertices[0] = vertices[faceIdx*3+0];
-			pmx->m_faces[faceIdx].m_vertices[1] = vertices[faceIdx*3+1];
-			pmx->m_faces[faceIdx].m_vertices[2] = vertices[faceIdx*3+2];
+			pmx->m_faces[i / 3].m_vertices[i % 3] = src[i];
 		}
 	}
 	break;
 	case 2:
 	{
-		std::vector<uint16_t> vertices(face_count*3);
-		file.read((char*)vertices.data(),sizeof(uint16_t)*vertices.size());
-		for(int32_t faceIdx = 0; faceIdx<face_count; faceIdx++)
+		for(size_t i = 0; i<indexCount; i++)
 		{
-			pmx->m_faces[faceIdx].m_vertices[0] = vertices[faceIdx*3+0];
-			pmx->m_faces[faceIdx].m_vertices[1] = vertices[faceIdx*3+1];
-			pmx->m_faces[faceIdx].m_vertices[2] = vertices[faceIdx*3+2];
+			uint16_t idx;
+			memcpy(&idx,src + i * 2,sizeof(uint16_t));
+			pmx->m_faces[i / 3].m_vertices[i % 3] = idx;
 		}
 	}
 	break;
 	case 4:
 	{
-		std::vector<uint32_t> vertices(face_count*3);
-		file.read((char*)vertices.data(),sizeof(uint32_t)*vertices.size());
-		for(int32_t faceIdx = 0; faceIdx<face_count; faceIdx++)
-		{
-			pmx->m_faces[faceIdx].m_vertices[0] = vertices[faceIdx*3+0];
-			pmx->m_faces[faceIdx].m_vertices[1] = vertices[faceIdx*3+1];
-			pmx->m_faces[faceIdx].m_vertices[2] = vertices[faceIdx*3+2];
-		}
+		static_assert(sizeof(PMXFace) == sizeof(uint32_t) * 3);
+		memcpy(pmx->m_faces.data(),src,indexCount * sizeof(uint32_t));
 	}
 	break;
-	default:
-		LOG_IO_ERROR("δ֪PMX: {0}",pmx->m_header.m_vertexIndexSize);
-		return;
 	}
+
+	// vertices are read before the faces, an index past them would read out of the vertex buffer.
+	const size_t vertexCount = pmx->m_vertices.size();
+	for(const auto& face : pmx->m_faces)
+	{
+		for(auto vertex : face.m_vertices)
+		{
+			if(size_t(vertex) >= vertexCount)
+			{
+				LOG_IO_ERROR("PMX face index {0} is out of the {1} vertices.",vertex,vertexCount);
+				return false;
+			}
+		}
+	}
+	return true;
 }
 
-void read_texture(PMXFile* pmx,std::ifstream& file)
+bool read_texture(PMXFile* pmx,PMXReader& file)
 {
 	int32_t texture_count;
-	file.read((char*)&texture_count,sizeof(int32_t));
+	if(!file.readCount(texture_count,sizeof(uint32_t)))
+	{
+		return false;
+	}
 	if constexpr(print_debug)
 	{
 		LOG_IO_TRACE("texture count: {0}",texture_count);
@@ -239,12 +376,16 @@ void read_texture(PMXFile* pmx,std::ifstream& file)
 			LOG_IO_TRACE("texture name: {0}",tex.m_textureName);
 		}
 	}
+	return file.ok();
 }
 
-void read_material(PMXFile* pmx,std::ifstream& file)
+bool read_material(PMXFile* pmx,PMXReader& file)
 {
 	int32_t mat_count;
-	file.read((char*)&mat_count,sizeof(int32_t));
+	if(!file.readCount(mat_count,sizeof(uint32_t) * 3))
+	{
+		return false;
+	}
 	if constexpr(print_debug)
 	{
 		LOG_IO_TRACE("material count: {0}",mat_count);
@@ -261,45 +402,49 @@ void read_material(PMXFile* pmx,std::ifstream& file)
 			LOG_IO_TRACE("material english name: {0}",mat.m_englishName);
 		}
 
-		file.read((char*)&mat.m_diffuse[0],sizeof(float)*4);
-		file.read((char*)&mat.m_specular[0],sizeof(float)*3);
-		file.read((char*)&mat.m_specularPower,sizeof(float));
-		file.read((char*)&mat.m_ambient[0],sizeof(float)*3);
-		file.read((char*)&mat.m_drawMode,sizeof(uint8_t));
-		file.read((char*)&mat.m_edgeColor[0],sizeof(float)*4);
-		file.read((char*)&mat.m_edgeSize,sizeof(float));
+		file.read(mat.m_diffuse);
+		file.read(mat.m_specular);
+		file.read(mat.m_specularPower);
+		file.read(mat.m_ambient);
+		file.read(mat.m_drawMode);
+		file.read(mat.m_edgeColor);
+		file.read(mat.m_edgeSize);
 
-		read_index(&mat.m_textureIndex,pmx->m_header.m_textureIndexSize,file);
-		read_index(&mat.m_sphereTextureIndex,pmx->m_header.m_textureIndexSize,file);
+		file.readIndex(mat.m_textureIndex,pmx->m_header.m_textureIndexSize);
+		file.readIndex(mat.m_sphereTextureIndex,pmx->m_header.m_textureIndexSize);
 
-		file.read((char*)&mat.m_sphereMode,sizeof(uint8_t));
-		file.read((char*)&mat.m_toonMode,sizeof(uint8_t));
+		file.read(mat.m_sphereMode);
+		file.read(mat.m_toonMode);
 
 		if(mat.m_toonMode==PMXToonMode::Separate)
 		{
-			read_index(&mat.m_toonTextureIndex,pmx->m_header.m_textureIndexSize,file);
+			file.readIndex(mat.m_toonTextureIndex,pmx->m_header.m_textureIndexSize);
 		}
 		else if(mat.m_toonMode==PMXToonMode::Common)
 		{
 			uint8_t toonIndex;
-			file.read((char*)&toonIndex,sizeof(uint8_t));
+			file.read(toonIndex);
 			mat.m_toonTextureIndex = (int32_t)toonIndex;
 		}
 		else
 		{
 			LOG_IO_ERROR("δ֪PMX Toon Mode:{0}",mat.m_toonMode);
-			return;
+			return false;
 		}
 
 		read_string(pmx,&mat.m_memo,file);
-		file.read((char*)&mat.m_numFaceVertices,sizeof(int32_t));
+		file.read(mat.m_numFaceVertices);
 	}
+	return file.ok();
 }
 
-void read_bone(PMXFile* pmx,std::ifstream& file)
+bool read_bone(PMXFile* pmx,PMXReader& file)
 {
 	int32_t boneCount;
-	file.read((char*)&boneCount,sizeof(int32_t));
+	if(!file.readCount(boneCount,sizeof(uint32_t) * 2 + sizeof(float) * 3 + sizeof(int32_t) + sizeof(uint16_t)))
+	{
+		return false;
+	}
 	if constexpr(print_debug)
 	{
 		LOG_IO_TRACE("bone count: {0}",boneCount);
@@ -313,73 +458,84 @@ void read_bone(PMXFile* pmx,std::ifstream& file)
 		// bone.m_u16name = unicode::ConvertSjisToU16String(bone.m_name.c_str());
 		read_string(pmx,&bone.m_englishName,file);
 
-		file.read((char*)&bone.m_position[0],sizeof(float)*3);
-		read_index(&bone.m_parentBoneIndex,pmx->m_header.m_boneIndexSize,file);
+		file.read(bone.m_position);
+		file.readIndex(bone.m_parentBoneIndex,pmx->m_header.m_boneIndexSize);
 
-		file.read((char*)&bone.m_deformDepth,sizeof(int32_t));
-		file.read((char*)&bone.m_boneFlag,sizeof(uint16_t));
+		file.read(bone.m_deformDepth);
+		file.read(bone.m_boneFlag);
 
 		if(((uint16_t)bone.m_boneFlag&(uint16_t)PMXBoneFlags::TargetShowMode)==0)
 		{
-			file.read((char*)&bone.m_positionOffset[0],sizeof(float)*3);
+			file.read(bone.m_positionOffset);
 		}
 		else
 		{
-			read_index(&bone.m_linkBoneIndex,pmx->m_header.m_boneIndexSize,file);
+			file.readIndex(bone.m_linkBoneIndex,pmx->m_header.m_boneIndexSize);
 		}
 
 		if(((uint16_t)bone.m_boneFlag&(uint16_t)PMXBoneFlags::AppendRotate)||
 			((uint16_t)bone.m_boneFlag&(uint16_t)PMXBoneFlags::AppendTranslate))
 		{
-			read_index(&bone.m_appendBoneIndex,pmx->m_header.m_boneIndexSize,file);
+			file.readIndex(bone.m_appendBoneIndex,pmx->m_header.m_boneIndexSize);
 
-			file.read((char*)&bone.m_appendWeight,sizeof(float));
+			file.read(bone.m_appendWeight);
 		}
 
 		if((uint16_t)bone.m_boneFlag&(uint16_t)PMXBoneFlags::FixedAxis)
 		{
-			file.read((char*)&bone.m_fixedAxis[0],sizeof(float)*3);
+			file.read(bone.m_fixedAxis);
 		}
 
 		if((uint16_t)bone.m_boneFlag&(uint16_t)PMXBoneFlags::LocalAxis)
 		{
-			file.read((char*)&bone.m_localXAxis[0],sizeof(float)*3);
-			file.read((char*)&bone.m_localZAxis[0],sizeof(float)*3);
+			file.read(bone.m_localXAxis);
+			file.read(bone.m_localZAxis);
 		}
 
 		if((uint16_t)bone.m_boneFlag&(uint16_t)PMXBoneFlags::DeformOuterParent)
 		{
-			file.read((char*)&bone.m_keyValue,sizeof(int32_t));
+			file.read(bone.m_keyValue);
 		}
 
 		if((uint16_t)bone.m_boneFlag&(uint16_t)PMXBoneFlags::IK)
 		{
-			read_index(&bone.m_ikTargetBoneIndex,pmx->m_header.m_boneIndexSize,file);
-			file.read((char*)&bone.m_ikIterationCount,sizeof(int32_t));
-			file.read((char*)&bone.m_ikLimit,sizeof(float));
+			file.readIndex(bone.m_ikTargetBoneIndex,pmx->m_header.m_boneIndexSize);
+			file.read(bone.m_ikIterationCount);
+			file.read(bone.m_ikLimit);
 
 			int32_t linkCount;
-			file.read((char*)&linkCount,sizeof(int32_t));
+			file.readCount(linkCount,size_t(pmx->m_header.m_boneIndexSize) + 1);
 			bone.m_ikLinks.resize(linkCount);
 			for(auto& ikLink:bone.m_ikLinks)
 			{
-				read_index(&ikLink.m_ikBoneIndex,pmx->m_header.m_boneIndexSize,file);
-				file.read((char*)&ikLink.m_enableLimit,sizeof(unsigned char));
+				file.readIndex(ikLink.m_ikBoneIndex,pmx->m_header.m_boneIndexSize);
+				file.read(ikLink.m_enableLimit);
 
 				if(ikLink.m_enableLimit!=0)
 				{
-					file.read((char*)&ikLink.m_limitMin,sizeof(float)*3);
-					file.read((char*)&ikLink.m_limitMax,sizeof(float)*3);
+					file.read(ikLink.m_limitMin);
+					file.read(ikLink.m_limitMax);
 				}
 			}
 		}
+
+		if(!file.ok())
+		{
+			return false;
+		}
 	}
+	return true;
 }
 
-void read_morph(PMXFile* pmx,std::ifstream& file)
+bool read_morph(PMXFile* pmx,PMXReader& file)
 {
+	const auto& header = pmx->m_header;
+
 	int32_t morphCount;
-	file.read((char*)&morphCount,sizeof(int32_t));
+	if(!file.readCount(morphCount,sizeof(uint32_t) * 3 + 2))
+	{
+		return false;
+	}
 	if constexpr(print_debug)
 	{
 		LOG_IO_TRACE("morph count: {0}",morphCount);
@@ -391,19 +547,30 @@ void read_morph(PMXFile* pmx,std::ifstream& file)
 		read_string(pmx,&morph.m_name,file);
 		read_string(pmx,&morph.m_englishName,file);
 
-		file.read((char*)&morph.m_controlPanel,sizeof(uint8_t));
-		file.read((char*)&morph.m_morphType,sizeof(uint8_t));
+		file.read(morph.m_controlPanel);
+		file.read(morph.m_morphType);
 
 		int32_t dataCount;
-		file.read((char*)&dataCount,sizeof(int32_t));
+		file.read(dataCount);
+		if(!file.ok() || dataCount < 0)
+		{
+			return false;
+		}
+
+		// every morph type stores at least one index and one float per element.
+		if(size_t(dataCount) * (1 + sizeof(float)) > file.remaining())
+		{
+			LOG_IO_ERROR("PMX MorphԽ:[{0}]",morph.m_name);
+			return false;
+		}
 
 		if(morph.m_morphType==PMXMorphType::Position)
 		{
 			morph.m_positionMorph.resize(dataCount);
 			for(auto& data:morph.m_positionMorph)
 			{
-				read_index(&data.m_vertexIndex,pmx->m_header.m_vertexIndexSize,file);
-				file.read((char*)&data.m_position[0],sizeof(float)*3);
+				file.readIndex(data.m_vertexIndex,header.m_vertexIndexSize);
+				file.read(data.m_position);
 			}
 		}
 		else if(morph.m_morphType==PMXMorphType::UV||
@@ -416,8 +583,8 @@ void read_morph(PMXFile* pmx,std::ifstream& file)
 			morph.m_uvMorph.resize(dataCount);
 			for(auto& data:morph.m_uvMorph)
 			{
-				read_index(&data.m_vertexIndex,pmx->m_header.m_vertexIndexSize,file);
-				file.read((char*)&data.m_uv[0],sizeof(float)*4);
+				file.readIndex(data.m_vertexIndex,header.m_vertexIndexSize);
+				file.read(data.m_uv);
 			}
 		}
 		else if(morph.m_morphType==PMXMorphType::Bone)
@@ -425,9 +592,9 @@ void read_morph(PMXFile* pmx,std::ifstream& file)
 			morph.m_boneMorph.resize(dataCount);
 			for(auto& data:morph.m_boneMorph)
 			{
-				read_index(&data.m_boneIndex,pmx->m_header.m_boneIndexSize,file);
-				file.read((char*)&data.m_position[0],sizeof(float)*3);
-				file.read((char*)&data.m_quaternion[0],sizeof(float)*4);
+				file.readIndex(data.m_boneIndex,header.m_boneIndexSize);
+				file.read(data.m_position);
+				file.read(data.m_quaternion);
 			}
 		}
 		else if(morph.m_morphType==PMXMorphType::Material)
@@ -435,18 +602,18 @@ void read_morph(PMXFile* pmx,std::ifstream& file)
 			morph.m_materialMorph.resize(dataCount);
 			for(auto& data:morph.m_materialMorph)
 			{
-				read_index(&data.m_materialIndex,pmx->m_header.m_materialIndexSize,file);
-
-				file.read((char*)&data.m_opType,sizeof(uint8_t));
-				file.read((char*)&data.m_diffuse,sizeof(float)*4);
-				file.read((char*)&data.m_specular,sizeof(float)*3);
-				file.read((char*)&data.m_specularPower,sizeof(float));
-				file.read((char*)&data.m_ambient,sizeof(float)*3);
-				file.read((char*)&data.m_edgeColor,sizeof(float)*4);
-				file.read((char*)&data.m_edgeSize,sizeof(float));
-				file.read((char*)&data.m_textureFactor,sizeof(float)*4);
-				file.read((char*)&data.m_sphereTextureFactor,sizeof(float)*4);
-				file.read((char*)&data.m_toonTextureFactor,sizeof(float)*4);
+				file.readIndex(data.m_materialIndex,header.m_materialIndexSize);
+
+				file.read(data.m_opType);
+				file.read(data.m_diffuse);
+				file.read(data.m_specular);
+				file.read(data.m_specularPower);
+				file.read(data.m_ambient);
+				file.read(data.m_edgeColor);
+				file.read(data.m_edgeSize);
+				file.read(data.m_textureFactor);
+				file.read(data.m_sphereTextureFactor);
+				file.read(data.m_toonTextureFactor);
 			}
 		}
 		else if(morph.m_morphType==PMXMorphType::Group)
@@ -454,8 +621,8 @@ void read_morph(PMXFile* pmx,std::ifstream& file)
 			morph.m_groupMorph.resize(dataCount);
 			for(auto& data:morph.m_groupMorph)
 			{
-				read_index(&data.m_morphIndex,pmx->m_header.m_morphIndexSize,file);
-				file.read((char*)&data.m_weight,sizeof(float));
+				file.readIndex(data.m_morphIndex,header.m_morphIndexSize);
+				file.read(data.m_weight);
 			}
 		}
 		else if(morph.m_morphType==PMXMorphType::Flip)
@@ -463,8 +630,8 @@ void read_morph(PMXFile* pmx,std::ifstream& file)
 			morph.m_flipMorph.resize(dataCount);
 			for(auto& data:morph.m_flipMorph)
 			{
-				read_index(&data.m_morphIndex,pmx->m_header.m_morphIndexSize,file);
-				file.read((char*)&data.m_weight,sizeof(float));
+				file.readIndex(data.m_morphIndex,header.m_morphIndexSize);
+				file.read(data.m_weight);
 			}
 		}
 		else if(morph.m_morphType==PMXMorphType::Impluse)
@@ -472,119 +639,140 @@ void read_morph(PMXFile* pmx,std::ifstream& file)
 			morph.m_impulseMorph.resize(dataCount);
 			for(auto& data:morph.m_impulseMorph)
 			{
-				read_index(&data.m_rigidbodyIndex,pmx->m_header.m_rigidbodyIndexSize,file);
-				file.read((char*)&data.m_localFlag,sizeof(uint8_t));
-				file.read((char*)&data.m_translateVelocity,sizeof(float)*3);
-				file.read((char*)&data.m_rotateTorque,sizeof(float)*3);
+				file.readIndex(data.m_rigidbodyIndex,header.m_rigidbodyIndexSize);
+				file.read(data.m_localFlag);
+				file.read(data.m_translateVelocity);
+				file.read(data.m_rotateTorque);
 			}
 		}
 		else
 		{
 			LOG_IO_ERROR("ֵ֧PMX Morph:[{0}]",(int)morph.m_morphType);
-			return;
+			return false;
+		}
+
+		if(!file.ok())
+		{
+			return false;
 		}
 	}
+	return true;
 }
 
-void read_display_frame(PMXFile* pmx,std::ifstream& file)
+bool read_display_frame(PMXFile* pmx,PMXReader& file)
 {
 	int32_t displayFrameCount;
-	file.read((char*)&displayFrameCount,sizeof(int32_t));
+	if(!file.readCount(displayFrameCount,sizeof(uint32_t) * 3 + 1))
+	{
+		return false;
+	}
 	pmx->m_displayFrames.resize(displayFrameCount);
 	for(auto& displayFrame:pmx->m_displayFrames)
 	{
 		read_string(pmx,&displayFrame.m_name,file);
 		read_string(pmx,&displayFrame.m_englishName,file);
-		file.read((char*)&displayFrame.m_flag,sizeof(uint8_t));
+		file.read(displayFrame.m_flag);
 
 		int32_t targetCount;
-		file.read((char*)&targetCount,sizeof(int32_t));
+		if(!file.readCount(targetCount,2))
+		{
+			return false;
+		}
 		displayFrame.m_targets.resize(targetCount);
 
 		for(auto& target:displayFrame.m_targets)
 		{
-			file.read((char*)&target.m_type,sizeof(uint8_t));
+			file.read(target.m_type);
 
 			if(target.m_type==PMXDispalyFrame::TargetType::BoneIndex)
 			{
-				read_index(&target.m_index,pmx->m_header.m_boneIndexSize,file);
+				file.readIndex(target.m_index,pmx->m_header.m_boneIndexSize);
 			}
 			else if(target.m_type==PMXDispalyFrame::TargetType::MorphIndex)
 			{
-				read_index(&target.m_index,pmx->m_header.m_morphIndexSize,file);
+				file.readIndex(target.m_index,pmx->m_header.m_morphIndexSize);
 			}
 			else
 			{
 				LOG_IO_ERROR("δ֪PMX֡:{0}",(int32_t)target.m_type);
-				return;
+				return false;
 			}
 		}
 	}
+	return file.ok();
 }
 
-void read_rigidbody(PMXFile* pmx,std::ifstream& file)
+bool read_rigidbody(PMXFile* pmx,PMXReader& file)
 {
 	int32_t rbCount;
-	file.read((char*)&rbCount,sizeof(int32_t));
+	if(!file.readCount(rbCount,sizeof(uint32_t) * 2 + sizeof(float) * 14))
+	{
+		return false;
+	}
 	pmx->m_rigidbodies.resize(rbCount);
 	for(auto& rb:pmx->m_rigidbodies)
 	{
 		read_string(pmx,&rb.m_name,file);
 		read_string(pmx,&rb.m_englishName,file);
-		read_index(&rb.m_boneIndex,pmx->m_header.m_boneIndexSize,file);
-
-		file.read((char*)&rb.m_group,sizeof(uint8_t));
-		file.read((char*)&rb.m_collisionGroup,sizeof(uint16_t));
-		file.read((char*)&rb.m_shape,sizeof(uint8_t));
-		file.read((char*)&rb.m_shapeSize[0],sizeof(float)*3);
-		file.read((char*)&rb.m_translate[0],sizeof(float)*3);
-		file.read((char*)&rb.m_rotate[0],sizeof(float)*3);
-		file.read((char*)&rb.m_mass,sizeof(float));
-		file.read((char*)&rb.m_translateDimmer,sizeof(float));
-		file.read((char*)&rb.m_rotateDimmer,sizeof(float));
-		file.read((char*)&rb.m_repulsion,sizeof(float));
-		file.read((char*)&rb.m_friction,sizeof(float));
-		file.read((char*)&rb.m_op,sizeof(uint8_t));
+		file.readIndex(rb.m_boneIndex,pmx->m_header.m_boneIndexSize);
+
+		file.read(rb.m_group);
+		file.read(rb.m_collisionGroup);
+		file.read(rb.m_shape);
+		file.read(rb.m_shapeSize);
+		file.read(rb.m_translate);
+		file.read(rb.m_rotate);
+		file.read(rb.m_mass);
+		file.read(rb.m_translateDimmer);
+		file.read(rb.m_rotateDimmer);
+		file.read(rb.m_repulsion);
+		file.read(rb.m_friction);
+		file.read(rb.m_op);
 	}
+	return file.ok();
 }
 
-void read_joint(PMXFile* pmx,std::ifstream& file)
+bool read_joint(PMXFile* pmx,PMXReader& file)
 {
 	int32_t jointCount;
-	file.read((char*)&jointCount,sizeof(int32_t));
+	if(!file.readCount(jointCount,sizeof(uint32_t) * 2 + sizeof(float) * 24))
+	{
+		return false;
+	}
 	pmx->m_joints.resize(jointCount);
 	for(auto& joint:pmx->m_joints)
 	{
 		read_string(pmx,&joint.m_name,file);
 		read_string(pmx,&joint.m_englishName,file);
 
-		file.read((char*)&joint.m_type,sizeof(uint8_t));
-		read_index(&joint.m_rigidbodyAIndex,pmx->m_header.m_rigidbodyIndexSize,file);
-		read_index(&joint.m_rigidbodyBIndex,pmx->m_header.m_rigidbodyIndexSize,file);
+		file.read(joint.m_type);
+		file.readIndex(joint.m_rigidbodyAIndex,pmx->m_header.m_rigidbodyIndexSize);
+		file.readIndex(joint.m_rigidbodyBIndex,pmx->m_header.m_rigidbodyIndexSize);
 
-		file.read((char*)&joint.m_translate[0],sizeof(float)*3);
-		file.read((char*)&joint.m_rotate[0],sizeof(float)*3);
+		file.read(joint.m_translate);
+		file.read(joint.m_rotate);
 
-		file.read((char*)&joint.m_translateLowerLimit[0],sizeof(float)*3);
-		file.read((char*)&joint.m_translateUpperLimit[0],sizeof(float)*3);
-		file.read((char*)&joint.m_rotateLowerLimit[0],sizeof(float)*3);
-		file.read((char*)&joint.m_rotateUpperLimit[0],sizeof(float)*3);
+		file.read(joint.m_translateLowerLimit);
+		file.read(joint.m_translateUpperLimit);
+		file.read(joint.m_rotateLowerLimit);
+		file.read(joint.m_rotateUpperLimit);
 
-		file.read((char*)&joint.m_springTranslateFactor[0],sizeof(float)*3);
-		file.read((char*)&joint.m_springRotateFactor[0],sizeof(float)*3);
+		file.read(joint.m_springTranslateFactor);
+		file.read(joint.m_springRotateFactor);
 	}
+	return file.ok();
 }
 
-void read_soft_body(PMXFile* pmx,std::ifstream& file)
+bool read_soft_body(PMXFile* pmx,PMXReader& file)
 {
 	int32_t sbCount;
-	file.read((char*)&sbCount,sizeof(int32_t));
+	file.read(sbCount);
 	// if(sbCount<=0)
 	{
 		// todo: fix me.
 
 		// pmx 2.1 adapt.
-		return;
+		return true;
 	}
 	pmx->m_softbodies.resize(sbCount);
 	for(auto& sb:pmx->m_softbodies)
@@ -592,100 +780,137 @@ void read_soft_body(PMXFile* pmx,std::ifstream& file)
 		read_string(pmx,&sb.m_name,file);
 		read_string(pmx,&sb.m_englishName,file);
 
-		file.read((char*)&sb.m_type,sizeof(uint8_t));
+		file.read(sb.m_type);
 
-		read_index(&sb.m_materialIndex,pmx->m_header.m_materialIndexSize,file);
+		file.readIndex(sb.m_materialIndex,pmx->m_header.m_materialIndexSize);
 
-		file.read((char*)&sb.m_group,sizeof(uint8_t));
-		file.read((char*)&sb.m_collisionGroup,sizeof(uint16_t));
+		file.read(sb.m_group);
+		file.read(sb.m_collisionGroup);
 
-		file.read((char*)&sb.m_flag,sizeof(uint8_t));
+		file.read(sb.m_flag);
 
-		file.read((char*)&sb.m_BLinkLength,sizeof(int32_t));
-		file.read((char*)&sb.m_numClusters,sizeof(int32_t));
+		file.read(sb.m_BLinkLength);
+		file.read(sb.m_numClusters);
 
-		file.read((char*)&sb.m_totalMass,sizeof(float));
-		file.read((char*)&sb.m_collisionMargin,sizeof(float));
+		file.read(sb.m_totalMass);
+		file.read(sb.m_collisionMargin);
 
-		file.read((char*)&sb.m_aeroModel,sizeof(int32_t));
+		file.read(sb.m_aeroModel);
 
-		file.read((char*)&sb.m_VCF,sizeof(float));
-		file.read((char*)&sb.m_DP,sizeof(float));
-		file.read((char*)&sb.m_DG,sizeof(float));
-		file.read((char*)&sb.m_LF,sizeof(float));
-		file.read((char*)&sb.m_PR,sizeof(float));
-		file.read((char*)&sb.m_VC,sizeof(float));
-		file.read((char*)&sb.m_DF,sizeof(float));
-		file.read((char*)&sb.m_MT,sizeof(float));
-		file.read((char*)&sb.m_CHR,sizeof(float));
-		file.read((char*)&sb.m_KHR,sizeof(float));
-		file.read((char*)&sb.m_SHR,sizeof(float));
-		file.read((char*)&sb.m_AHR,sizeof(float));
+		file.read(sb.m_VCF);
+		file.read(sb.m_DP);
+		file.read(sb.m_DG);
+		file.read(sb.m_LF);
+		file.read(sb.m_PR);
+		file.read(sb.m_VC);
+		file.read(sb.m_DF);
+		file.read(sb.m_MT);
+		file.read(sb.m_CHR);
+		file.read(sb.m_KHR);
+		file.read(sb.m_SHR);
+		file.read(sb.m_AHR);
 
-		file.read((char*)&sb.m_SRHR_CL,sizeof(float));
-		file.read((char*)&sb.m_SKHR_CL,sizeof(float));
-		file.read((char*)&sb.m_SSHR_CL,sizeof(float));
-		file.read((char*)&sb.m_SR_SPLT_CL,sizeof(float));
-		file.read((char*)&sb.m_SK_SPLT_CL,sizeof(float));
-		file.read((char*)&sb.m_SS_SPLT_CL,sizeof(float));
+		file.read(sb.m_SRHR_CL);
+		file.read(sb.m_SKHR_CL);
+		file.read(sb.m_SSHR_CL);
+		file.read(sb.m_SR_SPLT_CL);
+		file.read(sb.m_SK_SPLT_CL);
+		file.read(sb.m_SS_SPLT_CL);
 
-		file.read((char*)&sb.m_V_IT,sizeof(int32_t));
-		file.read((char*)&sb.m_P_IT,sizeof(int32_t));
-		file.read((char*)&sb.m_D_IT,sizeof(int32_t));
-		file.read((char*)&sb.m_C_IT,sizeof(int32_t));
+		file.read(sb.m_V_IT);
+		file.read(sb.m_P_IT);
+		file.read(sb.m_D_IT);
+		file.read(sb.m_C_IT);
 
-		file.read((char*)&sb.m_LST,sizeof(float));
-		file.read((char*)&sb.m_AST,sizeof(float));
-		file.read((char*)&sb.m_VST,sizeof(float));
+		file.read(sb.m_LST);
+		file.read(sb.m_AST);
+		file.read(sb.m_VST);
 
 		int32_t arCount;
-		file.read((char*)&arCount,sizeof(int32_t));
+		file.readCount(arCount,size_t(pmx->m_header.m_rigidbodyIndexSize) + pmx->m_header.m_vertexIndexSize + 1);
 		sb.m_anchorRigidbodies.resize(arCount);
 
 		for(auto& ar:sb.m_anchorRigidbodies)
 		{
-			read_index(&ar.m_rigidBodyIndex,pmx->m_header.m_rigidbodyIndexSize,file);
-			read_index(&ar.m_vertexIndex,pmx->m_header.m_vertexIndexSize,file);
-			file.read((char*)&ar.m_nearMode,sizeof(uint8_t));
+			file.readIndex(ar.m_rigidBodyIndex,pmx->m_header.m_rigidbodyIndexSize);
+			file.readIndex(ar.m_vertexIndex,pmx->m_header.m_vertexIndexSize);
+			file.read(ar.m_nearMode);
 		}
 
 		int32_t pvCount;
-		file.read((char*)&pvCount,sizeof(int32_t));
+		file.readCount(pvCount,pmx->m_header.m_vertexIndexSize);
 		sb.m_pinVertexIndices.resize(pvCount);
 		for(auto& pv:sb.m_pinVertexIndices)
 		{
-			read_index(&pv,pmx->m_header.m_vertexIndexSize,file);
+			file.readIndex(pv,pmx->m_header.m_vertexIndexSize);
 		}
 	}
+	return file.ok();
+}
+
 }
 
 bool engine::asset_system::ReadPMXFile(PMXFile* pmx_file,const char* filename)
 {
-	std::ifstream infile;
-	infile.open(filename,std::ios::binary);
-
+	// NOTE: One read of the whole file, parsing then only walks memory.
+	std::ifstream infile(filename,std::ios::binary | std::ios::ate);
 	if(!infile.is_open())
 	{
-		LOG_IO_FATAL("ļ{0}ʧܣ",filename);
+		LOG_IO_ERROR("ļ{0}ʧܣ",filename);
+		return false;
+	}
+
+	const std::streamsize size = infile.tellg();
+	if(size <= 0)
+	{
+		LOG_IO_ERROR("ļ{0}Ϊգ",filename);
 		return false;
 	}
 
+	std::vector<uint8_t> data((size_t)size);
 	infile.seekg(0);
+	if(!infile.read((char*)data.data(),size))
+	{
+		LOG_IO_ERROR("ļ{0}ȡʧܣ",filename);
+		return false;
+	}
+	infile.close();
+
 	LOG_IO_INFO("Reading Pmx file {0}.",filename);
+	if(!ReadPMXFile(pmx_file,data.data(),data.size()))
+	{
+		LOG_IO_ERROR("Pmx file {0} is truncated or corrupt.",filename);
+		return false;
+	}
+	return true;
+}
+
+bool engine::asset_system::ReadPMXFile(PMXFile* pmx_file,const uint8_t* data,size_t size)
+{
+	PMXReader infile(data,size);
 
 	// 0.ȡheader
 	auto& header = pmx_file->m_header;
-	infile.read(header.m_magic,4);
-	infile.read((char*)&header.m_version,sizeof(float));
-	infile.read((char*)&header.m_dataSize,sizeof(uint8_t));
-	infile.read((char*)&header.m_encode,sizeof(uint8_t));
-	infile.read((char*)&header.m_addUVNum,sizeof(uint8_t));
-	infile.read((char*)&header.m_vertexIndexSize,sizeof(uint8_t));
-	infile.read((char*)&header.m_textureIndexSize,sizeof(uint8_t));
-	infile.read((char*)&header.m_materialIndexSize,sizeof(uint8_t));
-	infile.read((char*)&header.m_boneIndexSize,sizeof(uint8_t));
-	infile.read((char*)&header.m_morphIndexSize,sizeof(uint8_t));
-	infile.read((char*)&header.m_rigidbodyIndexSize,sizeof(uint8_t));
+	const uint8_t* magic = infile.readBytes(4);
+	if(magic == nullptr || memcmp(magic,"PMX ",4) != 0)
+	{
+		return false;
+	}
+	memcpy(header.m_magic,magic,4);
+	infile.read(header.m_version);
+	infile.read(header.m_dataSize);
+	infile.read(header.m_encode);
+	infile.read(header.m_addUVNum);
+	infile.read(header.m_vertexIndexSize);
+	infile.read(header.m_textureIndexSize);
+	infile.read(header.m_materialIndexSize);
+	infile.read(header.m_boneIndexSize);
+	infile.read(header.m_morphIndexSize);
+	infile.read(header.m_rigidbodyIndexSize);
+	if(!infile.ok() || header.m_addUVNum > 4)
+	{
+		return false;
+	}
 	if constexpr(print_debug)
 	{
 		LOG_IO_TRACE("Header Info {0}",header.get_header());
@@ -697,6 +922,10 @@ bool engine::asset_system::ReadPMXFile(PMXFile* pmx_file,const char* filename)
 	read_string(pmx_file,&info.m_englishModelName,infile);
 	read_string(pmx_file,&info.m_comment,infile);
 	read_string(pmx_file,&info.m_englishComment,infile);
+	if(!infile.ok())
+	{
+		return false;
+	}
 	if constexpr(print_debug)
 	{
 		LOG_IO_TRACE("Model Name: {0}",info.m_modelName);
@@ -706,38 +935,440 @@ bool engine::asset_system::ReadPMXFile(PMXFile* pmx_file,const char* filename)
 	}
 
 	// 2. ȡ vertex
-	read_vertex(pmx_file,infile);
-
 	// 3. ȡ face
-	read_face(pmx_file,infile);
-
 	// 4. ȡ pmx 
-	read_texture(pmx_file,infile);
-
 	// 5. ȡ
-	read_material(pmx_file,infile);
-
 	// 6. ȡ
-	read_bone(pmx_file,infile);
-
 	// 7. ȡƤϢ
-	read_morph(pmx_file,infile);
+	if(!read_vertex(pmx_file,infile) ||
+		!read_face(pmx_file,infile) ||
+		!read_texture(pmx_file,infile) ||
+		!read_material(pmx_file,infile) ||
+		!read_bone(pmx_file,infile) ||
+		!read_morph(pmx_file,infile))
+	{
+		return false;
+	}
 
 	// 8. ȡFrameϢ
-	read_display_frame(pmx_file,infile);
-
 	// 9. ȡ
-	read_rigidbody(pmx_file,infile);
-
 	// 10. ȡؽ
-	read_joint(pmx_file,infile);
+	if(!read_display_frame(pmx_file,infile) ||
+		!read_rigidbody(pmx_file,infile) ||
+		!read_joint(pmx_file,infile))
+	{
+		return false;
+	}
 
 	// 11. ȡ壨PMX2.1
-	if(infile.good())
+	if(infile.remaining() >= sizeof(int32_t))
 	{
 		read_soft_body(pmx_file,infile);
 	}
 
+	return true;
+}
+
+namespace {
+
+// NOTE: Cooked layout (little endian, same build only):
+//       PMXCookedHeader, source path, then every section of PMXFile in file order. Trivially copyable
+//       elements are stored as one block per vector, strings as uint32 size and chars.
+//       Soft bodies are never parsed, see read_soft_body, so they are not stored either.
+namespace pmxCooked
+{
+	constexpr uint32_t MAGIC   = 0x43584D50; // "PMXC"
+	constexpr uint32_t VERSION = 1;
+}
+
+struct PMXCookedHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceSize;
+	int64_t  sourceTime;
+	uint32_t vertexSize; // sizeof(PMXVertex), differs between builds with other glm settings.
+	uint32_t materialMorphSize;
+};
+static_assert(std::is_trivially_copyable_v<PMXCookedHeader>);
+
+bool getSourceStamp(const char* sourceFilename,uint64_t& size,int64_t& time)
+{
+	std::error_code ec;
+	const std::filesystem::path path(sourceFilename);
+	size = (uint64_t)std::filesystem::file_size(path,ec);
+	if(ec) return false;
+	time = (int64_t)std::filesystem::last_write_time(path,ec).time_since_epoch().count();
+	return !ec;
+}
+
+PMXCookedHeader makeCookedHeader(uint64_t sourceSize,int64_t sourceTime)
+{
+	PMXCookedHeader header {};
+	header.magic = pmxCooked::MAGIC;
+	header.version = pmxCooked::VERSION;
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+	header.vertexSize = sizeof(PMXVertex);
+	header.materialMorphSize = sizeof(PMXMorph::MaterialMorph);
+	return header;
+}
+
+class PMXCookedWriter
+{
+public:
+	std::vector<uint8_t> data;
+
+	template<typename T>
+	void operator()(const T& v)
+	{
+		if constexpr(std::is_trivially_copyable_v<T>)
+		{
+			writeBytes(&v,sizeof(T));
+		}
+		else
+		{
+			transfer(*this,const_cast<T&>(v));
+		}
+	}
+
+	template<typename CharT>
+	void operator()(const std::basic_string<CharT>& str)
+	{
+		(*this)(uint32_t(str.size()));
+		writeBytes(str.data(),str.size() * sizeof(CharT));
+	}
+
+	template<typename T>
+	void operator()(const std::vector<T>& vec)
+	{
+		(*this)(uint32_t(vec.size()));
+		if constexpr(std::is_trivially_copyable_v<T>)
+		{
+			writeBytes(vec.data(),vec.size() * sizeof(T));
+		}
+		else
+		{
+			for(const auto& v : vec)
+			{
+				(*this)(v);
+			}
+		}
+	}
+
+private:
+	void writeBytes(const void* src,size_t size)
+	{
+		const size_t pos = data.size();
+		data.resize(pos + size);
+		memcpy(data.data() + pos,src,size);
+	}
+};
+
+class PMXCookedReader
+{
+public:
+	PMXCookedReader(const uint8_t* data,size_t size) : m_reader(data,size) { }
+
+	template<typename T>
+	void operator()(T& v)
+	{
+		if constexpr(std::is_trivially_copyable_v<T>)
+		{
+			// raw bytes as written, glm vectors keep their in memory size here.
+			const uint8_t* src = m_reader.readBytes(sizeof(T));
+			if(src != nullptr) memcpy(&v,src,sizeof(T));
+		}
+		else
+		{
+			transfer(*this,v);
+		}
+	}
+
+	template<typename CharT>
+	void operator()(std::basic_string<CharT>& str)
+	{
+		uint32_t size;
+		m_reader.read(size);
+		const uint8_t* src = m_reader.readBytes(size_t(size) * sizeof(CharT));
+		if(src == nullptr) return;
+		str.resize(size);
+		memcpy(str.data(),src,size_t(size) * sizeof(CharT));
+	}
+
+	template<typename T>
+	void operator()(std::vector<T>& vec)
+	{
+		uint32_t size;
+		m_reader.read(size);
+
+		// every element takes at least one byte, so a corrupt size fails before the resize.
+		if(!m_reader.ok() || size > m_reader.remaining())
+		{
+			m_reader.fail();
+			return;
+		}
+
+		if constexpr(std::is_trivially_copyable_v<T>)
+		{
+			const uint8_t* src = m_reader.readBytes(size_t(size) * sizeof(T));
+			if(src == nullptr) return;
+			vec.resize(size);
+			memcpy(vec.data(),src,size_t(size) * sizeof(T));
+		}
+		else
+		{
+			vec.resize(size);
+			for(auto& v : vec)
+			{
+				(*this)(v);
+			}
+		}
+	}
+
+	bool ok() const { return m_reader.ok(); }
+
+private:
+	PMXReader m_reader;
+};
+
+template<typename Archive>
+void transfer(Archive& ar,PMXInfo& info)
+{
+	ar(info.m_modelName);
+	ar(info.m_englishModelName);
+	ar(info.m_comment);
+	ar(info.m_englishComment);
+}
+
+template<typename Archive>
+void transfer(Archive& ar,PMXTexture& tex)
+{
+	ar(tex.m_textureName);
+}
+
+template<typename Archive>
+void transfer(Archive& ar,PMXMaterial& mat)
+{
+	ar(mat.m_name);
+	ar(mat.m_englishName);
+	ar(mat.m_diffuse);
+	ar(mat.m_specular);
+	ar(mat.m_specularPower);
+	ar(mat.m_ambient);
+	ar(mat.m_drawMode);
+	ar(mat.m_edgeColor);
+	ar(mat.m_edgeSize);
+	ar(mat.m_textureIndex);
+	ar(mat.m_sphereTextureIndex);
+	ar(mat.m_sphereMode);
+	ar(mat.m_toonMode);
+	ar(mat.m_toonTextureIndex);
+	ar(mat.m_memo);
+	ar(mat.m_numFaceVertices);
+}
+
+template<typename Archive>
+void transfer(Archive& ar,PMXBone& bone)
+{
+	ar(bone.m_name);
+	ar(bone.m_u16name);
+	ar(bone.m_englishName);
+	ar(bone.m_position);
+	ar(bone.m_parentBoneIndex);
+	ar(bone.m_deformDepth);
+	ar(bone.m_boneFlag);
+	ar(bone.m_positionOffset);
+	ar(bone.m_linkBoneIndex);
+	ar(bone.m_appendBoneIndex);
+	ar(bone.m_appendWeight);
+	ar(bone.m_fixedAxis);
+	ar(bone.m_localXAxis);
+	ar(bone.m_localZAxis);
+	ar(bone.m_keyValue);
+	ar(bone.m_ikTargetBoneIndex);
+	ar(bone.m_ikIterationCount);
+	ar(bone.m_ikLimit);
+	ar(bone.m_ikLinks);
+}
+
+template<typename Archive>
+void transfer(Archive& ar,PMXMorph& morph)
+{
+	ar(morph.m_name);
+	ar(morph.m_englishName);
+	ar(morph.m_controlPanel);
+	ar(morph.m_morphType);
+	ar(morph.m_positionMorph);
+	ar(morph.m_uvMorph);
+	ar(morph.m_boneMorph);
+	ar(morph.m_materialMorph);
+	ar(morph.m_groupMorph);
+	ar(morph.m_flipMorph);
+	ar(morph.m_impulseMorph);
+}
+
+template<typename Archive>
+void transfer(Archive& ar,PMXDispalyFrame& displayFrame)
+{
+	ar(displayFrame.m_name);
+	ar(displayFrame.m_englishName);
+	ar(displayFrame.m_flag);
+	ar(displayFrame.m_targets);
+}
+
+template<typename Archive>
+void transfer(Archive& ar,PMXRigidbody& rb)
+{
+	ar(rb.m_name);
+	ar(rb.m_englishName);
+	ar(rb.m_boneIndex);
+	ar(rb.m_group);
+	ar(rb.m_collisionGroup);
+	ar(rb.m_shape);
+	ar(rb.m_shapeSize);
+	ar(rb.m_translate);
+	ar(rb.m_rotate);
+	ar(rb.m_mass);
+	ar(rb.m_translateDimmer);
+	ar(rb.m_rotateDimmer);
+	ar(rb.m_repulsion);
+	ar(rb.m_friction);
+	ar(rb.m_op);
+}
+
+template<typename Archive>
+void transfer(Archive& ar,PMXJoint& joint)
+{
+	ar(joint.m_name);
+	ar(joint.m_englishName);
+	ar(joint.m_type);
+	ar(joint.m_rigidbodyAIndex);
+	ar(joint.m_rigidbodyBIndex);
+	ar(joint.m_translate);
+	ar(joint.m_rotate);
+	ar(joint.m_translateLowerLimit);
+	ar(joint.m_translateUpperLimit);
+	ar(joint.m_rotateLowerLimit);
+	ar(joint.m_rotateUpperLimit);
+	ar(joint.m_springTranslateFactor);
+	ar(joint.m_springRotateFactor);
+}
+
+template<typename Archive>
+void transfer(Archive& ar,PMXFile& pmx)
+{
+	ar(pmx.m_header);
+	ar(pmx.m_info);
+	ar(pmx.m_vertices);
+	ar(pmx.m_faces);
+	ar(pmx.m_textures);
+	ar(pmx.m_materials);
+	ar(pmx.m_bones);
+	ar(pmx.m_morphs);
+	ar(pmx.m_displayFrames);
+	ar(pmx.m_rigidbodies);
+	ar(pmx.m_joints);
+}
+
+}
+
+bool engine::asset_system::ReadCookedPMXFile(PMXFile* pmx_file,const char* cacheFilename,const char* sourceFilename)
+{
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if(!getSourceStamp(sourceFilename,sourceSize,sourceTime))
+	{
+		return false;
+	}
+
+	std::ifstream infile(cacheFilename,std::ios::binary | std::ios::ate);
+	if(!infile.is_open())
+	{
+		return false;
+	}
+
+	const std::streamsize size = infile.tellg();
+	if(size < (std::streamsize)sizeof(PMXCookedHeader))
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> data((size_t)size);
+	infile.seekg(0);
+	if(!infile.read((char*)data.data(),size))
+	{
+		return false;
+	}
 	infile.close();
+
+	// stale or written by another build, the caller parses the source and cooks it again.
+	PMXCookedHeader header;
+	memcpy(&header,data.data(),sizeof(PMXCookedHeader));
+	const PMXCookedHeader expected = makeCookedHeader(sourceSize,sourceTime);
+	if(memcmp(&header,&expected,sizeof(PMXCookedHeader)) != 0)
+	{
+		return false;
+	}
+
+	PMXCookedReader reader(data.data() + sizeof(PMXCookedHeader),data.size() - sizeof(PMXCookedHeader));
+
+	// the cache file name is a hash of the path, make sure it is ours.
+	std::string cookedSource;
+	reader(cookedSource);
+	if(!reader.ok() || cookedSource != sourceFilename)
+	{
+		return false;
+	}
+
+	PMXFile cooked;
+	reader(cooked);
+	if(!reader.ok())
+	{
+		LOG_IO_WARN("Cooked pmx file {0} is corrupt, ignored.",cacheFilename);
+		return false;
+	}
+
+	*pmx_file = std::move(cooked);
 	return true;
-}
\ No newline at end of file
+}
+
+bool engine::asset_system::WriteCookedPMXFile(const PMXFile& pmx_file,const char* cacheFilename,const char* sourceFilename)
+{
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if(!getSourceStamp(sourceFilename,sourceSize,sourceTime))
+	{
+		return false;
+	}
+
+	PMXCookedWriter writer;
+	writer(makeCookedHeader(sourceSize,sourceTime));
+	writer(std::string(sourceFilename));
+	writer(pmx_file);
+
+	// NOTE: Written to a temporary file first, a crash mid write never leaves a half cooked cache.
+	const std::filesystem::path path(cacheFilename);
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(),ec);
+
+	{
+		std::ofstream outfile(tempPath,std::ios::binary | std::ios::trunc);
+		if(!outfile.is_open() || !outfile.write((const char*)writer.data.data(),(std::streamsize)writer.data.size()))
+		{
+			LOG_IO_WARN("Cooked pmx file {0} write failed.",cacheFilename);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath,path,ec);
+	if(ec)
+	{
+		std::filesystem::remove(tempPath,ec);
+		return false;
+	}
+	return true;
+}
@@ -606,6 +606,14 @@ struct PMXFile
 	std::vector<PMXSoftbody>	m_softbodies;
 };
 
+// NOTE: Reads the whole file with one call and decodes it from memory, every read is bounds checked.
+//       Returns false on missing, truncated or corrupt files.
 extern bool ReadPMXFile(PMXFile* pmxFile, const char* filename);
+extern bool ReadPMXFile(PMXFile* pmxFile, const uint8_t* data, size_t size);
+
+// NOTE: Cooked copy of a parsed PMXFile, stamped with the size and write time of the source file.
+//       Reading fails if the cache is missing, stale or written by a build with another layout.
+extern bool ReadCookedPMXFile(PMXFile* pmxFile, const char* cacheFilename, const char* sourceFilename);
+extern bool WriteCookedPMXFile(const PMXFile& pmxFile, const char* cacheFilename, const char* sourceFilename);
 
 }}
\ No newline at end of file
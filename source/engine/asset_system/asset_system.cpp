@@ -10,6 +10,7 @@
 #include "asset_mesh.h"
 #include "../launch/launch_engine_loop.h"
 #include "../core/job_system.h"
+#include "../core/cpu_profiler.h"
 
 namespace engine{ namespace asset_system{
 
@@ -41,9 +42,18 @@ void AssetSystem::tick(float dt)
 		scanTick ++;
 	}
 
-	prepareTextureLoad();
-	checkTextureUploadStateAsync();
-	MeshLibrary::get()->uploadAppendBuffer();
+	{
+		CPU_PROFILE_SCOPE("PrepareTextureLoad");
+		prepareTextureLoad();
+	}
+	{
+		CPU_PROFILE_SCOPE("CheckTextureUpload");
+		checkTextureUploadStateAsync();
+	}
+	{
+		CPU_PROFILE_SCOPE("UploadMeshAppendBuffer");
+		MeshLibrary::get()->tickGeometryHeaps();
+	}
 
 	broadcastCallbackOnAssetFolderDirty();
 }
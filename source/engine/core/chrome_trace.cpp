@@ -0,0 +1,105 @@
+#include "chrome_trace.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+
+namespace engine{
+
+static std::atomic<uint32> s_nextThreadId { 1 };
+static const std::chrono::steady_clock::time_point s_traceStart = std::chrono::steady_clock::now();
+
+uint32 getChromeTraceThreadId()
+{
+	thread_local uint32 threadId = s_nextThreadId.fetch_add(1);
+	return threadId;
+}
+
+double getChromeTraceTimeUs(std::chrono::steady_clock::time_point time)
+{
+	return std::chrono::duration<double,std::micro>(time - s_traceStart).count();
+}
+
+static void writeJsonString(std::ofstream& os,const std::string& str)
+{
+	os << '"';
+	for(char c : str)
+	{
+		switch(c)
+		{
+		case '"':  os << "\\\""; break;
+		case '\\': os << "\\\\"; break;
+		case '\n': os << "\\n";  break;
+		case '\t': os << "\\t";  break;
+		default:
+			if((unsigned char)c >= 0x20)
+			{
+				os << c;
+			}
+			break;
+		}
+	}
+	os << '"';
+}
+
+bool writeChromeTrace(const std::string& path,const std::vector<ChromeTraceTrack>& tracks,const std::vector<ChromeTraceEvent>& events)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(),ec);
+
+	std::ofstream os(path);
+	if(!os.is_open())
+	{
+		LOG_WARN("Fail to open trace file {0}.",path);
+		return false;
+	}
+
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool bFirst = true;
+	auto separator = [&]()
+	{
+		os << (bFirst ? "" : ",\n");
+		bFirst = false;
+	};
+
+	for(const auto& track : tracks)
+	{
+		separator();
+		os << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << track.pid << ",\"tid\":" << track.tid << ",\"args\":{\"name\":";
+		writeJsonString(os,track.processName);
+		os << "}}";
+
+		separator();
+		os << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << track.pid << ",\"tid\":" << track.tid << ",\"args\":{\"name\":";
+		writeJsonString(os,track.threadName);
+		os << "}}";
+	}
+
+	os.precision(3);
+	os << std::fixed;
+	for(const auto& event : events)
+	{
+		separator();
+		os << "{\"ph\":\"X\",\"name\":";
+		writeJsonString(os,event.name);
+		os << ",\"cat\":";
+		writeJsonString(os,event.category);
+		os << ",\"pid\":" << event.pid << ",\"tid\":" << event.tid << ",\"ts\":" << event.beginUs << ",\"dur\":" << event.durationUs;
+		if(!event.args.empty())
+		{
+			os << ",\"args\":{";
+			for(size_t i = 0; i < event.args.size(); i++)
+			{
+				os << (i == 0 ? "" : ",");
+				writeJsonString(os,event.args[i].first);
+				os << ":" << event.args[i].second;
+			}
+			os << "}";
+		}
+		os << "}";
+	}
+	os << "\n]}\n";
+
+	return os.good();
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include "core.h"
+
+namespace engine{
+
+// NOTE: One complete ("X") event of the Chrome trace event format, loads in chrome://tracing and Perfetto.
+//       Times are in microseconds, events of one process share a time base.
+struct ChromeTraceEvent
+{
+	std::string name = {};
+	std::string category = {};
+	uint32 pid = 0;
+	uint32 tid = 0;
+	double beginUs = 0.0;
+	double durationUs = 0.0;
+
+	// Extra key value pairs shown in the event details.
+	std::vector<std::pair<std::string,uint64>> args = {};
+};
+
+// Process ids of the engine's tracks.
+constexpr uint32 CHROME_TRACE_CPU_PID = 1;
+constexpr uint32 CHROME_TRACE_GPU_PID = 2;
+
+struct ChromeTraceTrack
+{
+	uint32 pid = 0;
+	uint32 tid = 0;
+	std::string processName = {};
+	std::string threadName = {};
+};
+
+// Small stable id of the calling thread, used as tid of cpu events.
+uint32 getChromeTraceThreadId();
+
+// Microseconds of a steady clock time point since the first call in this process.
+double getChromeTraceTimeUs(std::chrono::steady_clock::time_point time);
+
+bool writeChromeTrace(const std::string& path,const std::vector<ChromeTraceTrack>& tracks,const std::vector<ChromeTraceEvent>& events);
+
+}
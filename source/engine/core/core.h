@@ -9,6 +9,9 @@
 // Logӡ
 #define ENABLE_LOG
 
+// NOTE: CPU_PROFILE_* macros expand to nothing without this.
+#define ENABLE_CPU_PROFILER
+
 #ifdef ENABLE_LOG
 #define LOG_TRACE(...) ::engine::Logger::getInstance()->getLoggerUtil()->trace(__VA_ARGS__)
 #define LOG_INFO(...)  ::engine::Logger::getInstance()->getLoggerUtil()->info(__VA_ARGS__)
@@ -0,0 +1,188 @@
+#include "cpu_profiler.h"
+
+namespace engine{
+
+static AutoCVarInt32 cVarCpuProfiler(
+	"r.Profiler.Cpu",
+	"Record cpu profile scopes, takes effect at the next frame.",
+	"Profiler",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarCpuEventsPerThread(
+	"r.Profiler.CpuEventsPerThread",
+	"Ring buffer size of every profiled thread, read when the thread records its first scope.",
+	"Profiler",
+	16384,
+	CVarFlags::ReadOnly
+);
+
+static constexpr size_t CPU_PROFILER_FRAME_COUNT = 64;
+
+thread_local CpuProfiler::ThreadBuffer* CpuProfiler::t_threadBuffer = nullptr;
+
+CpuProfiler* CpuProfiler::get()
+{
+	static CpuProfiler profiler;
+	return &profiler;
+}
+
+double CpuProfiler::ticksToMs(int64 ticks)
+{
+	return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::duration(ticks)).count();
+}
+
+double CpuProfiler::ticksToTraceUs(int64 ticks)
+{
+	return getChromeTraceTimeUs(std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ticks)));
+}
+
+void CpuProfiler::frameBegin()
+{
+	const int64 time = now();
+	if(m_frameIndex > 0)
+	{
+		m_frames.push_back({ m_frameIndex, m_frameBegin, time });
+		if(m_frames.size() > CPU_PROFILER_FRAME_COUNT)
+		{
+			m_frames.erase(m_frames.begin());
+		}
+	}
+
+	m_frameIndex++;
+	m_frameBegin = time;
+	m_bEnabled.store(cVarCpuProfiler.get() != 0,std::memory_order_relaxed);
+}
+
+const char* CpuProfiler::intern(const std::string& name)
+{
+	std::lock_guard lock(m_internMutex);
+	return m_internedNames.insert(name).first->c_str();
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::getThreadBuffer()
+{
+	if(t_threadBuffer == nullptr)
+	{
+		auto buffer = std::make_unique<ThreadBuffer>();
+		buffer->events.resize(glm::max(cVarCpuEventsPerThread.get(),64));
+		buffer->threadId = getChromeTraceThreadId();
+		buffer->threadName = "Thread " + std::to_string(buffer->threadId);
+
+		std::lock_guard lock(m_bufferMutex);
+		t_threadBuffer = buffer.get();
+		m_buffers.push_back(std::move(buffer));
+	}
+	return *t_threadBuffer;
+}
+
+void CpuProfiler::setThreadName(const std::string& name)
+{
+	auto& buffer = getThreadBuffer();
+	std::lock_guard lock(m_bufferMutex);
+	buffer.threadName = name;
+}
+
+uint32 CpuProfiler::beginScope()
+{
+	return getThreadBuffer().depth++;
+}
+
+void CpuProfiler::endScope(const char* name,int64 beginTicks,uint32 depth)
+{
+	auto& buffer = *t_threadBuffer;
+	buffer.depth = depth;
+
+	const uint64 index = buffer.writeIndex.load(std::memory_order_relaxed);
+	auto& event = buffer.events[index % buffer.events.size()];
+	event.name = name;
+	event.beginTicks = beginTicks;
+	event.endTicks = now();
+	event.depth = depth;
+
+	// Publish after the event is written.
+	buffer.writeIndex.store(index + 1,std::memory_order_release);
+}
+
+std::vector<CpuProfiler::Frame> CpuProfiler::getFrames() const
+{
+	return m_frames;
+}
+
+void CpuProfiler::copyEvents(const ThreadBuffer& buffer,std::vector<Event>& out) const
+{
+	const uint64 capacity = buffer.events.size();
+	const uint64 end = buffer.writeIndex.load(std::memory_order_acquire);
+	const uint64 begin = end > capacity ? end - capacity : 0;
+
+	const size_t first = out.size();
+	for(uint64 i = begin; i < end; i++)
+	{
+		out.push_back(buffer.events[i % capacity]);
+	}
+
+	// NOTE: The owner kept writing while we copied, drop the slots it may have overwritten.
+	const uint64 endAfter = buffer.writeIndex.load(std::memory_order_acquire);
+	const uint64 overwritten = endAfter > capacity ? endAfter - capacity : 0;
+	if(overwritten > begin)
+	{
+		const size_t dropCount = (size_t)glm::min(overwritten - begin,end - begin);
+		out.erase(out.begin() + first,out.begin() + first + dropCount);
+	}
+}
+
+void CpuProfiler::collect(int64 beginTicks,int64 endTicks,std::vector<ThreadEvents>& out) const
+{
+	out.clear();
+
+	std::lock_guard lock(m_bufferMutex);
+	std::vector<Event> events;
+	for(const auto& buffer : m_buffers)
+	{
+		events.clear();
+		copyEvents(*buffer,events);
+
+		ThreadEvents thread { };
+		thread.threadId = buffer->threadId;
+		thread.threadName = buffer->threadName;
+		for(const auto& event : events)
+		{
+			if(event.endTicks > beginTicks && event.beginTicks < endTicks)
+			{
+				thread.events.push_back(event);
+			}
+		}
+
+		if(!thread.events.empty())
+		{
+			out.push_back(std::move(thread));
+		}
+	}
+}
+
+void CpuProfiler::appendChromeTrace(std::vector<ChromeTraceTrack>& tracks,std::vector<ChromeTraceEvent>& events) const
+{
+	std::lock_guard lock(m_bufferMutex);
+	std::vector<Event> buffered;
+	for(const auto& buffer : m_buffers)
+	{
+		tracks.push_back({ CHROME_TRACE_CPU_PID, buffer->threadId, "CPU", buffer->threadName });
+
+		buffered.clear();
+		copyEvents(*buffer,buffered);
+		for(const auto& event : buffered)
+		{
+			ChromeTraceEvent traceEvent { };
+			traceEvent.name = event.name;
+			traceEvent.category = "cpu";
+			traceEvent.pid = CHROME_TRACE_CPU_PID;
+			traceEvent.tid = buffer->threadId;
+			traceEvent.beginUs = ticksToTraceUs(event.beginTicks);
+			traceEvent.durationUs = ticksToMs(event.endTicks - event.beginTicks) * 1000.0;
+			events.push_back(std::move(traceEvent));
+		}
+	}
+}
+
+}
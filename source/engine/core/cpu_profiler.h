@@ -0,0 +1,141 @@
+#pragma once
+#include "core.h"
+#include "chrome_trace.h"
+#include <atomic>
+#include <memory>
+#include <unordered_set>
+
+namespace engine{
+
+// NOTE: Scoped cpu timings kept in one ring buffer per thread. Only the thread owning a buffer writes
+//       to it and nothing is locked on the hot path, older events are simply overwritten. Readers
+//       copy a ring and drop whatever was overwritten while they copied.
+class CpuProfiler
+{
+public:
+	struct Event
+	{
+		const char* name = nullptr;
+		int64 beginTicks = 0; // std::chrono::steady_clock ticks.
+		int64 endTicks = 0;
+		uint32 depth = 0;     // open scopes of the thread when this one began.
+	};
+
+	struct ThreadEvents
+	{
+		uint32 threadId = 0;
+		std::string threadName = {};
+		std::vector<Event> events = {};
+	};
+
+	struct Frame
+	{
+		uint64 index = 0;
+		int64 beginTicks = 0;
+		int64 endTicks = 0;
+	};
+
+	static CpuProfiler* get();
+
+	// NOTE: Call on the main thread at the start of every frame, also latches r.Profiler.Cpu.
+	void frameBegin();
+
+	bool isEnabled() const { return m_bEnabled.load(std::memory_order_relaxed); }
+
+	// NOTE: Event names are kept as pointers, dynamic names must go through here once.
+	const char* intern(const std::string& name);
+
+	void setThreadName(const std::string& name);
+
+	// Depth of the new scope, the caller passes it back to endScope.
+	uint32 beginScope();
+	void endScope(const char* name,int64 beginTicks,uint32 depth);
+
+	// Completed frames, oldest first.
+	std::vector<Frame> getFrames() const;
+
+	// Events of every thread overlapping [beginTicks,endTicks).
+	void collect(int64 beginTicks,int64 endTicks,std::vector<ThreadEvents>& out) const;
+
+	// Every buffered event on the thread that recorded it.
+	void appendChromeTrace(std::vector<ChromeTraceTrack>& tracks,std::vector<ChromeTraceEvent>& events) const;
+
+	static int64 now() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+	static double ticksToMs(int64 ticks);
+	static double ticksToTraceUs(int64 ticks);
+
+private:
+	struct ThreadBuffer
+	{
+		std::vector<Event> events = {};
+		std::atomic<uint64> writeIndex { 0 };
+		uint32 threadId = 0;
+		std::string threadName = {};
+		uint32 depth = 0;
+	};
+
+	static thread_local ThreadBuffer* t_threadBuffer;
+
+	ThreadBuffer& getThreadBuffer();
+	void copyEvents(const ThreadBuffer& buffer,std::vector<Event>& out) const;
+
+	std::atomic<bool> m_bEnabled { true };
+
+	// Buffers live until exit, worker threads never end before that.
+	mutable std::mutex m_bufferMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> m_buffers = {};
+
+	std::mutex m_internMutex;
+	std::unordered_set<std::string> m_internedNames = {};
+
+	std::vector<Frame> m_frames = {};
+	uint64 m_frameIndex = 0;
+	int64 m_frameBegin = 0;
+};
+
+class CpuProfileScope
+{
+public:
+	explicit CpuProfileScope(const char* name)
+		: m_name(name)
+	{
+		if(CpuProfiler::get()->isEnabled())
+		{
+			m_depth = CpuProfiler::get()->beginScope();
+			m_beginTicks = CpuProfiler::now();
+			m_bActive = true;
+		}
+	}
+
+	~CpuProfileScope()
+	{
+		if(m_bActive)
+		{
+			CpuProfiler::get()->endScope(m_name,m_beginTicks,m_depth);
+		}
+	}
+
+private:
+	const char* m_name;
+	int64 m_beginTicks = 0;
+	uint32 m_depth = 0;
+	bool m_bActive = false;
+};
+
+}
+
+#define CPU_PROFILE_CONCAT_INNER(a,b) a##b
+#define CPU_PROFILE_CONCAT(a,b) CPU_PROFILE_CONCAT_INNER(a,b)
+
+// NOTE: Names must outlive the profiler, use literals or CpuProfiler::intern.
+#ifdef ENABLE_CPU_PROFILER
+#define CPU_PROFILE_SCOPE(name) ::engine::CpuProfileScope CPU_PROFILE_CONCAT(cpuProfileScope,__LINE__)(name)
+#define CPU_PROFILE_FUNCTION() CPU_PROFILE_SCOPE(__FUNCTION__)
+#define CPU_PROFILE_FRAME() ::engine::CpuProfiler::get()->frameBegin()
+#define CPU_PROFILE_THREAD(name) ::engine::CpuProfiler::get()->setThreadName(name)
+#else
+#define CPU_PROFILE_SCOPE(name)
+#define CPU_PROFILE_FUNCTION()
+#define CPU_PROFILE_FRAME()
+#define CPU_PROFILE_THREAD(name)
+#endif
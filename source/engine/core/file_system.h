@@ -20,6 +20,9 @@ static const char* s_engineTex           = "./media/engine_texture/";
 static const char* s_engineMesh          = "./media/engine_mesh/";
 static const char* s_engineShader        = "./media/shader/";
 static const char* s_engineShaderCache   = "./media/cache/shader/";
+static const char* s_enginePipelineCache = "./media/cache/pipeline.bin";
+static const char* s_engineProfileCache  = "./media/cache/profile/";
+static const char* s_enginePMXCache      = "./media/cache/pmx/";
 static const char* s_shaderCompile       = "glslc.exe";
 
 static const char* s_defaultWhiteTextureName      = "./media/engine_texture/T_White.tga";
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <mutex>
 #include "job_system.h"
+#include "cpu_profiler.h"
 
 namespace engine{ namespace jobsystem{
 
@@ -88,8 +89,10 @@ void initialize()
 	// ʼʱʹȫĹ̡߳
 	for(uint32_t thread_id = 0; thread_id<num_threads; thread_id++)
 	{
-		std::thread worker([]
+		std::thread worker([thread_id]
 		{
+			CPU_PROFILE_THREAD("Worker " + std::to_string(thread_id));
+
 			// ʼʱʹÿ
 			std::function<void()> job;
 			while(true)
@@ -98,7 +101,10 @@ void initialize()
 				if(job_pool.pop_front(job))
 				{
 					// ִִ
-					job();
+					{
+						CPU_PROFILE_SCOPE("Job");
+						job();
+					}
 
 					// ±־λ
 					finished_bit.fetch_add(1);
@@ -133,6 +139,29 @@ void execute(const std::function<void()>& job)
 	wake_condition.notify_one(); 
 }
 
+void execute(Context& ctx,const std::function<void()>& job)
+{
+	ctx.counter.fetch_add(1);
+	execute([&ctx,job]()
+	{
+		job();
+		ctx.counter.fetch_sub(1);
+	});
+}
+
+bool isBusy(const Context& ctx)
+{
+	return ctx.counter.load() > 0;
+}
+
+void wait(const Context& ctx)
+{
+	while(isBusy(ctx))
+	{
+		poll();
+	}
+}
+
 bool isBusy()
 {
 	return finished_bit.load() < current_bit;
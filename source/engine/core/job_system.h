@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include <functional>
+#include <atomic>
 
 namespace engine{ namespace jobsystem {
 
@@ -20,6 +21,17 @@ struct DispatchArgs
 // һַвִС
 void dispatch(const uint32_t& jobCount,const uint32_t& groupSize,const std::function<void(DispatchArgs)>& job);
 
+// NOTE: Tracks only the jobs pushed with it, so a caller can wait on its own work
+//       without waiting on unrelated long jobs like scene loading.
+struct Context
+{
+	std::atomic<uint32_t> counter { 0 };
+};
+
+void execute(Context& ctx,const std::function<void()>& job);
+bool isBusy(const Context& ctx);
+void wait(const Context& ctx);
+
 // Ƿڹ
 bool isBusy();
 
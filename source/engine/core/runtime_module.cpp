@@ -1,4 +1,5 @@
 #include "runtime_module.h"
+#include "cpu_profiler.h"
 
 namespace engine{
 
@@ -37,6 +38,7 @@ void ModuleManager::tick(ETickType type,float dt)
 		if (runtimeModule.tickType != type)
 			continue;
 
+		CPU_PROFILE_SCOPE(typeid(*runtimeModule.ptr).name());
 		runtimeModule.ptr->tick(dt);
 	}
 }
@@ -9,15 +9,15 @@ class Timer
     friend class EngineLoop;
 private:
     // ʼTimePoint,ڼʵʱš
-    std::chrono::system_clock::time_point mInitTimePoint{ };
+    std::chrono::steady_clock::time_point mInitTimePoint{ };
     std::chrono::duration<float> mDeltaTime { 0.0f };
 
     // ϷеTimePoint,ڼϷеʱš
-    std::chrono::system_clock::time_point mGameTimePoint{ };
+    std::chrono::steady_clock::time_point mGameTimePoint{ };
     std::chrono::duration<float> mGameDeltaTime { 0.0f };
 
     // ϷеFramePoint,ڼϷеDeltaTime
-    std::chrono::system_clock::time_point mFrameTimePoint{ };
+    std::chrono::steady_clock::time_point mFrameTimePoint{ };
     std::chrono::duration<float> mFrameDeltaTime { 0.0f };
 
     bool bGamePause = true;
@@ -35,12 +35,12 @@ public:
 
     void globalTimeInit()
     {
-        mInitTimePoint = std::chrono::system_clock::now();
+        mInitTimePoint = std::chrono::steady_clock::now();
     }
 
     float globalPassTime()
     {
-        mDeltaTime = std::chrono::system_clock::now() - mInitTimePoint;
+        mDeltaTime = std::chrono::steady_clock::now() - mInitTimePoint;
         return mDeltaTime.count();
     }
 
@@ -51,7 +51,7 @@ public:
 
     void gameStart()
     {
-        mGameTimePoint = std::chrono::system_clock::now();
+        mGameTimePoint = std::chrono::steady_clock::now();
         mGameDeltaTime = std::chrono::duration<float>(0.0f);
         bGamePause = false;
     }
@@ -74,7 +74,7 @@ public:
         }
         else
         {
-            auto nowTime = std::chrono::system_clock::now();
+            auto nowTime = std::chrono::steady_clock::now();
             mGameDeltaTime += nowTime - mGameTimePoint;
             mGameTimePoint = nowTime;
 
@@ -86,7 +86,7 @@ public:
     {
         if(!bGamePause)
         {
-            auto nowTime = std::chrono::system_clock::now();
+            auto nowTime = std::chrono::steady_clock::now();
             mGameDeltaTime += nowTime - mGameTimePoint;
 
             mGameTimePoint = nowTime;
@@ -98,14 +98,14 @@ public:
     {
         if(bGamePause)
         {
-            mGameTimePoint = std::chrono::system_clock::now();
+            mGameTimePoint = std::chrono::steady_clock::now();
             bGamePause = false;
         }
     }
 
     void gameStop()
     {
-        mGameTimePoint = std::chrono::system_clock::now();
+        mGameTimePoint = std::chrono::steady_clock::now();
         mGameDeltaTime = std::chrono::duration<float>(0.0f);
 
         bGamePause = true;
@@ -113,12 +113,12 @@ public:
 
     void frameTimeInit()
     {
-        mFrameTimePoint = std::chrono::system_clock::now();
+        mFrameTimePoint = std::chrono::steady_clock::now();
     }
 
     void frameTick()
     {
-        mFrameDeltaTime = std::chrono::system_clock::now() - mFrameTimePoint;
+        mFrameDeltaTime = std::chrono::steady_clock::now() - mFrameTimePoint;
     }
 
     float frameDeltaTime() const
@@ -128,7 +128,7 @@ public:
 
     void frameReset()
     {
-        mFrameTimePoint = std::chrono::system_clock::now();
+        mFrameTimePoint = std::chrono::steady_clock::now();
     }
 };
 
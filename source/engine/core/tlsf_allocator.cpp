@@ -0,0 +1,353 @@
+#include "tlsf_allocator.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace engine{
+
+static inline uint32 findFirstSet(uint32 bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index,bits);
+	return (uint32)index;
+#else
+	return (uint32)__builtin_ctz(bits);
+#endif
+}
+
+static inline uint32 findLastSet(uint32 bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse(&index,bits);
+	return (uint32)index;
+#else
+	return 31u - (uint32)__builtin_clz(bits);
+#endif
+}
+
+void TlsfAllocator::mapping(uint32 size,uint32& fl,uint32& sl)
+{
+	if(size < SL_COUNT)
+	{
+		// Small blocks get exact bins in the first row.
+		fl = 0;
+		sl = size;
+	}
+	else
+	{
+		const uint32 msb = findLastSet(size);
+		fl = msb - SL_LOG2 + 1;
+		sl = (size >> (msb - SL_LOG2)) - SL_COUNT;
+	}
+}
+
+void TlsfAllocator::mappingSearch(uint32 size,uint32& fl,uint32& sl)
+{
+	// NOTE: Round up to the next bin so every block of the bin found is large enough.
+	if(size >= SL_COUNT)
+	{
+		const uint32 round = (1u << (findLastSet(size) - SL_LOG2)) - 1;
+		size = size > ~0u - round ? ~0u : size + round;
+	}
+	mapping(size,fl,sl);
+}
+
+uint32 TlsfAllocator::createNode()
+{
+	if(!m_unusedNodes.empty())
+	{
+		const uint32 node = m_unusedNodes.back();
+		m_unusedNodes.pop_back();
+		return node;
+	}
+
+	m_nodes.push_back({});
+	return (uint32)m_nodes.size() - 1;
+}
+
+void TlsfAllocator::releaseNode(uint32 node)
+{
+	m_nodes[node] = {};
+	m_unusedNodes.push_back(node);
+}
+
+void TlsfAllocator::insertFree(uint32 node)
+{
+	uint32 fl,sl;
+	mapping(m_nodes[node].size,fl,sl);
+
+	const uint32 head = m_bins[fl][sl];
+	m_nodes[node].prevFree = INVALID_NODE;
+	m_nodes[node].nextFree = head;
+	if(head != INVALID_NODE)
+	{
+		m_nodes[head].prevFree = node;
+	}
+
+	m_bins[fl][sl] = node;
+	m_slMask[fl] |= 1u << sl;
+	m_flMask |= 1u << fl;
+}
+
+void TlsfAllocator::removeFree(uint32 node)
+{
+	uint32 fl,sl;
+	mapping(m_nodes[node].size,fl,sl);
+
+	const uint32 prev = m_nodes[node].prevFree;
+	const uint32 next = m_nodes[node].nextFree;
+	if(prev != INVALID_NODE) m_nodes[prev].nextFree = next;
+	if(next != INVALID_NODE) m_nodes[next].prevFree = prev;
+
+	if(m_bins[fl][sl] == node)
+	{
+		m_bins[fl][sl] = next;
+		if(next == INVALID_NODE)
+		{
+			m_slMask[fl] &= ~(1u << sl);
+			if(m_slMask[fl] == 0)
+			{
+				m_flMask &= ~(1u << fl);
+			}
+		}
+	}
+
+	m_nodes[node].prevFree = INVALID_NODE;
+	m_nodes[node].nextFree = INVALID_NODE;
+}
+
+uint32 TlsfAllocator::findFree(uint32 size) const
+{
+	uint32 fl,sl;
+	mappingSearch(size,fl,sl);
+	if(fl >= FL_COUNT)
+	{
+		return INVALID_NODE;
+	}
+
+	uint32 slMap = m_slMask[fl] & (~0u << sl);
+	if(slMap == 0)
+	{
+		const uint32 flMap = fl + 1 < 32 ? m_flMask & (~0u << (fl + 1)) : 0;
+		if(flMap == 0)
+		{
+			return INVALID_NODE;
+		}
+
+		fl = findFirstSet(flMap);
+		slMap = m_slMask[fl];
+	}
+
+	return m_bins[fl][findFirstSet(slMap)];
+}
+
+void TlsfAllocator::init(uint32 size)
+{
+	m_nodes.clear();
+	m_unusedNodes.clear();
+
+	m_flMask = 0;
+	for(uint32 fl = 0; fl < FL_COUNT; fl++)
+	{
+		m_slMask[fl] = 0;
+		for(uint32 sl = 0; sl < SL_COUNT; sl++)
+		{
+			m_bins[fl][sl] = INVALID_NODE;
+		}
+	}
+
+	m_lastNode = INVALID_NODE;
+	m_size = 0;
+	m_usedSize = 0;
+	m_allocationCount = 0;
+
+	grow(size);
+}
+
+bool TlsfAllocator::allocate(uint32 size,Allocation& out)
+{
+	if(size == 0)
+	{
+		return false;
+	}
+
+	const uint32 node = findFree(size);
+	if(node == INVALID_NODE)
+	{
+		return false;
+	}
+	removeFree(node);
+
+	// NOTE: Split the tail off as a new free block, createNode may move m_nodes so index only.
+	if(m_nodes[node].size > size)
+	{
+		const uint32 rest = createNode();
+		m_nodes[rest].offset = m_nodes[node].offset + size;
+		m_nodes[rest].size = m_nodes[node].size - size;
+		m_nodes[rest].prevPhysical = node;
+		m_nodes[rest].nextPhysical = m_nodes[node].nextPhysical;
+
+		if(m_nodes[node].nextPhysical != INVALID_NODE)
+		{
+			m_nodes[m_nodes[node].nextPhysical].prevPhysical = rest;
+		}
+		else
+		{
+			m_lastNode = rest;
+		}
+
+		m_nodes[node].nextPhysical = rest;
+		m_nodes[node].size = size;
+		insertFree(rest);
+	}
+
+	m_nodes[node].bUsed = true;
+	m_usedSize += size;
+	m_allocationCount ++;
+
+	out.offset = m_nodes[node].offset;
+	out.size = size;
+	out.node = node;
+	return true;
+}
+
+void TlsfAllocator::free(Allocation& allocation)
+{
+	uint32 node = allocation.node;
+	CHECK(node < m_nodes.size() && m_nodes[node].bUsed && m_nodes[node].offset == allocation.offset);
+
+	m_usedSize -= m_nodes[node].size;
+	m_allocationCount --;
+	m_nodes[node].bUsed = false;
+
+	const uint32 prev = m_nodes[node].prevPhysical;
+	if(prev != INVALID_NODE && !m_nodes[prev].bUsed)
+	{
+		removeFree(prev);
+		m_nodes[prev].size += m_nodes[node].size;
+		m_nodes[prev].nextPhysical = m_nodes[node].nextPhysical;
+		if(m_nodes[node].nextPhysical != INVALID_NODE)
+		{
+			m_nodes[m_nodes[node].nextPhysical].prevPhysical = prev;
+		}
+		else
+		{
+			m_lastNode = prev;
+		}
+
+		releaseNode(node);
+		node = prev;
+	}
+
+	const uint32 next = m_nodes[node].nextPhysical;
+	if(next != INVALID_NODE && !m_nodes[next].bUsed)
+	{
+		removeFree(next);
+		m_nodes[node].size += m_nodes[next].size;
+		m_nodes[node].nextPhysical = m_nodes[next].nextPhysical;
+		if(m_nodes[next].nextPhysical != INVALID_NODE)
+		{
+			m_nodes[m_nodes[next].nextPhysical].prevPhysical = node;
+		}
+		else
+		{
+			m_lastNode = node;
+		}
+
+		releaseNode(next);
+	}
+
+	insertFree(node);
+	allocation = {};
+}
+
+void TlsfAllocator::grow(uint32 newSize)
+{
+	CHECK(newSize >= m_size);
+	if(newSize == m_size)
+	{
+		return;
+	}
+
+	const uint32 extra = newSize - m_size;
+	if(m_lastNode != INVALID_NODE && !m_nodes[m_lastNode].bUsed)
+	{
+		removeFree(m_lastNode);
+		m_nodes[m_lastNode].size += extra;
+		insertFree(m_lastNode);
+	}
+	else
+	{
+		const uint32 node = createNode();
+		m_nodes[node].offset = m_size;
+		m_nodes[node].size = extra;
+		m_nodes[node].prevPhysical = m_lastNode;
+		if(m_lastNode != INVALID_NODE)
+		{
+			m_nodes[m_lastNode].nextPhysical = node;
+		}
+
+		m_lastNode = node;
+		insertFree(node);
+	}
+
+	m_size = newSize;
+}
+
+uint32 TlsfAllocator::getLastAllocatedNode() const
+{
+	if(m_lastNode == INVALID_NODE || m_nodes[m_lastNode].bUsed)
+	{
+		return m_lastNode;
+	}
+
+	// Free blocks are always merged, the one before a free block is used.
+	return m_nodes[m_lastNode].prevPhysical;
+}
+
+uint32 TlsfAllocator::getPrevAllocatedNode(uint32 node) const
+{
+	uint32 prev = m_nodes[node].prevPhysical;
+	if(prev != INVALID_NODE && !m_nodes[prev].bUsed)
+	{
+		prev = m_nodes[prev].prevPhysical;
+	}
+	return prev;
+}
+
+TlsfAllocator::Allocation TlsfAllocator::getAllocation(uint32 node) const
+{
+	CHECK(node < m_nodes.size() && m_nodes[node].bUsed);
+
+	Allocation allocation { };
+	allocation.offset = m_nodes[node].offset;
+	allocation.size = m_nodes[node].size;
+	allocation.node = node;
+	return allocation;
+}
+
+TlsfAllocator::Stats TlsfAllocator::getStats() const
+{
+	Stats stats { };
+	stats.size = m_size;
+	stats.usedSize = m_usedSize;
+	stats.allocationCount = m_allocationCount;
+	stats.freeBlockCount = (uint32)(m_nodes.size() - m_unusedNodes.size()) - m_allocationCount;
+
+	// NOTE: The largest block is in the highest bin, the bin itself is not sorted.
+	if(m_flMask != 0)
+	{
+		const uint32 fl = findLastSet(m_flMask);
+		const uint32 sl = findLastSet(m_slMask[fl]);
+		for(uint32 node = m_bins[fl][sl]; node != INVALID_NODE; node = m_nodes[node].nextFree)
+		{
+			stats.largestFreeBlock = glm::max(stats.largestFreeBlock,m_nodes[node].size);
+		}
+	}
+	return stats;
+}
+
+}
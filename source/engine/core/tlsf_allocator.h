@@ -0,0 +1,104 @@
+#pragma once
+#include "core.h"
+#include <vector>
+
+namespace engine{
+
+// NOTE: Two level segregated fit range allocator. It only hands out offsets in abstract units, the
+//       caller owns the memory. Free blocks are binned by the top bit of their size (first level)
+//       and the next SL_LOG2 bits (second level), one bit mask per level finds a fitting bin in O(1).
+//       Neighbouring free blocks are merged on free, so the heap never holds two adjacent free blocks.
+class TlsfAllocator
+{
+public:
+	static constexpr uint32 INVALID_NODE = ~0u;
+
+	struct Allocation
+	{
+		uint32 offset = 0;
+		uint32 size = 0;
+		uint32 node = INVALID_NODE;
+
+		bool valid() const { return node != INVALID_NODE; }
+	};
+
+	struct Stats
+	{
+		uint32 size = 0;
+		uint32 usedSize = 0;
+		uint32 largestFreeBlock = 0;
+		uint32 allocationCount = 0;
+		uint32 freeBlockCount = 0;
+	};
+
+	void init(uint32 size);
+	void reset() { init(0); }
+
+	// Fails without touching the heap when no free block is large enough.
+	bool allocate(uint32 size,Allocation& out);
+	void free(Allocation& allocation);
+
+	// Append [getSize(),newSize) as free space, merged with a free block at the end.
+	void grow(uint32 newSize);
+
+	uint32 getSize() const { return m_size; }
+	uint32 getUsedSize() const { return m_usedSize; }
+	uint32 getAllocationCount() const { return m_allocationCount; }
+
+	// Used block with the highest offset, INVALID_NODE when the heap is empty.
+	uint32 getLastAllocatedNode() const;
+
+	// Used block before node in address order, INVALID_NODE at the start of the heap.
+	uint32 getPrevAllocatedNode(uint32 node) const;
+
+	Allocation getAllocation(uint32 node) const;
+
+	Stats getStats() const;
+
+private:
+	static constexpr uint32 SL_LOG2 = 4;
+	static constexpr uint32 SL_COUNT = 1u << SL_LOG2;
+	static constexpr uint32 FL_COUNT = 32 - SL_LOG2 + 1;
+
+	struct Node
+	{
+		uint32 offset = 0;
+		uint32 size = 0;
+
+		// Address order neighbours.
+		uint32 prevPhysical = INVALID_NODE;
+		uint32 nextPhysical = INVALID_NODE;
+
+		// Links of the bin the free block is in.
+		uint32 prevFree = INVALID_NODE;
+		uint32 nextFree = INVALID_NODE;
+
+		bool bUsed = false;
+	};
+
+	static void mapping(uint32 size,uint32& fl,uint32& sl);
+	static void mappingSearch(uint32 size,uint32& fl,uint32& sl);
+
+	uint32 createNode();
+	void releaseNode(uint32 node);
+
+	void insertFree(uint32 node);
+	void removeFree(uint32 node);
+	uint32 findFree(uint32 size) const;
+
+	std::vector<Node> m_nodes = {};
+	std::vector<uint32> m_unusedNodes = {};
+
+	uint32 m_flMask = 0;
+	uint32 m_slMask[FL_COUNT] = {};
+	uint32 m_bins[FL_COUNT][SL_COUNT] = {};
+
+	// Node at the end of the address range.
+	uint32 m_lastNode = INVALID_NODE;
+
+	uint32 m_size = 0;
+	uint32 m_usedSize = 0;
+	uint32 m_allocationCount = 0;
+};
+
+}
@@ -6,11 +6,13 @@
 #include "scene/scene.h"
 #include "core/job_system.h"
 #include "shader_compiler/shader_compiler.h"
+#include "core/cpu_profiler.h"
 
 namespace engine{
 
 bool Engine::init()
 {
+	CPU_PROFILE_THREAD("Main");
 	jobsystem::initialize();
 
 	m_moduleManager = std::make_unique<ModuleManager>();
@@ -38,6 +40,8 @@ Engine::~Engine()
 
 ETickResult Engine::tick(float trueDt,float smoothDt)
 {
+	CPU_PROFILE_FRAME();
+
 	m_moduleManager->tick(ETickType::True,     trueDt);
 	m_moduleManager->tick(ETickType::Smoothed, smoothDt);
 
@@ -2,6 +2,7 @@
 #include "../core/cvar.h"
 #include "../core/core.h"
 #include <sstream>
+#include <thread>
 #include "../engine.h"
 #include "../vk/vk_rhi.h"
 #include "../asset_system/asset_system.h"
@@ -56,6 +57,30 @@ static AutoCVarInt32 cVarFpsMode(
     CVarFlags::ReadAndWrite
 );
 
+static AutoCVarInt32 cVarMaxFps(
+    "r.Window.MaxFps",
+    "Custom frame rate limit, overrides r.Window.FpsMode when greater than 0.",
+    "Window",
+    0,
+    CVarFlags::ReadAndWrite
+);
+
+static AutoCVarFloat cVarLimiterSpinMs(
+    "r.Window.LimiterSpinMs",
+    "The frame limiter sleeps until this many milliseconds before the deadline and spins the rest, covers the os sleep granularity.",
+    "Window",
+    2.0f,
+    CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarLowLatency(
+    "r.Window.LowLatency",
+    "Wait for the gpu to finish the previous frame before sampling input, trades throughput for latency.",
+    "Window",
+    0,
+    CVarFlags::ReadAndWrite
+);
+
 enum class EFpsMode : uint32
 {
     Free = 0,
@@ -67,6 +92,11 @@ enum class EFpsMode : uint32
 
 float getFps()
 {
+    if(cVarMaxFps.get() > 0)
+    {
+        return (float)cVarMaxFps.get();
+    }
+
     auto mode = (EFpsMode)cVarFpsMode.get();
     switch(mode)
     {
@@ -225,6 +255,26 @@ bool EngineLoop::init()
 	return true;
 }
 
+// NOTE: Sleeping alone overshoots by the os timer granularity, so sleep to a margin before the
+//       deadline and spin the rest on the steady clock.
+static void waitUntil(std::chrono::steady_clock::time_point deadline)
+{
+    using Clock = std::chrono::steady_clock;
+    const auto spin = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<float,std::milli>(glm::max(cVarLimiterSpinMs.get(),0.0f)));
+
+    auto now = Clock::now();
+    if(deadline - now > spin)
+    {
+        std::this_thread::sleep_for(deadline - now - spin);
+    }
+
+    while(Clock::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
+}
+
 float computeSmoothDt(float oldDt,float dt)
 {
     constexpr double frames_to_accumulate = 5;
@@ -243,12 +293,43 @@ void EngineLoop::guardedMain()
     g_timer.frameTimeInit();
     
     float dt = 0.0166f;
+    float passTime = 0.0f;
+    int32 passFrame = 0;
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point frameDeadline = Clock::now();
+
     ETickResult result = ETickResult::Continue;
     while(ETickResult::Continue == result && !glfwWindowShouldClose(g_windowData.window) && m_run)
     {
+        // Frame limiter, paces the start of frames so input is sampled right after the wait.
+        const float requestFps = getFps();
+        if(requestFps > 0.0f)
+        {
+            const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / requestFps));
+            frameDeadline += period;
+
+            // Fell behind by more than a frame, restart the schedule instead of rushing to catch up.
+            const auto now = Clock::now();
+            if(frameDeadline + period < now)
+            {
+                frameDeadline = now;
+            }
+            waitUntil(frameDeadline);
+        }
+        else
+        {
+            frameDeadline = Clock::now();
+        }
+
+        if(cVarLowLatency.get() != 0)
+        {
+            VulkanRHI::get()->waitForPreviousFrame();
+        }
+
         glfwPollEvents();
+        VulkanRHI::get()->markInputSampled();
 
-        float requestFps = getFps();
         g_timer.frameTick();
 
         if(!g_windowData.bFoucus)
@@ -260,44 +341,22 @@ void EngineLoop::guardedMain()
             }
         }
 
-        if(requestFps > 0.0f && g_timer.frameDeltaTime() > 1.0f / requestFps)
-        {
-            g_timer.frameReset();
-            dt = m_frameCount == 0 ? 1.0f / requestFps : g_timer.frameDeltaTime();
+        g_timer.frameReset();
+        dt = m_frameCount == 0 ? (requestFps > 0.0f ? 1.0f / requestFps : dt) : g_timer.frameDeltaTime();
+        m_smooth_dt = computeSmoothDt(m_smooth_dt,dt);
+        result = m_engine.tick(dt,m_smooth_dt);
+        g_timer.frameCountAdd();
+        m_frameCount ++;
 
-            m_smooth_dt = computeSmoothDt(m_smooth_dt,dt);
-            result = m_engine.tick(dt,m_smooth_dt);
-            g_timer.frameCountAdd();
-            m_frameCount ++;
-
-            g_timer.m_currentFps = requestFps;
-            g_timer.m_currentSmoothFps = requestFps;
-        }
-        else if((EFpsMode)cVarFpsMode.get() == EFpsMode::Free)
+        passFrame++;
+        passTime += dt;
+        if(passTime >= 1.0f)
         {
-            static float passTime = 0.0f;
-            static int32_t passFrame = 0;
-
-            g_timer.frameReset();
-            dt = m_frameCount == 0 ? dt : g_timer.frameDeltaTime();
-            m_smooth_dt = computeSmoothDt(m_smooth_dt,dt);
-            result = m_engine.tick(dt,m_smooth_dt);
-            g_timer.frameCountAdd();
-
-            m_frameCount ++;
-            passFrame++;
-            passTime += dt;
-            if(passTime >= 1.0f)
-            {
-                requestFps = passFrame / passTime;
-                passTime = 0;
-                passFrame = 0;
-                g_timer.m_currentSmoothFps = requestFps;
-            }
-
-            g_timer.m_currentFps = 1.0f / dt;
-            
+            g_timer.m_currentSmoothFps = passFrame / passTime;
+            passTime = 0;
+            passFrame = 0;
         }
+        g_timer.m_currentFps = 1.0f / glm::max(dt,1e-6f);
     }
 
     VulkanRHI::get()->waitIdle();
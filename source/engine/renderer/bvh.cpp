@@ -0,0 +1,579 @@
+#include "bvh.h"
+#include "mesh.h"
+#include <xmmintrin.h>
+#include <algorithm>
+
+namespace engine{
+
+constexpr uint32 SAH_BIN_COUNT = 16;
+constexpr float  SAH_TRAVERSAL_COST = 1.0f;
+constexpr float  SAH_INTERSECT_COST = 1.0f;
+
+// NOTE: Rebuild once refitted tree cost grows past this factor of the freshly built one.
+constexpr float  SAH_REBUILD_THRESHOLD = 1.5f;
+
+AABBBounds AABBBounds::fromRenderBounds(const RenderBounds& bounds,const glm::mat4& modelMatrix)
+{
+	glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(bounds.origin,1.0f));
+	glm::vec3 extents = glm::vec3(0.0f);
+	for(uint32 i = 0; i < 3; i++)
+	{
+		for(uint32 j = 0; j < 3; j++)
+		{
+			extents[i] += glm::abs(modelMatrix[j][i]) * bounds.extents[j];
+		}
+	}
+
+	AABBBounds result;
+	result.min = center - extents;
+	result.max = center + extents;
+	return result;
+}
+
+static inline void setLane(SceneBVH::Node& node,uint32 lane,const AABBBounds& b)
+{
+	node.minX[lane] = b.min.x; node.minY[lane] = b.min.y; node.minZ[lane] = b.min.z;
+	node.maxX[lane] = b.max.x; node.maxY[lane] = b.max.y; node.maxZ[lane] = b.max.z;
+}
+
+static inline AABBBounds getLane(const SceneBVH::Node& node,uint32 lane)
+{
+	AABBBounds b;
+	b.min = glm::vec3(node.minX[lane],node.minY[lane],node.minZ[lane]);
+	b.max = glm::vec3(node.maxX[lane],node.maxY[lane],node.maxZ[lane]);
+	return b;
+}
+
+void SceneBVH::clear()
+{
+	m_nodes.clear();
+	m_primIndices.clear();
+	m_primBounds.clear();
+	m_rootBounds = {};
+	m_buildSAHCost = 0.0f;
+	m_sahCost = 0.0f;
+}
+
+AABBBounds SceneBVH::rangeBounds(BuildRange range) const
+{
+	AABBBounds b;
+	for(uint32 i = range.begin; i < range.end; i++)
+	{
+		b.expand(m_primBounds[m_primIndices[i]]);
+	}
+	return b;
+}
+
+void SceneBVH::splitRange(const std::vector<glm::vec3>& centers,BuildRange range,BuildRange& left,BuildRange& right)
+{
+	AABBBounds centerBounds;
+	for(uint32 i = range.begin; i < range.end; i++)
+	{
+		centerBounds.expand(centers[m_primIndices[i]]);
+	}
+
+	glm::vec3 extent = centerBounds.max - centerBounds.min;
+	uint32 axis = 0;
+	if(extent.y > extent[axis]) axis = 1;
+	if(extent.z > extent[axis]) axis = 2;
+
+	const uint32 mid = (range.begin + range.end) / 2;
+	auto medianSplit = [&]()
+	{
+		std::nth_element(
+			m_primIndices.begin() + range.begin,
+			m_primIndices.begin() + mid,
+			m_primIndices.begin() + range.end,
+			[&](uint32 a,uint32 b){ return centers[a][axis] < centers[b][axis]; }
+		);
+		left  = { range.begin, mid };
+		right = { mid, range.end };
+	};
+
+	if(extent[axis] <= 1e-6f)
+	{
+		medianSplit();
+		return;
+	}
+
+	struct Bin
+	{
+		AABBBounds bounds;
+		uint32 count = 0;
+	};
+	Bin bins[SAH_BIN_COUNT];
+
+	const float binScale = float(SAH_BIN_COUNT) / extent[axis];
+	const float binMin = centerBounds.min[axis];
+	auto binIndex = [&](uint32 prim)
+	{
+		uint32 id = uint32((centers[prim][axis] - binMin) * binScale);
+		return std::min(id,SAH_BIN_COUNT - 1);
+	};
+
+	for(uint32 i = range.begin; i < range.end; i++)
+	{
+		const uint32 prim = m_primIndices[i];
+		Bin& bin = bins[binIndex(prim)];
+		bin.count ++;
+		bin.bounds.expand(m_primBounds[prim]);
+	}
+
+	// sweep from right to left to get suffix areas, then evaluate each split plane from the left.
+	float rightArea[SAH_BIN_COUNT];
+	uint32 rightCount[SAH_BIN_COUNT];
+	{
+		AABBBounds acc;
+		uint32 count = 0;
+		for(uint32 i = SAH_BIN_COUNT - 1; i > 0; i--)
+		{
+			acc.expand(bins[i].bounds);
+			count += bins[i].count;
+			rightArea[i] = acc.surfaceArea();
+			rightCount[i] = count;
+		}
+	}
+
+	float bestCost = std::numeric_limits<float>::max();
+	uint32 bestSplit = 0;
+	{
+		AABBBounds acc;
+		uint32 count = 0;
+		for(uint32 i = 0; i < SAH_BIN_COUNT - 1; i++)
+		{
+			acc.expand(bins[i].bounds);
+			count += bins[i].count;
+
+			if(count == 0 || rightCount[i + 1] == 0) continue;
+
+			float cost = acc.surfaceArea() * count + rightArea[i + 1] * rightCount[i + 1];
+			if(cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i + 1;
+			}
+		}
+	}
+
+	if(bestSplit == 0)
+	{
+		medianSplit();
+		return;
+	}
+
+	auto it = std::partition(
+		m_primIndices.begin() + range.begin,
+		m_primIndices.begin() + range.end,
+		[&](uint32 prim){ return binIndex(prim) < bestSplit; }
+	);
+
+	const uint32 splitPos = uint32(it - m_primIndices.begin());
+	left  = { range.begin, splitPos };
+	right = { splitPos, range.end };
+}
+
+uint32 SceneBVH::buildNode(const std::vector<glm::vec3>& centers,BuildRange range)
+{
+	// NOTE: Collapse two levels of binary splits into up to four children.
+	BuildRange childRanges[WIDTH];
+	uint32 childCount = 0;
+
+	BuildRange halves[2];
+	splitRange(centers,range,halves[0],halves[1]);
+	for(auto& half : halves)
+	{
+		const uint32 size = half.end - half.begin;
+		if(size == 0) continue;
+
+		if(size <= MAX_LEAF_SIZE)
+		{
+			childRanges[childCount ++] = half;
+		}
+		else
+		{
+			splitRange(centers,half,childRanges[childCount],childRanges[childCount + 1]);
+			childCount += 2;
+		}
+	}
+
+	const uint32 nodeIndex = (uint32)m_nodes.size();
+	m_nodes.emplace_back();
+
+	for(uint32 lane = 0; lane < WIDTH; lane++)
+	{
+		Node& node = m_nodes[nodeIndex];
+		if(lane >= childCount || childRanges[lane].end == childRanges[lane].begin)
+		{
+			// NOTE: Empty lanes get inverted bounds so they never pass any test.
+			setLane(node,lane,AABBBounds{});
+			node.child[lane] = INVALID_INDEX;
+			node.count[lane] = 0;
+			continue;
+		}
+
+		const BuildRange childRange = childRanges[lane];
+		setLane(node,lane,rangeBounds(childRange));
+
+		const uint32 size = childRange.end - childRange.begin;
+		if(size <= MAX_LEAF_SIZE)
+		{
+			node.child[lane] = childRange.begin;
+			node.count[lane] = size;
+		}
+		else
+		{
+			// m_nodes may grow, so don't hold the reference across the recursion.
+			const uint32 childIndex = buildNode(centers,childRange);
+			m_nodes[nodeIndex].child[lane] = childIndex;
+			m_nodes[nodeIndex].count[lane] = 0;
+		}
+	}
+
+	return nodeIndex;
+}
+
+void SceneBVH::build(const std::vector<AABBBounds>& bounds)
+{
+	clear();
+	if(bounds.empty()) return;
+
+	m_primBounds = bounds;
+	m_primIndices.resize(bounds.size());
+
+	std::vector<glm::vec3> centers(bounds.size());
+	for(uint32 i = 0; i < (uint32)bounds.size(); i++)
+	{
+		m_primIndices[i] = i;
+		centers[i] = bounds[i].center();
+		m_rootBounds.expand(bounds[i]);
+	}
+
+	// rough upper bound of the node count.
+	m_nodes.reserve(bounds.size() / 2 + 1);
+	buildNode(centers,{ 0, (uint32)bounds.size() });
+
+	m_buildSAHCost = computeSAHCost();
+	m_sahCost = m_buildSAHCost;
+}
+
+AABBBounds SceneBVH::refitNode(uint32 nodeIndex)
+{
+	Node& node = m_nodes[nodeIndex];
+	AABBBounds nodeBounds;
+	for(uint32 lane = 0; lane < WIDTH; lane++)
+	{
+		if(node.child[lane] == INVALID_INDEX) continue;
+
+		AABBBounds laneBounds;
+		if(node.count[lane] > 0)
+		{
+			for(uint32 i = 0; i < node.count[lane]; i++)
+			{
+				laneBounds.expand(m_primBounds[m_primIndices[node.child[lane] + i]]);
+			}
+		}
+		else
+		{
+			// children are always allocated after the parent, see refit().
+			const Node& child = m_nodes[node.child[lane]];
+			for(uint32 c = 0; c < WIDTH; c++)
+			{
+				if(child.child[c] != INVALID_INDEX) laneBounds.expand(getLane(child,c));
+			}
+		}
+
+		setLane(node,lane,laneBounds);
+		nodeBounds.expand(laneBounds);
+	}
+	return nodeBounds;
+}
+
+void SceneBVH::refit(const std::vector<AABBBounds>& bounds)
+{
+	CHECK(bounds.size() == m_primBounds.size());
+	if(m_nodes.empty()) return;
+
+	m_primBounds = bounds;
+
+	// NOTE: Children always have a bigger index than their parent,
+	//       so a reverse walk visits them bottom-up.
+	for(int32 i = (int32)m_nodes.size() - 1; i >= 0; i--)
+	{
+		AABBBounds nodeBounds = refitNode((uint32)i);
+		if(i == 0) m_rootBounds = nodeBounds;
+	}
+
+	m_sahCost = computeSAHCost();
+}
+
+void SceneBVH::update(const std::vector<AABBBounds>& bounds)
+{
+	if(m_nodes.empty() || bounds.size() != m_primBounds.size())
+	{
+		build(bounds);
+		return;
+	}
+
+	refit(bounds);
+	if(m_sahCost > m_buildSAHCost * SAH_REBUILD_THRESHOLD)
+	{
+		build(bounds);
+	}
+}
+
+float SceneBVH::computeSAHCost() const
+{
+	const float rootArea = m_rootBounds.surfaceArea();
+	if(rootArea <= 0.0f) return 0.0f;
+
+	float cost = 0.0f;
+	for(const auto& node : m_nodes)
+	{
+		for(uint32 lane = 0; lane < WIDTH; lane++)
+		{
+			if(node.child[lane] == INVALID_INDEX) continue;
+
+			const float area = getLane(node,lane).surfaceArea();
+			cost += node.count[lane] > 0 ?
+				area * node.count[lane] * SAH_INTERSECT_COST :
+				area * SAH_TRAVERSAL_COST;
+		}
+	}
+	return cost / rootArea;
+}
+
+static inline bool aabbOutsidePlanes(const AABBBounds& b,const glm::vec4* planes,uint32 planeCount)
+{
+	for(uint32 i = 0; i < planeCount; i++)
+	{
+		const glm::vec4& p = planes[i];
+		glm::vec3 pv = glm::vec3(
+			p.x > 0.0f ? b.max.x : b.min.x,
+			p.y > 0.0f ? b.max.y : b.min.y,
+			p.z > 0.0f ? b.max.z : b.min.z
+		);
+		if(p.x * pv.x + p.y * pv.y + p.z * pv.z + p.w < 0.0f) return true;
+	}
+	return false;
+}
+
+void SceneBVH::cullPlanes(const glm::vec4* planes,uint32 planeCount,std::vector<uint32>& outVisible) const
+{
+	if(m_nodes.empty()) return;
+
+	// NOTE: Append every primitive under a node without further tests.
+	auto appendSubtree = [&](uint32 rootIndex)
+	{
+		std::vector<uint32> subStack;
+		subStack.push_back(rootIndex);
+		while(!subStack.empty())
+		{
+			const Node& node = m_nodes[subStack.back()];
+			subStack.pop_back();
+			for(uint32 lane = 0; lane < WIDTH; lane++)
+			{
+				if(node.child[lane] == INVALID_INDEX) continue;
+				if(node.count[lane] > 0)
+				{
+					for(uint32 i = 0; i < node.count[lane]; i++)
+					{
+						outVisible.push_back(m_primIndices[node.child[lane] + i]);
+					}
+				}
+				else
+				{
+					subStack.push_back(node.child[lane]);
+				}
+			}
+		}
+	};
+
+	const __m128 zero = _mm_setzero_ps();
+
+	std::vector<uint32> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+	while(!stack.empty())
+	{
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		const __m128 minX = _mm_loadu_ps(node.minX);
+		const __m128 minY = _mm_loadu_ps(node.minY);
+		const __m128 minZ = _mm_loadu_ps(node.minZ);
+		const __m128 maxX = _mm_loadu_ps(node.maxX);
+		const __m128 maxY = _mm_loadu_ps(node.maxY);
+		const __m128 maxZ = _mm_loadu_ps(node.maxZ);
+
+		__m128 outside = _mm_setzero_ps();
+		__m128 intersect = _mm_setzero_ps();
+		for(uint32 i = 0; i < planeCount; i++)
+		{
+			const glm::vec4& p = planes[i];
+
+			// NOTE: The plane is shared by all four lanes, so the p/n-vertex selection is scalar.
+			const __m128 px = _mm_set1_ps(p.x);
+			const __m128 py = _mm_set1_ps(p.y);
+			const __m128 pz = _mm_set1_ps(p.z);
+			const __m128 pw = _mm_set1_ps(p.w);
+
+			const __m128 posX = p.x > 0.0f ? maxX : minX;
+			const __m128 posY = p.y > 0.0f ? maxY : minY;
+			const __m128 posZ = p.z > 0.0f ? maxZ : minZ;
+			const __m128 negX = p.x > 0.0f ? minX : maxX;
+			const __m128 negY = p.y > 0.0f ? minY : maxY;
+			const __m128 negZ = p.z > 0.0f ? minZ : maxZ;
+
+			__m128 distPos = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px,posX),_mm_mul_ps(py,posY)),_mm_add_ps(_mm_mul_ps(pz,posZ),pw));
+			__m128 distNeg = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px,negX),_mm_mul_ps(py,negY)),_mm_add_ps(_mm_mul_ps(pz,negZ),pw));
+
+			outside   = _mm_or_ps(outside,  _mm_cmplt_ps(distPos,zero));
+			intersect = _mm_or_ps(intersect,_mm_cmplt_ps(distNeg,zero));
+		}
+
+		const int32 outsideMask = _mm_movemask_ps(outside);
+		const int32 intersectMask = _mm_movemask_ps(intersect);
+
+		for(uint32 lane = 0; lane < WIDTH; lane++)
+		{
+			if(node.child[lane] == INVALID_INDEX) continue;
+			if(outsideMask & (1 << lane)) continue;
+
+			const bool bFullyInside = (intersectMask & (1 << lane)) == 0;
+			if(node.count[lane] > 0)
+			{
+				for(uint32 i = 0; i < node.count[lane]; i++)
+				{
+					const uint32 prim = m_primIndices[node.child[lane] + i];
+					if(bFullyInside || !aabbOutsidePlanes(m_primBounds[prim],planes,planeCount))
+					{
+						outVisible.push_back(prim);
+					}
+				}
+			}
+			else if(bFullyInside)
+			{
+				appendSubtree(node.child[lane]);
+			}
+			else
+			{
+				stack.push_back(node.child[lane]);
+			}
+		}
+	}
+}
+
+// NOTE: Entry hits only. A box around the origin would always win at t = 0 and hide everything in
+//       front of it, e.g. the camera standing inside a large room mesh, so it does not count as a hit.
+static inline bool rayAABB(const AABBBounds& b,const glm::vec3& origin,const glm::vec3& invDir,float maxT,float& outT)
+{
+	glm::vec3 t0 = (b.min - origin) * invDir;
+	glm::vec3 t1 = (b.max - origin) * invDir;
+	glm::vec3 tNear = glm::min(t0,t1);
+	glm::vec3 tFar  = glm::max(t0,t1);
+
+	float tmin = glm::max(glm::max(tNear.x,tNear.y),tNear.z);
+	float tmax = glm::min(glm::min(tFar.x,tFar.y),glm::min(tFar.z,maxT));
+	outT = tmin;
+	return tmin >= 0.0f && tmin <= tmax;
+}
+
+uint32 SceneBVH::raycast(const glm::vec3& origin,const glm::vec3& dir,float maxT,float* outT) const
+{
+	if(m_nodes.empty()) return INVALID_INDEX;
+
+	// NOTE: Avoid inf * 0 = nan in the slab test for axis aligned rays.
+	auto safeInv = [](float d)
+	{
+		constexpr float big = 1e30f;
+		if(glm::abs(d) < 1e-12f) return d < 0.0f ? -big : big;
+		return 1.0f / d;
+	};
+	const glm::vec3 invDir = glm::vec3(safeInv(dir.x),safeInv(dir.y),safeInv(dir.z));
+
+	const __m128 ox = _mm_set1_ps(origin.x);
+	const __m128 oy = _mm_set1_ps(origin.y);
+	const __m128 oz = _mm_set1_ps(origin.z);
+	const __m128 ix = _mm_set1_ps(invDir.x);
+	const __m128 iy = _mm_set1_ps(invDir.y);
+	const __m128 iz = _mm_set1_ps(invDir.z);
+
+	float bestT = maxT;
+	uint32 bestPrim = INVALID_INDEX;
+
+	struct StackEntry
+	{
+		uint32 node;
+		float tmin;
+	};
+	std::vector<StackEntry> stack;
+	stack.reserve(64);
+	stack.push_back({ 0, 0.0f });
+
+	while(!stack.empty())
+	{
+		const StackEntry entry = stack.back();
+		stack.pop_back();
+		if(entry.tmin > bestT) continue;
+
+		const Node& node = m_nodes[entry.node];
+
+		__m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX),ox),ix);
+		__m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX),ox),ix);
+		__m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY),oy),iy);
+		__m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY),oy),iy);
+		__m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ),oz),iz);
+		__m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ),oz),iz);
+
+		__m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x,t1x),_mm_min_ps(t0y,t1y)),_mm_max_ps(_mm_min_ps(t0z,t1z),_mm_setzero_ps()));
+		__m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x,t1x),_mm_max_ps(t0y,t1y)),_mm_min_ps(_mm_max_ps(t0z,t1z),_mm_set1_ps(bestT)));
+
+		const int32 hitMask = _mm_movemask_ps(_mm_cmple_ps(tmin,tmax));
+		if(hitMask == 0) continue;
+
+		alignas(16) float laneTMin[WIDTH];
+		_mm_store_ps(laneTMin,tmin);
+
+		// NOTE: Push far lanes first so the nearest child is popped next.
+		uint32 order[WIDTH];
+		uint32 orderCount = 0;
+		for(uint32 lane = 0; lane < WIDTH; lane++)
+		{
+			if((hitMask & (1 << lane)) && node.child[lane] != INVALID_INDEX) order[orderCount ++] = lane;
+		}
+		for(uint32 k = 1; k < orderCount; k++)
+		{
+			for(uint32 j = k; j > 0 && laneTMin[order[j]] > laneTMin[order[j - 1]]; j--)
+			{
+				std::swap(order[j],order[j - 1]);
+			}
+		}
+
+		for(uint32 k = 0; k < orderCount; k++)
+		{
+			const uint32 lane = order[k];
+			if(node.count[lane] > 0)
+			{
+				for(uint32 i = 0; i < node.count[lane]; i++)
+				{
+					const uint32 prim = m_primIndices[node.child[lane] + i];
+					float t;
+					if(rayAABB(m_primBounds[prim],origin,invDir,bestT,t) && t < bestT)
+					{
+						bestT = t;
+						bestPrim = prim;
+					}
+				}
+			}
+			else
+			{
+				stack.push_back({ node.child[lane], laneTMin[lane] });
+			}
+		}
+	}
+
+	if(outT) *outT = bestT;
+	return bestPrim;
+}
+
+}
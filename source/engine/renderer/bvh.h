@@ -0,0 +1,98 @@
+#pragma once
+#include "../core/core.h"
+
+namespace engine{
+
+struct RenderBounds;
+
+struct AABBBounds
+{
+	glm::vec3 min = glm::vec3( std::numeric_limits<float>::max());
+	glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+	void expand(const glm::vec3& p) { min = glm::min(min,p); max = glm::max(max,p); }
+	void expand(const AABBBounds& b) { min = glm::min(min,b.min); max = glm::max(max,b.max); }
+
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+	bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
+	float surfaceArea() const
+	{
+		if(!valid()) return 0.0f;
+		glm::vec3 d = max - min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	// NOTE: Transform local RenderBounds to a world space AABB (Arvo's method).
+	static AABBBounds fromRenderBounds(const RenderBounds& bounds,const glm::mat4& modelMatrix);
+};
+
+// NOTE: 4-wide BVH. Child bounds are stored as SoA so one SIMD test covers all 4 children.
+//       build() uses a binned SAH, refit() updates bounds bottom-up after objects move,
+//       update() picks between the two and rebuilds when the tree degrades too much.
+class SceneBVH
+{
+public:
+	static constexpr uint32 WIDTH = 4;
+	static constexpr uint32 MAX_LEAF_SIZE = 4;
+	static constexpr uint32 INVALID_INDEX = ~0u;
+
+	struct Node
+	{
+		float minX[WIDTH];
+		float minY[WIDTH];
+		float minZ[WIDTH];
+		float maxX[WIDTH];
+		float maxY[WIDTH];
+		float maxZ[WIDTH];
+
+		// count == 0 : child is an inner node index.
+		// count >  0 : child is the first slot in m_primIndices.
+		// child == INVALID_INDEX : empty lane.
+		uint32 child[WIDTH];
+		uint32 count[WIDTH];
+	};
+
+	void build(const std::vector<AABBBounds>& bounds);
+	void refit(const std::vector<AABBBounds>& bounds);
+
+	// NOTE: Refit when the object count is unchanged, rebuild otherwise or when the SAH cost degrades past a threshold.
+	void update(const std::vector<AABBBounds>& bounds);
+	void clear();
+
+	// NOTE: Planes are normalized with inward normals (same as Frustum). Visible object indices are appended to outVisible.
+	void cullPlanes(const glm::vec4* planes,uint32 planeCount,std::vector<uint32>& outVisible) const;
+
+	// NOTE: Returns the closest hit object index, INVALID_INDEX on miss. Objects are hit where the ray
+	//       enters their bounds, bounds containing the origin are skipped.
+	uint32 raycast(const glm::vec3& origin,const glm::vec3& dir,float maxT,float* outT = nullptr) const;
+
+	bool empty() const { return m_nodes.empty(); }
+	uint32 getPrimitiveCount() const { return (uint32)m_primBounds.size(); }
+	uint32 getNodeCount() const { return (uint32)m_nodes.size(); }
+	float getSAHCost() const { return m_sahCost; }
+
+private:
+	struct BuildRange
+	{
+		uint32 begin;
+		uint32 end;
+	};
+
+	void splitRange(const std::vector<glm::vec3>& centers,BuildRange range,BuildRange& left,BuildRange& right);
+	uint32 buildNode(const std::vector<glm::vec3>& centers,BuildRange range);
+	AABBBounds rangeBounds(BuildRange range) const;
+	AABBBounds refitNode(uint32 nodeIndex);
+	float computeSAHCost() const;
+
+private:
+	std::vector<Node> m_nodes;
+	std::vector<uint32> m_primIndices;
+	std::vector<AABBBounds> m_primBounds;
+
+	AABBBounds m_rootBounds;
+	float m_buildSAHCost = 0.0f;
+	float m_sahCost = 0.0f;
+};
+
+}
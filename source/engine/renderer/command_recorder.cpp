@@ -0,0 +1,171 @@
+#include "command_recorder.h"
+#include "../core/job_system.h"
+#include <atomic>
+
+namespace engine{
+
+void ParallelCommandRecorder::init(uint32 backBufferCount)
+{
+	release();
+
+	const auto* device = VulkanRHI::get()->getVulkanDevice();
+	const bool bComputeFamily = device->computeFamily != device->graphicsFamily;
+
+	m_contexts.resize(backBufferCount);
+	for(auto& contexts : m_contexts)
+	{
+		for(auto& ctx : contexts)
+		{
+			createPool(ctx.graphics,device->graphicsFamily);
+			if(bComputeFamily)
+			{
+				createPool(ctx.compute,device->computeFamily);
+			}
+		}
+	}
+}
+
+void ParallelCommandRecorder::release()
+{
+	for(auto& contexts : m_contexts)
+	{
+		for(auto& ctx : contexts)
+		{
+			destroyPool(ctx.graphics);
+			destroyPool(ctx.compute);
+		}
+	}
+	m_contexts.clear();
+	m_recorded = {};
+}
+
+void ParallelCommandRecorder::createPool(CommandPool& pool,uint32 family)
+{
+	VkCommandPoolCreateInfo poolInfo { };
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = family;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	vkCheck(vkCreateCommandPool(VulkanRHI::get()->getDevice(),&poolInfo,nullptr,&pool.pool));
+}
+
+void ParallelCommandRecorder::destroyPool(CommandPool& pool)
+{
+	// Destroying the pool frees its command buffers.
+	if(pool.pool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(VulkanRHI::get()->getDevice(),pool.pool,nullptr);
+	}
+	pool = {};
+}
+
+void ParallelCommandRecorder::resetPool(CommandPool& pool)
+{
+	if(pool.usedCount > 0)
+	{
+		vkCheck(vkResetCommandPool(VulkanRHI::get()->getDevice(),pool.pool,0));
+		pool.usedCount = 0;
+	}
+}
+
+VkCommandBuffer ParallelCommandRecorder::acquire(CommandPool& pool)
+{
+	if(pool.usedCount == pool.buffers.size())
+	{
+		VkCommandBufferAllocateInfo allocInfo { };
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = pool.pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer cmd = VK_NULL_HANDLE;
+		vkCheck(vkAllocateCommandBuffers(VulkanRHI::get()->getDevice(),&allocInfo,&cmd));
+		pool.buffers.push_back(cmd);
+	}
+	return pool.buffers[pool.usedCount++];
+}
+
+VkCommandBuffer ParallelCommandRecorder::begin(CommandPool& pool)
+{
+	VkCommandBuffer cmd = acquire(pool);
+	VkCommandBufferBeginInfo cmdBeginInfo = vkCommandbufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	vkCheck(vkBeginCommandBuffer(cmd,&cmdBeginInfo));
+	return cmd;
+}
+
+ParallelCommandRecorder::CommandPool& ParallelCommandRecorder::getPool(JobContext& ctx,frame_graph::EQueueType queue)
+{
+	if(queue == frame_graph::EQueueType::AsyncCompute)
+	{
+		// The graph only moves passes off graphics when compute has its own family.
+		CHECK(ctx.compute.pool != VK_NULL_HANDLE);
+		return ctx.compute;
+	}
+	return ctx.graphics;
+}
+
+const ParallelCommandRecorder::RecordedCommands& ParallelCommandRecorder::record(
+	const frame_graph::FrameGraph& graph,
+	uint32 backBufferIndex,
+	uint32 jobCount,
+	const std::function<void(VkCommandBuffer)>& prologue)
+{
+	CHECK(backBufferIndex < m_contexts.size());
+	auto& contexts = m_contexts[backBufferIndex];
+
+	// NOTE: The back buffer's fence was waited on in acquireNextPresentImage, its buffers are idle.
+	//       The fence is signaled by the last graphics batch, which waits on every compute batch.
+	for(auto& ctx : contexts)
+	{
+		resetPool(ctx.graphics);
+		resetPool(ctx.compute);
+	}
+
+	const uint32 passCount = (uint32)graph.getExecutionOrder().size();
+	m_recorded.passes.assign(passCount,VK_NULL_HANDLE);
+
+	m_recorded.prologue = begin(contexts[0].graphics);
+	if(prologue)
+	{
+		prologue(m_recorded.prologue);
+	}
+	graph.executePrologue(m_recorded.prologue);
+	vkCheck(vkEndCommandBuffer(m_recorded.prologue));
+
+	if(passCount > 0)
+	{
+		std::atomic<uint32> nextPass { 0 };
+		auto work = [&](JobContext& ctx)
+		{
+			uint32 order;
+			while((order = nextPass.fetch_add(1)) < passCount)
+			{
+				const uint32 passIndex = graph.getExecutionOrder()[order];
+				VkCommandBuffer cmd = begin(getPool(ctx,graph.getPassQueue(passIndex)));
+				graph.executePass(order,cmd);
+				vkCheck(vkEndCommandBuffer(cmd));
+				m_recorded.passes[order] = cmd;
+			}
+		};
+
+		jobCount = glm::clamp(jobCount,1u,glm::min(passCount,MAX_JOB_COUNT));
+
+		jobsystem::Context jobContext { };
+		for(uint32 job = 1; job < jobCount; job++)
+		{
+			jobsystem::execute(jobContext,[&work,&contexts,job]()
+			{
+				work(contexts[job]);
+			});
+		}
+		work(contexts[0]);
+		jobsystem::wait(jobContext);
+	}
+
+	m_recorded.epilogue = begin(contexts[0].graphics);
+	graph.executeEpilogue(m_recorded.epilogue);
+	vkCheck(vkEndCommandBuffer(m_recorded.epilogue));
+
+	return m_recorded;
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "../vk/vk_rhi.h"
+#include "frame_graph/frame_graph.h"
+
+namespace engine{
+
+// NOTE: Records the passes of a compiled frame graph on the job system. Every job owns one command pool
+//       per back buffer and queue family, pools are externally synchronized so no two jobs ever share one.
+//       Jobs pull passes in execution order and record each into its own primary command buffer, allocated
+//       from the family of the queue the pass runs on. The buffers are submitted in that order per batch so
+//       the graph barriers keep working across buffers.
+class ParallelCommandRecorder
+{
+public:
+	static constexpr uint32 MAX_JOB_COUNT = 8;
+
+	struct RecordedCommands
+	{
+		VkCommandBuffer prologue = VK_NULL_HANDLE;  // graphics, in front of the first batch.
+		std::vector<VkCommandBuffer> passes = {};   // by execution order.
+		VkCommandBuffer epilogue = VK_NULL_HANDLE;  // graphics, after the last batch.
+	};
+
+	void init(uint32 backBufferCount);
+	void release();
+
+	// NOTE: The calling thread records the prologue, the epilogue and works as job 0. prologue goes in front
+	//       of the graph prologue. Returned buffers are valid until the next record of this back buffer.
+	const RecordedCommands& record(
+		const frame_graph::FrameGraph& graph,
+		uint32 backBufferIndex,
+		uint32 jobCount,
+		const std::function<void(VkCommandBuffer)>& prologue);
+
+private:
+	struct CommandPool
+	{
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> buffers = {};
+		uint32 usedCount = 0;
+	};
+
+	struct JobContext
+	{
+		CommandPool graphics = {};
+
+		// Only created when async compute has its own family.
+		CommandPool compute = {};
+	};
+
+	static void createPool(CommandPool& pool,uint32 family);
+	static void destroyPool(CommandPool& pool);
+	static void resetPool(CommandPool& pool);
+	static VkCommandBuffer acquire(CommandPool& pool);
+	static VkCommandBuffer begin(CommandPool& pool);
+
+	static CommandPool& getPool(JobContext& ctx,frame_graph::EQueueType queue);
+
+	// [backBufferIndex][job]
+	std::vector<std::array<JobContext,MAX_JOB_COUNT>> m_contexts = {};
+	RecordedCommands m_recorded = {};
+};
+
+}
@@ -15,7 +15,7 @@ void engine::GpuBRDFLutPass::initInner()
 
 void engine::GpuBRDFLutPass::record(uint32 backBufferIndex)
 {
-	VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+	VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
 	commandBufBegin(backBufferIndex);
 
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[backBufferIndex]);
@@ -87,7 +87,7 @@ void engine::GpuBRDFLutPass::createPipeline()
 		computePipelineCreateInfo.layout = m_pipelineLayouts[index];
 		computePipelineCreateInfo.flags = 0;
 		computePipelineCreateInfo.stage = shaderStageCI;
-		vkCheck(vkCreateComputePipelines(VulkanRHI::get()->getDevice(),nullptr,1,&computePipelineCreateInfo,nullptr,&m_pipelines[index]));
+		m_pipelines[index] = VulkanRHI::get()->createComputePipeline(computePipelineCreateInfo);
 	}
 
 	bInitPipeline = true;
@@ -99,8 +99,8 @@ void engine::GpuBRDFLutPass::destroyPipeline()
 
 	for(uint32 index = 0; index<m_pipelines.size(); index++)
 	{
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
 	}
 	m_pipelines.resize(0);
 	m_pipelineLayouts.resize(0);
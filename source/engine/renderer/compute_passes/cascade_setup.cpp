@@ -17,6 +17,7 @@ struct GpuCascadeSetupPushConstant
 	uint32 reverseZ;
 	float shadowMapSize;
 	uint32 bFixCascade;
+	uint32 updateMask; // cascades keeping their cached matrices are not written.
 };
 
 void engine::GpuCascadeSetupPass::initInner()
@@ -41,7 +42,7 @@ void engine::GpuCascadeSetupPass::afterSceneTextureRecreate()
 
 void engine::GpuCascadeSetupPass::record(uint32 backBufferIndex)
 {
-	VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+	VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
 	commandBufBegin(backBufferIndex);
 
 
@@ -51,6 +52,7 @@ void engine::GpuCascadeSetupPass::record(uint32 backBufferIndex)
 	gpuPushConstant.reverseZ = reverseZOpen();
 	gpuPushConstant.bFixCascade = cVarFixCascade.get() != 0;
 	gpuPushConstant.shadowMapSize = float(*cVarShadowMapSize);
+	gpuPushConstant.updateMask = m_renderScene->m_cascadeShadowCache.getPlan().refreshMask;
 
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[backBufferIndex]);
 
@@ -59,7 +61,7 @@ void engine::GpuCascadeSetupPass::record(uint32 backBufferIndex)
 
 	std::vector<VkDescriptorSet> compPassSets = {
 		  m_renderer->getFrameData().m_frameDataDescriptorSets[backBufferIndex].set
-		, m_renderer->getRenderScene().m_evaluateDepthMinMax.descriptorSets.set
+		, m_renderer->getRenderScene().m_evaluateDepthMinMax.descriptorSets[backBufferIndex].set
 		, m_renderer->getRenderScene().m_cascadeSetupBuffer.descriptorSets.set
 	};
 
@@ -122,7 +124,7 @@ void engine::GpuCascadeSetupPass::createPipeline()
 		computePipelineCreateInfo.layout = m_pipelineLayouts[index];
 		computePipelineCreateInfo.flags = 0;
 		computePipelineCreateInfo.stage = shaderStageCI;
-		vkCheck(vkCreateComputePipelines(VulkanRHI::get()->getDevice(),nullptr,1,&computePipelineCreateInfo,nullptr,&m_pipelines[index]));
+		m_pipelines[index] = VulkanRHI::get()->createComputePipeline(computePipelineCreateInfo);
 	}
 
 	bInitPipeline = true;
@@ -134,8 +136,8 @@ void engine::GpuCascadeSetupPass::destroyPipeline()
 
 	for(uint32 index = 0; index<m_pipelines.size(); index++)
 	{
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
 	}
 	m_pipelines.resize(0);
 	m_pipelineLayouts.resize(0);
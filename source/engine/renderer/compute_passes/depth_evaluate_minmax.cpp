@@ -31,12 +31,16 @@ void engine::GpuDepthEvaluateMinMaxPass::afterSceneTextureRecreate()
 
 void engine::GpuDepthEvaluateMinMaxPass::record(uint32 backBufferIndex)
 {
-	VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+	VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
 	commandBufBegin(backBufferIndex);
+
+	// NOTE: The graph barrier, or the queue wait on async compute, in front of this pass already orders
+	//       the depth writes, the layout transition only chains onto it. Fragment stages can't be used
+	//       here, the pass may run on a compute only queue.
 	std::array<VkImageMemoryBarrier,1> imageBarriers {};
 	imageBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	imageBarriers[0].image = m_renderScene->getSceneTextures().getDepthStencil()->getImage();
-	imageBarriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	imageBarriers[0].srcAccessMask = 0;
 	imageBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 	imageBarriers[0].subresourceRange.levelCount = 1;
 	imageBarriers[0].subresourceRange.layerCount = 1;
@@ -44,7 +48,7 @@ void engine::GpuDepthEvaluateMinMaxPass::record(uint32 backBufferIndex)
 	imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 	imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; 
 	vkCmdPipelineBarrier(cmd,
-		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 		0,0,nullptr,0,nullptr,(uint32)imageBarriers.size(), imageBarriers.data());
 
@@ -60,7 +64,7 @@ void engine::GpuDepthEvaluateMinMaxPass::record(uint32 backBufferIndex)
 
 	std::vector<VkDescriptorSet> compPassSets = {
 		  m_descriptorSets[backBufferIndex].set
-		, m_renderer->getRenderScene().m_evaluateDepthMinMax.descriptorSets.set
+		, m_renderer->getRenderScene().m_evaluateDepthMinMax.descriptorSets[backBufferIndex].set
 	};
 
 	vkCmdBindDescriptorSets(
@@ -140,7 +144,7 @@ void engine::GpuDepthEvaluateMinMaxPass::createPipeline()
 		computePipelineCreateInfo.layout = m_pipelineLayouts[index];
 		computePipelineCreateInfo.flags = 0;
 		computePipelineCreateInfo.stage = shaderStageCI;
-		vkCheck(vkCreateComputePipelines(VulkanRHI::get()->getDevice(),nullptr,1,&computePipelineCreateInfo,nullptr,&m_pipelines[index]));
+		m_pipelines[index] = VulkanRHI::get()->createComputePipeline(computePipelineCreateInfo);
 	}
 
 	bInitPipeline = true;
@@ -152,8 +156,8 @@ void engine::GpuDepthEvaluateMinMaxPass::destroyPipeline()
 
 	for(uint32 index = 0; index<m_pipelines.size(); index++)
 	{
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
 	}
 	m_pipelines.resize(0);
 	m_pipelineLayouts.resize(0);
@@ -27,6 +27,13 @@ struct PushConstant
 	int32_t mipLevel;
 };
 
+struct HZBPushConstant
+{
+	glm::uvec2 size;
+	uint32 bReverseZ;
+	int32_t mipLevel;
+};
+
 void engine::DownSamplePass::initInner()
 {
 	bInitPipeline = false;
@@ -53,47 +60,70 @@ void engine::DownSamplePass::destroyPipeline()
 
 	for(uint32 index = 0; index<m_pipelines.size(); index++)
 	{
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
 	}
 	m_pipelines.resize(0);
 	m_pipelineLayouts.resize(0);
 	bInitPipeline = false;
 }
 
+VulkanImage* engine::DownSamplePass::getTarget()
+{
+	return m_mode == EDownSampleMode::HZB ? m_renderScene->getSceneTextures().getHZB() : m_renderScene->getSceneTextures().getDownSampleChain();
+}
 
 
 void engine::DownSamplePass::record(uint32 backBufferIndex)
 {
-	VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+	VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
 	commandBufBegin(backBufferIndex);
 
 	vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_COMPUTE,m_pipelines[backBufferIndex]);
 
+	const bool bHZB = m_mode == EDownSampleMode::HZB;
+	const uint32 mipCount = (uint32)m_outputImages.size();
+	VkImage target = getTarget()->getImage();
+
 	{
-		std::array<VkImageMemoryBarrier,1> imageBarriers{};
+		std::array<VkImageMemoryBarrier,2> imageBarriers{};
 		imageBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageBarriers[0].image = m_renderScene->getSceneTextures().getDownSampleChain()->getImage();
+		imageBarriers[0].image = target;
 		imageBarriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		imageBarriers[0].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
 		imageBarriers[0].subresourceRange.baseMipLevel = 0; // We barrier mip level i
-		imageBarriers[0].subresourceRange.levelCount = g_downsampleCount;
+		imageBarriers[0].subresourceRange.levelCount = mipCount;
 		imageBarriers[0].subresourceRange.layerCount = 1;
 		imageBarriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		// NOTE: Same as the depth min max pass, the graph orders the depth writes and this only chains
+		//       the layout transition onto it. Depth stays in shader read, the late gbuffer pass takes it back.
+		imageBarriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarriers[1].image = m_renderScene->getSceneTextures().getDepthStencil()->getImage();
+		imageBarriers[1].srcAccessMask = 0;
+		imageBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		imageBarriers[1].subresourceRange.levelCount = 1;
+		imageBarriers[1].subresourceRange.layerCount = 1;
+		imageBarriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		imageBarriers[1].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		imageBarriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
 		vkCmdPipelineBarrier(
 			cmd,
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			0,
 			0,nullptr,
 			0,nullptr,
-			(uint32)imageBarriers.size(),imageBarriers.data()
+			bHZB ? 2 : 1,imageBarriers.data()
 		);
 	}
 
 	PushConstant pushData {};
+	HZBPushConstant hzbPushData {};
+	hzbPushData.bReverseZ = reverseZOpen() ? 1 : 0;
 
 	float knee = cVarBloomThreshold.get() * cVarBloomSoftThreshold.get();
 
@@ -105,8 +135,9 @@ void engine::DownSamplePass::record(uint32 backBufferIndex)
 	uint32 workingWidth = m_renderScene->getSceneTextures().getHDRSceneColor()->getInfo().extent.width;
 	uint32 workingHeight = m_renderScene->getSceneTextures().getHDRSceneColor()->getInfo().extent.height;
 
-	for(uint32 i = 0; i < g_downsampleCount; i++)
+	for(uint32 i = 0; i < mipCount; i++)
 	{
+		GpuProfileScope mipScope(cmd,bHZB ? "HZBMip" : "DownsampleMip",(int32)i);
 		pushData.mipLevel = i;
 
 		workingWidth  = std::max(1u, workingWidth  / 2);
@@ -121,31 +152,53 @@ void engine::DownSamplePass::record(uint32 backBufferIndex)
 			workingHeight
 		);
 
-		vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex], VK_SHADER_STAGE_COMPUTE_BIT, 
-			0, sizeof(PushConstant), &pushData);
+		if(bHZB)
+		{
+			hzbPushData.mipLevel = i;
+			hzbPushData.size = pushData.size;
+			vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex], VK_SHADER_STAGE_COMPUTE_BIT, 
+				0, sizeof(HZBPushConstant), &hzbPushData);
+		}
+		else
+		{
+			vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex], VK_SHADER_STAGE_COMPUTE_BIT, 
+				0, sizeof(PushConstant), &pushData);
+		}
 
-		std::vector<VkDescriptorSet> compPassSets = {
-			m_descriptorSets[backBufferIndex * g_downsampleCount + i].set,
-			m_inputDescritorSets[backBufferIndex * g_downsampleCount + i].set
-		};
+		auto output = VulkanRHI::get()->vkFrameDescriptorFactoryBegin()
+			.bindImage(0,&m_outputImages[i],VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,VK_SHADER_STAGE_COMPUTE_BIT);
+		auto input = VulkanRHI::get()->vkFrameDescriptorFactoryBegin()
+			.bindImage(0,&m_inputImages[i],VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,VK_SHADER_STAGE_COMPUTE_BIT);
 
-		vkCmdBindDescriptorSets(
-			cmd,
-			VK_PIPELINE_BIND_POINT_COMPUTE,
-			m_pipelineLayouts[backBufferIndex],
-			0,
-			(uint32)compPassSets.size(),
-			compPassSets.data(),
-			0,
-			nullptr
-		);
+		if(m_bPushDescriptor)
+		{
+			output.push(cmd,VK_PIPELINE_BIND_POINT_COMPUTE,m_pipelineLayouts[backBufferIndex],0);
+			input.push(cmd,VK_PIPELINE_BIND_POINT_COMPUTE,m_pipelineLayouts[backBufferIndex],1);
+		}
+		else
+		{
+			std::array<VkDescriptorSet,2> compPassSets = {};
+			const bool bBuilt = output.build(&compPassSets[0]) && input.build(&compPassSets[1]);
+			CHECK(bBuilt);
+
+			vkCmdBindDescriptorSets(
+				cmd,
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				m_pipelineLayouts[backBufferIndex],
+				0,
+				(uint32)compPassSets.size(),
+				compPassSets.data(),
+				0,
+				nullptr
+			);
+		}
 
 		vkCmdDispatch(cmd, getGroupCount(workingWidth , 16),getGroupCount(workingHeight, 16), 1);
 	
 
 		std::array<VkImageMemoryBarrier,1> imageBarriers{};
 		imageBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageBarriers[0].image = m_renderScene->getSceneTextures().getDownSampleChain()->getImage();
+		imageBarriers[0].image = target;
 		imageBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
 		imageBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		imageBarriers[0].subresourceRange.baseMipLevel = i; // We barrier mip level i
@@ -168,11 +221,11 @@ void engine::DownSamplePass::record(uint32 backBufferIndex)
 	{
 		std::array<VkImageMemoryBarrier,1> imageBarriers{};
 		imageBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageBarriers[0].image = m_renderScene->getSceneTextures().getDownSampleChain()->getImage();
+		imageBarriers[0].image = target;
 		imageBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
 		imageBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		imageBarriers[0].subresourceRange.baseMipLevel = 0; // We barrier mip level i
-		imageBarriers[0].subresourceRange.levelCount = g_downsampleCount;
+		imageBarriers[0].subresourceRange.levelCount = mipCount;
 		imageBarriers[0].subresourceRange.layerCount = 1;
 		imageBarriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
@@ -180,7 +233,7 @@ void engine::DownSamplePass::record(uint32 backBufferIndex)
 		vkCmdPipelineBarrier(
 			cmd,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			0,
 			0,nullptr,
 			0,nullptr,
@@ -198,84 +251,40 @@ void engine::DownSamplePass::createPipeline()
 	if(bInitPipeline) return;
 
 	uint32 backBufferCount = (uint32)VulkanRHI::get()->getSwapchainImageViews().size();
-	RenderTexture* downsampleChain = static_cast<RenderTexture*>(
-		m_renderScene->getSceneTextures().getDownSampleChain()
-	);
-
-	m_descriptorSets.resize(backBufferCount * g_downsampleCount);
-	m_descriptorSetLayouts.resize(backBufferCount);
-
-	m_inputDescritorSets.resize(backBufferCount * g_downsampleCount);
-	m_inputDescriptorSetLayouts.resize(backBufferCount);
-	for(uint32 index = 0; index < backBufferCount; index++)
+	RenderTexture* downsampleChain = static_cast<RenderTexture*>(getTarget());
+
+	// NOTE: The hzb is read with texel fetches only, the sampler doesn't matter.
+	const bool bHZB = m_mode == EDownSampleMode::HZB;
+	VkSampler sampler = bHZB ? VulkanRHI::get()->getPointClampEdgeSampler() : VulkanRHI::get()->getLinearClampNoMipSampler();
+	VkImageView source = bHZB ? 
+		m_renderScene->getSceneTextures().getDepthStencil()->getImageView() : 
+		m_renderScene->getSceneTextures().getHDRSceneColor()->getImageView();
+
+	// NOTE: Every back buffer binds the same views, so only the image infos are kept here and the
+	//       descriptors are written per frame at record time.
+	const uint32 mipCount = bHZB ? downsampleChain->getInfo().mipLevels : g_downsampleCount;
+	m_outputImages.resize(mipCount);
+	m_inputImages.resize(mipCount);
+	for(uint32 level = 0; level < mipCount; level++)
 	{
-		// For output
-		uint32 ouputIndex = index * g_downsampleCount;
-		for(uint32_t level = 0; level < downsampleChain->getInfo().mipLevels; ++level)
-		{
-			VkDescriptorImageInfo outImage = {};
-			outImage.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			outImage.imageView = downsampleChain->getMipmapView(level);
-			outImage.sampler = VulkanRHI::get()->getLinearClampNoMipSampler();
-
-			if(level==0)
-			{
-				m_renderer->vkDynamicDescriptorFactoryBegin(index)
-					.bindImage(
-						0,
-						&outImage,
-						VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-						VK_SHADER_STAGE_COMPUTE_BIT)
-					.build(m_descriptorSets[ouputIndex], m_descriptorSetLayouts[index]);
-			}
-			else
-			{
-				m_renderer->vkDynamicDescriptorFactoryBegin(index)
-					.bindImage(
-						0,
-						&outImage,
-						VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-						VK_SHADER_STAGE_COMPUTE_BIT)
-					.build(m_descriptorSets[ouputIndex]);
-			}
-			ouputIndex ++;
-		}
-
-		// For input
-		uint32 inputIndex = index * g_downsampleCount;
-
-		VkDescriptorImageInfo hdrImage = {};
-		hdrImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		hdrImage.imageView = m_renderScene->getSceneTextures().getHDRSceneColor()->getImageView();
-		hdrImage.sampler = VulkanRHI::get()->getLinearClampNoMipSampler();
-		m_renderer->vkDynamicDescriptorFactoryBegin(index)
-			.bindImage(
-				0,
-				&hdrImage,
-				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-				VK_SHADER_STAGE_COMPUTE_BIT)
-			.build(m_inputDescritorSets[inputIndex],m_inputDescriptorSetLayouts[index]);
-
-		
-		for(uint32_t level = 0; level < downsampleChain->getInfo().mipLevels - 1; ++level)
-		{
-			inputIndex ++;
-
-			VkDescriptorImageInfo inputChainImage = {};
-			inputChainImage.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			inputChainImage.imageView = downsampleChain->getMipmapView(level);
-			inputChainImage.sampler = VulkanRHI::get()->getLinearClampNoMipSampler();
-
-			m_renderer->vkDynamicDescriptorFactoryBegin(index)
-				.bindImage(
-					0,
-					&inputChainImage,
-					VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					VK_SHADER_STAGE_COMPUTE_BIT)
-				.build(m_inputDescritorSets[inputIndex]);
-		}
+		m_outputImages[level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		m_outputImages[level].imageView = downsampleChain->getMipmapView(level);
+		m_outputImages[level].sampler = sampler;
+
+		// Mip 0 reads the hdr scene color or the depth, every other mip the one above it.
+		m_inputImages[level].imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+		m_inputImages[level].imageView = level == 0 ? source : downsampleChain->getMipmapView(level - 1);
+		m_inputImages[level].sampler = sampler;
 	}
 
+	m_bPushDescriptor = VulkanRHI::get()->isPushDescriptorEnabled();
+	VulkanRHI::get()->vkFrameDescriptorFactoryBegin()
+		.bindImage(0,&m_outputImages[0],VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,VK_SHADER_STAGE_COMPUTE_BIT)
+		.buildLayout(m_outputLayout,m_bPushDescriptor);
+	VulkanRHI::get()->vkFrameDescriptorFactoryBegin()
+		.bindImage(0,&m_inputImages[0],VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.buildLayout(m_inputLayout,m_bPushDescriptor);
+
 	m_pipelines.resize(backBufferCount);
 	m_pipelineLayouts.resize(backBufferCount);
 	for(uint32 index = 0; index<backBufferCount; index++)
@@ -285,13 +294,13 @@ void engine::DownSamplePass::createPipeline()
 
 		VkPushConstantRange push_constant{};
 		push_constant.offset = 0;
-		push_constant.size = sizeof(PushConstant);
+		push_constant.size = bHZB ? sizeof(HZBPushConstant) : sizeof(PushConstant);
 		push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 		plci.pPushConstantRanges = &push_constant;
 
 		std::vector<VkDescriptorSetLayout> setLayouts = {
-			m_descriptorSetLayouts[index].layout,
-			m_inputDescriptorSetLayouts[index].layout
+			m_outputLayout.layout,
+			m_inputLayout.layout
 		};
 
 		plci.setLayoutCount = (uint32)setLayouts.size();
@@ -304,7 +313,7 @@ void engine::DownSamplePass::createPipeline()
 		const VkSpecializationInfo specializationInfo = { 1, &specializationMap, sizeof(specializationData), specializationData};
 
 
-		auto* shaderModule = VulkanRHI::get()->getShader("media/shader/fallback/bin/downsample.comp.spv", true);
+		auto* shaderModule = VulkanRHI::get()->getShader(bHZB ? "media/shader/fallback/bin/hzb.comp.spv" : "media/shader/fallback/bin/downsample.comp.spv", true);
 		VkPipelineShaderStageCreateInfo shaderStageCI{};
 		shaderStageCI.module = shaderModule->GetModule();
 		shaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -317,7 +326,7 @@ void engine::DownSamplePass::createPipeline()
 		computePipelineCreateInfo.layout = m_pipelineLayouts[index];
 		computePipelineCreateInfo.flags = 0;
 		computePipelineCreateInfo.stage = shaderStageCI;
-		vkCheck(vkCreateComputePipelines(VulkanRHI::get()->getDevice(),nullptr,1,&computePipelineCreateInfo,nullptr,&m_pipelines[index]));
+		m_pipelines[index] = VulkanRHI::get()->createComputePipeline(computePipelineCreateInfo);
 	}
 
 	bInitPipeline = true;
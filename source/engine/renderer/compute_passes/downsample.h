@@ -3,6 +3,12 @@
 
 namespace engine
 {
+	enum class EDownSampleMode
+	{
+		Bloom, // hdr scene color into the bloom downsample chain.
+		HZB,   // scene depth into the hzb, farthest depth per texel.
+	};
+
 	class DownSamplePass : public ComputePass
 	{
 	public:
@@ -10,8 +16,9 @@ namespace engine
 			Ref<Renderer> renderer,
 			Ref<RenderScene> scene,
 			Ref<shaderCompiler::ShaderCompiler> sc,
-			const std::string& name)
-			: ComputePass(renderer,scene,sc,name)
+			const std::string& name,
+			EDownSampleMode mode = EDownSampleMode::Bloom)
+			: ComputePass(renderer,scene,sc,name), m_mode(mode)
 		{
 
 		}
@@ -24,17 +31,23 @@ namespace engine
 
 	private:
 		bool bInitPipeline = false;
+		EDownSampleMode m_mode;
 
 		void createPipeline();
 		void destroyPipeline();
+
+		VulkanImage* getTarget();
 	public:
 		std::vector<VkPipeline> m_pipelines = {};
 		std::vector<VkPipelineLayout> m_pipelineLayouts = {};
-		std::vector<VulkanDescriptorSetReference> m_descriptorSets = {};
-		std::vector<VulkanDescriptorLayoutReference> m_descriptorSetLayouts = {};
 
-		std::vector<VulkanDescriptorSetReference> m_inputDescritorSets = {};
-		std::vector<VulkanDescriptorLayoutReference> m_inputDescriptorSetLayouts = {};
+		// Mip i writes m_outputImages[i] and reads m_inputImages[i], bound per dispatch either as
+		// push descriptors or as sets from the frame descriptor allocator.
+		bool m_bPushDescriptor = false;
+		VulkanDescriptorLayoutReference m_outputLayout = {};
+		VulkanDescriptorLayoutReference m_inputLayout = {};
+		std::vector<VkDescriptorImageInfo> m_outputImages = {};
+		std::vector<VkDescriptorImageInfo> m_inputImages = {};
 	};
 
 }
\ No newline at end of file
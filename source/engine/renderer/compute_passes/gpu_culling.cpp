@@ -3,14 +3,97 @@
 
 using namespace engine;
 
+static AutoCVarInt32 cVarCullingBatchStats(
+    "r.Culling.BatchStats",
+    "Log gbuffer draw count before and after instance batching once.",
+    "Culling",
+    0,
+    CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarOcclusionCulling(
+    "r.Culling.Occlusion",
+    "Two phase hzb occlusion culling of the gbuffer. 0 is off, 1 is on.",
+    "Culling",
+    1,
+    CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarMeshletConeCulling(
+    "r.Meshlet.ConeCulling",
+    "Cull meshlets facing away from the camera with their normal cone. The gbuffer draws without back face culling and materials have no double sided flag, only enable it for single sided content. 0 is off, 1 is on.",
+    "Meshlet",
+    0,
+    CVarFlags::ReadAndWrite
+);
+
+static AutoCVarFloat cVarLodErrorPixels(
+    "r.Lod.ErrorPixels",
+    "Screen space error in pixels a simplified lod may show, larger picks coarser lods.",
+    "Lod",
+    1.0f,
+    CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarLodShadowBias(
+    "r.Lod.ShadowBias",
+    "Lod levels added for shadow casters on top of the camera lod.",
+    "Lod",
+    1,
+    CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarLodStats(
+    "r.Lod.Stats",
+    "Log gbuffer and shadow triangles drawn with lods against lod #0 once.",
+    "Lod",
+    0,
+    CVarFlags::ReadAndWrite
+);
+
+static void accumulateLodStats(GPUCullingLodStats& stats,const GPUOutIndirectDrawCount& counts)
+{
+    stats.triangleCount += counts.lodTriangleCount;
+    stats.fullTriangleCount += counts.fullTriangleCount;
+    for(uint32 i = 0; i < MESH_MAX_LOD_COUNT; i++)
+    {
+        stats.objectCounts[i] += counts.lodObjectCounts[i];
+    }
+}
+
+static void logLodStats(const char* name,const GPUCullingLodStats& stats)
+{
+    const float reduction = stats.fullTriangleCount > 0 ? 
+        100.0f * (1.0f - float(stats.triangleCount) / float(stats.fullTriangleCount)) : 0.0f;
+
+    LOG_INFO("{0} lod: {1} triangles instead of {2}, {3}% less. Objects per lod {4} {5} {6} {7} {8}.",
+        name,
+        stats.triangleCount,
+        stats.fullTriangleCount,
+        reduction,
+        stats.objectCounts[0],
+        stats.objectCounts[1],
+        stats.objectCounts[2],
+        stats.objectCounts[3],
+        stats.objectCounts[4]);
+}
+
 void engine::GpuCullingPass::initInner()
 {
 	bInitPipeline = false;
     createPipeline();
+    createStatsReadback();
 
     m_deletionQueue.push([&]()
     {
 		destroyPipeline();
+
+        for(auto* buffer : m_statsReadbackBuffers)
+        {
+            buffer->unmap();
+            delete buffer;
+        }
+        m_statsReadbackBuffers.resize(0);
     });
 }
 
@@ -24,23 +107,211 @@ void engine::GpuCullingPass::afterSceneTextureRecreate()
     createPipeline();
 }
 
-void engine::GpuCullingPass::gbuffer_record(uint32 backBufferIndex)
+void engine::GpuCullingPass::createStatsReadback()
 {
-    VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
-    commandBufBegin(backBufferIndex);
+    uint32 backBufferCount = (uint32)VulkanRHI::get()->getSwapchainImageViews().size();
+    m_statsReadbackBuffers.resize(backBufferCount);
+    for(auto& buffer : m_statsReadbackBuffers)
+    {
+        // early and late phase counters, or one per cascade.
+        static_assert(CASCADE_MAX_COUNT >= 2);
+        std::array<GPUOutIndirectDrawCount,CASCADE_MAX_COUNT> zero {};
+        buffer = VulkanBuffer::create(
+            VulkanRHI::get()->getVulkanDevice(),
+            VulkanRHI::get()->getGraphicsCommandPool(),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_TO_CPU,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            sizeof(zero),
+            zero.data()
+        );
+        buffer->map();
+    }
+}
+
+// NOTE: The command buffer of this back buffer finished before we record it again,
+//       so the copy it made last time is safe to read without a stall.
+void engine::GpuCullingPass::readbackStats(uint32 backBufferIndex)
+{
+    std::array<GPUOutIndirectDrawCount,2> counts {};
+    memcpy(counts.data(),m_statsReadbackBuffers[backBufferIndex]->mapped,sizeof(counts));
+
+    for(size_t i = 0; i < counts.size(); i++)
+    {
+        auto& phase = m_batchStats.phases[i];
+        phase.visibleObjectCount = counts[i].visibleObjectCount;
+        phase.visibleBatchCount = counts[i].visibleBatchCount;
+        phase.frustumCulledObjectCount = counts[i].frustumCulledObjectCount;
+        phase.occlusionCulledObjectCount = counts[i].occlusionCulledObjectCount;
+        phase.visibleClusterCount = counts[i].clusterDrawCount + counts[i].clusterDrawCount16;
+        phase.frustumCulledClusterCount = counts[i].frustumCulledClusterCount;
+        phase.coneCulledClusterCount = counts[i].coneCulledClusterCount;
+        phase.occlusionCulledClusterCount = counts[i].occlusionCulledClusterCount;
+    }
+    const auto& early = m_batchStats.phases[0];
+    const auto& late = m_batchStats.phases[1];
+
+    m_batchStats.objectCount = (uint32)m_renderScene->m_cacheMeshObjectSSBOData.size();
+    m_batchStats.batchCount = (uint32)m_renderScene->m_cacheDrawBatchSSBOData.size();
+    m_batchStats.visibleObjectCount = early.visibleObjectCount + late.visibleObjectCount;
+    m_batchStats.visibleBatchCount = early.visibleBatchCount + late.visibleBatchCount;
+
+    // NOTE: Both phases run the same frustum and cone tests, the early counts are the ones of the frame.
+    m_batchStats.clusterObjectCount = m_renderScene->m_clusterObjectCount;
+    m_batchStats.clusterCount = m_renderScene->m_clusterMeshletCounts[0] + m_renderScene->m_clusterMeshletCounts[1];
+    m_batchStats.visibleClusterCount = early.visibleClusterCount + late.visibleClusterCount;
+    m_batchStats.frustumCulledClusterCount = early.frustumCulledClusterCount;
+    m_batchStats.coneCulledClusterCount = early.coneCulledClusterCount;
+
+    m_batchStats.gbufferLod = {};
+    accumulateLodStats(m_batchStats.gbufferLod,counts[0]);
+    accumulateLodStats(m_batchStats.gbufferLod,counts[1]);
+
+    if(cVarCullingBatchStats.get() != 0)
+    {
+        LOG_INFO("Gbuffer culling: {0} objects in {1} batches, visible draws {2} without batching, {3} with batching.",
+            m_batchStats.objectCount,
+            m_batchStats.batchCount,
+            m_batchStats.visibleObjectCount,
+            m_batchStats.visibleBatchCount);
+        LOG_INFO("Gbuffer cluster culling: {0} objects with {1} meshlets, {2} tested, {3} visible, {4} frustum culled, {5} cone culled.",
+            m_batchStats.clusterObjectCount,
+            m_batchStats.clusterCount,
+            counts[0].testedClusterCount,
+            m_batchStats.visibleClusterCount,
+            m_batchStats.frustumCulledClusterCount,
+            m_batchStats.coneCulledClusterCount);
+        LOG_INFO("Gbuffer occlusion culling: early phase drew {0} objects and {1} meshlets, {2} objects and {3} meshlets not visible last frame. "
+            "Late phase drew {4} objects and {5} meshlets, {6} objects and {7} meshlets occluded.",
+            early.visibleObjectCount,
+            early.visibleClusterCount,
+            early.occlusionCulledObjectCount,
+            early.occlusionCulledClusterCount,
+            late.visibleObjectCount,
+            late.visibleClusterCount,
+            late.occlusionCulledObjectCount,
+            late.occlusionCulledClusterCount);
+        cVarCullingBatchStats.set(0);
+    }
+
+    if(cVarLodStats.get() != 0)
+    {
+        logLodStats("Gbuffer",m_batchStats.gbufferLod);
+    }
+}
+
+void engine::GpuCullingPass::readbackCascadeStats(uint32 backBufferIndex)
+{
+    std::array<GPUOutIndirectDrawCount,CASCADE_MAX_COUNT> counts {};
+    memcpy(counts.data(),m_statsReadbackBuffers[backBufferIndex]->mapped,sizeof(counts));
+
+    m_batchStats.shadowLod = {};
+    for(const auto& cascadeCounts : counts)
+    {
+        accumulateLodStats(m_batchStats.shadowLod,cascadeCounts);
+    }
+
+    // NOTE: The cascade culling records after the gbuffer, it resets the cvar for both.
+    if(cVarLodStats.get() != 0)
+    {
+        logLodStats("Shadow",m_batchStats.shadowLod);
+        cVarLodStats.set(0);
+    }
+}
 
-	GPUCullingPushConstants gpuPushConstant = {};
-	gpuPushConstant.drawCount = (uint32)m_renderScene->m_cacheMeshObjectSSBOData.size();
-    gpuPushConstant.cullIndex = static_cast<uint32>(ECullIndex::GBUFFER);
+void engine::GpuCullingPass::dispatchCulling(
+    VkCommandBuffer& cmd,
+    uint32 backBufferIndex,
+    ECullIndex cullIndex,
+    RenderScene::DrawIndirectBuffer& drawIndirectBuffer,
+    EOcclusionPhase phase,
+    EShadowCasters casters)
+{
+    auto& visibility = m_renderScene->m_occlusionVisibility;
+    auto& sceneTextures = m_renderScene->getSceneTextures();
+
+    GPUCullingPushConstants gpuPushConstant = {};
+    gpuPushConstant.drawCount = (uint32)m_renderScene->m_cacheMeshObjectSSBOData.size();
+    gpuPushConstant.cullIndex = static_cast<uint32>(cullIndex);
+    gpuPushConstant.batchCount = (uint32)m_renderScene->m_cacheDrawBatchSSBOData.size();
+    gpuPushConstant.stage = 0;
+
+    // NOTE: Only the gbuffer draws clusters, the object stage skips clustered objects there.
+    gpuPushConstant.clusterCapacity = m_renderScene->m_clusterObjectCount > 0 ? drawIndirectBuffer.clusterCapacity : 0;
+    gpuPushConstant.clusterInstanceBase = MAX_SSBO_OBJECTS;
+    gpuPushConstant.bConeCulling = cVarMeshletConeCulling.get() != 0 ? 1 : 0;
+    gpuPushConstant.phase = static_cast<uint32>(phase);
+    gpuPushConstant.depthSize = glm::uvec2(sceneTextures.getDepthStencil()->getExtent().width,sceneTextures.getDepthStencil()->getExtent().height);
+
+    // NOTE: Pixels covered by one unit of world size at distance one, over the allowed error. The shader
+    //       scales it with radius over distance, so error * size > 1 means the lod error shows.
+    const float fovy = m_renderer->getGPUFrameData().cameraInfo.x;
+    const float errorPixels = glm::max(cVarLodErrorPixels.get(),0.01f);
+    //       With r.Lod.Enable off the batches only hold lod #0.
+    gpuPushConstant.lodScale = float(gpuPushConstant.depthSize.y) / (2.0f * glm::tan(fovy * 0.5f)) / errorPixels;
+    gpuPushConstant.lodBias = cullIndex == ECullIndex::GBUFFER ? 0 : glm::max(cVarLodShadowBias.get(),0);
+    gpuPushConstant.casterMask = static_cast<uint32>(casters);
+
+    // NOTE: Without occlusion culling the early phase draws everything in the frustum and the late
+    //       phase still runs to reset its draws, it just culls no object.
+    if(phase == EOcclusionPhase::Late && cVarOcclusionCulling.get() == 0)
+    {
+        gpuPushConstant.drawCount = 0;
+    }
+
+    // NOTE: Everything counts as not visible last frame at first, the late phase draws it.
+    if(phase == EOcclusionPhase::Early && visibility.bNeedClear)
+    {
+        vkCmdFillBuffer(cmd,visibility.objectBuffer->GetVkBuffer(),0,visibility.objectSize,0);
+        vkCmdFillBuffer(cmd,visibility.clusterBuffer->GetVkBuffer(),0,visibility.clusterSize,0);
+
+        VkMemoryBarrier clearBarrier {};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd,VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,0,1,&clearBarrier,0,nullptr,0,nullptr);
+        visibility.bNeedClear = false;
+    }
 
     vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[backBufferIndex]);
-    vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullingPushConstants), &gpuPushConstant);
-    
+
+    VkDescriptorBufferInfo meshletBufInfo = {};
+    meshletBufInfo.buffer = MeshLibrary::get()->getMeshletBuffer();
+    meshletBufInfo.offset = 0;
+    meshletBufInfo.range = VK_WHOLE_SIZE;
+
+    VkDescriptorBufferInfo objectVisibilityBufInfo = {};
+    objectVisibilityBufInfo.buffer = visibility.objectBuffer->GetVkBuffer();
+    objectVisibilityBufInfo.offset = 0;
+    objectVisibilityBufInfo.range = visibility.objectSize;
+
+    VkDescriptorBufferInfo clusterVisibilityBufInfo = {};
+    clusterVisibilityBufInfo.buffer = visibility.clusterBuffer->GetVkBuffer();
+    clusterVisibilityBufInfo.offset = 0;
+    clusterVisibilityBufInfo.range = visibility.clusterSize;
+
+    // NOTE: Only the late phase reads the hzb, it is in shader read outside of its build.
+    VkDescriptorImageInfo hzbImageInfo = {};
+    hzbImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    hzbImageInfo.imageView = sceneTextures.getHZB()->getImageView();
+    hzbImageInfo.sampler = VulkanRHI::get()->getPointClampEdgeSampler();
+
+    VkDescriptorSet meshletSet = VK_NULL_HANDLE;
+    const bool bBuilt = VulkanRHI::get()->vkFrameDescriptorFactoryBegin()
+        .bindBuffer(0,&meshletBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+        .bindBuffer(1,&objectVisibilityBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+        .bindBuffer(2,&clusterVisibilityBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+        .bindImage(3,&hzbImageInfo,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,VK_SHADER_STAGE_COMPUTE_BIT)
+        .build(&meshletSet);
+    CHECK(bBuilt);
+
     std::vector<VkDescriptorSet> compPassSets = {
           m_renderer->getFrameData().m_frameDataDescriptorSets[backBufferIndex].set
         , m_renderer->getRenderScene().m_meshObjectSSBO->descriptorSets.set
-        , m_renderer->getRenderScene().m_drawIndirectSSBOGbuffer.descriptorSets.set
-        , m_renderer->getRenderScene().m_drawIndirectSSBOGbuffer.countDescriptorSets.set
+        , drawIndirectBuffer.descriptorSets.set
+        , drawIndirectBuffer.countDescriptorSets.set
+        , m_renderer->getRenderScene().m_drawBatchSSBO->descriptorSets.set
+        , meshletSet
     };
 
     vkCmdBindDescriptorSets(
@@ -54,13 +325,107 @@ void engine::GpuCullingPass::gbuffer_record(uint32 backBufferIndex)
         nullptr
     );
 
+    // 1. reset every batch draw to zero instances.
+    vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullingPushConstants), &gpuPushConstant);
+    vkCmdDispatch(cmd, (gpuPushConstant.batchCount / 256) + 1, 1, 1);
+
+    std::array<VkBufferMemoryBarrier,2> bufferBarriers {};
+    bufferBarriers[0].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarriers[0].buffer = drawIndirectBuffer.drawIndirectSSBO->GetVkBuffer();
+    bufferBarriers[0].size = drawIndirectBuffer.size;
+    bufferBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    bufferBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    bufferBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarriers[1] = bufferBarriers[0];
+    bufferBarriers[1].buffer = drawIndirectBuffer.countBuffer->GetVkBuffer();
+    bufferBarriers[1].size = drawIndirectBuffer.countSize;
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0,
+        nullptr,
+        (uint32)bufferBarriers.size(),bufferBarriers.data(),
+        0,
+        nullptr
+    );
+
+    // 2. cull objects and append the visible ones to their batch.
+    gpuPushConstant.stage = 1;
+    vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullingPushConstants), &gpuPushConstant);
     vkCmdDispatch(cmd, (gpuPushConstant.drawCount / 256) + 1, 1, 1);
+
+    // 3. one workgroup per object, clustered ones cull their meshlets into the cluster draws.
+    //    Only the counters are shared with the object stage, they are atomics so no barrier.
+    if(gpuPushConstant.clusterCapacity > 0 && gpuPushConstant.drawCount > 0)
+    {
+        gpuPushConstant.stage = 2;
+        vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullingPushConstants), &gpuPushConstant);
+        vkCmdDispatch(cmd, gpuPushConstant.drawCount, 1, 1);
+    }
+}
+
+void engine::GpuCullingPass::gbuffer_record(uint32 backBufferIndex)
+{
+    VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
+    commandBufBegin(backBufferIndex);
+
+    const EOcclusionPhase phase = cVarOcclusionCulling.get() != 0 ? EOcclusionPhase::Early : EOcclusionPhase::None;
+    dispatchCulling(cmd,backBufferIndex,ECullIndex::GBUFFER,m_renderer->getRenderScene().m_drawIndirectSSBOGbuffer,phase);
+
+    commandBufEnd(backBufferIndex);
+}
+
+void engine::GpuCullingPass::gbuffer_late_record(uint32 backBufferIndex)
+{
+    VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
+    readbackStats(backBufferIndex);
+    commandBufBegin(backBufferIndex);
+
+    auto& earlyBuffer = m_renderer->getRenderScene().m_drawIndirectSSBOGbuffer;
+    auto& lateBuffer = m_renderer->getRenderScene().m_drawIndirectSSBOGbufferLate;
+    dispatchCulling(cmd,backBufferIndex,ECullIndex::GBUFFER,lateBuffer,EOcclusionPhase::Late);
+
+    // copy the draw counters of both phases out for the batch stats. The early culling ran before
+    // on the same queue, the barrier covers its writes as well.
+    std::array<VkBufferMemoryBarrier,2> countBarriers {};
+    countBarriers[0].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    countBarriers[0].buffer = earlyBuffer.countBuffer->GetVkBuffer();
+    countBarriers[0].size = earlyBuffer.countSize;
+    countBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    countBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    countBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    countBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    countBarriers[1] = countBarriers[0];
+    countBarriers[1].buffer = lateBuffer.countBuffer->GetVkBuffer();
+    countBarriers[1].size = lateBuffer.countSize;
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0,
+        nullptr,
+        (uint32)countBarriers.size(),countBarriers.data(),
+        0,
+        nullptr
+    );
+
+    VkBufferCopy copyRegion {};
+    copyRegion.size = sizeof(GPUOutIndirectDrawCount);
+    vkCmdCopyBuffer(cmd,earlyBuffer.countBuffer->GetVkBuffer(),m_statsReadbackBuffers[backBufferIndex]->GetVkBuffer(),1,&copyRegion);
+    copyRegion.dstOffset = sizeof(GPUOutIndirectDrawCount);
+    vkCmdCopyBuffer(cmd,lateBuffer.countBuffer->GetVkBuffer(),m_statsReadbackBuffers[backBufferIndex]->GetVkBuffer(),1,&copyRegion);
+
     commandBufEnd(backBufferIndex);
 }
 
 void engine::GpuCullingPass::cascade_record(uint32 backBufferIndex)
 {
-    VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+    VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
+    readbackCascadeStats(backBufferIndex);
     commandBufBegin(backBufferIndex);
 
     std::array<VkBufferMemoryBarrier,1> bufferBarriers {};
@@ -72,7 +437,7 @@ void engine::GpuCullingPass::cascade_record(uint32 backBufferIndex)
     vkCmdPipelineBarrier(
         cmd,
         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
         0,
         0,
         nullptr,
@@ -83,43 +448,77 @@ void engine::GpuCullingPass::cascade_record(uint32 backBufferIndex)
 
     for(size_t i = 0; i < CASCADE_MAX_COUNT; i++)
     {
+        GpuProfileScope cascadeScope(cmd,"CullCascade",(int32)i);
         cascade_record(cmd,backBufferIndex,ECullIndex(i + 1));
     }
 
+    // NOTE: Virtual shadow pages draw every caster, the page matrices and scissors clip them.
+    //       Cascade culling does no spatial test, so the cascade #0 path gives the full list.
+    if(!m_renderScene->m_virtualShadowMap.getPlan().renders.empty())
+    {
+        GpuProfileScope virtualScope(cmd,"CullVirtualShadow");
+        dispatchCulling(cmd,backBufferIndex,ECullIndex::CASCADE_0,m_renderScene->m_drawIndirectSSBOVirtualShadow,EOcclusionPhase::None);
+    }
+
+    // copy the draw counters of every cascade out for the lod stats.
+    std::array<VkBufferMemoryBarrier,CASCADE_MAX_COUNT> countBarriers {};
+    for(uint32 i = 0; i < CASCADE_MAX_COUNT; i++)
+    {
+        const auto& drawIndirectBuffer = m_renderScene->m_drawIndirectSSBOShadowDepths[i];
+        countBarriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        countBarriers[i].buffer = drawIndirectBuffer.countBuffer->GetVkBuffer();
+        countBarriers[i].size = drawIndirectBuffer.countSize;
+        countBarriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        countBarriers[i].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        countBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        countBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0,
+        nullptr,
+        (uint32)countBarriers.size(),countBarriers.data(),
+        0,
+        nullptr
+    );
+
+    for(uint32 i = 0; i < CASCADE_MAX_COUNT; i++)
+    {
+        VkBufferCopy copyRegion {};
+        copyRegion.size = sizeof(GPUOutIndirectDrawCount);
+        copyRegion.dstOffset = i * sizeof(GPUOutIndirectDrawCount);
+        vkCmdCopyBuffer(cmd,m_renderScene->m_drawIndirectSSBOShadowDepths[i].countBuffer->GetVkBuffer(),m_statsReadbackBuffers[backBufferIndex]->GetVkBuffer(),1,&copyRegion);
+    }
+
     commandBufEnd(backBufferIndex);
 }
 
 void engine::GpuCullingPass::cascade_record(VkCommandBuffer& cmd,uint32 backBufferIndex,ECullIndex cullIndex)
 {
     uint32 cascasdeIndex = cullingIndexToCasacdeIndex(cullIndex);
+    auto& renderScene = m_renderer->getRenderScene();
 
-    GPUCullingPushConstants gpuPushConstant = {};
-    gpuPushConstant.drawCount = (uint32)m_renderScene->m_cacheMeshObjectSSBOData.size();
-    gpuPushConstant.cullIndex = static_cast<uint32>(cullIndex); 
-   
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[backBufferIndex]);
-
-    vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex], VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullingPushConstants), &gpuPushConstant);
-
-    std::vector<VkDescriptorSet> compPassSets = {
-          m_renderer->getFrameData().m_frameDataDescriptorSets[backBufferIndex].set
-        , m_renderer->getRenderScene().m_meshObjectSSBO->descriptorSets.set
-        , m_renderer->getRenderScene().m_drawIndirectSSBOShadowDepths[cascasdeIndex].descriptorSets.set
-        , m_renderer->getRenderScene().m_drawIndirectSSBOShadowDepths[cascasdeIndex].countDescriptorSets.set
-    };
-
-    vkCmdBindDescriptorSets(
-        cmd,
-        VK_PIPELINE_BIND_POINT_COMPUTE, 
-        m_pipelineLayouts[backBufferIndex], 
-        0, 
-        (uint32)compPassSets.size(), 
-        compPassSets.data(), 
-        0, 
-        nullptr
-    );
+    const auto& plan = renderScene.m_cascadeShadowCache.getPlan();
+    if(!plan.bEnable)
+    {
+        dispatchCulling(cmd,backBufferIndex,cullIndex,renderScene.m_drawIndirectSSBOShadowDepths[cascasdeIndex],EOcclusionPhase::None);
+        return;
+    }
 
-    vkCmdDispatch(cmd, (gpuPushConstant.drawCount / 256) + 1, 1, 1);
+    // NOTE: Static casters only when the cascade redraws its cache, dynamic ones whenever they are
+    //       drawn over it. Cascades doing neither keep their depth and skip culling.
+    const uint32 cascadeBit = 1u << cascasdeIndex;
+    if((plan.refreshMask & cascadeBit) != 0)
+    {
+        dispatchCulling(cmd,backBufferIndex,cullIndex,renderScene.m_drawIndirectSSBOShadowDepths[cascasdeIndex],EOcclusionPhase::None,EShadowCasters::Static);
+    }
+    if(plan.bDynamicCasters && (plan.compositeMask & cascadeBit) != 0)
+    {
+        dispatchCulling(cmd,backBufferIndex,cullIndex,renderScene.m_drawIndirectSSBOShadowDynamic[cascasdeIndex],EOcclusionPhase::None,EShadowCasters::Dynamic);
+    }
 }
 
 void engine::GpuCullingPass::createPipeline()
@@ -127,6 +526,16 @@ void engine::GpuCullingPass::createPipeline()
     if(bInitPipeline) return;
 
     uint32 backBufferCount = (uint32)VulkanRHI::get()->getSwapchainImageViews().size();
+
+    VkDescriptorBufferInfo meshletBufInfo = {};
+    VkDescriptorImageInfo hzbImageInfo = {};
+    VulkanRHI::get()->vkFrameDescriptorFactoryBegin()
+        .bindBuffer(0,&meshletBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+        .bindBuffer(1,&meshletBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+        .bindBuffer(2,&meshletBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+        .bindImage(3,&hzbImageInfo,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,VK_SHADER_STAGE_COMPUTE_BIT)
+        .buildLayout(m_meshletLayout);
+
     m_pipelines.resize(backBufferCount);
     m_pipelineLayouts.resize(backBufferCount);
     for(uint32 index = 0; index < backBufferCount; index++)
@@ -146,6 +555,8 @@ void engine::GpuCullingPass::createPipeline()
             , m_renderer->getRenderScene().m_meshObjectSSBO->descriptorSetLayout.layout
             , m_renderer->getRenderScene().m_drawIndirectSSBOGbuffer.descriptorSetLayout.layout
             , m_renderer->getRenderScene().m_drawIndirectSSBOGbuffer.countDescriptorSetLayout.layout
+            , m_renderer->getRenderScene().m_drawBatchSSBO->descriptorSetLayout.layout
+            , m_meshletLayout.layout
         };
 
         plci.setLayoutCount = (uint32)setLayouts.size();
@@ -165,7 +576,7 @@ void engine::GpuCullingPass::createPipeline()
         computePipelineCreateInfo.layout = m_pipelineLayouts[index];
         computePipelineCreateInfo.flags = 0;
         computePipelineCreateInfo.stage = shaderStageCI;
-        vkCheck(vkCreateComputePipelines(VulkanRHI::get()->getDevice(), nullptr, 1, &computePipelineCreateInfo, nullptr, &m_pipelines[index]));
+        m_pipelines[index] = VulkanRHI::get()->createComputePipeline(computePipelineCreateInfo);
     }
 
     bInitPipeline = true;
@@ -177,8 +588,8 @@ void engine::GpuCullingPass::destroyPipeline()
 
     for(uint32 index = 0; index < m_pipelines.size(); index++)
     {
-        vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-        vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+        VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+        VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
     }
     m_pipelines.resize(0);
     m_pipelineLayouts.resize(0);
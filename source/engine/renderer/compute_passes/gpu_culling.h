@@ -17,11 +17,89 @@ inline uint32 cullingIndexToCasacdeIndex(ECullIndex e)
 	return static_cast<uint32>(e) - 1;
 }
 
+// NOTE: Two phase occlusion culling of the gbuffer. The early phase draws what was visible last frame,
+//       the hzb is built from its depth and the late phase draws what became visible against it.
+enum class EOcclusionPhase
+{
+	None  = 0, // frustum only, cascades and the gbuffer with occlusion culling off.
+	Early = 1,
+	Late  = 2,
+};
+
+// NOTE: Casters a cascade culling appends, the shadow cache culls static and dynamic ones apart.
+enum class EShadowCasters
+{
+	Static  = 1,
+	Dynamic = 2,
+	All     = 3,
+};
+
 struct GPUCullingPushConstants 
 {
 	uint32 drawCount;
 
 	uint32 cullIndex;
+
+	uint32 batchCount;
+
+	uint32 stage; // 0 reset batch draws, 1 culling, 2 cluster culling.
+
+	uint32 clusterCapacity;     // cluster draws per index width, 0 skips the cluster stage.
+	uint32 clusterInstanceBase; // first cluster draw and instance id slot.
+	uint32 bConeCulling;
+	uint32 phase;               // EOcclusionPhase.
+
+	glm::uvec2 depthSize;       // scene depth the hzb was built from.
+
+	float lodScale;             // depth pixels per unit of projected size over the error threshold, 0 keeps lod #0.
+	int32 lodBias;              // levels added to the selected lod.
+
+	uint32 casterMask;          // EShadowCasters, cascades only.
+	uint32 pad0;
+	uint32 pad1;
+	uint32 pad2;
+};
+
+// NOTE: What one occlusion phase drew and culled.
+struct GPUCullingPhaseStats
+{
+	uint32 visibleObjectCount = 0;  // clustered objects count when any of their meshlets is drawn.
+	uint32 visibleBatchCount = 0;
+	uint32 frustumCulledObjectCount = 0;
+	uint32 occlusionCulledObjectCount = 0;
+
+	uint32 visibleClusterCount = 0;
+	uint32 frustumCulledClusterCount = 0;
+	uint32 coneCulledClusterCount = 0;
+	uint32 occlusionCulledClusterCount = 0;
+};
+
+// NOTE: Triangles drawn with the selected lods against drawing every visible object at lod #0.
+struct GPUCullingLodStats
+{
+	uint32 triangleCount = 0;     // clustered objects drawn per meshlet are not counted.
+	uint32 fullTriangleCount = 0;
+	std::array<uint32,MESH_MAX_LOD_COUNT> objectCounts = {}; // visible objects per lod.
+};
+
+// NOTE: Draw counts of the last finished gbuffer culling, readback is some frames late.
+struct GPUCullingBatchStats
+{
+	uint32 objectCount = 0;        // draws without instance batching.
+	uint32 batchCount = 0;         // draws with instance batching.
+	uint32 visibleObjectCount = 0; // both phases.
+	uint32 visibleBatchCount = 0;
+
+	uint32 clusterObjectCount = 0; // objects culled per meshlet.
+	uint32 clusterCount = 0;       // their meshlets.
+	uint32 visibleClusterCount = 0;
+	uint32 frustumCulledClusterCount = 0;
+	uint32 coneCulledClusterCount = 0;
+
+	std::array<GPUCullingPhaseStats,2> phases = {}; // early, late.
+
+	GPUCullingLodStats gbufferLod = {}; // both phases.
+	GPUCullingLodStats shadowLod = {};  // every cascade, filled by the cascade culling pass. Cached cascades count their last refresh.
 };
 
 class GpuCullingPass : public ComputePass
@@ -40,6 +118,11 @@ public:
 	void gbuffer_record(uint32 backBufferIndex);
 	void cascade_record(uint32 backBufferIndex);
 
+	// Late occlusion phase against the hzb, also reads back the counters of both phases.
+	void gbuffer_late_record(uint32 backBufferIndex);
+
+	const GPUCullingBatchStats& getBatchStats() const { return m_batchStats; }
+
 private:
 	bool bInitPipeline = false;
 
@@ -48,6 +131,27 @@ private:
 
 	void cascade_record(VkCommandBuffer& cmd,uint32 backBufferIndex,ECullIndex cullIndex);
 
+	// reset batch draws, then cull visible objects into them.
+	void dispatchCulling(
+		VkCommandBuffer& cmd,
+		uint32 backBufferIndex,
+		ECullIndex cullIndex,
+		RenderScene::DrawIndirectBuffer& drawIndirectBuffer,
+		EOcclusionPhase phase,
+		EShadowCasters casters = EShadowCasters::All);
+
+	void createStatsReadback();
+	void readbackStats(uint32 backBufferIndex);
+	void readbackCascadeStats(uint32 backBufferIndex);
+
+	// Meshlet heap, occlusion visibility and hzb at set 5. The heap buffer is replaced when it grows
+	// and the hzb with the scene textures, so the set is built per frame.
+	VulkanDescriptorLayoutReference m_meshletLayout = {};
+
+	// one counter block per cascade, the gbuffer uses the first two for its phases.
+	std::vector<VulkanBuffer*> m_statsReadbackBuffers = {};
+	GPUCullingBatchStats m_batchStats = {};
+
 public:
 	std::vector<VkPipeline> m_pipelines = {};
 	std::vector<VkPipelineLayout> m_pipelineLayouts = {};
@@ -22,7 +22,7 @@ void engine::GpuIrradiancePrefilterPass::initInner()
 
 void engine::GpuIrradiancePrefilterPass::record(uint32 backBufferIndex)
 {
-	VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+	VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
 	commandBufBegin(backBufferIndex);
 
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[backBufferIndex]);
@@ -107,7 +107,7 @@ void engine::GpuIrradiancePrefilterPass::createPipeline()
 		computePipelineCreateInfo.layout = m_pipelineLayouts[index];
 		computePipelineCreateInfo.flags = 0;
 		computePipelineCreateInfo.stage = shaderStageCI;
-		vkCheck(vkCreateComputePipelines(VulkanRHI::get()->getDevice(),nullptr,1,&computePipelineCreateInfo,nullptr,&m_pipelines[index]));
+		m_pipelines[index] = VulkanRHI::get()->createComputePipeline(computePipelineCreateInfo);
 	}
 
 	bInitPipeline = true;
@@ -119,8 +119,8 @@ void engine::GpuIrradiancePrefilterPass::destroyPipeline()
 
 	for(uint32 index = 0; index<m_pipelines.size(); index++)
 	{
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
 	}
 	m_pipelines.resize(0);
 	m_pipelineLayouts.resize(0);
@@ -0,0 +1,167 @@
+#include "pmx_skinning.h"
+#include "../renderer.h"
+#include "../../scene/components/pmx_mesh_component.h"
+using namespace engine;
+
+static AutoCVarInt32 cVarPMXSkinningStats(
+	"r.PMX.Skinning.Stats",
+	"Log skinned pmx components, vertices and per frame upload once.",
+	"PMX",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+void engine::GpuPMXSkinningPass::initInner()
+{
+	bInitPipeline = false;
+	createPipeline();
+	m_deletionQueue.push([&]()
+	{
+		destroyPipeline();
+	});
+}
+
+void engine::GpuPMXSkinningPass::beforeSceneTextureRecreate()
+{
+	destroyPipeline();
+}
+
+void engine::GpuPMXSkinningPass::afterSceneTextureRecreate()
+{
+	createPipeline();
+}
+
+void engine::GpuPMXSkinningPass::record(uint32 backBufferIndex)
+{
+	VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
+	commandBufBegin(backBufferIndex);
+
+	const auto& pmxComponents = m_renderScene->m_cachePMXMeshComponents;
+	if(pmxComponents.empty())
+	{
+		commandBufEnd(backBufferIndex);
+		return;
+	}
+
+	// NOTE: The draws of the last frame read the vertex buffers on the same queue.
+	VkMemoryBarrier memoryBarrier {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,1,&memoryBarrier,0,nullptr,0,nullptr);
+
+	vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_COMPUTE,m_pipelines[backBufferIndex]);
+
+	uint32 componentCount = 0;
+	uint64 vertexCount = 0;
+	uint64 uploadSize = 0;
+	for(const auto& pmxWeakPtr : pmxComponents)
+	{
+		if(auto pmxComp = pmxWeakPtr.lock())
+		{
+			pmxComp->OnSkinningCollect(cmd,m_pipelineLayouts[backBufferIndex],backBufferIndex);
+
+			componentCount++;
+			vertexCount += pmxComp->getSkinVertexCount();
+			uploadSize += pmxComp->getFrameUploadSize();
+		}
+	}
+
+	// NOTE: The pmx pass and the shadow depth passes draw the skinned vertices.
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0,1,&memoryBarrier,0,nullptr,0,nullptr);
+
+	if(cVarPMXSkinningStats.get() != 0)
+	{
+		// the full vertex upload of cpu skinning, see getPMXMeshAttributes.
+		const uint64 vertexUploadSize = vertexCount * sizeof(float) * 8;
+		LOG_INFO("PMX skinning: {0} components, {1} vertices, {2} bytes uploaded per frame instead of {3}.",
+			componentCount,
+			vertexCount,
+			uploadSize,
+			vertexUploadSize);
+		cVarPMXSkinningStats.set(0);
+	}
+
+	commandBufEnd(backBufferIndex);
+}
+
+void engine::GpuPMXSkinningPass::createPipeline()
+{
+	if(bInitPipeline) return;
+
+	uint32 backBufferCount = (uint32)VulkanRHI::get()->getSwapchainImageViews().size();
+
+	// NOTE: Same bindings as PMXMeshComponent::OnSkinningCollect, the sets are built per component.
+	VkDescriptorBufferInfo bufInfo = {};
+	VulkanRHI::get()->vkFrameDescriptorFactoryBegin()
+		.bindBuffer(0,&bufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.bindBuffer(1,&bufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.bindBuffer(2,&bufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.bindBuffer(3,&bufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.bindBuffer(4,&bufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.bindBuffer(5,&bufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.buildLayout(m_skinningLayout);
+
+	m_pipelines.resize(backBufferCount);
+	m_pipelineLayouts.resize(backBufferCount);
+	for(uint32 index = 0; index < backBufferCount; index++)
+	{
+		VkPipelineLayoutCreateInfo plci = vkPipelineLayoutCreateInfo();
+
+		VkPushConstantRange push_constant{};
+		push_constant.offset = 0;
+		push_constant.size = sizeof(GPUPMXSkinningPushConstants);
+		push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		plci.pPushConstantRanges = &push_constant;
+		plci.pushConstantRangeCount = 1;
+
+		std::vector<VkDescriptorSetLayout> setLayouts = {
+			m_skinningLayout.layout
+		};
+
+		plci.setLayoutCount = (uint32)setLayouts.size();
+		plci.pSetLayouts = setLayouts.data();
+
+		m_pipelineLayouts[index] = VulkanRHI::get()->createPipelineLayout(plci);
+
+		auto* shaderModule = VulkanRHI::get()->getShader("media/shader/fallback/bin/pmx_skinning.comp.spv",true);
+		VkPipelineShaderStageCreateInfo shaderStageCI{};
+		shaderStageCI.module = shaderModule->GetModule();
+		shaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStageCI.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStageCI.pName = "main";
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo{};
+		computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		computePipelineCreateInfo.layout = m_pipelineLayouts[index];
+		computePipelineCreateInfo.flags = 0;
+		computePipelineCreateInfo.stage = shaderStageCI;
+		m_pipelines[index] = VulkanRHI::get()->createComputePipeline(computePipelineCreateInfo);
+	}
+
+	bInitPipeline = true;
+}
+
+void engine::GpuPMXSkinningPass::destroyPipeline()
+{
+	if(!bInitPipeline) return;
+
+	for(uint32 index = 0; index < m_pipelines.size(); index++)
+	{
+		VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
+	}
+	m_pipelines.resize(0);
+	m_pipelineLayouts.resize(0);
+
+	bInitPipeline = false;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "../pass_interface.h"
+
+namespace engine{
+
+struct GPUPMXSkinningPushConstants
+{
+	uint32 vertexCount;
+	uint32 boneCount;
+	uint32 morphCount;
+	uint32 pad;
+};
+
+// NOTE: Skins and morphs every pmx component into its vertex buffer, see pmx_skinning.comp. Bind pose,
+//       weights and morph offsets live on the gpu, only bone transforms and morph weights change per frame.
+class GpuPMXSkinningPass: public ComputePass
+{
+public:
+	GpuPMXSkinningPass(
+		Ref<Renderer> renderer,
+		Ref<RenderScene> scene,
+		Ref<shaderCompiler::ShaderCompiler> sc,
+		const std::string& name)
+		: ComputePass(renderer,scene,sc,name)
+	{
+
+	}
+
+	virtual void initInner() override;
+	virtual void beforeSceneTextureRecreate() override;
+	virtual void afterSceneTextureRecreate() override;
+
+	void record(uint32 backBufferIndex);
+
+private:
+	bool bInitPipeline = false;
+
+	void createPipeline();
+	void destroyPipeline();
+
+	std::vector<VkPipeline> m_pipelines = {};
+	std::vector<VkPipelineLayout> m_pipelineLayouts = {};
+
+	VulkanDescriptorLayoutReference m_skinningLayout = {};
+};
+
+}
@@ -36,8 +36,8 @@ void engine::TAAPass::destroyPipeline()
 
 	for(uint32 index = 0; index<m_pipelines.size(); index++)
 	{
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
 	}
 	m_pipelines.resize(0);
 	m_pipelineLayouts.resize(0);
@@ -45,8 +45,8 @@ void engine::TAAPass::destroyPipeline()
 	// sharpen
 	for(uint32 index = 0; index < m_pipelinesSharpen.size(); index++)
 	{
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelinesSharpen[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayoutsSharpen[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_pipelinesSharpen[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayoutsSharpen[index]);
 	}
 	m_pipelinesSharpen.resize(0);
 	m_pipelineLayoutsSharpen.resize(0);
@@ -58,7 +58,7 @@ void engine::TAAPass::destroyPipeline()
 
 void engine::TAAPass::record(uint32 backBufferIndex)
 {
-	VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+	VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
 	commandBufBegin(backBufferIndex);
 
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[backBufferIndex]);
@@ -264,7 +264,7 @@ void engine::TAAPass::createPipeline()
 			computePipelineCreateInfo.layout = m_pipelineLayouts[index];
 			computePipelineCreateInfo.flags = 0;
 			computePipelineCreateInfo.stage = shaderStageCI;
-			vkCheck(vkCreateComputePipelines(VulkanRHI::get()->getDevice(),nullptr,1,&computePipelineCreateInfo,nullptr,&m_pipelines[index]));
+			m_pipelines[index] = VulkanRHI::get()->createComputePipeline(computePipelineCreateInfo);
 		}
 		
 		// TAA Sharpen
@@ -293,7 +293,7 @@ void engine::TAAPass::createPipeline()
 			computePipelineCreateInfo.layout = m_pipelineLayoutsSharpen[index];
 			computePipelineCreateInfo.flags = 0;
 			computePipelineCreateInfo.stage = shaderStageCI;
-			vkCheck(vkCreateComputePipelines(VulkanRHI::get()->getDevice(),nullptr,1,&computePipelineCreateInfo,nullptr,&m_pipelinesSharpen[index]));
+			m_pipelinesSharpen[index] = VulkanRHI::get()->createComputePipeline(computePipelineCreateInfo);
 		}
 	}
 
@@ -0,0 +1,194 @@
+#include "virtual_shadow_mark.h"
+#include "../renderer.h"
+using namespace engine;
+
+#define WORK_TILE_SIZE 16
+
+struct GpuVirtualShadowMarkPushConstant
+{
+	glm::vec2 imageSize;
+};
+
+void engine::GpuVirtualShadowMarkPass::initInner()
+{
+	bInitPipeline = false;
+	createPipeline();
+	m_deletionQueue.push([&]()
+	{
+		destroyPipeline();
+	});
+}
+
+void engine::GpuVirtualShadowMarkPass::beforeSceneTextureRecreate()
+{
+	destroyPipeline();
+}
+
+void engine::GpuVirtualShadowMarkPass::afterSceneTextureRecreate()
+{
+	createPipeline();
+}
+
+void engine::GpuVirtualShadowMarkPass::record(uint32 backBufferIndex)
+{
+	VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
+	commandBufBegin(backBufferIndex);
+
+	// NOTE: Nothing reads the requests while the virtual shadow map is off.
+	if(!m_renderScene->m_virtualShadowMap.getPlan().bEnable)
+	{
+		commandBufEnd(backBufferIndex);
+		return;
+	}
+
+	auto& virtualShadowBuffer = m_renderScene->m_virtualShadowBuffer;
+	VkBuffer requestBuffer = virtualShadowBuffer.requestBuffer->GetVkBuffer();
+
+	// the copy of the last frame read the request bits on the same queue.
+	VkBufferMemoryBarrier bufferBarrier {};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.buffer = requestBuffer;
+	bufferBarrier.size = virtualShadowBuffer.requestSize;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,0,nullptr,1,&bufferBarrier,0,nullptr);
+
+	vkCmdFillBuffer(cmd,requestBuffer,0,virtualShadowBuffer.requestSize,0);
+
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,0,nullptr,1,&bufferBarrier,0,nullptr);
+
+	GpuVirtualShadowMarkPushConstant gpuPushConstant = {};
+	auto depthImageExtent = m_renderScene->getSceneTextures().getDepthStencil()->getExtent();
+	gpuPushConstant.imageSize.x = float(depthImageExtent.width);
+	gpuPushConstant.imageSize.y = float(depthImageExtent.height);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[backBufferIndex]);
+
+	vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex],
+		VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GpuVirtualShadowMarkPushConstant), &gpuPushConstant);
+
+	std::vector<VkDescriptorSet> compPassSets = {
+		  m_renderer->getFrameData().m_frameDataDescriptorSets[backBufferIndex].set
+		, m_descriptorSets[backBufferIndex].set
+		, virtualShadowBuffer.descriptorSets[backBufferIndex].set
+	};
+
+	vkCmdBindDescriptorSets(
+		cmd,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		m_pipelineLayouts[backBufferIndex],
+		0,
+		(uint32)compPassSets.size(),
+		compPassSets.data(),
+		0,
+		nullptr
+	);
+
+	vkCmdDispatch(cmd,
+		getGroupCount(depthImageExtent.width, WORK_TILE_SIZE),
+		getGroupCount(depthImageExtent.height,WORK_TILE_SIZE),
+		1
+	);
+
+	bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,0,nullptr,1,&bufferBarrier,0,nullptr);
+
+	// NOTE: Read by VirtualShadowMap::update once this back buffer comes around again.
+	VkBufferCopy copyRegion {};
+	copyRegion.size = virtualShadowBuffer.requestSize;
+	vkCmdCopyBuffer(cmd,requestBuffer,virtualShadowBuffer.readbackBuffers[backBufferIndex]->GetVkBuffer(),1,&copyRegion);
+
+	commandBufEnd(backBufferIndex);
+}
+
+void engine::GpuVirtualShadowMarkPass::createPipeline()
+{
+	if(bInitPipeline) return;
+
+	uint32 backBufferCount = (uint32)VulkanRHI::get()->getSwapchainImageViews().size();
+
+	m_descriptorSets.resize(backBufferCount);
+	m_descriptorSetLayouts.resize(backBufferCount);
+	for(uint32 index = 0; index < backBufferCount; index++)
+	{
+		VkDescriptorImageInfo depthStencilImage = {};
+		depthStencilImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthStencilImage.imageView = m_renderScene->getSceneTextures().getDepthStencil()->getImageView();
+		depthStencilImage.sampler = VulkanRHI::get()->getPointClampEdgeSampler();
+
+		m_renderer->vkDynamicDescriptorFactoryBegin(index)
+			.bindImage(0,&depthStencilImage,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build(m_descriptorSets[index],m_descriptorSetLayouts[index]);
+	}
+
+	m_pipelines.resize(backBufferCount);
+	m_pipelineLayouts.resize(backBufferCount);
+	for(uint32 index = 0; index < backBufferCount; index++)
+	{
+		VkPipelineLayoutCreateInfo plci = vkPipelineLayoutCreateInfo();
+
+		VkPushConstantRange push_constant{};
+		push_constant.offset = 0;
+		push_constant.size = sizeof(GpuVirtualShadowMarkPushConstant);
+		push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		plci.pPushConstantRanges = &push_constant;
+		plci.pushConstantRangeCount = 1;
+
+		std::vector<VkDescriptorSetLayout> setLayouts = {
+			  m_renderer->getFrameData().m_frameDataDescriptorSetLayouts[index].layout
+			, m_descriptorSetLayouts[index].layout
+			, m_renderer->getRenderScene().m_virtualShadowBuffer.descriptorSetLayout.layout
+		};
+
+		plci.setLayoutCount = (uint32)setLayouts.size();
+		plci.pSetLayouts = setLayouts.data();
+
+		m_pipelineLayouts[index] = VulkanRHI::get()->createPipelineLayout(plci);
+
+		auto* shaderModule = VulkanRHI::get()->getShader("media/shader/fallback/bin/vsm_mark.comp.spv",true);
+		VkPipelineShaderStageCreateInfo shaderStageCI{};
+		shaderStageCI.module = shaderModule->GetModule();
+		shaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStageCI.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStageCI.pName = "main";
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo{};
+		computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		computePipelineCreateInfo.layout = m_pipelineLayouts[index];
+		computePipelineCreateInfo.flags = 0;
+		computePipelineCreateInfo.stage = shaderStageCI;
+		m_pipelines[index] = VulkanRHI::get()->createComputePipeline(computePipelineCreateInfo);
+	}
+
+	bInitPipeline = true;
+}
+
+void engine::GpuVirtualShadowMarkPass::destroyPipeline()
+{
+	if(!bInitPipeline) return;
+
+	for(uint32 index = 0; index < m_pipelines.size(); index++)
+	{
+		VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
+	}
+	m_pipelines.resize(0);
+	m_pipelineLayouts.resize(0);
+
+	bInitPipeline = false;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "../pass_interface.h"
+
+namespace engine{
+
+// NOTE: Marks the virtual shadow pages the lighting will sample from the scene depth and copies the
+//       request bits out for VirtualShadowMap::update, see virtual_shadow_map.h.
+class GpuVirtualShadowMarkPass: public ComputePass
+{
+public:
+	GpuVirtualShadowMarkPass(
+		Ref<Renderer> renderer,
+		Ref<RenderScene> scene,
+		Ref<shaderCompiler::ShaderCompiler> sc,
+		const std::string& name)
+		: ComputePass(renderer,scene,sc,name)
+	{
+
+	}
+
+	virtual void initInner() override;
+	virtual void beforeSceneTextureRecreate() override;
+	virtual void afterSceneTextureRecreate() override;
+
+	void record(uint32 backBufferIndex);
+
+private:
+	bool bInitPipeline = false;
+
+	void createPipeline();
+	void destroyPipeline();
+
+	std::vector<VkPipeline> m_pipelines = {};
+	std::vector<VkPipelineLayout> m_pipelineLayouts = {};
+
+	std::vector<VulkanDescriptorSetReference> m_descriptorSets = {};
+	std::vector<VulkanDescriptorLayoutReference> m_descriptorSetLayouts = {};
+};
+
+}
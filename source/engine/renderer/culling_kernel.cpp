@@ -0,0 +1,278 @@
+#include "culling_kernel.h"
+#include "mesh.h"
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CULLING_AVX_TARGET
+#else
+#define CULLING_AVX_TARGET __attribute__((target("avx")))
+#endif
+
+namespace engine{
+
+void CullingBoundsSoA::resize(uint32 count)
+{
+	centerX.resize(count); centerY.resize(count); centerZ.resize(count);
+	extentX.resize(count); extentY.resize(count); extentZ.resize(count);
+	for(auto& row : m)
+	{
+		for(auto& column : row)
+		{
+			column.resize(count);
+		}
+	}
+}
+
+void CullingBoundsSoA::set(uint32 index,const RenderBounds& bounds,const glm::mat4& modelMatrix)
+{
+	centerX[index] = bounds.origin.x;
+	centerY[index] = bounds.origin.y;
+	centerZ[index] = bounds.origin.z;
+
+	extentX[index] = bounds.extents.x;
+	extentY[index] = bounds.extents.y;
+	extentZ[index] = bounds.extents.z;
+
+	for(uint32 r = 0; r < 3; r++)
+	{
+		for(uint32 c = 0; c < 4; c++)
+		{
+			m[r][c][index] = modelMatrix[c][r];
+		}
+	}
+}
+
+static bool detectAVX()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info,1);
+	const bool bOSXSave = (info[2] & (1 << 27)) != 0;
+	const bool bAVX     = (info[2] & (1 << 28)) != 0;
+	if(!bOSXSave || !bAVX) return false;
+
+	// os must save ymm state.
+	return (_xgetbv(0) & 0x6) == 0x6;
+#elif defined(__GNUC__)
+	return __builtin_cpu_supports("avx");
+#else
+	return false;
+#endif
+}
+
+bool cullingKernelUseAVX()
+{
+	static const bool bAVX = detectAVX();
+	return bAVX;
+}
+
+static inline uint32 countTrailingZero(uint32 bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index,bits);
+	return (uint32)index;
+#else
+	return (uint32)__builtin_ctz(bits);
+#endif
+}
+
+static inline uint32* writeVisible(uint32* dst,uint32 base,uint32 mask)
+{
+	while(mask != 0)
+	{
+		*dst++ = base + countTrailingZero(mask);
+		mask &= mask - 1;
+	}
+	return dst;
+}
+
+static inline bool scalarVisible(const CullingBoundsSoA& b,uint32 i,const glm::vec4* planes,uint32 planeCount)
+{
+	const float cx = b.centerX[i], cy = b.centerY[i], cz = b.centerZ[i];
+	const float ex = b.extentX[i], ey = b.extentY[i], ez = b.extentZ[i];
+
+	float wc[3];
+	float we[3];
+	for(uint32 r = 0; r < 3; r++)
+	{
+		wc[r] = b.m[r][0][i] * cx + b.m[r][1][i] * cy + b.m[r][2][i] * cz + b.m[r][3][i];
+		we[r] = glm::abs(b.m[r][0][i]) * ex + glm::abs(b.m[r][1][i]) * ey + glm::abs(b.m[r][2][i]) * ez;
+	}
+
+	for(uint32 p = 0; p < planeCount; p++)
+	{
+		const glm::vec4& n = planes[p];
+		const float d = n.x * wc[0] + n.y * wc[1] + n.z * wc[2] + n.w;
+		const float radius = glm::abs(n.x) * we[0] + glm::abs(n.y) * we[1] + glm::abs(n.z) * we[2];
+		if(d + radius < 0.0f) return false;
+	}
+	return true;
+}
+
+// NOTE: 8 boxes per iteration as two 4-wide halves.
+static uint32* cullSSE(const CullingBoundsSoA& b,const glm::vec4* planes,uint32 planeCount,uint32 begin,uint32 end,uint32* dst)
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	uint32 i = begin;
+	for(; i + 8 <= end; i += 8)
+	{
+		uint32 mask = 0;
+		for(uint32 half = 0; half < 2; half++)
+		{
+			const uint32 o = i + half * 4;
+			const __m128 cx = _mm_loadu_ps(&b.centerX[o]);
+			const __m128 cy = _mm_loadu_ps(&b.centerY[o]);
+			const __m128 cz = _mm_loadu_ps(&b.centerZ[o]);
+			const __m128 ex = _mm_loadu_ps(&b.extentX[o]);
+			const __m128 ey = _mm_loadu_ps(&b.extentY[o]);
+			const __m128 ez = _mm_loadu_ps(&b.extentZ[o]);
+
+			__m128 wc[3];
+			__m128 we[3];
+			for(uint32 r = 0; r < 3; r++)
+			{
+				const __m128 m0 = _mm_loadu_ps(&b.m[r][0][o]);
+				const __m128 m1 = _mm_loadu_ps(&b.m[r][1][o]);
+				const __m128 m2 = _mm_loadu_ps(&b.m[r][2][o]);
+				const __m128 m3 = _mm_loadu_ps(&b.m[r][3][o]);
+
+				wc[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0,cx),_mm_mul_ps(m1,cy)),_mm_add_ps(_mm_mul_ps(m2,cz),m3));
+				we[r] = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_andnot_ps(signMask,m0),ex),
+					_mm_mul_ps(_mm_andnot_ps(signMask,m1),ey)),
+					_mm_mul_ps(_mm_andnot_ps(signMask,m2),ez));
+			}
+
+			__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for(uint32 p = 0; p < planeCount; p++)
+			{
+				const glm::vec4& n = planes[p];
+				const __m128 d = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(n.x),wc[0]),_mm_mul_ps(_mm_set1_ps(n.y),wc[1])),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(n.z),wc[2]),_mm_set1_ps(n.w)));
+				const __m128 radius = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(glm::abs(n.x)),we[0]),_mm_mul_ps(_mm_set1_ps(glm::abs(n.y)),we[1])),
+					_mm_mul_ps(_mm_set1_ps(glm::abs(n.z)),we[2]));
+
+				visible = _mm_and_ps(visible,_mm_cmpge_ps(_mm_add_ps(d,radius),zero));
+			}
+
+			mask |= uint32(_mm_movemask_ps(visible)) << (half * 4);
+		}
+
+		dst = writeVisible(dst,i,mask);
+	}
+
+	for(; i < end; i++)
+	{
+		if(scalarVisible(b,i,planes,planeCount)) *dst++ = i;
+	}
+	return dst;
+}
+
+CULLING_AVX_TARGET
+static uint32* cullAVX(const CullingBoundsSoA& b,const glm::vec4* planes,uint32 planeCount,uint32 begin,uint32 end,uint32* dst)
+{
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	uint32 i = begin;
+	for(; i + 8 <= end; i += 8)
+	{
+		const __m256 cx = _mm256_loadu_ps(&b.centerX[i]);
+		const __m256 cy = _mm256_loadu_ps(&b.centerY[i]);
+		const __m256 cz = _mm256_loadu_ps(&b.centerZ[i]);
+		const __m256 ex = _mm256_loadu_ps(&b.extentX[i]);
+		const __m256 ey = _mm256_loadu_ps(&b.extentY[i]);
+		const __m256 ez = _mm256_loadu_ps(&b.extentZ[i]);
+
+		__m256 wc[3];
+		__m256 we[3];
+		for(uint32 r = 0; r < 3; r++)
+		{
+			const __m256 m0 = _mm256_loadu_ps(&b.m[r][0][i]);
+			const __m256 m1 = _mm256_loadu_ps(&b.m[r][1][i]);
+			const __m256 m2 = _mm256_loadu_ps(&b.m[r][2][i]);
+			const __m256 m3 = _mm256_loadu_ps(&b.m[r][3][i]);
+
+			wc[r] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0,cx),_mm256_mul_ps(m1,cy)),_mm256_add_ps(_mm256_mul_ps(m2,cz),m3));
+			we[r] = _mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(_mm256_andnot_ps(signMask,m0),ex),
+				_mm256_mul_ps(_mm256_andnot_ps(signMask,m1),ey)),
+				_mm256_mul_ps(_mm256_andnot_ps(signMask,m2),ez));
+		}
+
+		__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for(uint32 p = 0; p < planeCount; p++)
+		{
+			const glm::vec4& n = planes[p];
+			const __m256 d = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(n.x),wc[0]),_mm256_mul_ps(_mm256_set1_ps(n.y),wc[1])),
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(n.z),wc[2]),_mm256_set1_ps(n.w)));
+			const __m256 radius = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(glm::abs(n.x)),we[0]),_mm256_mul_ps(_mm256_set1_ps(glm::abs(n.y)),we[1])),
+				_mm256_mul_ps(_mm256_set1_ps(glm::abs(n.z)),we[2]));
+
+			visible = _mm256_and_ps(visible,_mm256_cmp_ps(_mm256_add_ps(d,radius),zero,_CMP_GE_OQ));
+		}
+
+		dst = writeVisible(dst,i,uint32(_mm256_movemask_ps(visible)));
+	}
+
+	for(; i < end; i++)
+	{
+		if(scalarVisible(b,i,planes,planeCount)) *dst++ = i;
+	}
+	return dst;
+}
+
+void frustumCullingSoA(
+	const CullingBoundsSoA& bounds,
+	const glm::vec4* planes,
+	uint32 planeCount,
+	uint32 begin,
+	uint32 end,
+	std::vector<uint32>& outVisible,
+	ECullingKernel kernel)
+{
+	CHECK(end <= bounds.size());
+	if(begin >= end) return;
+
+	if(kernel == ECullingKernel::Auto)
+	{
+		kernel = cullingKernelUseAVX() ? ECullingKernel::AVX : ECullingKernel::SSE;
+	}
+	if(kernel == ECullingKernel::AVX && !cullingKernelUseAVX())
+	{
+		kernel = ECullingKernel::SSE;
+	}
+
+	// NOTE: Reserve the worst case and shrink afterwards, so the kernel writes through a raw pointer.
+	const size_t base = outVisible.size();
+	outVisible.resize(base + (end - begin));
+	uint32* dst = outVisible.data() + base;
+
+	switch(kernel)
+	{
+	case ECullingKernel::AVX:
+		dst = cullAVX(bounds,planes,planeCount,begin,end,dst);
+		break;
+	case ECullingKernel::SSE:
+		dst = cullSSE(bounds,planes,planeCount,begin,end,dst);
+		break;
+	default:
+		for(uint32 i = begin; i < end; i++)
+		{
+			if(scalarVisible(bounds,i,planes,planeCount)) *dst++ = i;
+		}
+		break;
+	}
+
+	outVisible.resize(dst - outVisible.data());
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "../core/core.h"
+
+namespace engine{
+
+struct RenderBounds;
+
+// NOTE: SoA culling input. Local bounds plus the first three rows of the model matrix,
+//       so the kernel transforms 8 boxes at once instead of building a mat4 per mesh.
+struct CullingBoundsSoA
+{
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+
+	// row r, column c of the model matrix.
+	std::vector<float> m[3][4];
+
+	uint32 size() const { return (uint32)centerX.size(); }
+	void resize(uint32 count);
+	void set(uint32 index,const RenderBounds& bounds,const glm::mat4& modelMatrix);
+};
+
+enum class ECullingKernel
+{
+	Auto = 0, // AVX when the cpu supports it, otherwise SSE.
+	Scalar,
+	SSE,      // 8 boxes per iteration as two 4-wide halves.
+	AVX,      // 8 boxes per iteration.
+};
+
+// NOTE: Test bounds [begin,end) against inward normalized planes (same as Frustum),
+//       appending visible indices to outVisible in ascending order.
+extern void frustumCullingSoA(
+	const CullingBoundsSoA& bounds,
+	const glm::vec4* planes,
+	uint32 planeCount,
+	uint32 begin,
+	uint32 end,
+	std::vector<uint32>& outVisible,
+	ECullingKernel kernel = ECullingKernel::Auto
+);
+
+extern bool cullingKernelUseAVX();
+
+}
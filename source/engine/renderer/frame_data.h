@@ -8,6 +8,12 @@ namespace engine{
 
 constexpr int32 MAX_SSBO_OBJECTS      = 50000;
 
+// NOTE: Cluster draws of one index width per frame, objects past the budget are culled as a whole.
+constexpr uint32 MAX_CLUSTER_DRAWS    = 128 * 1024;
+
+// NOTE: One visibility bit per meshlet of every clustered object, both index widths.
+constexpr uint32 MAX_CLUSTER_VISIBILITY_BITS = MAX_CLUSTER_DRAWS * 2;
+
 struct GPUObjectData
 {
     glm::mat4 model;
@@ -19,7 +25,19 @@ struct GPUObjectData
     uint32 indexCount; // pad 4 uint32
     uint32 firstIndex;
     uint32 vertexOffset;
-    uint32 firstInstance;
+    uint32 batchId;    // index into the draw batch buffer.
+
+    // NOTE: Zero meshletCount culls and draws the object through its batch, otherwise per meshlet.
+    uint32 meshletStart; // absolute in the meshlet heap.
+    uint32 meshletCount;
+    uint32 bIndex16;
+    uint32 clusterVisibilityStart; // first visibility bit of the meshlets of a clustered object.
+
+    // NOTE: Dynamic casters are drawn over the cached static cascade depth every frame, see CascadeShadowCache.
+    uint32 bShadowDynamic;
+    uint32 pad0;
+    uint32 pad1;
+    uint32 pad2;
 };
 
 struct GPUMaterialData
@@ -66,6 +84,23 @@ struct GPUDrawCallData
     uint32 materialId;
 };
 
+// NOTE: Objects sharing index range and material, drawn as one instanced indirect draw.
+//       Visible object ids of the batch are written to the instance id buffer starting at firstInstance.
+//       The simplified lods of a batch are the batches right after it, the culling appends an object
+//       to batchId + its selected lod.
+struct GPUDrawBatchData
+{
+    uint32 indexCount;
+    uint32 firstIndex;
+    uint32 vertexOffset;
+    uint32 firstInstance;
+
+    uint32 materialId;
+    uint32 lodCount; // batches of the lod chain, same in every one of them.
+    float lodError;  // see MeshLod::error.
+    uint32 pad0;
+};
+
 struct GpuDepthEvaluteMinMaxBuffer
 {
 	uint32 minDepth;
@@ -81,6 +116,29 @@ struct GpuCascadeInfo
 struct GPUOutIndirectDrawCount
 {
     uint32 outGbufferDrawCount;
+
+    uint32 visibleObjectCount; // draw count before instance batching.
+    uint32 visibleBatchCount;  // draw count after instance batching.
+
+    // NOTE: Draw counts of the cluster ranges, 32 and 16 bit indices. Also the count buffer offsets
+    //       of the two indirect count draws, keep them in sync with OutIndirectDrawCount.
+    uint32 clusterDrawCount;
+    uint32 clusterDrawCount16;
+
+    uint32 testedClusterCount;
+    uint32 frustumCulledClusterCount;
+    uint32 coneCulledClusterCount;
+
+    // NOTE: Occlusion culled in the early phase means not visible last frame, left to the late phase.
+    uint32 frustumCulledObjectCount;
+    uint32 occlusionCulledObjectCount;
+    uint32 occlusionCulledClusterCount;
+
+    // NOTE: Triangles of the appended batch instances with their selected lod and with lod #0,
+    //       and the appended instances per lod. Cluster draws are always lod #0 and not counted.
+    uint32 lodTriangleCount;
+    uint32 fullTriangleCount;
+    uint32 lodObjectCounts[MESH_MAX_LOD_COUNT];
 };
 
 class Renderer;
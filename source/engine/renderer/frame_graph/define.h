@@ -1,5 +1,6 @@
 #pragma once
 #include "../../core/core.h"
+#include <vulkan/vulkan.h>
 
 namespace engine { namespace frame_graph{
 
@@ -24,4 +25,107 @@ enum class EQueueUsage : uint32_t
 	All = ((Count - 1) << 1) - 1,
 };
 
-} }
\ No newline at end of file
+// NOTE: Stages a queue of this type can run. Barriers recorded on it and semaphore waits
+//       submitted to it must stay inside this mask.
+inline VkPipelineStageFlags getQueueStageMask(EQueueType queue)
+{
+	constexpr VkPipelineStageFlags computeStages =
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT |
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+		VK_PIPELINE_STAGE_TRANSFER_BIT |
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT |
+		VK_PIPELINE_STAGE_HOST_BIT |
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+	switch(queue)
+	{
+	case EQueueType::AsyncCompute:
+		return computeStages;
+	case EQueueType::AsyncTransfer:
+		return VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT |
+			VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	default:
+		return ~VkPipelineStageFlags(0);
+	}
+}
+
+inline const char* getQueueName(EQueueType queue)
+{
+	switch(queue)
+	{
+	case EQueueType::Graphics: return "Graphics";
+	case EQueueType::AsyncCompute: return "AsyncCompute";
+	case EQueueType::AsyncTransfer: return "AsyncTransfer";
+	default: return "Unknown";
+	}
+}
+
+// NOTE: How a pass touches a resource. Each access maps to one stage/access/layout triple,
+//       the graph derives barriers and layout transitions from consecutive accesses.
+enum class EResourceAccess : uint32_t
+{
+	None = 0,
+
+	IndirectArgument,      // vkCmdDrawIndirect* arguments and count buffers.
+	VertexShaderRead,      // storage or uniform buffer read in the vertex shader.
+	GraphicsShaderRead,    // sampled image or buffer read in vertex/fragment shaders.
+	ComputeShaderRead,     // sampled image or storage read in a compute shader.
+	ComputeShaderWrite,    // storage image or buffer write in a compute shader.
+	ComputeShaderReadWrite,
+	ColorAttachmentWrite,
+	DepthStencilWrite,
+	DepthStencilRead,      // depth test without write, or sampled while bound as read only depth.
+	TransferRead,
+	TransferWrite,
+	Present,
+
+	Count,
+};
+
+struct AccessInfo
+{
+	VkPipelineStageFlags stage;
+	VkAccessFlags access;
+	VkImageLayout layout;
+	bool bWrite;
+};
+
+inline const AccessInfo& getAccessInfo(EResourceAccess access)
+{
+	static const AccessInfo infos[] =
+	{
+		{ VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, false },
+
+		{ VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+		{ VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false },
+		{ VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false },
+		{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false },
+		{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true },
+		{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true },
+		{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true },
+		{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true },
+		{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false },
+		{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false },
+		{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true },
+		{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false },
+	};
+	static_assert(sizeof(infos) / sizeof(infos[0]) == size_t(EResourceAccess::Count), "Access table out of sync.");
+
+	return infos[uint32_t(access)];
+}
+
+inline const char* getAccessName(EResourceAccess access)
+{
+	static const char* names[] =
+	{
+		"None", "IndirectArgument", "VertexShaderRead", "GraphicsShaderRead", "ComputeShaderRead",
+		"ComputeShaderWrite", "ComputeShaderReadWrite", "ColorAttachmentWrite", "DepthStencilWrite",
+		"DepthStencilRead", "TransferRead", "TransferWrite", "Present",
+	};
+	static_assert(sizeof(names) / sizeof(names[0]) == size_t(EResourceAccess::Count), "Access names out of sync.");
+
+	return names[uint32_t(access)];
+}
+
+} }
@@ -0,0 +1,1026 @@
+#include "frame_graph.h"
+#include <algorithm>
+#include <sstream>
+
+namespace engine { namespace frame_graph{
+
+constexpr VkAccessFlags WRITE_ACCESS_MASK =
+	VK_ACCESS_SHADER_WRITE_BIT |
+	VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_TRANSFER_WRITE_BIT |
+	VK_ACCESS_HOST_WRITE_BIT |
+	VK_ACCESS_MEMORY_WRITE_BIT;
+
+static VkDeviceSize alignUp(VkDeviceSize value,VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkFlags getImageUsage(EResourceAccess access)
+{
+	switch(access)
+	{
+	case EResourceAccess::GraphicsShaderRead:
+	case EResourceAccess::ComputeShaderRead:
+	case EResourceAccess::VertexShaderRead:
+		return VK_IMAGE_USAGE_SAMPLED_BIT;
+	case EResourceAccess::ComputeShaderWrite:
+	case EResourceAccess::ComputeShaderReadWrite:
+		return VK_IMAGE_USAGE_STORAGE_BIT;
+	case EResourceAccess::ColorAttachmentWrite:
+		return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	case EResourceAccess::DepthStencilWrite:
+	case EResourceAccess::DepthStencilRead:
+		return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	case EResourceAccess::TransferRead:
+		return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	case EResourceAccess::TransferWrite:
+		return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	default:
+		return 0;
+	}
+}
+
+static VkFlags getBufferUsage(EResourceAccess access)
+{
+	switch(access)
+	{
+	case EResourceAccess::IndirectArgument:
+		return VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+	case EResourceAccess::VertexShaderRead:
+	case EResourceAccess::GraphicsShaderRead:
+	case EResourceAccess::ComputeShaderRead:
+	case EResourceAccess::ComputeShaderWrite:
+	case EResourceAccess::ComputeShaderReadWrite:
+		return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	case EResourceAccess::TransferRead:
+		return VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	case EResourceAccess::TransferWrite:
+		return VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	default:
+		return 0;
+	}
+}
+
+ResourceHandle PassBuilder::createTexture(const std::string& name,const TextureDesc& desc)
+{
+	return m_graph.createTexture(name,desc);
+}
+
+ResourceHandle PassBuilder::createBuffer(const std::string& name,const BufferDesc& desc)
+{
+	return m_graph.createBuffer(name,desc);
+}
+
+ResourceHandle PassBuilder::read(ResourceHandle resource,EResourceAccess access)
+{
+	CHECK(resource < m_graph.m_resources.size());
+	CHECK(!getAccessInfo(access).bWrite && "Use write() for write accesses.");
+	m_graph.m_passes[m_pass].accesses.push_back({ resource, access });
+	return resource;
+}
+
+ResourceHandle PassBuilder::write(ResourceHandle resource,EResourceAccess access)
+{
+	CHECK(resource < m_graph.m_resources.size());
+	CHECK(getAccessInfo(access).bWrite && "Use read() for read accesses.");
+	m_graph.m_passes[m_pass].accesses.push_back({ resource, access });
+	return resource;
+}
+
+void PassBuilder::sideEffect()
+{
+	m_graph.m_passes[m_pass].bSideEffect = true;
+}
+
+void PassBuilder::setQueue(EQueueType queue)
+{
+	m_graph.m_passes[m_pass].queue = queue;
+}
+
+uint32_t FrameGraph::addPass(const std::string& name,const std::function<void(PassBuilder&)>& setup,ExecuteFunc&& execute)
+{
+	const uint32_t index = (uint32_t)m_passes.size();
+
+	Pass pass { };
+	pass.name = name;
+	pass.execute = std::move(execute);
+	m_passes.push_back(std::move(pass));
+
+	PassBuilder builder(*this,index);
+	setup(builder);
+
+	m_bCompiled = false;
+	return index;
+}
+
+ResourceHandle FrameGraph::addResource(Resource&& resource)
+{
+	m_resources.push_back(std::move(resource));
+	m_bCompiled = false;
+	return ResourceHandle(m_resources.size() - 1);
+}
+
+ResourceHandle FrameGraph::createTexture(const std::string& name,const TextureDesc& desc)
+{
+	Resource resource { };
+	resource.name = name;
+	resource.type = EResourceType::Texture;
+	resource.texture = desc;
+	return addResource(std::move(resource));
+}
+
+ResourceHandle FrameGraph::createBuffer(const std::string& name,const BufferDesc& desc)
+{
+	Resource resource { };
+	resource.name = name;
+	resource.type = EResourceType::Buffer;
+	resource.buffer = desc;
+	return addResource(std::move(resource));
+}
+
+ResourceHandle FrameGraph::importTexture(const std::string& name,VkImage image,VkImageView view,const TextureDesc& desc,const ImportDesc& import)
+{
+	Resource resource { };
+	resource.name = name;
+	resource.type = EResourceType::Texture;
+	resource.texture = desc;
+	resource.bImported = true;
+	resource.import = import;
+	resource.image = image;
+	resource.view = view;
+	return addResource(std::move(resource));
+}
+
+ResourceHandle FrameGraph::importBuffer(const std::string& name,VkBuffer buffer,VkDeviceSize size,const ImportDesc& import)
+{
+	Resource resource { };
+	resource.name = name;
+	resource.type = EResourceType::Buffer;
+	resource.buffer.size = size;
+	resource.bImported = true;
+	resource.import = import;
+	resource.vkBuffer = buffer;
+	return addResource(std::move(resource));
+}
+
+void FrameGraph::setRealizedHandles(ResourceHandle handle,VkImage image,VkImageView view,VkBuffer buffer)
+{
+	auto& resource = m_resources[handle];
+	CHECK(resource.isTransient());
+	resource.image = image;
+	resource.view = view;
+	resource.vkBuffer = buffer;
+}
+
+void FrameGraph::setQueueFamilies(uint32_t graphicsFamily,uint32_t asyncComputeFamily)
+{
+	// NOTE: Async transfer passes aren't split out yet, they run on graphics.
+	m_queueFamilies[size_t(EQueueType::Graphics)] = graphicsFamily;
+	m_queueFamilies[size_t(EQueueType::AsyncCompute)] = asyncComputeFamily;
+	m_queueFamilies[size_t(EQueueType::AsyncTransfer)] = graphicsFamily;
+	m_bCompiled = false;
+}
+
+void FrameGraph::reset()
+{
+	m_passes.clear();
+	m_resources.clear();
+	m_executionOrder.clear();
+	m_batches.clear();
+	m_prologueBarriers.clear();
+	m_epilogueBarriers.clear();
+	m_externalEpilogue = {};
+	m_heaps.clear();
+	m_stats = {};
+	m_bCompiled = false;
+}
+
+VkImageCreateInfo FrameGraph::getImageCreateInfo(ResourceHandle handle) const
+{
+	const auto& resource = m_resources[handle];
+	CHECK(resource.isTexture());
+
+	VkImageCreateInfo info { };
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	info.imageType = VK_IMAGE_TYPE_2D;
+	info.format = resource.texture.format;
+	info.extent = { resource.texture.width, resource.texture.height, 1 };
+	info.mipLevels = resource.texture.mipLevels;
+	info.arrayLayers = resource.texture.arrayLayers;
+	info.samples = VK_SAMPLE_COUNT_1_BIT;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.usage = resource.texture.usage | resource.derivedUsage;
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	return info;
+}
+
+VkBufferCreateInfo FrameGraph::getBufferCreateInfo(ResourceHandle handle) const
+{
+	const auto& resource = m_resources[handle];
+	CHECK(!resource.isTexture());
+
+	VkBufferCreateInfo info { };
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.size = resource.buffer.size;
+	info.usage = resource.buffer.usage | resource.derivedUsage;
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	return info;
+}
+
+bool FrameGraph::compile(const MemoryRequirementFunc& queryMemory)
+{
+	m_executionOrder.clear();
+	m_batches.clear();
+	m_prologueBarriers.clear();
+	m_epilogueBarriers.clear();
+	m_externalEpilogue = {};
+	m_heaps.clear();
+	m_stats = {};
+
+	for(auto& pass : m_passes)
+	{
+		pass.bCulled = false;
+		pass.executeQueue = EQueueType::Graphics;
+		pass.batch = INVALID_BATCH;
+		pass.merged.clear();
+		pass.barriers.clear();
+		pass.releaseBarriers.clear();
+		pass.stages = 0;
+		pass.waitStages = 0;
+		pass.externalDependency = {};
+	}
+	for(auto& resource : m_resources)
+	{
+		resource.firstUse = INVALID_PASS;
+		resource.lastUse = INVALID_PASS;
+		resource.derivedUsage = 0;
+		resource.memory = {};
+		resource.heap = ~0u;
+		resource.offset = 0;
+		resource.aliasPredecessors.clear();
+	}
+
+	mergeAccesses();
+	cullPasses();
+	assignQueues();
+	buildBatches();
+	computeLifetimes();
+	placeTransients(queryMemory);
+	computeBarriers();
+
+	m_stats.passCount = (uint32_t)m_passes.size();
+	m_stats.culledPassCount = m_stats.passCount - (uint32_t)m_executionOrder.size();
+	m_stats.submitBatchCount = (uint32_t)m_batches.size();
+
+	m_bCompiled = true;
+	return true;
+}
+
+void FrameGraph::mergeAccesses()
+{
+	for(auto& pass : m_passes)
+	{
+		for(const auto& passAccess : pass.accesses)
+		{
+			const AccessInfo& info = getAccessInfo(passAccess.access);
+			auto& resource = m_resources[passAccess.resource];
+
+			resource.derivedUsage |= resource.isTexture() ? getImageUsage(passAccess.access) : getBufferUsage(passAccess.access);
+			pass.stages |= info.stage;
+
+			// Passes keep the layout of external images themselves.
+			const VkImageLayout layout = resource.isTexture() && resource.isTracked() ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+			auto it = std::find_if(pass.merged.begin(),pass.merged.end(),[&](const MergedAccess& m){ return m.resource == passAccess.resource; });
+			if(it == pass.merged.end())
+			{
+				pass.merged.push_back({ passAccess.resource, info.stage, info.access, layout, info.bWrite });
+				continue;
+			}
+
+			it->stage |= info.stage;
+			it->access |= info.access;
+			it->bWrite |= info.bWrite;
+			if(it->layout != layout)
+			{
+				// NOTE: One image can only be in one layout inside a pass, GENERAL serves every access.
+				LOG_WARN("Frame graph pass {0} uses {1} with different layouts, fallback to GENERAL.",pass.name,resource.name);
+				it->layout = VK_IMAGE_LAYOUT_GENERAL;
+			}
+		}
+	}
+}
+
+// NOTE: Walk backwards from retained outputs and side effect passes. Writes are treated as
+//       read-modify-write, so a resource stays needed by every earlier writer once it is needed.
+void FrameGraph::cullPasses()
+{
+	std::vector<bool> needed(m_resources.size(),false);
+	for(size_t i = 0; i < m_resources.size(); i++)
+	{
+		needed[i] = m_resources[i].bImported && m_resources[i].import.bRetained;
+	}
+
+	for(int32_t i = int32_t(m_passes.size()) - 1; i >= 0; i--)
+	{
+		auto& pass = m_passes[i];
+
+		bool bLive = pass.bSideEffect;
+		for(const auto& access : pass.merged)
+		{
+			if(access.bWrite && needed[access.resource])
+			{
+				bLive = true;
+			}
+		}
+
+		pass.bCulled = !bLive;
+		if(!bLive)
+		{
+			continue;
+		}
+
+		for(const auto& access : pass.merged)
+		{
+			needed[access.resource] = true;
+		}
+	}
+
+	for(uint32_t i = 0; i < m_passes.size(); i++)
+	{
+		if(!m_passes[i].bCulled)
+		{
+			m_executionOrder.push_back(i);
+		}
+	}
+}
+
+void FrameGraph::assignQueues()
+{
+	const VkPipelineStageFlags computeStages = getQueueStageMask(EQueueType::AsyncCompute);
+	for(auto passIndex : m_executionOrder)
+	{
+		auto& pass = m_passes[passIndex];
+		if(pass.queue != EQueueType::AsyncCompute || !hasAsyncCompute())
+		{
+			continue;
+		}
+
+		if((pass.stages & ~computeStages) != 0)
+		{
+			LOG_WARN("Frame graph pass {0} asks for async compute but has graphics accesses, run it on graphics.",pass.name);
+			continue;
+		}
+
+		pass.executeQueue = EQueueType::AsyncCompute;
+		m_stats.asyncComputePassCount++;
+	}
+}
+
+// NOTE: Passes keep declaration order, a batch ends wherever the queue changes. Without async
+//       compute this is one graphics batch holding every pass.
+void FrameGraph::buildBatches()
+{
+	m_batches.push_back({ });
+	for(uint32_t order = 0; order < m_executionOrder.size(); order++)
+	{
+		auto& pass = m_passes[m_executionOrder[order]];
+		if(pass.executeQueue != m_batches.back().queue)
+		{
+			SubmitBatch batch { };
+			batch.queue = pass.executeQueue;
+			batch.firstOrder = order;
+			m_batches.push_back(batch);
+		}
+
+		m_batches.back().orderCount++;
+		pass.batch = uint32_t(m_batches.size() - 1);
+	}
+
+	if(m_batches.back().queue != EQueueType::Graphics)
+	{
+		SubmitBatch batch { };
+		batch.firstOrder = (uint32_t)m_executionOrder.size();
+		m_batches.push_back(batch);
+	}
+}
+
+void FrameGraph::computeLifetimes()
+{
+	for(uint32_t order = 0; order < m_executionOrder.size(); order++)
+	{
+		const auto& pass = m_passes[m_executionOrder[order]];
+		for(const auto& access : pass.merged)
+		{
+			auto& resource = m_resources[access.resource];
+			if(resource.firstUse == INVALID_PASS)
+			{
+				resource.firstUse = order;
+
+				if(resource.isTransient() && !access.bWrite)
+				{
+					LOG_WARN("Frame graph transient {0} is read by {1} before any write.",resource.name,pass.name);
+				}
+			}
+			resource.lastUse = order;
+		}
+	}
+}
+
+// NOTE: Greedy first fit, largest first. Transients whose lifetimes don't overlap share memory,
+//       every transient records the earlier owners of its range so its first use can wait on them.
+void FrameGraph::placeTransients(const MemoryRequirementFunc& queryMemory)
+{
+	std::vector<ResourceHandle> transients;
+	for(ResourceHandle i = 0; i < m_resources.size(); i++)
+	{
+		if(m_resources[i].isTransient() && m_resources[i].firstUse != INVALID_PASS)
+		{
+			transients.push_back(i);
+		}
+	}
+	m_stats.transientCount = (uint32_t)transients.size();
+
+	if(!queryMemory)
+	{
+		return;
+	}
+
+	for(auto handle : transients)
+	{
+		auto& resource = m_resources[handle];
+		resource.memory = queryMemory(*this,handle);
+		resource.memory.alignment = std::max<VkDeviceSize>(resource.memory.alignment,1);
+		m_stats.unaliasedBytes += resource.memory.size;
+	}
+
+	std::stable_sort(transients.begin(),transients.end(),[&](ResourceHandle a,ResourceHandle b)
+	{
+		return m_resources[a].memory.size > m_resources[b].memory.size;
+	});
+
+	std::vector<ResourceHandle> placed;
+	for(auto handle : transients)
+	{
+		auto& resource = m_resources[handle];
+
+		uint32_t heapIndex = ~0u;
+		for(uint32_t i = 0; i < m_heaps.size(); i++)
+		{
+			if((m_heaps[i].memoryTypeBits & resource.memory.memoryTypeBits) != 0)
+			{
+				heapIndex = i;
+				break;
+			}
+		}
+		if(heapIndex == ~0u)
+		{
+			heapIndex = (uint32_t)m_heaps.size();
+			m_heaps.push_back({ 0, 1, resource.memory.memoryTypeBits });
+		}
+		auto& heap = m_heaps[heapIndex];
+
+		// Ranges of resources alive at the same time.
+		std::vector<std::pair<VkDeviceSize,VkDeviceSize>> busy;
+		for(auto other : placed)
+		{
+			const auto& o = m_resources[other];
+			const bool bOverlap = o.heap == heapIndex && !(o.lastUse < resource.firstUse || resource.lastUse < o.firstUse);
+			if(bOverlap)
+			{
+				busy.push_back({ o.offset, o.offset + o.memory.size });
+			}
+		}
+		std::sort(busy.begin(),busy.end());
+
+		VkDeviceSize offset = 0;
+		for(const auto& range : busy)
+		{
+			if(alignUp(offset,resource.memory.alignment) + resource.memory.size <= range.first)
+			{
+				break;
+			}
+			offset = std::max(offset,range.second);
+		}
+		offset = alignUp(offset,resource.memory.alignment);
+
+		resource.heap = heapIndex;
+		resource.offset = offset;
+
+		heap.memoryTypeBits &= resource.memory.memoryTypeBits;
+		heap.alignment = std::max(heap.alignment,resource.memory.alignment);
+		heap.size = std::max(heap.size,offset + resource.memory.size);
+
+		placed.push_back(handle);
+	}
+
+	// Earlier owners of an overlapping range.
+	for(auto handle : transients)
+	{
+		auto& resource = m_resources[handle];
+		for(auto other : transients)
+		{
+			const auto& o = m_resources[other];
+			if(other == handle || o.heap != resource.heap || o.lastUse >= resource.firstUse)
+			{
+				continue;
+			}
+
+			const bool bRangeOverlap = o.offset < resource.offset + resource.memory.size && resource.offset < o.offset + o.memory.size;
+			if(bRangeOverlap)
+			{
+				resource.aliasPredecessors.push_back(other);
+			}
+		}
+	}
+
+	for(const auto& heap : m_heaps)
+	{
+		m_stats.aliasedBytes += heap.size;
+	}
+	m_stats.heapCount = (uint32_t)m_heaps.size();
+}
+
+namespace
+{
+	struct ResourceState
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkPipelineStageFlags writeStage = 0; // last write, or last layout transition.
+		VkAccessFlags writeAccess = 0;
+
+		VkPipelineStageFlags visibleStage = 0; // stages which already wait on the last write.
+		VkAccessFlags visibleAccess = 0;
+
+		VkPipelineStageFlags readStage = 0; // reads since the last write.
+
+		// Queue of the accesses above. lastOrder is INVALID_PASS before the first pass, where the
+		// prologue in the first graphics batch stands in for it.
+		EQueueType queue = EQueueType::Graphics;
+		uint32_t lastOrder = INVALID_PASS;
+		uint32_t lastBatch = 0;
+		bool bDefined = false;
+	};
+
+	// Returns true when a barrier is needed and fills it.
+	bool transition(
+		ResourceState& state,
+		bool bImage,
+		VkPipelineStageFlags stage,
+		VkAccessFlags access,
+		VkImageLayout layout,
+		bool bWrite,
+		VkPipelineStageFlags aliasStage,
+		VkAccessFlags aliasAccess,
+		Barrier& barrier)
+	{
+		const bool bLayoutChange = bImage && layout != state.layout;
+		const bool bAliasing = aliasStage != 0;
+
+		barrier.dstStage = stage;
+		barrier.dstAccess = access;
+		barrier.oldLayout = state.layout;
+		barrier.newLayout = bImage ? layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.bAliasing = bAliasing;
+
+		bool bNeedBarrier = false;
+		if(bWrite || bLayoutChange || bAliasing)
+		{
+			// WAW, WAR and layout transitions wait on every prior access. When the last write already
+			// reached the readers through a barrier, waiting on the reads chains onto that barrier
+			// and the write is available, so only an execution dependency is left.
+			if(state.visibleStage != 0 && state.readStage != 0)
+			{
+				barrier.srcStage = state.readStage | aliasStage;
+				barrier.srcAccess = aliasAccess;
+			}
+			else
+			{
+				barrier.srcStage = state.writeStage | state.readStage | aliasStage;
+				barrier.srcAccess = state.writeAccess | aliasAccess;
+			}
+			bNeedBarrier = bLayoutChange || bAliasing || barrier.srcStage != 0;
+
+			if(bWrite)
+			{
+				state.writeStage = stage;
+				state.writeAccess = access & WRITE_ACCESS_MASK;
+				state.visibleStage = 0;
+				state.visibleAccess = 0;
+				state.readStage = 0;
+			}
+			else
+			{
+				// The transition itself is the last write, visible to this access only.
+				state.writeStage = stage;
+				state.writeAccess = 0;
+				state.visibleStage = stage;
+				state.visibleAccess = access;
+				state.readStage = stage;
+			}
+		}
+		else
+		{
+			// RAW, skipped when an earlier barrier already made the write visible to these stages.
+			if(state.writeStage != 0 && ((stage & ~state.visibleStage) != 0 || (access & ~state.visibleAccess) != 0))
+			{
+				barrier.srcStage = state.writeStage;
+				barrier.srcAccess = state.writeAccess;
+				bNeedBarrier = true;
+
+				state.visibleStage |= stage;
+				state.visibleAccess |= access;
+			}
+			state.readStage |= stage;
+		}
+
+		if(bNeedBarrier && barrier.srcStage == 0)
+		{
+			barrier.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		}
+
+		state.layout = bImage ? layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		return bNeedBarrier;
+	}
+}
+
+void FrameGraph::computeBarriers()
+{
+	std::vector<ResourceState> states(m_resources.size());
+
+	for(ResourceHandle i = 0; i < m_resources.size(); i++)
+	{
+		const auto& resource = m_resources[i];
+		auto& state = states[i];
+		if(resource.isTransient())
+		{
+			// Content starts undefined, the first user owns it without a transfer.
+			if(resource.firstUse != INVALID_PASS)
+			{
+				const auto& pass = m_passes[m_executionOrder[resource.firstUse]];
+				state.queue = pass.executeQueue;
+				state.lastBatch = pass.batch;
+			}
+			continue;
+		}
+		if(resource.import.initialAccess == EResourceAccess::None)
+		{
+			continue;
+		}
+
+		// NOTE: Work from the previous frame is already ordered by the frame semaphores,
+		//       only the layout and the pending write matter here. Imports start on graphics.
+		const AccessInfo& info = getAccessInfo(resource.import.initialAccess);
+		state.layout = resource.isTexture() ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		state.bDefined = true;
+		if(info.bWrite)
+		{
+			state.writeStage = info.stage;
+			state.writeAccess = info.access & WRITE_ACCESS_MASK;
+		}
+		else
+		{
+			state.readStage = info.stage;
+		}
+	}
+
+	auto countBarrier = [this](const Barrier& barrier)
+	{
+		m_stats.barrierCount++;
+		if(barrier.oldLayout != barrier.newLayout)
+		{
+			m_stats.layoutTransitionCount++;
+		}
+		if(barrier.bAliasing)
+		{
+			m_stats.aliasingBarrierCount++;
+		}
+	};
+
+	auto addWait = [this](uint32_t batchIndex,EQueueType srcQueue,uint32_t srcBatch,VkPipelineStageFlags stages)
+	{
+		auto& batch = m_batches[batchIndex];
+		CHECK(srcBatch < batchIndex && m_batches[srcBatch].queue == srcQueue);
+
+		auto& wait = batch.waitBatch[size_t(srcQueue)];
+		wait = (wait == INVALID_BATCH) ? srcBatch : std::max(wait,srcBatch);
+		batch.waitStages[size_t(srcQueue)] |= stages & getQueueStageMask(batch.queue);
+	};
+
+	// NOTE: A resource changes queue behind a semaphore wait on the batch which used it last. The wait
+	//       orders every earlier access before this one and makes them visible to its stage only, so the
+	//       state starts over as if the wait were a write at that stage. Exclusive tracked resources with
+	//       content are handed over by a release after the last pass on the old queue and an acquire on
+	//       the new one, the pair also does the layout transition. Other layout changes get a barrier whose
+	//       source stage sits inside the wait. Returns true when the access was handled here.
+	auto changeQueue = [&](ResourceHandle handle,EQueueType queue,uint32_t batch,VkPipelineStageFlags stage,VkAccessFlags access,VkImageLayout layout,bool bWrite,std::vector<Barrier>& acquires)
+	{
+		auto& state = states[handle];
+		if(state.queue == queue)
+		{
+			return false;
+		}
+
+		const auto& resource = m_resources[handle];
+		const EQueueType srcQueue = state.queue;
+		const bool bFamilyChange = getQueueFamily(srcQueue) != getQueueFamily(queue);
+		CHECK((!bFamilyChange || resource.isTracked() || resource.import.bConcurrent) && "External resource used on two queue families must be concurrent.");
+
+		addWait(batch,srcQueue,state.lastBatch,stage);
+
+		const bool bTransfer = bFamilyChange && resource.isTracked() && !(resource.bImported && resource.import.bConcurrent) && state.bDefined;
+		const VkImageLayout newLayout = resource.isTexture() ? layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		const bool bLayoutChange = resource.isTracked() && newLayout != state.layout;
+
+		ResourceState next { };
+		next.layout = state.layout;
+		next.queue = queue;
+		next.lastOrder = state.lastOrder;
+		next.lastBatch = state.lastBatch;
+		next.bDefined = state.bDefined;
+
+		if(bTransfer || bLayoutChange)
+		{
+			Barrier acquire { };
+			acquire.resource = handle;
+			acquire.srcStage = stage;
+			acquire.srcAccess = 0;
+			acquire.dstStage = stage;
+			acquire.dstAccess = access;
+			acquire.oldLayout = state.layout;
+			acquire.newLayout = newLayout;
+
+			if(bTransfer)
+			{
+				acquire.srcQueueFamily = getQueueFamily(srcQueue);
+				acquire.dstQueueFamily = getQueueFamily(queue);
+
+				Barrier release = acquire;
+				release.srcStage = (state.writeStage | state.readStage) != 0 ? (state.writeStage | state.readStage) : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+				release.srcAccess = state.writeAccess;
+				release.dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+				release.dstAccess = 0;
+
+				auto& releases = state.lastOrder == INVALID_PASS ? m_prologueBarriers : m_passes[m_executionOrder[state.lastOrder]].releaseBarriers;
+				releases.push_back(release);
+				countBarrier(release);
+				m_stats.ownershipTransferCount++;
+			}
+			acquires.push_back(acquire);
+			countBarrier(acquire);
+			next.layout = newLayout;
+		}
+
+		next.writeStage = stage;
+		if(bWrite)
+		{
+			next.writeAccess = access & WRITE_ACCESS_MASK;
+		}
+		else
+		{
+			next.visibleStage = stage;
+			next.visibleAccess = access;
+			next.readStage = stage;
+		}
+		state = next;
+		return true;
+	};
+
+	// Stage of the last access to external resources.
+	std::vector<VkPipelineStageFlags> externalStages(m_resources.size(),0);
+	for(ResourceHandle i = 0; i < m_resources.size(); i++)
+	{
+		if(!m_resources[i].isTracked() && m_resources[i].import.initialAccess != EResourceAccess::None)
+		{
+			externalStages[i] = getAccessInfo(m_resources[i].import.initialAccess).stage;
+		}
+	}
+
+	// External resources are tracked like buffers, layouts stay with the owning pass.
+	auto addDependency = [](Barrier& dependency,const Barrier& barrier)
+	{
+		dependency.srcStage |= barrier.srcStage;
+		dependency.srcAccess |= barrier.srcAccess;
+		dependency.dstStage |= barrier.dstStage;
+		dependency.dstAccess |= barrier.dstAccess;
+	};
+
+	for(uint32_t order = 0; order < m_executionOrder.size(); order++)
+	{
+		auto& pass = m_passes[m_executionOrder[order]];
+		pass.waitStages = pass.stages;
+
+		for(const auto& access : pass.merged)
+		{
+			const auto& resource = m_resources[access.resource];
+			auto& state = states[access.resource];
+			if(!resource.isTracked())
+			{
+				if(changeQueue(access.resource,pass.executeQueue,pass.batch,access.stage,access.access,VK_IMAGE_LAYOUT_UNDEFINED,access.bWrite,pass.barriers))
+				{
+					externalStages[access.resource] = 0;
+				}
+				else
+				{
+					Barrier barrier { };
+					if(transition(state,false,access.stage,access.access,VK_IMAGE_LAYOUT_UNDEFINED,access.bWrite,0,0,barrier))
+					{
+						addDependency(pass.externalDependency,barrier);
+					}
+				}
+				pass.waitStages |= externalStages[access.resource];
+				externalStages[access.resource] = access.stage;
+
+				state.lastOrder = order;
+				state.lastBatch = pass.batch;
+				state.bDefined = true;
+				continue;
+			}
+
+			VkPipelineStageFlags aliasStage = 0;
+			VkAccessFlags aliasAccess = 0;
+			if(resource.firstUse == order)
+			{
+				for(auto predecessor : resource.aliasPredecessors)
+				{
+					const auto& predecessorState = states[predecessor];
+					if(predecessorState.queue != pass.executeQueue)
+					{
+						// The semaphore orders the memory reuse, the aliasing barrier chains onto the wait.
+						addWait(pass.batch,predecessorState.queue,predecessorState.lastBatch,access.stage);
+						aliasStage |= access.stage;
+						continue;
+					}
+					aliasStage |= predecessorState.writeStage | predecessorState.readStage;
+					aliasAccess |= predecessorState.writeAccess;
+				}
+				if(!resource.aliasPredecessors.empty() && aliasStage == 0)
+				{
+					aliasStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+				}
+			}
+
+			if(!changeQueue(access.resource,pass.executeQueue,pass.batch,access.stage,access.access,access.layout,access.bWrite,pass.barriers))
+			{
+				Barrier barrier { };
+				barrier.resource = access.resource;
+				if(transition(state,resource.isTexture(),access.stage,access.access,access.layout,access.bWrite,aliasStage,aliasAccess,barrier))
+				{
+					countBarrier(barrier);
+					pass.barriers.push_back(barrier);
+				}
+			}
+			state.lastOrder = order;
+			state.lastBatch = pass.batch;
+			state.bDefined = true;
+		}
+
+		pass.waitStages &= getQueueStageMask(pass.executeQueue);
+
+		// Let the pass' own barriers chain onto the dependency, like they do onto a semaphore wait.
+		if(pass.externalDependency.srcStage != 0)
+		{
+			pass.externalDependency.dstStage |= pass.waitStages;
+		}
+	}
+
+	// NOTE: The first batch of another queue waits on the prologue batch, which orders it after the
+	//       uploads of this frame and after the graphics work of the previous one.
+	std::array<bool,size_t(EQueueType::Count)> bQueueStarted = { };
+	for(uint32_t i = 1; i < m_batches.size(); i++)
+	{
+		const EQueueType queue = m_batches[i].queue;
+		if(queue != EQueueType::Graphics && !bQueueStarted[size_t(queue)])
+		{
+			addWait(i,EQueueType::Graphics,0,VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+			bQueueStarted[size_t(queue)] = true;
+		}
+	}
+
+	// NOTE: The epilogue runs on graphics, every import comes back there for the next frame. The last
+	//       batch also waits on the rest of the async work, so the frame fence covers all of it.
+	const uint32_t lastBatch = uint32_t(m_batches.size() - 1);
+	for(uint32_t i = 0; i < lastBatch; i++)
+	{
+		if(m_batches[i].queue != EQueueType::Graphics)
+		{
+			m_batches[lastBatch].waitBatch[size_t(m_batches[i].queue)] = i;
+			m_batches[lastBatch].waitStages[size_t(m_batches[i].queue)] |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		}
+	}
+
+	for(ResourceHandle i = 0; i < m_resources.size(); i++)
+	{
+		const auto& resource = m_resources[i];
+		if(!resource.bImported)
+		{
+			continue;
+		}
+
+		const bool bFinal = resource.import.finalAccess != EResourceAccess::None;
+		const AccessInfo& info = getAccessInfo(resource.import.finalAccess);
+		const VkImageLayout layout = resource.isTexture() && bFinal ? info.layout : states[i].layout;
+		const VkPipelineStageFlags stage = bFinal ? info.stage : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		if(changeQueue(i,EQueueType::Graphics,lastBatch,stage,info.access,layout,info.bWrite,m_epilogueBarriers) || !bFinal)
+		{
+			continue;
+		}
+
+		if(!resource.isTracked())
+		{
+			Barrier barrier { };
+			if(transition(states[i],false,info.stage,info.access,VK_IMAGE_LAYOUT_UNDEFINED,info.bWrite,0,0,barrier))
+			{
+				addDependency(m_externalEpilogue,barrier);
+			}
+			continue;
+		}
+
+		Barrier barrier { };
+		barrier.resource = i;
+		if(transition(states[i],resource.isTexture(),info.stage,info.access,layout,info.bWrite,0,0,barrier))
+		{
+			countBarrier(barrier);
+			m_epilogueBarriers.push_back(barrier);
+		}
+	}
+}
+
+std::string FrameGraph::dump() const
+{
+	std::stringstream ss;
+	auto dumpBarrier = [&](const char* prefix,const Barrier& barrier)
+	{
+		ss << prefix << m_resources[barrier.resource].name
+		   << " stage 0x" << std::hex << barrier.srcStage << "->0x" << barrier.dstStage
+		   << " access 0x" << barrier.srcAccess << "->0x" << barrier.dstAccess << std::dec
+		   << " layout " << barrier.oldLayout << "->" << barrier.newLayout
+		   << (barrier.bAliasing ? " (alias)" : "");
+		if(barrier.srcQueueFamily != barrier.dstQueueFamily)
+		{
+			ss << " family " << barrier.srcQueueFamily << "->" << barrier.dstQueueFamily;
+		}
+		ss << "\n";
+	};
+
+	for(uint32_t i = 0; i < m_batches.size(); i++)
+	{
+		const auto& batch = m_batches[i];
+		ss << "  batch " << i << " " << getQueueName(batch.queue) << " passes [" << batch.firstOrder << "," << batch.firstOrder + batch.orderCount << ")";
+		for(size_t queue = 0; queue < batch.waitBatch.size(); queue++)
+		{
+			if(batch.waitBatch[queue] != INVALID_BATCH)
+			{
+				ss << " waits " << batch.waitBatch[queue] << " stage 0x" << std::hex << batch.waitStages[queue] << std::dec;
+			}
+		}
+		ss << "\n";
+	}
+	for(const auto& barrier : m_prologueBarriers)
+	{
+		dumpBarrier("  prologue ",barrier);
+	}
+	for(uint32_t i = 0; i < m_passes.size(); i++)
+	{
+		const auto& pass = m_passes[i];
+		ss << (pass.bCulled ? "  culled " : "  pass   ") << pass.name;
+		if(!pass.bCulled)
+		{
+			ss << " (" << getQueueName(pass.executeQueue) << ", batch " << pass.batch << ")";
+		}
+		ss << "\n";
+		for(const auto& barrier : pass.barriers)
+		{
+			dumpBarrier("    barrier ",barrier);
+		}
+		for(const auto& barrier : pass.releaseBarriers)
+		{
+			dumpBarrier("    release ",barrier);
+		}
+	}
+	for(const auto& barrier : m_epilogueBarriers)
+	{
+		dumpBarrier("  epilogue ",barrier);
+	}
+	for(const auto& resource : m_resources)
+	{
+		if(resource.isTransient() && resource.heap != ~0u)
+		{
+			ss << "  transient " << resource.name << " heap " << resource.heap << " offset " << resource.offset
+			   << " size " << resource.memory.size << " life [" << resource.firstUse << "," << resource.lastUse << "]\n";
+		}
+	}
+	ss << "  passes " << m_stats.passCount << " culled " << m_stats.culledPassCount
+	   << " barriers " << m_stats.barrierCount << " transients " << m_stats.transientCount
+	   << " bytes " << m_stats.unaliasedBytes << " -> " << m_stats.aliasedBytes
+	   << " async compute passes " << m_stats.asyncComputePassCount << " batches " << m_stats.submitBatchCount
+	   << " ownership transfers " << m_stats.ownershipTransferCount;
+	return ss.str();
+}
+
+} }
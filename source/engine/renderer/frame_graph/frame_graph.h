@@ -1 +1,384 @@
 #pragma once
+#include "define.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <array>
+#include <Vma/vk_mem_alloc.h>
+
+namespace engine{
+
+class VulkanImage;
+class VulkanBuffer;
+
+namespace frame_graph{
+
+using ResourceHandle = uint32_t;
+constexpr ResourceHandle INVALID_RESOURCE = ~0u;
+constexpr uint32_t INVALID_PASS = ~0u;
+constexpr uint32_t INVALID_BATCH = ~0u;
+
+enum class EResourceType : uint32_t
+{
+	Texture,
+	Buffer,
+};
+
+struct TextureDesc
+{
+	uint32_t width = 1;
+	uint32_t height = 1;
+	uint32_t mipLevels = 1;
+	uint32_t arrayLayers = 1;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+	// Extra usage, the graph adds the bits implied by the declared accesses.
+	VkImageUsageFlags usage = 0;
+};
+
+struct BufferDesc
+{
+	VkDeviceSize size = 0;
+	VkBufferUsageFlags usage = 0;
+};
+
+struct ImportDesc
+{
+	// State the resource is in before the first pass and must be in after the last pass.
+	// None means "don't care" for initial and "leave as is" for final.
+	EResourceAccess initialAccess = EResourceAccess::None;
+	EResourceAccess finalAccess = EResourceAccess::None;
+
+	// NOTE: The owning pass records its own barriers for this resource, the graph only uses
+	//       the declared accesses for ordering, culling and submit wait stages.
+	bool bExternalBarrier = false;
+
+	// NOTE: Content is consumed outside the graph (history, present, readback), so writers are never culled.
+	bool bRetained = true;
+
+	// NOTE: Created with VK_SHARING_MODE_CONCURRENT over the graph's queue families, moving it to
+	//       another queue needs a semaphore but no ownership transfer. External resources used on
+	//       more than one queue family must set it, the graph can't transfer what it doesn't track.
+	bool bConcurrent = false;
+};
+
+struct MemoryRequirement
+{
+	VkDeviceSize size = 0;
+	VkDeviceSize alignment = 1;
+	uint32_t memoryTypeBits = ~0u;
+};
+
+struct Barrier
+{
+	ResourceHandle resource = INVALID_RESOURCE;
+
+	VkPipelineStageFlags srcStage = 0;
+	VkPipelineStageFlags dstStage = 0;
+	VkAccessFlags srcAccess = 0;
+	VkAccessFlags dstAccess = 0;
+
+	VkImageLayout oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkImageLayout newLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	// First use of memory previously owned by another transient.
+	bool bAliasing = false;
+
+	// Set on both halves of a queue family ownership transfer, the release is recorded after the
+	// last pass on the old queue and the acquire in front of the first pass on the new one.
+	uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+	uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+};
+
+// NOTE: Consecutive live passes on one queue, submitted together. The first and the last batch are
+//       always graphics, they carry the prologue and the epilogue. A batch waits on the timeline value
+//       signaled by waitBatch[queue] of the other queues before waitStages[queue] run.
+struct SubmitBatch
+{
+	EQueueType queue = EQueueType::Graphics;
+	uint32_t firstOrder = 0; // index into execution order.
+	uint32_t orderCount = 0;
+
+	std::array<uint32_t,size_t(EQueueType::Count)> waitBatch = { INVALID_BATCH, INVALID_BATCH, INVALID_BATCH };
+	std::array<VkPipelineStageFlags,size_t(EQueueType::Count)> waitStages = { };
+};
+
+struct HeapInfo
+{
+	VkDeviceSize size = 0;
+	VkDeviceSize alignment = 1;
+	uint32_t memoryTypeBits = ~0u;
+};
+
+struct FrameGraphStats
+{
+	uint32_t passCount = 0;
+	uint32_t culledPassCount = 0;
+	uint32_t transientCount = 0;
+	uint32_t barrierCount = 0;
+	uint32_t layoutTransitionCount = 0;
+	uint32_t aliasingBarrierCount = 0;
+	uint32_t heapCount = 0;
+	uint32_t asyncComputePassCount = 0;
+	uint32_t submitBatchCount = 0;
+	uint32_t ownershipTransferCount = 0;
+
+	VkDeviceSize unaliasedBytes = 0;
+	VkDeviceSize aliasedBytes = 0;
+};
+
+class FrameGraph;
+
+using ExecuteFunc = std::function<void(VkCommandBuffer cmd,const FrameGraph& graph)>;
+using MemoryRequirementFunc = std::function<MemoryRequirement(const FrameGraph& graph,ResourceHandle resource)>;
+
+class PassBuilder
+{
+public:
+	PassBuilder(FrameGraph& graph,uint32_t pass) : m_graph(graph), m_pass(pass) { }
+
+	ResourceHandle createTexture(const std::string& name,const TextureDesc& desc);
+	ResourceHandle createBuffer(const std::string& name,const BufferDesc& desc);
+
+	ResourceHandle read(ResourceHandle resource,EResourceAccess access);
+	ResourceHandle write(ResourceHandle resource,EResourceAccess access);
+
+	// NOTE: Pass has effects the graph can't see (readback, upload, cpu sync), never cull it.
+	void sideEffect();
+	void setQueue(EQueueType queue);
+
+private:
+	FrameGraph& m_graph;
+	uint32_t m_pass;
+};
+
+// NOTE: Built every frame. Passes are executed in declaration order, the graph only removes
+//       passes whose results are never consumed. Typical usage:
+//
+//       FrameGraph graph;
+//       auto history = graph.importTexture("History",image,view,desc,importDesc);
+//       graph.addPass("Blur",[&](PassBuilder& builder)
+//       {
+//           temp = builder.createTexture("BlurTemp",desc);
+//           builder.write(temp,EResourceAccess::ComputeShaderWrite);
+//           builder.read(history,EResourceAccess::ComputeShaderRead);
+//       },[=](VkCommandBuffer cmd,const FrameGraph& graph){ ... graph.getImageView(temp) ... });
+//       graph.compile(queryFunc);
+//       cache.realize(graph,slot);
+//       graph.execute(cmd);
+class FrameGraph
+{
+	friend class PassBuilder;
+
+public:
+	struct Resource
+	{
+		std::string name;
+		EResourceType type = EResourceType::Texture;
+		TextureDesc texture = {};
+		BufferDesc buffer = {};
+
+		bool bImported = false;
+		ImportDesc import = {};
+
+		// Realized handles, set by import or by realize().
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkBuffer vkBuffer = VK_NULL_HANDLE;
+
+		// Compile results.
+		uint32_t firstUse = INVALID_PASS; // index into execution order.
+		uint32_t lastUse = INVALID_PASS;
+		VkFlags derivedUsage = 0;
+		MemoryRequirement memory = {};
+		uint32_t heap = ~0u;
+		VkDeviceSize offset = 0;
+		std::vector<ResourceHandle> aliasPredecessors = {};
+
+		bool isTexture() const { return type == EResourceType::Texture; }
+		bool isTransient() const { return !bImported; }
+		bool isTracked() const { return !(bImported && import.bExternalBarrier); }
+	};
+
+	struct PassAccess
+	{
+		ResourceHandle resource;
+		EResourceAccess access;
+	};
+
+	// Accesses of one pass to one resource merged together.
+	struct MergedAccess
+	{
+		ResourceHandle resource;
+		VkPipelineStageFlags stage;
+		VkAccessFlags access;
+		VkImageLayout layout;
+		bool bWrite;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		EQueueType queue = EQueueType::Graphics; // requested queue.
+		bool bSideEffect = false;
+		std::vector<PassAccess> accesses = {};
+		ExecuteFunc execute = nullptr;
+
+		// Compile results.
+		bool bCulled = false;
+		EQueueType executeQueue = EQueueType::Graphics; // requested queue, or graphics when it isn't available.
+		uint32_t batch = INVALID_BATCH;
+		std::vector<MergedAccess> merged = {};
+		std::vector<Barrier> barriers = {};
+		std::vector<Barrier> releaseBarriers = {}; // ownership releases recorded after the pass.
+		VkPipelineStageFlags stages = 0;
+
+		// Destination stages for a semaphore wait in front of this pass. Adds the stages of the previous
+		// access to every external resource, so the pass' own barriers chain onto the wait.
+		VkPipelineStageFlags waitStages = 0;
+
+		// Global memory barrier replacing that semaphore when passes share one command buffer.
+		// srcStage is 0 when nothing external has to be waited on.
+		Barrier externalDependency = {};
+	};
+
+public:
+	FrameGraph() = default;
+
+	uint32_t addPass(const std::string& name,const std::function<void(PassBuilder&)>& setup,ExecuteFunc&& execute);
+
+	ResourceHandle createTexture(const std::string& name,const TextureDesc& desc);
+	ResourceHandle createBuffer(const std::string& name,const BufferDesc& desc);
+
+	ResourceHandle importTexture(const std::string& name,VkImage image,VkImageView view,const TextureDesc& desc,const ImportDesc& import);
+	ResourceHandle importTexture(const std::string& name,VulkanImage* image,const ImportDesc& import);
+	ResourceHandle importBuffer(const std::string& name,VkBuffer buffer,VkDeviceSize size,const ImportDesc& import);
+	ResourceHandle importBuffer(const std::string& name,VulkanBuffer* buffer,const ImportDesc& import);
+
+	// NOTE: Async compute passes only leave the graphics queue when the families differ, pass the same
+	//       family twice to run everything on graphics. Kept across reset().
+	void setQueueFamilies(uint32_t graphicsFamily,uint32_t asyncComputeFamily);
+	uint32_t getQueueFamily(EQueueType queue) const { return m_queueFamilies[size_t(queue)]; }
+	bool hasAsyncCompute() const { return getQueueFamily(EQueueType::AsyncCompute) != getQueueFamily(EQueueType::Graphics); }
+
+	// NOTE: Cull passes, compute barriers and place transients. queryMemory may be null,
+	//       transients then get no memory placement (cpu only validation of culling and barriers).
+	bool compile(const MemoryRequirementFunc& queryMemory);
+
+	// NOTE: Record barriers and pass callbacks. With a command buffer, external dependencies are
+	//       recorded as memory barriers too, so passes can share it. cmd may be VK_NULL_HANDLE when every
+	//       live pass records into its own command buffer, semaphores then order the external resources
+	//       and the created buffers. Created textures need a command buffer for their layout transitions.
+	void execute(VkCommandBuffer cmd);
+
+	// NOTE: Same as execute, split for recording passes on several threads into their own command buffers.
+	//       Submitting the buffers in execution order, prologue first and epilogue last, gives the same
+	//       result as execute. With async compute the buffers go out per submit batch, prologue and
+	//       epilogue are recorded for the graphics queue and each pass for its execute queue.
+	void executePrologue(VkCommandBuffer cmd) const;
+	void executePass(uint32_t order,VkCommandBuffer cmd) const;
+	void executeEpilogue(VkCommandBuffer cmd) const;
+
+	void reset();
+
+public:
+	const std::vector<Pass>& getPasses() const { return m_passes; }
+	const std::vector<Resource>& getResources() const { return m_resources; }
+	const std::vector<uint32_t>& getExecutionOrder() const { return m_executionOrder; }
+	const std::vector<SubmitBatch>& getSubmitBatches() const { return m_batches; }
+	const std::vector<Barrier>& getPrologueBarriers() const { return m_prologueBarriers; }
+	const std::vector<Barrier>& getEpilogueBarriers() const { return m_epilogueBarriers; }
+	const Barrier& getExternalEpilogue() const { return m_externalEpilogue; }
+	const std::vector<HeapInfo>& getHeaps() const { return m_heaps; }
+	const FrameGraphStats& getStats() const { return m_stats; }
+
+	bool isCompiled() const { return m_bCompiled; }
+	bool isPassCulled(uint32_t pass) const { return m_passes[pass].bCulled; }
+	VkPipelineStageFlags getPassStages(uint32_t pass) const { return m_passes[pass].stages; }
+	VkPipelineStageFlags getPassWaitStages(uint32_t pass) const { return m_passes[pass].waitStages; }
+	EQueueType getPassQueue(uint32_t pass) const { return m_passes[pass].executeQueue; }
+
+	const Resource& getResource(ResourceHandle handle) const { return m_resources[handle]; }
+	VkImage getImage(ResourceHandle handle) const { return m_resources[handle].image; }
+	VkImageView getImageView(ResourceHandle handle) const { return m_resources[handle].view; }
+	VkBuffer getBuffer(ResourceHandle handle) const { return m_resources[handle].vkBuffer; }
+
+	// Usage bits implied by the accesses, valid after compile.
+	VkImageCreateInfo getImageCreateInfo(ResourceHandle handle) const;
+	VkBufferCreateInfo getBufferCreateInfo(ResourceHandle handle) const;
+
+	void setRealizedHandles(ResourceHandle handle,VkImage image,VkImageView view,VkBuffer buffer);
+
+	std::string dump() const;
+
+private:
+	ResourceHandle addResource(Resource&& resource);
+
+	void cullPasses();
+	void mergeAccesses();
+	void assignQueues();
+	void buildBatches();
+	void computeLifetimes();
+	void placeTransients(const MemoryRequirementFunc& queryMemory);
+	void computeBarriers();
+
+private:
+	std::vector<Pass> m_passes = {};
+	std::vector<Resource> m_resources = {};
+
+	std::vector<uint32_t> m_executionOrder = {};
+	std::vector<SubmitBatch> m_batches = {};
+	std::vector<Barrier> m_prologueBarriers = {};
+	std::vector<Barrier> m_epilogueBarriers = {};
+	Barrier m_externalEpilogue = {};
+	std::vector<HeapInfo> m_heaps = {};
+
+	FrameGraphStats m_stats = {};
+	bool m_bCompiled = false;
+
+	std::array<uint32_t,size_t(EQueueType::Count)> m_queueFamilies = { };
+};
+
+// NOTE: Owns the device memory behind transient resources. One slot per back buffer, a slot
+//       is rebuilt only when the compiled placement changes, so a steady graph allocates nothing.
+class FrameGraphTransientCache
+{
+public:
+	FrameGraphTransientCache() = default;
+	~FrameGraphTransientCache() { release(); }
+
+	void init(uint32_t slotCount);
+	void release();
+
+	MemoryRequirement queryMemory(const FrameGraph& graph,ResourceHandle handle);
+
+	// NOTE: Create or reuse transients of a compiled graph for this slot and patch the handles into the graph.
+	void realize(FrameGraph& graph,uint32_t slot);
+
+	VkDeviceSize getAllocatedBytes() const;
+
+private:
+	struct Slot
+	{
+		uint64_t signature = 0;
+		std::vector<VmaAllocation> heaps = {};
+		std::vector<VkImage> images = {};
+		std::vector<VkImageView> views = {};
+		std::vector<VkBuffer> buffers = {};
+		std::vector<VkDeviceSize> heapSizes = {};
+	};
+
+	void releaseSlot(Slot& slot);
+
+	std::vector<Slot> m_slots = {};
+
+	// memory requirement by create info hash, queried once with a throwaway object.
+	std::vector<std::pair<uint64_t,MemoryRequirement>> m_requirementCache = {};
+};
+
+// CPU only schedule validation, see frame_graph_validate.cpp.
+extern bool validateFrameGraph(const FrameGraph& graph,std::string& outError);
+extern bool runFrameGraphSelfTest();
+
+} }
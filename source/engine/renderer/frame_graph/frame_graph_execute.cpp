@@ -0,0 +1,366 @@
+#include "frame_graph.h"
+#include "../../vk/vk_rhi.h"
+
+namespace engine { namespace frame_graph{
+
+ResourceHandle FrameGraph::importTexture(const std::string& name,VulkanImage* image,const ImportDesc& import)
+{
+	CHECK(image);
+	const auto& info = image->getInfo();
+
+	TextureDesc desc { };
+	desc.width = info.extent.width;
+	desc.height = info.extent.height;
+	desc.mipLevels = info.mipLevels;
+	desc.arrayLayers = info.arrayLayers;
+	desc.format = info.format;
+	desc.usage = info.usage;
+	desc.aspect = (info.usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+
+	return importTexture(name,image->getImage(),image->getImageView(),desc,import);
+}
+
+ResourceHandle FrameGraph::importBuffer(const std::string& name,VulkanBuffer* buffer,const ImportDesc& import)
+{
+	CHECK(buffer);
+	return importBuffer(name,buffer->GetVkBuffer(),buffer->getSize(),import);
+}
+
+// NOTE: global may be null, external dependencies are then left to the submit semaphores. Without a
+//       command buffer every pass is its own submit waiting on the one before, that semaphore already
+//       makes buffer writes visible, only image layout transitions still need a command buffer.
+static void recordBarriers(VkCommandBuffer cmd,const FrameGraph& graph,const std::vector<Barrier>& barriers,const Barrier* global)
+{
+	if(cmd == VK_NULL_HANDLE)
+	{
+		for(const auto& barrier : barriers)
+		{
+			CHECK(!graph.getResource(barrier.resource).isTexture() && "Graph transitions a texture for this pass but no command buffer was given.");
+		}
+		return;
+	}
+
+	const bool bGlobal = global && global->srcStage != 0;
+	if(barriers.empty() && !bGlobal)
+	{
+		return;
+	}
+
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	VkPipelineStageFlags srcStage = 0;
+	VkPipelineStageFlags dstStage = 0;
+
+	VkMemoryBarrier memoryBarrier { };
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	if(bGlobal)
+	{
+		memoryBarrier.srcAccessMask = global->srcAccess;
+		memoryBarrier.dstAccessMask = global->dstAccess;
+		srcStage |= global->srcStage;
+		dstStage |= global->dstStage;
+	}
+
+	for(const auto& barrier : barriers)
+	{
+		const auto& resource = graph.getResource(barrier.resource);
+		srcStage |= barrier.srcStage;
+		dstStage |= barrier.dstStage;
+
+		if(resource.isTexture())
+		{
+			VkImageMemoryBarrier imageBarrier { };
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = barrier.srcAccess;
+			imageBarrier.dstAccessMask = barrier.dstAccess;
+			imageBarrier.oldLayout = barrier.oldLayout;
+			imageBarrier.newLayout = barrier.newLayout;
+			imageBarrier.srcQueueFamilyIndex = barrier.srcQueueFamily;
+			imageBarrier.dstQueueFamilyIndex = barrier.dstQueueFamily;
+			imageBarrier.image = resource.image;
+			imageBarrier.subresourceRange.aspectMask = resource.texture.aspect;
+			imageBarrier.subresourceRange.baseMipLevel = 0;
+			imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			imageBarrier.subresourceRange.baseArrayLayer = 0;
+			imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+			imageBarriers.push_back(imageBarrier);
+		}
+		else
+		{
+			VkBufferMemoryBarrier bufferBarrier { };
+			bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			bufferBarrier.srcAccessMask = barrier.srcAccess;
+			bufferBarrier.dstAccessMask = barrier.dstAccess;
+			bufferBarrier.srcQueueFamilyIndex = barrier.srcQueueFamily;
+			bufferBarrier.dstQueueFamilyIndex = barrier.dstQueueFamily;
+			bufferBarrier.buffer = resource.vkBuffer;
+			bufferBarrier.offset = 0;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			bufferBarriers.push_back(bufferBarrier);
+		}
+	}
+
+	vkCmdPipelineBarrier(
+		cmd,
+		srcStage,
+		dstStage,
+		0,
+		bGlobal ? 1 : 0,&memoryBarrier,
+		(uint32)bufferBarriers.size(),bufferBarriers.data(),
+		(uint32)imageBarriers.size(),imageBarriers.data()
+	);
+}
+
+void FrameGraph::execute(VkCommandBuffer cmd)
+{
+	CHECK(m_bCompiled);
+	CHECK((cmd == VK_NULL_HANDLE || m_batches.size() == 1) && "Async compute passes need one command buffer per queue, record them with executePass.");
+
+	executePrologue(cmd);
+	for(uint32_t order = 0; order < m_executionOrder.size(); order++)
+	{
+		executePass(order,cmd);
+	}
+	executeEpilogue(cmd);
+}
+
+void FrameGraph::executePrologue(VkCommandBuffer cmd) const
+{
+	recordBarriers(cmd,*this,m_prologueBarriers,nullptr);
+}
+
+void FrameGraph::executePass(uint32_t order,VkCommandBuffer cmd) const
+{
+	const bool bShared = cmd != VK_NULL_HANDLE;
+	const auto& pass = m_passes[m_executionOrder[order]];
+	recordBarriers(cmd,*this,pass.barriers,bShared ? &pass.externalDependency : nullptr);
+
+	if(pass.execute)
+	{
+		pass.execute(cmd,*this);
+	}
+
+	recordBarriers(cmd,*this,pass.releaseBarriers,nullptr);
+}
+
+void FrameGraph::executeEpilogue(VkCommandBuffer cmd) const
+{
+	const bool bShared = cmd != VK_NULL_HANDLE;
+	recordBarriers(cmd,*this,m_epilogueBarriers,bShared ? &m_externalEpilogue : nullptr);
+}
+
+static uint64_t hashCombine(uint64_t seed,uint64_t value)
+{
+	return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+static uint64_t hashImageInfo(const VkImageCreateInfo& info)
+{
+	uint64_t hash = 1;
+	hash = hashCombine(hash,info.format);
+	hash = hashCombine(hash,info.extent.width);
+	hash = hashCombine(hash,info.extent.height);
+	hash = hashCombine(hash,info.mipLevels);
+	hash = hashCombine(hash,info.arrayLayers);
+	hash = hashCombine(hash,info.usage);
+	return hash;
+}
+
+static uint64_t hashBufferInfo(const VkBufferCreateInfo& info)
+{
+	uint64_t hash = 2;
+	hash = hashCombine(hash,info.size);
+	hash = hashCombine(hash,info.usage);
+	return hash;
+}
+
+void FrameGraphTransientCache::init(uint32_t slotCount)
+{
+	release();
+	m_slots.resize(slotCount);
+}
+
+void FrameGraphTransientCache::release()
+{
+	for(auto& slot : m_slots)
+	{
+		releaseSlot(slot);
+	}
+	m_slots.clear();
+	m_requirementCache.clear();
+}
+
+void FrameGraphTransientCache::releaseSlot(Slot& slot)
+{
+	VkDevice device = VulkanRHI::get()->getDevice();
+
+	for(auto view : slot.views)
+	{
+		if(view != VK_NULL_HANDLE) vkDestroyImageView(device,view,nullptr);
+	}
+	for(auto image : slot.images)
+	{
+		if(image != VK_NULL_HANDLE) vkDestroyImage(device,image,nullptr);
+	}
+	for(auto buffer : slot.buffers)
+	{
+		if(buffer != VK_NULL_HANDLE) vkDestroyBuffer(device,buffer,nullptr);
+	}
+	for(auto allocation : slot.heaps)
+	{
+		vmaFreeMemory(VulkanRHI::get()->getVmaAllocator(),allocation);
+	}
+	slot = {};
+}
+
+MemoryRequirement FrameGraphTransientCache::queryMemory(const FrameGraph& graph,ResourceHandle handle)
+{
+	const auto& resource = graph.getResource(handle);
+	VkDevice device = VulkanRHI::get()->getDevice();
+
+	const uint64_t key = resource.isTexture() ? hashImageInfo(graph.getImageCreateInfo(handle)) : hashBufferInfo(graph.getBufferCreateInfo(handle));
+	for(const auto& pair : m_requirementCache)
+	{
+		if(pair.first == key) return pair.second;
+	}
+
+	// NOTE: Requirements only depend on the create info, so query once with a throwaway object.
+	VkMemoryRequirements requirements { };
+	if(resource.isTexture())
+	{
+		auto info = graph.getImageCreateInfo(handle);
+		VkImage image;
+		vkCheck(vkCreateImage(device,&info,nullptr,&image));
+		vkGetImageMemoryRequirements(device,image,&requirements);
+		vkDestroyImage(device,image,nullptr);
+	}
+	else
+	{
+		auto info = graph.getBufferCreateInfo(handle);
+		VkBuffer buffer;
+		vkCheck(vkCreateBuffer(device,&info,nullptr,&buffer));
+		vkGetBufferMemoryRequirements(device,buffer,&requirements);
+		vkDestroyBuffer(device,buffer,nullptr);
+	}
+
+	MemoryRequirement result { requirements.size, requirements.alignment, requirements.memoryTypeBits };
+	m_requirementCache.push_back({ key, result });
+	return result;
+}
+
+void FrameGraphTransientCache::realize(FrameGraph& graph,uint32_t slotIndex)
+{
+	CHECK(graph.isCompiled());
+	CHECK(slotIndex < m_slots.size());
+	auto& slot = m_slots[slotIndex];
+
+	const auto& resources = graph.getResources();
+
+	uint64_t signature = 3;
+	for(ResourceHandle i = 0; i < resources.size(); i++)
+	{
+		const auto& resource = resources[i];
+		if(!resource.isTransient() || resource.heap == ~0u) continue;
+
+		signature = hashCombine(signature,resource.isTexture() ? hashImageInfo(graph.getImageCreateInfo(i)) : hashBufferInfo(graph.getBufferCreateInfo(i)));
+		signature = hashCombine(signature,resource.heap);
+		signature = hashCombine(signature,resource.offset);
+	}
+	for(const auto& heap : graph.getHeaps())
+	{
+		signature = hashCombine(signature,heap.size);
+	}
+
+	// NOTE: The slot's last frame is finished once its back buffer comes around again,
+	//       so a changed placement can destroy the old objects right away.
+	if(signature != slot.signature)
+	{
+		releaseSlot(slot);
+		slot.signature = signature;
+
+		VkDevice device = VulkanRHI::get()->getDevice();
+		VmaAllocator allocator = VulkanRHI::get()->getVmaAllocator();
+
+		for(const auto& heap : graph.getHeaps())
+		{
+			VkMemoryRequirements requirements { heap.size, heap.alignment, heap.memoryTypeBits };
+
+			VmaAllocationCreateInfo allocInfo { };
+			allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+			allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+			VmaAllocation allocation = nullptr;
+			vkCheck(vmaAllocateMemory(allocator,&requirements,&allocInfo,&allocation,nullptr));
+			slot.heaps.push_back(allocation);
+			slot.heapSizes.push_back(heap.size);
+		}
+
+		for(ResourceHandle i = 0; i < resources.size(); i++)
+		{
+			const auto& resource = resources[i];
+			if(!resource.isTransient() || resource.heap == ~0u) continue;
+
+			if(resource.isTexture())
+			{
+				auto info = graph.getImageCreateInfo(i);
+				VkImage image;
+				vkCheck(vkCreateImage(device,&info,nullptr,&image));
+				vkCheck(vmaBindImageMemory2(allocator,slot.heaps[resource.heap],resource.offset,image,nullptr));
+
+				VkImageViewCreateInfo viewInfo { };
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = image;
+				viewInfo.viewType = info.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = info.format;
+				viewInfo.subresourceRange.aspectMask = resource.texture.aspect;
+				viewInfo.subresourceRange.baseMipLevel = 0;
+				viewInfo.subresourceRange.levelCount = info.mipLevels;
+				viewInfo.subresourceRange.baseArrayLayer = 0;
+				viewInfo.subresourceRange.layerCount = info.arrayLayers;
+
+				VkImageView view;
+				vkCheck(vkCreateImageView(device,&viewInfo,nullptr,&view));
+
+				slot.images.push_back(image);
+				slot.views.push_back(view);
+				slot.buffers.push_back(VK_NULL_HANDLE);
+			}
+			else
+			{
+				auto info = graph.getBufferCreateInfo(i);
+				VkBuffer buffer;
+				vkCheck(vkCreateBuffer(device,&info,nullptr,&buffer));
+				vkCheck(vmaBindBufferMemory2(allocator,slot.heaps[resource.heap],resource.offset,buffer,nullptr));
+
+				slot.images.push_back(VK_NULL_HANDLE);
+				slot.views.push_back(VK_NULL_HANDLE);
+				slot.buffers.push_back(buffer);
+			}
+		}
+	}
+
+	uint32_t objectIndex = 0;
+	for(ResourceHandle i = 0; i < resources.size(); i++)
+	{
+		const auto& resource = resources[i];
+		if(!resource.isTransient() || resource.heap == ~0u) continue;
+
+		graph.setRealizedHandles(i,slot.images[objectIndex],slot.views[objectIndex],slot.buffers[objectIndex]);
+		objectIndex++;
+	}
+}
+
+VkDeviceSize FrameGraphTransientCache::getAllocatedBytes() const
+{
+	VkDeviceSize bytes = 0;
+	for(const auto& slot : m_slots)
+	{
+		for(auto size : slot.heapSizes)
+		{
+			bytes += size;
+		}
+	}
+	return bytes;
+}
+
+} }
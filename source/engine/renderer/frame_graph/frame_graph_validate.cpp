@@ -0,0 +1,981 @@
+#include "frame_graph.h"
+#include <random>
+#include <sstream>
+
+namespace engine { namespace frame_graph{
+
+// NOTE: Replays the compiled schedule with its own hazard model, independent from the barrier
+//       builder in frame_graph.cpp. Needs no device, so it runs on any machine.
+namespace
+{
+	struct SimulatedState
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		bool bDefined = false; // holds content written in this frame or imported.
+
+		VkPipelineStageFlags writeStage = 0;
+		VkAccessFlags writeAccess = 0;
+		bool bWriteAvailable = false;
+
+		// Stages ordered after the last write, a barrier whose source hits one of them chains onto it.
+		VkPipelineStageFlags visibleStage = 0;
+		VkAccessFlags visibleAccess = 0;
+
+		VkPipelineStageFlags readStage = 0;
+		VkPipelineStageFlags readSyncedStage = 0; // stages ordered after every read since the last write.
+
+		EQueueType queue = EQueueType::Graphics;
+		uint32_t lastBatch = 0;
+
+		// Exclusive resources only, IGNORED while the content is undefined and any queue may take it.
+		uint32_t ownerFamily = VK_QUEUE_FAMILY_IGNORED;
+		bool bReleased = false;
+		Barrier release = {};
+	};
+
+	bool covers(VkFlags have,VkFlags need)
+	{
+		return (need & ~have) == 0;
+	}
+
+	class Validator
+	{
+	public:
+		explicit Validator(const FrameGraph& graph) : m_graph(graph), m_states(graph.getResources().size()) { }
+
+		bool run(std::string& outError)
+		{
+			const auto& resources = m_graph.getResources();
+			const auto& passes = m_graph.getPasses();
+			const auto& order = m_graph.getExecutionOrder();
+			const auto& batches = m_graph.getSubmitBatches();
+
+			for(ResourceHandle i = 0; i < resources.size(); i++)
+			{
+				const auto& resource = resources[i];
+				auto& state = m_states[i];
+				if(resource.isTransient() && resource.firstUse != INVALID_PASS)
+				{
+					const auto& pass = passes[order[resource.firstUse]];
+					state.queue = pass.executeQueue;
+					state.lastBatch = pass.batch;
+				}
+				if(resource.bImported && resource.import.initialAccess != EResourceAccess::None)
+				{
+					const AccessInfo& info = getAccessInfo(resource.import.initialAccess);
+					state.layout = resource.isTexture() ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+					state.bDefined = true;
+					if(isExclusive(resource))
+					{
+						state.ownerFamily = m_graph.getQueueFamily(EQueueType::Graphics);
+					}
+					if(info.bWrite)
+					{
+						state.writeStage = info.stage;
+						state.writeAccess = info.access & writeMask();
+					}
+					else
+					{
+						state.readStage = info.stage;
+					}
+				}
+			}
+
+			checkCulling();
+			checkMemoryOverlap();
+			checkBatches();
+
+			for(const auto& barrier : m_graph.getPrologueBarriers())
+			{
+				applyRelease(barrier,EQueueType::Graphics,"Prologue");
+			}
+
+			for(uint32_t step = 0; step < order.size(); step++)
+			{
+				const auto& pass = passes[order[step]];
+				for(const auto& access : pass.merged)
+				{
+					changeQueue(access.resource,pass.executeQueue,pass.batch,pass.name);
+				}
+
+				checkStages(pass.externalDependency,pass.executeQueue,pass.name);
+				applyGlobalBarrier(pass.externalDependency);
+				for(const auto& barrier : pass.barriers)
+				{
+					applyBarrier(barrier,pass.executeQueue,pass.batch,pass.name);
+				}
+				for(const auto& access : pass.merged)
+				{
+					checkAccess(access,pass.executeQueue,pass.batch,pass.name);
+				}
+				for(const auto& barrier : pass.releaseBarriers)
+				{
+					applyRelease(barrier,pass.executeQueue,pass.name);
+				}
+			}
+
+			// Every import goes back to graphics for the epilogue and the next frame.
+			const uint32_t lastBatch = uint32_t(batches.size() - 1);
+			for(ResourceHandle i = 0; i < resources.size(); i++)
+			{
+				if(resources[i].bImported)
+				{
+					changeQueue(i,EQueueType::Graphics,lastBatch,"Epilogue");
+				}
+			}
+			for(const auto& barrier : m_graph.getEpilogueBarriers())
+			{
+				applyBarrier(barrier,EQueueType::Graphics,lastBatch,"Epilogue");
+			}
+			applyGlobalBarrier(m_graph.getExternalEpilogue());
+			for(ResourceHandle i = 0; i < resources.size(); i++)
+			{
+				const auto& resource = resources[i];
+				if(resource.bImported && !resource.isTracked() && resource.import.finalAccess != EResourceAccess::None)
+				{
+					const AccessInfo& info = getAccessInfo(resource.import.finalAccess);
+					checkAccess({ i, info.stage, info.access, VK_IMAGE_LAYOUT_UNDEFINED, info.bWrite },EQueueType::Graphics,lastBatch,"Epilogue");
+				}
+				if(resource.bImported && resource.isTracked() && resource.isTexture() && resource.import.finalAccess != EResourceAccess::None)
+				{
+					const VkImageLayout layout = getAccessInfo(resource.import.finalAccess).layout;
+					if(m_states[i].layout != layout)
+					{
+						error() << resource.name << " ends in layout " << m_states[i].layout << " but final layout is " << layout;
+					}
+				}
+				if(resource.bImported && isExclusive(resource) && m_states[i].ownerFamily != VK_QUEUE_FAMILY_IGNORED &&
+					(m_states[i].bReleased || m_states[i].ownerFamily != m_graph.getQueueFamily(EQueueType::Graphics)))
+				{
+					error() << resource.name << " isn't owned by the graphics family at the end of the frame";
+				}
+			}
+
+			outError = m_errors.str();
+			return m_errorCount == 0;
+		}
+
+	private:
+		const FrameGraph& m_graph;
+		std::vector<SimulatedState> m_states;
+		std::stringstream m_errors;
+		uint32_t m_errorCount = 0;
+
+		static VkAccessFlags writeMask()
+		{
+			return VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+				VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		}
+
+		bool isExclusive(const FrameGraph::Resource& resource) const
+		{
+			return m_graph.hasAsyncCompute() && resource.isTracked() && !(resource.bImported && resource.import.bConcurrent);
+		}
+
+		// First and last batch on graphics, passes inside their batch, waits only on earlier batches.
+		void checkBatches()
+		{
+			const auto& batches = m_graph.getSubmitBatches();
+			const auto& order = m_graph.getExecutionOrder();
+			if(batches.empty() || batches.front().queue != EQueueType::Graphics || batches.back().queue != EQueueType::Graphics)
+			{
+				error() << "first and last submit batch must be graphics";
+				return;
+			}
+
+			uint32_t nextOrder = 0;
+			for(uint32_t i = 0; i < batches.size(); i++)
+			{
+				const auto& batch = batches[i];
+				if(batch.firstOrder != nextOrder)
+				{
+					error() << "batch " << i << " doesn't continue the execution order";
+				}
+				nextOrder = batch.firstOrder + batch.orderCount;
+
+				for(uint32_t step = batch.firstOrder; step < nextOrder && step < order.size(); step++)
+				{
+					const auto& pass = m_graph.getPasses()[order[step]];
+					if(pass.batch != i || pass.executeQueue != batch.queue)
+					{
+						error() << pass.name << " isn't on the queue of its batch " << i;
+					}
+				}
+				for(size_t queue = 0; queue < batch.waitBatch.size(); queue++)
+				{
+					const uint32_t wait = batch.waitBatch[queue];
+					if(wait == INVALID_BATCH)
+					{
+						continue;
+					}
+					if(wait >= i || batches[wait].queue != EQueueType(queue) || batch.waitStages[queue] == 0)
+					{
+						error() << "batch " << i << " has an invalid wait on batch " << wait;
+					}
+					if((batch.waitStages[queue] & ~getQueueStageMask(batch.queue)) != 0)
+					{
+						error() << "batch " << i << " waits on stages its queue doesn't support";
+					}
+				}
+			}
+			if(nextOrder != order.size())
+			{
+				error() << "batches don't cover the execution order";
+			}
+		}
+
+		void checkStages(const Barrier& barrier,EQueueType queue,const std::string& passName)
+		{
+			if(((barrier.srcStage | barrier.dstStage) & ~getQueueStageMask(queue)) != 0)
+			{
+				error() << passName << ": barrier uses stages the " << getQueueName(queue) << " queue doesn't support";
+			}
+		}
+
+		// A semaphore wait on the batch that used the resource last: every earlier access is done and
+		// visible to the waiting stages. Modeled as a write at those stages, already visible to them.
+		void changeQueue(ResourceHandle handle,EQueueType queue,uint32_t batchIndex,const std::string& passName)
+		{
+			auto& state = m_states[handle];
+			if(state.queue == queue)
+			{
+				return;
+			}
+
+			const auto& batch = m_graph.getSubmitBatches()[batchIndex];
+			const uint32_t wait = batch.waitBatch[size_t(state.queue)];
+			if(wait == INVALID_BATCH || wait < state.lastBatch)
+			{
+				error() << passName << ": " << m_graph.getResource(handle).name << " moves from " << getQueueName(state.queue) << " to "
+					<< getQueueName(queue) << " without waiting on batch " << state.lastBatch;
+			}
+
+			VkPipelineStageFlags waitStages = batch.waitStages[size_t(state.queue)];
+			if(waitStages & VK_PIPELINE_STAGE_ALL_COMMANDS_BIT)
+			{
+				waitStages = ~VkPipelineStageFlags(0);
+			}
+			state.writeStage = waitStages;
+			state.writeAccess = 0;
+			state.bWriteAvailable = true;
+			state.visibleStage = waitStages;
+			state.visibleAccess = ~0u;
+			state.readStage = 0;
+			state.readSyncedStage = waitStages;
+			state.queue = queue;
+		}
+
+		// First half of an ownership transfer, has to wait on every access of the old owner.
+		void applyRelease(const Barrier& barrier,EQueueType queue,const std::string& passName)
+		{
+			const auto& resource = m_graph.getResource(barrier.resource);
+			auto& state = m_states[barrier.resource];
+			checkStages(barrier,queue,passName);
+
+			if(barrier.srcQueueFamily != m_graph.getQueueFamily(queue) || state.ownerFamily != barrier.srcQueueFamily || state.bReleased)
+			{
+				error() << passName << ": " << resource.name << " released by a queue that doesn't own it";
+			}
+			if(resource.isTexture() && barrier.oldLayout != state.layout)
+			{
+				error() << passName << ": " << resource.name << " release old layout " << barrier.oldLayout << " but image is in " << state.layout;
+			}
+
+			bool bWriteCovered = false;
+			bool bReadCovered = false;
+			resolveDependency(state,barrier,bWriteCovered,bReadCovered);
+			if(!bWriteCovered || !bReadCovered)
+			{
+				error() << passName << ": release of " << resource.name << " races with earlier accesses";
+			}
+
+			state.bReleased = true;
+			state.release = barrier;
+		}
+
+		std::stringstream& error()
+		{
+			if(m_errorCount > 0) m_errors << "\n";
+			m_errorCount++;
+			return m_errors;
+		}
+
+		// A live pass must never depend on a culled writer.
+		void checkCulling()
+		{
+			const auto& passes = m_graph.getPasses();
+			for(uint32_t i = 0; i < passes.size(); i++)
+			{
+				if(!passes[i].bCulled) continue;
+				for(const auto& write : passes[i].merged)
+				{
+					if(!write.bWrite) continue;
+					for(uint32_t j = i + 1; j < passes.size(); j++)
+					{
+						if(passes[j].bCulled) continue;
+						for(const auto& access : passes[j].merged)
+						{
+							if(access.resource == write.resource)
+							{
+								error() << "culled pass " << passes[i].name << " writes " << m_graph.getResource(write.resource).name << " used by live pass " << passes[j].name;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		void checkMemoryOverlap()
+		{
+			const auto& resources = m_graph.getResources();
+			for(ResourceHandle a = 0; a < resources.size(); a++)
+			{
+				const auto& ra = resources[a];
+				if(!ra.isTransient() || ra.heap == ~0u) continue;
+
+				const auto& heap = m_graph.getHeaps()[ra.heap];
+				if(ra.offset + ra.memory.size > heap.size || ra.offset % ra.memory.alignment != 0)
+				{
+					error() << ra.name << " placed outside its heap or misaligned";
+				}
+
+				for(ResourceHandle b = a + 1; b < resources.size(); b++)
+				{
+					const auto& rb = resources[b];
+					if(!rb.isTransient() || rb.heap != ra.heap) continue;
+
+					const bool bLifeOverlap = !(ra.lastUse < rb.firstUse || rb.lastUse < ra.firstUse);
+					const bool bMemoryOverlap = ra.offset < rb.offset + rb.memory.size && rb.offset < ra.offset + ra.memory.size;
+					if(bLifeOverlap && bMemoryOverlap)
+					{
+						error() << ra.name << " and " << rb.name << " alias while both alive";
+					}
+				}
+			}
+		}
+
+		void applyBarrier(const Barrier& barrier,EQueueType queue,uint32_t batchIndex,const std::string& passName)
+		{
+			const auto& resource = m_graph.getResource(barrier.resource);
+			auto& state = m_states[barrier.resource];
+			checkStages(barrier,queue,passName);
+
+			if(barrier.srcQueueFamily != barrier.dstQueueFamily)
+			{
+				applyAcquire(barrier,queue,passName);
+				return;
+			}
+
+			if(barrier.bAliasing)
+			{
+				// Every earlier owner of the range must be finished before the new owner starts.
+				const auto& batch = m_graph.getSubmitBatches()[batchIndex];
+				for(auto predecessor : resource.aliasPredecessors)
+				{
+					const auto& p = m_states[predecessor];
+					if(p.queue != queue)
+					{
+						const uint32_t wait = batch.waitBatch[size_t(p.queue)];
+						if(wait == INVALID_BATCH || wait < p.lastBatch || (barrier.srcStage & batch.waitStages[size_t(p.queue)]) == 0)
+						{
+							error() << passName << ": aliasing barrier for " << resource.name << " doesn't wait on " << m_graph.getResource(predecessor).name << " from another queue";
+						}
+						continue;
+					}
+					if(!covers(barrier.srcStage,p.writeStage | p.readStage))
+					{
+						error() << passName << ": aliasing barrier for " << resource.name << " doesn't wait on " << m_graph.getResource(predecessor).name;
+					}
+				}
+			}
+			else if(resource.isTransient() && !resource.aliasPredecessors.empty() && !state.bDefined && state.writeStage == 0 && state.readStage == 0)
+			{
+				error() << passName << ": first barrier of aliased " << resource.name << " isn't an aliasing barrier";
+			}
+
+			const bool bLayoutChange = resource.isTexture() && barrier.oldLayout != barrier.newLayout;
+			if(resource.isTexture() && barrier.oldLayout != state.layout && barrier.oldLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+			{
+				error() << passName << ": " << resource.name << " barrier old layout " << barrier.oldLayout << " but image is in " << state.layout;
+			}
+			if(resource.isTexture() && barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && state.bDefined && bLayoutChange)
+			{
+				error() << passName << ": " << resource.name << " discards defined content with an UNDEFINED transition";
+			}
+
+			bool bWriteCovered = false;
+			bool bReadCovered = false;
+			resolveDependency(state,barrier,bWriteCovered,bReadCovered);
+
+			if(bLayoutChange)
+			{
+				// The transition is a write, it has to wait on everything before it.
+				if(!bWriteCovered || !bReadCovered)
+				{
+					error() << passName << ": layout transition of " << resource.name << " races with earlier accesses";
+				}
+				state.layout = barrier.newLayout;
+				state.writeStage = barrier.dstStage;
+				state.writeAccess = 0;
+				state.bWriteAvailable = true;
+				state.visibleStage = barrier.dstStage;
+				state.visibleAccess = barrier.dstAccess;
+				state.readStage = 0;
+				state.readSyncedStage = barrier.dstStage;
+				return;
+			}
+
+			applyDependency(state,barrier,bWriteCovered,bReadCovered);
+		}
+
+		// Second half of an ownership transfer, matches the release and chains onto the semaphore wait.
+		void applyAcquire(const Barrier& barrier,EQueueType queue,const std::string& passName)
+		{
+			const auto& resource = m_graph.getResource(barrier.resource);
+			auto& state = m_states[barrier.resource];
+
+			const Barrier& release = state.release;
+			if(!state.bReleased || release.srcQueueFamily != barrier.srcQueueFamily || release.dstQueueFamily != barrier.dstQueueFamily ||
+				release.oldLayout != barrier.oldLayout || release.newLayout != barrier.newLayout)
+			{
+				error() << passName << ": acquire of " << resource.name << " doesn't match a release";
+			}
+			if(barrier.dstQueueFamily != m_graph.getQueueFamily(queue))
+			{
+				error() << passName << ": " << resource.name << " acquired on the wrong queue family";
+			}
+
+			bool bWriteCovered = false;
+			bool bReadCovered = false;
+			resolveDependency(state,barrier,bWriteCovered,bReadCovered);
+			if(!bWriteCovered || !bReadCovered)
+			{
+				error() << passName << ": acquire of " << resource.name << " doesn't chain onto the semaphore wait";
+			}
+
+			state.bReleased = false;
+			state.ownerFamily = barrier.dstQueueFamily;
+			state.layout = barrier.newLayout;
+			state.writeStage = barrier.dstStage;
+			state.writeAccess = 0;
+			state.bWriteAvailable = true;
+			state.visibleStage = barrier.dstStage;
+			state.visibleAccess = barrier.dstAccess;
+			state.readStage = 0;
+			state.readSyncedStage = barrier.dstStage;
+		}
+
+		static void resolveDependency(SimulatedState& state,const Barrier& barrier,bool& bWriteCovered,bool& bReadCovered)
+		{
+			const bool bWriteChained = covers(barrier.srcStage,state.writeStage) || (barrier.srcStage & state.visibleStage) != 0;
+			if(bWriteChained && covers(barrier.srcAccess,state.writeAccess))
+			{
+				state.bWriteAvailable = true;
+			}
+			bWriteCovered = bWriteChained && state.bWriteAvailable;
+			bReadCovered = covers(barrier.srcStage,state.readStage);
+		}
+
+		static void applyDependency(SimulatedState& state,const Barrier& barrier,bool bWriteCovered,bool bReadCovered)
+		{
+			if(bWriteCovered)
+			{
+				state.visibleStage |= barrier.dstStage;
+				state.visibleAccess |= barrier.dstAccess;
+			}
+			if(bReadCovered)
+			{
+				state.readSyncedStage |= barrier.dstStage;
+			}
+		}
+
+		// A memory barrier covers every external resource, layouts stay with the owning pass.
+		void applyGlobalBarrier(const Barrier& barrier)
+		{
+			if(barrier.srcStage == 0)
+			{
+				return;
+			}
+
+			const auto& resources = m_graph.getResources();
+			for(ResourceHandle i = 0; i < resources.size(); i++)
+			{
+				if(resources[i].isTracked())
+				{
+					continue;
+				}
+
+				bool bWriteCovered = false;
+				bool bReadCovered = false;
+				resolveDependency(m_states[i],barrier,bWriteCovered,bReadCovered);
+				applyDependency(m_states[i],barrier,bWriteCovered,bReadCovered);
+			}
+		}
+
+		void checkAccess(const FrameGraph::MergedAccess& access,EQueueType queue,uint32_t batchIndex,const std::string& passName)
+		{
+			const auto& resource = m_graph.getResource(access.resource);
+			auto& state = m_states[access.resource];
+
+			if(state.queue != queue)
+			{
+				error() << passName << ": " << resource.name << " accessed on " << getQueueName(queue) << " while it is on " << getQueueName(state.queue);
+			}
+			if(isExclusive(resource))
+			{
+				const uint32_t family = m_graph.getQueueFamily(queue);
+				if(state.bReleased || (state.ownerFamily != VK_QUEUE_FAMILY_IGNORED && state.ownerFamily != family))
+				{
+					error() << passName << ": " << resource.name << " accessed by a queue family that doesn't own it";
+				}
+				state.ownerFamily = family;
+			}
+			state.lastBatch = batchIndex;
+
+			// NOTE: External resources are only checked for hazards against the graph's memory barriers.
+			if(resource.isTracked() && resource.isTexture() && state.layout != access.layout)
+			{
+				error() << passName << ": " << resource.name << " accessed in layout " << access.layout << " but image is in " << state.layout;
+			}
+
+			if(state.writeStage != 0 && !(covers(state.visibleStage,access.stage) && covers(state.visibleAccess,access.access)))
+			{
+				error() << passName << ": " << resource.name << " accessed before the last write is visible";
+			}
+
+			if(access.bWrite)
+			{
+				if(state.readStage != 0 && !covers(state.readSyncedStage,access.stage))
+				{
+					error() << passName << ": " << resource.name << " written while earlier reads may still run";
+				}
+
+				state.writeStage = access.stage;
+				state.writeAccess = access.access & writeMask();
+				state.bWriteAvailable = state.writeAccess == 0;
+				state.visibleStage = 0;
+				state.visibleAccess = 0;
+				state.readStage = 0;
+				state.readSyncedStage = 0;
+			}
+			else
+			{
+				state.readStage |= access.stage;
+			}
+			state.bDefined = true;
+		}
+	};
+
+	MemoryRequirement fakeMemory(const FrameGraph& graph,ResourceHandle handle)
+	{
+		const auto& resource = graph.getResource(handle);
+		if(resource.isTexture())
+		{
+			const VkDeviceSize texel = (resource.texture.format == VK_FORMAT_R16G16B16A16_SFLOAT) ? 8 : 4;
+			return { resource.texture.width * resource.texture.height * resource.texture.arrayLayers * texel, 256, 0x1 };
+		}
+		return { resource.buffer.size, 64, 0x3 };
+	}
+
+	TextureDesc makeTexture(uint32_t width,uint32_t height,VkFormat format)
+	{
+		TextureDesc desc { };
+		desc.width = width;
+		desc.height = height;
+		desc.format = format;
+		return desc;
+	}
+
+	struct TestContext
+	{
+		uint32_t failCount = 0;
+
+		void expect(bool bCondition,const char* what)
+		{
+			if(!bCondition)
+			{
+				LOG_ERROR("Frame graph self test failed: {0}.",what);
+				failCount++;
+			}
+		}
+
+		void validate(const FrameGraph& graph,const char* what)
+		{
+			std::string error;
+			if(!validateFrameGraph(graph,error))
+			{
+				LOG_ERROR("Frame graph self test {0} schedule invalid:\n{1}\n{2}",what,error,graph.dump());
+				failCount++;
+			}
+		}
+	};
+
+	void testCulling(TestContext& ctx)
+	{
+		FrameGraph graph;
+		ImportDesc outputImport { };
+		outputImport.finalAccess = EResourceAccess::GraphicsShaderRead;
+		auto output = graph.importTexture("Output",VK_NULL_HANDLE,VK_NULL_HANDLE,makeTexture(64,64,VK_FORMAT_R8G8B8A8_UNORM),outputImport);
+
+		ResourceHandle a = INVALID_RESOURCE, unused = INVALID_RESOURCE;
+		graph.addPass("WriteA",[&](PassBuilder& builder)
+		{
+			a = builder.createTexture("A",makeTexture(64,64,VK_FORMAT_R8G8B8A8_UNORM));
+			builder.write(a,EResourceAccess::ColorAttachmentWrite);
+		},nullptr);
+		graph.addPass("Unused",[&](PassBuilder& builder)
+		{
+			unused = builder.createTexture("Unused",makeTexture(64,64,VK_FORMAT_R8G8B8A8_UNORM));
+			builder.read(a,EResourceAccess::ComputeShaderRead);
+			builder.write(unused,EResourceAccess::ComputeShaderWrite);
+		},nullptr);
+		const uint32_t readback = graph.addPass("Readback",[&](PassBuilder& builder)
+		{
+			builder.read(a,EResourceAccess::TransferRead);
+			builder.sideEffect();
+		},nullptr);
+		graph.addPass("Final",[&](PassBuilder& builder)
+		{
+			builder.read(a,EResourceAccess::GraphicsShaderRead);
+			builder.write(output,EResourceAccess::ColorAttachmentWrite);
+		},nullptr);
+
+		graph.compile(fakeMemory);
+		ctx.expect(graph.isPassCulled(1),"unused pass culled");
+		ctx.expect(!graph.isPassCulled(0) && !graph.isPassCulled(readback) && !graph.isPassCulled(3),"needed passes kept");
+		ctx.expect(graph.getResource(unused).heap == ~0u,"culled transient gets no memory");
+		ctx.expect(graph.getEpilogueBarriers().size() == 1,"output transitioned to final state");
+		ctx.validate(graph,"culling");
+	}
+
+	void testBarriers(TestContext& ctx)
+	{
+		FrameGraph graph;
+		ResourceHandle image = INVALID_RESOURCE, buffer = INVALID_RESOURCE;
+
+		graph.addPass("ComputeWrite",[&](PassBuilder& builder)
+		{
+			image = builder.createTexture("Image",makeTexture(128,128,VK_FORMAT_R16G16B16A16_SFLOAT));
+			buffer = builder.createBuffer("Args",{ 256, 0 });
+			builder.write(image,EResourceAccess::ComputeShaderWrite);
+			builder.write(buffer,EResourceAccess::ComputeShaderWrite);
+		},nullptr);
+		graph.addPass("Draw",[&](PassBuilder& builder)
+		{
+			builder.read(image,EResourceAccess::GraphicsShaderRead);
+			builder.read(buffer,EResourceAccess::IndirectArgument);
+			builder.sideEffect();
+		},nullptr);
+		graph.addPass("DrawAgain",[&](PassBuilder& builder)
+		{
+			builder.read(image,EResourceAccess::GraphicsShaderRead);
+			builder.read(buffer,EResourceAccess::IndirectArgument);
+			builder.sideEffect();
+		},nullptr);
+		graph.addPass("ComputeRewrite",[&](PassBuilder& builder)
+		{
+			builder.write(buffer,EResourceAccess::ComputeShaderWrite);
+			builder.sideEffect();
+		},nullptr);
+
+		graph.compile(fakeMemory);
+
+		const auto& passes = graph.getPasses();
+		ctx.expect(passes[0].barriers.size() == 1,"first write only transitions the image");
+		ctx.expect(passes[1].barriers.size() == 2,"RAW barriers before draw");
+		ctx.expect(passes[2].barriers.empty(),"no barrier for repeated reads");
+		ctx.expect(passes[3].barriers.size() == 1 && passes[3].barriers[0].srcAccess == 0,"WAR is an execution only barrier");
+
+		for(const auto& barrier : passes[1].barriers)
+		{
+			if(barrier.resource == image)
+			{
+				ctx.expect(barrier.oldLayout == VK_IMAGE_LAYOUT_GENERAL && barrier.newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,"storage to sampled transition");
+				ctx.expect(barrier.srcAccess == VK_ACCESS_SHADER_WRITE_BIT,"write made available");
+			}
+		}
+		ctx.validate(graph,"barriers");
+	}
+
+	void testAliasing(TestContext& ctx)
+	{
+		FrameGraph graph;
+		ImportDesc outputImport { };
+		auto output = graph.importTexture("Output",VK_NULL_HANDLE,VK_NULL_HANDLE,makeTexture(256,256,VK_FORMAT_R8G8B8A8_UNORM),outputImport);
+
+		ResourceHandle a = INVALID_RESOURCE, b = INVALID_RESOURCE, c = INVALID_RESOURCE;
+		graph.addPass("A",[&](PassBuilder& builder)
+		{
+			a = builder.createTexture("TempA",makeTexture(256,256,VK_FORMAT_R8G8B8A8_UNORM));
+			builder.write(a,EResourceAccess::ColorAttachmentWrite);
+		},nullptr);
+		graph.addPass("B",[&](PassBuilder& builder)
+		{
+			b = builder.createTexture("TempB",makeTexture(256,256,VK_FORMAT_R8G8B8A8_UNORM));
+			builder.read(a,EResourceAccess::ComputeShaderRead);
+			builder.write(b,EResourceAccess::ComputeShaderWrite);
+		},nullptr);
+		graph.addPass("C",[&](PassBuilder& builder)
+		{
+			c = builder.createTexture("TempC",makeTexture(256,256,VK_FORMAT_R8G8B8A8_UNORM));
+			builder.read(b,EResourceAccess::ComputeShaderRead);
+			builder.write(c,EResourceAccess::ComputeShaderWrite);
+		},nullptr);
+		graph.addPass("Resolve",[&](PassBuilder& builder)
+		{
+			builder.read(c,EResourceAccess::GraphicsShaderRead);
+			builder.write(output,EResourceAccess::ColorAttachmentWrite);
+		},nullptr);
+
+		graph.compile(fakeMemory);
+
+		const auto& stats = graph.getStats();
+		ctx.expect(stats.unaliasedBytes == 3 * 256 * 256 * 4,"unaliased size");
+		ctx.expect(stats.aliasedBytes == 2 * 256 * 256 * 4,"A and C share memory");
+		ctx.expect(graph.getResource(c).aliasPredecessors.size() == 1 && graph.getResource(c).aliasPredecessors[0] == a,"C waits on A");
+		ctx.expect(stats.aliasingBarrierCount == 1,"one aliasing barrier");
+		ctx.validate(graph,"aliasing");
+	}
+
+	void testExternal(TestContext& ctx)
+	{
+		FrameGraph graph;
+		ImportDesc external { };
+		external.bExternalBarrier = true;
+		auto depth = graph.importTexture("Depth",VK_NULL_HANDLE,VK_NULL_HANDLE,makeTexture(64,64,VK_FORMAT_D32_SFLOAT),external);
+		auto color = graph.importTexture("Color",VK_NULL_HANDLE,VK_NULL_HANDLE,makeTexture(64,64,VK_FORMAT_R8G8B8A8_UNORM),external);
+
+		const uint32_t gbuffer = graph.addPass("GBuffer",[&](PassBuilder& builder)
+		{
+			builder.write(depth,EResourceAccess::DepthStencilWrite);
+		},nullptr);
+		const uint32_t lighting = graph.addPass("Lighting",[&](PassBuilder& builder)
+		{
+			builder.read(depth,EResourceAccess::GraphicsShaderRead);
+			builder.write(color,EResourceAccess::ColorAttachmentWrite);
+		},nullptr);
+
+		graph.compile(nullptr);
+		ctx.expect(graph.getStats().barrierCount == 0,"external resources get no barriers");
+		ctx.expect((graph.getPassStages(gbuffer) & VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT) != 0,"pass stages from accesses");
+		ctx.expect((graph.getPassStages(lighting) & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) != 0,"pass stages from accesses");
+		ctx.expect((graph.getPassWaitStages(lighting) & VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT) != 0,"wait stages cover the previous external access");
+
+		const Barrier& dependency = graph.getPasses()[lighting].externalDependency;
+		ctx.expect((dependency.srcStage & VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT) != 0,"dependency waits on the depth write");
+		ctx.expect((dependency.srcAccess & VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT) != 0,"dependency makes the depth write available");
+		ctx.expect((dependency.dstStage & VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT) != 0,"dependency chains pass barriers");
+		ctx.validate(graph,"external");
+	}
+
+	void testAsyncCompute(TestContext& ctx)
+	{
+		FrameGraph graph;
+		graph.setQueueFamilies(0,1);
+
+		ImportDesc objectsImport { };
+		objectsImport.initialAccess = EResourceAccess::ComputeShaderRead;
+		objectsImport.bExternalBarrier = true;
+		objectsImport.bConcurrent = true;
+		auto objects = graph.importBuffer("Objects",VK_NULL_HANDLE,4096,objectsImport);
+
+		ImportDesc depthImport { };
+		depthImport.bRetained = false;
+		auto depth = graph.importTexture("Depth",VK_NULL_HANDLE,VK_NULL_HANDLE,makeTexture(64,64,VK_FORMAT_D32_SFLOAT),depthImport);
+
+		ImportDesc outputImport { };
+		outputImport.finalAccess = EResourceAccess::GraphicsShaderRead;
+		auto output = graph.importTexture("Output",VK_NULL_HANDLE,VK_NULL_HANDLE,makeTexture(64,64,VK_FORMAT_R8G8B8A8_UNORM),outputImport);
+
+		ResourceHandle args = INVALID_RESOURCE, color = INVALID_RESOURCE;
+		const uint32_t culling = graph.addPass("Culling",[&](PassBuilder& builder)
+		{
+			args = builder.createBuffer("DrawArgs",{ 256, 0 });
+			builder.read(objects,EResourceAccess::ComputeShaderRead);
+			builder.write(args,EResourceAccess::ComputeShaderWrite);
+			builder.setQueue(EQueueType::AsyncCompute);
+		},nullptr);
+		const uint32_t draw = graph.addPass("Draw",[&](PassBuilder& builder)
+		{
+			color = builder.createTexture("Color",makeTexture(64,64,VK_FORMAT_R8G8B8A8_UNORM));
+			builder.read(args,EResourceAccess::IndirectArgument);
+			builder.read(objects,EResourceAccess::VertexShaderRead);
+			builder.write(color,EResourceAccess::ColorAttachmentWrite);
+			builder.write(depth,EResourceAccess::DepthStencilWrite);
+		},nullptr);
+		const uint32_t blur = graph.addPass("Blur",[&](PassBuilder& builder)
+		{
+			builder.read(color,EResourceAccess::ComputeShaderRead);
+			builder.read(depth,EResourceAccess::ComputeShaderRead);
+			builder.write(output,EResourceAccess::ComputeShaderWrite);
+			builder.setQueue(EQueueType::AsyncCompute);
+		},nullptr);
+
+		graph.compile(fakeMemory);
+
+		const auto& batches = graph.getSubmitBatches();
+		ctx.expect(batches.size() == 5,"prologue, culling, draw, blur and epilogue batches");
+		ctx.expect(graph.getPassQueue(culling) == EQueueType::AsyncCompute && graph.getPassQueue(draw) == EQueueType::Graphics &&
+			graph.getPassQueue(blur) == EQueueType::AsyncCompute,"passes on their requested queues");
+		if(batches.size() == 5)
+		{
+			ctx.expect(batches[1].waitBatch[size_t(EQueueType::Graphics)] == 0,"culling waits on the prologue");
+			ctx.expect(batches[2].waitBatch[size_t(EQueueType::AsyncCompute)] == 1,"draw waits on culling");
+			ctx.expect(batches[3].waitBatch[size_t(EQueueType::Graphics)] == 2,"blur waits on draw");
+			ctx.expect(batches[4].waitBatch[size_t(EQueueType::AsyncCompute)] == 3,"epilogue waits on blur");
+		}
+
+		// Args and Color move once, the imported Depth goes out and comes back, Output comes back to
+		// graphics. Objects is concurrent.
+		ctx.expect(graph.getStats().ownershipTransferCount == 5,"ownership transfers");
+		ctx.expect(graph.getPasses()[culling].releaseBarriers.size() == 1 && graph.getPasses()[draw].releaseBarriers.size() == 2,"releases after the last pass on the old queue");
+		ctx.validate(graph,"async compute");
+
+		// Same family: one batch, nothing to transfer.
+		graph.setQueueFamilies(0,0);
+		graph.compile(fakeMemory);
+		ctx.expect(graph.getSubmitBatches().size() == 1,"single batch without async compute");
+		ctx.expect(graph.getStats().ownershipTransferCount == 0 && graph.getPrologueBarriers().empty(),"no ownership transfers without async compute");
+		ctx.validate(graph,"async compute fallback");
+	}
+
+	// NOTE: Random graphs, the compiled schedule must always pass the independent validator.
+	void testRandom(TestContext& ctx,uint32_t iterations)
+	{
+		std::mt19937 rng(1234);
+		const EResourceAccess textureAccesses[] =
+		{
+			EResourceAccess::GraphicsShaderRead, EResourceAccess::ComputeShaderRead, EResourceAccess::ComputeShaderWrite,
+			EResourceAccess::ComputeShaderReadWrite, EResourceAccess::ColorAttachmentWrite, EResourceAccess::TransferRead,
+			EResourceAccess::TransferWrite,
+		};
+		const EResourceAccess bufferAccesses[] =
+		{
+			EResourceAccess::IndirectArgument, EResourceAccess::VertexShaderRead, EResourceAccess::ComputeShaderRead,
+			EResourceAccess::ComputeShaderWrite, EResourceAccess::TransferWrite,
+		};
+
+		// Accesses an async compute pass may use.
+		const EResourceAccess computeTextureAccesses[] =
+		{
+			EResourceAccess::ComputeShaderRead, EResourceAccess::ComputeShaderWrite, EResourceAccess::ComputeShaderReadWrite,
+			EResourceAccess::TransferRead, EResourceAccess::TransferWrite,
+		};
+		const EResourceAccess computeBufferAccesses[] =
+		{
+			EResourceAccess::IndirectArgument, EResourceAccess::ComputeShaderRead, EResourceAccess::ComputeShaderWrite,
+			EResourceAccess::TransferWrite,
+		};
+
+		for(uint32_t iteration = 0; iteration < iterations; iteration++)
+		{
+			FrameGraph graph;
+			std::vector<ResourceHandle> resources;
+
+			const bool bAsync = (iteration % 2) == 1;
+			graph.setQueueFamilies(0,bAsync ? 1 : 0);
+
+			const uint32_t importCount = 1 + rng() % 3;
+			for(uint32_t i = 0; i < importCount; i++)
+			{
+				ImportDesc import { };
+				import.initialAccess = (rng() % 2) ? EResourceAccess::GraphicsShaderRead : EResourceAccess::None;
+				import.finalAccess = (rng() % 2) ? EResourceAccess::GraphicsShaderRead : EResourceAccess::None;
+				import.bRetained = (rng() % 4) != 0;
+				import.bExternalBarrier = (rng() % 3) == 0;
+				import.bConcurrent = import.bExternalBarrier || (rng() % 2) == 0;
+				resources.push_back(graph.importTexture("Import" + std::to_string(i),VK_NULL_HANDLE,VK_NULL_HANDLE,makeTexture(32,32,VK_FORMAT_R8G8B8A8_UNORM),import));
+			}
+			const uint32_t transientCount = 2 + rng() % 8;
+			for(uint32_t i = 0; i < transientCount; i++)
+			{
+				if(rng() % 3 == 0)
+				{
+					resources.push_back(graph.createBuffer("Buffer" + std::to_string(i),{ 64ull * (1 + rng() % 16), 0 }));
+				}
+				else
+				{
+					resources.push_back(graph.createTexture("Texture" + std::to_string(i),makeTexture(16 << (rng() % 3),16,VK_FORMAT_R8G8B8A8_UNORM)));
+				}
+			}
+
+			const uint32_t passCount = 2 + rng() % 10;
+			for(uint32_t p = 0; p < passCount; p++)
+			{
+				graph.addPass("Pass" + std::to_string(p),[&](PassBuilder& builder)
+				{
+					const bool bCompute = (rng() % 2) == 0;
+					if(bCompute)
+					{
+						builder.setQueue(EQueueType::AsyncCompute);
+					}
+
+					const uint32_t accessCount = 1 + rng() % 4;
+					for(uint32_t a = 0; a < accessCount; a++)
+					{
+						const ResourceHandle resource = resources[rng() % resources.size()];
+						EResourceAccess access;
+						if(graph.getResource(resource).isTexture())
+						{
+							access = bCompute
+								? computeTextureAccesses[rng() % (sizeof(computeTextureAccesses) / sizeof(computeTextureAccesses[0]))]
+								: textureAccesses[rng() % (sizeof(textureAccesses) / sizeof(textureAccesses[0]))];
+						}
+						else
+						{
+							access = bCompute
+								? computeBufferAccesses[rng() % (sizeof(computeBufferAccesses) / sizeof(computeBufferAccesses[0]))]
+								: bufferAccesses[rng() % (sizeof(bufferAccesses) / sizeof(bufferAccesses[0]))];
+						}
+
+						if(getAccessInfo(access).bWrite) builder.write(resource,access);
+						else builder.read(resource,access);
+					}
+					if(rng() % 6 == 0) builder.sideEffect();
+				},nullptr);
+			}
+
+			graph.compile(fakeMemory);
+
+			std::string error;
+			if(!validateFrameGraph(graph,error))
+			{
+				LOG_ERROR("Frame graph random test {0} invalid:\n{1}\n{2}",iteration,error,graph.dump());
+				ctx.failCount++;
+				return;
+			}
+		}
+	}
+}
+
+bool validateFrameGraph(const FrameGraph& graph,std::string& outError)
+{
+	if(!graph.isCompiled())
+	{
+		outError = "graph not compiled";
+		return false;
+	}
+
+	Validator validator(graph);
+	return validator.run(outError);
+}
+
+bool runFrameGraphSelfTest()
+{
+	TestContext ctx { };
+
+	testCulling(ctx);
+	testBarriers(ctx);
+	testAliasing(ctx);
+	testExternal(ctx);
+	testAsyncCompute(ctx);
+	testRandom(ctx,2000);
+
+	if(ctx.failCount == 0)
+	{
+		LOG_INFO("Frame graph self test passed.");
+	}
+	return ctx.failCount == 0;
+}
+
+} }
@@ -0,0 +1,463 @@
+#include "geometry_heap.h"
+
+namespace engine{
+
+static AutoCVarInt32 cVarCompactMoves(
+	"r.GeometryHeap.CompactMoves",
+	"Ranges compaction may move per heap and tick, 0 disables compaction.",
+	"GeometryHeap",
+	4,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarFloat cVarCompactThreshold(
+	"r.GeometryHeap.CompactThreshold",
+	"Fragmentation (1 - largest free block / free space) above which compaction runs.",
+	"GeometryHeap",
+	0.25f,
+	CVarFlags::ReadAndWrite
+);
+
+// Candidates compaction looks at per tick, bounds the walk when nothing fits lower.
+static constexpr uint32 GEOMETRY_HEAP_COMPACT_CANDIDATES = 64;
+
+void GeometryHeap::init(const std::string& name,uint32 stride,VkBufferUsageFlags usage,VkDeviceSize baseSize,VkDeviceSize incrementSize)
+{
+	CHECK(stride > 0 && m_buffer == nullptr);
+
+	m_name = name;
+	m_stride = stride;
+	m_usage = usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	m_incrementSize = glm::max(incrementSize,VkDeviceSize(stride));
+
+	m_allocator.init((uint32)glm::max(baseSize / stride,VkDeviceSize(1)));
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = VulkanRHI::get()->getVulkanDevice()->graphicsFamily;
+	vkCheck(vkCreateCommandPool(VulkanRHI::get()->getDevice(),&poolInfo,nullptr,&m_commandPool));
+
+	resizeBuffer();
+}
+
+void GeometryHeap::release()
+{
+	submit();
+	pollSubmissions(true);
+	releaseRetired(true);
+
+	if(m_buffer)
+	{
+		delete m_buffer;
+		m_buffer = nullptr;
+	}
+
+	if(m_commandPool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(VulkanRHI::get()->getDevice(),m_commandPool,nullptr);
+		m_commandPool = VK_NULL_HANDLE;
+	}
+
+	m_allocator.reset();
+	m_blocks.clear();
+	m_freeHandles.clear();
+	m_nodeHandles.clear();
+	m_stagingData = {};
+	m_pendingUploads.clear();
+}
+
+GeometryHeap::Handle GeometryHeap::allocate(uint32 count)
+{
+	CHECK(count > 0);
+
+	TlsfAllocator::Allocation allocation {};
+	if(!m_allocator.allocate(count,allocation))
+	{
+		// NOTE: Whole increments plus a spare one. The request is padded for the bin rounding of the
+		//       allocator, so the new tail block is always found.
+		const VkDeviceSize requiredBytes = (VkDeviceSize(m_allocator.getSize()) + count + count / 8 + 1) * m_stride;
+		const VkDeviceSize newBytes = (requiredBytes / m_incrementSize + 2) * m_incrementSize;
+
+		m_allocator.grow((uint32)glm::min(newBytes / m_stride,VkDeviceSize(~0u)));
+		CHECK(m_allocator.allocate(count,allocation));
+	}
+
+	Handle handle;
+	if(!m_freeHandles.empty())
+	{
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+	}
+	else
+	{
+		handle = (Handle)m_blocks.size();
+		m_blocks.push_back({});
+	}
+
+	m_blocks[handle].allocation = allocation;
+	m_blocks[handle].bLive = true;
+	m_blocks[handle].bPendingUpload = false;
+	m_nodeHandles[allocation.node] = handle;
+	return handle;
+}
+
+void GeometryHeap::free(Handle handle)
+{
+	CHECK(handle < m_blocks.size() && m_blocks[handle].bLive);
+	Block& block = m_blocks[handle];
+
+	if(block.bPendingUpload)
+	{
+		m_pendingUploads.erase(std::remove_if(m_pendingUploads.begin(),m_pendingUploads.end(),[handle](const PendingUpload& upload)
+		{
+			return upload.handle == handle;
+		}),m_pendingUploads.end());
+	}
+
+	// NOTE: Frames already submitted may still draw from the range.
+	Retired retired { };
+	retired.frameIndex = m_frameIndex;
+	retired.serial = m_submitSerial;
+	retired.allocation = block.allocation;
+	m_retired.push_back(retired);
+
+	m_nodeHandles.erase(block.allocation.node);
+	block = {};
+	m_freeHandles.push_back(handle);
+}
+
+void GeometryHeap::upload(Handle handle,const void* data)
+{
+	CHECK(handle < m_blocks.size() && m_blocks[handle].bLive);
+	Block& block = m_blocks[handle];
+
+	const size_t bytes = size_t(block.allocation.size) * m_stride;
+	const size_t offset = m_stagingData.size();
+	m_stagingData.resize(offset + bytes);
+	memcpy(m_stagingData.data() + offset,data,bytes);
+
+	m_pendingUploads.push_back({ handle, offset });
+	block.bPendingUpload = true;
+}
+
+uint32 GeometryHeap::getOffset(Handle handle) const
+{
+	CHECK(handle < m_blocks.size() && m_blocks[handle].bLive);
+	return m_blocks[handle].allocation.offset;
+}
+
+uint32 GeometryHeap::getCount(Handle handle) const
+{
+	CHECK(handle < m_blocks.size() && m_blocks[handle].bLive);
+	return m_blocks[handle].allocation.size;
+}
+
+bool GeometryHeap::isResident(Handle handle) const
+{
+	return handle < m_blocks.size() && m_blocks[handle].bLive && !m_blocks[handle].bPendingUpload;
+}
+
+bool GeometryHeap::tick()
+{
+	m_frameIndex ++;
+
+	pollSubmissions(false);
+	releaseRetired(false);
+
+	resizeBuffer();
+	uploadPending();
+
+	// NOTE: Compaction only runs on quiet ticks, moves never have to wait for a copy of the same tick.
+	const bool bMoved = m_recordingCmd == VK_NULL_HANDLE && compact();
+
+	submit();
+	return bMoved;
+}
+
+VkCommandBuffer GeometryHeap::getCommandBuffer()
+{
+	if(m_recordingCmd == VK_NULL_HANDLE)
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = m_commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		vkCheck(vkAllocateCommandBuffers(VulkanRHI::get()->getDevice(),&allocInfo,&m_recordingCmd));
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkCheck(vkBeginCommandBuffer(m_recordingCmd,&beginInfo));
+	}
+	return m_recordingCmd;
+}
+
+void GeometryHeap::submit()
+{
+	if(m_recordingCmd == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// NOTE: Later submissions on the queue read the heap as vertices, indices, storage buffer or copy source.
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+		VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(m_recordingCmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,1,&barrier,0,nullptr,0,nullptr);
+
+	vkCheck(vkEndCommandBuffer(m_recordingCmd));
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	Submission submission { };
+	submission.serial = ++m_submitSerial;
+	submission.cmd = m_recordingCmd;
+	submission.staging = m_recordingStaging;
+	vkCheck(vkCreateFence(VulkanRHI::get()->getDevice(),&fenceInfo,nullptr,&submission.fence));
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &submission.cmd;
+	vkCheck(vkQueueSubmit(VulkanRHI::get()->getVulkanDevice()->graphicsQueue,1,&submitInfo,submission.fence));
+
+	m_submissions.push_back(submission);
+	m_recordingCmd = VK_NULL_HANDLE;
+	m_recordingStaging = nullptr;
+}
+
+void GeometryHeap::pollSubmissions(bool bWait)
+{
+	VkDevice device = VulkanRHI::get()->getDevice();
+
+	// NOTE: Submissions complete in order on the queue, stop at the first one still running.
+	size_t completed = 0;
+	for(; completed < m_submissions.size(); completed++)
+	{
+		auto& submission = m_submissions[completed];
+		if(bWait)
+		{
+			vkCheck(vkWaitForFences(device,1,&submission.fence,VK_TRUE,UINT64_MAX));
+		}
+		else if(vkGetFenceStatus(device,submission.fence) != VK_SUCCESS)
+		{
+			break;
+		}
+
+		vkDestroyFence(device,submission.fence,nullptr);
+		vkFreeCommandBuffers(device,m_commandPool,1,&submission.cmd);
+		if(submission.staging)
+		{
+			delete submission.staging;
+		}
+		m_completedSerial = submission.serial;
+	}
+	m_submissions.erase(m_submissions.begin(),m_submissions.begin() + completed);
+}
+
+void GeometryHeap::releaseRetired(bool bForce)
+{
+	const uint64 frameDelay = VulkanRHI::get()->getMaxFramesInFlight() + 1;
+
+	size_t keep = 0;
+	for(size_t i = 0; i < m_retired.size(); i++)
+	{
+		auto& retired = m_retired[i];
+		if(!bForce && (m_frameIndex < retired.frameIndex + frameDelay || m_completedSerial < retired.serial))
+		{
+			m_retired[keep++] = retired;
+			continue;
+		}
+
+		if(retired.allocation.valid())
+		{
+			m_allocator.free(retired.allocation);
+		}
+		if(retired.buffer)
+		{
+			delete retired.buffer;
+		}
+	}
+	m_retired.resize(keep);
+}
+
+void GeometryHeap::resizeBuffer()
+{
+	const VkDeviceSize bytes = VkDeviceSize(m_allocator.getSize()) * m_stride;
+	if(m_buffer && m_buffer->getSize() >= bytes)
+	{
+		return;
+	}
+
+	VulkanBuffer* newBuffer = VulkanBuffer::create(
+		VulkanRHI::get()->getVulkanDevice(),
+		VulkanRHI::get()->getGraphicsCommandPool(),
+		m_usage,
+		VMA_MEMORY_USAGE_GPU_ONLY,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		bytes,
+		nullptr,
+		true
+	);
+
+	if(m_buffer)
+	{
+		LOG_INFO("Grow {0} geometry heap to {1} mb with a gpu copy.",m_name,bytes / (1024 * 1024));
+
+		VkCommandBuffer cmd = getCommandBuffer();
+		VkBufferCopy region{};
+		region.size = m_buffer->getSize();
+		vkCmdCopyBuffer(cmd,*m_buffer,*newBuffer,1,&region);
+
+		// NOTE: Uploads recorded next may land inside the copied range.
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd,VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_TRANSFER_BIT,0,1,&barrier,0,nullptr,0,nullptr);
+
+		Retired retired { };
+		retired.frameIndex = m_frameIndex;
+		retired.serial = m_submitSerial + 1;
+		retired.buffer = m_buffer;
+		m_retired.push_back(retired);
+
+		m_growCount ++;
+	}
+
+	m_buffer = newBuffer;
+}
+
+void GeometryHeap::uploadPending()
+{
+	if(m_pendingUploads.empty())
+	{
+		m_stagingData = {};
+		return;
+	}
+
+	CHECK(m_recordingStaging == nullptr);
+	m_recordingStaging = VulkanBuffer::create(
+		VulkanRHI::get()->getVulkanDevice(),
+		VulkanRHI::get()->getGraphicsCommandPool(),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_stagingData.size(),
+		m_stagingData.data()
+	);
+
+	std::vector<VkBufferCopy> regions(m_pendingUploads.size());
+	for(size_t i = 0; i < m_pendingUploads.size(); i++)
+	{
+		Block& block = m_blocks[m_pendingUploads[i].handle];
+		regions[i].srcOffset = m_pendingUploads[i].stagingOffset;
+		regions[i].dstOffset = VkDeviceSize(block.allocation.offset) * m_stride;
+		regions[i].size = VkDeviceSize(block.allocation.size) * m_stride;
+
+		block.bPendingUpload = false;
+		m_uploadedBytes += regions[i].size;
+	}
+	vkCmdCopyBuffer(getCommandBuffer(),*m_recordingStaging,*m_buffer,(uint32)regions.size(),regions.data());
+
+	m_pendingUploads.clear();
+	m_stagingData = {};
+}
+
+bool GeometryHeap::compact()
+{
+	const int32 maxMoves = cVarCompactMoves.get();
+	if(maxMoves <= 0 || getStats().fragmentation < cVarCompactThreshold.get())
+	{
+		return false;
+	}
+
+	// NOTE: Walk down from the end of the heap and move every range that fits into a lower hole.
+	//       The old range stays allocated until its deferred free, which also keeps the walk valid.
+	int32 moves = 0;
+	uint32 candidates = 0;
+	uint32 node = m_allocator.getLastAllocatedNode();
+	while(node != TlsfAllocator::INVALID_NODE && moves < maxMoves && candidates < GEOMETRY_HEAP_COMPACT_CANDIDATES)
+	{
+		const uint32 prevNode = m_allocator.getPrevAllocatedNode(node);
+		candidates ++;
+
+		// Ranges waiting for their deferred free have no handle and can't move.
+		auto it = m_nodeHandles.find(node);
+		if(it != m_nodeHandles.end())
+		{
+			const Handle handle = it->second;
+			Block& block = m_blocks[handle];
+
+			TlsfAllocator::Allocation target {};
+			if(!m_allocator.allocate(block.allocation.size,target))
+			{
+				break;
+			}
+
+			if(target.offset > block.allocation.offset)
+			{
+				m_allocator.free(target);
+			}
+			else
+			{
+				VkBufferCopy region{};
+				region.srcOffset = VkDeviceSize(block.allocation.offset) * m_stride;
+				region.dstOffset = VkDeviceSize(target.offset) * m_stride;
+				region.size = VkDeviceSize(target.size) * m_stride;
+				vkCmdCopyBuffer(getCommandBuffer(),*m_buffer,*m_buffer,1,&region);
+
+				Retired retired { };
+				retired.frameIndex = m_frameIndex;
+				retired.serial = m_submitSerial + 1;
+				retired.allocation = block.allocation;
+				m_retired.push_back(retired);
+
+				m_nodeHandles.erase(it);
+				m_nodeHandles[target.node] = handle;
+				block.allocation = target;
+				moves ++;
+			}
+		}
+
+		node = prevNode;
+	}
+
+	m_moveCount += moves;
+	return moves > 0;
+}
+
+GeometryHeap::Stats GeometryHeap::getStats() const
+{
+	const auto allocatorStats = m_allocator.getStats();
+
+	Stats stats { };
+	stats.bufferBytes = m_buffer ? m_buffer->getSize() : 0;
+	stats.usedBytes = VkDeviceSize(allocatorStats.usedSize) * m_stride;
+	stats.largestFreeBytes = VkDeviceSize(allocatorStats.largestFreeBlock) * m_stride;
+	stats.allocationCount = uint32(m_blocks.size() - m_freeHandles.size());
+	stats.freeBlockCount = allocatorStats.freeBlockCount;
+	stats.inflightSubmits = (uint32)m_submissions.size();
+	for(const auto& retired : m_retired)
+	{
+		if(retired.allocation.valid()) stats.pendingFreeCount ++;
+	}
+
+	const uint32 freeSize = allocatorStats.size - allocatorStats.usedSize;
+	stats.fragmentation = freeSize > 0 ? 1.0f - float(allocatorStats.largestFreeBlock) / float(freeSize) : 0.0f;
+
+	stats.growCount = m_growCount;
+	stats.moveCount = m_moveCount;
+	stats.uploadedBytes = m_uploadedBytes;
+	return stats;
+}
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include "../vk/vk_rhi.h"
+#include "../core/tlsf_allocator.h"
+#include <unordered_map>
+
+namespace engine{
+
+// NOTE: One device local buffer sub allocated with a TlsfAllocator in elements of a fixed stride,
+//       so ranges can be allocated and freed one by one. Nothing here waits for the device:
+//       uploads, growth and compaction are recorded at tick and submitted on the graphics queue
+//       with a fence that is only polled. Growth copies the old buffer into a bigger one on the
+//       gpu and keeps every offset, compaction moves the range at the end of the heap into a
+//       lower free block a few ranges per tick. A freed or moved range is reused once every frame
+//       in flight which may still read it finished.
+class GeometryHeap
+{
+public:
+	using Handle = uint32;
+	static constexpr Handle INVALID_HANDLE = ~0u;
+
+	struct Stats
+	{
+		VkDeviceSize bufferBytes = 0;
+		VkDeviceSize usedBytes = 0;        // includes ranges waiting for their deferred free.
+		VkDeviceSize largestFreeBytes = 0;
+		uint32 allocationCount = 0;
+		uint32 freeBlockCount = 0;
+		uint32 pendingFreeCount = 0;
+		uint32 inflightSubmits = 0;
+		float fragmentation = 0.0f;        // 1 - largest free block / free space.
+
+		// Since init.
+		uint32 growCount = 0;
+		uint32 moveCount = 0;
+		uint64 uploadedBytes = 0;
+	};
+
+	void init(const std::string& name,uint32 stride,VkBufferUsageFlags usage,VkDeviceSize baseSize,VkDeviceSize incrementSize);
+	void release();
+
+	// NOTE: Grows the heap when nothing fits, the buffer is replaced at the next tick.
+	Handle allocate(uint32 count);
+	void free(Handle handle);
+
+	// NOTE: Copies count * stride bytes of data, the gpu copy is recorded at the next tick.
+	void upload(Handle handle,const void* data);
+
+	// In elements, compaction may change the offset at any tick.
+	uint32 getOffset(Handle handle) const;
+	uint32 getCount(Handle handle) const;
+
+	// False until the upload of the range was submitted.
+	bool isResident(Handle handle) const;
+
+	// NOTE: Once per frame before anything records draws that read the heap. Returns true when
+	//       compaction moved ranges, offsets read before must be refreshed.
+	bool tick();
+
+	VkBuffer getBuffer() const { return m_buffer ? m_buffer->GetVkBuffer() : VK_NULL_HANDLE; }
+	uint32 getStride() const { return m_stride; }
+
+	Stats getStats() const;
+
+private:
+	struct Block
+	{
+		TlsfAllocator::Allocation allocation = {};
+		bool bLive = false;
+		bool bPendingUpload = false;
+	};
+
+	struct PendingUpload
+	{
+		Handle handle = INVALID_HANDLE;
+		size_t stagingOffset = 0;
+	};
+
+	struct Submission
+	{
+		uint64 serial = 0;
+		VkFence fence = VK_NULL_HANDLE;
+		VkCommandBuffer cmd = VK_NULL_HANDLE;
+		VulkanBuffer* staging = nullptr;
+	};
+
+	// NOTE: Range or buffer kept until the tick frameIndex + frames in flight and the submission
+	//       serial, the last one that may still read it, completed.
+	struct Retired
+	{
+		uint64 frameIndex = 0;
+		uint64 serial = 0;
+		TlsfAllocator::Allocation allocation = {};
+		VulkanBuffer* buffer = nullptr;
+	};
+
+	VkCommandBuffer getCommandBuffer();
+	void submit();
+	void pollSubmissions(bool bWait);
+	void releaseRetired(bool bForce);
+
+	void resizeBuffer();
+	void uploadPending();
+	bool compact();
+
+	std::string m_name = {};
+	uint32 m_stride = 0;
+	VkBufferUsageFlags m_usage = 0;
+	VkDeviceSize m_incrementSize = 0;
+
+	VulkanBuffer* m_buffer = nullptr;
+	TlsfAllocator m_allocator = {};
+
+	std::vector<Block> m_blocks = {};
+	std::vector<Handle> m_freeHandles = {};
+	std::unordered_map<uint32,Handle> m_nodeHandles = {};
+
+	std::vector<uint8> m_stagingData = {};
+	std::vector<PendingUpload> m_pendingUploads = {};
+
+	VkCommandPool m_commandPool = VK_NULL_HANDLE;
+	VkCommandBuffer m_recordingCmd = VK_NULL_HANDLE;
+	VulkanBuffer* m_recordingStaging = nullptr;
+
+	std::vector<Submission> m_submissions = {};
+	std::vector<Retired> m_retired = {};
+
+	uint64 m_frameIndex = 0;
+	uint64 m_submitSerial = 0;
+	uint64 m_completedSerial = 0;
+
+	uint32 m_growCount = 0;
+	uint32 m_moveCount = 0;
+	uint64 m_uploadedBytes = 0;
+};
+
+}
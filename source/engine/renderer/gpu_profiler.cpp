@@ -0,0 +1,516 @@
+#include "gpu_profiler.h"
+
+namespace engine{
+
+static AutoCVarInt32 cVarGpuProfiler(
+	"r.Profiler.Gpu",
+	"Write gpu timestamps around every pass and its sub scopes.",
+	"Profiler",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarGpuStatistics(
+	"r.Profiler.GpuStatistics",
+	"Count pipeline statistics (vertices, primitives, shader invocations) of every pass.",
+	"Profiler",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarGpuMaxScopes(
+	"r.Profiler.GpuMaxScopes",
+	"Gpu scopes one frame can hold, read at init.",
+	"Profiler",
+	256,
+	CVarFlags::ReadOnly
+);
+
+using frame_graph::EQueueType;
+
+static constexpr uint32 GPU_PROFILER_HISTORY_SIZE = 128;
+
+// A frame cut short never lands its queries, give up on it after this many visits of its back buffer.
+static constexpr uint32 GPU_PROFILER_MAX_READBACK_ATTEMPTS = 4;
+
+// Thread local nesting, record jobs never share a pass.
+static thread_local std::vector<uint32> t_scopeStack = {};
+static thread_local EQueueType t_scopeQueue = EQueueType::Graphics;
+
+static VkQueryPipelineStatisticFlags getStatisticFlags(EQueueType queue)
+{
+	if(queue == EQueueType::AsyncCompute)
+	{
+		return VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+	}
+
+	// Same order as GpuProfiler::EStatistic, results come back in bit order.
+	return
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+}
+
+static uint32 getStatisticCount(EQueueType queue)
+{
+	return queue == EQueueType::AsyncCompute ? 1 : GpuProfiler::StatisticCount;
+}
+
+GpuProfiler* GpuProfiler::get()
+{
+	static GpuProfiler profiler;
+	return &profiler;
+}
+
+void GpuProfiler::init()
+{
+	auto* device = VulkanRHI::get()->getVulkanDevice();
+
+	// only enabled on the device when the gpu supports it.
+	m_bPipelineStatisticsSupported = device->getDeviceFeatures().pipelineStatisticsQuery == VK_TRUE;
+
+	uint32 familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device->physicalDevice,&familyCount,nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device->physicalDevice,&familyCount,families.data());
+
+	m_timestampValidBits[size_t(EQueueType::Graphics)] = families[device->graphicsFamily].timestampValidBits;
+	m_timestampValidBits[size_t(EQueueType::AsyncCompute)] = families[device->computeFamily].timestampValidBits;
+	m_timestampPeriod = VulkanRHI::get()->getPhysicalDeviceProperties().limits.timestampPeriod;
+
+	if(!queueHasTimestamps(EQueueType::Graphics))
+	{
+		LOG_GRAPHICS_WARN("Graphics queue has no timestamps, gpu profiler disabled.");
+	}
+	else if(!queueHasTimestamps(EQueueType::AsyncCompute))
+	{
+		LOG_GRAPHICS_WARN("Compute queue has no timestamps, async compute passes are not profiled.");
+	}
+
+	m_maxScopes = (uint32)glm::max(cVarGpuMaxScopes.get(),1);
+	createQueries();
+}
+
+void GpuProfiler::release()
+{
+	destroyQueries();
+	m_currentFrame = nullptr;
+	m_latest = {};
+	m_smoothedMs.clear();
+	m_frameHistory.clear();
+}
+
+void GpuProfiler::createQueries()
+{
+	VkDevice device = VulkanRHI::get()->getDevice();
+	const size_t backBufferCount = VulkanRHI::get()->getSwapchainImageViews().size();
+
+	m_frames.resize(backBufferCount);
+	for(auto& frame : m_frames)
+	{
+		frame = std::make_unique<FrameQueries>();
+		frame->scopes.resize(m_maxScopes);
+
+		VkQueryPoolCreateInfo info { };
+		info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		info.queryCount = m_maxScopes * 2;
+		vkCheck(vkCreateQueryPool(device,&info,nullptr,&frame->timestamps));
+		vkResetQueryPool(device,frame->timestamps,0,info.queryCount);
+
+		if(m_bPipelineStatisticsSupported)
+		{
+			for(size_t queue = 0; queue < frame->statistics.size(); queue++)
+			{
+				info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+				info.queryCount = m_maxScopes;
+				info.pipelineStatistics = getStatisticFlags(EQueueType(queue));
+				vkCheck(vkCreateQueryPool(device,&info,nullptr,&frame->statistics[queue]));
+				vkResetQueryPool(device,frame->statistics[queue],0,info.queryCount);
+			}
+		}
+	}
+}
+
+void GpuProfiler::destroyQueries()
+{
+	VkDevice device = VulkanRHI::get()->getDevice();
+	for(auto& frame : m_frames)
+	{
+		vkDestroyQueryPool(device,frame->timestamps,nullptr);
+		for(auto pool : frame->statistics)
+		{
+			if(pool != VK_NULL_HANDLE)
+			{
+				vkDestroyQueryPool(device,pool,nullptr);
+			}
+		}
+	}
+	m_frames.clear();
+}
+
+void GpuProfiler::beginFrame(uint32 backBufferIndex)
+{
+	m_currentFrame = nullptr;
+	m_bFrameEnabled = false;
+	m_bFrameStatistics = false;
+	if(backBufferIndex >= m_frames.size())
+	{
+		return;
+	}
+
+	// NOTE: Acquire waited for the last frame which used this back buffer, so its queries are usually
+	//       done. Results are fetched without wait, when some are not ready yet the pools keep them and
+	//       this frame records no scopes into them.
+	auto& frame = *m_frames[backBufferIndex];
+	if(frame.scopeCount.load() > 0 && !readback(frame))
+	{
+		return;
+	}
+
+	m_currentFrame = &frame;
+	m_bFrameEnabled = cVarGpuProfiler.get() != 0 && queueHasTimestamps(EQueueType::Graphics);
+	m_bFrameStatistics = m_bFrameEnabled && m_bPipelineStatisticsSupported && cVarGpuStatistics.get() != 0;
+
+	frame.scopeCount = 0;
+	frame.readbackAttempts = 0;
+	frame.frameIndex = ++m_frameIndex;
+	frame.cpuFrameBegin = std::chrono::steady_clock::now();
+	frame.bStatistics = m_bFrameStatistics;
+}
+
+uint32 GpuProfiler::allocateScope(FrameQueries& frame)
+{
+	const uint32 index = frame.scopeCount.fetch_add(1);
+	return index < m_maxScopes ? index : INVALID_SCOPE;
+}
+
+bool GpuProfiler::queueHasTimestamps(EQueueType queue) const
+{
+	return m_timestampValidBits[size_t(queue)] > 0;
+}
+
+void GpuProfiler::beginPassScope(VkCommandBuffer cmd,const std::string& name,EQueueType queue)
+{
+	CHECK(t_scopeStack.empty() && "Pass scopes can't nest.");
+
+	uint32 index = INVALID_SCOPE;
+	if(m_bFrameEnabled && queueHasTimestamps(queue))
+	{
+		index = allocateScope(*m_currentFrame);
+	}
+	t_scopeStack.push_back(index);
+	t_scopeQueue = queue;
+
+	if(index == INVALID_SCOPE)
+	{
+		return;
+	}
+
+	auto& slot = m_currentFrame->scopes[index];
+	slot.name = name;
+	slot.index = -1;
+	slot.parent = INVALID_SCOPE;
+	slot.queue = queue;
+	slot.bStatistics = m_bFrameStatistics;
+	slot.bClosed = false;
+
+	vkCmdWriteTimestamp(cmd,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,m_currentFrame->timestamps,index * 2);
+	if(slot.bStatistics)
+	{
+		vkCmdBeginQuery(cmd,m_currentFrame->statistics[size_t(queue)],index,0);
+	}
+}
+
+void GpuProfiler::endPassScope(VkCommandBuffer cmd)
+{
+	CHECK(t_scopeStack.size() == 1 && "Sub scopes still open at the end of the pass.");
+
+	const uint32 index = t_scopeStack.back();
+	t_scopeStack.pop_back();
+	if(index == INVALID_SCOPE)
+	{
+		return;
+	}
+
+	auto& slot = m_currentFrame->scopes[index];
+	if(slot.bStatistics)
+	{
+		vkCmdEndQuery(cmd,m_currentFrame->statistics[size_t(slot.queue)],index);
+	}
+	vkCmdWriteTimestamp(cmd,VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,m_currentFrame->timestamps,index * 2 + 1);
+
+	slot.bClosed = true;
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer cmd,const char* name,int32 index)
+{
+	if(t_scopeStack.empty())
+	{
+		return;
+	}
+
+	const uint32 parent = t_scopeStack.back();
+	const uint32 scope = parent != INVALID_SCOPE ? allocateScope(*m_currentFrame) : INVALID_SCOPE;
+	t_scopeStack.push_back(scope);
+	if(scope == INVALID_SCOPE)
+	{
+		return;
+	}
+
+	auto& slot = m_currentFrame->scopes[scope];
+	slot.name = name;
+	slot.index = index;
+	slot.parent = parent;
+	slot.queue = t_scopeQueue;
+	slot.bStatistics = false;
+	slot.bClosed = false;
+
+	vkCmdWriteTimestamp(cmd,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,m_currentFrame->timestamps,scope * 2);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer cmd)
+{
+	// The pass scope itself is closed by endPassScope.
+	if(t_scopeStack.size() < 2)
+	{
+		return;
+	}
+
+	const uint32 scope = t_scopeStack.back();
+	t_scopeStack.pop_back();
+	if(scope == INVALID_SCOPE)
+	{
+		return;
+	}
+
+	vkCmdWriteTimestamp(cmd,VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,m_currentFrame->timestamps,scope * 2 + 1);
+	m_currentFrame->scopes[scope].bClosed = true;
+}
+
+double GpuProfiler::ticksToMs(uint64 begin,uint64 end,EQueueType queue) const
+{
+	// Timestamps only count the valid bits and wrap around.
+	const uint32 validBits = m_timestampValidBits[size_t(queue)];
+	const uint64 mask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	return double((end - begin) & mask) * m_timestampPeriod * 1e-6;
+}
+
+bool GpuProfiler::readback(FrameQueries& frame)
+{
+	VkDevice device = VulkanRHI::get()->getDevice();
+	const uint32 scopeCount = glm::min(frame.scopeCount.load(),m_maxScopes);
+
+	// Value and availability per query.
+	m_timestampData.resize(scopeCount * 2 * 2);
+	const VkResult timestampResult = vkGetQueryPoolResults(device,frame.timestamps,0,scopeCount * 2,
+		m_timestampData.size() * sizeof(uint64),m_timestampData.data(),sizeof(uint64) * 2,
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	CHECK(timestampResult == VK_SUCCESS || timestampResult == VK_NOT_READY);
+
+	auto timestampAvailable = [&](uint32 query) { return m_timestampData[query * 2 + 1] != 0; };
+	auto timestamp = [&](uint32 query) { return m_timestampData[query * 2]; };
+
+	std::array<std::vector<uint64>,size_t(EQueueType::Count)> statistics {};
+	if(frame.bStatistics)
+	{
+		for(size_t queue = 0; queue < statistics.size(); queue++)
+		{
+			const uint32 stride = getStatisticCount(EQueueType(queue)) + 1;
+			statistics[queue].resize(scopeCount * stride);
+			const VkResult statisticsResult = vkGetQueryPoolResults(device,frame.statistics[queue],0,scopeCount,
+				statistics[queue].size() * sizeof(uint64),statistics[queue].data(),sizeof(uint64) * stride,
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			CHECK(statisticsResult == VK_SUCCESS || statisticsResult == VK_NOT_READY);
+		}
+	}
+	auto statisticsAvailable = [&](uint32 i)
+	{
+		const EQueueType queue = frame.scopes[i].queue;
+		const uint32 stride = getStatisticCount(queue) + 1;
+		return statistics[size_t(queue)][i * stride + stride - 1] != 0;
+	};
+
+	// NOTE: Closed scopes were recorded, their queries land once the frame finished on the gpu. Keep the
+	//       pools untouched until then so no timing is lost.
+	bool bReady = true;
+	for(uint32 i = 0; i < scopeCount && bReady; i++)
+	{
+		const auto& slot = frame.scopes[i];
+		bReady = !slot.bClosed || (timestampAvailable(i * 2) && timestampAvailable(i * 2 + 1) &&
+			(!slot.bStatistics || statisticsAvailable(i)));
+	}
+	if(!bReady && ++frame.readbackAttempts < GPU_PROFILER_MAX_READBACK_ATTEMPTS)
+	{
+		return false;
+	}
+
+	vkResetQueryPool(device,frame.timestamps,0,scopeCount * 2);
+	if(frame.bStatistics)
+	{
+		for(size_t queue = 0; queue < statistics.size(); queue++)
+		{
+			vkResetQueryPool(device,frame.statistics[queue],0,scopeCount);
+		}
+	}
+
+	// NOTE: A parent takes its slot before its children, so one pass settles validity.
+	std::vector<bool> valid(scopeCount,false);
+	for(uint32 i = 0; i < scopeCount; i++)
+	{
+		const auto& slot = frame.scopes[i];
+		valid[i] = slot.bClosed && timestampAvailable(i * 2) && timestampAvailable(i * 2 + 1) &&
+			(slot.parent == INVALID_SCOPE || valid[slot.parent]);
+	}
+
+	// NOTE: Frame base per queue. Timestamps of different queues are not comparable, every scope is
+	//       measured against the first timestamp of its own queue.
+	std::array<uint64,size_t(EQueueType::Count)> frameBegin {};
+	std::array<bool,size_t(EQueueType::Count)> bHasQueue {};
+	for(uint32 i = 0; i < scopeCount; i++)
+	{
+		if(!valid[i])
+		{
+			continue;
+		}
+		const size_t queue = size_t(frame.scopes[i].queue);
+		if(!bHasQueue[queue] || timestamp(i * 2) < frameBegin[queue])
+		{
+			frameBegin[queue] = timestamp(i * 2);
+			bHasQueue[queue] = true;
+		}
+	}
+
+	std::vector<std::vector<uint32>> children(scopeCount);
+	std::vector<uint32> roots;
+	for(uint32 i = 0; i < scopeCount; i++)
+	{
+		if(valid[i])
+		{
+			(frame.scopes[i].parent == INVALID_SCOPE ? roots : children[frame.scopes[i].parent]).push_back(i);
+		}
+	}
+
+	auto beginMs = [&](uint32 i)
+	{
+		const EQueueType queue = frame.scopes[i].queue;
+		return ticksToMs(frameBegin[size_t(queue)],timestamp(i * 2),queue);
+	};
+
+	// Queue first, begin times only order scopes of the same queue.
+	auto byBegin = [&](uint32 a,uint32 b)
+	{
+		if(frame.scopes[a].queue != frame.scopes[b].queue)
+		{
+			return frame.scopes[a].queue < frame.scopes[b].queue;
+		}
+		return beginMs(a) < beginMs(b);
+	};
+
+	FrameResult result { };
+	result.frameIndex = frame.frameIndex;
+	result.cpuFrameBeginUs = getChromeTraceTimeUs(frame.cpuFrameBegin);
+
+	constexpr float smoothFactor = 0.1f;
+	std::vector<std::string> pathStack;
+	auto emit = [&](auto&& self,uint32 i,uint32 depth) -> void
+	{
+		const auto& slot = frame.scopes[i];
+
+		ScopeResult scope { };
+		scope.name = slot.index >= 0 ? slot.name + " " + std::to_string(slot.index) : slot.name;
+		scope.depth = depth;
+		scope.queue = slot.queue;
+		scope.beginMs = beginMs(i);
+		scope.endMs = scope.beginMs + ticksToMs(timestamp(i * 2),timestamp(i * 2 + 1),slot.queue);
+
+		pathStack.push_back(pathStack.empty() ? scope.name : pathStack.back() + "/" + scope.name);
+		auto smoothed = m_smoothedMs.find(pathStack.back());
+		const float ms = float(scope.endMs - scope.beginMs);
+		scope.smoothedMs = smoothed == m_smoothedMs.end() ? ms : glm::mix(smoothed->second,ms,smoothFactor);
+		m_smoothedMs[pathStack.back()] = scope.smoothedMs;
+
+		if(slot.bStatistics)
+		{
+			const size_t queue = size_t(slot.queue);
+			const uint32 stride = getStatisticCount(slot.queue) + 1;
+			const uint64* values = &statistics[queue][i * stride];
+			if(values[stride - 1] != 0)
+			{
+				scope.bStatistics = true;
+				if(slot.queue == EQueueType::AsyncCompute)
+				{
+					scope.statistics[ComputeShaderInvocations] = values[0];
+				}
+				else
+				{
+					std::copy(values,values + StatisticCount,scope.statistics.begin());
+				}
+			}
+		}
+
+		result.gpuMs = glm::max(result.gpuMs,scope.endMs);
+		result.scopes.push_back(std::move(scope));
+
+		std::sort(children[i].begin(),children[i].end(),byBegin);
+		for(uint32 child : children[i])
+		{
+			self(self,child,depth + 1);
+		}
+		pathStack.pop_back();
+	};
+
+	std::sort(roots.begin(),roots.end(),byBegin);
+	for(uint32 root : roots)
+	{
+		emit(emit,root,0);
+	}
+
+	if(result.scopes.empty())
+	{
+		return true;
+	}
+
+	m_latest = std::move(result);
+	m_frameHistory.push_back(float(m_latest.gpuMs));
+	if(m_frameHistory.size() > GPU_PROFILER_HISTORY_SIZE)
+	{
+		m_frameHistory.erase(m_frameHistory.begin());
+	}
+	return true;
+}
+
+void GpuProfiler::appendChromeTrace(std::vector<ChromeTraceTrack>& tracks,std::vector<ChromeTraceEvent>& events) const
+{
+	static const char* statisticNames[StatisticCount] =
+	{
+		"ia vertices", "ia primitives", "vs invocations", "clipping primitives", "fs invocations", "cs invocations"
+	};
+
+	tracks.push_back({ CHROME_TRACE_GPU_PID, uint32(EQueueType::Graphics), "GPU", "Graphics queue" });
+	tracks.push_back({ CHROME_TRACE_GPU_PID, uint32(EQueueType::AsyncCompute), "GPU", "Compute queue" });
+
+	for(const auto& scope : m_latest.scopes)
+	{
+		ChromeTraceEvent event { };
+		event.name = scope.name;
+		event.category = "gpu";
+		event.pid = CHROME_TRACE_GPU_PID;
+		event.tid = uint32(scope.queue);
+		event.beginUs = m_latest.cpuFrameBeginUs + scope.beginMs * 1000.0;
+		event.durationUs = (scope.endMs - scope.beginMs) * 1000.0;
+		if(scope.bStatistics)
+		{
+			for(uint32 i = 0; i < StatisticCount; i++)
+			{
+				event.args.push_back({ statisticNames[i], scope.statistics[i] });
+			}
+		}
+		events.push_back(std::move(event));
+	}
+}
+
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include "../vk/vk_rhi.h"
+#include "../core/chrome_trace.h"
+#include "frame_graph/frame_graph.h"
+#include <atomic>
+
+namespace engine{
+
+// NOTE: Gpu timestamps around every frame graph pass and the sub scopes passes open inside of them,
+//       plus optional pipeline statistics per pass. Every back buffer owns its query pools, the results
+//       of a back buffer are read without waiting when it comes around again, its fence was already
+//       waited by acquire then. Results that did not land yet stay in the pools and that back buffer
+//       skips profiling until they do. Passes record on several threads so scope slots are taken with
+//       an atomic and the nesting lives on a thread local stack.
+class GpuProfiler
+{
+public:
+	enum EStatistic : uint32
+	{
+		InputAssemblyVertices = 0,
+		InputAssemblyPrimitives,
+		VertexShaderInvocations,
+		ClippingPrimitives,
+		FragmentShaderInvocations,
+		ComputeShaderInvocations,
+
+		StatisticCount,
+	};
+
+	struct ScopeResult
+	{
+		std::string name = {};
+		uint32 depth = 0;
+		frame_graph::EQueueType queue = frame_graph::EQueueType::Graphics;
+
+		// Relative to the first timestamp of its queue in the frame, queues are never compared.
+		double beginMs = 0.0;
+		double endMs = 0.0;
+
+		// Exponential average of endMs - beginMs over the frames this scope showed up in.
+		float smoothedMs = 0.0f;
+
+		bool bStatistics = false;
+		std::array<uint64,StatisticCount> statistics = {};
+	};
+
+	// NOTE: Scopes are grouped by queue and in execution order within it, children follow their parent.
+	struct FrameResult
+	{
+		uint64 frameIndex = 0;
+		double gpuMs = 0.0;         // longest first to last timestamp span of one queue.
+		double cpuFrameBeginUs = 0.0;
+		std::vector<ScopeResult> scopes = {};
+	};
+
+	static GpuProfiler* get();
+
+	void init();
+	void release();
+
+	// NOTE: Call once per frame after the present image was acquired and before any pass records.
+	void beginFrame(uint32 backBufferIndex);
+
+	// NOTE: Pass scopes are roots and own the pipeline statistics query, the queue decides which
+	//       statistics are valid and whether that queue family has timestamps at all.
+	void beginPassScope(VkCommandBuffer cmd,const std::string& name,frame_graph::EQueueType queue);
+	void endPassScope(VkCommandBuffer cmd);
+
+	// NOTE: Nested inside the pass scope open on this thread, ignored when there is none.
+	//       index >= 0 is appended to the name, so loops don't have to format strings.
+	void beginScope(VkCommandBuffer cmd,const char* name,int32 index = -1);
+	void endScope(VkCommandBuffer cmd);
+
+	bool isEnabled() const { return m_bFrameEnabled; }
+	bool isStatisticsEnabled() const { return m_bFrameStatistics; }
+
+	const FrameResult& getLatestResult() const { return m_latest; }
+
+	// Gpu frame time history, oldest first.
+	const std::vector<float>& getFrameHistory() const { return m_frameHistory; }
+
+	// NOTE: Latest frame, one track per queue. Every queue is placed at the cpu begin of its frame,
+	//       neither the queues nor the cpu clock are calibrated against each other.
+	void appendChromeTrace(std::vector<ChromeTraceTrack>& tracks,std::vector<ChromeTraceEvent>& events) const;
+
+private:
+	static constexpr uint32 INVALID_SCOPE = ~0u;
+
+	struct ScopeSlot
+	{
+		std::string name = {};
+		int32 index = -1;
+		uint32 parent = INVALID_SCOPE;
+		frame_graph::EQueueType queue = frame_graph::EQueueType::Graphics;
+		bool bStatistics = false;
+		bool bClosed = false;
+	};
+
+	struct FrameQueries
+	{
+		VkQueryPool timestamps = VK_NULL_HANDLE;
+
+		// Compute only queue families may not count graphics statistics, so one pool per queue type.
+		std::array<VkQueryPool,size_t(frame_graph::EQueueType::Count)> statistics = {};
+
+		std::vector<ScopeSlot> scopes = {};
+		std::atomic<uint32> scopeCount { 0 };
+		uint64 frameIndex = 0;
+		std::chrono::steady_clock::time_point cpuFrameBegin = {};
+		bool bStatistics = false;
+		uint32 readbackAttempts = 0;
+	};
+
+	void createQueries();
+	void destroyQueries();
+	bool readback(FrameQueries& frame);
+	uint32 allocateScope(FrameQueries& frame);
+	bool queueHasTimestamps(frame_graph::EQueueType queue) const;
+	double ticksToMs(uint64 begin,uint64 end,frame_graph::EQueueType queue) const;
+
+	std::vector<std::unique_ptr<FrameQueries>> m_frames = {};
+	FrameQueries* m_currentFrame = nullptr;
+	uint32 m_maxScopes = 0;
+	uint64 m_frameIndex = 0;
+
+	bool m_bFrameEnabled = false;
+	bool m_bFrameStatistics = false;
+
+	bool m_bPipelineStatisticsSupported = false;
+	float m_timestampPeriod = 1.0f;
+	std::array<uint32,size_t(frame_graph::EQueueType::Count)> m_timestampValidBits = {};
+
+	FrameResult m_latest = {};
+	std::unordered_map<std::string,float> m_smoothedMs = {};
+	std::vector<float> m_frameHistory = {};
+
+	// Raw query results, reused across readbacks.
+	std::vector<uint64> m_timestampData = {};
+	std::vector<uint64> m_statisticsData = {};
+};
+
+// NOTE: Nested gpu scope for the lifetime of the object.
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(VkCommandBuffer cmd,const char* name,int32 index = -1)
+		: m_cmd(cmd)
+	{
+		GpuProfiler::get()->beginScope(m_cmd,name,index);
+	}
+
+	~GpuProfileScope()
+	{
+		GpuProfiler::get()->endScope(m_cmd);
+	}
+
+private:
+	VkCommandBuffer m_cmd;
+};
+
+}
@@ -25,7 +25,7 @@ void setupVulkanInitInfo(ImGui_ImplVulkan_InitInfo* inout,VkDescriptorPool pool)
 	inout->Device = VulkanRHI::get()->getDevice();
 	inout->QueueFamily = VulkanRHI::get()->getVulkanDevice()->findQueueFamilies().graphicsFamily;
 	inout->Queue = VulkanRHI::get()->getGraphicsQueue();
-	inout->PipelineCache = VK_NULL_HANDLE;
+	inout->PipelineCache = VulkanRHI::get()->getPipelineRegistry().getPipelineCache();
 	inout->DescriptorPool = pool;
 	inout->Allocator = nullptr;
 	inout->MinImageCount = (uint32_t)VulkanRHI::get()->getSwapchainImageViews().size();
@@ -26,6 +26,12 @@ engine::MaterialLibrary::~MaterialLibrary()
 		delete pair.second;
 	}
 	m_materialContainer.clear();
+
+	for(auto& pair : m_prefetchMaterials)
+	{
+		delete pair.second;
+	}
+	m_prefetchMaterials.clear();
 }
 
 std::unordered_map<std::string,Material*>& engine::MaterialLibrary::getContainer()
@@ -51,7 +57,10 @@ Material* engine::MaterialLibrary::createEmptyMaterialAsset(const std::string& n
 	}
 
 	auto* newMat = new Material();
-	m_materialContainer[name] = newMat;
+	{
+		std::lock_guard lock(m_prefetchMutex);
+		m_materialContainer[name] = newMat;
+	}
 
 	std::ofstream os(name);
 	cereal::JSONOutputArchive archive(os);
@@ -67,16 +76,78 @@ Material* engine::MaterialLibrary::getMaterial(const std::string& name)
 		return m_materialContainer[name];
 	}
 
-	auto newMat = new Material();
-	m_materialContainer[name] = newMat;
+	Material* newMat = nullptr;
+	{
+		std::lock_guard lock(m_prefetchMutex);
+		auto it = m_prefetchMaterials.find(name);
+		if(it != m_prefetchMaterials.end())
+		{
+			newMat = it->second;
+			m_prefetchMaterials.erase(it);
+		}
+	}
 
-	std::ifstream os(name);
-	cereal::JSONInputArchive iarchive(os);
-	iarchive(*newMat);
+	if(newMat == nullptr)
+	{
+		newMat = new Material();
+		std::ifstream os(name);
+		cereal::JSONInputArchive iarchive(os);
+		iarchive(*newMat);
+	}
 
+	std::lock_guard lock(m_prefetchMutex);
+	m_materialContainer[name] = newMat;
 	return newMat;
 }
 
+void engine::MaterialLibrary::prefetchMaterial(const std::string& name)
+{
+	if(name == "" || !std::filesystem::exists(name))
+	{
+		return;
+	}
+
+	{
+		std::lock_guard lock(m_prefetchMutex);
+		if(m_materialContainer.find(name) != m_materialContainer.end() || 
+		   m_prefetchMaterials.find(name) != m_prefetchMaterials.end())
+		{
+			return;
+		}
+	}
+
+	auto newMat = new Material();
+	{
+		std::ifstream os(name);
+		cereal::JSONInputArchive iarchive(os);
+		iarchive(*newMat);
+	}
+
+	std::lock_guard lock(m_prefetchMutex);
+	if(!m_prefetchMaterials.emplace(name,newMat).second)
+	{
+		delete newMat;
+	}
+}
+
+void engine::MaterialLibrary::flushPrefetchMaterials()
+{
+	std::vector<std::string> names;
+	{
+		std::lock_guard lock(m_prefetchMutex);
+		for(auto& pair : m_prefetchMaterials)
+		{
+			names.push_back(pair.first);
+		}
+	}
+
+	for(auto& name : names)
+	{
+		// NOTE: Requesting the gpu data puts every texture of the material into the asset system load queue.
+		getMaterial(name)->getGPUMaterialData();
+	}
+}
+
 Material& engine::MaterialLibrary::getCallbackMaterial()
 {
 	return m_callBackMaterial;
@@ -18,6 +18,7 @@
 #include "../shader_compiler/shader_compiler.h"
 #include <utility>
 #include <cereal/types/utility.hpp>
+#include <mutex>
 
 namespace engine{
 
@@ -53,6 +54,11 @@ private:
 	std::unordered_map<std::string/*file path*/,Material*> m_materialContainer;
 	static MaterialLibrary* s_materialLibrary;
 	Material m_callBackMaterial;
+
+	// NOTE: Materials parsed on loading threads, moved into the container on the main thread.
+	std::mutex m_prefetchMutex;
+	std::unordered_map<std::string,Material*> m_prefetchMaterials;
+
 	MaterialLibrary();
 	~MaterialLibrary();
 
@@ -65,6 +71,12 @@ public:
 	Material* getMaterial(const std::string& name);
 
 	Material& getCallbackMaterial();
+
+	// NOTE: Thread safe, parse the material file on the calling thread.
+	void prefetchMaterial(const std::string& name);
+
+	// NOTE: Main thread. Move prefetched materials into the container and queue their textures.
+	void flushPrefetchMaterials();
 };
 
 }
\ No newline at end of file
@@ -4,7 +4,6 @@
 #include "../core/file_system.h"
 #include "material.h"
 #include "../launch/launch_engine_loop.h"
-#include <execution>
 #include "../core/job_system.h"
 #include "../vk/vk_rhi.h"
 
@@ -42,6 +41,14 @@ static AutoCVarInt32 cVarIndexBufferIncrementSize(
     CVarFlags::InitOnce | CVarFlags::ReadOnly
 );
 
+static AutoCVarInt32 cVarMeshCpuMirror(
+    "r.Mesh.CpuMirror",
+    "Keep a cpu copy of the vertex and index data of meshes loaded from now on. 0 frees it once it is staged for upload.",
+    "Mesh",
+    0,
+    CVarFlags::ReadAndWrite
+);
+
 MeshLibrary* MeshLibrary::s_meshLibrary = new MeshLibrary();
 
 void RenderBounds::toExtents(
@@ -88,38 +95,49 @@ RenderBounds RenderBounds::combine(const RenderBounds& b0,const RenderBounds& b1
     return ret;
 }
 
-void engine::MeshLibrary::buildFromGameAsset(Mesh& inout,const std::string& gameName)
+bool engine::MeshLibrary::decodeGameAsset(const std::string& gameName,PrefetchMesh& out)
 {
     using namespace asset_system;
 
     AssetFile asset {};
-    loadBinFile(gameName.c_str(),asset);
+    if(!loadBinFile(gameName.c_str(),asset))
+    {
+        return false;
+    }
+
     CHECK(asset.type[0] == 'M' && 
         asset.type[1] == 'E' && 
         asset.type[2] == 'S' && 
         asset.type[3] == 'H');
 
-    std::vector<VertexIndexType> indicesData = {};
-    std::vector<float> verticesData = {};
-
     MeshInfo info = asset_system::readMeshInfo(&asset);
 
     // 1. indicesDataverticesData
-    unpackMesh(&info,asset.binBlob.data(),asset.binBlob.size(),verticesData,indicesData);
-
-    inout.layout = info.attributeLayout;
-    inout.subMeshes.resize(info.subMeshCount);
+    QuantizedMesh quantized {};
+    unpackMesh(&info,asset.binBlob.data(),asset.binBlob.size(),quantized);
+    out.verticesData = std::move(quantized.vertices);
+    out.indicesData = std::move(quantized.indices);
+    out.indices16Data = std::move(quantized.indices16);
+    out.meshletsData = std::move(quantized.meshlets);
 
-    uint32 lastMeshVerticesPos = (uint32)m_cacheVerticesData.size();
-    uint32 lastMeshIndexPos = (uint32)m_cacheIndicesData.size();
+    out.layout = info.attributeLayout;
+    out.subMeshes.resize(info.subMeshCount);
 
     for (uint32 i = 0; i < info.subMeshCount; i++)
     {
         const auto& subMeshInfo = info.subMeshInfos[i];
-        auto& subMesh = inout.subMeshes[i];
+        auto& subMesh = out.subMeshes[i];
 
         subMesh.indexCount = subMeshInfo.indexCount;
-        subMesh.indexStartPosition = subMeshInfo.indexStartPosition + lastMeshIndexPos;
+        subMesh.indexStartPosition = subMeshInfo.indexStartPosition;
+        subMesh.baseVertex = subMeshInfo.baseVertex;
+        subMesh.bIndex16 = subMeshInfo.bIndex16;
+        subMesh.meshletStart = subMeshInfo.meshletStart;
+        subMesh.meshletCount = subMeshInfo.meshletCount;
+
+        CHECK(!subMeshInfo.lods.empty() && subMeshInfo.lods.size() <= MESH_MAX_LOD_COUNT);
+        subMesh.lodCount = (uint32)subMeshInfo.lods.size();
+        std::copy(subMeshInfo.lods.begin(),subMeshInfo.lods.end(),subMesh.lods.begin());
         subMesh.renderBounds.extents = glm::vec3(
             subMeshInfo.bounds.extents[0],
             subMeshInfo.bounds.extents[1],
@@ -133,36 +151,203 @@ void engine::MeshLibrary::buildFromGameAsset(Mesh& inout,const std::string& game
         );
 
         subMesh.renderBounds.radius = subMeshInfo.bounds.radius;
+        subMesh.materialInfoPath = subMeshInfo.materialPath;
+    }
 
+    return true;
+}
+
+void engine::MeshLibrary::buildFromPrefetch(Mesh& inout,PrefetchMesh& prefetch)
+{
+    inout.layout = std::move(prefetch.layout);
+    inout.subMeshes = std::move(prefetch.subMeshes);
+
+    for(auto& subMesh : inout.subMeshes)
+    {
         // NOTE: òʿһβ
-        if(subMeshInfo.materialPath != "")
+        if(subMesh.materialInfoPath != "")
         {
-            subMesh.cacheMaterial =  MaterialLibrary::get()->getMaterial(subMeshInfo.materialPath);
-            subMesh.materialInfoPath = subMeshInfo.materialPath;
+            subMesh.cacheMaterial = MaterialLibrary::get()->getMaterial(subMesh.materialInfoPath);
         }
         else
         {
             subMesh.cacheMaterial = &MaterialLibrary::get()->getCallbackMaterial();
-            subMesh.materialInfoPath = "";
         }
     }
 
+    auto& verticesData = prefetch.verticesData;
+    auto& indicesData = prefetch.indicesData;
+    auto& indices16Data = prefetch.indices16Data;
+    auto& meshletsData = prefetch.meshletsData;
+
     // 2. Զλ
-    inout.vertexStartPosition = lastMeshVerticesPos;
+    //    Indices stay relative to the base vertex of their submesh, draws add the vertex offset of its heap range.
     inout.vertexCount = (uint32)verticesData.size();
-
-    inout.indexStartPosition = lastMeshIndexPos;
     inout.indexCount = (uint32)indicesData.size();
+    inout.index16Count = (uint32)indices16Data.size();
+    inout.meshletCount = (uint32)meshletsData.size();
+    inout.vertexStartPosition = 0;
+    inout.indexStartPosition = 0;
+    inout.index16StartPosition = 0;
+    inout.meshletStartPosition = 0;
+
+    // 3. ڼζϷ䲢Ŷϴ
+    if(inout.vertexCount > 0 && inout.indexCount + inout.index16Count > 0)
+    {
+        inout.vertexHandle = m_vertexHeap.allocate(inout.vertexCount);
+        m_vertexHeap.upload(inout.vertexHandle,verticesData.data());
+
+        if(inout.indexCount > 0)
+        {
+            inout.indexHandle = m_indexHeap.allocate(inout.indexCount);
+            m_indexHeap.upload(inout.indexHandle,indicesData.data());
+        }
+
+        if(inout.index16Count > 0)
+        {
+            inout.index16Handle = m_index16Heap.allocate(inout.index16Count);
+            m_index16Heap.upload(inout.index16Handle,indices16Data.data());
+        }
+
+        if(inout.meshletCount > 0)
+        {
+            inout.meshletHandle = m_meshletHeap.allocate(inout.meshletCount);
+            m_meshletHeap.upload(inout.meshletHandle,meshletsData.data());
+        }
+
+        refreshMeshPosition(inout);
+    }
+
+    if(cVarMeshCpuMirror.get() != 0)
+    {
+        inout.verticesData = std::move(verticesData);
+        inout.indicesData = std::move(indicesData);
+        inout.indices16Data = std::move(indices16Data);
+        inout.meshletsData = std::move(meshletsData);
+    }
+}
+
+void engine::MeshLibrary::refreshMeshPosition(Mesh& mesh)
+{
+    if(mesh.vertexHandle != GeometryHeap::INVALID_HANDLE)
+    {
+        mesh.vertexStartPosition = m_vertexHeap.getOffset(mesh.vertexHandle);
+    }
+
+    if(mesh.indexHandle != GeometryHeap::INVALID_HANDLE)
+    {
+        mesh.indexStartPosition = m_indexHeap.getOffset(mesh.indexHandle);
+    }
+
+    if(mesh.index16Handle != GeometryHeap::INVALID_HANDLE)
+    {
+        mesh.index16StartPosition = m_index16Heap.getOffset(mesh.index16Handle);
+    }
+
+    if(mesh.meshletHandle != GeometryHeap::INVALID_HANDLE)
+    {
+        mesh.meshletStartPosition = m_meshletHeap.getOffset(mesh.meshletHandle);
+    }
+}
+
+void engine::MeshLibrary::releaseMeshGeometry(Mesh& mesh)
+{
+    if(mesh.vertexHandle != GeometryHeap::INVALID_HANDLE)
+    {
+        m_vertexHeap.free(mesh.vertexHandle);
+        mesh.vertexHandle = GeometryHeap::INVALID_HANDLE;
+    }
+
+    if(mesh.indexHandle != GeometryHeap::INVALID_HANDLE)
+    {
+        m_indexHeap.free(mesh.indexHandle);
+        mesh.indexHandle = GeometryHeap::INVALID_HANDLE;
+    }
+
+    if(mesh.index16Handle != GeometryHeap::INVALID_HANDLE)
+    {
+        m_index16Heap.free(mesh.index16Handle);
+        mesh.index16Handle = GeometryHeap::INVALID_HANDLE;
+    }
+
+    if(mesh.meshletHandle != GeometryHeap::INVALID_HANDLE)
+    {
+        m_meshletHeap.free(mesh.meshletHandle);
+        mesh.meshletHandle = GeometryHeap::INVALID_HANDLE;
+    }
+}
+
+void engine::MeshLibrary::buildFromGameAsset(Mesh& inout,const std::string& gameName)
+{
+    PrefetchMesh prefetch {};
+    CHECK(decodeGameAsset(gameName,prefetch));
+
+    buildFromPrefetch(inout,prefetch);
+}
+
+void engine::MeshLibrary::insertMesh(const std::string& gameName,Mesh* mesh)
+{
+    std::lock_guard lock(m_prefetchMutex);
+    m_meshContainer[gameName] = mesh;
+}
+
+uint64 engine::MeshLibrary::prefetchMesh(const std::string& gameName,std::vector<std::string>* outMaterials)
+{
+    if(gameName == "" || gameName == toString(EPrimitiveMesh::Box) || !FileSystem::endWith(gameName,".mesh"))
+    {
+        return 0;
+    }
+
+    {
+        std::lock_guard lock(m_prefetchMutex);
+        if(m_meshContainer.find(gameName) != m_meshContainer.end() || 
+           m_prefetchMeshes.find(gameName) != m_prefetchMeshes.end())
+        {
+            return 0;
+        }
+    }
 
-    uint32 lastMeshVertexIndex = lastMeshVerticesPos / getStandardMeshAttributesVertexCount();
-    std::for_each(std::execution::par_unseq,indicesData.begin(),indicesData.end(), [lastMeshVertexIndex](auto&& index)
+    auto prefetch = std::make_unique<PrefetchMesh>();
+    if(!decodeGameAsset(gameName,*prefetch))
     {
-        index = index + lastMeshVertexIndex;
-    });
+        LOG_WARN("Fail to prefetch mesh {0}.",gameName);
+        return 0;
+    }
+
+    if(outMaterials)
+    {
+        for(const auto& subMesh : prefetch->subMeshes)
+        {
+            if(subMesh.materialInfoPath != "") outMaterials->push_back(subMesh.materialInfoPath);
+        }
+    }
+
+    const uint64 byteSize = prefetch->getByteSize();
+
+    std::lock_guard lock(m_prefetchMutex);
+    m_prefetchMeshes.emplace(gameName,std::move(prefetch));
+    return byteSize;
+}
 
-    // 3. ƴӵԭ
-    m_cacheVerticesData.insert(m_cacheVerticesData.end(),verticesData.begin(),verticesData.end());
-    m_cacheIndicesData.insert(m_cacheIndicesData.end(),indicesData.begin(),indicesData.end());
+void engine::MeshLibrary::flushPrefetchMeshes()
+{
+    std::unordered_map<std::string,std::unique_ptr<PrefetchMesh>> prefetchMeshes;
+    {
+        std::lock_guard lock(m_prefetchMutex);
+        prefetchMeshes.swap(m_prefetchMeshes);
+    }
+
+    for(auto& [name,prefetch] : prefetchMeshes)
+    {
+        if(m_meshContainer.find(name) != m_meshContainer.end())
+        {
+            continue;
+        }
+
+        Mesh* newMesh = new Mesh();
+        buildFromPrefetch(*newMesh,*prefetch);
+        insertMesh(name,newMesh);
+    }
 }
 
 Mesh& engine::MeshLibrary::getUnitBox()
@@ -174,7 +359,7 @@ Mesh& engine::MeshLibrary::getUnitBox()
     else
     {
         Mesh* newMesh = new Mesh();
-        m_meshContainer[s_engineMeshBox] = newMesh;
+        insertMesh(s_engineMeshBox,newMesh);
         buildFromGameAsset(*newMesh,s_engineMeshBox);
         return *newMesh;
     }
@@ -194,9 +379,28 @@ Mesh& engine::MeshLibrary::getMeshByName(const std::string& gameName)
     {
         CHECK(FileSystem::endWith(gameName,".mesh"));
 
+        // NOTE: Ѿڼֻ߳̽Ҫƴ
+        std::unique_ptr<PrefetchMesh> prefetch = nullptr;
+        {
+            std::lock_guard lock(m_prefetchMutex);
+            auto it = m_prefetchMeshes.find(gameName);
+            if(it != m_prefetchMeshes.end())
+            {
+                prefetch = std::move(it->second);
+                m_prefetchMeshes.erase(it);
+            }
+        }
+
         Mesh* newMesh = new Mesh();
-        m_meshContainer[gameName] = newMesh;
-        buildFromGameAsset(*newMesh,gameName);
+        insertMesh(gameName,newMesh);
+        if(prefetch)
+        {
+            buildFromPrefetch(*newMesh,*prefetch);
+        }
+        else
+        {
+            buildFromGameAsset(*newMesh,gameName);
+        }
 
         return *newMesh;
     }
@@ -204,30 +408,44 @@ Mesh& engine::MeshLibrary::getMeshByName(const std::string& gameName)
 
 void engine::MeshLibrary::init()
 {
-    CHECK(m_indexBuffer == nullptr);
-    CHECK(m_vertexBuffer == nullptr);
-
     VkDeviceSize baseVertexBufferSize = static_cast<VkDeviceSize>(cVarBaseVRamForVertexBuffer.get()) * 1024 * 1024;
     VkDeviceSize baseIndexBufferSize  = static_cast<VkDeviceSize>(cVarBaseVRamForIndexBuffer.get())  * 1024 * 1024;
+    VkDeviceSize incrementVertexBufferSize = static_cast<VkDeviceSize>(cVarVertexBufferIncrementSize.get()) * 1024 * 1024;
+    VkDeviceSize incrementIndexBufferSize  = static_cast<VkDeviceSize>(cVarIndexBufferIncrementSize.get())  * 1024 * 1024;
 
-    // NOTE: ʵ1024 * 1024 
-    m_cacheVerticesData.reserve(1024 * 1024);
-    m_cacheIndicesData.reserve(1024 * 1024);
+    // NOTE: Storage usage is kept for the triangle culling in compute shaders.
+    m_vertexHeap.init(
+        "vertex",
+        sizeof(PackedMeshVertex),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        baseVertexBufferSize,
+        incrementVertexBufferSize
+    );
 
-    m_indexBuffer = VulkanIndexBuffer::create(
-        VulkanRHI::get()->getVulkanDevice(),
+    m_indexHeap.init(
+        "index",
+        sizeof(VertexIndexType),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         baseIndexBufferSize,
-        VulkanRHI::get()->getGraphicsCommandPool(),
-        true,
-        true
+        incrementIndexBufferSize
     );
 
-    m_vertexBuffer = VulkanVertexBuffer::create(
-        VulkanRHI::get()->getVulkanDevice(),
-        VulkanRHI::get()->getGraphicsCommandPool(),
-        baseVertexBufferSize,
-		true,
-		true
+    // NOTE: Most submeshes fit 16 bit indices, the 32 bit heap only keeps the large ones.
+    m_index16Heap.init(
+        "index16",
+        sizeof(uint16),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        baseIndexBufferSize,
+        incrementIndexBufferSize
+    );
+
+    // NOTE: One meshlet of 48 bytes covers ~100 triangles, a fraction of the index memory is plenty.
+    m_meshletHeap.init(
+        "meshlet",
+        sizeof(Meshlet),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        baseIndexBufferSize / 8,
+        incrementIndexBufferSize / 8
     );
 
     // NOTE: ȼBoxΪع
@@ -242,28 +460,33 @@ void engine::MeshLibrary::release()
     }
 
     m_meshContainer.clear();
+    m_prefetchMeshes.clear();
 
-    if(m_indexBuffer)
-    {
-        delete m_indexBuffer;
-        m_indexBuffer = nullptr;
-    }
-   
-    if(m_vertexBuffer)
-    {
-        delete m_vertexBuffer;
-        m_vertexBuffer = nullptr;
-    }
+    m_vertexHeap.release();
+    m_indexHeap.release();
+    m_index16Heap.release();
+    m_meshletHeap.release();
 }
 
+// NOTE: Growth replaces the heap buffers, bind them again every frame.
 void engine::MeshLibrary::bindVertexBuffer(VkCommandBuffer cmd)
 {
-    m_vertexBuffer->bind(cmd);
+    VkBuffer buffer = m_vertexHeap.getBuffer();
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd,0,1,&buffer,&offset);
 }
 
-void engine::MeshLibrary::bindIndexBuffer(VkCommandBuffer cmd)
+void engine::MeshLibrary::bindIndexBuffer(VkCommandBuffer cmd,bool bIndex16)
 {
-    m_indexBuffer->bind(cmd);
+    static_assert(sizeof(VertexIndexType) == sizeof(uint32));
+    if(bIndex16)
+    {
+        vkCmdBindIndexBuffer(cmd,m_index16Heap.getBuffer(),0,VK_INDEX_TYPE_UINT16);
+    }
+    else
+    {
+        vkCmdBindIndexBuffer(cmd,m_indexHeap.getBuffer(),0,VK_INDEX_TYPE_UINT32);
+    }
 }
 
 const std::unordered_set<std::string>& engine::MeshLibrary::getStaticMeshList() const
@@ -279,118 +502,71 @@ void engine::MeshLibrary::emplaceStaticeMeshList(const std::string& name)
 bool engine::MeshLibrary::MeshReady(const Mesh& in) const
 {
     if(in.vertexCount <= 0) return false;
-    if(in.indexCount <= 0) return false;
+    if(in.indexCount + in.index16Count <= 0) return false;
 
-    if(in.vertexStartPosition < m_lastUploadVertexBufferPos &&
-        in.indexStartPosition < m_lastUploadIndexBufferPos)
-    {
-        return true;
-    }
-
-    return false;
+    return m_vertexHeap.isResident(in.vertexHandle) && 
+        (in.indexCount == 0 || m_indexHeap.isResident(in.indexHandle)) &&
+        (in.index16Count == 0 || m_index16Heap.isResident(in.index16Handle)) &&
+        (in.meshletCount == 0 || m_meshletHeap.isResident(in.meshletHandle));
 }
 
-void engine::MeshLibrary::uploadAppendBuffer()
+bool engine::MeshLibrary::unloadMesh(const std::string& gameName)
 {
-    VkDeviceSize incrementVertexBufferSize = static_cast<VkDeviceSize>(cVarVertexBufferIncrementSize.get()) * 1024 * 1024;
-    VkDeviceSize incrementIndexBufferSize  = static_cast<VkDeviceSize>(cVarIndexBufferIncrementSize.get())  * 1024 * 1024;
-
-    if(m_lastUploadVertexBufferPos != (uint32)m_cacheVerticesData.size())
+    if(gameName == s_engineMeshBox)
     {
-        uint32 upLoadStartPos = m_lastUploadVertexBufferPos;
-        uint32 upLoadEndPos = (uint32)m_cacheVerticesData.size();
-        uint64 perElemtSize = sizeof(m_cacheVerticesData[0]);
-        m_lastUploadVertexBufferPos = upLoadEndPos;
-
-        VkDeviceSize currentVertexDataDeviceSize = VkDeviceSize(perElemtSize * m_cacheVerticesData.size());
-        VkDeviceSize lastDeviceSize = m_vertexBuffer->getVulkanBuffer()->getSize();
+        return false;
+    }
 
-        // NOTE: ˷ΧҪ벢ˢ
-        if(currentVertexDataDeviceSize >= lastDeviceSize)
+    Mesh* mesh = nullptr;
+    {
+        std::lock_guard lock(m_prefetchMutex);
+        auto it = m_meshContainer.find(gameName);
+        if(it == m_meshContainer.end())
         {
-            VkDeviceSize newDeviceSize = ((currentVertexDataDeviceSize / incrementVertexBufferSize) + 2) * incrementVertexBufferSize;
-
-            LOG_INFO("Reallocate {0} mb local vram for vertex buffer!", newDeviceSize / (1024 * 1024));
-           
-            vkQueueWaitIdle(VulkanRHI::get()->getVulkanDevice()->graphicsQueue);
-            delete m_vertexBuffer;
-
-            m_vertexBuffer = VulkanVertexBuffer::create(
-                VulkanRHI::get()->getVulkanDevice(),
-                VulkanRHI::get()->getGraphicsCommandPool(),
-                newDeviceSize,
-                true,
-                true // TODO: δǽComputeShader޳ÿһΣ
-            );
-
-            upLoadStartPos = 0; // NOTE: Ҫȫϴһ
+            return false;
         }
 
-        CHECK(upLoadEndPos > upLoadStartPos);
-        VkDeviceSize uploadDeviceSize = VkDeviceSize(perElemtSize * (upLoadEndPos - upLoadStartPos));
-        VkDeviceSize offsetDeviceSize = VkDeviceSize(perElemtSize * upLoadStartPos);
-
-        VulkanBuffer* stageBuffer = VulkanBuffer::create(
-            VulkanRHI::get()->getVulkanDevice(),
-            VulkanRHI::get()->getGraphicsCommandPool(),
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-            VMA_MEMORY_USAGE_CPU_TO_GPU,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            uploadDeviceSize,
-            (void *)(m_cacheVerticesData.data() + upLoadStartPos)
-        );
-
-        m_vertexBuffer->getVulkanBuffer()->stageCopyFrom(*stageBuffer, uploadDeviceSize,VulkanRHI::get()->getVulkanDevice()->graphicsQueue, 0, offsetDeviceSize);
-        delete stageBuffer;
+        mesh = it->second;
+        m_meshContainer.erase(it);
     }
 
-    if(m_lastUploadIndexBufferPos != (uint32)m_cacheIndicesData.size())
-    {
-        uint32 upLoadStartPos = m_lastUploadIndexBufferPos;
-        uint32 upLoadEndPos = (uint32)m_cacheIndicesData.size();
-        m_lastUploadIndexBufferPos = upLoadEndPos;
-        uint64 perElemtSize = sizeof(m_cacheIndicesData[0]);
-
-        VkDeviceSize currentIndexDataDeviceSize = VkDeviceSize(perElemtSize * m_cacheIndicesData.size());
-        VkDeviceSize lastDeviceSize = m_indexBuffer->getVulkanBuffer()->getSize();
+    releaseMeshGeometry(*mesh);
+    delete mesh;
+    return true;
+}
 
-        // NOTE: ˷ΧҪ벢ˢ
-        if(currentIndexDataDeviceSize >= lastDeviceSize)
+uint32 engine::MeshLibrary::unloadUnusedMeshes(const std::unordered_set<std::string>& usedMeshes)
+{
+    std::vector<std::string> unusedMeshes;
+    for(const auto& [name,mesh] : m_meshContainer)
+    {
+        if(name != s_engineMeshBox && usedMeshes.find(name) == usedMeshes.end())
         {
-            VkDeviceSize newDeviceSize = ((currentIndexDataDeviceSize / incrementIndexBufferSize) + 2) * incrementIndexBufferSize;
-            delete m_indexBuffer;
-
-            LOG_INFO("Reallocate {0} mb local vram for index buffer!", newDeviceSize / (1024 * 1024));
-            vkQueueWaitIdle(VulkanRHI::get()->getVulkanDevice()->graphicsQueue);
-
+            unusedMeshes.push_back(name);
+        }
+    }
 
+    for(const auto& name : unusedMeshes)
+    {
+        unloadMesh(name);
+    }
+    return (uint32)unusedMeshes.size();
+}
 
-            m_indexBuffer = VulkanIndexBuffer::create(
-                VulkanRHI::get()->getVulkanDevice(),
-                newDeviceSize,
-                VulkanRHI::get()->getGraphicsCommandPool(),
-				true,
-                true // TODO: δǽComputeShader޳ÿһΣ
-            );
+// NOTE: Uploads, growth and compaction of the heaps are submitted here without waiting,
+//       compaction moves show up in the mesh positions before anything of this frame draws.
+void engine::MeshLibrary::tickGeometryHeaps()
+{
+    const bool bVertexMoved = m_vertexHeap.tick();
+    const bool bIndexMoved = m_indexHeap.tick();
+    const bool bIndex16Moved = m_index16Heap.tick();
+    const bool bMeshletMoved = m_meshletHeap.tick();
 
-            upLoadStartPos = 0; // NOTE: Ҫȫϴһ
+    if(bVertexMoved || bIndexMoved || bIndex16Moved || bMeshletMoved)
+    {
+        for(auto& [name,mesh] : m_meshContainer)
+        {
+            refreshMeshPosition(*mesh);
         }
-
-        CHECK(upLoadEndPos > upLoadStartPos);
-        VkDeviceSize uploadDeviceSize = VkDeviceSize(perElemtSize * (upLoadEndPos - upLoadStartPos));
-        VkDeviceSize offsetDeviceSize = VkDeviceSize(perElemtSize * upLoadStartPos);
-
-        VulkanBuffer* stageBuffer = VulkanBuffer::create(
-            VulkanRHI::get()->getVulkanDevice(),
-            VulkanRHI::get()->getGraphicsCommandPool(),
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-            VMA_MEMORY_USAGE_CPU_TO_GPU,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            uploadDeviceSize,
-            (void *)(m_cacheIndicesData.data() + upLoadStartPos)
-        );
-
-        m_indexBuffer->getVulkanBuffer()->stageCopyFrom(*stageBuffer, uploadDeviceSize,VulkanRHI::get()->getVulkanDevice()->graphicsQueue, 0, offsetDeviceSize);
-        delete stageBuffer;
     }
-}
\ No newline at end of file
+}
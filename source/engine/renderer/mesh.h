@@ -1,7 +1,12 @@
 #pragma once
 #include "../core/core.h"
 #include "../vk/vk_rhi.h"
+#include "geometry_heap.h"
+#include "meshlet.h"
+#include "mesh_lod.h"
 #include <unordered_set>
+#include <mutex>
+#include <array>
 namespace engine{
 
 namespace asset_system
@@ -26,8 +31,21 @@ struct SubMesh
 {
     RenderBounds renderBounds;
 
+    // NOTE: Index start is relative to the index stream of its width, indices are relative to
+    //       the base vertex which is relative to the first vertex of the mesh.
     uint32 indexStartPosition;
     uint32 indexCount;
+    uint32 baseVertex = 0;
+    bool bIndex16 = false;
+
+    // Relative to the first meshlet of the mesh, zero count for meshes baked without meshlets.
+    uint32 meshletStart = 0;
+    uint32 meshletCount = 0;
+
+    // NOTE: lods[0] is the full level over indexCount, meshlets only cover it. Meshes baked without
+    //       lods have just that one.
+    uint32 lodCount = 1;
+    std::array<MeshLod,MESH_MAX_LOD_COUNT> lods = {};
 
     Ref<Material> cacheMaterial = nullptr;
     std::string materialInfoPath;
@@ -37,8 +55,16 @@ struct RenderSubMesh
 {
     RenderBounds renderBounds;
 
-    uint32 indexStartPosition;
+    uint32 indexStartPosition; // absolute in the index heap of its width.
     uint32 indexCount;
+    uint32 vertexOffset;       // base vertex of the submesh in the vertex heap, indices are relative to it.
+    bool bIndex16 = false;
+
+    uint32 meshletStart = 0;   // absolute in the meshlet heap.
+    uint32 meshletCount = 0;
+
+    uint32 lodCount = 1;       // lod index ranges relative to indexStartPosition.
+    std::array<MeshLod,MESH_MAX_LOD_COUNT> lods = {};
 
     Ref<Material> cacheMaterial = nullptr;
     bool bCullingResult = true;
@@ -62,6 +88,28 @@ inline uint32 getStandardMeshAttributesVertexCount()
     return 3 + 2 + 3 + 4;
 }
 
+// NOTE: Gpu layout of static mesh vertices, quantized at bake time from the standard layout.
+//       Position is unorm inside the render bounds of its submesh and w holds the bitangent sign (0 or 65535),
+//       normal and tangent are octahedral snorm. Decoded in common_mesh.glsl.
+struct PackedMeshVertex
+{
+    uint16 position[4];
+    uint16 uv0[2];   // half
+    int16 normal[2];
+    int16 tangent[2];
+};
+static_assert(sizeof(PackedMeshVertex) == 20);
+
+inline std::vector<EVertexAttribute> getPackedMeshAttributes()
+{
+    return std::vector<EVertexAttribute>{
+        EVertexAttribute::packedPos,
+        EVertexAttribute::packedUv0,
+        EVertexAttribute::packedNormal,
+        EVertexAttribute::packedTangent
+    };
+}
+
 enum class EPrimitiveMesh
 {
     Min = 0,
@@ -99,14 +147,56 @@ inline void loopPrimitiveType(std::function<void(std::string,EPrimitiveMesh)>&&
 
 struct Mesh
 {
-    std::vector<SubMesh> subMeshes;
+    std::vector<SubMesh> subMeshes; // index start relative to the mesh.
     std::vector<EVertexAttribute> layout;
 
+    // NOTE: Positions in the geometry heaps in elements, refreshed when compaction moves the mesh.
+    //       Submeshes which reach less than 65536 vertices use the 16 bit index heap.
     uint32 vertexStartPosition;
     uint32 vertexCount;
 
     uint32 indexStartPosition;
     uint32 indexCount;
+
+    uint32 index16StartPosition;
+    uint32 index16Count;
+
+    uint32 meshletStartPosition = 0;
+    uint32 meshletCount = 0;
+
+    GeometryHeap::Handle vertexHandle = GeometryHeap::INVALID_HANDLE;
+    GeometryHeap::Handle indexHandle = GeometryHeap::INVALID_HANDLE;
+    GeometryHeap::Handle index16Handle = GeometryHeap::INVALID_HANDLE;
+    GeometryHeap::Handle meshletHandle = GeometryHeap::INVALID_HANDLE;
+
+    // Cpu copy of the uploaded data, only kept with r.Mesh.CpuMirror.
+    std::vector<PackedMeshVertex> verticesData;
+    std::vector<VertexIndexType> indicesData;
+    std::vector<uint16> indices16Data;
+    std::vector<Meshlet> meshletsData;
+
+    uint64 getByteSize() const
+    {
+        return uint64(vertexCount) * sizeof(PackedMeshVertex) + uint64(indexCount) * sizeof(VertexIndexType) + uint64(index16Count) * sizeof(uint16) +
+            uint64(meshletCount) * sizeof(Meshlet);
+    }
+};
+
+// NOTE: Mesh asset decoded on a loading thread, appended to the library on the main thread.
+struct PrefetchMesh
+{
+    std::vector<EVertexAttribute> layout;
+    std::vector<SubMesh> subMeshes; // index start relative to the mesh, material not resolved.
+    std::vector<PackedMeshVertex> verticesData;
+    std::vector<VertexIndexType> indicesData;
+    std::vector<uint16> indices16Data;
+    std::vector<Meshlet> meshletsData;
+
+    uint64 getByteSize() const
+    {
+        return verticesData.size() * sizeof(PackedMeshVertex) + indicesData.size() * sizeof(VertexIndexType) + indices16Data.size() * sizeof(uint16) +
+            meshletsData.size() * sizeof(Meshlet);
+    }
 };
 
 struct RenderMeshPack
@@ -126,24 +216,29 @@ private:
     std::unordered_set<std::string> m_staticMeshList;
     MeshContainer m_meshContainer;
 
-    // NOTE: е񶥵
-    //       ǰĲΪһؾͲͷֱȷ˳
-    // TODO: Ҫʱٻʽ
-    std::vector<VertexIndexType> m_cacheIndicesData = {};
-    std::vector<float> m_cacheVerticesData = {};
+    // NOTE: Every mesh owns one range of each heap and gives it back when it is unloaded.
+    GeometryHeap m_vertexHeap;
+    GeometryHeap m_indexHeap;
+    GeometryHeap m_index16Heap;
+
+    // Meshlet bounds and cones read by the cluster culling, see Meshlet.
+    GeometryHeap m_meshletHeap;
 
-    VulkanIndexBuffer* m_indexBuffer = nullptr;
-    VulkanVertexBuffer* m_vertexBuffer = nullptr;
+    // NOTE: Guard the container writes and the prefetch queue, loading threads only read under this lock.
+    std::mutex m_prefetchMutex;
+    std::unordered_map<std::string,std::unique_ptr<PrefetchMesh>> m_prefetchMeshes;
 
 private:
     void buildFromGameAsset(Mesh& inout,const std::string& gameName);
+    void buildFromPrefetch(Mesh& inout,PrefetchMesh& prefetch);
+    void insertMesh(const std::string& gameName,Mesh* mesh);
+    static bool decodeGameAsset(const std::string& gameName,PrefetchMesh& out);
+    void refreshMeshPosition(Mesh& mesh);
+    void releaseMeshGeometry(Mesh& mesh);
 
 private: // upload gpu
-    uint32 m_lastUploadVertexBufferPos = 0;
-    uint32 m_lastUploadIndexBufferPos = 0;
-
     // ÿ֡TickʱAssetSystem
-    void uploadAppendBuffer();
+    void tickGeometryHeaps();
 
 public:
     Mesh& getUnitBox();
@@ -154,12 +249,33 @@ public:
 
     static MeshLibrary* get() { return s_meshLibrary; }
     void bindVertexBuffer(VkCommandBuffer cmd);
-    void bindIndexBuffer(VkCommandBuffer cmd);
+    void bindIndexBuffer(VkCommandBuffer cmd,bool bIndex16 = false);
+    VkBuffer getMeshletBuffer() const { return m_meshletHeap.getBuffer(); }
 
     const std::unordered_set<std::string>& getStaticMeshList() const;
     void emplaceStaticeMeshList(const std::string& name);
 
     bool MeshReady(const Mesh& in) const;
+
+    // NOTE: Thread safe. Decode the mesh asset on the calling thread so the first
+    //       getMeshByName only appends the data. Returns the decoded byte size, 0 if
+    //       the mesh is already built, prefetched or invalid.
+    uint64 prefetchMesh(const std::string& gameName,std::vector<std::string>* outMaterials = nullptr);
+
+    // NOTE: Main thread. Append every prefetched mesh, they are uploaded on the next AssetSystem tick.
+    void flushPrefetchMeshes();
+
+    // NOTE: Main thread. Drop the mesh and give its heap ranges back, the next getMeshByName loads it again.
+    //       The unit box is the fallback mesh and never unloaded.
+    bool unloadMesh(const std::string& gameName);
+
+    // Unload every mesh not in usedMeshes, returns the unloaded count.
+    uint32 unloadUnusedMeshes(const std::unordered_set<std::string>& usedMeshes);
+
+    GeometryHeap::Stats getVertexHeapStats() const { return m_vertexHeap.getStats(); }
+    GeometryHeap::Stats getIndexHeapStats() const { return m_indexHeap.getStats(); }
+    GeometryHeap::Stats getIndex16HeapStats() const { return m_index16Heap.getStats(); }
+    GeometryHeap::Stats getMeshletHeapStats() const { return m_meshletHeap.getStats(); }
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,655 @@
+#include "mesh_lod.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace engine{
+
+// NOTE: Smallest level worth simplifying, the chain stops below it.
+constexpr uint32 kMinLodTriangles = 64;
+
+// NOTE: A level has to drop at least a quarter of the triangles of the level before.
+constexpr float kMinLodReduction = 0.75f;
+
+// NOTE: Quadric error limit of the chain relative to the submesh radius, collapses past it are skipped.
+constexpr float kMaxLodError = 0.1f;
+
+namespace
+{
+    // Area weighted planes of the triangles around a vertex.
+    struct Quadric
+    {
+        double a00 = 0.0, a11 = 0.0, a22 = 0.0;
+        double a01 = 0.0, a02 = 0.0, a12 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+        double c = 0.0;
+        double weight = 0.0;
+
+        // n is unit length, the plane is dot(n,p) + d = 0.
+        void addPlane(const glm::dvec3& n,double d,double w)
+        {
+            a00 += w * n.x * n.x; a11 += w * n.y * n.y; a22 += w * n.z * n.z;
+            a01 += w * n.x * n.y; a02 += w * n.x * n.z; a12 += w * n.y * n.z;
+            b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric& o)
+        {
+            a00 += o.a00; a11 += o.a11; a22 += o.a22;
+            a01 += o.a01; a02 += o.a02; a12 += o.a12;
+            b0 += o.b0; b1 += o.b1; b2 += o.b2;
+            c += o.c;
+            weight += o.weight;
+        }
+
+        // Mean squared distance of p to the planes.
+        double evaluate(const glm::dvec3& p) const
+        {
+            if(weight <= 0.0)
+            {
+                return 0.0;
+            }
+
+            const double r =
+                a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+                2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+                2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return std::max(r,0.0) / weight;
+        }
+    };
+
+    struct PositionKey
+    {
+        uint32 x,y,z;
+
+        bool operator==(const PositionKey& o) const
+        {
+            return x == o.x && y == o.y && z == o.z;
+        }
+    };
+
+    struct PositionKeyHash
+    {
+        size_t operator()(const PositionKey& k) const
+        {
+            return (size_t(k.x) * 73856093u) ^ (size_t(k.y) * 19349663u) ^ (size_t(k.z) * 83492791u);
+        }
+    };
+
+    PositionKey makePositionKey(const float* p)
+    {
+        // Adding zero folds -0 into +0.
+        const float x = p[0] + 0.0f;
+        const float y = p[1] + 0.0f;
+        const float z = p[2] + 0.0f;
+
+        PositionKey key { };
+        memcpy(&key.x,&x,sizeof(float));
+        memcpy(&key.y,&y,sizeof(float));
+        memcpy(&key.z,&z,sizeof(float));
+        return key;
+    }
+
+    struct Collapse
+    {
+        double cost;
+        uint32 from;
+        uint32 to;
+
+        bool operator<(const Collapse& o) const
+        {
+            if(cost != o.cost) return cost < o.cost;
+            if(from != o.from) return from < o.from;
+            return to < o.to;
+        }
+    };
+}
+
+float simplifyMesh(
+    const float* positions,
+    uint32 positionStride,
+    uint32 vertexCount,
+    const uint32* indices,
+    uint32 indexCount,
+    uint32 targetIndexCount,
+    float maxError,
+    std::vector<uint32>& outIndices)
+{
+    CHECK(indexCount % 3 == 0);
+
+    outIndices.assign(indices,indices + indexCount);
+    if(indexCount <= targetIndexCount)
+    {
+        return 0.0f;
+    }
+
+    const auto position = [&](uint32 v)
+    {
+        const float* p = positions + size_t(v) * positionStride;
+        return glm::dvec3(p[0],p[1],p[2]);
+    };
+
+    // 1. Vertices at one position share a welded id and its quadric.
+    std::vector<uint32> remap(vertexCount);
+    {
+        std::unordered_map<PositionKey,uint32,PositionKeyHash> firstVertex;
+        firstVertex.reserve(vertexCount);
+        for(uint32 v = 0; v < vertexCount; v++)
+        {
+            remap[v] = firstVertex.emplace(makePositionKey(positions + size_t(v) * positionStride),v).first->second;
+        }
+    }
+
+    // 2. Lock attribute seams, more than one referenced vertex at a position, and open borders,
+    //    an edge without the opposite one. Both would tear the surface apart when moved.
+    std::vector<bool> locked(vertexCount,false);
+    {
+        std::vector<uint32> referencedCount(vertexCount,0);
+        std::vector<bool> referenced(vertexCount,false);
+        for(uint32 i = 0; i < indexCount; i++)
+        {
+            CHECK(indices[i] < vertexCount);
+            if(!referenced[indices[i]])
+            {
+                referenced[indices[i]] = true;
+                referencedCount[remap[indices[i]]] ++;
+            }
+        }
+
+        for(uint32 v = 0; v < vertexCount; v++)
+        {
+            locked[v] = referencedCount[v] > 1;
+        }
+
+        std::unordered_set<uint64> edges;
+        edges.reserve(indexCount);
+        for(uint32 i = 0; i < indexCount; i += 3)
+        {
+            for(uint32 k = 0; k < 3; k++)
+            {
+                const uint64 a = remap[indices[i + k]];
+                const uint64 b = remap[indices[i + (k + 1) % 3]];
+                edges.insert((a << 32) | b);
+            }
+        }
+
+        for(uint32 i = 0; i < indexCount; i += 3)
+        {
+            for(uint32 k = 0; k < 3; k++)
+            {
+                const uint64 a = remap[indices[i + k]];
+                const uint64 b = remap[indices[i + (k + 1) % 3]];
+                if(edges.find((b << 32) | a) == edges.end())
+                {
+                    locked[a] = true;
+                    locked[b] = true;
+                }
+            }
+        }
+    }
+
+    // 3. Planes of the full level, collapses add up the quadrics so the error stays against it.
+    std::vector<Quadric> quadrics(vertexCount);
+    for(uint32 i = 0; i < indexCount; i += 3)
+    {
+        const glm::dvec3 p0 = position(indices[i + 0]);
+        const glm::dvec3 p1 = position(indices[i + 1]);
+        const glm::dvec3 p2 = position(indices[i + 2]);
+
+        const glm::dvec3 n = glm::cross(p1 - p0,p2 - p0);
+        const double length = glm::length(n);
+        if(length <= 0.0)
+        {
+            continue;
+        }
+
+        const glm::dvec3 normal = n / length;
+        const double d = -glm::dot(normal,p0);
+        for(uint32 k = 0; k < 3; k++)
+        {
+            quadrics[remap[indices[i + k]]].addPlane(normal,d,length * 0.5);
+        }
+    }
+
+    const double maxErrorSq = double(maxError) * double(maxError);
+    double resultErrorSq = 0.0;
+
+    std::vector<uint32> adjacencyOffsets;
+    std::vector<uint32> adjacency;
+    std::vector<uint32> adjacencyFill;
+    std::vector<Collapse> candidates;
+    std::vector<Collapse> accepted;
+    std::vector<uint32> collapseTarget(vertexCount);
+    std::vector<bool> touched(vertexCount);
+
+    // NOTE: Every pass collapses the cheapest edges whose one rings do not overlap, so the flip test
+    //       of a collapse sees the final neighbourhood.
+    while(outIndices.size() > targetIndexCount)
+    {
+        const uint32 triangleCount = uint32(outIndices.size() / 3);
+
+        adjacencyOffsets.assign(size_t(vertexCount) + 1,0);
+        for(uint32 index : outIndices)
+        {
+            adjacencyOffsets[index + 1] ++;
+        }
+        for(uint32 v = 0; v < vertexCount; v++)
+        {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+
+        adjacency.resize(outIndices.size());
+        adjacencyFill.assign(adjacencyOffsets.begin(),adjacencyOffsets.end() - 1);
+        for(uint32 t = 0; t < triangleCount; t++)
+        {
+            for(uint32 k = 0; k < 3; k++)
+            {
+                adjacency[adjacencyFill[outIndices[t * 3 + k]] ++] = t;
+            }
+        }
+
+        candidates.clear();
+        for(uint32 t = 0; t < triangleCount; t++)
+        {
+            for(uint32 k = 0; k < 3; k++)
+            {
+                const uint32 a = outIndices[t * 3 + k];
+                const uint32 b = outIndices[t * 3 + (k + 1) % 3];
+                if(remap[a] == remap[b])
+                {
+                    continue;
+                }
+
+                for(const auto& [from,to] : { std::make_pair(a,b),std::make_pair(b,a) })
+                {
+                    if(locked[remap[from]])
+                    {
+                        continue;
+                    }
+
+                    Quadric q = quadrics[remap[from]];
+                    q.add(quadrics[remap[to]]);
+                    const double cost = q.evaluate(position(to));
+                    if(cost <= maxErrorSq)
+                    {
+                        candidates.push_back({ cost,from,to });
+                    }
+                }
+            }
+        }
+
+        if(candidates.empty())
+        {
+            break;
+        }
+        std::sort(candidates.begin(),candidates.end());
+
+        // A triangle must not turn around when from moves onto to.
+        const auto flips = [&](uint32 from,uint32 to)
+        {
+            const glm::dvec3 target = position(to);
+            for(uint32 i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; i++)
+            {
+                const uint32* triangle = &outIndices[size_t(adjacency[i]) * 3];
+                if(remap[triangle[0]] == remap[to] || remap[triangle[1]] == remap[to] || remap[triangle[2]] == remap[to])
+                {
+                    continue; // collapses to nothing.
+                }
+
+                glm::dvec3 p[3] = { position(triangle[0]),position(triangle[1]),position(triangle[2]) };
+                const glm::dvec3 before = glm::cross(p[1] - p[0],p[2] - p[0]);
+                for(uint32 k = 0; k < 3; k++)
+                {
+                    if(triangle[k] == from) p[k] = target;
+                }
+
+                const glm::dvec3 after = glm::cross(p[1] - p[0],p[2] - p[0]);
+                if(glm::dot(before,after) <= 0.0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        for(uint32 v = 0; v < vertexCount; v++)
+        {
+            collapseTarget[v] = v;
+        }
+        std::fill(touched.begin(),touched.end(),false);
+        accepted.clear();
+
+        const uint32 removeGoal = glm::max(uint32(outIndices.size() - targetIndexCount) / 3,1u);
+        uint32 removedCount = 0;
+        for(const auto& candidate : candidates)
+        {
+            if(touched[candidate.from] || collapseTarget[candidate.to] != candidate.to)
+            {
+                continue;
+            }
+
+            if(flips(candidate.from,candidate.to))
+            {
+                continue;
+            }
+
+            collapseTarget[candidate.from] = candidate.to;
+            accepted.push_back(candidate);
+
+            for(uint32 i = adjacencyOffsets[candidate.from]; i < adjacencyOffsets[candidate.from + 1]; i++)
+            {
+                const uint32* triangle = &outIndices[size_t(adjacency[i]) * 3];
+                bool bRemoved = false;
+                for(uint32 k = 0; k < 3; k++)
+                {
+                    touched[triangle[k]] = true;
+                    bRemoved |= remap[triangle[k]] == remap[candidate.to];
+                }
+                removedCount += bRemoved ? 1 : 0;
+            }
+
+            if(removedCount >= removeGoal)
+            {
+                break;
+            }
+        }
+
+        if(accepted.empty())
+        {
+            break;
+        }
+
+        for(const auto& collapse : accepted)
+        {
+            quadrics[remap[collapse.to]].add(quadrics[remap[collapse.from]]);
+            resultErrorSq = std::max(resultErrorSq,collapse.cost);
+        }
+
+        size_t writeIndex = 0;
+        for(size_t i = 0; i < outIndices.size(); i += 3)
+        {
+            const uint32 a = collapseTarget[outIndices[i + 0]];
+            const uint32 b = collapseTarget[outIndices[i + 1]];
+            const uint32 c = collapseTarget[outIndices[i + 2]];
+            if(remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+            {
+                continue;
+            }
+
+            outIndices[writeIndex ++] = a;
+            outIndices[writeIndex ++] = b;
+            outIndices[writeIndex ++] = c;
+        }
+
+        if(writeIndex == outIndices.size())
+        {
+            break;
+        }
+        outIndices.resize(writeIndex);
+    }
+
+    return float(std::sqrt(resultErrorSq));
+}
+
+void buildMeshLods(
+    const float* positions,
+    uint32 positionStride,
+    uint32 vertexCount,
+    std::vector<uint32>& indices,
+    std::vector<MeshLod>& outLods,
+    uint32 maxLodCount)
+{
+    CHECK(indices.size() % 3 == 0);
+    CHECK(maxLodCount >= 1 && maxLodCount <= MESH_MAX_LOD_COUNT);
+
+    outLods.clear();
+
+    MeshLod fullLod { };
+    fullLod.indexCount = (uint32)indices.size();
+    outLods.push_back(fullLod);
+
+    if(indices.size() < kMinLodTriangles * 3)
+    {
+        return;
+    }
+
+    glm::vec3 minPos = glm::vec3( std::numeric_limits<float>::max());
+    glm::vec3 maxPos = glm::vec3(-std::numeric_limits<float>::max());
+    for(uint32 index : indices)
+    {
+        const float* p = positions + size_t(index) * positionStride;
+        minPos = glm::min(minPos,glm::vec3(p[0],p[1],p[2]));
+        maxPos = glm::max(maxPos,glm::vec3(p[0],p[1],p[2]));
+    }
+
+    const float radius = glm::length(maxPos - minPos) * 0.5f;
+    if(radius <= 0.0f)
+    {
+        return;
+    }
+
+    // NOTE: Every level starts over from the full one, the quadrics then measure the error against it.
+    const uint32 fullIndexCount = (uint32)indices.size();
+    std::vector<uint32> lodIndices;
+    for(uint32 lod = 1; lod < maxLodCount; lod++)
+    {
+        const uint32 previousCount = outLods.back().indexCount;
+        if(previousCount < kMinLodTriangles * 3)
+        {
+            break;
+        }
+
+        const uint32 targetCount = previousCount / 6 * 3;
+        const float error = simplifyMesh(positions,positionStride,vertexCount,indices.data(),fullIndexCount,targetCount,radius * kMaxLodError,lodIndices);
+        if(lodIndices.empty() || float(lodIndices.size()) > float(previousCount) * kMinLodReduction)
+        {
+            break;
+        }
+
+        MeshLod level { };
+        level.firstIndex = (uint32)indices.size();
+        level.indexCount = (uint32)lodIndices.size();
+        level.error = glm::max(error / radius,outLods.back().error); // the selection expects it to grow.
+
+        indices.insert(indices.end(),lodIndices.begin(),lodIndices.end());
+        outLods.push_back(level);
+    }
+}
+
+namespace
+{
+    struct TestMesh
+    {
+        std::vector<float> positions;
+        std::vector<uint32> indices;
+
+        uint32 vertexCount() const { return uint32(positions.size() / 3); }
+        glm::vec3 position(uint32 v) const { return glm::vec3(positions[v * 3 + 0],positions[v * 3 + 1],positions[v * 3 + 2]); }
+    };
+
+    // bSeam duplicates the middle column so the right half is a separate uv island.
+    TestMesh makeGrid(uint32 size,bool bSeam)
+    {
+        TestMesh mesh { };
+        for(uint32 y = 0; y <= size; y++)
+        {
+            for(uint32 x = 0; x <= size; x++)
+            {
+                mesh.positions.insert(mesh.positions.end(),{ float(x),float(y),0.0f });
+            }
+        }
+
+        const uint32 seamStart = mesh.vertexCount();
+        if(bSeam)
+        {
+            for(uint32 y = 0; y <= size; y++)
+            {
+                mesh.positions.insert(mesh.positions.end(),{ float(size / 2),float(y),0.0f });
+            }
+        }
+
+        // Counter clockwise seen from +z.
+        const auto vertex = [&](uint32 x,uint32 y,bool bRight)
+        {
+            return bSeam && bRight && x == size / 2 ? seamStart + y : y * (size + 1) + x;
+        };
+        for(uint32 y = 0; y < size; y++)
+        {
+            for(uint32 x = 0; x < size; x++)
+            {
+                const bool bRight = x >= size / 2;
+                const uint32 i0 = vertex(x,y,bRight);
+                const uint32 i1 = vertex(x + 1,y,bRight);
+                const uint32 i2 = vertex(x,y + 1,bRight);
+                const uint32 i3 = vertex(x + 1,y + 1,bRight);
+                mesh.indices.insert(mesh.indices.end(),{ i0,i1,i3, i0,i3,i2 });
+            }
+        }
+        return mesh;
+    }
+
+    // Closed, the poles are single vertices and the seam at phi 0 is welded.
+    TestMesh makeSphere(uint32 rings,uint32 segments)
+    {
+        TestMesh mesh { };
+        mesh.positions.insert(mesh.positions.end(),{ 0.0f,1.0f,0.0f });
+        for(uint32 r = 1; r < rings; r++)
+        {
+            const float theta = glm::pi<float>() * float(r) / float(rings);
+            for(uint32 s = 0; s < segments; s++)
+            {
+                const float phi = glm::two_pi<float>() * float(s) / float(segments);
+                mesh.positions.insert(mesh.positions.end(),{ std::sin(theta) * std::cos(phi),std::cos(theta),std::sin(theta) * std::sin(phi) });
+            }
+        }
+        mesh.positions.insert(mesh.positions.end(),{ 0.0f,-1.0f,0.0f });
+
+        const uint32 bottom = mesh.vertexCount() - 1;
+        const auto ring = [&](uint32 r,uint32 s) { return 1 + (r - 1) * segments + s % segments; };
+
+        // Counter clockwise seen from outside.
+        for(uint32 s = 0; s < segments; s++)
+        {
+            mesh.indices.insert(mesh.indices.end(),{ 0,ring(1,s + 1),ring(1,s) });
+            mesh.indices.insert(mesh.indices.end(),{ bottom,ring(rings - 1,s),ring(rings - 1,s + 1) });
+        }
+        for(uint32 r = 1; r + 1 < rings; r++)
+        {
+            for(uint32 s = 0; s < segments; s++)
+            {
+                const uint32 i0 = ring(r,s);
+                const uint32 i1 = ring(r,s + 1);
+                const uint32 i2 = ring(r + 1,s);
+                const uint32 i3 = ring(r + 1,s + 1);
+                mesh.indices.insert(mesh.indices.end(),{ i0,i1,i2, i1,i3,i2 });
+            }
+        }
+        return mesh;
+    }
+
+    struct SelfTestContext
+    {
+        uint32 failCount = 0;
+
+        void expect(bool bCondition,const char* test,const char* what)
+        {
+            if(!bCondition)
+            {
+                LOG_ERROR("Mesh lod self test {0} failed: {1}.",test,what);
+                failCount ++;
+            }
+        }
+    };
+
+    // Signed area of the triangles projected on z, a flat grid keeps it when nothing folds over.
+    float projectedArea(const TestMesh& mesh,const uint32* indices,size_t indexCount,uint32& outFlipCount)
+    {
+        float area = 0.0f;
+        outFlipCount = 0;
+        for(size_t i = 0; i < indexCount; i += 3)
+        {
+            const glm::vec3 p0 = mesh.position(indices[i + 0]);
+            const glm::vec3 p1 = mesh.position(indices[i + 1]);
+            const glm::vec3 p2 = mesh.position(indices[i + 2]);
+            const float z = glm::cross(p1 - p0,p2 - p0).z * 0.5f;
+            outFlipCount += z < 0.0f ? 1 : 0;
+            area += z;
+        }
+        return area;
+    }
+
+    void checkGrid(SelfTestContext& ctx,const char* test,bool bSeam)
+    {
+        const TestMesh mesh = makeGrid(32,bSeam);
+        std::vector<uint32> simplified;
+        const float error = simplifyMesh(mesh.positions.data(),3,mesh.vertexCount(),mesh.indices.data(),(uint32)mesh.indices.size(),(uint32)mesh.indices.size() / 4 / 3 * 3,0.01f,simplified);
+
+        ctx.expect(simplified.size() % 3 == 0,test,"partial triangle");
+        ctx.expect(simplified.size() <= mesh.indices.size() / 2,test,"flat grid not simplified");
+        ctx.expect(error < 1e-4f,test,"flat grid has error");
+
+        uint32 flipCount = 0;
+        const float area = projectedArea(mesh,simplified.data(),simplified.size(),flipCount);
+        ctx.expect(flipCount == 0,test,"triangle flipped");
+        ctx.expect(std::abs(area - 32.0f * 32.0f) < 1e-2f,test,"border moved");
+
+        if(bSeam)
+        {
+            // Both sides of the seam keep every seam vertex, the columns stay stitched.
+            std::unordered_set<uint32> used(simplified.begin(),simplified.end());
+            for(uint32 y = 0; y <= 32; y++)
+            {
+                ctx.expect(used.count(y * 33 + 16) != 0 && used.count(33 * 33 + y) != 0,test,"seam vertex removed");
+            }
+        }
+    }
+}
+
+bool runMeshLodSelfTest()
+{
+    SelfTestContext ctx { };
+
+    checkGrid(ctx,"grid",false);
+    checkGrid(ctx,"seam",true);
+
+    {
+        const TestMesh mesh = makeSphere(32,64);
+        std::vector<uint32> indices = mesh.indices;
+        std::vector<MeshLod> lods;
+        buildMeshLods(mesh.positions.data(),3,mesh.vertexCount(),indices,lods);
+
+        ctx.expect(lods.size() >= 3,"sphere","lod chain too short");
+        ctx.expect(lods[0].firstIndex == 0 && lods[0].indexCount == mesh.indices.size() && lods[0].error == 0.0f,"sphere","lod #0 changed");
+        ctx.expect(std::equal(mesh.indices.begin(),mesh.indices.end(),indices.begin()),"sphere","lod #0 indices changed");
+
+        for(size_t lod = 1; lod < lods.size(); lod++)
+        {
+            const auto& level = lods[lod];
+            ctx.expect(level.firstIndex == lods[lod - 1].firstIndex + lods[lod - 1].indexCount,"sphere","lods not contiguous");
+            ctx.expect(float(level.indexCount) <= float(lods[lod - 1].indexCount) * kMinLodReduction,"sphere","lod too large");
+            ctx.expect(level.error >= lods[lod - 1].error && level.error <= kMaxLodError,"sphere","lod error out of order");
+
+            // Every triangle still faces outwards.
+            for(uint32 i = level.firstIndex; i < level.firstIndex + level.indexCount; i += 3)
+            {
+                const glm::vec3 p0 = mesh.position(indices[i + 0]);
+                const glm::vec3 p1 = mesh.position(indices[i + 1]);
+                const glm::vec3 p2 = mesh.position(indices[i + 2]);
+                ctx.expect(glm::dot(glm::cross(p1 - p0,p2 - p0),p0 + p1 + p2) > 0.0f,"sphere","triangle faces inwards");
+            }
+        }
+        ctx.expect(indices.size() == size_t(lods.back().firstIndex) + lods.back().indexCount,"sphere","indices miss a lod");
+    }
+
+    if(ctx.failCount == 0)
+    {
+        LOG_INFO("Mesh lod self test passed.");
+    }
+    return ctx.failCount == 0;
+}
+
+}
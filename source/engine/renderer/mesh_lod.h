@@ -0,0 +1,48 @@
+#pragma once
+#include "../core/core.h"
+#include <vector>
+
+namespace engine{
+
+// NOTE: Levels of a submesh including the full one, keep in sync with g_meshMaxLodCount in common.glsl.
+constexpr uint32 MESH_MAX_LOD_COUNT = 5;
+
+// NOTE: One level of detail of a submesh. The simplified levels follow the full one in the index range
+//       of the submesh and reference the same vertices, so base vertex and index width are shared.
+struct MeshLod
+{
+    uint32 firstIndex = 0; // relative to the first index of the submesh, 0 for lod #0.
+    uint32 indexCount = 0;
+    float error = 0.0f;    // quadric error against lod #0 relative to the radius of the submesh.
+};
+
+// NOTE: Quadric error edge collapse. A collapse moves a vertex onto one of its neighbours so the result
+//       indexes the input vertices. Vertices on open borders and attribute seams (several vertices at one
+//       position) never move. Stops at targetIndexCount or when the next collapse costs more than maxError.
+//       positions holds the xyz of every vertex, positionStride apart in floats. Returns the object space
+//       error of the result.
+extern float simplifyMesh(
+    const float* positions,
+    uint32 positionStride,
+    uint32 vertexCount,
+    const uint32* indices,
+    uint32 indexCount,
+    uint32 targetIndexCount,
+    float maxError,
+    std::vector<uint32>& outIndices);
+
+// NOTE: Chain of levels with about half the triangles of the level before, simplified from the full level.
+//       The simplified indices are appended to indices, outLods[0] is the full level. The chain ends early
+//       when a level does not drop enough triangles.
+extern void buildMeshLods(
+    const float* positions,
+    uint32 positionStride,
+    uint32 vertexCount,
+    std::vector<uint32>& indices,
+    std::vector<MeshLod>& outLods,
+    uint32 maxLodCount = MESH_MAX_LOD_COUNT);
+
+// NOTE: Cpu checks of the simplifier and the lod chain on generated meshes, logs failures.
+extern bool runMeshLodSelfTest();
+
+}
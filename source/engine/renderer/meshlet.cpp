@@ -0,0 +1,435 @@
+#include "meshlet.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <random>
+
+namespace engine{
+
+static inline glm::vec3 loadPosition(const float* positions,uint32 positionStride,uint32 index)
+{
+    const float* p = positions + size_t(index) * positionStride;
+    return glm::vec3(p[0],p[1],p[2]);
+}
+
+void buildMeshlets(
+    const float* positions,
+    uint32 positionStride,
+    uint32 vertexCount,
+    std::vector<uint32>& indices,
+    std::vector<Meshlet>& outMeshlets,
+    uint32 maxVertices,
+    uint32 maxTriangles)
+{
+    CHECK(indices.size() % 3 == 0);
+    CHECK(maxVertices >= 3 && maxTriangles >= 1);
+
+    outMeshlets.clear();
+    const uint32 triangleCount = uint32(indices.size() / 3);
+    if(triangleCount == 0)
+    {
+        return;
+    }
+
+    // NOTE: Triangles around each vertex, packed by vertex.
+    std::vector<uint32> adjacencyOffsets(size_t(vertexCount) + 1,0);
+    for(uint32 index : indices)
+    {
+        CHECK(index < vertexCount);
+        adjacencyOffsets[index + 1] ++;
+    }
+    for(uint32 v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+
+    std::vector<uint32> adjacency(indices.size());
+    std::vector<uint32> adjacencyFill(adjacencyOffsets.begin(),adjacencyOffsets.end() - 1);
+    for(uint32 t = 0; t < triangleCount; t++)
+    {
+        for(uint32 k = 0; k < 3; k++)
+        {
+            adjacency[adjacencyFill[indices[t * 3 + k]] ++] = t;
+        }
+    }
+
+    std::vector<bool> emitted(triangleCount,false);
+    std::vector<uint32> vertexTag(vertexCount,~0u); // meshlet which holds the vertex.
+    std::vector<uint32> sorted;
+    sorted.reserve(indices.size());
+
+    std::vector<uint32> candidates;
+    uint32 cursor = 0;
+    uint32 emittedCount = 0;
+    while(emittedCount < triangleCount)
+    {
+        const uint32 meshletIndex = (uint32)outMeshlets.size();
+        uint32 meshletVertexCount = 0;
+        uint32 meshletTriangleCount = 0;
+        candidates.clear();
+
+        const auto newVertexCount = [&](uint32 t)
+        {
+            const uint32 a = indices[t * 3 + 0];
+            const uint32 b = indices[t * 3 + 1];
+            const uint32 c = indices[t * 3 + 2];
+
+            uint32 count = (vertexTag[a] != meshletIndex) ? 1 : 0;
+            count += (vertexTag[b] != meshletIndex && b != a) ? 1 : 0;
+            count += (vertexTag[c] != meshletIndex && c != a && c != b) ? 1 : 0;
+            return count;
+        };
+
+        const auto addTriangle = [&](uint32 t)
+        {
+            emitted[t] = true;
+            emittedCount ++;
+            meshletTriangleCount ++;
+
+            for(uint32 k = 0; k < 3; k++)
+            {
+                const uint32 v = indices[t * 3 + k];
+                sorted.push_back(v);
+
+                if(vertexTag[v] != meshletIndex)
+                {
+                    vertexTag[v] = meshletIndex;
+                    meshletVertexCount ++;
+
+                    for(uint32 i = adjacencyOffsets[v]; i < adjacencyOffsets[v + 1]; i++)
+                    {
+                        if(!emitted[adjacency[i]]) candidates.push_back(adjacency[i]);
+                    }
+                }
+            }
+        };
+
+        Meshlet meshlet { };
+        meshlet.firstIndex = (uint32)sorted.size();
+
+        while(emitted[cursor]) cursor ++;
+        addTriangle(cursor);
+
+        while(meshletTriangleCount < maxTriangles)
+        {
+            uint32 best = ~0u;
+            uint32 bestNewVertices = 4;
+            for(size_t i = 0; i < candidates.size();)
+            {
+                const uint32 t = candidates[i];
+                if(emitted[t])
+                {
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+
+                const uint32 newVertices = newVertexCount(t);
+                if(meshletVertexCount + newVertices <= maxVertices && newVertices < bestNewVertices)
+                {
+                    best = t;
+                    bestNewVertices = newVertices;
+                    if(newVertices == 0) break;
+                }
+                i ++;
+            }
+
+            if(best == ~0u)
+            {
+                break;
+            }
+            addTriangle(best);
+        }
+
+        meshlet.indexCount = meshletTriangleCount * 3;
+        meshlet.vertexCount = meshletVertexCount;
+        outMeshlets.push_back(meshlet);
+    }
+
+    indices.swap(sorted);
+    for(auto& meshlet : outMeshlets)
+    {
+        computeMeshletBounds(positions,positionStride,indices.data(),meshlet);
+    }
+}
+
+void computeMeshletBounds(const float* positions,uint32 positionStride,const uint32* indices,Meshlet& inout)
+{
+    const uint32* meshletIndices = indices + inout.firstIndex;
+
+    // NOTE: Sphere around the center of the bounding box, tight enough for clusters this small.
+    glm::vec3 minPos = glm::vec3( std::numeric_limits<float>::max());
+    glm::vec3 maxPos = glm::vec3(-std::numeric_limits<float>::max());
+    for(uint32 i = 0; i < inout.indexCount; i++)
+    {
+        const glm::vec3 p = loadPosition(positions,positionStride,meshletIndices[i]);
+        minPos = glm::min(minPos,p);
+        maxPos = glm::max(maxPos,p);
+    }
+
+    const glm::vec3 center = (minPos + maxPos) * 0.5f;
+    float radius = 0.0f;
+    for(uint32 i = 0; i < inout.indexCount; i++)
+    {
+        radius = glm::max(radius,glm::distance(center,loadPosition(positions,positionStride,meshletIndices[i])));
+    }
+    inout.sphere = glm::vec4(center,radius);
+
+    // NOTE: Cone around the mean of the counter clockwise face normals, zero area triangles face nowhere.
+    //       The cutoff is the sine of the widest normal angle to the axis, wider than ~84 degrees never culls.
+    glm::vec3 normalSum = glm::vec3(0.0f);
+    const uint32 triangleCount = inout.indexCount / 3;
+    for(uint32 t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3 p0 = loadPosition(positions,positionStride,meshletIndices[t * 3 + 0]);
+        const glm::vec3 p1 = loadPosition(positions,positionStride,meshletIndices[t * 3 + 1]);
+        const glm::vec3 p2 = loadPosition(positions,positionStride,meshletIndices[t * 3 + 2]);
+
+        const glm::vec3 n = glm::cross(p1 - p0,p2 - p0);
+        const float length = glm::length(n);
+        if(length > 0.0f) normalSum += n / length;
+    }
+
+    inout.cone = glm::vec4(0.0f,0.0f,1.0f,1.0f);
+    const float sumLength = glm::length(normalSum);
+    if(sumLength <= 1e-6f)
+    {
+        return;
+    }
+
+    const glm::vec3 axis = normalSum / sumLength;
+    float minDot = 1.0f;
+    for(uint32 t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3 p0 = loadPosition(positions,positionStride,meshletIndices[t * 3 + 0]);
+        const glm::vec3 p1 = loadPosition(positions,positionStride,meshletIndices[t * 3 + 1]);
+        const glm::vec3 p2 = loadPosition(positions,positionStride,meshletIndices[t * 3 + 2]);
+
+        const glm::vec3 n = glm::cross(p1 - p0,p2 - p0);
+        const float length = glm::length(n);
+        if(length > 0.0f) minDot = glm::min(minDot,glm::dot(axis,n / length));
+    }
+
+    if(minDot > 0.1f)
+    {
+        inout.cone = glm::vec4(axis,std::sqrt(1.0f - minDot * minDot));
+    }
+}
+
+bool isMeshletBackfacing(const Meshlet& meshlet,const glm::vec3& viewPos)
+{
+    if(meshlet.cone.w >= 1.0f)
+    {
+        return false;
+    }
+
+    const glm::vec3 toCenter = glm::vec3(meshlet.sphere) - viewPos;
+    return glm::dot(toCenter,glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(toCenter) + meshlet.sphere.w;
+}
+
+namespace
+{
+    struct TestMesh
+    {
+        std::vector<float> positions; // xyz
+        std::vector<uint32> indices;
+
+        uint32 vertexCount() const { return uint32(positions.size() / 3); }
+        glm::vec3 position(uint32 i) const { return glm::vec3(positions[i * 3 + 0],positions[i * 3 + 1],positions[i * 3 + 2]); }
+    };
+
+    TestMesh makeGrid(uint32 size)
+    {
+        TestMesh mesh { };
+        for(uint32 y = 0; y <= size; y++)
+        {
+            for(uint32 x = 0; x <= size; x++)
+            {
+                mesh.positions.insert(mesh.positions.end(),{ float(x),float(y),0.0f });
+            }
+        }
+
+        // Counter clockwise seen from +z.
+        for(uint32 y = 0; y < size; y++)
+        {
+            for(uint32 x = 0; x < size; x++)
+            {
+                const uint32 i0 = y * (size + 1) + x;
+                const uint32 i1 = i0 + 1;
+                const uint32 i2 = i0 + size + 1;
+                const uint32 i3 = i2 + 1;
+                mesh.indices.insert(mesh.indices.end(),{ i0,i1,i3, i0,i3,i2 });
+            }
+        }
+        return mesh;
+    }
+
+    TestMesh makeSphere(uint32 rings,uint32 segments)
+    {
+        TestMesh mesh { };
+        for(uint32 r = 0; r <= rings; r++)
+        {
+            const float theta = glm::pi<float>() * float(r) / float(rings);
+            for(uint32 s = 0; s <= segments; s++)
+            {
+                const float phi = glm::two_pi<float>() * float(s) / float(segments);
+                mesh.positions.insert(mesh.positions.end(),{ std::sin(theta) * std::cos(phi),std::cos(theta),std::sin(theta) * std::sin(phi) });
+            }
+        }
+
+        // Counter clockwise seen from outside.
+        for(uint32 r = 0; r < rings; r++)
+        {
+            for(uint32 s = 0; s < segments; s++)
+            {
+                const uint32 i0 = r * (segments + 1) + s;
+                const uint32 i1 = i0 + 1;
+                const uint32 i2 = i0 + segments + 1;
+                const uint32 i3 = i2 + 1;
+                mesh.indices.insert(mesh.indices.end(),{ i0,i1,i2, i1,i3,i2 });
+            }
+        }
+        return mesh;
+    }
+
+    TestMesh makeSoup(uint32 vertexCount,uint32 triangleCount,uint32 seed)
+    {
+        TestMesh mesh { };
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> posDist(-10.0f,10.0f);
+        std::uniform_int_distribution<uint32> indexDist(0,vertexCount - 1);
+
+        for(uint32 i = 0; i < vertexCount * 3; i++) mesh.positions.push_back(posDist(rng));
+        for(uint32 i = 0; i < triangleCount * 3; i++) mesh.indices.push_back(indexDist(rng));
+        return mesh;
+    }
+
+    struct SelfTestContext
+    {
+        uint32 failCount = 0;
+
+        void expect(bool bCondition,const char* test,const char* what)
+        {
+            if(!bCondition)
+            {
+                LOG_ERROR("Meshlet self test {0} failed: {1}.",test,what);
+                failCount ++;
+            }
+        }
+    };
+
+    // Every triangle kept exactly once, limits respected, bounds contain every vertex.
+    void checkMeshlets(SelfTestContext& ctx,const char* test,const TestMesh& source,const TestMesh& built,const std::vector<Meshlet>& meshlets)
+    {
+        std::vector<std::array<uint32,3>> sourceTriangles;
+        std::vector<std::array<uint32,3>> builtTriangles;
+        for(size_t i = 0; i < source.indices.size(); i += 3) sourceTriangles.push_back({ source.indices[i],source.indices[i + 1],source.indices[i + 2] });
+        for(size_t i = 0; i < built.indices.size(); i += 3) builtTriangles.push_back({ built.indices[i],built.indices[i + 1],built.indices[i + 2] });
+        std::sort(sourceTriangles.begin(),sourceTriangles.end());
+        std::sort(builtTriangles.begin(),builtTriangles.end());
+        ctx.expect(sourceTriangles == builtTriangles,test,"triangles changed");
+
+        uint32 nextIndex = 0;
+        for(const auto& meshlet : meshlets)
+        {
+            ctx.expect(meshlet.firstIndex == nextIndex,test,"meshlets not contiguous");
+            ctx.expect(meshlet.indexCount > 0 && meshlet.indexCount <= MESHLET_MAX_TRIANGLES * 3,test,"triangle limit");
+            nextIndex = meshlet.firstIndex + meshlet.indexCount;
+
+            std::vector<uint32> unique(built.indices.begin() + meshlet.firstIndex,built.indices.begin() + nextIndex);
+            std::sort(unique.begin(),unique.end());
+            unique.erase(std::unique(unique.begin(),unique.end()),unique.end());
+            ctx.expect(unique.size() == meshlet.vertexCount && meshlet.vertexCount <= MESHLET_MAX_VERTICES,test,"vertex limit");
+
+            for(uint32 v : unique)
+            {
+                const float distance = glm::distance(glm::vec3(meshlet.sphere),built.position(v));
+                ctx.expect(distance <= meshlet.sphere.w * 1.0001f + 1e-5f,test,"vertex outside the sphere");
+            }
+        }
+        ctx.expect(nextIndex == built.indices.size(),test,"meshlets miss indices");
+    }
+
+    // A backfacing meshlet must not have a single triangle facing viewPos.
+    uint32 checkCone(SelfTestContext& ctx,const char* test,const TestMesh& mesh,const std::vector<Meshlet>& meshlets,const glm::vec3& viewPos)
+    {
+        uint32 culledCount = 0;
+        for(const auto& meshlet : meshlets)
+        {
+            if(!isMeshletBackfacing(meshlet,viewPos))
+            {
+                continue;
+            }
+            culledCount ++;
+
+            for(uint32 i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3)
+            {
+                const glm::vec3 p0 = mesh.position(mesh.indices[i + 0]);
+                const glm::vec3 p1 = mesh.position(mesh.indices[i + 1]);
+                const glm::vec3 p2 = mesh.position(mesh.indices[i + 2]);
+                const glm::vec3 n = glm::cross(p1 - p0,p2 - p0);
+                ctx.expect(glm::dot(n,viewPos - p0) <= 1e-4f * glm::length(n),test,"front facing triangle culled");
+            }
+        }
+        return culledCount;
+    }
+}
+
+bool runMeshletSelfTest()
+{
+    SelfTestContext ctx { };
+
+    {
+        const TestMesh source = makeGrid(64);
+        TestMesh built = source;
+        std::vector<Meshlet> meshlets;
+        buildMeshlets(built.positions.data(),3,built.vertexCount(),built.indices,meshlets);
+        checkMeshlets(ctx,"grid",source,built,meshlets);
+
+        // A flat grid is one cone, everything culls from far below and nothing from above.
+        const uint32 culledBelow = checkCone(ctx,"grid",built,meshlets,glm::vec3(32.0f,32.0f,-200.0f));
+        const uint32 culledAbove = checkCone(ctx,"grid",built,meshlets,glm::vec3(32.0f,32.0f, 10.0f));
+        ctx.expect(culledBelow == meshlets.size(),"grid","backfacing meshlets kept");
+        ctx.expect(culledAbove == 0,"grid","front facing meshlets culled");
+
+        // 64x64 quads are 8192 triangles, a full meshlet of a grid holds ~100 of them.
+        ctx.expect(meshlets.size() < 8192 / 50,"grid","meshlets too small");
+    }
+
+    {
+        const TestMesh source = makeSphere(48,96);
+        TestMesh built = source;
+        std::vector<Meshlet> meshlets;
+        buildMeshlets(built.positions.data(),3,built.vertexCount(),built.indices,meshlets);
+        checkMeshlets(ctx,"sphere",source,built,meshlets);
+
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> dirDist(-1.0f,1.0f);
+        uint32 culledCount = 0;
+        for(uint32 i = 0; i < 64; i++)
+        {
+            const glm::vec3 dir = glm::normalize(glm::vec3(dirDist(rng),dirDist(rng),dirDist(rng)) + glm::vec3(0.0f,0.0f,1e-3f));
+            culledCount += checkCone(ctx,"sphere",built,meshlets,dir * 20.0f);
+        }
+
+        // From far away about half the sphere faces away, the cone keeps a good part of that.
+        ctx.expect(culledCount > 64 * meshlets.size() / 5,"sphere","cone culls too little");
+    }
+
+    {
+        const TestMesh source = makeSoup(500,3000,11);
+        TestMesh built = source;
+        std::vector<Meshlet> meshlets;
+        buildMeshlets(built.positions.data(),3,built.vertexCount(),built.indices,meshlets);
+        checkMeshlets(ctx,"soup",source,built,meshlets);
+        checkCone(ctx,"soup",built,meshlets,glm::vec3(0.0f,0.0f,40.0f));
+    }
+
+    if(ctx.failCount == 0)
+    {
+        LOG_INFO("Meshlet self test passed.");
+    }
+    return ctx.failCount == 0;
+}
+
+}
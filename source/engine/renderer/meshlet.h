@@ -0,0 +1,47 @@
+#pragma once
+#include "../core/core.h"
+#include <vector>
+
+namespace engine{
+
+constexpr uint32 MESHLET_MAX_VERTICES = 64;
+constexpr uint32 MESHLET_MAX_TRIANGLES = 124;
+
+// NOTE: Cluster of a submesh, its triangles are one contiguous range of the submesh indices so it draws
+//       as a plain indexed draw. Same layout on the gpu, see Meshlet in common.glsl.
+struct Meshlet
+{
+    glm::vec4 sphere;      // object space center and radius.
+    glm::vec4 cone;        // xyz axis, w cutoff. A cutoff of 1 never culls.
+
+    uint32 firstIndex;     // relative to the first index of the submesh.
+    uint32 indexCount;
+    uint32 vertexCount;    // unique vertices.
+    uint32 pad;
+};
+static_assert(sizeof(Meshlet) == 48);
+
+// NOTE: Greedy clustering, a meshlet grows by the adjacent triangle which adds the fewest new vertices
+//       and starts over from the next unclustered triangle in index order when none fits.
+//       positions holds the xyz of every vertex, positionStride apart in floats. indices is one triangle
+//       list, it is reordered in place so every meshlet is a contiguous range of it.
+extern void buildMeshlets(
+    const float* positions,
+    uint32 positionStride,
+    uint32 vertexCount,
+    std::vector<uint32>& indices,
+    std::vector<Meshlet>& outMeshlets,
+    uint32 maxVertices = MESHLET_MAX_VERTICES,
+    uint32 maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// Bounding sphere and normal cone of the triangles [firstIndex,firstIndex + indexCount) of indices.
+extern void computeMeshletBounds(const float* positions,uint32 positionStride,const uint32* indices,Meshlet& inout);
+
+// NOTE: Same test as the culling shader. True when every triangle of the meshlet faces away from viewPos,
+//       meshlet and viewPos in the same space.
+extern bool isMeshletBackfacing(const Meshlet& meshlet,const glm::vec3& viewPos);
+
+// NOTE: Cpu checks of the builder and the cone test on generated meshes, logs failures.
+extern bool runMeshletSelfTest();
+
+}
@@ -108,14 +108,35 @@ void engine::PassCommon::releaseCommandBuffersAndSemaphore()
     m_semaphore.clear();
 }
 
+VkCommandBuffer engine::PassCommon::getRecordCommandBuf(uint32 index)
+{
+    return m_sharedCommandBuf != VK_NULL_HANDLE ? m_sharedCommandBuf : m_commandbufs[index]->getInstance();
+}
+
 void engine::PassCommon::commandBufBegin(uint32 index)
 {
-    vkCheck(vkResetCommandBuffer(m_commandbufs[index]->getInstance(),0));
-    VkCommandBufferBeginInfo cmdBeginInfo = vkCommandbufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-    vkCheck(vkBeginCommandBuffer(m_commandbufs[index]->getInstance(),&cmdBeginInfo));
+    if(m_sharedCommandBuf == VK_NULL_HANDLE)
+    {
+        vkCheck(vkResetCommandBuffer(m_commandbufs[index]->getInstance(),0));
+        VkCommandBufferBeginInfo cmdBeginInfo = vkCommandbufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        vkCheck(vkBeginCommandBuffer(m_commandbufs[index]->getInstance(),&cmdBeginInfo));
+    }
+
+    if(!m_profileScopeName.empty())
+    {
+        GpuProfiler::get()->beginPassScope(getRecordCommandBuf(index),m_profileScopeName,m_profileScopeQueue);
+    }
 }
 
 void engine::PassCommon::commandBufEnd(uint32 index)
 {
-    vkCheck(vkEndCommandBuffer(m_commandbufs[index]->getInstance()));
+    if(!m_profileScopeName.empty())
+    {
+        GpuProfiler::get()->endPassScope(getRecordCommandBuf(index));
+    }
+
+    if(m_sharedCommandBuf == VK_NULL_HANDLE)
+    {
+        vkCheck(vkEndCommandBuffer(m_commandbufs[index]->getInstance()));
+    }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "../vk/vk_rhi.h"
 #include "render_scene.h"
 #include "../shader_compiler/shader_compiler.h"
+#include "gpu_profiler.h"
 
 namespace engine{
 
@@ -18,14 +19,30 @@ public:
 	VkSemaphore getSemaphore(uint32 i);
 	VulkanCommandBuffer* getCommandBuf(uint32 i);
 
+	// NOTE: Record into a command buffer owned by the caller instead of the pass' own one,
+	//       begin and end are then left to the caller. VK_NULL_HANDLE restores the own buffer.
+	void setSharedCommandBuf(VkCommandBuffer cmd) { m_sharedCommandBuf = cmd; }
+
+	// NOTE: Gpu profiler scope opened by commandBufBegin and closed by commandBufEnd, an empty name
+	//       records without one.
+	void setProfileScope(const std::string& name,frame_graph::EQueueType queue)
+	{
+		m_profileScopeName = name;
+		m_profileScopeQueue = queue;
+	}
+
 protected:
 	DeletionQueue m_deletionQueue = {};
 	std::vector<VulkanCommandBuffer*> m_commandbufs = {};
 	std::vector<VkSemaphore> m_semaphore = {};
+	VkCommandBuffer m_sharedCommandBuf = VK_NULL_HANDLE;
+	std::string m_profileScopeName = {};
+	frame_graph::EQueueType m_profileScopeQueue = frame_graph::EQueueType::Graphics;
 
 	void createCommandBuffersAndSemaphore();
 	void releaseCommandBuffersAndSemaphore();
 
+	VkCommandBuffer getRecordCommandBuf(uint32 index);
 	void commandBufBegin(uint32 index);
 	void commandBufEnd(uint32 index);
 };
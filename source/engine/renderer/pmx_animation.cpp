@@ -0,0 +1,1425 @@
+#include "pmx_animation.h"
+#include "culling_kernel.h"
+#include "../asset_system/asset_pmx.h"
+#include "../core/job_system.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PMX_SKINNING_AVX_TARGET
+#else
+#define PMX_SKINNING_AVX_TARGET __attribute__((target("avx")))
+#endif
+
+namespace engine{
+
+// NOTE: Vertices of one skinning job, a 100k vertex model splits into 13 jobs.
+constexpr uint32 kSkinningJobVertices = 8192;
+
+// NOTE: Ccd stops once the target is this close to the ik bone.
+constexpr float kIKTolerance = 1e-4f;
+
+// NOTE: Limit range of a locked axis, a link with two locked axes turns around the third only.
+constexpr float kIKLockedAxisRange = 1e-4f;
+
+static bool hasBoneFlag(const asset_system::PMXBone& bone,asset_system::PMXBoneFlags flag)
+{
+	return (uint16_t(bone.m_boneFlag) & uint16_t(flag)) != 0;
+}
+
+// NOTE: Parents are evaluated before their children, pmx files don't guarantee the bone order.
+static std::vector<uint32_t> buildBoneOrder(const std::vector<PMXBoneData>& bones)
+{
+	std::vector<uint32_t> order;
+	order.reserve(bones.size());
+
+	std::vector<uint8_t> states(bones.size(),0); // 1 visiting, 2 done.
+	std::vector<uint32_t> stack;
+	for(uint32_t root = 0; root < bones.size(); root++)
+	{
+		stack.push_back(root);
+		while(!stack.empty())
+		{
+			const uint32_t index = stack.back();
+			if(states[index] == 2)
+			{
+				stack.pop_back();
+				continue;
+			}
+
+			const int32_t parent = bones[index].parentIndex;
+			if(states[index] == 0 && parent >= 0 && states[parent] == 0)
+			{
+				states[index] = 1;
+				stack.push_back(uint32_t(parent));
+				continue;
+			}
+
+			// a parent still visiting is a cycle, the bone is evaluated as a root then.
+			states[index] = 2;
+			order.push_back(index);
+			stack.pop_back();
+		}
+	}
+	return order;
+}
+
+static PMXSkinWeights buildSkinWeights(const asset_system::PMXVertex& vertex,size_t boneCount)
+{
+	PMXSkinWeights skin {};
+
+	uint32_t influenceCount = 1;
+	glm::vec4 weights = glm::vec4(1.0f,0.0f,0.0f,0.0f);
+	switch(vertex.m_weightType)
+	{
+	case asset_system::PMXVertexWeight::BDEF1:
+		break;
+	case asset_system::PMXVertexWeight::BDEF2:
+	case asset_system::PMXVertexWeight::SDEF:
+		influenceCount = 2;
+		weights = glm::vec4(vertex.m_boneWeights[0],1.0f - vertex.m_boneWeights[0],0.0f,0.0f);
+		break;
+	case asset_system::PMXVertexWeight::BDEF4:
+	case asset_system::PMXVertexWeight::QDEF:
+		influenceCount = 4;
+		weights = glm::vec4(vertex.m_boneWeights[0],vertex.m_boneWeights[1],vertex.m_boneWeights[2],vertex.m_boneWeights[3]);
+		break;
+	}
+
+	// NOTE: -1 bone indices carry no weight, the rest is renormalized.
+	float weightSum = 0.0f;
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		const int32_t boneIndex = vertex.m_boneIndices[i];
+		if(i >= influenceCount || boneIndex < 0 || size_t(boneIndex) >= boneCount)
+		{
+			weights[i] = 0.0f;
+			skin.boneIndices[i] = 0;
+		}
+		else
+		{
+			weights[i] = glm::max(weights[i],0.0f);
+			skin.boneIndices[i] = uint32_t(boneIndex);
+		}
+		weightSum += weights[i];
+	}
+	skin.boneWeights = weightSum > 0.0f ? weights / weightSum : glm::vec4(1.0f,0.0f,0.0f,0.0f);
+
+	return skin;
+}
+
+// Axis a limited link turns around, -1 if more than one axis is free.
+static int32_t getIKLinkAxis(const PMXIKLinkData& link)
+{
+	int32_t freeAxis = -1;
+	for(int32_t axis = 0; axis < 3; axis++)
+	{
+		const bool bLocked = link.limitMax[axis] - link.limitMin[axis] < kIKLockedAxisRange
+			&& glm::abs(link.limitMin[axis]) < kIKLockedAxisRange;
+		if(!bLocked)
+		{
+			if(freeAxis >= 0) return -1;
+			freeAxis = axis;
+		}
+	}
+	return freeAxis;
+}
+
+void PMXAnimation::build(const asset_system::PMXFile& file)
+{
+	using asset_system::PMXBoneFlags;
+
+	// 0. bones.
+	const size_t boneCount = file.m_bones.size();
+	auto validBone = [boneCount](int32_t index,size_t self)
+	{
+		return index >= 0 && size_t(index) < boneCount && size_t(index) != self;
+	};
+
+	m_bones.clear();
+	m_bones.resize(boneCount);
+	for(size_t i_b = 0; i_b < boneCount; i_b++)
+	{
+		const auto& srcBone = file.m_bones[i_b];
+		auto& bone = m_bones[i_b];
+
+		bone.name = srcBone.m_name;
+		bone.position = srcBone.m_position;
+		bone.parentIndex = validBone(srcBone.m_parentBoneIndex,i_b) ? srcBone.m_parentBoneIndex : -1;
+		bone.deformDepth = srcBone.m_deformDepth;
+		bone.bAfterPhysics = hasBoneFlag(srcBone,PMXBoneFlags::DeformAfterPhysics);
+
+		const bool bAppendRotate = hasBoneFlag(srcBone,PMXBoneFlags::AppendRotate);
+		const bool bAppendTranslate = hasBoneFlag(srcBone,PMXBoneFlags::AppendTranslate);
+		if((bAppendRotate || bAppendTranslate) && validBone(srcBone.m_appendBoneIndex,i_b))
+		{
+			bone.appendIndex = srcBone.m_appendBoneIndex;
+			bone.appendWeight = srcBone.m_appendWeight;
+			bone.bAppendRotate = bAppendRotate;
+			bone.bAppendTranslate = bAppendTranslate;
+			bone.bAppendLocal = hasBoneFlag(srcBone,PMXBoneFlags::AppendLocal);
+		}
+
+		if(hasBoneFlag(srcBone,PMXBoneFlags::IK) && validBone(srcBone.m_ikTargetBoneIndex,i_b))
+		{
+			bone.ikTargetIndex = srcBone.m_ikTargetBoneIndex;
+			bone.ikIterationCount = glm::max(srcBone.m_ikIterationCount,0);
+			bone.ikLimit = srcBone.m_ikLimit;
+			for(const auto& srcLink : srcBone.m_ikLinks)
+			{
+				if(validBone(srcLink.m_ikBoneIndex,i_b))
+				{
+					PMXIKLinkData link {};
+					link.boneIndex = srcLink.m_ikBoneIndex;
+					link.bLimit = srcLink.m_enableLimit != 0;
+					link.limitMin = glm::min(srcLink.m_limitMin,srcLink.m_limitMax);
+					link.limitMax = glm::max(srcLink.m_limitMin,srcLink.m_limitMax);
+					bone.ikLinks.push_back(link);
+				}
+			}
+		}
+	}
+	buildDeformOrder();
+
+	// 1. morphs.
+	const size_t vertexCount = file.m_vertices.size();
+	const size_t morphCount = file.m_morphs.size();
+	m_morphs.clear();
+	m_morphs.resize(morphCount);
+	m_bVertexMorphs = false;
+	for(size_t i_m = 0; i_m < morphCount; i_m++)
+	{
+		const auto& srcMorph = file.m_morphs[i_m];
+		auto& morph = m_morphs[i_m];
+		morph.name = srcMorph.m_name;
+
+		switch(srcMorph.m_morphType)
+		{
+		case asset_system::PMXMorphType::Bone:
+			for(const auto& offset : srcMorph.m_boneMorph)
+			{
+				if(offset.m_boneIndex >= 0 && size_t(offset.m_boneIndex) < boneCount)
+				{
+					morph.boneOffsets.push_back({ offset.m_boneIndex, offset.m_position, glm::normalize(offset.m_quaternion) });
+				}
+			}
+			break;
+		case asset_system::PMXMorphType::Group:
+			for(const auto& child : srcMorph.m_groupMorph)
+			{
+				if(child.m_morphIndex >= 0 && size_t(child.m_morphIndex) < morphCount && size_t(child.m_morphIndex) != i_m)
+				{
+					morph.children.push_back({ child.m_morphIndex, child.m_weight });
+				}
+			}
+			break;
+		case asset_system::PMXMorphType::Position:
+			morph.vertexOffsets.reserve(srcMorph.m_positionMorph.size());
+			for(const auto& offset : srcMorph.m_positionMorph)
+			{
+				if(offset.m_vertexIndex >= 0 && size_t(offset.m_vertexIndex) < vertexCount)
+				{
+					morph.vertexOffsets.push_back({ uint32_t(offset.m_vertexIndex), offset.m_position, glm::vec2(0.0f) });
+				}
+			}
+			break;
+		case asset_system::PMXMorphType::UV:
+			morph.vertexOffsets.reserve(srcMorph.m_uvMorph.size());
+			for(const auto& offset : srcMorph.m_uvMorph)
+			{
+				if(offset.m_vertexIndex >= 0 && size_t(offset.m_vertexIndex) < vertexCount)
+				{
+					morph.vertexOffsets.push_back({ uint32_t(offset.m_vertexIndex), glm::vec3(0.0f), glm::vec2(offset.m_uv.x,offset.m_uv.y) });
+				}
+			}
+			break;
+		default:
+			break;
+		}
+		m_bVertexMorphs |= !morph.vertexOffsets.empty();
+	}
+
+	// 2. bind pose and weights.
+	m_positions.resize(vertexCount);
+	m_normals.resize(vertexCount);
+	m_uvs.resize(vertexCount);
+	m_skinWeights.resize(vertexCount);
+	m_sphericalVertices.clear();
+	for(size_t i_v = 0; i_v < vertexCount; i_v++)
+	{
+		const auto& vertex = file.m_vertices[i_v];
+		m_positions[i_v] = glm::vec4(vertex.m_position,1.0f);
+		m_normals[i_v] = glm::vec4(vertex.m_normal,0.0f);
+		m_uvs[i_v] = vertex.m_uv;
+		m_skinWeights[i_v] = buildSkinWeights(vertex,boneCount);
+
+		if(vertex.m_weightType == asset_system::PMXVertexWeight::SDEF || vertex.m_weightType == asset_system::PMXVertexWeight::QDEF)
+		{
+			PMXSphericalVertex spherical {};
+			spherical.vertexIndex = uint32_t(i_v);
+			spherical.type = vertex.m_weightType == asset_system::PMXVertexWeight::SDEF ? EPMXSkinType::Spherical : EPMXSkinType::DualQuat;
+			spherical.sdefC = vertex.m_sdefC;
+			spherical.sdefR0 = vertex.m_sdefR0;
+			spherical.sdefR1 = vertex.m_sdefR1;
+			m_sphericalVertices.push_back(spherical);
+		}
+	}
+}
+
+void PMXAnimation::buildDeformOrder()
+{
+	// NOTE: Deform depth first like MMD, parents first inside one depth.
+	m_deformOrder = buildBoneOrder(m_bones);
+	std::stable_sort(m_deformOrder.begin(),m_deformOrder.end(),[this](uint32_t a,uint32_t b)
+	{
+		const auto& boneA = m_bones[a];
+		const auto& boneB = m_bones[b];
+		if(boneA.bAfterPhysics != boneB.bAfterPhysics) return boneB.bAfterPhysics;
+		return boneA.deformDepth < boneB.deformDepth;
+	});
+
+	// NOTE: A turned link moves every bone below it, the target included.
+	const size_t boneCount = m_bones.size();
+	m_ikBones.clear();
+	m_ikBoneSlots.assign(boneCount,-1);
+	std::vector<uint8_t> bLink(boneCount);
+	for(const uint32_t index : m_deformOrder)
+	{
+		const auto& bone = m_bones[index];
+		if(bone.ikTargetIndex < 0 || bone.ikLinks.empty())
+		{
+			continue;
+		}
+
+		std::fill(bLink.begin(),bLink.end(),uint8_t(0));
+		for(const auto& link : bone.ikLinks)
+		{
+			bLink[link.boneIndex] = 1;
+		}
+
+		IKBone ikBone {};
+		ikBone.boneIndex = index;
+		for(const uint32_t candidate : m_deformOrder)
+		{
+			// walk up to the root, bounded in case of a parent cycle.
+			int32_t ancestor = int32_t(candidate);
+			for(size_t step = 0; ancestor >= 0 && step < boneCount; step++)
+			{
+				if(bLink[ancestor])
+				{
+					ikBone.chainUpdate.push_back(candidate);
+					break;
+				}
+				ancestor = m_bones[ancestor].parentIndex;
+			}
+		}
+
+		m_ikBoneSlots[index] = int32_t(m_ikBones.size());
+		m_ikBones.push_back(std::move(ikBone));
+	}
+}
+
+int32_t PMXAnimation::findBone(const std::string& name) const
+{
+	for(size_t i = 0; i < m_bones.size(); i++)
+	{
+		if(m_bones[i].name == name)
+		{
+			return int32_t(i);
+		}
+	}
+	return -1;
+}
+
+int32_t PMXAnimation::findMorph(const std::string& name) const
+{
+	for(size_t i = 0; i < m_morphs.size(); i++)
+	{
+		if(m_morphs[i].name == name)
+		{
+			return int32_t(i);
+		}
+	}
+	return -1;
+}
+
+void PMXAnimation::initPose(PMXPose& pose) const
+{
+	const size_t boneCount = m_bones.size();
+	const glm::quat identity = glm::quat(1.0f,0.0f,0.0f,0.0f);
+
+	pose.translations.assign(boneCount,glm::vec3(0.0f));
+	pose.rotations.assign(boneCount,identity);
+	pose.morphWeights.assign(m_morphs.size(),0.0f);
+
+	// links evaluated after their ik bone start from the bind pose.
+	pose.globalRotations.assign(boneCount,identity);
+	pose.globalPositions.resize(boneCount);
+	for(size_t i = 0; i < boneCount; i++)
+	{
+		pose.globalPositions[i] = m_bones[i].position;
+	}
+
+	pose.skinRotations.assign(boneCount,identity);
+	pose.skinTranslations.assign(boneCount,glm::vec3(0.0f));
+	pose.skinMatrices.assign(boneCount,glm::mat4(1.0f));
+	pose.resolvedMorphWeights.assign(m_morphs.size(),0.0f);
+}
+
+glm::quat PMXAnimation::getLocalRotation(const PMXPose& pose,uint32_t index) const
+{
+	return pose.ikRotations[index] * pose.animRotations[index] * pose.appendRotations[index];
+}
+
+void PMXAnimation::updateAppend(PMXPose& pose,uint32_t index) const
+{
+	const auto& bone = m_bones[index];
+	if(bone.appendIndex < 0)
+	{
+		return;
+	}
+
+	// NOTE: Local append takes the animated value of the source, otherwise the source's own append
+	//       is inherited when it has one, so append chains follow their root.
+	const uint32_t source = uint32_t(bone.appendIndex);
+	const auto& sourceBone = m_bones[source];
+	if(bone.bAppendRotate)
+	{
+		const bool bChain = !bone.bAppendLocal && sourceBone.appendIndex >= 0 && sourceBone.bAppendRotate;
+		const glm::quat rotation = pose.ikRotations[source] * (bChain ? pose.appendRotations[source] : pose.animRotations[source]);
+		pose.appendRotations[index] = glm::slerp(glm::quat(1.0f,0.0f,0.0f,0.0f),rotation,bone.appendWeight);
+	}
+	if(bone.bAppendTranslate)
+	{
+		const bool bChain = !bone.bAppendLocal && sourceBone.appendIndex >= 0 && sourceBone.bAppendTranslate;
+		const glm::vec3 translation = bChain ? pose.appendTranslations[source] : pose.animTranslations[source];
+		pose.appendTranslations[index] = translation * bone.appendWeight;
+	}
+}
+
+void PMXAnimation::updateGlobal(PMXPose& pose,uint32_t index) const
+{
+	const auto& bone = m_bones[index];
+	const glm::quat rotation = getLocalRotation(pose,index);
+	const glm::vec3 translation = pose.animTranslations[index] + pose.appendTranslations[index];
+	if(bone.parentIndex >= 0)
+	{
+		const glm::quat& parentRotation = pose.globalRotations[bone.parentIndex];
+		const glm::vec3 offset = bone.position - m_bones[bone.parentIndex].position + translation;
+
+		pose.globalRotations[index] = parentRotation * rotation;
+		pose.globalPositions[index] = pose.globalPositions[bone.parentIndex] + parentRotation * offset;
+	}
+	else
+	{
+		pose.globalRotations[index] = rotation;
+		pose.globalPositions[index] = bone.position + translation;
+	}
+}
+
+void PMXAnimation::updateIKChain(PMXPose& pose,uint32_t ikIndex) const
+{
+	for(const uint32_t index : m_ikBones[m_ikBoneSlots[ikIndex]].chainUpdate)
+	{
+		updateGlobal(pose,index);
+	}
+}
+
+void PMXAnimation::solveIKIteration(PMXPose& pose,uint32_t ikIndex) const
+{
+	const auto& ikBone = m_bones[ikIndex];
+	const uint32_t target = uint32_t(ikBone.ikTargetIndex);
+	const glm::vec3 ikPosition = pose.globalPositions[ikIndex];
+
+	for(const auto& link : ikBone.ikLinks)
+	{
+		const uint32_t index = uint32_t(link.boneIndex);
+		if(index == target)
+		{
+			continue;
+		}
+
+		// NOTE: In the frame of the link, turning it by rotation moves the target towards the ik bone.
+		const glm::quat inverseRotation = glm::conjugate(pose.globalRotations[index]);
+		glm::vec3 toTarget = inverseRotation * (pose.globalPositions[target] - pose.globalPositions[index]);
+		glm::vec3 toIK = inverseRotation * (ikPosition - pose.globalPositions[index]);
+
+		const int32_t limitAxis = link.bLimit ? getIKLinkAxis(link) : -1;
+		glm::vec3 axis = glm::vec3(0.0f);
+		if(limitAxis >= 0)
+		{
+			// hinge, like a knee. solve in the plane of the free axis.
+			axis[limitAxis] = 1.0f;
+			toTarget -= axis * glm::dot(toTarget,axis);
+			toIK -= axis * glm::dot(toIK,axis);
+		}
+
+		const float targetLength = glm::length(toTarget);
+		const float ikLength = glm::length(toIK);
+		if(targetLength < 1e-6f || ikLength < 1e-6f)
+		{
+			continue;
+		}
+		toTarget /= targetLength;
+		toIK /= ikLength;
+
+		float angle = glm::acos(glm::clamp(glm::dot(toTarget,toIK),-1.0f,1.0f));
+		if(angle < 1e-5f)
+		{
+			continue;
+		}
+		if(ikBone.ikLimit > 0.0f)
+		{
+			angle = glm::min(angle,ikBone.ikLimit);
+		}
+
+		const glm::vec3 cross = glm::cross(toTarget,toIK);
+		if(limitAxis >= 0)
+		{
+			angle = glm::dot(cross,axis) < 0.0f ? -angle : angle;
+		}
+		else
+		{
+			const float crossLength = glm::length(cross);
+			if(crossLength < 1e-6f)
+			{
+				continue;
+			}
+			axis = cross / crossLength;
+		}
+
+		glm::quat rotation = glm::normalize(getLocalRotation(pose,index) * glm::angleAxis(angle,axis));
+		if(link.bLimit)
+		{
+			const glm::vec3 euler = glm::clamp(glm::eulerAngles(rotation),link.limitMin,link.limitMax);
+			rotation = glm::quat(euler);
+		}
+
+		// ik rotation goes in front of the animated and appended rotation, see getLocalRotation.
+		pose.ikRotations[index] = rotation * glm::inverse(pose.animRotations[index] * pose.appendRotations[index]);
+		updateIKChain(pose,ikIndex);
+	}
+}
+
+void PMXAnimation::solveIK(PMXPose& pose,uint32_t ikIndex) const
+{
+	const auto& ikBone = m_bones[ikIndex];
+	const uint32_t target = uint32_t(ikBone.ikTargetIndex);
+	const size_t linkCount = ikBone.ikLinks.size();
+	pose.ikBestRotations.resize(glm::max(pose.ikBestRotations.size(),linkCount));
+
+	// NOTE: Ccd can overshoot, the best iteration is kept.
+	float bestDistance = std::numeric_limits<float>::max();
+	for(int32_t iteration = 0; iteration < ikBone.ikIterationCount; iteration++)
+	{
+		solveIKIteration(pose,ikIndex);
+
+		const float distance = glm::length(pose.globalPositions[target] - pose.globalPositions[ikIndex]);
+		if(distance < bestDistance)
+		{
+			bestDistance = distance;
+			for(size_t i = 0; i < linkCount; i++)
+			{
+				pose.ikBestRotations[i] = pose.ikRotations[ikBone.ikLinks[i].boneIndex];
+			}
+		}
+		else
+		{
+			for(size_t i = 0; i < linkCount; i++)
+			{
+				pose.ikRotations[ikBone.ikLinks[i].boneIndex] = pose.ikBestRotations[i];
+			}
+			updateIKChain(pose,ikIndex);
+			break;
+		}
+
+		if(distance < kIKTolerance)
+		{
+			break;
+		}
+	}
+}
+
+void PMXAnimation::evaluatePose(PMXPose& pose) const
+{
+	const size_t boneCount = m_bones.size();
+	const size_t morphCount = m_morphs.size();
+	CHECK(pose.translations.size() == boneCount && pose.rotations.size() == boneCount);
+	CHECK(pose.morphWeights.size() == morphCount);
+	CHECK(pose.globalPositions.size() == boneCount);
+
+	// 0. group morphs add their weight to the children, nested groups are not followed.
+	pose.resolvedMorphWeights = pose.morphWeights;
+	for(size_t i = 0; i < morphCount; i++)
+	{
+		if(pose.morphWeights[i] == 0.0f) continue;
+		for(const auto& child : m_morphs[i].children)
+		{
+			pose.resolvedMorphWeights[child.morphIndex] += pose.morphWeights[i] * child.weight;
+		}
+	}
+
+	// 1. bone morphs on top of the local pose.
+	pose.animTranslations = pose.translations;
+	pose.animRotations = pose.rotations;
+	for(size_t i = 0; i < morphCount; i++)
+	{
+		const float weight = pose.resolvedMorphWeights[i];
+		if(weight == 0.0f) continue;
+		for(const auto& offset : m_morphs[i].boneOffsets)
+		{
+			pose.animTranslations[offset.boneIndex] += offset.translation * weight;
+			pose.animRotations[offset.boneIndex] = pose.animRotations[offset.boneIndex] * glm::slerp(glm::quat(1.0f,0.0f,0.0f,0.0f),offset.rotation,weight);
+		}
+	}
+
+	// 2. hierarchy in deform order, append and ik of a bone see every bone deformed before it.
+	const glm::quat identity = glm::quat(1.0f,0.0f,0.0f,0.0f);
+	pose.appendTranslations.assign(boneCount,glm::vec3(0.0f));
+	pose.appendRotations.assign(boneCount,identity);
+	pose.ikRotations.assign(boneCount,identity);
+	for(const uint32_t index : m_deformOrder)
+	{
+		updateAppend(pose,index);
+		updateGlobal(pose,index);
+		if(m_ikBoneSlots[index] >= 0)
+		{
+			solveIK(pose,index);
+		}
+	}
+
+	// 3. skin transforms.
+	pose.skinRotations.resize(boneCount);
+	pose.skinTranslations.resize(boneCount);
+	pose.skinMatrices.resize(boneCount);
+	for(size_t i = 0; i < boneCount; i++)
+	{
+		const glm::quat rotation = glm::normalize(pose.globalRotations[i]);
+		const glm::vec3 translation = pose.globalPositions[i] - rotation * m_bones[i].position;
+
+		pose.skinRotations[i] = rotation;
+		pose.skinTranslations[i] = translation;
+
+		glm::mat4& matrix = pose.skinMatrices[i];
+		matrix = glm::mat4_cast(rotation);
+		matrix[3] = glm::vec4(translation,1.0f);
+	}
+}
+
+static inline void writeVertex(float* dest,const glm::vec3& position,const glm::vec3& normal,const glm::vec2& uv)
+{
+	dest[0] = position.x; dest[1] = position.y; dest[2] = position.z;
+	dest[3] = normal.x;   dest[4] = normal.y;   dest[5] = normal.z;
+	dest[6] = uv.x;       dest[7] = uv.y;
+}
+
+static inline glm::vec3 normalizeSafe(const glm::vec3& v)
+{
+	return v * (1.0f / glm::sqrt(glm::max(glm::dot(v,v),1e-30f)));
+}
+
+static void skinScalar(
+	const glm::mat4* matrices,
+	const PMXSkinWeights* weights,
+	const glm::vec4* positions,
+	const glm::vec4* normals,
+	const glm::vec2* uvs,
+	uint32_t begin,
+	uint32_t end,
+	float* outVertices)
+{
+	for(uint32_t i = begin; i < end; i++)
+	{
+		const PMXSkinWeights& w = weights[i];
+		const glm::mat4 matrix =
+			matrices[w.boneIndices.x] * w.boneWeights.x +
+			matrices[w.boneIndices.y] * w.boneWeights.y +
+			matrices[w.boneIndices.z] * w.boneWeights.z +
+			matrices[w.boneIndices.w] * w.boneWeights.w;
+
+		writeVertex(&outVertices[size_t(i) * 8],glm::vec3(matrix * positions[i]),normalizeSafe(glm::vec3(matrix * normals[i])),uvs[i]);
+	}
+}
+
+// NOTE: Blends the four bone matrices column by column, then transforms position and normal with
+//       broadcasts instead of dot products. One vertex per iteration.
+static void skinSSE(
+	const glm::mat4* matrices,
+	const PMXSkinWeights* weights,
+	const glm::vec4* positions,
+	const glm::vec4* normals,
+	const glm::vec2* uvs,
+	uint32_t begin,
+	uint32_t end,
+	float* outVertices)
+{
+	const __m128 minLength = _mm_set1_ps(1e-30f);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for(uint32_t i = begin; i < end; i++)
+	{
+		const PMXSkinWeights& w = weights[i];
+
+		__m128 c0 = _mm_setzero_ps();
+		__m128 c1 = _mm_setzero_ps();
+		__m128 c2 = _mm_setzero_ps();
+		__m128 c3 = _mm_setzero_ps();
+		for(uint32_t k = 0; k < 4; k++)
+		{
+			const float* m = &matrices[w.boneIndices[k]][0][0];
+			const __m128 weight = _mm_set1_ps(w.boneWeights[k]);
+			c0 = _mm_add_ps(c0,_mm_mul_ps(weight,_mm_loadu_ps(m + 0)));
+			c1 = _mm_add_ps(c1,_mm_mul_ps(weight,_mm_loadu_ps(m + 4)));
+			c2 = _mm_add_ps(c2,_mm_mul_ps(weight,_mm_loadu_ps(m + 8)));
+			c3 = _mm_add_ps(c3,_mm_mul_ps(weight,_mm_loadu_ps(m + 12)));
+		}
+
+		const __m128 p = _mm_loadu_ps(&positions[i].x);
+		__m128 position = _mm_mul_ps(c0,_mm_shuffle_ps(p,p,_MM_SHUFFLE(0,0,0,0)));
+		position = _mm_add_ps(position,_mm_mul_ps(c1,_mm_shuffle_ps(p,p,_MM_SHUFFLE(1,1,1,1))));
+		position = _mm_add_ps(position,_mm_mul_ps(c2,_mm_shuffle_ps(p,p,_MM_SHUFFLE(2,2,2,2))));
+		position = _mm_add_ps(position,c3);
+
+		const __m128 n = _mm_loadu_ps(&normals[i].x);
+		__m128 normal = _mm_mul_ps(c0,_mm_shuffle_ps(n,n,_MM_SHUFFLE(0,0,0,0)));
+		normal = _mm_add_ps(normal,_mm_mul_ps(c1,_mm_shuffle_ps(n,n,_MM_SHUFFLE(1,1,1,1))));
+		normal = _mm_add_ps(normal,_mm_mul_ps(c2,_mm_shuffle_ps(n,n,_MM_SHUFFLE(2,2,2,2))));
+
+		// w of the normal is zero, the horizontal sum of the squares is the squared length in every lane.
+		__m128 lengthSq = _mm_mul_ps(normal,normal);
+		lengthSq = _mm_add_ps(lengthSq,_mm_shuffle_ps(lengthSq,lengthSq,_MM_SHUFFLE(2,3,0,1)));
+		lengthSq = _mm_add_ps(lengthSq,_mm_shuffle_ps(lengthSq,lengthSq,_MM_SHUFFLE(1,0,3,2)));
+		normal = _mm_mul_ps(normal,_mm_div_ps(one,_mm_sqrt_ps(_mm_max_ps(lengthSq,minLength))));
+
+		// 4 wide stores, the normal overwrites w of the position and the uv overwrites w of the normal.
+		float* dest = &outVertices[size_t(i) * 8];
+		_mm_storeu_ps(dest + 0,position);
+		_mm_storeu_ps(dest + 3,normal);
+		dest[6] = uvs[i].x;
+		dest[7] = uvs[i].y;
+	}
+}
+
+static inline __m256 PMX_SKINNING_AVX_TARGET loadPair(const float* a,const float* b)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)),_mm_loadu_ps(b),1);
+}
+
+static inline __m256 PMX_SKINNING_AVX_TARGET broadcastPair(float a,float b)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(a)),_mm_set1_ps(b),1);
+}
+
+// NOTE: Same as skinSSE with two vertices per iteration, one in each 128 bit lane.
+static PMX_SKINNING_AVX_TARGET void skinAVX(
+	const glm::mat4* matrices,
+	const PMXSkinWeights* weights,
+	const glm::vec4* positions,
+	const glm::vec4* normals,
+	const glm::vec2* uvs,
+	uint32_t begin,
+	uint32_t end,
+	float* outVertices)
+{
+	const __m256 minLength = _mm256_set1_ps(1e-30f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	uint32_t i = begin;
+	for(; i + 2 <= end; i += 2)
+	{
+		const PMXSkinWeights& wa = weights[i];
+		const PMXSkinWeights& wb = weights[i + 1];
+
+		__m256 c0 = _mm256_setzero_ps();
+		__m256 c1 = _mm256_setzero_ps();
+		__m256 c2 = _mm256_setzero_ps();
+		__m256 c3 = _mm256_setzero_ps();
+		for(uint32_t k = 0; k < 4; k++)
+		{
+			const float* ma = &matrices[wa.boneIndices[k]][0][0];
+			const float* mb = &matrices[wb.boneIndices[k]][0][0];
+			const __m256 weight = broadcastPair(wa.boneWeights[k],wb.boneWeights[k]);
+			c0 = _mm256_add_ps(c0,_mm256_mul_ps(weight,loadPair(ma + 0,mb + 0)));
+			c1 = _mm256_add_ps(c1,_mm256_mul_ps(weight,loadPair(ma + 4,mb + 4)));
+			c2 = _mm256_add_ps(c2,_mm256_mul_ps(weight,loadPair(ma + 8,mb + 8)));
+			c3 = _mm256_add_ps(c3,_mm256_mul_ps(weight,loadPair(ma + 12,mb + 12)));
+		}
+
+		// positions and normals of the two vertices are adjacent.
+		const __m256 p = _mm256_loadu_ps(&positions[i].x);
+		__m256 position = _mm256_mul_ps(c0,_mm256_permute_ps(p,_MM_SHUFFLE(0,0,0,0)));
+		position = _mm256_add_ps(position,_mm256_mul_ps(c1,_mm256_permute_ps(p,_MM_SHUFFLE(1,1,1,1))));
+		position = _mm256_add_ps(position,_mm256_mul_ps(c2,_mm256_permute_ps(p,_MM_SHUFFLE(2,2,2,2))));
+		position = _mm256_add_ps(position,c3);
+
+		const __m256 n = _mm256_loadu_ps(&normals[i].x);
+		__m256 normal = _mm256_mul_ps(c0,_mm256_permute_ps(n,_MM_SHUFFLE(0,0,0,0)));
+		normal = _mm256_add_ps(normal,_mm256_mul_ps(c1,_mm256_permute_ps(n,_MM_SHUFFLE(1,1,1,1))));
+		normal = _mm256_add_ps(normal,_mm256_mul_ps(c2,_mm256_permute_ps(n,_MM_SHUFFLE(2,2,2,2))));
+
+		__m256 lengthSq = _mm256_mul_ps(normal,normal);
+		lengthSq = _mm256_add_ps(lengthSq,_mm256_permute_ps(lengthSq,_MM_SHUFFLE(2,3,0,1)));
+		lengthSq = _mm256_add_ps(lengthSq,_mm256_permute_ps(lengthSq,_MM_SHUFFLE(1,0,3,2)));
+		normal = _mm256_mul_ps(normal,_mm256_div_ps(one,_mm256_sqrt_ps(_mm256_max_ps(lengthSq,minLength))));
+
+		float* destA = &outVertices[size_t(i) * 8];
+		float* destB = destA + 8;
+		_mm_storeu_ps(destA + 0,_mm256_castps256_ps128(position));
+		_mm_storeu_ps(destA + 3,_mm256_castps256_ps128(normal));
+		_mm_storeu_ps(destB + 0,_mm256_extractf128_ps(position,1));
+		_mm_storeu_ps(destB + 3,_mm256_extractf128_ps(normal,1));
+		destA[6] = uvs[i].x;
+		destA[7] = uvs[i].y;
+		destB[6] = uvs[i + 1].x;
+		destB[7] = uvs[i + 1].y;
+	}
+
+	skinScalar(matrices,weights,positions,normals,uvs,i,end,outVertices);
+}
+
+void PMXAnimation::skinRange(
+	const PMXPose& pose,
+	const glm::vec4* positions,
+	const glm::vec2* uvs,
+	uint32_t begin,
+	uint32_t end,
+	float* outVertices,
+	EPMXSkinningKernel kernel) const
+{
+	// a model without bones keeps the bind pose, every weight points at bone 0.
+	static const glm::mat4 identity = glm::mat4(1.0f);
+	const glm::mat4* matrices = pose.skinMatrices.empty() ? &identity : pose.skinMatrices.data();
+
+	switch(kernel)
+	{
+	case EPMXSkinningKernel::Scalar:
+		skinScalar(matrices,m_skinWeights.data(),positions,m_normals.data(),uvs,begin,end,outVertices);
+		break;
+	case EPMXSkinningKernel::AVX:
+		skinAVX(matrices,m_skinWeights.data(),positions,m_normals.data(),uvs,begin,end,outVertices);
+		break;
+	default:
+		skinSSE(matrices,m_skinWeights.data(),positions,m_normals.data(),uvs,begin,end,outVertices);
+		break;
+	}
+}
+
+void PMXAnimation::skinSpherical(const PMXPose& pose,const glm::vec4* positions,float* outVertices) const
+{
+	if(pose.skinRotations.empty())
+	{
+		return;
+	}
+
+	auto boneTransform = [&pose](uint32_t boneIndex,const glm::vec3& position)
+	{
+		return pose.skinRotations[boneIndex] * position + pose.skinTranslations[boneIndex];
+	};
+
+	// NOTE: Same math as pmx_skinning.comp.
+	for(const auto& spherical : m_sphericalVertices)
+	{
+		const uint32_t vertexIndex = spherical.vertexIndex;
+		const PMXSkinWeights& w = m_skinWeights[vertexIndex];
+		const glm::vec3 position = glm::vec3(positions[vertexIndex]);
+		const glm::vec3 normal = glm::vec3(m_normals[vertexIndex]);
+
+		glm::vec3 skinnedPosition;
+		glm::vec3 skinnedNormal;
+		if(spherical.type == EPMXSkinType::Spherical)
+		{
+			const uint32_t bone0 = w.boneIndices.x;
+			const uint32_t bone1 = w.boneIndices.y;
+			const float w0 = w.boneWeights.x;
+			const float w1 = w.boneWeights.y;
+
+			const glm::vec3 center = spherical.sdefC;
+			const glm::vec3 rw = spherical.sdefR0 * w0 + spherical.sdefR1 * w1;
+			const glm::vec3 cr0 = (center + center + spherical.sdefR0 - rw) * 0.5f;
+			const glm::vec3 cr1 = (center + center + spherical.sdefR1 - rw) * 0.5f;
+
+			const glm::quat q0 = pose.skinRotations[bone0];
+			glm::quat q1 = pose.skinRotations[bone1];
+			q1 = glm::dot(q0,q1) < 0.0f ? -q1 : q1;
+			const glm::quat q = glm::normalize(q0 * w0 + q1 * w1);
+
+			skinnedPosition = q * (position - center) + boneTransform(bone0,cr0) * w0 + boneTransform(bone1,cr1) * w1;
+			skinnedNormal = q * normal;
+		}
+		else
+		{
+			const glm::quat pivot = pose.skinRotations[w.boneIndices.x];
+			glm::quat real = glm::quat(0.0f,0.0f,0.0f,0.0f);
+			glm::quat dual = glm::quat(0.0f,0.0f,0.0f,0.0f);
+			for(uint32_t i = 0; i < 4; i++)
+			{
+				const float weight = w.boneWeights[i];
+				if(weight == 0.0f) continue;
+
+				const glm::quat& boneReal = pose.skinRotations[w.boneIndices[i]];
+				const glm::vec3& translation = pose.skinTranslations[w.boneIndices[i]];
+				const glm::quat boneDual = glm::quat(0.0f,translation.x,translation.y,translation.z) * boneReal * 0.5f;
+				const float sign = glm::dot(pivot,boneReal) < 0.0f ? -1.0f : 1.0f;
+
+				real = real + boneReal * (weight * sign);
+				dual = dual + boneDual * (weight * sign);
+			}
+
+			const float length = glm::length(real);
+			real = real / length;
+			dual = dual / length;
+
+			const glm::quat translation = dual * glm::conjugate(real);
+			skinnedPosition = real * position + glm::vec3(translation.x,translation.y,translation.z) * 2.0f;
+			skinnedNormal = real * normal;
+		}
+
+		float* dest = &outVertices[size_t(vertexIndex) * 8];
+		dest[0] = skinnedPosition.x; dest[1] = skinnedPosition.y; dest[2] = skinnedPosition.z;
+
+		skinnedNormal = normalizeSafe(skinnedNormal);
+		dest[3] = skinnedNormal.x; dest[4] = skinnedNormal.y; dest[5] = skinnedNormal.z;
+	}
+}
+
+void PMXAnimation::skin(PMXPose& pose,float* outVertices,EPMXSkinningKernel kernel,bool bParallel) const
+{
+	const uint32_t vertexCount = getVertexCount();
+	if(vertexCount == 0)
+	{
+		return;
+	}
+	CHECK(pose.skinMatrices.size() == m_bones.size());
+
+	// 0. position and uv morphs, sparse on top of a copy of the bind pose.
+	const glm::vec4* positions = m_positions.data();
+	const glm::vec2* uvs = m_uvs.data();
+	if(m_bVertexMorphs)
+	{
+		bool bMorphed = false;
+		for(size_t i = 0; i < m_morphs.size(); i++)
+		{
+			const float weight = pose.resolvedMorphWeights[i];
+			if(weight == 0.0f || m_morphs[i].vertexOffsets.empty()) continue;
+
+			if(!bMorphed)
+			{
+				pose.morphedPositions = m_positions;
+				pose.morphedUVs = m_uvs;
+				bMorphed = true;
+			}
+			for(const auto& offset : m_morphs[i].vertexOffsets)
+			{
+				pose.morphedPositions[offset.vertexIndex] += glm::vec4(offset.position * weight,0.0f);
+				pose.morphedUVs[offset.vertexIndex] += offset.uv * weight;
+			}
+		}
+
+		if(bMorphed)
+		{
+			positions = pose.morphedPositions.data();
+			uvs = pose.morphedUVs.data();
+		}
+	}
+
+	if(kernel == EPMXSkinningKernel::Auto)
+	{
+		kernel = cullingKernelUseAVX() ? EPMXSkinningKernel::AVX : EPMXSkinningKernel::SSE;
+	}
+
+	// 1. linear blend of every vertex, the calling thread takes the first range.
+	const uint32_t jobCount = bParallel ? (vertexCount + kSkinningJobVertices - 1) / kSkinningJobVertices : 1;
+	if(jobCount <= 1)
+	{
+		skinRange(pose,positions,uvs,0,vertexCount,outVertices,kernel);
+	}
+	else
+	{
+		jobsystem::Context jobContext { };
+		for(uint32_t job = 1; job < jobCount; job++)
+		{
+			const uint32_t begin = job * kSkinningJobVertices;
+			const uint32_t end = glm::min(begin + kSkinningJobVertices,vertexCount);
+			jobsystem::execute(jobContext,[this,&pose,positions,uvs,begin,end,outVertices,kernel]()
+			{
+				skinRange(pose,positions,uvs,begin,end,outVertices,kernel);
+			});
+		}
+		skinRange(pose,positions,uvs,0,kSkinningJobVertices,outVertices,kernel);
+		jobsystem::wait(jobContext);
+	}
+
+	// 2. sdef and qdef, usually a small part of the model.
+	if(!m_sphericalVertices.empty())
+	{
+		skinSpherical(pose,positions,outVertices);
+	}
+}
+
+namespace
+{
+	struct SelfTestContext
+	{
+		uint32 failCount = 0;
+
+		void expect(bool bCondition,const char* test,const char* what)
+		{
+			if(!bCondition)
+			{
+				LOG_ERROR("PMX animation self test {0} failed: {1}.",test,what);
+				failCount ++;
+			}
+		}
+	};
+
+	bool nearlyEqual(const glm::vec3& a,const glm::vec3& b,float tolerance = 1e-4f)
+	{
+		return glm::all(glm::lessThanEqual(glm::abs(a - b),glm::vec3(tolerance)));
+	}
+
+	glm::vec3 outPosition(const std::vector<float>& vertices,uint32_t index)
+	{
+		return glm::vec3(vertices[index * 8 + 0],vertices[index * 8 + 1],vertices[index * 8 + 2]);
+	}
+
+	glm::vec3 outNormal(const std::vector<float>& vertices,uint32_t index)
+	{
+		return glm::vec3(vertices[index * 8 + 3],vertices[index * 8 + 4],vertices[index * 8 + 5]);
+	}
+
+	int32_t addBone(asset_system::PMXFile& file,const char* name,const glm::vec3& position,int32_t parent)
+	{
+		asset_system::PMXBone bone {};
+		bone.m_name = name;
+		bone.m_position = position;
+		bone.m_parentBoneIndex = parent;
+		bone.m_boneFlag = asset_system::PMXBoneFlags(
+			uint16_t(asset_system::PMXBoneFlags::AllowRotate) |
+			uint16_t(asset_system::PMXBoneFlags::Visible));
+		file.m_bones.push_back(bone);
+		return int32_t(file.m_bones.size() - 1);
+	}
+
+	void addBoneFlag(asset_system::PMXBone& bone,asset_system::PMXBoneFlags flag)
+	{
+		bone.m_boneFlag = asset_system::PMXBoneFlags(uint16_t(bone.m_boneFlag) | uint16_t(flag));
+	}
+
+	void setAppend(asset_system::PMXFile& file,int32_t bone,int32_t source,float weight)
+	{
+		addBoneFlag(file.m_bones[bone],asset_system::PMXBoneFlags::AppendRotate);
+		file.m_bones[bone].m_appendBoneIndex = source;
+		file.m_bones[bone].m_appendWeight = weight;
+	}
+
+	// links from the target's parent towards the root, as pmx stores them.
+	void setIK(asset_system::PMXFile& file,int32_t bone,int32_t target,const std::vector<int32_t>& links,int32_t iterationCount,float limit)
+	{
+		auto& ikBone = file.m_bones[bone];
+		addBoneFlag(ikBone,asset_system::PMXBoneFlags::IK);
+		ikBone.m_ikTargetBoneIndex = target;
+		ikBone.m_ikIterationCount = iterationCount;
+		ikBone.m_ikLimit = limit;
+		for(const int32_t link : links)
+		{
+			asset_system::PMXIKLink ikLink {};
+			ikLink.m_ikBoneIndex = link;
+			ikBone.m_ikLinks.push_back(ikLink);
+		}
+	}
+
+	void addVertex(
+		asset_system::PMXFile& file,
+		const glm::vec3& position,
+		const glm::vec3& normal,
+		asset_system::PMXVertexWeight type,
+		const glm::ivec4& bones,
+		const glm::vec4& weights)
+	{
+		asset_system::PMXVertex vertex {};
+		vertex.m_position = position;
+		vertex.m_normal = normal;
+		vertex.m_uv = glm::vec2(0.5f);
+		vertex.m_weightType = type;
+		for(uint32_t i = 0; i < 4; i++)
+		{
+			vertex.m_boneIndices[i] = bones[i];
+			vertex.m_boneWeights[i] = weights[i];
+		}
+		file.m_vertices.push_back(vertex);
+	}
+
+	// Chains hanging from the root, the end of every other chain follows an ik bone and every fourth
+	// chain appends the rotation of its neighbour. Vertices sit around the chains with two to four weights,
+	// one in a hundred is SDEF. A position morph moves every tenth vertex.
+	asset_system::PMXFile makeChainRig(uint32_t vertexCount,uint32_t chainCount,uint32_t chainLength)
+	{
+		asset_system::PMXFile file {};
+		addBone(file,"root",glm::vec3(0.0f),-1);
+
+		std::vector<std::vector<int32_t>> chains(chainCount);
+		for(uint32_t c = 0; c < chainCount; c++)
+		{
+			int32_t parent = 0;
+			for(uint32_t j = 0; j < chainLength; j++)
+			{
+				// slightly bent so the ik never starts from a straight chain.
+				const glm::vec3 position = glm::vec3(float(c) * 2.0f,20.0f - float(j),(j % 2) * 0.1f);
+				parent = addBone(file,"chain",position,parent);
+				chains[c].push_back(parent);
+				if(c % 4 == 3)
+				{
+					setAppend(file,parent,chains[c - 1][j],0.5f);
+				}
+			}
+		}
+
+		for(uint32_t c = 0; c < chainCount; c += 2)
+		{
+			const int32_t target = chains[c].back();
+			const int32_t ik = addBone(file,"ik",file.m_bones[target].m_position,0);
+
+			std::vector<int32_t> links;
+			for(uint32_t j = 2; j <= glm::min(chainLength,4u); j++)
+			{
+				links.push_back(chains[c][chainLength - j]);
+			}
+			setIK(file,ik,target,links,10,0.5f);
+		}
+
+		file.m_vertices.reserve(vertexCount);
+		const uint32_t vertexPerChain = (vertexCount + chainCount - 1) / chainCount;
+		for(uint32_t v = 0; v < vertexCount; v++)
+		{
+			const auto& chain = chains[v % chainCount];
+			const float t = float(v / chainCount) / float(vertexPerChain) * float(chainLength - 1);
+			const uint32_t j = glm::min(uint32_t(t),chainLength - 2);
+			const float f = t - float(j);
+
+			const float angle = float(v) * 0.37f;
+			const glm::vec3 radial = glm::vec3(glm::cos(angle),0.0f,glm::sin(angle));
+			const glm::vec3 position = glm::mix(file.m_bones[chain[j]].m_position,file.m_bones[chain[j + 1]].m_position,f) + radial * 0.3f;
+
+			if(v % 100 == 0)
+			{
+				addVertex(file,position,radial,asset_system::PMXVertexWeight::SDEF,glm::ivec4(chain[j],chain[j + 1],-1,-1),glm::vec4(1.0f - f,0.0f,0.0f,0.0f));
+				auto& vertex = file.m_vertices.back();
+				vertex.m_sdefC = file.m_bones[chain[j + 1]].m_position;
+				vertex.m_sdefR0 = vertex.m_sdefC + glm::vec3(0.0f,0.2f,0.0f);
+				vertex.m_sdefR1 = vertex.m_sdefC - glm::vec3(0.0f,0.2f,0.0f);
+			}
+			else if(v % 3 == 0)
+			{
+				const uint32_t j0 = j > 0 ? j - 1 : j;
+				const uint32_t j3 = glm::min(j + 2,chainLength - 1);
+				addVertex(file,position,radial,asset_system::PMXVertexWeight::BDEF4,
+					glm::ivec4(chain[j0],chain[j],chain[j + 1],chain[j3]),
+					glm::vec4(0.1f,(1.0f - f) * 0.8f,f * 0.8f,0.1f));
+			}
+			else
+			{
+				addVertex(file,position,radial,asset_system::PMXVertexWeight::BDEF2,glm::ivec4(chain[j],chain[j + 1],-1,-1),glm::vec4(1.0f - f,0.0f,0.0f,0.0f));
+			}
+		}
+
+		asset_system::PMXMorph morph {};
+		morph.m_name = "position";
+		morph.m_morphType = asset_system::PMXMorphType::Position;
+		for(uint32_t v = 0; v < vertexCount; v += 10)
+		{
+			morph.m_positionMorph.push_back({ int32_t(v), glm::vec3(0.0f,0.1f,0.0f) });
+		}
+		file.m_morphs.push_back(morph);
+
+		return file;
+	}
+
+	// Animated local pose of the chain rig, ik bones move away from their targets.
+	void animateChainRig(const PMXAnimation& animation,PMXPose& pose,uint32_t frame)
+	{
+		const auto& bones = animation.getBones();
+		for(uint32_t i = 1; i < bones.size(); i++)
+		{
+			const float phase = float(frame) * 0.1f + float(i) * 0.7f;
+			if(bones[i].ikTargetIndex >= 0)
+			{
+				pose.translations[i] = glm::vec3(glm::sin(phase),1.0f + glm::cos(phase),0.5f);
+			}
+			else
+			{
+				pose.rotations[i] = glm::angleAxis(glm::sin(phase) * 0.3f,glm::normalize(glm::vec3(1.0f,0.2f,0.1f)));
+			}
+		}
+		if(!pose.morphWeights.empty())
+		{
+			pose.morphWeights[0] = 0.5f + 0.5f * glm::sin(float(frame) * 0.05f);
+		}
+	}
+
+	void checkGoldenPose(SelfTestContext& ctx)
+	{
+		using asset_system::PMXVertexWeight;
+		const char* test = "golden";
+
+		asset_system::PMXFile file {};
+		const int32_t root = addBone(file,"root",glm::vec3(0.0f,0.0f,0.0f),-1);
+		const int32_t arm = addBone(file,"arm",glm::vec3(0.0f,1.0f,0.0f),root);
+		const int32_t hand = addBone(file,"hand",glm::vec3(0.0f,2.0f,0.0f),arm);
+		const int32_t follow = addBone(file,"follow",glm::vec3(1.0f,0.0f,0.0f),root);
+		const int32_t slide = addBone(file,"slide",glm::vec3(0.0f,-1.0f,0.0f),root);
+		setAppend(file,follow,arm,0.5f);
+
+		// free two link chain and a knee turning around x only.
+		const int32_t upper = addBone(file,"upper",glm::vec3(3.0f,3.0f,0.0f),root);
+		const int32_t lower = addBone(file,"lower",glm::vec3(3.0f,1.5f,0.1f),upper);
+		const int32_t foot = addBone(file,"foot",glm::vec3(3.0f,0.0f,0.0f),lower);
+		const int32_t footIK = addBone(file,"footIK",glm::vec3(3.0f,0.0f,0.0f),root);
+		setIK(file,footIK,foot,{ lower, upper },40,1.0f);
+
+		const int32_t thigh = addBone(file,"thigh",glm::vec3(-3.0f,3.0f,0.0f),root);
+		const int32_t knee = addBone(file,"knee",glm::vec3(-3.0f,1.5f,-0.1f),thigh);
+		const int32_t ankle = addBone(file,"ankle",glm::vec3(-3.0f,0.0f,0.0f),knee);
+		const int32_t legIK = addBone(file,"legIK",glm::vec3(-3.0f,0.0f,0.0f),root);
+		setIK(file,legIK,ankle,{ knee, thigh },40,1.0f);
+		auto& kneeLink = file.m_bones[legIK].m_ikLinks[0];
+		kneeLink.m_enableLimit = 1;
+		kneeLink.m_limitMin = glm::vec3(-glm::pi<float>(),0.0f,0.0f);
+		kneeLink.m_limitMax = glm::vec3(-0.01f,0.0f,0.0f);
+
+		const glm::vec3 x = glm::vec3(1.0f,0.0f,0.0f);
+		const glm::vec3 y = glm::vec3(0.0f,1.0f,0.0f);
+		const glm::vec3 z = glm::vec3(0.0f,0.0f,1.0f);
+		addVertex(file,glm::vec3(0.0f,2.0f,0.0f),x,PMXVertexWeight::BDEF1,glm::ivec4(hand,-1,-1,-1),glm::vec4(1.0f,0.0f,0.0f,0.0f));
+		addVertex(file,glm::vec3(0.0f,1.5f,0.0f),z,PMXVertexWeight::BDEF2,glm::ivec4(arm,root,-1,-1),glm::vec4(0.5f,0.0f,0.0f,0.0f));
+		addVertex(file,glm::vec3(2.0f,0.0f,0.0f),y,PMXVertexWeight::BDEF1,glm::ivec4(follow,-1,-1,-1),glm::vec4(1.0f,0.0f,0.0f,0.0f));
+		addVertex(file,glm::vec3(0.0f,0.0f,0.0f),y,PMXVertexWeight::BDEF1,glm::ivec4(root,-1,-1,-1),glm::vec4(1.0f,0.0f,0.0f,0.0f));
+		addVertex(file,glm::vec3(0.0f,-1.0f,0.0f),y,PMXVertexWeight::BDEF1,glm::ivec4(slide,-1,-1,-1),glm::vec4(1.0f,0.0f,0.0f,0.0f));
+		addVertex(file,glm::vec3(0.0f,1.5f,0.0f),z,PMXVertexWeight::SDEF,glm::ivec4(arm,root,-1,-1),glm::vec4(0.5f,0.0f,0.0f,0.0f));
+		addVertex(file,glm::vec3(0.0f,1.5f,0.0f),z,PMXVertexWeight::QDEF,glm::ivec4(arm,-1,-1,-1),glm::vec4(1.0f,0.0f,0.0f,0.0f));
+		for(uint32_t i = 0; i < 4; i++)
+		{
+			// out of range bones carry no weight.
+			addVertex(file,glm::vec3(0.0f,2.0f,0.0f),x,PMXVertexWeight::BDEF2,glm::ivec4(hand,100,-1,-1),glm::vec4(0.5f,0.0f,0.0f,0.0f));
+		}
+		auto& sdefVertex = file.m_vertices[5];
+		sdefVertex.m_sdefC = glm::vec3(0.0f,1.0f,0.0f);
+		sdefVertex.m_sdefR0 = glm::vec3(0.0f,1.0f,0.0f);
+		sdefVertex.m_sdefR1 = glm::vec3(0.0f,1.0f,0.0f);
+
+		// morphs, the group drives the position and uv morphs at twice and once its weight.
+		asset_system::PMXMorph positionMorph {};
+		positionMorph.m_morphType = asset_system::PMXMorphType::Position;
+		positionMorph.m_positionMorph.push_back({ 3, glm::vec3(0.0f,0.0f,1.0f) });
+		file.m_morphs.push_back(positionMorph);
+
+		asset_system::PMXMorph uvMorph {};
+		uvMorph.m_morphType = asset_system::PMXMorphType::UV;
+		uvMorph.m_uvMorph.push_back({ 3, glm::vec4(0.2f,0.0f,0.0f,0.0f) });
+		file.m_morphs.push_back(uvMorph);
+
+		asset_system::PMXMorph groupMorph {};
+		groupMorph.m_name = "group";
+		groupMorph.m_morphType = asset_system::PMXMorphType::Group;
+		groupMorph.m_groupMorph.push_back({ 0, 2.0f });
+		groupMorph.m_groupMorph.push_back({ 1, 1.0f });
+		file.m_morphs.push_back(groupMorph);
+
+		asset_system::PMXMorph boneMorph {};
+		boneMorph.m_name = "bone";
+		boneMorph.m_morphType = asset_system::PMXMorphType::Bone;
+		boneMorph.m_boneMorph.push_back({ slide, glm::vec3(1.0f,0.0f,0.0f), glm::quat(1.0f,0.0f,0.0f,0.0f) });
+		file.m_morphs.push_back(boneMorph);
+
+		PMXAnimation animation {};
+		animation.build(file);
+		ctx.expect(animation.getIKCount() == 2,test,"ik bones missing");
+		ctx.expect(animation.findBone("legIK") == legIK && animation.findMorph("bone") == 3,test,"name lookup");
+
+		PMXPose pose {};
+		animation.initPose(pose);
+
+		// the bind pose skins to the bind vertices.
+		std::vector<float> vertices(animation.getVertexCount() * 8);
+		animation.evaluatePose(pose);
+		animation.skin(pose,vertices.data(),EPMXSkinningKernel::Scalar,false);
+		for(uint32_t i = 0; i < animation.getVertexCount(); i++)
+		{
+			ctx.expect(nearlyEqual(outPosition(vertices,i),file.m_vertices[i].m_position),test,"bind pose moved");
+		}
+
+		// reference pose.
+		pose.rotations[arm] = glm::angleAxis(glm::half_pi<float>(),z);
+		pose.translations[footIK] = glm::vec3(0.8f,0.8f,0.3f);
+		pose.translations[legIK] = glm::vec3(0.0f,0.6f,0.3f);
+		pose.morphWeights[2] = 0.25f;
+		pose.morphWeights[3] = 1.0f;
+		animation.evaluatePose(pose);
+
+		const float s = glm::sqrt(0.5f);
+		const float sdef = glm::sqrt(0.125f);
+		for(const auto kernel : { EPMXSkinningKernel::Scalar, EPMXSkinningKernel::SSE, EPMXSkinningKernel::AVX })
+		{
+			if(kernel == EPMXSkinningKernel::AVX && !cullingKernelUseAVX())
+			{
+				continue;
+			}
+
+			std::fill(vertices.begin(),vertices.end(),0.0f);
+			animation.skin(pose,vertices.data(),kernel,false);
+
+			ctx.expect(nearlyEqual(outPosition(vertices,0),glm::vec3(-1.0f,1.0f,0.0f)),test,"child of a turned bone");
+			ctx.expect(nearlyEqual(outNormal(vertices,0),y),test,"normal of a turned bone");
+			ctx.expect(nearlyEqual(outPosition(vertices,1),glm::vec3(-0.25f,1.25f,0.0f)),test,"linear blend");
+			ctx.expect(nearlyEqual(outNormal(vertices,1),z),test,"blended normal");
+			ctx.expect(nearlyEqual(outPosition(vertices,2),glm::vec3(1.0f + s,s,0.0f)),test,"append rotation");
+			ctx.expect(nearlyEqual(outNormal(vertices,2),glm::vec3(-s,s,0.0f)),test,"append normal");
+			ctx.expect(nearlyEqual(outPosition(vertices,3),glm::vec3(0.0f,0.0f,0.5f)),test,"group position morph");
+			ctx.expect(glm::abs(vertices[3 * 8 + 6] - 0.55f) < 1e-4f && vertices[3 * 8 + 7] == 0.5f,test,"group uv morph");
+			ctx.expect(nearlyEqual(outPosition(vertices,4),glm::vec3(1.0f,-1.0f,0.0f)),test,"bone morph");
+			ctx.expect(nearlyEqual(outPosition(vertices,5),glm::vec3(-sdef,1.0f + sdef,0.0f)),test,"sdef");
+			ctx.expect(nearlyEqual(outPosition(vertices,6),glm::vec3(-0.5f,1.0f,0.0f)),test,"qdef");
+			for(uint32_t i = 7; i < 11; i++)
+			{
+				ctx.expect(nearlyEqual(outPosition(vertices,i),glm::vec3(-1.0f,1.0f,0.0f)),test,"invalid bone weight");
+			}
+		}
+
+		// ik reaches the bone, links keep their length.
+		const auto& p = pose.globalPositions;
+		ctx.expect(glm::length(p[foot] - p[footIK]) < 1e-3f,test,"ik target not reached");
+		ctx.expect(glm::abs(glm::length(p[lower] - p[upper]) - glm::length(glm::vec3(0.0f,1.5f,0.1f))) < 1e-4f,test,"ik link stretched");
+		ctx.expect(glm::abs(glm::length(p[foot] - p[lower]) - glm::length(glm::vec3(0.0f,1.5f,-0.1f))) < 1e-4f,test,"ik link stretched");
+
+		// the knee bends around x inside its limit and gets closer.
+		const glm::vec3 kneeEuler = glm::eulerAngles(pose.ikRotations[knee]);
+		ctx.expect(glm::abs(kneeEuler.y) < 1e-3f && glm::abs(kneeEuler.z) < 1e-3f,test,"knee left its axis");
+		ctx.expect(kneeEuler.x <= -0.01f + 1e-3f && kneeEuler.x >= -glm::pi<float>() - 1e-3f,test,"knee outside its limit");
+		ctx.expect(glm::length(p[ankle] - p[legIK]) < 0.05f,test,"limited ik target not reached");
+	}
+
+	void checkKernels(SelfTestContext& ctx)
+	{
+		const char* test = "kernels";
+
+		const asset_system::PMXFile file = makeChainRig(20000,16,12);
+		PMXAnimation animation {};
+		animation.build(file);
+
+		PMXPose pose {};
+		animation.initPose(pose);
+		animateChainRig(animation,pose,7);
+		animation.evaluatePose(pose);
+
+		std::vector<float> reference(animation.getVertexCount() * 8);
+		animation.skin(pose,reference.data(),EPMXSkinningKernel::Scalar,false);
+
+		std::vector<float> vertices(reference.size());
+		for(const auto kernel : { EPMXSkinningKernel::SSE, EPMXSkinningKernel::AVX, EPMXSkinningKernel::Auto })
+		{
+			if(kernel == EPMXSkinningKernel::AVX && !cullingKernelUseAVX())
+			{
+				continue;
+			}
+
+			std::fill(vertices.begin(),vertices.end(),0.0f);
+			animation.skin(pose,vertices.data(),kernel,kernel == EPMXSkinningKernel::Auto);
+
+			float maxError = 0.0f;
+			for(size_t i = 0; i < vertices.size(); i++)
+			{
+				maxError = glm::max(maxError,glm::abs(vertices[i] - reference[i]));
+			}
+			ctx.expect(maxError < 1e-4f,test,kernel == EPMXSkinningKernel::Auto ? "jobs differ from scalar" : "simd differs from scalar");
+		}
+
+		// a second evaluation of the same pose is identical.
+		std::vector<glm::vec3> positions = pose.globalPositions;
+		animation.evaluatePose(pose);
+		ctx.expect(positions == pose.globalPositions,test,"pose evaluation not deterministic");
+	}
+}
+
+bool runPMXAnimationSelfTest()
+{
+	SelfTestContext ctx { };
+
+	checkGoldenPose(ctx);
+	checkKernels(ctx);
+
+	if(ctx.failCount == 0)
+	{
+		LOG_INFO("PMX animation self test passed.");
+	}
+	return ctx.failCount == 0;
+}
+
+void runPMXAnimationBenchmark(uint32_t vertexCount)
+{
+	using Clock = std::chrono::steady_clock;
+	auto elapsedMs = [](Clock::time_point begin)
+	{
+		return std::chrono::duration<double,std::milli>(Clock::now() - begin).count();
+	};
+
+	// 32 chains of 16 bones, about the bone count of a dressed mmd model.
+	const asset_system::PMXFile file = makeChainRig(vertexCount,32,16);
+	PMXAnimation animation {};
+	animation.build(file);
+
+	PMXPose pose {};
+	animation.initPose(pose);
+
+	constexpr uint32_t poseFrames = 1000;
+	auto begin = Clock::now();
+	for(uint32_t frame = 0; frame < poseFrames; frame++)
+	{
+		animateChainRig(animation,pose,frame);
+		animation.evaluatePose(pose);
+	}
+	const double poseMs = elapsedMs(begin) / poseFrames;
+	LOG_INFO("PMX animation benchmark {0} bones, {1} ik: pose {2:.4f}ms, {3:.0f} bones/ms.",
+		animation.getBoneCount(),
+		animation.getIKCount(),
+		poseMs,
+		double(animation.getBoneCount()) / poseMs);
+
+	std::vector<float> vertices(size_t(animation.getVertexCount()) * 8);
+	struct Run
+	{
+		const char* name;
+		EPMXSkinningKernel kernel;
+		bool bParallel;
+	};
+	const Run runs[] = {
+		{ "scalar", EPMXSkinningKernel::Scalar, false },
+		{ "sse",    EPMXSkinningKernel::SSE,    false },
+		{ "avx",    EPMXSkinningKernel::AVX,    false },
+		{ "jobs",   EPMXSkinningKernel::Auto,   true  },
+	};
+
+	constexpr uint32_t skinFrames = 50;
+	for(const auto& run : runs)
+	{
+		if(run.kernel == EPMXSkinningKernel::AVX && !cullingKernelUseAVX())
+		{
+			continue;
+		}
+
+		begin = Clock::now();
+		for(uint32_t frame = 0; frame < skinFrames; frame++)
+		{
+			animation.skin(pose,vertices.data(),run.kernel,run.bParallel);
+		}
+		const double skinMs = elapsedMs(begin) / skinFrames;
+		LOG_INFO("PMX animation benchmark {0} vertices {1}: skin {2:.3f}ms, {3:.0f} vertices/ms.",
+			animation.getVertexCount(),
+			run.name,
+			skinMs,
+			double(animation.getVertexCount()) / skinMs);
+	}
+}
+
+}
@@ -0,0 +1,210 @@
+#pragma once
+#include "../core/core.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <string>
+#include <vector>
+
+namespace engine{
+
+namespace asset_system{ struct PMXFile; }
+
+namespace EPMXSkinType
+{
+	constexpr uint32 Linear = 0; // BDEF1, BDEF2, BDEF4.
+	constexpr uint32 Spherical = 1; // SDEF.
+	constexpr uint32 DualQuat = 2; // QDEF.
+}
+
+struct PMXIKLinkData
+{
+	int32_t boneIndex;
+	bool bLimit;
+	glm::vec3 limitMin; // euler angles in radians, parent space of the link.
+	glm::vec3 limitMax;
+};
+
+struct PMXBoneData
+{
+	std::string name;
+	int32_t parentIndex;
+	glm::vec3 position; // bind pose, model space.
+
+	// deform order is deform depth, bones deformed after physics go last.
+	int32_t deformDepth = 0;
+	bool bAfterPhysics = false;
+
+	// append(inherit) of another bone's local rotation or translation, -1 without.
+	int32_t appendIndex = -1;
+	float appendWeight = 0.0f;
+	bool bAppendRotate = false;
+	bool bAppendTranslate = false;
+	bool bAppendLocal = false;
+
+	// ccd ik, -1 if the bone is no ik bone.
+	int32_t ikTargetIndex = -1;
+	int32_t ikIterationCount = 0;
+	float ikLimit = 0.0f; // max angle of a link per iteration in radians.
+	std::vector<PMXIKLinkData> ikLinks;
+};
+
+struct PMXMorphData
+{
+	struct BoneOffset
+	{
+		int32_t boneIndex;
+		glm::vec3 translation;
+		glm::quat rotation;
+	};
+
+	struct GroupChild
+	{
+		int32_t morphIndex;
+		float weight;
+	};
+
+	// position and uv morph.
+	struct VertexOffset
+	{
+		uint32_t vertexIndex;
+		glm::vec3 position;
+		glm::vec2 uv;
+	};
+
+	std::string name;
+	std::vector<BoneOffset> boneOffsets;     // bone morph.
+	std::vector<GroupChild> children;        // group morph.
+	std::vector<VertexOffset> vertexOffsets; // position and uv morph.
+};
+
+// NOTE: Normalized weights of a vertex, unused slots and invalid bones have zero weight and bone 0.
+struct PMXSkinWeights
+{
+	glm::uvec4 boneIndices;
+	glm::vec4 boneWeights;
+};
+
+// NOTE: SDEF and QDEF vertices, skinned on top of the linear result.
+struct PMXSphericalVertex
+{
+	uint32_t vertexIndex;
+	uint32_t type; // EPMXSkinType.
+	glm::vec3 sdefC;
+	glm::vec3 sdefR0;
+	glm::vec3 sdefR1;
+};
+
+// NOTE: Pose of one model, owned by the caller so models sharing a PMXAnimation evaluate in parallel.
+//       Inputs are relative to the bind pose, see PMXAnimation::initPose.
+struct PMXPose
+{
+	// input.
+	std::vector<glm::vec3> translations;
+	std::vector<glm::quat> rotations;
+	std::vector<float> morphWeights;
+
+	// output of evaluatePose, skin transforms map the bind pose to the posed model space: p' = R p + t.
+	std::vector<float> resolvedMorphWeights; // group morphs applied.
+	std::vector<glm::quat> globalRotations;
+	std::vector<glm::vec3> globalPositions;
+	std::vector<glm::quat> skinRotations;
+	std::vector<glm::vec3> skinTranslations;
+	std::vector<glm::mat4> skinMatrices;
+
+	// scratch.
+	std::vector<glm::vec3> animTranslations; // input plus bone morphs.
+	std::vector<glm::quat> animRotations;
+	std::vector<glm::vec3> appendTranslations;
+	std::vector<glm::quat> appendRotations;
+	std::vector<glm::quat> ikRotations;
+	std::vector<glm::quat> ikBestRotations;
+	std::vector<glm::vec4> morphedPositions;
+	std::vector<glm::vec2> morphedUVs;
+};
+
+enum class EPMXSkinningKernel
+{
+	Auto = 0, // AVX when the cpu supports it, otherwise SSE.
+	Scalar,
+	SSE,      // one vertex per iteration.
+	AVX,      // two vertices per iteration.
+};
+
+// NOTE: Cpu animation of a pmx model, the reference of pmx_skinning.comp and the path without a gpu.
+//       evaluatePose resolves group and bone morphs, then walks the bones in deform order applying
+//       append rotation and translation and solving ccd ik. skin applies position and uv morphs and
+//       blends the bone matrices of every vertex with SSE or AVX, split into jobs. SDEF and QDEF vertices
+//       are skinned scalar afterwards, same math as the shader.
+class PMXAnimation
+{
+public:
+	void build(const asset_system::PMXFile& file);
+
+	uint32_t getVertexCount() const { return uint32_t(m_positions.size()); }
+	uint32_t getBoneCount() const { return uint32_t(m_bones.size()); }
+	uint32_t getMorphCount() const { return uint32_t(m_morphs.size()); }
+	uint32_t getIKCount() const { return uint32_t(m_ikBones.size()); }
+
+	const std::vector<PMXBoneData>& getBones() const { return m_bones; }
+	const std::vector<PMXMorphData>& getMorphs() const { return m_morphs; }
+	const std::vector<PMXSkinWeights>& getSkinWeights() const { return m_skinWeights; }
+
+	// -1 if not found.
+	int32_t findBone(const std::string& name) const;
+	int32_t findMorph(const std::string& name) const;
+
+	// Sizes the pose and resets it to the bind pose.
+	void initPose(PMXPose& pose) const;
+	void evaluatePose(PMXPose& pose) const;
+
+	// Writes the skinned vertices of an evaluated pose interleaved as getPMXMeshAttributes, 8 floats each.
+	void skin(PMXPose& pose,float* outVertices,EPMXSkinningKernel kernel = EPMXSkinningKernel::Auto,bool bParallel = true) const;
+
+private:
+	void buildDeformOrder();
+
+	glm::quat getLocalRotation(const PMXPose& pose,uint32_t index) const;
+	void updateAppend(PMXPose& pose,uint32_t index) const;
+	void updateGlobal(PMXPose& pose,uint32_t index) const;
+	void solveIK(PMXPose& pose,uint32_t ikIndex) const;
+	void solveIKIteration(PMXPose& pose,uint32_t ikIndex) const;
+	void updateIKChain(PMXPose& pose,uint32_t ikIndex) const;
+
+	void skinRange(const PMXPose& pose,const glm::vec4* positions,const glm::vec2* uvs,uint32_t begin,uint32_t end,float* outVertices,EPMXSkinningKernel kernel) const;
+	void skinSpherical(const PMXPose& pose,const glm::vec4* positions,float* outVertices) const;
+
+private:
+	std::vector<PMXBoneData> m_bones;
+	std::vector<PMXMorphData> m_morphs;
+
+	// parents first inside one deform depth.
+	std::vector<uint32_t> m_deformOrder;
+
+	// ik bones and the bones to update after one of their links turned, in deform order.
+	struct IKBone
+	{
+		uint32_t boneIndex;
+		std::vector<uint32_t> chainUpdate;
+	};
+	std::vector<IKBone> m_ikBones;
+	std::vector<int32_t> m_ikBoneSlots; // IKBone of a bone, -1 without.
+
+	// bind pose, 16 byte aligned for the skinning kernels.
+	std::vector<glm::vec4> m_positions; // w is 1.
+	std::vector<glm::vec4> m_normals;   // w is 0.
+	std::vector<glm::vec2> m_uvs;
+
+	std::vector<PMXSkinWeights> m_skinWeights;
+	std::vector<PMXSphericalVertex> m_sphericalVertices;
+	bool m_bVertexMorphs = false;
+};
+
+extern bool pmxSkinningKernelUseAVX();
+
+// NOTE: Golden pose of a generated rig plus kernel and job consistency checks, logs failures.
+extern bool runPMXAnimationSelfTest();
+
+// NOTE: Evaluates and skins a generated rig of vertexCount vertices, logs bones and vertices per ms.
+extern void runPMXAnimationBenchmark(uint32_t vertexCount);
+
+}
@@ -3,9 +3,91 @@
 #include "texture.h"
 #include "../core/file_system.h"
 #include "../asset_system/asset_texture.h"
+#include "../core/crc.h"
+#include "../core/job_system.h"
+#include <chrono>
+#include <thread>
 
 namespace engine{
-	
+
+static AutoCVarInt32 cVarPMXCookedCache(
+	"r.PMX.CookedCache",
+	"Load pmx files from a cooked copy of the parsed file, written on the first load. The cooked file is larger than the source, it pays off for models with many morphs and names.",
+	"PMX",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+// NOTE: Storage buffers of pmx_skinning.comp, read by every component of the mesh.
+template<typename T>
+static VulkanBuffer* createSkinningBuffer(std::vector<T>& data)
+{
+	// zero sized buffers are invalid, keep one unused element.
+	if(data.empty())
+	{
+		data.push_back({});
+	}
+	const VkDeviceSize bufferSize = VkDeviceSize(sizeof(T) * data.size());
+
+	VulkanBuffer* stageBuffer = VulkanBuffer::create(
+		VulkanRHI::get()->getVulkanDevice(),
+		VulkanRHI::get()->getGraphicsCommandPool(),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		bufferSize,
+		(void*)data.data()
+	);
+
+	VulkanBuffer* buffer = VulkanBuffer::create(
+		VulkanRHI::get()->getVulkanDevice(),
+		VulkanRHI::get()->getGraphicsCommandPool(),
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		bufferSize,
+		nullptr
+	);
+	buffer->stageCopyFrom(*stageBuffer,bufferSize,VulkanRHI::get()->getVulkanDevice()->graphicsQueue);
+
+	delete stageBuffer;
+	return buffer;
+}
+
+static GPUPMXSkinVertex buildSkinVertex(const asset_system::PMXVertex& vertex,const PMXSkinWeights& weights)
+{
+	GPUPMXSkinVertex skin {};
+	skin.boneIndices = weights.boneIndices;
+	skin.boneWeights = weights.boneWeights;
+
+	switch(vertex.m_weightType)
+	{
+	case asset_system::PMXVertexWeight::SDEF:
+		skin.weightType = EPMXSkinType::Spherical;
+		skin.sdefC = glm::vec4(vertex.m_sdefC,0.0f);
+		skin.sdefR0 = glm::vec4(vertex.m_sdefR0,0.0f);
+		skin.sdefR1 = glm::vec4(vertex.m_sdefR1,0.0f);
+		break;
+	case asset_system::PMXVertexWeight::QDEF:
+		skin.weightType = EPMXSkinType::DualQuat;
+		break;
+	default:
+		skin.weightType = EPMXSkinType::Linear;
+		break;
+	}
+	return skin;
+}
+
+// NOTE: Cpu side of a pmx mesh built by a loading job, textures and gpu buffers are created on the main thread.
+struct PMXLoadResult
+{
+	std::string name;
+	PMXMesh* mesh = nullptr; // nullptr if the file failed to load.
+
+	std::vector<GPUPMXSkinVertex> skinVertices;
+	std::vector<GPUPMXMorphVertex> morphVertices;
+	std::vector<float> bindVertices; // interleaved as getPMXMeshAttributes.
+};
 
 PMXManager* PMXManager::get()
 {
@@ -13,206 +95,364 @@ PMXManager* PMXManager::get()
 	return &manager;
 }
 
-PMXMesh* PMXManager::getPMX(const std::string& name)
+static std::string getCookedPMXPath(const std::string& name)
 {
-	if(m_cache.find(name) == m_cache.end())
+	const uint32 hash = Crc::memCrc32(name.data(),(int32)name.size());
+	return std::string(s_enginePMXCache) + std::to_string(hash) + ".pmxc";
+}
+
+static bool readPMXFile(const std::string& name,bool bCookedCache,asset_system::PMXFile& pmxFile)
+{
+	if(!bCookedCache)
+	{
+		return asset_system::ReadPMXFile(&pmxFile,name.c_str());
+	}
+
+	const std::string cookedPath = getCookedPMXPath(name);
+	if(asset_system::ReadCookedPMXFile(&pmxFile,cookedPath.c_str(),name.c_str()))
+	{
+		return true;
+	}
+
+	pmxFile = {};
+	if(!asset_system::ReadPMXFile(&pmxFile,name.c_str()))
 	{
-		asset_system::PMXFile pmxFile;
+		return false;
+	}
+	asset_system::WriteCookedPMXFile(pmxFile,cookedPath.c_str(),name.c_str());
+	return true;
+}
 
-		if(asset_system::ReadPMXFile(&pmxFile,name.c_str()))
+// NOTE: Runs on a job, everything here is cpu only.
+PMXMesh* PMXManager::buildPMXMesh(const std::string& name,const asset_system::PMXFile& pmxFile,PMXLoadResult& result)
+{
+	// faces of the materials must be in the file, the index packing below trusts them.
+	uint32_t indicesCount = 0;
+	size_t faceCount = 0;
+	for(auto& mat : pmxFile.m_materials)
+	{
+		if(mat.m_numFaceVertices < 0)
 		{
-			// build pmx mesh
-			PMXMesh* newMesh = new PMXMesh();
+			faceCount = ~size_t(0);
+			break;
+		}
+		indicesCount += mat.m_numFaceVertices;
+		faceCount += size_t(mat.m_numFaceVertices / 3);
+	}
+	if(faceCount > pmxFile.m_faces.size())
+	{
+		LOG_ERROR("Pmx file {0} has materials with more faces than the file.",name);
+		return nullptr;
+	}
 
-			// 0. prepare path.
-			auto end_pos = name.find_last_of("/\\");
-			std::string pmx_folder_path;
-			if(end_pos!=std::string::npos)
+	// cooked files skip the parser checks, an index past the vertices would read out of the vertex buffer.
+	const size_t fileVertexCount = pmxFile.m_vertices.size();
+	for(size_t i = 0; i < faceCount; i++)
+	{
+		for(auto vertex : pmxFile.m_faces[i].m_vertices)
+		{
+			if(size_t(vertex) >= fileVertexCount)
 			{
-				pmx_folder_path = name.substr(0,end_pos);
+				LOG_ERROR("Pmx file {0} has a face index {1} out of its {2} vertices.",name,vertex,fileVertexCount);
+				return nullptr;
 			}
-			pmx_folder_path += "/";
+		}
+	}
 
-			// 1. prepare data.
-			newMesh->m_materials.resize(pmxFile.m_materials.size());
-			newMesh->m_subMeshes.resize(pmxFile.m_materials.size());
+	// build pmx mesh
+	PMXMesh* newMesh = new PMXMesh();
 
-			newMesh->m_positions.resize(pmxFile.m_vertices.size() * 3);
-			newMesh->m_normals.resize(  pmxFile.m_vertices.size() * 3);
-			newMesh->m_uvs.resize(      pmxFile.m_vertices.size() * 2);
+	// 0. prepare path.
+	auto end_pos = name.find_last_of("/\\");
+	std::string pmx_folder_path;
+	if(end_pos!=std::string::npos)
+	{
+		pmx_folder_path = name.substr(0,end_pos);
+	}
+	pmx_folder_path += "/";
 
-			// 2. pack raw vertices data.
-			for(auto i_v = 0; i_v < pmxFile.m_vertices.size(); i_v ++)
-			{
-				auto pos_index    = 3 * i_v;
-				auto normal_index = 3 * i_v;
-				auto uv0_index    = 2 * i_v;
+	// 1. prepare data.
+	newMesh->m_materials.resize(pmxFile.m_materials.size());
+	newMesh->m_subMeshes.resize(pmxFile.m_materials.size());
 
-				newMesh->m_positions[pos_index]     = pmxFile.m_vertices[i_v].m_position.x;
-				newMesh->m_positions[pos_index + 1] = pmxFile.m_vertices[i_v].m_position.y;
-				newMesh->m_positions[pos_index + 2] = pmxFile.m_vertices[i_v].m_position.z;
+	newMesh->m_positions.resize(pmxFile.m_vertices.size() * 3);
+	newMesh->m_normals.resize(  pmxFile.m_vertices.size() * 3);
+	newMesh->m_uvs.resize(      pmxFile.m_vertices.size() * 2);
 
-				newMesh->m_normals[normal_index]     = pmxFile.m_vertices[i_v].m_normal.x;
-				newMesh->m_normals[normal_index + 1] = pmxFile.m_vertices[i_v].m_normal.y;
-				newMesh->m_normals[normal_index + 2] = pmxFile.m_vertices[i_v].m_normal.z;
+	// 2. pack raw vertices data.
+	for(auto i_v = 0; i_v < pmxFile.m_vertices.size(); i_v ++)
+	{
+		auto pos_index    = 3 * i_v;
+		auto normal_index = 3 * i_v;
+		auto uv0_index    = 2 * i_v;
 
-				newMesh->m_uvs[uv0_index]     = pmxFile.m_vertices[i_v].m_uv.x;
-				newMesh->m_uvs[uv0_index + 1] = pmxFile.m_vertices[i_v].m_uv.y;
-			}
+		newMesh->m_positions[pos_index]     = pmxFile.m_vertices[i_v].m_position.x;
+		newMesh->m_positions[pos_index + 1] = pmxFile.m_vertices[i_v].m_position.y;
+		newMesh->m_positions[pos_index + 2] = pmxFile.m_vertices[i_v].m_position.z;
 
-			// 3. prepare mmd textures.
-			//  for mmd mesh asset, i want to keep best quality so don't do any compress.
-			auto* textureLibrary = TextureLibrary::get();
-			for(auto mat_i = 0; mat_i < pmxFile.m_materials.size(); mat_i++)
+		newMesh->m_normals[normal_index]     = pmxFile.m_vertices[i_v].m_normal.x;
+		newMesh->m_normals[normal_index + 1] = pmxFile.m_vertices[i_v].m_normal.y;
+		newMesh->m_normals[normal_index + 2] = pmxFile.m_vertices[i_v].m_normal.z;
+
+		newMesh->m_uvs[uv0_index]     = pmxFile.m_vertices[i_v].m_uv.x;
+		newMesh->m_uvs[uv0_index + 1] = pmxFile.m_vertices[i_v].m_uv.y;
+	}
+
+	// 2.1 bones, morphs and weights, evaluated on the cpu every frame.
+	newMesh->m_animation.build(pmxFile);
+
+	// 2.2 skin weights and the position and uv morph offsets of every vertex.
+	const size_t vertexCount = pmxFile.m_vertices.size();
+	const auto& skinWeights = newMesh->m_animation.getSkinWeights();
+	auto& skinVertices = result.skinVertices;
+	skinVertices.resize(vertexCount);
+	for(size_t i_v = 0; i_v < vertexCount; i_v++)
+	{
+		skinVertices[i_v] = buildSkinVertex(pmxFile.m_vertices[i_v],skinWeights[i_v]);
+	}
+
+	const auto& morphs = newMesh->m_animation.getMorphs();
+	auto forEachMorphVertex = [&](auto&& func)
+	{
+		for(size_t i_m = 0; i_m < morphs.size(); i_m++)
+		{
+			for(const auto& offset : morphs[i_m].vertexOffsets)
 			{
-				auto& set_mat = newMesh->m_materials[mat_i];
-				auto& process_mat = pmxFile.m_materials[mat_i];
-
-				CHECK(textureLibrary->m_textureContainer[s_defaultCheckboardTextureName].bReady);
-
-				uint32_t fallbackId = textureLibrary->m_textureContainer[s_defaultCheckboardTextureName].bindingIndex;
-
-				// base color
-				if(process_mat.m_textureIndex >= 0)
-				{
-					auto base_color_path = pmx_folder_path + pmxFile.m_textures[process_mat.m_textureIndex].m_textureName;
-					if(textureLibrary->m_textureContainer.find(base_color_path)==textureLibrary->m_textureContainer.end())
-					{
-						textureLibrary->m_textureContainer[base_color_path] = {};
-						auto& texture = textureLibrary->m_textureContainer[base_color_path];
-						texture.sampler = VulkanRHI::get()->getLinearRepeatSampler();
-						texture.texture = asset_system::loadFromFile(base_color_path,VK_FORMAT_R8G8B8A8_SRGB,4,false,true);
-						texture.bReady = true;
-						TextureLibrary::get()->updateTextureToBindlessDescriptorSet(texture);
-					}
-
-					set_mat.baseColorTextureName = base_color_path;
-					set_mat.baseColorTextureId = textureLibrary->m_textureContainer[base_color_path].bindingIndex;
-				}
-				else
-				{
-					set_mat.baseColorTextureName = s_defaultCheckboardTextureName;
-					set_mat.baseColorTextureId = fallbackId;
-				}
-
-				// toon lut
-				if(process_mat.m_toonTextureIndex >=0 )
-				{
-					auto toon_path = pmx_folder_path + pmxFile.m_textures[process_mat.m_toonTextureIndex].m_textureName;
-
-					if(textureLibrary->m_textureContainer.find(toon_path)==textureLibrary->m_textureContainer.end())
-					{
-						textureLibrary->m_textureContainer[toon_path] = {};
-
-						auto& texture = textureLibrary->m_textureContainer[toon_path];
-
-						texture.sampler = VulkanRHI::get()->getLinearRepeatSampler();
-						texture.texture = asset_system::loadFromFile(toon_path,VK_FORMAT_R8G8B8A8_SRGB,4,false,true);
-						texture.bReady = true;
-						TextureLibrary::get()->updateTextureToBindlessDescriptorSet(texture);
-					}
-
-					
-
-					set_mat.toonTextureName = toon_path;
-					set_mat.toonTextureId = textureLibrary->m_textureContainer[toon_path].bindingIndex;
-				}
-				else
-				{
-					set_mat.toonTextureId = fallbackId;
-					set_mat.toonTextureName = s_defaultCheckboardTextureName;
-				}
-
-
-				// sphere texture
-				if(process_mat.m_sphereTextureIndex >= 0)
-				{
-					auto sphere_tex_path = pmx_folder_path + pmxFile.m_textures[process_mat.m_sphereTextureIndex].m_textureName;
-
-					if(textureLibrary->m_textureContainer.find(sphere_tex_path)==textureLibrary->m_textureContainer.end())
-					{
-						textureLibrary->m_textureContainer[sphere_tex_path] = {};
-
-						auto& texture = textureLibrary->m_textureContainer[sphere_tex_path];
-
-						texture.sampler = VulkanRHI::get()->getLinearRepeatSampler();
-						texture.texture = asset_system::loadFromFile(sphere_tex_path,VK_FORMAT_R8G8B8A8_SRGB,4,false,true);
-						texture.bReady = true;
-						TextureLibrary::get()->updateTextureToBindlessDescriptorSet(texture);
-					}
-
-					
-
-					set_mat.sphereTextureId = textureLibrary->m_textureContainer[sphere_tex_path].bindingIndex;
-					set_mat.sphereTextureName = sphere_tex_path;
-				}
-				else
-				{
-					set_mat.sphereTextureId = fallbackId;
-					set_mat.sphereTextureName = s_defaultCheckboardTextureName;
-				}
+				func(uint32_t(i_m),offset.vertexIndex,glm::vec4(offset.position,0.0f),glm::vec4(offset.uv,0.0f,0.0f));
 			}
+		}
+	};
+
+	// NOTE: Offsets are grouped by vertex, a skinning thread only walks the offsets of its vertex.
+	forEachMorphVertex([&](uint32_t,uint32_t vertexIndex,const glm::vec4&,const glm::vec4&)
+	{
+		skinVertices[vertexIndex].morphCount++;
+	});
+	uint32_t morphVertexCount = 0;
+	for(auto& skin : skinVertices)
+	{
+		skin.morphStart = morphVertexCount;
+		morphVertexCount += skin.morphCount;
+		skin.morphCount = 0;
+	}
+	auto& morphVertices = result.morphVertices;
+	morphVertices.resize(morphVertexCount);
+	forEachMorphVertex([&](uint32_t morphIndex,uint32_t vertexIndex,const glm::vec4& position,const glm::vec4& uv)
+	{
+		auto& skin = skinVertices[vertexIndex];
+		auto& morphVertex = morphVertices[skin.morphStart + skin.morphCount];
+		morphVertex.position = position;
+		morphVertex.uv = uv;
+		morphVertex.morphIndex = morphIndex;
+		skin.morphCount++;
+	});
+	newMesh->m_morphVertexCount = morphVertexCount;
+
+	// 3. prepare mmd texture paths, the textures load on the main thread.
+	auto texturePath = [&](int32_t textureIndex)
+	{
+		if(textureIndex >= 0 && size_t(textureIndex) < pmxFile.m_textures.size())
+		{
+			return pmx_folder_path + pmxFile.m_textures[textureIndex].m_textureName;
+		}
+		return std::string(s_defaultCheckboardTextureName);
+	};
+	for(auto mat_i = 0; mat_i < pmxFile.m_materials.size(); mat_i++)
+	{
+		auto& set_mat = newMesh->m_materials[mat_i];
+		auto& process_mat = pmxFile.m_materials[mat_i];
+
+		set_mat.baseColorTextureName = texturePath(process_mat.m_textureIndex);
+		set_mat.toonTextureName = texturePath(process_mat.m_toonTextureIndex);
+		set_mat.sphereTextureName = texturePath(process_mat.m_sphereTextureIndex);
+	}
+
+	// 4. prepare submesh
+	newMesh->m_indices.resize(indicesCount);
+	int32_t start_face_point = 0;
+	int32_t material_id = 0;
+	int32_t indexLoop = 0;
+	for(auto& mat : pmxFile.m_materials)
+	{
+		auto& processing_submesh = newMesh->m_subMeshes[material_id];
+		
 
-			// 4. prepare submesh
-			uint32_t indicesCount = 0;
-			for(auto& mat : pmxFile.m_materials)
+		processing_submesh.beginIndex  = indexLoop;
+		processing_submesh.vertexCount = mat.m_numFaceVertices;
+		processing_submesh.materialId  = material_id;
+
+		material_id ++;
+
+		// pack all face data in mesh
+		auto face_num = mat.m_numFaceVertices / 3;
+		int32_t end_face_point = start_face_point + face_num;
+		for(auto face_id = start_face_point; face_id < end_face_point; face_id++)
+		{
+			auto& face = pmxFile.m_faces[face_id];
+			for(auto vertex : face.m_vertices)
 			{
-				indicesCount += mat.m_numFaceVertices;
+				newMesh->m_indices[indexLoop] = vertex;
+				indexLoop ++;
 			}
-			newMesh->m_indices.resize(indicesCount);
-			int32_t start_face_point = 0;
-			int32_t material_id = 0;
-			int32_t indexLoop = 0;
-			for(auto& mat : pmxFile.m_materials)
+		}
+		start_face_point = end_face_point;
+	}
+
+	// 5. bind pose and skinning input, every component skins from them.
+	auto& bindVertices = result.bindVertices;
+	bindVertices.resize(vertexCount * 8);
+	for(size_t i_v = 0; i_v < vertexCount; i_v++)
+	{
+		float* dest = &bindVertices[i_v * 8];
+		memcpy(dest + 0,&newMesh->m_positions[i_v * 3],sizeof(float) * 3);
+		memcpy(dest + 3,&newMesh->m_normals[i_v * 3],sizeof(float) * 3);
+		memcpy(dest + 6,&newMesh->m_uvs[i_v * 2],sizeof(float) * 2);
+	}
+
+	return newMesh;
+}
+
+// NOTE: Main thread, loads the textures and creates the gpu buffers of a mesh built by a job.
+void PMXManager::uploadPMXMesh(PMXLoadResult& result)
+{
+	PMXMesh* newMesh = result.mesh;
+
+	// for mmd mesh asset, i want to keep best quality so don't do any compress.
+	auto* textureLibrary = TextureLibrary::get();
+	CHECK(textureLibrary->m_textureContainer[s_defaultCheckboardTextureName].bReady);
+
+	auto loadTexture = [&](const std::string& path)
+	{
+		if(textureLibrary->m_textureContainer.find(path)==textureLibrary->m_textureContainer.end())
+		{
+			textureLibrary->m_textureContainer[path] = {};
+			auto& texture = textureLibrary->m_textureContainer[path];
+			texture.sampler = VulkanRHI::get()->getLinearRepeatSampler();
+			texture.texture = asset_system::loadFromFile(path,VK_FORMAT_R8G8B8A8_SRGB,4,false,true);
+			texture.bReady = true;
+			TextureLibrary::get()->updateTextureToBindlessDescriptorSet(texture);
+		}
+		return textureLibrary->m_textureContainer[path].bindingIndex;
+	};
+
+	for(auto& set_mat : newMesh->m_materials)
+	{
+		set_mat.baseColorTextureId = loadTexture(set_mat.baseColorTextureName);
+		set_mat.toonTextureId = loadTexture(set_mat.toonTextureName);
+		set_mat.sphereTextureId = loadTexture(set_mat.sphereTextureName);
+	}
+
+	// create index buffer and vertex buffer.
+	CHECK(newMesh->m_indexBuffer == nullptr);
+
+	// init and upload indices data.
+	newMesh->m_indexBuffer = VulkanIndexBuffer::create(
+		VulkanRHI::get()->getVulkanDevice(),
+		VulkanRHI::get()->getGraphicsCommandPool(),
+		newMesh->m_indices
+	);
+
+	newMesh->m_bindVertexBuffer = createSkinningBuffer(result.bindVertices);
+	newMesh->m_skinVertexBuffer = createSkinningBuffer(result.skinVertices);
+	newMesh->m_morphVertexBuffer = createSkinningBuffer(result.morphVertices);
+}
+
+PMXMesh* PMXManager::getPMX(const std::string& name)
+{
+	auto it = m_cache.find(name);
+	if(it != m_cache.end())
+	{
+		return it->second;
+	}
+
+	commitPendingResults();
+
+	it = m_cache.find(name);
+	if(it != m_cache.end())
+	{
+		return it->second;
+	}
+
+	if(m_loading.find(name) == m_loading.end() && m_failed.find(name) == m_failed.end())
+	{
+		requestLoad(name);
+	}
+	return nullptr;
+}
+
+void PMXManager::requestLoad(const std::string& name)
+{
+	const bool bCookedCache = cVarPMXCookedCache.get() != 0;
+
+	m_loading.insert(name);
+	m_loadingJobs ++;
+	jobsystem::execute([this,name,bCookedCache]()
+	{
+		using Clock = std::chrono::steady_clock;
+		const auto begin = Clock::now();
+
+		auto result = std::make_unique<PMXLoadResult>();
+		result->name = name;
+		{
+			asset_system::PMXFile pmxFile;
+			if(readPMXFile(name,bCookedCache,pmxFile))
 			{
-				auto& processing_submesh = newMesh->m_subMeshes[material_id];
-				
-
-				processing_submesh.beginIndex  = indexLoop;
-				processing_submesh.vertexCount = mat.m_numFaceVertices;
-				processing_submesh.materialId  = material_id;
-
-				material_id ++;
-
-				// pack all face data in mesh
-				auto face_num = mat.m_numFaceVertices / 3;
-				int32_t end_face_point = start_face_point + face_num;
-				for(auto face_id = start_face_point; face_id < end_face_point; face_id++)
-				{
-					auto& face = pmxFile.m_faces[face_id];
-					for(auto vertex : face.m_vertices)
-					{
-						newMesh->m_indices[indexLoop] = vertex;
-						indexLoop ++;
-					}
-				}
-				start_face_point = end_face_point;
+				result->mesh = buildPMXMesh(name,pmxFile,*result);
 			}
+		}
 
-			// 5. create index buffer and vertex buffer.
-			CHECK(newMesh->m_indexBuffer == nullptr);
-
-			// init and upload indices data.
-			newMesh->m_indexBuffer = VulkanIndexBuffer::create(
-				VulkanRHI::get()->getVulkanDevice(),
-				VulkanRHI::get()->getGraphicsCommandPool(),
-				newMesh->m_indices
-			);
-			
+		if(result->mesh)
+		{
+			LOG_INFO("Loaded pmx {0} in {1:.2f} ms.",name,std::chrono::duration<double,std::milli>(Clock::now() - begin).count());
+		}
 
-			m_cache[name] = newMesh;
-			return newMesh;
+		{
+			std::lock_guard lock(m_pendingMutex);
+			m_pendingResults.push_back(std::move(result));
 		}
-		return nullptr;
+		m_loadingJobs --;
+	});
+}
+
+void PMXManager::commitPendingResults()
+{
+	std::vector<std::unique_ptr<PMXLoadResult>> pendingResults;
+	{
+		std::lock_guard lock(m_pendingMutex);
+		pendingResults.swap(m_pendingResults);
 	}
-	else
+
+	for(auto& result : pendingResults)
 	{
-		return m_cache[name];
+		m_loading.erase(result->name);
+		if(result->mesh == nullptr)
+		{
+			LOG_ERROR("Failed to load pmx {0}.",result->name);
+			m_failed.insert(result->name);
+			continue;
+		}
+
+		uploadPMXMesh(*result);
+		m_cache[result->name] = result->mesh;
 	}
 }
 
 void PMXManager::release()
 {
+	// NOTE: Loading jobs hold this module.
+	while(m_loadingJobs.load() > 0)
+	{
+		std::this_thread::yield();
+	}
+
+	for(auto& result : m_pendingResults)
+	{
+		delete result->mesh;
+	}
+	m_pendingResults.clear();
+	m_loading.clear();
+	m_failed.clear();
+
 	for(auto& pair : m_cache)
 	{
 		delete pair.second;
@@ -232,6 +472,22 @@ VkDeviceSize PMXMesh::getTotalVertexSize() const
 	);
 }
 
+void PMXMesh::evaluatePose(PMXPose& pose,GPUPMXBone* outBones,float* outMorphWeights) const
+{
+	m_animation.evaluatePose(pose);
+
+	for(uint32_t i = 0; i < getBoneCount(); i++)
+	{
+		const glm::quat& rotation = pose.skinRotations[i];
+		outBones[i].rotation = glm::vec4(rotation.x,rotation.y,rotation.z,rotation.w);
+		outBones[i].translation = glm::vec4(pose.skinTranslations[i],0.0f);
+	}
+	for(uint32_t i = 0; i < getMorphCount(); i++)
+	{
+		outMorphWeights[i] = pose.resolvedMorphWeights[i];
+	}
+}
+
 PMXMesh::~PMXMesh()
 {
 	if(m_indexBuffer)
@@ -239,6 +495,15 @@ PMXMesh::~PMXMesh()
 		delete m_indexBuffer;
 		m_indexBuffer = nullptr;
 	}
+
+	for(VulkanBuffer** buffer : { &m_bindVertexBuffer, &m_skinVertexBuffer, &m_morphVertexBuffer })
+	{
+		if(*buffer)
+		{
+			delete *buffer;
+			*buffer = nullptr;
+		}
+	}
 }
 
 }
@@ -1,7 +1,12 @@
 #pragma once
 #include "../core/core.h"
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include "../vk/vk_rhi.h"
+#include "pmx_animation.h"
+#include <mutex>
+#include <atomic>
+#include <unordered_set>
 
 // NOTE: pmx ģ͵Ⱦ
 // ΪкܶඨƵķshadingModel.Ҫcpu˽IK
@@ -33,6 +38,42 @@ struct PMXSubMesh
 	int32_t materialId;
 };
 
+// NOTE: Same layout as PMXSkinVertex in pmx_skinning.comp.
+struct GPUPMXSkinVertex
+{
+	glm::uvec4 boneIndices;
+	glm::vec4 boneWeights; // normalized at load, unused slots are zero.
+
+	glm::vec4 sdefC;       // .xyz, SDEF only.
+	glm::vec4 sdefR0;
+	glm::vec4 sdefR1;
+
+	uint32 weightType;     // EPMXSkinType.
+	uint32 morphStart;     // first GPUPMXMorphVertex of the vertex.
+	uint32 morphCount;
+	uint32 pad;
+};
+
+// NOTE: Same layout as PMXMorphVertex in pmx_skinning.comp.
+struct GPUPMXMorphVertex
+{
+	glm::vec4 position; // .xyz offset at full weight.
+	glm::vec4 uv;       // .xy offset at full weight.
+
+	uint32 morphIndex;
+	uint32 pad0;
+	uint32 pad1;
+	uint32 pad2;
+};
+
+// NOTE: Same layout as PMXBone in pmx_skinning.comp. Bind pose to posed model space,
+//       rotate around the model origin, then translate.
+struct GPUPMXBone
+{
+	glm::vec4 rotation;    // quaternion .xyzw
+	glm::vec4 translation; // .xyz
+};
+
 inline std::vector<EVertexAttribute> getPMXMeshAttributes()
 {
 	return std::vector<EVertexAttribute>{
@@ -53,7 +94,15 @@ private:
 	std::vector<float> m_normals;   // vec3
 	std::vector<float> m_uvs;       // vec2
 
-	
+private:
+	// bones, morphs and weights, the pose is evaluated on the cpu every frame.
+	PMXAnimation m_animation;
+
+	// static input of pmx_skinning.comp, uploaded once.
+	VulkanBuffer* m_bindVertexBuffer = nullptr; // interleaved as getPMXMeshAttributes.
+	VulkanBuffer* m_skinVertexBuffer = nullptr; // GPUPMXSkinVertex per vertex.
+	VulkanBuffer* m_morphVertexBuffer = nullptr; // GPUPMXMorphVertex, grouped by vertex.
+	uint32_t m_morphVertexCount = 0;
 
 private:
 	// index buffers.
@@ -69,15 +118,49 @@ private:
 public:
 	~PMXMesh();
 	VkDeviceSize getTotalVertexSize() const;
+
+	uint32_t getVertexCount() const { return uint32_t(m_positions.size() / 3); }
+	uint32_t getBoneCount() const { return m_animation.getBoneCount(); }
+	uint32_t getMorphCount() const { return m_animation.getMorphCount(); }
+	const PMXAnimation& getAnimation() const { return m_animation; }
+
+	// -1 if not found.
+	int32_t findBone(const std::string& name) const { return m_animation.findBone(name); }
+	int32_t findMorph(const std::string& name) const { return m_animation.findMorph(name); }
+
+	// Evaluates the pose, see PMXAnimation::evaluatePose, and writes the skin transform of every bone
+	// and the resolved morph weights for pmx_skinning.comp.
+	void evaluatePose(PMXPose& pose,GPUPMXBone* outBones,float* outMorphWeights) const;
 };
 
+struct PMXLoadResult;
+
+// NOTE: Pmx files are parsed and packed by a job, the first getPMX of a file starts it and returns
+//       nullptr until a later call on the main thread finds the result and uploads it.
 class PMXManager
 {
 private:
 	std::unordered_map<std::string, PMXMesh*> m_cache;
 
+	// main thread only.
+	std::unordered_set<std::string> m_loading;
+	std::unordered_set<std::string> m_failed; // not retried every tick.
+
+	// NOTE: Written by loading jobs, consumed on the main thread.
+	std::mutex m_pendingMutex;
+	std::vector<std::unique_ptr<PMXLoadResult>> m_pendingResults;
+	std::atomic<uint32> m_loadingJobs = 0;
+
+	void requestLoad(const std::string& name);
+	void commitPendingResults();
+
+	static PMXMesh* buildPMXMesh(const std::string& name,const asset_system::PMXFile& pmxFile,PMXLoadResult& result);
+	static void uploadPMXMesh(PMXLoadResult& result);
+
 public:
 	static PMXManager* get();
+
+	// nullptr while the file is loading or if it failed to load.
 	PMXMesh* getPMX(const std::string& name);
 
 	void release();
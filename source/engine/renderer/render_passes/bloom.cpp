@@ -66,7 +66,7 @@ void engine::BloomPass::afterSceneTextureRecreate()
 
 void engine::BloomPass::dynamicRecord(uint32 backBufferIndex)
 {
-	VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+	VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
 	commandBufBegin(backBufferIndex);
 	
 	CHECK(m_verticalBlur.size() == g_downsampleCount);
@@ -92,6 +92,7 @@ void engine::BloomPass::dynamicRecord(uint32 backBufferIndex)
 	{
 		// from mip #5 blur
 		// then mix last blend mip.
+		GpuProfileScope levelScope(cmd,"BloomLevel",loopId);
 
 		VkExtent2D blurExtent2D = { widthChain[loopId + 1], heightChain[loopId +1] };
 		CHECK(m_horizontalBlur[loopId]->getInfo().extent.width  == widthChain[loopId + 1]);
@@ -99,10 +100,10 @@ void engine::BloomPass::dynamicRecord(uint32 backBufferIndex)
 
 		// horizonral blur 
 		{
-			
+			GpuProfileScope blurScope(cmd,"HorizontalBlur");
 
 			VkRenderPassBeginInfo rpInfo = vkRenderpassBeginInfo(
-				getRenderpass(),
+				m_blurRenderpass,
 				blurExtent2D,
 				m_horizontalBlurFramebuffers[loopId]
 			);
@@ -163,8 +164,9 @@ void engine::BloomPass::dynamicRecord(uint32 backBufferIndex)
 
 		// vertical blur
 		{
+			GpuProfileScope blurScope(cmd,"VerticalBlur");
 			VkRenderPassBeginInfo rpInfo = vkRenderpassBeginInfo(
-				getRenderpass(),
+				m_blurRenderpass,
 				blurExtent2D,
 				m_verticalBlurFramebuffers[loopId]
 			);
@@ -226,6 +228,7 @@ void engine::BloomPass::dynamicRecord(uint32 backBufferIndex)
 		
 		// blend with last mip
 		{
+			GpuProfileScope blendScope(cmd,"Blend");
 			VkRenderPassBeginInfo rpInfo = vkRenderpassBeginInfo(
 				getRenderpass(),
 				blendExtent2D,
@@ -320,11 +323,13 @@ void BloomPass::createRenderpass()
 	std::array<VkSubpassDependency,2> dependencies;
 	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependencies[0].dstSubpass = 0;
-	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	// NOTE: Waits for the reads of the previous pass too, blur targets alias each other's memory
+	//       and differ in size, so no by region here.
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT|VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT|VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+	dependencies[0].dependencyFlags = 0;
 	dependencies[1].srcSubpass = 0;
 	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -344,11 +349,17 @@ void BloomPass::createRenderpass()
 
 	m_renderpass = VulkanRHI::get()->createRenderpass(render_pass_info);
 
+	// NOTE: Compatible with the pass above. Blur targets are pooled and aliased, their content is
+	//       undefined before every blur and the fullscreen draw overwrites all of it.
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	m_blurRenderpass = VulkanRHI::get()->createRenderpass(render_pass_info);
 }
 
 void BloomPass::destroyRenderpass()
 {
 	VulkanRHI::get()->destroyRenderpass(m_renderpass);
+	VulkanRHI::get()->destroyRenderpass(m_blurRenderpass);
 }
 
 void BloomPass::createPipeline()
@@ -378,13 +389,13 @@ void BloomPass::createPipeline()
 			// all bloom descriptor set layout same so just init one.
 			if(index == 0)
 			{
-				m_renderer->vkDynamicDescriptorFactoryBegin(0)
+				VulkanRHI::get()->vkCachedDescriptorFactoryBegin()
 					.bindImage(0,&horizontalBlurInputImage,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,VK_SHADER_STAGE_FRAGMENT_BIT)
 					.build(m_horizontalBlurDescriptorSets[index],m_descriptorSetLayout);
 			}
 			else
 			{
-				m_renderer->vkDynamicDescriptorFactoryBegin(0)
+				VulkanRHI::get()->vkCachedDescriptorFactoryBegin()
 					.bindImage(0,&horizontalBlurInputImage,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,VK_SHADER_STAGE_FRAGMENT_BIT)
 					.build(m_horizontalBlurDescriptorSets[index]);
 			}
@@ -406,7 +417,7 @@ void BloomPass::createPipeline()
 			//				  horizontal blur mip #5
 			verticalBlurInputImage.imageView = m_horizontalBlur[index]->getImageView();
 
-			m_renderer->vkDynamicDescriptorFactoryBegin(0)
+			VulkanRHI::get()->vkCachedDescriptorFactoryBegin()
 				.bindImage(0,&verticalBlurInputImage,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,VK_SHADER_STAGE_FRAGMENT_BIT)
 				.build(m_verticalBlurDescriptorSets[index]);
 		}
@@ -427,7 +438,7 @@ void BloomPass::createPipeline()
 			//			   vertical blur mip #5
 			blendInputImage.imageView = m_verticalBlur[index]->getImageView();
 
-			m_renderer->vkDynamicDescriptorFactoryBegin(0)
+			VulkanRHI::get()->vkCachedDescriptorFactoryBegin()
 				.bindImage(0,&blendInputImage,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,VK_SHADER_STAGE_FRAGMENT_BIT)
 				.build(m_blendDescriptorSets[index]);
 		}
@@ -606,16 +617,16 @@ void BloomPass::destroyPipeline()
 
 	for(uint32 index = 0; index < m_blurPipelines.size(); index++)
 	{
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_blurPipelines[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_blurPipelineLayouts[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_blurPipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_blurPipelineLayouts[index]);
 	}
 	m_blurPipelines.resize(0);
 	m_blurPipelineLayouts.resize(0);
 
 	for(uint32 index = 0; index < m_blendPipelines.size(); index++)
 	{
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_blendPipelines[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_blendPipelineLayouts[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_blendPipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_blendPipelineLayouts[index]);
 	}
 	m_blendPipelines.resize(0);
 	m_blendPipelineLayouts.resize(0);
@@ -627,12 +638,14 @@ void engine::BloomPass::createFramebuffers()
 {
 	// create local image for bloom tmp rt.
 #pragma region create rt image
-	// horizontal blur image
+	// NOTE: Blur targets of one direction are only alive inside one loop iteration of dynamicRecord,
+	//       so every level of a chain aliases the memory of the biggest one.
 	{
 		uint32 width = m_renderScene->getSceneTextures().getHDRSceneColor()->getExtent().width;
 		uint32 height = m_renderScene->getSceneTextures().getHDRSceneColor()->getExtent().height;
 
-		for(uint32 index = 0; index < m_horizontalBlur.size(); index++)
+		std::vector<RenderTargetDesc> blurDescs(g_downsampleCount);
+		for(uint32 index = 0; index < g_downsampleCount; index++)
 		{
 			/**
 			**  #0 is mip1, #1 is mip2, #2 is mip3, #3 is mip4, #4 is mip5 
@@ -647,57 +660,19 @@ void engine::BloomPass::createFramebuffers()
 			CHECK(width  >= 1);
 			CHECK(height >= 1);
 
-			CHECK(m_horizontalBlur[index] == nullptr);
-
-			m_horizontalBlur[index] = RenderTexture::create(
-				VulkanRHI::get()->getVulkanDevice(),
-				width,
-				height,
-				SceneTextures::getHDRSceneColorFormat()
-			);
-
-			m_horizontalBlur[index]->transitionLayoutImmediately(
-				VulkanRHI::get()->getGraphicsCommandPool(),
-				VulkanRHI::get()->getGraphicsQueue(),
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-			);
+			blurDescs[index] = RenderTargetDesc::color(width,height,SceneTextures::getHDRSceneColorFormat());
 		}
-	}
 
-	// vertical blur image
-	{
-		uint32 width = m_renderScene->getSceneTextures().getHDRSceneColor()->getExtent().width;
-		uint32 height = m_renderScene->getSceneTextures().getHDRSceneColor()->getExtent().height;
-
-		for(uint32 index = 0; index < m_verticalBlur.size(); index++)
+		auto& pool = m_renderer->getRenderTargetPool();
+		auto horizontalBlur = pool.acquireAliased(blurDescs);
+		auto verticalBlur = pool.acquireAliased(blurDescs);
+		for(uint32 index = 0; index < g_downsampleCount; index++)
 		{
-			/**
-			**  #0 is mip1, #1 is mip2, #2 is mip3, #3 is mip4, #4 is mip5 
-			**  so just >> 1 to get actual size.   
-			*/
-
-			width  = width  >> 1;
-			height = height >> 1;
-
-			// min scene texture size is (64u,64u) = (2^6, 2^6).
-			// so there should always pass.
-			CHECK(width  >= 1);
-			CHECK(height >= 1);
-
+			CHECK(m_horizontalBlur[index] == nullptr);
 			CHECK(m_verticalBlur[index] == nullptr);
 
-			m_verticalBlur[index] = RenderTexture::create(
-				VulkanRHI::get()->getVulkanDevice(),
-				width,
-				height,
-				SceneTextures::getHDRSceneColorFormat()
-			);
-
-			m_verticalBlur[index]->transitionLayoutImmediately(
-				VulkanRHI::get()->getGraphicsCommandPool(),
-				VulkanRHI::get()->getGraphicsQueue(),
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-			);
+			m_horizontalBlur[index] = horizontalBlur[index];
+			m_verticalBlur[index] = verticalBlur[index];
 		}
 	}
 #pragma endregion
@@ -825,17 +800,18 @@ void engine::BloomPass::createFramebuffers()
 
 void engine::BloomPass::destroyFramebuffers()
 {
-	// destroy image first
+	// return images to the pool first
 	{
+		auto& pool = m_renderer->getRenderTargetPool();
 		for(uint32 i = 0; i < m_horizontalBlur.size(); i++)
 		{
-			delete m_horizontalBlur[i];
+			pool.release(m_horizontalBlur[i]);
 			m_horizontalBlur[i] = nullptr;
 		}
 
 		for(uint32 i = 0; i < m_verticalBlur.size(); i++)
 		{
-			delete m_verticalBlur[i];
+			pool.release(m_verticalBlur[i]);
 			m_verticalBlur[i] = nullptr;
 		}
 	}
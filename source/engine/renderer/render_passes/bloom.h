@@ -41,6 +41,9 @@ namespace engine
 	private:
 		bool bInitPipeline = false;
 
+		// Used by the blur passes, m_renderpass by the blend passes.
+		VkRenderPass m_blurRenderpass = VK_NULL_HANDLE;
+
 		void createRenderpass();
 		void destroyRenderpass();
 
@@ -213,32 +213,329 @@ void engine::ShadowDepthPass::afterSceneTextureRecreate()
 {
     createFramebuffers();
 	createPipeline();
+
+	// NOTE: Both shadow arrays and the virtual shadow pool were acquired again, their content is undefined.
+	m_renderScene->m_cascadeShadowCache.invalidate();
+	m_renderScene->m_virtualShadowMap.invalidatePool();
 }
 
 void engine::ShadowDepthPass::dynamicRecord(uint32 backBufferIndex)
 {
-	VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+	VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
 	commandBufBegin(backBufferIndex);
 
-	MeshLibrary::get()->bindIndexBuffer(cmd);
 	MeshLibrary::get()->bindVertexBuffer(cmd);
 
-	for(size_t i = 0; i < CASCADE_MAX_COUNT; i++)
+	if(m_renderScene->m_cascadeShadowCache.getPlan().bEnable)
 	{
-		cascadeRecord(cmd,backBufferIndex,ECullIndex(i + 1));
+		cachedRecord(cmd,backBufferIndex);
 	}
-
-	for(size_t i = 0; i < CASCADE_MAX_COUNT; i++)
+	else
 	{
-		pmxCascadeRecord(cmd,backBufferIndex,ECullIndex(i + 1));
+		for(size_t i = 0; i < CASCADE_MAX_COUNT; i++)
+		{
+			GpuProfileScope cascadeScope(cmd,"Cascade",(int32)i);
+			cascadeRecord(cmd,backBufferIndex,ECullIndex(i + 1));
+		}
+
+		for(size_t i = 0; i < CASCADE_MAX_COUNT; i++)
+		{
+			GpuProfileScope cascadeScope(cmd,"PMXCascade",(int32)i);
+			pmxCascadeRecord(cmd,backBufferIndex,ECullIndex(i + 1));
+		}
 	}
 
+	virtualPageRecord(cmd,backBufferIndex);
+
 	commandBufEnd(backBufferIndex);
 }
 
+// NOTE: One render pass over the whole pool. Each page render clears its rect and draws every caster
+//       with the page matrix at render slot i, viewport and scissor keep it inside its page.
+void engine::ShadowDepthPass::virtualPageRecord(VkCommandBuffer& cmd,uint32 backBufferIndex)
+{
+	const auto& plan = m_renderScene->m_virtualShadowMap.getPlan();
+	if(!plan.bClearPool && plan.renders.empty())
+	{
+		return;
+	}
+
+	GpuProfileScope virtualScope(cmd,"VirtualShadowPages");
+
+	auto poolExtent = m_renderScene->getSceneTextures().getVirtualShadowPool()->getExtent();
+	VkExtent2D poolExtent2D{};
+	poolExtent2D.width = poolExtent.width;
+	poolExtent2D.height = poolExtent.height;
+
+	VkRenderPassBeginInfo rpInfo = vkRenderpassBeginInfo(
+		plan.bClearPool ? getRenderpass() : m_pmxRenderpass,
+		poolExtent2D,
+		m_virtualPoolFramebuffers[backBufferIndex]
+	);
+
+	VkClearValue clearValue{};
+	clearValue.depthStencil = { getEngineClearZFar(), 1 };
+	rpInfo.clearValueCount = 1;
+	rpInfo.pClearValues = &clearValue;
+
+	vkCmdBeginRenderPass(cmd,&rpInfo,VK_SUBPASS_CONTENTS_INLINE);
+
+	if(plan.renders.empty())
+	{
+		vkCmdEndRenderPass(cmd);
+		return;
+	}
+
+	const uint32 pageSize = VirtualShadowMap::PAGE_SIZE;
+	auto getPageRect = [&](uint32 physicalPage)
+	{
+		VkRect2D rect{};
+		rect.offset.x = int32((physicalPage % VirtualShadowMap::POOL_SIZE) * pageSize);
+		rect.offset.y = int32((physicalPage / VirtualShadowMap::POOL_SIZE) * pageSize);
+		rect.extent = { pageSize, pageSize };
+		return rect;
+	};
+	auto setPageViewport = [&](uint32 physicalPage)
+	{
+		VkRect2D scissor = getPageRect(physicalPage);
+		VkViewport viewport{};
+		viewport.x = (float)scissor.offset.x;
+		viewport.y = (float)(scissor.offset.y + int32(pageSize)); // flip y on mesh raster
+		viewport.width = (float)pageSize;
+		viewport.height = -(float)pageSize; // flip y on mesh raster
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetScissor(cmd,0,1,&scissor);
+		vkCmdSetViewport(cmd,0,1,&viewport);
+	};
+
+	if(!plan.bClearPool)
+	{
+		std::vector<VkClearRect> clearRects(plan.renders.size());
+		for(size_t i = 0; i < plan.renders.size(); i++)
+		{
+			clearRects[i].rect = getPageRect(plan.renders[i].physicalPage);
+			clearRects[i].baseArrayLayer = 0;
+			clearRects[i].layerCount = 1;
+		}
+
+		VkClearAttachment clearAttachment{};
+		clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		clearAttachment.clearValue = clearValue;
+		vkCmdClearAttachments(cmd,1,&clearAttachment,(uint32)clearRects.size(),clearRects.data());
+	}
+
+	const float depthBiasSlope = reverseZOpen() ? -cVarShadowDepthHardwareSlope.get() : cVarShadowDepthHardwareSlope.get();
+	const float depthBiasFactor = reverseZOpen() ? -cVarShadowDepthBias.get() : cVarShadowDepthBias.get();
+	vkCmdSetDepthBias(cmd,depthBiasFactor,0,depthBiasSlope);
+
+	const auto& drawBuffer = m_renderScene->m_drawIndirectSSBOVirtualShadow;
+	std::vector<VkDescriptorSet> meshPassSets = {
+		  m_renderer->getFrameData().m_frameDataDescriptorSets[backBufferIndex].set
+		, TextureLibrary::get()->getBindlessTextureDescriptorSet()
+		, m_renderer->getRenderScene().m_meshObjectSSBO->descriptorSets.set
+		, m_renderer->getRenderScene().m_meshMaterialSSBO->descriptorSets.set
+		, drawBuffer.descriptorSets.set
+		, m_renderer->getRenderScene().m_virtualShadowBuffer.pageMatrixDescriptorSets[backBufferIndex].set
+	};
+
+	if(!m_renderScene->isSceneStaticMeshEmpty())
+	{
+		MeshLibrary::get()->bindVertexBuffer(cmd);
+
+		vkCmdBindDescriptorSets(
+			cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,
+			m_pipelineLayouts[backBufferIndex],
+			0,
+			(uint32)meshPassSets.size(),
+			meshPassSets.data(),
+			0,
+			nullptr
+		);
+		vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,m_pipelines[backBufferIndex]);
+
+		for(uint32 i = 0; i < (uint32)plan.renders.size(); i++)
+		{
+			setPageViewport(plan.renders[i].physicalPage);
+
+			GPUCascadePushConstants gpuPushConstant = {};
+			gpuPushConstant.cascadeIndex = i; // render slot in the page matrices.
+			vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex], VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUCascadePushConstants), &gpuPushConstant);
+
+			m_renderScene->drawStaticMeshBatches(cmd,drawBuffer);
+		}
+	}
+
+	if(!m_renderScene->m_cachePMXMeshComponents.empty())
+	{
+		vkCmdBindDescriptorSets(
+			cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,
+			m_pmxPipelineLayouts[backBufferIndex],
+			0,
+			(uint32)meshPassSets.size(),
+			meshPassSets.data(),
+			0,
+			nullptr
+		);
+		vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,m_pmxPipelines[backBufferIndex]);
+
+		for(uint32 i = 0; i < (uint32)plan.renders.size(); i++)
+		{
+			setPageViewport(plan.renders[i].physicalPage);
+			for(auto pmxWeakPtr : m_renderScene->m_cachePMXMeshComponents)
+			{
+				if(auto pmxComp = pmxWeakPtr.lock())
+				{
+					pmxComp->OnShadowRenderCollect(cmd, m_pmxPipelineLayouts[backBufferIndex], i);
+				}
+			}
+		}
+	}
+
+	vkCmdEndRenderPass(cmd);
+}
+
+// NOTE: Refreshed cascades draw their static casters into the cache first. Every cascade which has to
+//       change gets a copy of its cache and the dynamic casters on top, the others keep their depth.
+void engine::ShadowDepthPass::cachedRecord(VkCommandBuffer& cmd,uint32 backBufferIndex)
+{
+	const auto& plan = m_renderScene->m_cascadeShadowCache.getPlan();
+
+	for(uint32 i = 0; i < CASCADE_MAX_COUNT; i++)
+	{
+		if((plan.refreshMask & (1u << i)) != 0)
+		{
+			GpuProfileScope cascadeScope(cmd,"CascadeCache",(int32)i);
+			staticMeshRecord(cmd,backBufferIndex,i,getRenderpass(),m_cacheFramebuffers[backBufferIndex][i],m_renderScene->m_drawIndirectSSBOShadowDepths[i]);
+		}
+	}
+
+	if(plan.compositeMask == 0)
+	{
+		return;
+	}
+	copyStaticCache(cmd,plan.compositeMask);
+
+	if(!plan.bDynamicCasters)
+	{
+		return;
+	}
+
+	for(uint32 i = 0; i < CASCADE_MAX_COUNT; i++)
+	{
+		if((plan.compositeMask & (1u << i)) != 0)
+		{
+			GpuProfileScope cascadeScope(cmd,"CascadeDynamic",(int32)i);
+			staticMeshRecord(cmd,backBufferIndex,i,m_pmxRenderpass,m_cascadeFramebuffers[backBufferIndex][i],m_renderScene->m_drawIndirectSSBOShadowDynamic[i]);
+			pmxCascadeRecord(cmd,backBufferIndex,ECullIndex(i + 1));
+		}
+	}
+}
+
+void engine::ShadowDepthPass::copyStaticCache(VkCommandBuffer& cmd,uint32 cascadeMask)
+{
+	auto* cache = m_renderScene->getSceneTextures().getCascadeShadowStaticCache();
+	auto* cascades = m_renderScene->getSceneTextures().getCascadeShadowDepthMapArray();
+
+	std::vector<VkImageMemoryBarrier> toTransfer;
+	std::vector<VkImageMemoryBarrier> toShaderRead;
+	std::vector<VkImageCopy> regions;
+	for(uint32 i = 0; i < CASCADE_MAX_COUNT; i++)
+	{
+		if((cascadeMask & (1u << i)) == 0)
+		{
+			continue;
+		}
+
+		VkImageMemoryBarrier barrier {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, i, 1 };
+
+		// cache layers are in shader read after their render pass.
+		barrier.image = cache->getImage();
+		barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		toTransfer.push_back(barrier);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = 0;
+		toShaderRead.push_back(barrier);
+
+		// the whole layer is overwritten.
+		barrier.image = cascades->getImage();
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toTransfer.push_back(barrier);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+		toShaderRead.push_back(barrier);
+
+		VkImageCopy region {};
+		region.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1 };
+		region.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1 };
+		region.extent = cascades->getExtent();
+		regions.push_back(region);
+	}
+
+	vkCmdPipelineBarrier(
+		cmd,
+		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0,nullptr,
+		0,nullptr,
+		(uint32)toTransfer.size(),toTransfer.data()
+	);
+
+	vkCmdCopyImage(
+		cmd,
+		cache->getImage(),VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		cascades->getImage(),VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		(uint32)regions.size(),regions.data()
+	);
+
+	vkCmdPipelineBarrier(
+		cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		0,nullptr,
+		0,nullptr,
+		(uint32)toShaderRead.size(),toShaderRead.data()
+	);
+}
+
 void engine::ShadowDepthPass::cascadeRecord(VkCommandBuffer& cmd,uint32 backBufferIndex,ECullIndex cullIndexType)
 {
 	uint32 cascadeIndex = cullingIndexToCasacdeIndex(cullIndexType);
+	staticMeshRecord(
+		cmd,
+		backBufferIndex,
+		cascadeIndex,
+		getRenderpass(),
+		m_cascadeFramebuffers[backBufferIndex][cascadeIndex],
+		m_renderScene->m_drawIndirectSSBOShadowDepths[cascadeIndex]);
+}
+
+void engine::ShadowDepthPass::staticMeshRecord(
+	VkCommandBuffer& cmd,
+	uint32 backBufferIndex,
+	uint32 cascadeIndex,
+	VkRenderPass renderpass,
+	VkFramebuffer framebuffer,
+	const RenderScene::DrawIndirectBuffer& drawBuffer)
+{
 	CHECK(cascadeIndex < 4);
 
     auto shadowTextureExtent = m_renderScene->getSceneTextures().getCascadeShadowDepthMapArray()->getExtent();
@@ -247,9 +544,9 @@ void engine::ShadowDepthPass::cascadeRecord(VkCommandBuffer& cmd,uint32 backBuff
 	shadowTextureExtent2D.height = shadowTextureExtent.height;
 
     VkRenderPassBeginInfo rpInfo = vkRenderpassBeginInfo(
-		getRenderpass(),
+		renderpass,
 		shadowTextureExtent2D,
-		m_cascadeFramebuffers[backBufferIndex][cascadeIndex]
+		framebuffer
 	);
 
     VkClearValue clearValue{};
@@ -281,6 +578,9 @@ void engine::ShadowDepthPass::cascadeRecord(VkCommandBuffer& cmd,uint32 backBuff
 	GPUCascadePushConstants gpuPushConstant = {};
 	gpuPushConstant.cascadeIndex = cascadeIndex;
 
+	// NOTE: The shadow cache draws pmx meshes between the cascades, they bind their own vertex buffers.
+	MeshLibrary::get()->bindVertexBuffer(cmd);
+
 	vkCmdBeginRenderPass(cmd,&rpInfo,VK_SUBPASS_CONTENTS_INLINE);
 
 	vkCmdSetScissor(cmd,0,1,&scissor);
@@ -295,7 +595,7 @@ void engine::ShadowDepthPass::cascadeRecord(VkCommandBuffer& cmd,uint32 backBuff
 		, TextureLibrary::get()->getBindlessTextureDescriptorSet()
 		, m_renderer->getRenderScene().m_meshObjectSSBO->descriptorSets.set
 		, m_renderer->getRenderScene().m_meshMaterialSSBO->descriptorSets.set
-		, m_renderer->getRenderScene().m_drawIndirectSSBOShadowDepths[cascadeIndex].descriptorSets.set
+		, drawBuffer.descriptorSets.set
 		, m_renderer->getRenderScene().m_cascadeSetupBuffer.descriptorSets.set
 	};
 
@@ -312,15 +612,7 @@ void engine::ShadowDepthPass::cascadeRecord(VkCommandBuffer& cmd,uint32 backBuff
 	vkCmdPushConstants(cmd, m_pipelineLayouts[backBufferIndex], VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUCascadePushConstants), &gpuPushConstant);
 
 	vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,m_pipelines[backBufferIndex]);
-	vkCmdDrawIndexedIndirectCount(
-		cmd,
-		m_renderScene->m_drawIndirectSSBOShadowDepths[cascadeIndex].drawIndirectSSBO->GetVkBuffer(),
-		0,
-		m_renderScene->m_drawIndirectSSBOShadowDepths[cascadeIndex].countBuffer->GetVkBuffer(),
-		0,
-		(uint32)m_renderScene->m_cacheMeshObjectSSBOData.size(),
-		sizeof(GPUDrawCallData)
-	);
+	m_renderScene->drawStaticMeshBatches(cmd,drawBuffer);
 
 	vkCmdEndRenderPass(cmd);
 }
@@ -481,6 +773,29 @@ void engine::ShadowDepthPass::createFramebuffers()
 			cascadeFramebuffers[j] = fbf.create(VulkanRHI::get()->getDevice());
 		}
     }
+
+	m_cacheFramebuffers.resize(swapchain_imagecount);
+	for(uint32 i = 0; i < swapchain_imagecount; i++)
+	{
+		auto& cacheFramebuffers = m_cacheFramebuffers[i];
+		cacheFramebuffers.resize(CASCADE_MAX_COUNT);
+		for(uint32 j = 0; j < CASCADE_MAX_COUNT; j++)
+		{
+			VulkanFrameBufferFactory fbf {};
+			fbf.setRenderpass(m_renderpass)
+			   .addArrayAttachment(m_renderScene->getSceneTextures().getCascadeShadowStaticCache(),j);
+			cacheFramebuffers[j] = fbf.create(VulkanRHI::get()->getDevice());
+		}
+	}
+
+	m_virtualPoolFramebuffers.resize(swapchain_imagecount);
+	for(uint32 i = 0; i < swapchain_imagecount; i++)
+	{
+		VulkanFrameBufferFactory fbf {};
+		fbf.setRenderpass(m_renderpass)
+		   .addArrayAttachment(m_renderScene->getSceneTextures().getVirtualShadowPool(),0);
+		m_virtualPoolFramebuffers[i] = fbf.create(VulkanRHI::get()->getDevice());
+	}
 }
 
 void engine::ShadowDepthPass::destroyFramebuffers()
@@ -494,6 +809,21 @@ void engine::ShadowDepthPass::destroyFramebuffers()
 	}
 
 	m_cascadeFramebuffers.resize(0);
+
+	for(auto& cacheFramebuffers : m_cacheFramebuffers)
+	{
+		for(auto& framebuffer : cacheFramebuffers)
+		{
+			VulkanRHI::get()->destroyFramebuffer(framebuffer);
+		}
+	}
+	m_cacheFramebuffers.resize(0);
+
+	for(auto& framebuffer : m_virtualPoolFramebuffers)
+	{
+		VulkanRHI::get()->destroyFramebuffer(framebuffer);
+	}
+	m_virtualPoolFramebuffers.resize(0);
 }
 
 void engine::ShadowDepthPass::createPipeline()
@@ -543,8 +873,8 @@ void engine::ShadowDepthPass::createPipeline()
 		gpf.shaderStages.push_back(vkPipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, *fragShader));
 
 		VulkanVertexInputDescription vvid = {};
-		vvid.bindings   =  { VulkanVertexBuffer::getInputBinding(getStandardMeshAttributes()) };
-		vvid.attributes = VulkanVertexBuffer::getInputAttribute(getStandardMeshAttributes());
+		vvid.bindings   =  { VulkanVertexBuffer::getInputBinding(getPackedMeshAttributes()) };
+		vvid.attributes = VulkanVertexBuffer::getInputAttribute(getPackedMeshAttributes());
 
 		gpf.vertexInputDescription = vvid;
 		gpf.inputAssembly = vkInputAssemblyCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
@@ -656,11 +986,11 @@ void engine::ShadowDepthPass::destroyPipeline()
 
 	for(uint32 index = 0; index < m_pipelines.size(); index++)
 	{
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
 
-		vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pmxPipelines[index],nullptr);
-		vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pmxPipelineLayouts[index],nullptr);
+		VulkanRHI::get()->destroyPipeline(m_pmxPipelines[index]);
+		VulkanRHI::get()->destroyPipelineLayout(m_pmxPipelineLayouts[index]);
 	}
 	m_pipelines.resize(0);
 	m_pipelineLayouts.resize(0);
@@ -55,6 +55,24 @@ private:
 
 	void pmxCascadeRecord(VkCommandBuffer& cmd,uint32 backBufferIndex, ECullIndex);
 
+	// Static mesh draws of drawBuffer into one cascade layer of the framebuffer.
+	void staticMeshRecord(
+		VkCommandBuffer& cmd,
+		uint32 backBufferIndex,
+		uint32 cascadeIndex,
+		VkRenderPass renderpass,
+		VkFramebuffer framebuffer,
+		const RenderScene::DrawIndirectBuffer& drawBuffer);
+
+	// Shadow cache path, see CascadeShadowCache.
+	std::vector<std::vector<VkFramebuffer>> m_cacheFramebuffers = {};
+	void cachedRecord(VkCommandBuffer& cmd,uint32 backBufferIndex);
+	void copyStaticCache(VkCommandBuffer& cmd,uint32 cascadeMask);
+
+	// Virtual shadow map page renders into the pool, see VirtualShadowMap.
+	std::vector<VkFramebuffer> m_virtualPoolFramebuffers = {};
+	void virtualPageRecord(VkCommandBuffer& cmd,uint32 backBufferIndex);
+
 private:
 	bool bInitPipeline = false;
 	std::vector<VkPipeline> m_pipelines = {};
@@ -34,9 +34,14 @@ void engine::GBufferPass::afterSceneTextureRecreate()
     createPipeline();
 }
 
+RenderScene::DrawIndirectBuffer& engine::GBufferPass::getDrawIndirectBuffer()
+{
+    return m_bLate ? m_renderScene->m_drawIndirectSSBOGbufferLate : m_renderScene->m_drawIndirectSSBOGbuffer;
+}
+
 void engine::GBufferPass::dynamicRecord(uint32 backBufferIndex)
 {
-    VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+    VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
     commandBufBegin(backBufferIndex);
 
 
@@ -81,7 +86,6 @@ void engine::GBufferPass::dynamicRecord(uint32 backBufferIndex)
         return;
     }
 
-    MeshLibrary::get()->bindIndexBuffer(cmd);
     MeshLibrary::get()->bindVertexBuffer(cmd);
 
     vkCmdBeginRenderPass(cmd,&rpInfo,VK_SUBPASS_CONTENTS_INLINE);
@@ -95,7 +99,7 @@ void engine::GBufferPass::dynamicRecord(uint32 backBufferIndex)
         , TextureLibrary::get()->getBindlessTextureDescriptorSet()
         , m_renderer->getRenderScene().m_meshObjectSSBO->descriptorSets.set
         , m_renderer->getRenderScene().m_meshMaterialSSBO->descriptorSets.set
-        , m_renderer->getRenderScene().m_drawIndirectSSBOGbuffer.descriptorSets.set
+        , getDrawIndirectBuffer().descriptorSets.set
     };
 
     vkCmdBindDescriptorSets(
@@ -109,15 +113,7 @@ void engine::GBufferPass::dynamicRecord(uint32 backBufferIndex)
     );
     vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,m_pipelines[backBufferIndex]);
 
-    vkCmdDrawIndexedIndirectCount(
-        cmd,
-        m_renderScene->m_drawIndirectSSBOGbuffer.drawIndirectSSBO->GetVkBuffer(),
-        0,
-        m_renderScene->m_drawIndirectSSBOGbuffer.countBuffer->GetVkBuffer(),
-        0,
-        (uint32)m_renderScene->m_cacheMeshObjectSSBOData.size(),
-        sizeof(GPUDrawCallData)
-    );
+    m_renderScene->drawStaticMeshBatches(cmd,getDrawIndirectBuffer());
 
     vkCmdEndRenderPass(cmd);
 
@@ -135,11 +131,11 @@ void engine::GBufferPass::createRenderpass()
         attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
         
         // GBufferPassʱ
-        attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachmentDescs[i].loadOp = m_bLate ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
         attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachmentDescs[i].initialLayout = m_bLate ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
     }
 
     attachmentDescs[0].format = SceneTextures::getGbufferBaseColorRoughnessFormat();
@@ -154,11 +150,11 @@ void engine::GBufferPass::createRenderpass()
     attachmentDescs[3].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
     attachmentDescs[depthAttachmentIndex].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachmentDescs[depthAttachmentIndex].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachmentDescs[depthAttachmentIndex].loadOp = m_bLate ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachmentDescs[depthAttachmentIndex].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     attachmentDescs[depthAttachmentIndex].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachmentDescs[depthAttachmentIndex].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachmentDescs[depthAttachmentIndex].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; 
+    attachmentDescs[depthAttachmentIndex].initialLayout = m_bLate ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED; 
     attachmentDescs[depthAttachmentIndex].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     std::vector<VkAttachmentReference> colorReferences;
@@ -186,6 +182,18 @@ void engine::GBufferPass::createRenderpass()
     dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+    // NOTE: The late pass loads what the early pass wrote, the depth comes from the hzb build.
+    if(m_bLate)
+    {
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dstAccessMask = 
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | 
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dependencyFlags = 0;
+    }
+
     dependencies[1].srcSubpass = 0;
     dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
     dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -261,7 +269,7 @@ void engine::GBufferPass::createPipeline()
             , TextureLibrary::get()->getBindlessTextureDescriptorSetLayout()
             , m_renderer->getRenderScene().m_meshObjectSSBO->descriptorSetLayout.layout
             , m_renderer->getRenderScene().m_meshMaterialSSBO->descriptorSetLayout.layout
-            , m_renderer->getRenderScene().m_drawIndirectSSBOGbuffer.descriptorSetLayout.layout
+            , getDrawIndirectBuffer().descriptorSetLayout.layout
         };
         plci.setLayoutCount = (uint32)setLayouts.size();
         plci.pSetLayouts = setLayouts.data();
@@ -278,8 +286,8 @@ void engine::GBufferPass::createPipeline()
         gpf.shaderStages.push_back(vkPipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, *fragShader));
 
         VulkanVertexInputDescription vvid = {};
-        vvid.bindings   =  { VulkanVertexBuffer::getInputBinding(getStandardMeshAttributes()) };
-        vvid.attributes = VulkanVertexBuffer::getInputAttribute(getStandardMeshAttributes());
+        vvid.bindings   =  { VulkanVertexBuffer::getInputBinding(getPackedMeshAttributes()) };
+        vvid.attributes = VulkanVertexBuffer::getInputAttribute(getPackedMeshAttributes());
 
         gpf.vertexInputDescription = vvid;
         gpf.inputAssembly = vkInputAssemblyCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
@@ -321,8 +329,8 @@ void engine::GBufferPass::destroyPipeline()
 
     for(uint32 index = 0; index < m_pipelines.size(); index++)
     {
-        vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-        vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+        VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+        VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
     }
     m_pipelines.resize(0);
     m_pipelineLayouts.resize(0);
@@ -4,11 +4,13 @@
 namespace engine
 {
 
+// NOTE: The late pass draws the late occlusion culling phase on top of the early one, it loads the
+//       gbuffer instead of clearing it and takes the depth back from the hzb build.
 class GBufferPass : public GraphicsPass
 {
 public:
-	GBufferPass(Ref<Renderer> renderer,Ref<RenderScene> scene,Ref<shaderCompiler::ShaderCompiler> sc,const std::string& name)
-		:GraphicsPass(renderer,scene,sc,name,shaderCompiler::EShaderPass::GBuffer)
+	GBufferPass(Ref<Renderer> renderer,Ref<RenderScene> scene,Ref<shaderCompiler::ShaderCompiler> sc,const std::string& name,bool bLate = false)
+		:GraphicsPass(renderer,scene,sc,name,shaderCompiler::EShaderPass::GBuffer), m_bLate(bLate)
 	{
 
 	}
@@ -20,6 +22,9 @@ public:
 
 private:
 	std::vector<VkFramebuffer> m_framebuffers = {};
+	bool m_bLate;
+
+	RenderScene::DrawIndirectBuffer& getDrawIndirectBuffer();
 
 private:
 	bool bInitPipeline = false;
@@ -32,7 +32,7 @@ void engine::LightingPass::afterSceneTextureRecreate()
 
 void engine::LightingPass::dynamicRecord(uint32 backBufferIndex)
 {
-    VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+    VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
     commandBufBegin(backBufferIndex);
 
     auto sceneTextureExtent = m_renderScene->getSceneTextures().getHDRSceneColor()->getExtent();
@@ -110,6 +110,14 @@ void engine::LightingPass::dynamicRecord(uint32 backBufferIndex)
         &m_renderScene->m_cascadeSetupBuffer.descriptorSets.set,0,nullptr
     );
 
+    vkCmdBindDescriptorSets(
+        cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,
+        m_pipelineLayouts[backBufferIndex],
+        3, // PassSet #3
+        1,
+        &m_renderScene->m_virtualShadowBuffer.descriptorSets[backBufferIndex].set,0,nullptr
+    );
+
     vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,m_pipelines[backBufferIndex]);
     vkCmdDraw(cmd, 3, 1, 0, 0);
     vkCmdEndRenderPass(cmd);
@@ -243,6 +251,12 @@ void engine::LightingPass::createPipeline()
 		shadowDepthArrayImages.imageView = m_renderScene->getSceneTextures().getCascadeShadowDepthMapArray()->getImageView();
 		shadowDepthArrayImages.sampler =  m_renderScene->getSceneTextures().getCascadeShadowDepthMapArraySampler();
 
+        // page depth is fetched texel by texel through the page table.
+        VkDescriptorImageInfo virtualShadowPoolImage = {};
+        virtualShadowPoolImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        virtualShadowPoolImage.imageView = m_renderScene->getSceneTextures().getVirtualShadowPool()->getImageView();
+        virtualShadowPoolImage.sampler = VulkanRHI::get()->getPointClampEdgeSampler();
+
         VkDescriptorImageInfo BRDFLutImage = {};
         BRDFLutImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         BRDFLutImage.imageView = m_renderScene->getSceneTextures().getBRDFLut()->getImageView();
@@ -267,6 +281,7 @@ void engine::LightingPass::createPipeline()
             .bindImage(5,&BRDFLutImage,VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .bindImage(6,&IrradianceCubeImage, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .bindImage(7,&SpecularCubeImage, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .bindImage(8,&virtualShadowPoolImage, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
             .build(m_lightingPassDescriptorSets[index],m_lightingPassDescriptorSetLayouts[index]);
     }
 
@@ -288,6 +303,7 @@ void engine::LightingPass::createPipeline()
               m_renderer->getFrameData().m_frameDataDescriptorSetLayouts[index].layout
             , m_lightingPassDescriptorSetLayouts[index].layout 
             , m_renderScene->m_cascadeSetupBuffer.descriptorSetLayout.layout
+            , m_renderScene->m_virtualShadowBuffer.descriptorSetLayout.layout
         };
 
         plci.setLayoutCount = (uint32)setLayouts.size();
@@ -348,8 +364,8 @@ void engine::LightingPass::destroyPipeline()
 
     for(uint32 index = 0; index < m_pipelines.size(); index++)
     {
-        vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-        vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+        VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+        VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
     }
     m_pipelines.resize(0);
     m_pipelineLayouts.resize(0);
@@ -31,7 +31,7 @@ void engine::TonemapperPass::afterSceneTextureRecreate()
 
 void engine::TonemapperPass::dynamicRecord(uint32 backBufferIndex)
 {
-    VkCommandBuffer cmd = m_commandbufs[backBufferIndex]->getInstance();
+    VkCommandBuffer cmd = getRecordCommandBuf(backBufferIndex);
     commandBufBegin(backBufferIndex);
 
     auto sceneTextureExtent = m_renderScene->getSceneTextures().getTonemapper()->getExtent();
@@ -282,8 +282,8 @@ void engine::TonemapperPass::destroyPipeline()
 
     for(uint32 index = 0; index < m_pipelines.size(); index++)
     {
-        vkDestroyPipeline(VulkanRHI::get()->getDevice(),m_pipelines[index],nullptr);
-        vkDestroyPipelineLayout(VulkanRHI::get()->getDevice(),m_pipelineLayouts[index],nullptr);
+        VulkanRHI::get()->destroyPipeline(m_pipelines[index]);
+        VulkanRHI::get()->destroyPipelineLayout(m_pipelineLayouts[index]);
     }
     m_pipelines.resize(0);
     m_pipelineLayouts.resize(0);
@@ -3,7 +3,12 @@
 #include "material.h"
 #include "renderer.h"
 #include "frame_data.h"
+#include "frustum.h"
+#include "bvh.h"
+#include "culling_kernel.h"
 #include <execution>
+#include <random>
+#include <chrono>
 
 namespace engine{
 
@@ -23,6 +28,14 @@ static AutoCVarInt32 cVarParallelCulling(
 	CVarFlags::ReadAndWrite
 );
 
+static AutoCVarInt32 cVarCullingBenchmark(
+	"r.Culling.Benchmark",
+	"Run flat culling vs bvh culling benchmark once. 0 is off, other is on.",
+	"Culling",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
 }
 
 using namespace engine;
@@ -351,10 +364,195 @@ static void mutliThreadCulling(RenderMeshPack& inMeshes,const GPUFrameData& inVi
     });
 }
 
-void engine::frustumCulling(RenderMeshPack& inMeshes,const GPUFrameData& inView)
+constexpr uint32 SIMD_CULLING_CHUNK_SIZE = 4096;
+
+// NOTE: Pack bounds into SoA and run the simd kernel on fixed size chunks in parallel.
+static void mutliThreadSimdCulling(RenderMeshPack& inMeshes,const GPUFrameData& inView,CullingBoundsSoA& soa)
+{
+    const uint32 meshCount = (uint32)inMeshes.submesh.size();
+    const uint32 chunkCount = (meshCount + SIMD_CULLING_CHUNK_SIZE - 1) / SIMD_CULLING_CHUNK_SIZE;
+
+    std::vector<uint32> chunks(chunkCount);
+    for(uint32 i = 0; i < chunkCount; i++) chunks[i] = i;
+
+    // NOTE: Not par_unseq, the kernel appends to a per chunk vector which allocates.
+    soa.resize(meshCount);
+    std::for_each(std::execution::par,chunks.begin(),chunks.end(),[&](uint32 chunk)
+    {
+        const uint32 begin = chunk * SIMD_CULLING_CHUNK_SIZE;
+        const uint32 end = std::min(begin + SIMD_CULLING_CHUNK_SIZE,meshCount);
+
+        for(uint32 i = begin; i < end; i++)
+        {
+            const auto& mesh = inMeshes.submesh[i];
+            soa.set(i,mesh.renderBounds,mesh.modelMatrix);
+            inMeshes.submesh[i].bCullingResult = false;
+        }
+
+        std::vector<uint32> visible;
+        frustumCullingSoA(soa,inView.camFrustumPlanes,6,begin,end,visible);
+        for(uint32 id : visible)
+        {
+            inMeshes.submesh[id].bCullingResult = true;
+        }
+    });
+}
+
+void engine::frustumCulling(RenderMeshPack& inMeshes,const GPUFrameData& inView,CullingBoundsSoA& soa)
 {
 	if(cVarCulling.get() == 0) return;
 
 	if(cVarParallelCulling.get() == 0) return singleThreadCulling(inMeshes,inView);
-    else return mutliThreadCulling(inMeshes,inView);
-}
\ No newline at end of file
+	else if(cVarParallelCulling.get() == 1) return mutliThreadCulling(inMeshes,inView);
+	else return mutliThreadSimdCulling(inMeshes,inView,soa);
+}
+
+void engine::frustumCulling(RenderMeshPack& inMeshes,const SceneBVH& bvh,const GPUFrameData& inView)
+{
+	if(cVarCulling.get() == 0) return;
+	CHECK(bvh.getPrimitiveCount() == inMeshes.submesh.size());
+
+	std::vector<uint32> visibleIds;
+	visibleIds.reserve(inMeshes.submesh.size());
+	bvh.cullPlanes(inView.camFrustumPlanes,6,visibleIds);
+
+	for(auto& mesh : inMeshes.submesh)
+	{
+		mesh.bCullingResult = false;
+	}
+	for(uint32 id : visibleIds)
+	{
+		inMeshes.submesh[id].bCullingResult = true;
+	}
+}
+
+static void runCullingBenchmark(uint32 objectCount)
+{
+	using Clock = std::chrono::steady_clock;
+	auto elapsedMs = [](Clock::time_point begin)
+	{
+		return std::chrono::duration<double,std::milli>(Clock::now() - begin).count();
+	};
+
+	// NOTE: Keep object density constant, camera sits in the middle looking down +x.
+	const float halfSize = 50.0f * std::cbrt(float(objectCount) / 1000.0f);
+	std::mt19937 rng(objectCount);
+	std::uniform_real_distribution<float> posDist(-halfSize,halfSize);
+	std::uniform_real_distribution<float> extentDist(0.2f,2.0f);
+	std::uniform_real_distribution<float> angleDist(0.0f,glm::radians(360.0f));
+
+	RenderMeshPack pack{};
+	pack.submesh.resize(objectCount);
+	for(auto& mesh : pack.submesh)
+	{
+		mesh.renderBounds.origin = glm::vec3(0.0f);
+		mesh.renderBounds.extents = glm::vec3(extentDist(rng),extentDist(rng),extentDist(rng));
+		mesh.renderBounds.radius = glm::length(mesh.renderBounds.extents);
+
+		glm::mat4 model = glm::translate(glm::mat4(1.0f),glm::vec3(posDist(rng),posDist(rng),posDist(rng)));
+		mesh.modelMatrix = glm::rotate(model,angleDist(rng),glm::normalize(glm::vec3(0.3f,1.0f,0.2f)));
+		mesh.preModelMatrix = mesh.modelMatrix;
+	}
+
+	const float zNear = 0.1f;
+	const float zFar = halfSize;
+	const float fovy = glm::radians(60.0f);
+	const float aspect = 16.0f / 9.0f;
+
+	GPUFrameData view{};
+	view.camView = glm::lookAt(glm::vec3(0.0f),glm::vec3(1.0f,0.0f,0.0f),glm::vec3(0.0f,1.0f,0.0f));
+	view.camProj = glm::perspective(fovy,aspect,zNear,zFar);
+	view.camViewProj = view.camProj * view.camView;
+	view.cameraInfo = glm::vec4(fovy,aspect,zNear,zFar);
+
+	Frustum frustum{};
+	frustum.update(view.camViewProj);
+	for(uint32 i = 0; i < 6; i++)
+	{
+		view.camFrustumPlanes[i] = frustum.planes[i];
+	}
+
+	auto countVisible = [&]()
+	{
+		size_t count = 0;
+		for(const auto& mesh : pack.submesh) count += mesh.bCullingResult ? 1 : 0;
+		return count;
+	};
+
+	auto timePoint = Clock::now();
+	singleThreadCulling(pack,view);
+	const double flatMs = elapsedMs(timePoint);
+	const size_t flatVisible = countVisible();
+
+	timePoint = Clock::now();
+	mutliThreadCulling(pack,view);
+	const double flatParallelMs = elapsedMs(timePoint);
+
+	// NOTE: SoA kernel micro benchmark, packing is timed separately from the kernel itself.
+	CullingBoundsSoA soa{};
+	timePoint = Clock::now();
+	soa.resize(objectCount);
+	for(uint32 i = 0; i < objectCount; i++)
+	{
+		soa.set(i,pack.submesh[i].renderBounds,pack.submesh[i].modelMatrix);
+	}
+	const double soaPackMs = elapsedMs(timePoint);
+
+	constexpr uint32 kernelLoopCount = 8;
+	std::vector<uint32> kernelVisible;
+	kernelVisible.reserve(objectCount);
+	auto kernelObjectsPerNs = [&](ECullingKernel kernel)
+	{
+		const auto begin = Clock::now();
+		for(uint32 loop = 0; loop < kernelLoopCount; loop++)
+		{
+			kernelVisible.clear();
+			frustumCullingSoA(soa,view.camFrustumPlanes,6,0,objectCount,kernelVisible,kernel);
+		}
+		const double ns = std::chrono::duration<double,std::nano>(Clock::now() - begin).count() / kernelLoopCount;
+		return double(objectCount) / ns;
+	};
+	const double scalarRate = kernelObjectsPerNs(ECullingKernel::Scalar);
+	const double sseRate = kernelObjectsPerNs(ECullingKernel::SSE);
+	const double avxRate = cullingKernelUseAVX() ? kernelObjectsPerNs(ECullingKernel::AVX) : 0.0;
+
+	timePoint = Clock::now();
+	std::vector<AABBBounds> bounds(objectCount);
+	for(uint32 i = 0; i < objectCount; i++)
+	{
+		bounds[i] = AABBBounds::fromRenderBounds(pack.submesh[i].renderBounds,pack.submesh[i].modelMatrix);
+	}
+	SceneBVH bvh{};
+	bvh.build(bounds);
+	const double buildMs = elapsedMs(timePoint);
+
+	timePoint = Clock::now();
+	bvh.refit(bounds);
+	const double refitMs = elapsedMs(timePoint);
+
+	timePoint = Clock::now();
+	frustumCulling(pack,bvh,view);
+	const double bvhMs = elapsedMs(timePoint);
+	const size_t bvhVisible = countVisible();
+
+	LOG_INFO("Culling benchmark {0} objects: flat {1:.3f}ms, flat parallel {2:.3f}ms, {3} visible.",
+		objectCount,flatMs,flatParallelMs,flatVisible);
+	LOG_INFO("Culling benchmark {0} objects: soa pack {1:.3f}ms, kernel scalar {2:.3f}, sse {3:.3f}, avx {4:.3f} objects/ns, {5} visible.",
+		objectCount,soaPackMs,scalarRate,sseRate,avxRate,kernelVisible.size());
+	LOG_INFO("Culling benchmark {0} objects: bvh build {1:.3f}ms, refit {2:.3f}ms, cull {3:.3f}ms, {4} visible, {5} nodes.",
+		objectCount,buildMs,refitMs,bvhMs,bvhVisible,bvh.getNodeCount());
+}
+
+void engine::cullingBenchmarkTick()
+{
+	if(cVarCullingBenchmark.get() == 0) return;
+
+	// NOTE: SAT tests the oriented box and the bvh tests its world AABB,
+	//       so the bvh visible count is expected to be slightly larger.
+	for(uint32 objectCount : { 10000u, 100000u, 1000000u })
+	{
+		runCullingBenchmark(objectCount);
+	}
+
+	cVarCullingBenchmark.set(0);
+}
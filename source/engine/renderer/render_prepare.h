@@ -6,7 +6,16 @@ namespace engine{
 
 struct RenderMeshPack;
 struct GPUFrameData;
+class SceneBVH;
+struct CullingBoundsSoA;
 
-extern void frustumCulling(RenderMeshPack& inMeshes,const GPUFrameData& view);
+// NOTE: soa is the packing scratch of r.Culling.Parallel 2, owned by the caller so culling stays reentrant.
+extern void frustumCulling(RenderMeshPack& inMeshes,const GPUFrameData& view,CullingBoundsSoA& soa);
+
+// NOTE: Hierarchical culling through a bvh built over inMeshes (same order). Writes RenderSubMesh::bCullingResult.
+extern void frustumCulling(RenderMeshPack& inMeshes,const SceneBVH& bvh,const GPUFrameData& view);
+
+// NOTE: Run once when r.Culling.Benchmark is set, compares flat, simd kernel and bvh culling.
+extern void cullingBenchmarkTick();
 
 }
\ No newline at end of file
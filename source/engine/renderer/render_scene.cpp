@@ -1,19 +1,54 @@
 #include "render_scene.h"
 #include "mesh.h"
+#include "../core/cpu_profiler.h"
 #include "../scene/components/staticmesh_renderer.h"
 #include "../scene/components/pmx_mesh_component.h"
 #include "render_passes/cascade_shadowdepth_pass.h"	
 #include "frame_data.h"
 #include "render_prepare.h"
 #include "material.h"
+#include "renderer.h"
 
 constexpr uint32_t SSBO_BINDING_POS = 0;
 constexpr uint32_t SSBO_COUNT_BUFFER_BINDING_POS = 0;
 constexpr uint32_t SSBO_DEPTH_EVALUATE_BINDING_POS = 0;
 constexpr uint32_t SSBO_CASCADE_SETUP_BINDING_POS = 0;
+constexpr uint32_t SSBO_INSTANCE_ID_BINDING_POS = 1;
 
 namespace engine{
 
+static AutoCVarInt32 cVarInstanceBatching(
+	"r.Culling.InstanceBatching",
+	"Merge draws with the same mesh and material into instanced draws. 0 is off, 1 is on.",
+	"Culling",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarClusterCulling(
+	"r.Meshlet.ClusterCulling",
+	"Cull and draw large static meshes per meshlet in the gbuffer. 0 is off, 1 is on.",
+	"Meshlet",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarLod(
+	"r.Lod.Enable",
+	"Draw simplified lods of static meshes by their projected size. 0 is off, 1 is on.",
+	"Lod",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarClusterMinMeshlets(
+	"r.Meshlet.MinClusters",
+	"Submeshes with fewer meshlets are culled as a whole.",
+	"Meshlet",
+	8,
+	CVarFlags::ReadAndWrite
+);
+
 RenderScene::RenderScene(Ref<SceneManager> sceneManager,Ref<shaderCompiler::ShaderCompiler> shaderCompiler)
 {
 	m_sceneManager = sceneManager;
@@ -22,6 +57,7 @@ RenderScene::RenderScene(Ref<SceneManager> sceneManager,Ref<shaderCompiler::Shad
 	m_sceneTextures = new SceneTextures();
 	m_meshObjectSSBO = new SceneUploadSSBO<GPUObjectData>();
 	m_meshMaterialSSBO = new SceneUploadSSBO<GPUMaterialData>();
+	m_drawBatchSSBO = new SceneUploadSSBO<GPUDrawBatchData>();
 	m_drawIndirectSSBOGbuffer = {};
 }
 
@@ -31,6 +67,7 @@ RenderScene::~RenderScene()
 
 	delete m_meshObjectSSBO;
 	delete m_meshMaterialSSBO;
+	delete m_drawBatchSSBO;
 }
 
 void RenderScene::initFrame(uint32 width,uint32 height,bool forceAllocateTextures)
@@ -39,19 +76,57 @@ void RenderScene::initFrame(uint32 width,uint32 height,bool forceAllocateTexture
 	allocateSceneTextures(width,height,forceAllocateTextures);
 }
 
-void RenderScene::renderPrepare(const GPUFrameData& view, VkCommandBuffer cmd)
+void RenderScene::renderPrepare(const GPUFrameData& view, VkCommandBuffer cmd, uint32 backBufferIndex)
 {
+	CPU_PROFILE_FUNCTION();
+
 	// 0. ռеpmx
-	pmxCollect(cmd);
+	{
+		CPU_PROFILE_SCOPE("PMXCollect");
+		pmxCollect(backBufferIndex);
+	}
 
 	// 1. ռе
-	meshCollect();
+	{
+		CPU_PROFILE_SCOPE("MeshCollect");
+		meshCollect();
+	}
+	{
+		CPU_PROFILE_SCOPE("BatchCollect");
+		batchCollect();
+	}
+	m_cascadeShadowCache.update(glm::vec3(view.sunLightDir),view.camViewProj,CASCADE_MAX_COUNT);
+	{
+		CPU_PROFILE_SCOPE("VirtualShadowUpdate");
+
+		// NOTE: The command buffer of this back buffer finished, its request copy is safe to read.
+		const uint32* requests = static_cast<const uint32*>(m_virtualShadowBuffer.readbackBuffers[backBufferIndex]->mapped);
+		const float pixelAngle = 2.0f * glm::tan(view.cameraInfo.x * 0.5f) / float(glm::max(m_sceneTextures->getHeight(),1u));
+		m_virtualShadowMap.update(
+			glm::vec3(view.sunLightDir),
+			glm::vec3(view.camWorldPos),
+			pixelAngle,
+			m_cascadeShadowCache.getStaticHash(),
+			m_cascadeShadowCache.getSettingsHash(),
+			requests,
+			backBufferIndex);
+		m_virtualShadowBuffer.upload(m_virtualShadowMap,backBufferIndex);
+	}
 
 	// 2. ssbo
-	uploadMeshSSBO();
+	{
+		CPU_PROFILE_SCOPE("UploadMeshSSBO");
+		uploadMeshSSBO();
+	}
 
 	// 3. cpu׶޳(ѷ)
-	// frustumCulling(m_cacheStaticMeshRenderMesh,view);
+	// frustumCulling(m_cacheStaticMeshRenderMesh,view,m_cullingSoA);
+
+	// 4. bvh culling benchmark
+	{
+		CPU_PROFILE_SCOPE("CullingBenchmark");
+		cullingBenchmarkTick();
+	}
 }
 
 void RenderScene::uploadMeshSSBO()
@@ -78,6 +153,16 @@ void RenderScene::uploadMeshSSBO()
 		);
 		m_meshMaterialSSBO->buffers->unmap();
 	}
+	{
+		size_t batchBoundSize = sizeof(GPUDrawBatchData) * m_cacheDrawBatchSSBOData.size();
+
+		m_drawBatchSSBO->buffers->map(batchBoundSize);
+		m_drawBatchSSBO->buffers->copyTo(
+			m_cacheDrawBatchSSBOData.data(),
+			batchBoundSize
+		);
+		m_drawBatchSSBO->buffers->unmap();
+	}
 }
 
 bool RenderScene::isSceneStaticMeshEmpty()
@@ -92,7 +177,7 @@ Scene& RenderScene::getActiveScene()
 
 void RenderScene::allocateSceneTextures(uint32 width,uint32 height,bool forceAllocate)
 {
-	m_sceneTextures->allocate(width,height,forceAllocate);
+	m_sceneTextures->allocate(m_renderer->getRenderTargetPool(),width,height,forceAllocate);
 }
 
 void RenderScene::init(Renderer* renderer)
@@ -104,14 +189,23 @@ void RenderScene::init(Renderer* renderer)
 
 	m_meshObjectSSBO->init(SSBO_BINDING_POS);
 	m_meshMaterialSSBO->init(SSBO_BINDING_POS);
-	m_drawIndirectSSBOGbuffer.init(SSBO_BINDING_POS,SSBO_COUNT_BUFFER_BINDING_POS);
+	m_drawBatchSSBO->init(SSBO_BINDING_POS);
+	m_drawIndirectSSBOGbuffer.init(SSBO_BINDING_POS,SSBO_COUNT_BUFFER_BINDING_POS,SSBO_INSTANCE_ID_BINDING_POS,MAX_CLUSTER_DRAWS);
+	m_drawIndirectSSBOGbufferLate.init(SSBO_BINDING_POS,SSBO_COUNT_BUFFER_BINDING_POS,SSBO_INSTANCE_ID_BINDING_POS,MAX_CLUSTER_DRAWS);
+	m_occlusionVisibility.init();
 	m_evaluateDepthMinMax.init(SSBO_DEPTH_EVALUATE_BINDING_POS);
 	m_cascadeSetupBuffer.init(SSBO_CASCADE_SETUP_BINDING_POS);
 
 	for(auto& drawIndirectSSBOShadowDepth : m_drawIndirectSSBOShadowDepths)
 	{
-		drawIndirectSSBOShadowDepth.init(SSBO_BINDING_POS,SSBO_COUNT_BUFFER_BINDING_POS);
+		drawIndirectSSBOShadowDepth.init(SSBO_BINDING_POS,SSBO_COUNT_BUFFER_BINDING_POS,SSBO_INSTANCE_ID_BINDING_POS);
+	}
+	for(auto& drawIndirectSSBOShadowDynamic : m_drawIndirectSSBOShadowDynamic)
+	{
+		drawIndirectSSBOShadowDynamic.init(SSBO_BINDING_POS,SSBO_COUNT_BUFFER_BINDING_POS,SSBO_INSTANCE_ID_BINDING_POS);
 	}
+	m_drawIndirectSSBOVirtualShadow.init(SSBO_BINDING_POS,SSBO_COUNT_BUFFER_BINDING_POS,SSBO_INSTANCE_ID_BINDING_POS);
+	m_virtualShadowBuffer.init();
 }
 
 void RenderScene::release()
@@ -120,8 +214,11 @@ void RenderScene::release()
 
 	m_meshObjectSSBO->release();
 	m_meshMaterialSSBO->release();
+	m_drawBatchSSBO->release();
 	m_evaluateDepthMinMax.release();
 	m_drawIndirectSSBOGbuffer.release();
+	m_drawIndirectSSBOGbufferLate.release();
+	m_occlusionVisibility.release();
 	m_cascadeSetupBuffer.release();
 
 	// NOTE: ΪÿһCascadeShadowMap׼һ޳
@@ -129,6 +226,12 @@ void RenderScene::release()
 	{
 		drawIndirectSSBOShadowDepth.release();
 	}
+	for(auto& drawIndirectSSBOShadowDynamic : m_drawIndirectSSBOShadowDynamic)
+	{
+		drawIndirectSSBOShadowDynamic.release();
+	}
+	m_drawIndirectSSBOVirtualShadow.release();
+	m_virtualShadowBuffer.release();
 }
 
 // NOTE: ռеľ̬
@@ -144,15 +247,23 @@ void RenderScene::meshCollect()
 	m_cacheStaticMeshRenderMesh.submesh.clear();
 	m_cacheStaticMeshRenderMesh.submesh.resize(0);
 
+	m_cacheStaticMeshWorldBounds.clear();
+	m_cacheStaticMeshNodes.clear();
+	m_bStaticMeshBVHDirty = true;
+
 	auto& activeScene = m_sceneManager->getActiveScene();
 	auto staticMeshComponents = activeScene.getComponents<StaticMeshComponent>();
 
+	m_cascadeShadowCache.beginCasters();
+	m_virtualShadowMap.beginCasters();
+
 	// TODO: Parallel For
 	for(auto& componentWeakPtr : staticMeshComponents)
 	{
 		if(auto component = componentWeakPtr.lock()) // NOTE: ȡComponent
 		{
 			std::vector<RenderSubMesh> renderMeshes = component->getRenderMesh(m_renderer);
+			const SceneNode* node = component->m_node.lock().get();
 
 			// TODO: Parallel For
 			for(auto& subMesh : renderMeshes)
@@ -165,12 +276,17 @@ void RenderScene::meshCollect()
 				objData.preModel = subMesh.modelMatrix; // ̬Model󲻱
 				objData.sphereBounds = glm::vec4(subMesh.renderBounds.origin,subMesh.renderBounds.radius);
 				objData.extents = glm::vec4(subMesh.renderBounds.extents,1.0f);
-				objData.firstInstance = 0;
-				objData.vertexOffset = 0; // ѾcpuvertexOffset
+				objData.batchId = 0;     // filled in batchCollect.
+				objData.vertexOffset = subMesh.vertexOffset; // , ڶеƫ
 										  
 				objData.indexCount = subMesh.indexCount;
 				objData.firstIndex = subMesh.indexStartPosition;
 
+				objData.meshletStart = subMesh.meshletStart;
+				objData.meshletCount = subMesh.meshletCount; // cleared in batchCollect when not clustered.
+				objData.bIndex16 = subMesh.bIndex16 ? 1 : 0;
+				objData.bShadowDynamic = m_cascadeShadowCache.updateCaster(node,subMesh.modelMatrix,subMesh.indexStartPosition,subMesh.indexCount) ? 1 : 0;
+
 				m_cacheMeshObjectSSBOData.push_back(objData);
 
 				// NOTE: 
@@ -179,12 +295,291 @@ void RenderScene::meshCollect()
 				m_cacheMeshMaterialSSBOData.push_back(matData);
 
 				m_cacheStaticMeshRenderMesh.submesh.push_back(subMesh);
+				m_cacheStaticMeshWorldBounds.push_back(AABBBounds::fromRenderBounds(subMesh.renderBounds,subMesh.modelMatrix));
+				m_cacheStaticMeshNodes.push_back(component->m_node);
+
+				if(objData.bShadowDynamic != 0)
+				{
+					const auto& bounds = m_cacheStaticMeshWorldBounds.back();
+					m_virtualShadowMap.addDynamicCaster(bounds.center(),glm::length(bounds.max - bounds.center()));
+				}
+			}
+		}
+	}
+
+	m_cascadeShadowCache.endCasters(!m_cachePMXMeshComponents.empty());
+
+	for(auto& pmxWeakPtr : m_cachePMXMeshComponents)
+	{
+		if(auto pmxComp = pmxWeakPtr.lock())
+		{
+			if(auto node = pmxComp->getNode())
+			{
+				m_virtualShadowMap.addSkinnedCaster(node->getTransform()->getWorldMatrix());
 			}
 		}
 	}
 }
 
-void RenderScene::pmxCollect(VkCommandBuffer cmd)
+// NOTE: Group the collected submeshes by index range and material. Every group becomes one
+//       instanced indirect draw, GpuCullingPass appends the visible object ids of a group to
+//       the instance id buffer at GPUDrawBatchData::firstInstance.
+void RenderScene::batchCollect()
+{
+	m_cacheDrawBatchSSBOData.clear();
+
+	struct BatchKey
+	{
+		uint32 firstIndex;
+		uint32 indexCount;
+		const Material* material;
+		bool bIndex16;
+
+		bool operator==(const BatchKey& o) const
+		{
+			return firstIndex == o.firstIndex && indexCount == o.indexCount && material == o.material && bIndex16 == o.bIndex16;
+		}
+	};
+
+	struct BatchKeyHash
+	{
+		size_t operator()(const BatchKey& k) const
+		{
+			size_t h = std::hash<uint64>()((uint64(k.firstIndex) << 32) | k.indexCount) ^ size_t(k.bIndex16);
+			return h ^ (std::hash<const void*>()(k.material) + 0x9e3779b9 + (h << 6) + (h >> 2));
+		}
+	};
+
+	// NOTE: Cluster draws of an index width may not overflow their range of the draw buffer,
+	//       objects past it fall back to the whole object test.
+	const bool bClusterCulling = cVarClusterCulling.get() != 0;
+	const uint32 minMeshlets = (uint32)glm::max(cVarClusterMinMeshlets.get(),1);
+	m_clusterObjectCount = 0;
+	m_clusterMeshletCounts = {};
+	for(auto& objData : m_cacheMeshObjectSSBOData)
+	{
+		uint32& meshletBudget = m_clusterMeshletCounts[objData.bIndex16];
+		if(bClusterCulling && objData.meshletCount >= minMeshlets && meshletBudget + objData.meshletCount <= MAX_CLUSTER_DRAWS)
+		{
+			// Instances of one mesh share their meshlets but not their visibility.
+			objData.clusterVisibilityStart = m_clusterMeshletCounts[0] + m_clusterMeshletCounts[1];
+			meshletBudget += objData.meshletCount;
+			m_clusterObjectCount ++;
+		}
+		else
+		{
+			objData.meshletCount = 0;
+			objData.clusterVisibilityStart = 0;
+		}
+	}
+
+	const bool bBatching = cVarInstanceBatching.get() != 0;
+	const uint32 objectCount = (uint32)m_cacheMeshObjectSSBOData.size();
+	std::unordered_map<BatchKey,uint32,BatchKeyHash> groupMap;
+	std::vector<uint32> groupFirstObjects; // its submesh holds the lods of the group.
+	std::vector<uint32> groupCounts;
+	std::vector<uint32> objectGroups(objectCount);
+
+	for(uint32 i = 0; i < objectCount; i++)
+	{
+		const auto& objData = m_cacheMeshObjectSSBOData[i];
+		const auto& subMesh = m_cacheStaticMeshRenderMesh.submesh[i];
+		const BatchKey key{ objData.firstIndex, objData.indexCount, subMesh.cacheMaterial, subMesh.bIndex16 };
+
+		auto it = bBatching ? groupMap.find(key) : groupMap.end();
+		if(it == groupMap.end())
+		{
+			const uint32 groupId = (uint32)groupFirstObjects.size();
+			groupFirstObjects.push_back(i);
+			groupCounts.push_back(0);
+			if(bBatching)
+			{
+				it = groupMap.emplace(key,groupId).first;
+			}
+			objectGroups[i] = groupId;
+		}
+		else
+		{
+			objectGroups[i] = it->second;
+		}
+		groupCounts[objectGroups[i]] ++;
+	}
+
+	// NOTE: Every lod of a group is one more batch after the full one, and any instance of the group may
+	//       select it. Groups which would overflow the batch draws or the instance ids keep lod #0 only.
+	const bool bLod = cVarLod.get() != 0;
+	const uint32 groupCount = (uint32)groupFirstObjects.size();
+	uint32 drawBudget = (uint32)MAX_SSBO_OBJECTS - glm::min(groupCount,(uint32)MAX_SSBO_OBJECTS);
+	uint32 instanceBudget = (uint32)MAX_SSBO_OBJECTS - glm::min(objectCount,(uint32)MAX_SSBO_OBJECTS);
+
+	std::vector<uint32> groupBatches(groupCount);
+	std::vector<uint32> instanceCounts;
+	std::vector<bool> batchIndex16;
+	for(uint32 groupId = 0; groupId < groupCount; groupId++)
+	{
+		const uint32 firstObject = groupFirstObjects[groupId];
+		const auto& objData = m_cacheMeshObjectSSBOData[firstObject];
+		const auto& subMesh = m_cacheStaticMeshRenderMesh.submesh[firstObject];
+
+		uint32 lodCount = bLod ? subMesh.lodCount : 1;
+		const uint32 extraDraws = lodCount - 1;
+		const uint32 extraInstances = extraDraws * groupCounts[groupId];
+		if(extraDraws > drawBudget || extraInstances > instanceBudget)
+		{
+			lodCount = 1;
+		}
+		else
+		{
+			drawBudget -= extraDraws;
+			instanceBudget -= extraInstances;
+		}
+
+		groupBatches[groupId] = (uint32)m_cacheDrawBatchSSBOData.size();
+		for(uint32 lod = 0; lod < lodCount; lod++)
+		{
+			GPUDrawBatchData batch{};
+			batch.indexCount = lod == 0 ? objData.indexCount : subMesh.lods[lod].indexCount;
+			batch.firstIndex = objData.firstIndex + (lod == 0 ? 0 : subMesh.lods[lod].firstIndex);
+			batch.vertexOffset = objData.vertexOffset;
+			batch.materialId = firstObject; // material data is stored per object, all objects of the batch share it.
+			batch.lodCount = lodCount;
+			batch.lodError = lod == 0 ? 0.0f : subMesh.lods[lod].error;
+
+			m_cacheDrawBatchSSBOData.push_back(batch);
+			instanceCounts.push_back(groupCounts[groupId]);
+			batchIndex16.push_back(subMesh.bIndex16);
+		}
+	}
+
+	for(uint32 i = 0; i < objectCount; i++)
+	{
+		m_cacheMeshObjectSSBOData[i].batchId = groupBatches[objectGroups[i]];
+	}
+
+	// NOTE: Move the 16 bit batches behind the 32 bit ones so each index width is one indirect draw range.
+	//       The order inside a width is kept, the lods of a group share its width and stay together.
+	const uint32 batchCount = (uint32)m_cacheDrawBatchSSBOData.size();
+	std::vector<uint32> batchRemap(batchCount);
+	m_drawBatchIndex16Begin = 0;
+	for(uint32 i = 0; i < batchCount; i++)
+	{
+		if(!batchIndex16[i]) batchRemap[i] = m_drawBatchIndex16Begin ++;
+	}
+
+	uint32 index16Batch = m_drawBatchIndex16Begin;
+	for(uint32 i = 0; i < batchCount; i++)
+	{
+		if(batchIndex16[i]) batchRemap[i] = index16Batch ++;
+	}
+
+	if(m_drawBatchIndex16Begin != 0 && m_drawBatchIndex16Begin != batchCount)
+	{
+		std::vector<GPUDrawBatchData> sortedBatches(batchCount);
+		std::vector<uint32> sortedInstanceCounts(batchCount);
+		for(uint32 i = 0; i < batchCount; i++)
+		{
+			sortedBatches[batchRemap[i]] = m_cacheDrawBatchSSBOData[i];
+			sortedInstanceCounts[batchRemap[i]] = instanceCounts[i];
+		}
+		m_cacheDrawBatchSSBOData.swap(sortedBatches);
+		instanceCounts.swap(sortedInstanceCounts);
+
+		for(auto& objData : m_cacheMeshObjectSSBOData)
+		{
+			objData.batchId = batchRemap[objData.batchId];
+		}
+	}
+
+	// worst case every object of a batch is visible.
+	uint32 instanceOffset = 0;
+	for(size_t i = 0; i < m_cacheDrawBatchSSBOData.size(); i++)
+	{
+		m_cacheDrawBatchSSBOData[i].firstInstance = instanceOffset;
+		instanceOffset += instanceCounts[i];
+	}
+}
+
+void RenderScene::drawStaticMeshBatches(VkCommandBuffer cmd,const DrawIndirectBuffer& drawBuffer) const
+{
+	// NOTE: The count buffer holds the batch count, maxDrawCount clamps it to each range.
+	//       Shaders read the batch of an instance from its object since gl_DrawID restarts per draw.
+	const uint32 batchCount = (uint32)m_cacheDrawBatchSSBOData.size();
+	const uint32 index16Begin = m_drawBatchIndex16Begin;
+
+	if(index16Begin > 0)
+	{
+		MeshLibrary::get()->bindIndexBuffer(cmd,false);
+		vkCmdDrawIndexedIndirectCount(
+			cmd,
+			drawBuffer.drawIndirectSSBO->GetVkBuffer(),
+			0,
+			drawBuffer.countBuffer->GetVkBuffer(),
+			0,
+			index16Begin,
+			sizeof(GPUDrawCallData)
+		);
+	}
+
+	if(batchCount > index16Begin)
+	{
+		MeshLibrary::get()->bindIndexBuffer(cmd,true);
+		vkCmdDrawIndexedIndirectCount(
+			cmd,
+			drawBuffer.drawIndirectSSBO->GetVkBuffer(),
+			VkDeviceSize(index16Begin) * sizeof(GPUDrawCallData),
+			drawBuffer.countBuffer->GetVkBuffer(),
+			0,
+			batchCount - index16Begin,
+			sizeof(GPUDrawCallData)
+		);
+	}
+
+	// NOTE: Cluster draws are bounded by the meshlets of clustered objects, zero for the cascades.
+	if(drawBuffer.clusterCapacity == 0)
+	{
+		return;
+	}
+
+	for(uint32 i = 0; i < 2; i++)
+	{
+		if(m_clusterMeshletCounts[i] == 0)
+		{
+			continue;
+		}
+
+		const bool bIndex16 = i == 1;
+		MeshLibrary::get()->bindIndexBuffer(cmd,bIndex16);
+		vkCmdDrawIndexedIndirectCount(
+			cmd,
+			drawBuffer.drawIndirectSSBO->GetVkBuffer(),
+			(VkDeviceSize(MAX_SSBO_OBJECTS) + VkDeviceSize(i) * drawBuffer.clusterCapacity) * sizeof(GPUDrawCallData),
+			drawBuffer.countBuffer->GetVkBuffer(),
+			bIndex16 ? offsetof(GPUOutIndirectDrawCount,clusterDrawCount16) : offsetof(GPUOutIndirectDrawCount,clusterDrawCount),
+			m_clusterMeshletCounts[i],
+			sizeof(GPUDrawCallData)
+		);
+	}
+}
+
+const SceneBVH& RenderScene::getStaticMeshBVH()
+{
+	if(m_bStaticMeshBVHDirty)
+	{
+		m_staticMeshBVH.update(m_cacheStaticMeshWorldBounds);
+		m_bStaticMeshBVHDirty = false;
+	}
+	return m_staticMeshBVH;
+}
+
+std::weak_ptr<SceneNode> RenderScene::pick(const glm::vec3& origin,const glm::vec3& dir)
+{
+	const uint32 hit = getStaticMeshBVH().raycast(origin,dir,std::numeric_limits<float>::max());
+	if(hit == SceneBVH::INVALID_INDEX) return {};
+
+	return m_cacheStaticMeshNodes[hit];
+}
+
+void RenderScene::pmxCollect(uint32 backBufferIndex)
 {
 	m_cachePMXMeshComponents.clear();
 	m_cachePMXMeshComponents.resize(0);
@@ -192,25 +587,38 @@ void RenderScene::pmxCollect(VkCommandBuffer cmd)
 	auto& activeScene = m_sceneManager->getActiveScene();
 
 	// only collect pmx component here.
-	// we call pmx skin update on pmx pass.
+	// GpuPMXSkinningPass skins them before the pmx and shadow passes.
 	m_cachePMXMeshComponents = activeScene.getComponents<PMXMeshComponent>();
 
-	// todo: pmx cascade record.
 	for(auto& pmxWeakPtr : m_cachePMXMeshComponents)
 	{
 		if(auto pmxComp = pmxWeakPtr.lock())
 		{
-			// todo: move tick to renderer begining.
-			pmxComp->OnRenderTick(cmd);
+			// bone transforms and morph weights of this frame.
+			pmxComp->OnRenderTick(backBufferIndex);
 		}
 	}
 }
 
-void RenderScene::DrawIndirectBuffer::init(uint32 bindingPos,uint32 countBindingPos)
+void RenderScene::DrawIndirectBuffer::init(uint32 bindingPos,uint32 countBindingPos,uint32 instanceIdBindingPos,uint32 inClusterCapacity)
 {
-	auto bufferSize = sizeof(GPUDrawCallData) * MAX_SSBO_OBJECTS;
+	clusterCapacity = inClusterCapacity;
+	const size_t drawCount = size_t(MAX_SSBO_OBJECTS) + size_t(clusterCapacity) * 2;
+
+	auto bufferSize = sizeof(GPUDrawCallData) * drawCount;
 	this->size = bufferSize;
 
+	instanceIdSize = sizeof(uint32) * drawCount;
+	instanceIdSSBO = VulkanBuffer::create(
+		VulkanRHI::get()->getVulkanDevice(),
+		VulkanRHI::get()->getGraphicsCommandPool(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		instanceIdSize,
+		nullptr
+	);
+
 	drawIndirectSSBO = VulkanBuffer::create(
 		VulkanRHI::get()->getVulkanDevice(),
 		VulkanRHI::get()->getGraphicsCommandPool(),
@@ -226,8 +634,14 @@ void RenderScene::DrawIndirectBuffer::init(uint32 bindingPos,uint32 countBinding
 	bufInfo.offset = 0;
 	bufInfo.range = bufferSize;
 
+	VkDescriptorBufferInfo instanceIdBufInfo = {};
+	instanceIdBufInfo.buffer = *instanceIdSSBO;
+	instanceIdBufInfo.offset = 0;
+	instanceIdBufInfo.range = instanceIdSize;
+
 	VulkanRHI::get()->vkDescriptorFactoryBegin()
 		.bindBuffer(bindingPos,&bufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT|VK_SHADER_STAGE_FRAGMENT_BIT)
+		.bindBuffer(instanceIdBindingPos,&instanceIdBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT)
 		.build(descriptorSets,descriptorSetLayout);
 
 	// Count buffer
@@ -235,7 +649,7 @@ void RenderScene::DrawIndirectBuffer::init(uint32 bindingPos,uint32 countBinding
 	countBuffer = VulkanBuffer::create(
 		VulkanRHI::get()->getVulkanDevice(),
 		VulkanRHI::get()->getGraphicsCommandPool(),
-		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT|VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT|VK_BUFFER_USAGE_STORAGE_BUFFER_BIT|VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		VMA_MEMORY_USAGE_GPU_ONLY,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		countSize,
@@ -254,35 +668,104 @@ void RenderScene::DrawIndirectBuffer::release()
 {
 	delete drawIndirectSSBO;
 	delete countBuffer;
+	delete instanceIdSSBO;
 }
 
-void RenderScene::EvaluateDepthMinMaxBuffer::init(uint32 bindingPos)
+void RenderScene::OcclusionVisibilityBuffer::init()
 {
-	size = sizeof(GpuDepthEvaluteMinMaxBuffer);
+	objectSize = sizeof(uint32) * MAX_SSBO_OBJECTS;
+	objectBuffer = VulkanBuffer::create(
+		VulkanRHI::get()->getVulkanDevice(),
+		VulkanRHI::get()->getGraphicsCommandPool(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		objectSize,
+		nullptr
+	);
 
-	buffer = VulkanBuffer::create(
+	clusterSize = sizeof(uint32) * (MAX_CLUSTER_VISIBILITY_BITS / 32);
+	clusterBuffer = VulkanBuffer::create(
 		VulkanRHI::get()->getVulkanDevice(),
 		VulkanRHI::get()->getGraphicsCommandPool(),
-		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VMA_MEMORY_USAGE_GPU_ONLY,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		size,
+		clusterSize,
 		nullptr
 	);
 
-	VkDescriptorBufferInfo countBufInfo = {};
-	countBufInfo.buffer = *buffer;
-	countBufInfo.offset = 0;
-	countBufInfo.range = size;
+	bNeedClear = true;
+}
 
-	VulkanRHI::get()->vkDescriptorFactoryBegin()
-		.bindBuffer(bindingPos,&countBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
-		.build(descriptorSets,descriptorSetLayout);
+void RenderScene::OcclusionVisibilityBuffer::release()
+{
+	delete objectBuffer;
+	delete clusterBuffer;
+}
+
+void RenderScene::EvaluateDepthMinMaxBuffer::init(uint32 bindingPos)
+{
+	size = sizeof(GpuDepthEvaluteMinMaxBuffer);
+	binding = bindingPos;
+
+	// Same binding as bindBuffer declares, so the layout cache hands back the layout of the sets built in bind().
+	VkDescriptorSetLayoutBinding layoutBinding = {};
+	layoutBinding.binding = bindingPos;
+	layoutBinding.descriptorCount = 1;
+	layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &layoutBinding;
+	descriptorSetLayout.layout = VulkanRHI::get()->getDescriptorLayoutCache().createDescriptorLayout(&layoutInfo);
+
+	const size_t backBufferCount = VulkanRHI::get()->getSwapchainImageViews().size();
+	boundBuffers.assign(backBufferCount,VK_NULL_HANDLE);
+	descriptorSets.assign(backBufferCount,{});
+}
+
+void RenderScene::EvaluateDepthMinMaxBuffer::bind(VkBuffer buffer,uint32 backBufferIndex)
+{
+	CHECK(backBufferIndex < descriptorSets.size());
+	if(buffer == VK_NULL_HANDLE || boundBuffers[backBufferIndex] == buffer)
+	{
+		return;
+	}
+
+	VkDescriptorBufferInfo bufInfo = {};
+	bufInfo.buffer = buffer;
+	bufInfo.offset = 0;
+	bufInfo.range = size;
+
+	if(descriptorSets[backBufferIndex].set == VK_NULL_HANDLE)
+	{
+		VulkanRHI::get()->vkDescriptorFactoryBegin()
+			.bindBuffer(binding,&bufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+			.build(descriptorSets[backBufferIndex]);
+	}
+	else
+	{
+		// NOTE: The frame that last used this back buffer has finished, its set can be rewritten in place.
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSets[backBufferIndex].set;
+		write.dstBinding = binding;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &bufInfo;
+		vkUpdateDescriptorSets(VulkanRHI::get()->getDevice(),1,&write,0,nullptr);
+	}
+	boundBuffers[backBufferIndex] = buffer;
 }
 
 void RenderScene::EvaluateDepthMinMaxBuffer::release()
 {
-	delete buffer;
+	// Sets are returned with the static descriptor pools, the buffers belong to the frame graph.
+	boundBuffers.clear();
+	descriptorSets.clear();
 }
 
 void RenderScene::CascadeSetupBuffer::init(uint32 bindingPos)
@@ -316,4 +799,167 @@ void RenderScene::CascadeSetupBuffer::release()
 	delete buffer;
 }
 
+void RenderScene::VirtualShadowBuffer::init()
+{
+	auto createHostBuffer = [](VkDeviceSize size)
+	{
+		VulkanBuffer* buffer = VulkanBuffer::create(
+			VulkanRHI::get()->getVulkanDevice(),
+			VulkanRHI::get()->getGraphicsCommandPool(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			size,
+			nullptr
+		);
+		return buffer;
+	};
+
+	requestSize = sizeof(uint32) * VirtualShadowMap::REQUEST_WORD_COUNT;
+	requestBuffer = VulkanBuffer::create(
+		VulkanRHI::get()->getVulkanDevice(),
+		VulkanRHI::get()->getGraphicsCommandPool(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		requestSize,
+		nullptr
+	);
+
+	VkDescriptorBufferInfo requestBufInfo = {};
+	requestBufInfo.buffer = *requestBuffer;
+	requestBufInfo.offset = 0;
+	requestBufInfo.range = requestSize;
+
+	const uint32 backBufferCount = (uint32)VulkanRHI::get()->getSwapchainImageViews().size();
+	infoBuffers.resize(backBufferCount);
+	pageTableBuffers.resize(backBufferCount);
+	pageTableStale.assign(backBufferCount,true);
+	pageMatrixBuffers.resize(backBufferCount);
+	descriptorSets.resize(backBufferCount);
+	pageMatrixDescriptorSets.resize(backBufferCount);
+	for(uint32 index = 0; index < backBufferCount; index++)
+	{
+		infoBuffers[index] = createHostBuffer(sizeof(GPUVirtualShadowInfo));
+		pageTableBuffers[index] = createHostBuffer(sizeof(uint32) * VirtualShadowMap::PAGE_COUNT);
+		pageMatrixBuffers[index] = createHostBuffer(sizeof(GpuCascadeInfo) * VirtualShadowMap::MAX_PAGE_RENDERS);
+
+		VkDescriptorBufferInfo infoBufInfo = {};
+		infoBufInfo.buffer = *infoBuffers[index];
+		infoBufInfo.offset = 0;
+		infoBufInfo.range = sizeof(GPUVirtualShadowInfo);
+
+		VkDescriptorBufferInfo pageTableBufInfo = {};
+		pageTableBufInfo.buffer = *pageTableBuffers[index];
+		pageTableBufInfo.offset = 0;
+		pageTableBufInfo.range = sizeof(uint32) * VirtualShadowMap::PAGE_COUNT;
+
+		VulkanRHI::get()->vkDescriptorFactoryBegin()
+			.bindBuffer(0,&infoBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+			.bindBuffer(1,&pageTableBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+			.bindBuffer(2,&requestBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+			.build(descriptorSets[index],descriptorSetLayout);
+
+		VkDescriptorBufferInfo pageMatrixBufInfo = {};
+		pageMatrixBufInfo.buffer = *pageMatrixBuffers[index];
+		pageMatrixBufInfo.offset = 0;
+		pageMatrixBufInfo.range = sizeof(GpuCascadeInfo) * VirtualShadowMap::MAX_PAGE_RENDERS;
+
+		VulkanRHI::get()->vkDescriptorFactoryBegin()
+			.bindBuffer(SSBO_CASCADE_SETUP_BINDING_POS,&pageMatrixBufInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			 VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+			.build(pageMatrixDescriptorSets[index],pageMatrixDescriptorSetLayout);
+	}
+
+	// NOTE: Zero requests until the first copy of a back buffer lands.
+	std::vector<uint32> zero(VirtualShadowMap::REQUEST_WORD_COUNT,0);
+	readbackBuffers.resize(backBufferCount);
+	for(auto& buffer : readbackBuffers)
+	{
+		buffer = VulkanBuffer::create(
+			VulkanRHI::get()->getVulkanDevice(),
+			VulkanRHI::get()->getGraphicsCommandPool(),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_TO_CPU,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			requestSize,
+			zero.data()
+		);
+		buffer->map();
+	}
+}
+
+void RenderScene::VirtualShadowBuffer::release()
+{
+	for(auto* buffers : { &infoBuffers, &pageTableBuffers, &pageMatrixBuffers })
+	{
+		for(VulkanBuffer* buffer : *buffers)
+		{
+			delete buffer;
+		}
+		buffers->clear();
+	}
+	descriptorSets.clear();
+	pageMatrixDescriptorSets.clear();
+	delete requestBuffer;
+
+	for(auto* buffer : readbackBuffers)
+	{
+		buffer->unmap();
+		delete buffer;
+	}
+	readbackBuffers.resize(0);
+}
+
+void RenderScene::VirtualShadowBuffer::upload(const VirtualShadowMap& virtualShadowMap,uint32 backBufferIndex)
+{
+	CHECK(backBufferIndex < infoBuffers.size());
+
+	const auto& info = virtualShadowMap.getInfo();
+	VulkanBuffer* infoBuffer = infoBuffers[backBufferIndex];
+	infoBuffer->map(sizeof(info));
+	infoBuffer->copyTo((void*)&info,sizeof(info));
+	infoBuffer->unmap();
+
+	const auto& plan = virtualShadowMap.getPlan();
+	if(plan.bPageTableDirty)
+	{
+		pageTableStale.assign(pageTableStale.size(),true);
+	}
+
+	if(!plan.bEnable)
+	{
+		return;
+	}
+
+	// NOTE: Rebuilt when pages moved in or out or a level window moved, 512kb each time. Every back buffer
+	//       copies it once after a change.
+	if(pageTableStale[backBufferIndex])
+	{
+		const auto& pageTable = virtualShadowMap.getPageTable();
+		const size_t pageTableSize = sizeof(uint32) * pageTable.size();
+		VulkanBuffer* pageTableBuffer = pageTableBuffers[backBufferIndex];
+		pageTableBuffer->map(pageTableSize);
+		pageTableBuffer->copyTo((void*)pageTable.data(),pageTableSize);
+		pageTableBuffer->unmap();
+		pageTableStale[backBufferIndex] = false;
+	}
+
+	if(!plan.renders.empty())
+	{
+		std::vector<GpuCascadeInfo> pageMatrices(plan.renders.size());
+		for(size_t i = 0; i < plan.renders.size(); i++)
+		{
+			pageMatrices[i].splitPosition = 0.0f;
+			pageMatrices[i].cascadeViewProjMatrix = plan.renders[i].viewProj;
+		}
+
+		const size_t pageMatrixSize = sizeof(GpuCascadeInfo) * pageMatrices.size();
+		VulkanBuffer* pageMatrixBuffer = pageMatrixBuffers[backBufferIndex];
+		pageMatrixBuffer->map(pageMatrixSize);
+		pageMatrixBuffer->copyTo(pageMatrices.data(),pageMatrixSize);
+		pageMatrixBuffer->unmap();
+	}
+}
+
 }
@@ -4,6 +4,10 @@
 #include "../scene/scene.h"
 #include "../shader_compiler/shader_compiler.h"
 #include "mesh.h"
+#include "bvh.h"
+#include "culling_kernel.h"
+#include "shadow_cache.h"
+#include "virtual_shadow_map.h"
 
 /**
  * NOTE: RenderScene洢RenderableWorldеĻ
@@ -11,6 +15,7 @@
 namespace engine{
 
 constexpr auto CASCADE_MAX_COUNT = 4u;
+static_assert(CASCADE_MAX_COUNT <= CascadeShadowCache::MAX_CASCADE_COUNT);
 
 template<typename SSBOType>
 struct SceneUploadSSBO;
@@ -18,6 +23,7 @@ struct SceneUploadSSBO;
 struct GPUFrameData;
 struct GPUObjectData;
 struct GPUMaterialData;
+struct GPUDrawBatchData;
 
 class PMXMeshComponent;
 
@@ -25,7 +31,7 @@ class RenderScene
 {
 public:
 	void initFrame(uint32 width,uint32 height,bool forceAllocateTextures = false);
-	void renderPrepare(const GPUFrameData& view, VkCommandBuffer cmd);
+	void renderPrepare(const GPUFrameData& view, VkCommandBuffer cmd, uint32 backBufferIndex);
 
 	void init(class Renderer* renderer);
 	void release();
@@ -46,8 +52,30 @@ public:
 	SceneUploadSSBO<GPUMaterialData>* m_meshMaterialSSBO;
 	std::vector<GPUMaterialData> m_cacheMeshMaterialSSBOData {};
 
+	// NOTE: One entry per instanced draw, filled by batchCollect after meshCollect.
+	SceneUploadSSBO<GPUDrawBatchData>* m_drawBatchSSBO;
+	std::vector<GPUDrawBatchData> m_cacheDrawBatchSSBOData {};
+
+	// NOTE: Batches with 32 bit indices come first, the 16 bit ones start here.
+	uint32 m_drawBatchIndex16Begin = 0;
+
+	// NOTE: Objects culled and drawn per meshlet by the gbuffer, and their meshlets per index width.
+	//       Cascades still draw them through their batch.
+	uint32 m_clusterObjectCount = 0;
+	std::array<uint32,2> m_clusterMeshletCounts = {};
+
 	std::vector<std::weak_ptr<PMXMeshComponent>> m_cachePMXMeshComponents {};
 
+	// NOTE: World space bounds and owner node of m_cacheStaticMeshRenderMesh.submesh, same order.
+	std::vector<AABBBounds> m_cacheStaticMeshWorldBounds {};
+	std::vector<std::weak_ptr<SceneNode>> m_cacheStaticMeshNodes {};
+
+	// NOTE: Lazily refit or rebuilt from m_cacheStaticMeshWorldBounds.
+	const SceneBVH& getStaticMeshBVH();
+
+	// NOTE: World space ray pick against static mesh bounds.
+	std::weak_ptr<SceneNode> pick(const glm::vec3& origin,const glm::vec3& dir);
+
 	struct DrawIndirectBuffer
 	{
 		VulkanBuffer* drawIndirectSSBO;
@@ -55,7 +83,11 @@ public:
 		VulkanDescriptorLayoutReference descriptorSetLayout = {};
 		VkDeviceSize size;
 
-		void init(uint32 bindingPos,uint32 countBindingPos);
+		// NOTE: Cluster draws follow the batch draws at MAX_SSBO_OBJECTS, clusterCapacity with 32 bit indices
+		//       then clusterCapacity with 16 bit indices. Their instance ids use the same slots.
+		uint32 clusterCapacity = 0;
+
+		void init(uint32 bindingPos,uint32 countBindingPos,uint32 instanceIdBindingPos,uint32 inClusterCapacity = 0);
 		void release();
 
 		// Count Buffer
@@ -63,19 +95,55 @@ public:
 		VulkanDescriptorSetReference countDescriptorSets = {};
 		VulkanDescriptorLayoutReference countDescriptorSetLayout = {};
 		VkDeviceSize countSize;
+
+		// Instance id buffer, same descriptor set as the draw commands.
+		// gl_InstanceIndex of a batch draw indexes the visible object id.
+		VulkanBuffer* instanceIdSSBO;
+		VkDeviceSize instanceIdSize;
 	};
 	
 	DrawIndirectBuffer m_drawIndirectSSBOGbuffer;
 
+	// NOTE: Draws of the late occlusion phase, objects and meshlets which were not visible last frame
+	//       and pass the hzb built from the early draws.
+	DrawIndirectBuffer m_drawIndirectSSBOGbufferLate;
+
+	// NOTE: Gbuffer visibility written by the late culling phase and read by the next early phase,
+	//       one uint per object id and one bit per meshlet of the clustered objects. Ids move when the
+	//       scene changes, a stale entry only moves a draw between the phases.
+	struct OcclusionVisibilityBuffer
+	{
+		VulkanBuffer* objectBuffer;
+		VkDeviceSize objectSize;
+
+		VulkanBuffer* clusterBuffer;
+		VkDeviceSize clusterSize;
+
+		// Content is undefined after init, the early culling clears it once.
+		bool bNeedClear = true;
+
+		void init();
+		void release();
+	};
+	OcclusionVisibilityBuffer m_occlusionVisibility;
+
+	// NOTE: Draw the culled static mesh batches of drawBuffer, one indirect draw per index width with its
+	//       index heap bound, then the culled clusters the same way. The vertex buffer and the pipeline must be bound already.
+	void drawStaticMeshBatches(VkCommandBuffer cmd,const DrawIndirectBuffer& drawBuffer) const;
+
 	struct EvaluateDepthMinMaxBuffer
 	{
 		// С(Cascade׶)
-		VulkanBuffer* buffer; 
-		VulkanDescriptorSetReference descriptorSets = {};
+		// NOTE: The buffer itself is a frame graph transient, bind() points the set of a back buffer
+		//       at the buffer realized for it and only rewrites it when the placement changed.
+		std::vector<VkBuffer> boundBuffers;
+		std::vector<VulkanDescriptorSetReference> descriptorSets;
 		VulkanDescriptorLayoutReference descriptorSetLayout = {};
 		VkDeviceSize size;
+		uint32 binding;
 
 		void init(uint32 bindingPos);
+		void bind(VkBuffer buffer,uint32 backBufferIndex);
 		void release();
 	};
 	EvaluateDepthMinMaxBuffer m_evaluateDepthMinMax;
@@ -95,18 +163,64 @@ public:
 	
 	std::array<DrawIndirectBuffer,CASCADE_MAX_COUNT> m_drawIndirectSSBOShadowDepths {};
 
+	// NOTE: With the shadow cache on m_drawIndirectSSBOShadowDepths only holds the static casters of a
+	//       refreshed cascade, the dynamic casters drawn over the cached depth every frame are culled here.
+	std::array<DrawIndirectBuffer,CASCADE_MAX_COUNT> m_drawIndirectSSBOShadowDynamic {};
+
+	// NOTE: Planned in renderPrepare, read by the cascade setup, culling and shadow depth passes.
+	CascadeShadowCache m_cascadeShadowCache;
+
+	// NOTE: Planned in renderPrepare after the cascade cache, its page renders draw every caster.
+	VirtualShadowMap m_virtualShadowMap;
+
+	// NOTE: Casters of the virtual shadow pages, culled without a frustum like the cascades.
+	DrawIndirectBuffer m_drawIndirectSSBOVirtualShadow;
+
+	// NOTE: Gpu side of m_virtualShadowMap. Info, page table and page matrices are written by the cpu
+	//       every frame into the buffers of its back buffer, frames in flight keep reading their own.
+	//       The mark pass sets the request bits and copies them to the readback buffer of its back buffer.
+	struct VirtualShadowBuffer
+	{
+		std::vector<VulkanBuffer*> infoBuffers = {};
+		std::vector<VulkanBuffer*> pageTableBuffers = {};
+		std::vector<bool> pageTableStale = {}; // the page table changed since this back buffer copied it.
+		VulkanBuffer* requestBuffer;
+		VkDeviceSize requestSize;
+		std::vector<VulkanDescriptorSetReference> descriptorSets = {};
+		VulkanDescriptorLayoutReference descriptorSetLayout = {};
+
+		// Page render matrices, laid out like CascadeSetupBuffer so the depth pipelines bind them as set 5.
+		std::vector<VulkanBuffer*> pageMatrixBuffers = {};
+		std::vector<VulkanDescriptorSetReference> pageMatrixDescriptorSets = {};
+		VulkanDescriptorLayoutReference pageMatrixDescriptorSetLayout = {};
+
+		std::vector<VulkanBuffer*> readbackBuffers = {};
+
+		void init();
+		void release();
+		void upload(const VirtualShadowMap& virtualShadowMap,uint32 backBufferIndex);
+	};
+	VirtualShadowBuffer m_virtualShadowBuffer;
+
 	Scene& getActiveScene();
 
 private:
 	void allocateSceneTextures(uint32 width,uint32 height,bool forceAllocate = false);
 	void meshCollect();
-	void pmxCollect(VkCommandBuffer cmd);
+	void batchCollect();
+	void pmxCollect(uint32 backBufferIndex);
 
 private:
 	SceneTextures* m_sceneTextures;
 	Renderer* m_renderer;
 	Ref<SceneManager> m_sceneManager;
 	Ref<shaderCompiler::ShaderCompiler> m_shaderCompiler;
+
+	SceneBVH m_staticMeshBVH;
+	bool m_bStaticMeshBVHDirty = true;
+
+	// NOTE: Packed bounds of the simd cpu culling, released with the scene.
+	CullingBoundsSoA m_cullingSoA;
 };
 
 }
\ No newline at end of file
@@ -11,8 +11,11 @@
 #include "render_passes/cascade_shadowdepth_pass.h"
 #include "compute_passes/depth_evaluate_minmax.h"
 #include "compute_passes/cascade_setup.h"
+#include "compute_passes/virtual_shadow_mark.h"
+#include "compute_passes/pmx_skinning.h"
 #include "render_prepare.h"
 #include "mesh.h"
+#include "pmx_animation.h"
 #include "compute_passes/gpu_culling.h"
 #include "compute_passes/brdf_lut.h"
 #include "compute_passes/irradiance_prefiltercube.h"
@@ -23,6 +26,9 @@
 #include "compute_passes/downsample.h"
 #include "render_passes/bloom.h"
 #include "render_passes/pmx_pass.h"
+#include <chrono>
+#include "../core/cpu_profiler.h"
+#include "../core/file_system.h"
 
 using namespace engine;
 
@@ -58,6 +64,94 @@ static AutoCVarInt32 cVarTAAOpen(
 	CVarFlags::ReadAndWrite
 );
 
+static AutoCVarInt32 cVarFrameGraphSelfTest(
+	"r.FrameGraph.SelfTest",
+	"Run the cpu frame graph barrier and aliasing tests once, then reset to 0.",
+	"FrameGraph",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarMeshletSelfTest(
+	"r.Meshlet.SelfTest",
+	"Run the cpu meshlet builder and cone culling tests once, then reset to 0.",
+	"Meshlet",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarLodSelfTest(
+	"r.Lod.SelfTest",
+	"Run the cpu mesh simplifier and lod chain tests once, then reset to 0.",
+	"Lod",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarPMXAnimationSelfTest(
+	"r.PMX.Animation.SelfTest",
+	"Run the cpu pmx pose, ik and skinning tests once, then reset to 0.",
+	"PMX",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarPMXAnimationBenchmark(
+	"r.PMX.Animation.Benchmark",
+	"Run the cpu pmx pose and skinning benchmark once. 0 is off, other is the vertex count, e.g. 100000.",
+	"PMX",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarFrameGraphDump(
+	"r.FrameGraph.Dump",
+	"Log the compiled frame graph once, then reset to 0.",
+	"FrameGraph",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarTraceExport(
+	"r.Profiler.TraceExport",
+	"Write the buffered cpu scopes and the latest gpu frame as chrome trace json to the profile cache folder, then reset to 0.",
+	"Profiler",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarSubmitMode(
+	"r.Renderer.SubmitMode",
+	"Scene pass submission. 0 is one submit per pass chained by semaphores, 1 is one command buffer and one submit with barriers.",
+	"Renderer",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarRecordJobs(
+	"r.Renderer.RecordJobs",
+	"Jobs recording scene passes in batched submit mode. 1 records every pass on the main thread into one command buffer.",
+	"Renderer",
+	4,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarAsyncCompute(
+	"r.Renderer.AsyncCompute",
+	"Run compute passes on the async compute queue in batched submit mode. Needs a compute queue family apart from graphics.",
+	"Renderer",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarSubmitStats(
+	"r.Renderer.SubmitStats",
+	"Average cpu record and submit time over the next 256 frames, log it, then reset to 0.",
+	"Renderer",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
 bool engine::TAAOpen()
 {
 	return cVarTAAOpen.get() != 0;
@@ -173,6 +267,8 @@ bool Renderer::init()
 		m_dynamicDescriptorAllocator[i]->init(VulkanRHI::get()->getVulkanDevice());
 	}
 
+	m_renderTargetPool.init();
+	GpuProfiler::get()->init();
 	m_renderScene->init(this);
 	m_uiPass->initImgui();
 
@@ -182,13 +278,18 @@ bool Renderer::init()
 	// עRenderPasses
 	// m_renderpasses.push_back(new ShadowDepthPass(this,m_renderScene,shader_compiler,"ShadowDepth"));
 
+	m_pmxSkinningPass = new GpuPMXSkinningPass(this,m_renderScene,shader_compiler, "PMXSkinning");
 	m_gbufferCullingPass = new GpuCullingPass(this,m_renderScene,shader_compiler, "GbufferCulling");
 
 	m_cascasdeCullingPasses = new GpuCullingPass(this,m_renderScene,shader_compiler, "CascadeCulling");
 	m_shadowdepthPasses = new ShadowDepthPass(this,m_renderScene,shader_compiler, "CascadeDepth");
 
 	m_gbufferPass = new GBufferPass(this,m_renderScene,shader_compiler,"GBuffer");
+	m_hzbPass = new DownSamplePass(this,m_renderScene,shader_compiler,"HZBBuild",EDownSampleMode::HZB);
+	m_gbufferCullingLatePass = new GpuCullingPass(this,m_renderScene,shader_compiler,"GbufferCullingLate");
+	m_gbufferLatePass = new GBufferPass(this,m_renderScene,shader_compiler,"GBufferLate",true);
 	m_depthEvaluateMinMaxPass = new GpuDepthEvaluateMinMaxPass(this,m_renderScene,shader_compiler, "DepthEvaluateMinMax");
+	m_virtualShadowMarkPass = new GpuVirtualShadowMarkPass(this,m_renderScene,shader_compiler, "VirtualShadowMark");
 	m_cascadeSetupPass = new GpuCascadeSetupPass(this,m_renderScene,shader_compiler, "CascadeSetup");
 
 	m_lightingPass = new LightingPass(this,m_renderScene,shader_compiler,"Lighting");
@@ -204,9 +305,14 @@ bool Renderer::init()
 	m_frameData.buildPerFrameDataDescriptorSets(this);
 
 	// ÿһRenderpassĳʼ
+	m_pmxSkinningPass->init();
 	m_gbufferCullingPass->init();
 	m_gbufferPass->init();
+	m_hzbPass->init();
+	m_gbufferCullingLatePass->init();
+	m_gbufferLatePass->init();
 	m_depthEvaluateMinMaxPass->init();
+	m_virtualShadowMarkPass->init();
 	m_cascadeSetupPass->init();
 
 	m_cascasdeCullingPasses->init();
@@ -221,6 +327,16 @@ bool Renderer::init()
 	m_taaPass->init();
 	m_tonemapperPass->init();
 
+	m_frameGraphTransientCache.init((uint32)VulkanRHI::get()->getSwapchainImageViews().size());
+
+	m_sceneCommandBufs.resize(VulkanRHI::get()->getSwapchainImageViews().size());
+	for(auto& cmd : m_sceneCommandBufs)
+	{
+		cmd = VulkanRHI::get()->createGraphicsCommandBuffer();
+	}
+	m_commandRecorder.init((uint32)VulkanRHI::get()->getSwapchainImageViews().size());
+	createQueueTimelines();
+
 	return true;
 }
 
@@ -231,7 +347,19 @@ void Renderer::tick(float dt)
 	Ref<shaderCompiler::ShaderCompiler> shader_compiler = m_moduleManager->getRuntimeModule<shaderCompiler::ShaderCompiler>();
 	CHECK(shader_compiler);
 
-	uint32 backBufferIndex = VulkanRHI::get()->acquireNextPresentImage();
+	uint32 backBufferIndex = 0;
+	{
+		CPU_PROFILE_SCOPE("AcquirePresentImage");
+		backBufferIndex = VulkanRHI::get()->acquireNextPresentImage();
+	}
+	m_renderTargetPool.tick();
+	GpuProfiler::get()->beginFrame(backBufferIndex);
+
+	if(cVarTraceExport.get() != 0)
+	{
+		exportTrace();
+		cVarTraceExport.set(0);
+	}
 	
 	bool bForceAllocate = false;
 	if(shaderCompiler::g_shaderPassChange)
@@ -244,11 +372,12 @@ void Renderer::tick(float dt)
 	   m_screenViewportWidth  != m_renderScene->getSceneTextures().getWidth() ||
 	   m_screenViewportHeight != m_renderScene->getSceneTextures().getHeight())
 	{
-		VulkanRHI::get()->waitIdle();
-
 		// NOTE: 仯Ҫö̬ز´ȫֵ
 		m_dynamicDescriptorAllocator[backBufferIndex]->resetPools();
 		m_frameData.markPerframeDescriptorSetsDirty();
+
+		// Cached sets hold views of the scene textures initFrame is about to recreate.
+		VulkanRHI::get()->clearDescriptorSetCache();
 	}
 
 	// NOTE: ͨinitFrame뵽ʵRTframeDataй
@@ -267,40 +396,134 @@ void Renderer::tick(float dt)
 	VkCommandBufferBeginInfo cmdBeginInfo = vkCommandbufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 	vkCheck(vkBeginCommandBuffer(dynamicBuf,&cmdBeginInfo));
 	{
-		m_renderScene->renderPrepare(m_gpuFrameData, dynamicBuf);
-		m_renderScene->getSceneTextures().frameBegin();
+		m_renderScene->renderPrepare(m_gpuFrameData, dynamicBuf, backBufferIndex);
+		m_renderScene->getSceneTextures().frameBegin(dynamicBuf);
 	}
 	vkCheck(vkEndCommandBuffer(dynamicBuf));
+
+	const auto recordStart = std::chrono::steady_clock::now();
 	
-	m_gbufferCullingPass->gbuffer_record(backBufferIndex); // gbuffer culling
-	m_gbufferPass->dynamicRecord(backBufferIndex); // gbuffer rendering
-	m_depthEvaluateMinMaxPass->record(backBufferIndex); // depth evaluate min max
+	if(cVarFrameGraphSelfTest.get() != 0)
+	{
+		frame_graph::runFrameGraphSelfTest();
+		cVarFrameGraphSelfTest.set(0);
+	}
+
+	if(cVarMeshletSelfTest.get() != 0)
+	{
+		runMeshletSelfTest();
+		cVarMeshletSelfTest.set(0);
+	}
+
+	if(cVarLodSelfTest.get() != 0)
+	{
+		runMeshLodSelfTest();
+		cVarLodSelfTest.set(0);
+	}
 
-	m_cascadeSetupPass->record(backBufferIndex);// cascade setup.
+	if(cVarPMXAnimationSelfTest.get() != 0)
+	{
+		runPMXAnimationSelfTest();
+		cVarPMXAnimationSelfTest.set(0);
+	}
 
-	m_cascasdeCullingPasses->cascade_record(backBufferIndex); // cascade culling
+	if(cVarPMXAnimationBenchmark.get() > 0)
+	{
+		runPMXAnimationBenchmark((uint32)cVarPMXAnimationBenchmark.get());
+		cVarPMXAnimationBenchmark.set(0);
+	}
 
-	m_shadowdepthPasses->dynamicRecord(backBufferIndex); // shadow rendering
+	// NOTE: Per pass submit chains every pass on the graphics queue, async compute needs batched submit.
+	const auto* device = VulkanRHI::get()->getVulkanDevice();
+	const bool bAsyncCompute = cVarAsyncCompute.get() != 0 && cVarSubmitMode.get() != 0;
+	m_frameGraph.setQueueFamilies(device->graphicsFamily,bAsyncCompute ? device->computeFamily : device->graphicsFamily);
+
+	{
+		CPU_PROFILE_SCOPE("BuildFrameGraph");
+		buildFrameGraph(backBufferIndex);
+		m_frameGraph.compile([this](const frame_graph::FrameGraph& graph,frame_graph::ResourceHandle handle)
+		{
+			return m_frameGraphTransientCache.queryMemory(graph,handle);
+		});
+		m_frameGraphTransientCache.realize(m_frameGraph,backBufferIndex);
+		m_renderScene->m_evaluateDepthMinMax.bind(m_frameGraph.getBuffer(m_frameGraphDepthMinMax),backBufferIndex);
+	}
+
+	if(cVarFrameGraphDump.get() != 0)
+	{
+		LOG_INFO("Frame graph:\n{0}",m_frameGraph.dump());
+		cVarFrameGraphDump.set(0);
+	}
 
-	m_lightingPass->dynamicRecord(backBufferIndex); // lighting pass
-	m_pmxPass->dynamicRecord(backBufferIndex); // pmx pass
+	{
+		CPU_PROFILE_SCOPE("RecordAndSubmit");
+		if(cVarSubmitMode.get() == 0)
+		{
+			submitPerPass(backBufferIndex,dynamicBuf);
+		}
+		else
+		{
+			submitBatched(backBufferIndex,dynamicBuf);
+		}
+	}
+	m_uiPass->updateAfterSubmit();
 
-	m_downsamplePass->record(backBufferIndex);
-	m_bloomPass->dynamicRecord(backBufferIndex);
+	if(cVarSubmitStats.get() != 0)
+	{
+		const auto recordEnd = std::chrono::steady_clock::now();
+		m_submitStats.recordAndSubmitMs += std::chrono::duration<double,std::milli>(recordEnd - recordStart).count();
+		m_submitStats.frameCount++;
 
-	m_taaPass->record(backBufferIndex);
-	m_tonemapperPass->dynamicRecord(backBufferIndex); // tonemapper pass
+		constexpr uint32 statsFrameCount = 256;
+		if(m_submitStats.frameCount == statsFrameCount)
+		{
+			LOG_INFO("Submit mode {0}: record and submit {1} ms, {2} queue submits, {3} semaphores per frame.",
+				cVarSubmitMode.get(),
+				m_submitStats.recordAndSubmitMs / statsFrameCount,
+				(float)m_submitStats.submitCount / statsFrameCount,
+				(float)m_submitStats.semaphoreCount / statsFrameCount);
+
+			m_submitStats = {};
+			cVarSubmitStats.set(0);
+		}
+	}
+
+	{
+		CPU_PROFILE_SCOPE("Present");
+		VulkanRHI::get()->present();
+	}
+}
+
+void Renderer::exportTrace()
+{
+	std::vector<ChromeTraceTrack> tracks;
+	std::vector<ChromeTraceEvent> events;
+	CpuProfiler::get()->appendChromeTrace(tracks,events);
+	GpuProfiler::get()->appendChromeTrace(tracks,events);
+
+	const std::string path = std::string(s_engineProfileCache) + "trace.json";
+	if(writeChromeTrace(path,tracks,events))
+	{
+		LOG_INFO("Profiler trace with {0} events written to {1}.",events.size(),path);
+	}
+}
+
+void Renderer::submitPerPass(uint32 backBufferIndex,VkCommandBuffer dynamicBuf)
+{
+	// NOTE: Scene passes record into their own command buffers.
+	const auto recordStart = std::chrono::steady_clock::now();
+	m_frameGraph.execute(VK_NULL_HANDLE);
+	const auto recordEnd = std::chrono::steady_clock::now();
+	updateRecordStats(std::chrono::duration<float,std::milli>(recordEnd - recordStart).count(),1);
 
 	uiRecord(backBufferIndex);
 	m_uiPass->renderFrame(backBufferIndex);
 
-	// TODO: ʹ rendergraph ⲿ
 	// ύ
 	auto frameStartSemaphore = VulkanRHI::get()->getCurrentFrameWaitSemaphoreRef();
 	auto frameEndSemaphore = VulkanRHI::get()->getCurrentFrameFinishSemaphore();
 
 	std::vector<VkPipelineStageFlags> graphicsWaitFlags = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	std::vector<VkPipelineStageFlags> computeWaitFlags = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
 
 	std::vector<VkSemaphore> waitSemaphores = {frameStartSemaphore};
 
@@ -314,131 +537,37 @@ void Renderer::tick(float dt)
 	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&dynamicBufSubmitInfo.get(),nullptr));
 
 
-	// 1. gbuffer culling
-	VulkanSubmitInfo gbufferCullingSubmitInfo{};
-	auto gbufferCullingSemaphore = m_gbufferCullingPass->getSemaphore(backBufferIndex);
-	VkCommandBuffer gbufferCullingBuf = m_gbufferCullingPass->getCommandBuf(backBufferIndex)->getInstance();
-	gbufferCullingSubmitInfo.setWaitStage(graphicsWaitFlags)
-		.setWaitSemaphore(&dynamicCmdBufSemaphore,1) 
-		.setSignalSemaphore(&gbufferCullingSemaphore,1)
-		.setCommandBuffer(&gbufferCullingBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&gbufferCullingSubmitInfo.get(),nullptr));
-
-	// 2. gbuffer rendering
-	VulkanSubmitInfo gbufferRenderingSubmitInfo{};
-	auto gbufferRenderingSemaphore = m_gbufferPass->getSemaphore(backBufferIndex);
-	VkCommandBuffer gbufferRenderingBuf = m_gbufferPass->getCommandBuf(backBufferIndex)->getInstance();
-	gbufferRenderingSubmitInfo.setWaitStage(computeWaitFlags)// ȴ޳
-		.setWaitSemaphore(&gbufferCullingSemaphore,1) 
-		.setSignalSemaphore(&gbufferRenderingSemaphore,1) 
-		.setCommandBuffer(&gbufferRenderingBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&gbufferRenderingSubmitInfo.get(),nullptr));
-
-	// 3. depth evaluate min max
-	VulkanSubmitInfo depthEvaluateMinMaxSubmitInfo{};
-	auto depthEvaluateMinMaxSemaphore = m_depthEvaluateMinMaxPass->getSemaphore(backBufferIndex);
-	VkCommandBuffer depthEvaluateMinMaxBuf = m_depthEvaluateMinMaxPass->getCommandBuf(backBufferIndex)->getInstance();
-	depthEvaluateMinMaxSubmitInfo.setWaitStage(graphicsWaitFlags)
-		.setWaitSemaphore(&gbufferRenderingSemaphore,1) 
-		.setSignalSemaphore(&depthEvaluateMinMaxSemaphore,1) 
-		.setCommandBuffer(&depthEvaluateMinMaxBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&depthEvaluateMinMaxSubmitInfo.get(),nullptr));
-
-	// 4. cascade setup
-	VulkanSubmitInfo cascasdeSetupSubmitInfo{};
-	auto cascasdeSetupSemaphore = m_cascadeSetupPass->getSemaphore(backBufferIndex);
-	VkCommandBuffer cascasdeSetupBuf = m_cascadeSetupPass->getCommandBuf(backBufferIndex)->getInstance();
-	cascasdeSetupSubmitInfo.setWaitStage(computeWaitFlags)
-		.setWaitSemaphore(&depthEvaluateMinMaxSemaphore,1)
-		.setSignalSemaphore(&cascasdeSetupSemaphore,1) 
-		.setCommandBuffer(&cascasdeSetupBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&cascasdeSetupSubmitInfo.get(),nullptr));
-
-	// 5. cascade culling
-	VulkanSubmitInfo cascasdeCullingSubmitInfo{};
-	auto cascasdeCullingSemaphore = m_cascasdeCullingPasses->getSemaphore(backBufferIndex);
-	VkCommandBuffer cascasdeCullingBuf = m_cascasdeCullingPasses->getCommandBuf(backBufferIndex)->getInstance();
-	cascasdeCullingSubmitInfo.setWaitStage(computeWaitFlags)
-		.setWaitSemaphore(&cascasdeSetupSemaphore,1)
-		.setSignalSemaphore(&cascasdeCullingSemaphore,1) 
-		.setCommandBuffer(&cascasdeCullingBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&cascasdeCullingSubmitInfo.get(),nullptr));
-
-	// 6. shadow rendering
-	VulkanSubmitInfo shadowDepthSubmitInfo{};
-	auto shadowDepthSemaphore = m_shadowdepthPasses->getSemaphore(backBufferIndex);
-	VkCommandBuffer shadowDepthBuf = m_shadowdepthPasses->getCommandBuf(backBufferIndex)->getInstance();
-	shadowDepthSubmitInfo.setWaitStage(computeWaitFlags)
-		.setWaitSemaphore(&cascasdeCullingSemaphore,1)
-		.setSignalSemaphore(&shadowDepthSemaphore,1) 
-		.setCommandBuffer(&shadowDepthBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&shadowDepthSubmitInfo.get(),nullptr));
-
-	// 7. lighting
-	VulkanSubmitInfo lightingSubmitInfo{};
-	auto lightingSemaphore = m_lightingPass->getSemaphore(backBufferIndex);
-	VkCommandBuffer lightingBuf = m_lightingPass->getCommandBuf(backBufferIndex)->getInstance();
-	lightingSubmitInfo.setWaitStage(graphicsWaitFlags)
-		.setWaitSemaphore(&shadowDepthSemaphore,1)
-		.setSignalSemaphore(&lightingSemaphore,1) 
-		.setCommandBuffer(&lightingBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&lightingSubmitInfo.get(),nullptr));
-
-	// 7.1 pmx pass
-	VulkanSubmitInfo pmxSubmitInfo{};
-	auto pmxSemaphore = m_pmxPass->getSemaphore(backBufferIndex);
-	VkCommandBuffer pmxBuf = m_pmxPass->getCommandBuf(backBufferIndex)->getInstance();
-	pmxSubmitInfo.setWaitStage(graphicsWaitFlags)
-		.setWaitSemaphore(&lightingSemaphore,1)
-		.setSignalSemaphore(&pmxSemaphore,1) 
-		.setCommandBuffer(&pmxBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&pmxSubmitInfo.get(),nullptr));
-
-	// 8. downsample
-	VulkanSubmitInfo downsampleSubmitInfo{};
-	auto downsampleSemaphore = m_downsamplePass->getSemaphore(backBufferIndex);
-	VkCommandBuffer downsampleBuf = m_downsamplePass->getCommandBuf(backBufferIndex)->getInstance();
-	downsampleSubmitInfo.setWaitStage(graphicsWaitFlags)
-		.setWaitSemaphore(&pmxSemaphore,1)
-		.setSignalSemaphore(&downsampleSemaphore,1)
-		.setCommandBuffer(&downsampleBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&downsampleSubmitInfo.get(),nullptr));
-
-	// 8.5 bloom
-	VulkanSubmitInfo bloomSubmitInfo{};
-	auto bloomSemaphore = m_bloomPass->getSemaphore(backBufferIndex);
-	VkCommandBuffer bloomBuf = m_bloomPass->getCommandBuf(backBufferIndex)->getInstance();
-	bloomSubmitInfo.setWaitStage(computeWaitFlags)
-		.setWaitSemaphore(&downsampleSemaphore,1)
-		.setSignalSemaphore(&bloomSemaphore,1)
-		.setCommandBuffer(&bloomBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&bloomSubmitInfo.get(),nullptr));
-
-	// 9. taa
-	VulkanSubmitInfo taaSubmitInfo{};
-	auto taaSemaphore = m_taaPass->getSemaphore(backBufferIndex);
-	VkCommandBuffer taaBuf = m_taaPass->getCommandBuf(backBufferIndex)->getInstance();
-	taaSubmitInfo.setWaitStage(graphicsWaitFlags)
-		.setWaitSemaphore(&bloomSemaphore,1)
-		.setSignalSemaphore(&taaSemaphore,1) 
-		.setCommandBuffer(&taaBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&taaSubmitInfo.get(),nullptr));
-
-	// 10. tonemapping
-	VulkanSubmitInfo tonemapperSubmitInfo{};
-	auto tonemapperSemaphore = m_tonemapperPass->getSemaphore(backBufferIndex);
-	VkCommandBuffer tonemapperBuf = m_tonemapperPass->getCommandBuf(backBufferIndex)->getInstance();
-	tonemapperSubmitInfo.setWaitStage(computeWaitFlags)
-		.setWaitSemaphore(&taaSemaphore,1)
-		.setSignalSemaphore(&tonemapperSemaphore,1) 
-		.setCommandBuffer(&tonemapperBuf,1);
-	vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&tonemapperSubmitInfo.get(),nullptr));
-
-	// 11. imgui
+	// 1. scene passes in graph order, each one waits on the one before.
+	const auto& executionOrder = m_frameGraph.getExecutionOrder();
+	std::vector<std::vector<VkPipelineStageFlags>> passWaitStages(executionOrder.size());
+	std::vector<VkSemaphore> passSemaphores(executionOrder.size());
+	std::vector<VkCommandBuffer> passCmdBufs(executionOrder.size());
+
+	VkSemaphore* lastPassSemaphore = &dynamicCmdBufSemaphore;
+	for(size_t i = 0; i < executionOrder.size(); i++)
+	{
+		const uint32 passIndex = executionOrder[i];
+		PassCommon* pass = m_frameGraphPasses[passIndex];
+
+		passWaitStages[i] = { m_frameGraph.getPassWaitStages(passIndex) };
+		passSemaphores[i] = pass->getSemaphore(backBufferIndex);
+		passCmdBufs[i] = pass->getCommandBuf(backBufferIndex)->getInstance();
+
+		VulkanSubmitInfo passSubmitInfo{};
+		passSubmitInfo.setWaitStage(passWaitStages[i])
+			.setWaitSemaphore(lastPassSemaphore,1)
+			.setSignalSemaphore(&passSemaphores[i],1)
+			.setCommandBuffer(&passCmdBufs[i],1);
+		vkCheck(vkQueueSubmit(VulkanRHI::get()->getGraphicsQueue(),1,&passSubmitInfo.get(),nullptr));
+
+		lastPassSemaphore = &passSemaphores[i];
+	}
+
+	// 2. imgui
 	VulkanSubmitInfo imguiPassSubmitInfo{};
 	VkCommandBuffer cmd_uiPass = m_uiPass->getCommandBuffer(backBufferIndex);
 	imguiPassSubmitInfo.setWaitStage(graphicsWaitFlags)
-		.setWaitSemaphore(&tonemapperSemaphore,1)
+		.setWaitSemaphore(lastPassSemaphore,1)
 		.setSignalSemaphore(frameEndSemaphore,1)
 		.setCommandBuffer(&cmd_uiPass,1);
 
@@ -446,10 +575,198 @@ void Renderer::tick(float dt)
 
 	VulkanRHI::get()->resetFence();
 	VulkanRHI::get()->submit((uint32_t)submitInfos.size(),submitInfos.data());
-	m_uiPass->updateAfterSubmit();
 
+	if(cVarSubmitStats.get() != 0)
+	{
+		m_submitStats.submitCount += (uint32)executionOrder.size() + 2;
+		m_submitStats.semaphoreCount += (uint32)executionOrder.size() + 2;
+	}
+}
+
+void Renderer::submitBatched(uint32 backBufferIndex,VkCommandBuffer dynamicBuf)
+{
+	// NOTE: Replaces the dynamic buffer semaphore, uploads and pmx updates recorded there
+	//       and work of the previous frame on this queue finish before any scene pass starts.
+	auto recordPrologue = [](VkCommandBuffer cmd)
+	{
+		VkMemoryBarrier prologue { };
+		prologue.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		prologue.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		prologue.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd,VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,0,1,&prologue,0,nullptr,0,nullptr);
+	};
+
+	// Command buffers of every submit batch of the graph, the first and the last one are graphics.
+	const auto& batches = m_frameGraph.getSubmitBatches();
+	std::vector<std::vector<VkCommandBuffer>> batchCmdBufs(batches.size());
+	batchCmdBufs.front().push_back(dynamicBuf);
+
+	// The graph puts a memory barrier in front of each pass where a semaphore used to be.
+	const uint32 jobCount = (uint32)glm::max(cVarRecordJobs.get(),1);
+	const auto recordStart = std::chrono::steady_clock::now();
+	if(jobCount > 1 || batches.size() > 1)
+	{
+		const auto& recorded = m_commandRecorder.record(m_frameGraph,backBufferIndex,jobCount,recordPrologue);
+		batchCmdBufs.front().push_back(recorded.prologue);
+		for(size_t i = 0; i < batches.size(); i++)
+		{
+			const auto begin = recorded.passes.begin() + batches[i].firstOrder;
+			batchCmdBufs[i].insert(batchCmdBufs[i].end(),begin,begin + batches[i].orderCount);
+		}
+		batchCmdBufs.back().push_back(recorded.epilogue);
+	}
+	else
+	{
+		VkCommandBuffer sceneCmd = m_sceneCommandBufs[backBufferIndex]->getInstance();
+		vkCheck(vkResetCommandBuffer(sceneCmd,0));
+		VkCommandBufferBeginInfo cmdBeginInfo = vkCommandbufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+		vkCheck(vkBeginCommandBuffer(sceneCmd,&cmdBeginInfo));
+		recordPrologue(sceneCmd);
+		m_frameGraph.execute(sceneCmd);
+		vkCheck(vkEndCommandBuffer(sceneCmd));
+
+		batchCmdBufs.front().push_back(sceneCmd);
+	}
+	const auto recordEnd = std::chrono::steady_clock::now();
+	updateRecordStats(std::chrono::duration<float,std::milli>(recordEnd - recordStart).count(),jobCount);
+
+	uiRecord(backBufferIndex);
+	m_uiPass->renderFrame(backBufferIndex);
+	batchCmdBufs.back().push_back(m_uiPass->getCommandBuffer(backBufferIndex));
+
+	if(batches.size() > 1)
+	{
+		submitAsyncBatches(batchCmdBufs);
+		return;
+	}
+
+	auto frameStartSemaphore = VulkanRHI::get()->getCurrentFrameWaitSemaphoreRef();
+	auto frameEndSemaphore = VulkanRHI::get()->getCurrentFrameFinishSemaphore();
+
+	// NOTE: Nothing touches the swapchain before the ui pass, so one wait on the acquire is enough.
+	std::vector<VkPipelineStageFlags> graphicsWaitFlags = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	auto& cmdBufs = batchCmdBufs.front();
+
+	VulkanSubmitInfo submitInfo{};
+	submitInfo.setWaitStage(graphicsWaitFlags)
+		.setWaitSemaphore(&frameStartSemaphore,1)
+		.setSignalSemaphore(frameEndSemaphore,1)
+		.setCommandBuffer(cmdBufs.data(),(uint32)cmdBufs.size());
+
+	VulkanRHI::get()->submitAndResetFence(submitInfo);
 
-	VulkanRHI::get()->present();
+	if(cVarSubmitStats.get() != 0)
+	{
+		m_submitStats.submitCount += 1;
+		m_submitStats.semaphoreCount += 2;
+	}
+}
+
+// NOTE: Batches are submitted in graph order, so every wait is submitted after its signal. The last
+//       batch waits on every compute batch, its fence covers the whole frame.
+void Renderer::submitAsyncBatches(const std::vector<std::vector<VkCommandBuffer>>& batchCmdBufs)
+{
+	using namespace frame_graph;
+
+	const auto& batches = m_frameGraph.getSubmitBatches();
+	std::vector<uint64> signalValues(batches.size());
+
+	uint32 semaphoreCount = 0;
+	for(size_t i = 0; i < batches.size(); i++)
+	{
+		const auto& batch = batches[i];
+		const bool bLast = i == batches.size() - 1;
+		signalValues[i] = ++m_queueTimelineValues[size_t(batch.queue)];
+
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<uint64> waitValues;
+		std::vector<VkPipelineStageFlags> waitStages;
+		for(size_t queue = 0; queue < batch.waitBatch.size(); queue++)
+		{
+			if(batch.waitBatch[queue] != INVALID_BATCH)
+			{
+				waitSemaphores.push_back(m_queueTimelines[queue]);
+				waitValues.push_back(signalValues[batch.waitBatch[queue]]);
+				waitStages.push_back(batch.waitStages[queue] != 0 ? batch.waitStages[queue] : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+			}
+		}
+
+		std::vector<VkSemaphore> signalSemaphores = { m_queueTimelines[size_t(batch.queue)] };
+		std::vector<uint64> signalSemaphoreValues = { signalValues[i] };
+
+		// Binary semaphores ignore their value.
+		if(bLast)
+		{
+			waitSemaphores.push_back(VulkanRHI::get()->getCurrentFrameWaitSemaphoreRef());
+			waitValues.push_back(0);
+			waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+			signalSemaphores.push_back(*VulkanRHI::get()->getCurrentFrameFinishSemaphore());
+			signalSemaphoreValues.push_back(0);
+		}
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo { };
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = (uint32)waitValues.size();
+		timelineInfo.pWaitSemaphoreValues = waitValues.data();
+		timelineInfo.signalSemaphoreValueCount = (uint32)signalSemaphoreValues.size();
+		timelineInfo.pSignalSemaphoreValues = signalSemaphoreValues.data();
+
+		VkSubmitInfo submitInfo { };
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.waitSemaphoreCount = (uint32)waitSemaphores.size();
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = (uint32)batchCmdBufs[i].size();
+		submitInfo.pCommandBuffers = batchCmdBufs[i].data();
+		submitInfo.signalSemaphoreCount = (uint32)signalSemaphores.size();
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+		if(bLast)
+		{
+			VulkanRHI::get()->submitAndResetFence(submitInfo);
+		}
+		else
+		{
+			VkQueue queue = batch.queue == EQueueType::Graphics ? VulkanRHI::get()->getGraphicsQueue() : VulkanRHI::get()->getComputeQueue();
+			vkCheck(vkQueueSubmit(queue,1,&submitInfo,VK_NULL_HANDLE));
+		}
+		semaphoreCount += (uint32)(waitSemaphores.size() + signalSemaphores.size());
+	}
+
+	if(cVarSubmitStats.get() != 0)
+	{
+		m_submitStats.submitCount += (uint32)batches.size();
+		m_submitStats.semaphoreCount += semaphoreCount;
+	}
+}
+
+void Renderer::createQueueTimelines()
+{
+	VkSemaphoreTypeCreateInfo typeInfo { };
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo { };
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	for(size_t i = 0; i < m_queueTimelines.size(); i++)
+	{
+		vkCheck(vkCreateSemaphore(VulkanRHI::get()->getDevice(),&semaphoreInfo,nullptr,&m_queueTimelines[i]));
+		m_queueTimelineValues[i] = 0;
+	}
+}
+
+void Renderer::releaseQueueTimelines()
+{
+	for(auto& semaphore : m_queueTimelines)
+	{
+		vkDestroySemaphore(VulkanRHI::get()->getDevice(),semaphore,nullptr);
+		semaphore = VK_NULL_HANDLE;
+	}
 }
 
 void Renderer::release()
@@ -458,7 +775,11 @@ void Renderer::release()
 	m_shadowdepthPasses->release(); delete m_shadowdepthPasses;
 
 	m_gbufferPass->release(); delete m_gbufferPass;
+	m_hzbPass->release(); delete m_hzbPass;
+	m_gbufferCullingLatePass->release(); delete m_gbufferCullingLatePass;
+	m_gbufferLatePass->release(); delete m_gbufferLatePass;
 	m_depthEvaluateMinMaxPass->release(); delete m_depthEvaluateMinMaxPass;
+	m_virtualShadowMarkPass->release(); delete m_virtualShadowMarkPass;
 	m_cascadeSetupPass->release(); delete m_cascadeSetupPass;
 
 	m_lightingPass->release(); delete m_lightingPass;
@@ -470,10 +791,25 @@ void Renderer::release()
 	m_taaPass->release(); delete m_taaPass;
 	m_tonemapperPass->release(); delete m_tonemapperPass;
 	m_gbufferCullingPass->release(); delete m_gbufferCullingPass;
+	m_pmxSkinningPass->release(); delete m_pmxSkinningPass;
 
 	m_uiPass->release(); delete m_uiPass;
 
+	m_frameGraph.reset();
+	m_frameGraphTransientCache.release();
+
+	for(auto& cmd : m_sceneCommandBufs)
+	{
+		delete cmd;
+		cmd = nullptr;
+	}
+	m_sceneCommandBufs.clear();
+	m_commandRecorder.release();
+	releaseQueueTimelines();
+
 	m_renderScene->release(); delete m_renderScene;
+	m_renderTargetPool.release();
+	GpuProfiler::get()->release();
 	m_frameData.release();
 
 	for(size_t i = 0; i < m_dynamicDescriptorAllocator.size(); i++)
@@ -483,6 +819,319 @@ void Renderer::release()
 	}
 }
 
+void Renderer::buildFrameGraph(uint32 backBufferIndex)
+{
+	using namespace frame_graph;
+
+	m_frameGraph.reset();
+	m_frameGraphPasses.clear();
+
+	auto& graph = m_frameGraph;
+	auto& sceneTextures = m_renderScene->getSceneTextures();
+
+	// NOTE: Scene textures and buffers are persistent and every pass still records its own barriers
+	//       for them, so they are imported as external. History and the tonemapper output are read
+	//       outside of the graph (next frame, imgui viewport), their writers are never culled.
+	//       All of them are shared by the graphics and compute families, see VulkanDevice::setSharingMode.
+	ImportDesc external { };
+	external.bExternalBarrier = true;
+	external.bRetained = false;
+	external.bConcurrent = true;
+
+	ImportDesc retained = external;
+	retained.bRetained = true;
+
+	auto baseColorRoughness = graph.importTexture("GBufferBaseColorRoughness",sceneTextures.getGbufferBaseColorRoughness(),external);
+	auto normalMetal = graph.importTexture("GBufferNormalMetal",sceneTextures.getGbufferNormalMetal(),external);
+	auto emissiveAo = graph.importTexture("GBufferEmissiveAo",sceneTextures.getGbufferEmissiveAo(),external);
+	auto velocity = graph.importTexture("Velocity",sceneTextures.getVelocity(),external);
+	auto depth = graph.importTexture("DepthStencil",sceneTextures.getDepthStencil(),external);
+	auto sceneColor = graph.importTexture("HDRSceneColor",sceneTextures.getHDRSceneColor(),external);
+	auto downsampleChain = graph.importTexture("DownsampleChain",sceneTextures.getDownSampleChain(),external);
+	auto hzb = graph.importTexture("HZB",sceneTextures.getHZB(),external);
+	auto cascadeShadow = graph.importTexture("CascadeShadowDepth",sceneTextures.getCascadeShadowDepthMapArray(),external);
+	auto cascadeShadowCache = graph.importTexture("CascadeShadowStaticCache",sceneTextures.getCascadeShadowStaticCache(),external);
+	auto history = graph.importTexture("History",sceneTextures.getHistory(),retained);
+	auto taa = graph.importTexture("TAA",sceneTextures.getTAA(),retained);
+	ImportDesc viewport = retained;
+	viewport.finalAccess = EResourceAccess::GraphicsShaderRead;
+	auto tonemapper = graph.importTexture("Tonemapper",sceneTextures.getTonemapper(),viewport);
+
+	auto meshObjects = graph.importBuffer("MeshObjects",m_renderScene->m_meshObjectSSBO->buffers,external);
+	auto drawBatches = graph.importBuffer("DrawBatches",m_renderScene->m_drawBatchSSBO->buffers,external);
+	auto cascadeSetup = graph.importBuffer("CascadeSetup",m_renderScene->m_cascadeSetupBuffer.buffer,external);
+	auto objectVisibility = graph.importBuffer("ObjectVisibility",m_renderScene->m_occlusionVisibility.objectBuffer,external);
+	auto clusterVisibility = graph.importBuffer("ClusterVisibility",m_renderScene->m_occlusionVisibility.clusterBuffer,external);
+	auto virtualShadowPool = graph.importTexture("VirtualShadowPool",sceneTextures.getVirtualShadowPool(),external);
+	auto virtualShadowRequests = graph.importBuffer("VirtualShadowRequests",m_renderScene->m_virtualShadowBuffer.requestBuffer,external);
+
+	// NOTE: Depth range only lives from DepthEvaluateMinMax to CascadeSetup, the graph owns its memory and barriers.
+	BufferDesc depthMinMaxDesc { };
+	depthMinMaxDesc.size = m_renderScene->m_evaluateDepthMinMax.size;
+	auto depthMinMax = graph.createBuffer("DepthMinMax",depthMinMaxDesc);
+	m_frameGraphDepthMinMax = depthMinMax;
+
+	struct IndirectHandles
+	{
+		ResourceHandle draws;
+		ResourceHandle count;
+		ResourceHandle instanceIds;
+	};
+	auto importIndirect = [&](const std::string& name,RenderScene::DrawIndirectBuffer& buffer)
+	{
+		IndirectHandles handles { };
+		handles.draws = graph.importBuffer(name + "Draws",buffer.drawIndirectSSBO,external);
+		handles.count = graph.importBuffer(name + "Count",buffer.countBuffer,external);
+		handles.instanceIds = graph.importBuffer(name + "InstanceIds",buffer.instanceIdSSBO,external);
+		return handles;
+	};
+	auto writeIndirect = [](PassBuilder& builder,const IndirectHandles& handles)
+	{
+		builder.write(handles.draws,EResourceAccess::ComputeShaderWrite);
+		builder.write(handles.count,EResourceAccess::ComputeShaderWrite);
+		builder.write(handles.instanceIds,EResourceAccess::ComputeShaderWrite);
+	};
+	auto readIndirect = [](PassBuilder& builder,const IndirectHandles& handles)
+	{
+		builder.read(handles.draws,EResourceAccess::IndirectArgument);
+		builder.read(handles.count,EResourceAccess::IndirectArgument);
+		builder.read(handles.instanceIds,EResourceAccess::VertexShaderRead);
+	};
+
+	const IndirectHandles gbufferIndirect = importIndirect("GBufferIndirect",m_renderScene->m_drawIndirectSSBOGbuffer);
+	const IndirectHandles gbufferLateIndirect = importIndirect("GBufferLateIndirect",m_renderScene->m_drawIndirectSSBOGbufferLate);
+	std::array<IndirectHandles,CASCADE_MAX_COUNT> cascadeIndirect { };
+	std::array<IndirectHandles,CASCADE_MAX_COUNT> cascadeDynamicIndirect { };
+	for(uint32 i = 0; i < CASCADE_MAX_COUNT; i++)
+	{
+		cascadeIndirect[i] = importIndirect("CascadeIndirect" + std::to_string(i),m_renderScene->m_drawIndirectSSBOShadowDepths[i]);
+		cascadeDynamicIndirect[i] = importIndirect("CascadeDynamicIndirect" + std::to_string(i),m_renderScene->m_drawIndirectSSBOShadowDynamic[i]);
+	}
+	const IndirectHandles virtualShadowIndirect = importIndirect("VirtualShadowIndirect",m_renderScene->m_drawIndirectSSBOVirtualShadow);
+
+	// NOTE: A null command buffer lets the pass record into its own one. Passes may run on any
+	//       record job, each writes only its own slot of m_passRecordMs. VulkanImage::transitionLayout
+	//       keeps the layout on the cpu, so an image may only be transitioned that way by one pass.
+	auto addPass = [&](PassCommon* pass,const char* name,const std::function<void(PassBuilder&)>& setup,std::function<void()>&& record)
+	{
+		const size_t passIndex = m_frameGraphPasses.size();
+		graph.addPass(name,setup,[this,pass,passIndex,name,record](VkCommandBuffer cmd,const FrameGraph&)
+		{
+			CPU_PROFILE_SCOPE(name);
+			const auto start = std::chrono::steady_clock::now();
+
+			pass->setSharedCommandBuf(cmd);
+			pass->setProfileScope(name,m_frameGraph.getPassQueue((uint32_t)passIndex));
+			record();
+			pass->setProfileScope({},frame_graph::EQueueType::Graphics);
+			pass->setSharedCommandBuf(VK_NULL_HANDLE);
+
+			m_passRecordMs[passIndex] = std::chrono::duration<float,std::milli>(std::chrono::steady_clock::now() - start).count();
+		});
+		m_frameGraphPasses.push_back(pass);
+	};
+
+	// NOTE: Pmx vertex buffers are not graph resources, the pass orders its writes against the
+	//       vertex reads of the pmx and shadow depth passes itself. Declared first on the graphics queue.
+	addPass(m_pmxSkinningPass,"PMXSkinning",[&](PassBuilder& builder)
+	{
+		builder.sideEffect();
+	},[=](){ m_pmxSkinningPass->record(backBufferIndex); });
+
+	// NOTE: Two phase occlusion culling. The early phase draws what was visible last frame, the hzb is
+	//       built from its depth and the late phase draws what became visible on top of it.
+	addPass(m_gbufferCullingPass,"GBufferCulling",[&](PassBuilder& builder)
+	{
+		builder.read(meshObjects,EResourceAccess::ComputeShaderRead);
+		builder.read(drawBatches,EResourceAccess::ComputeShaderRead);
+		builder.read(objectVisibility,EResourceAccess::ComputeShaderRead);
+		builder.read(clusterVisibility,EResourceAccess::ComputeShaderRead);
+		writeIndirect(builder,gbufferIndirect);
+		builder.setQueue(EQueueType::AsyncCompute);
+	},[=](){ m_gbufferCullingPass->gbuffer_record(backBufferIndex); });
+
+	addPass(m_gbufferPass,"GBuffer",[&](PassBuilder& builder)
+	{
+		readIndirect(builder,gbufferIndirect);
+		builder.read(meshObjects,EResourceAccess::VertexShaderRead);
+		builder.write(baseColorRoughness,EResourceAccess::ColorAttachmentWrite);
+		builder.write(normalMetal,EResourceAccess::ColorAttachmentWrite);
+		builder.write(emissiveAo,EResourceAccess::ColorAttachmentWrite);
+		builder.write(velocity,EResourceAccess::ColorAttachmentWrite);
+		builder.write(depth,EResourceAccess::DepthStencilWrite);
+	},[=](){ m_gbufferPass->dynamicRecord(backBufferIndex); });
+
+	addPass(m_hzbPass,"HZBBuild",[&](PassBuilder& builder)
+	{
+		builder.read(depth,EResourceAccess::ComputeShaderRead);
+		builder.write(hzb,EResourceAccess::ComputeShaderWrite);
+		builder.setQueue(EQueueType::AsyncCompute);
+	},[=](){ m_hzbPass->record(backBufferIndex); });
+
+	addPass(m_gbufferCullingLatePass,"GBufferCullingLate",[&](PassBuilder& builder)
+	{
+		builder.read(meshObjects,EResourceAccess::ComputeShaderRead);
+		builder.read(drawBatches,EResourceAccess::ComputeShaderRead);
+		builder.read(hzb,EResourceAccess::ComputeShaderRead);
+		builder.read(gbufferIndirect.count,EResourceAccess::TransferRead);
+		builder.write(objectVisibility,EResourceAccess::ComputeShaderReadWrite);
+		builder.write(clusterVisibility,EResourceAccess::ComputeShaderReadWrite);
+		writeIndirect(builder,gbufferLateIndirect);
+
+		// batch stats readback of both phases.
+		builder.sideEffect();
+		builder.setQueue(EQueueType::AsyncCompute);
+	},[=](){ m_gbufferCullingLatePass->gbuffer_late_record(backBufferIndex); });
+
+	addPass(m_gbufferLatePass,"GBufferLate",[&](PassBuilder& builder)
+	{
+		readIndirect(builder,gbufferLateIndirect);
+		builder.read(meshObjects,EResourceAccess::VertexShaderRead);
+		builder.write(baseColorRoughness,EResourceAccess::ColorAttachmentWrite);
+		builder.write(normalMetal,EResourceAccess::ColorAttachmentWrite);
+		builder.write(emissiveAo,EResourceAccess::ColorAttachmentWrite);
+		builder.write(velocity,EResourceAccess::ColorAttachmentWrite);
+		builder.write(depth,EResourceAccess::DepthStencilWrite);
+	},[=](){ m_gbufferLatePass->dynamicRecord(backBufferIndex); });
+
+	addPass(m_depthEvaluateMinMaxPass,"DepthEvaluateMinMax",[&](PassBuilder& builder)
+	{
+		builder.read(depth,EResourceAccess::ComputeShaderRead);
+		builder.write(depthMinMax,EResourceAccess::ComputeShaderWrite);
+		builder.setQueue(EQueueType::AsyncCompute);
+	},[=](){ m_depthEvaluateMinMaxPass->record(backBufferIndex); });
+
+	// NOTE: Runs after DepthEvaluateMinMax on the same queue, the depth is in shader read already.
+	addPass(m_virtualShadowMarkPass,"VirtualShadowMark",[&](PassBuilder& builder)
+	{
+		builder.read(depth,EResourceAccess::ComputeShaderRead);
+		builder.write(virtualShadowRequests,EResourceAccess::ComputeShaderWrite);
+
+		// request readback for the next frames.
+		builder.sideEffect();
+		builder.setQueue(EQueueType::AsyncCompute);
+	},[=](){ m_virtualShadowMarkPass->record(backBufferIndex); });
+
+	addPass(m_cascadeSetupPass,"CascadeSetup",[&](PassBuilder& builder)
+	{
+		builder.read(depthMinMax,EResourceAccess::ComputeShaderRead);
+		builder.write(cascadeSetup,EResourceAccess::ComputeShaderWrite);
+		builder.setQueue(EQueueType::AsyncCompute);
+	},[=](){ m_cascadeSetupPass->record(backBufferIndex); });
+
+	addPass(m_cascasdeCullingPasses,"CascadeCulling",[&](PassBuilder& builder)
+	{
+		builder.read(meshObjects,EResourceAccess::ComputeShaderRead);
+		builder.read(drawBatches,EResourceAccess::ComputeShaderRead);
+		builder.read(cascadeSetup,EResourceAccess::ComputeShaderRead);
+		for(const auto& handles : cascadeIndirect)
+		{
+			writeIndirect(builder,handles);
+		}
+		for(const auto& handles : cascadeDynamicIndirect)
+		{
+			writeIndirect(builder,handles);
+		}
+		writeIndirect(builder,virtualShadowIndirect);
+		builder.setQueue(EQueueType::AsyncCompute);
+	},[=](){ m_cascasdeCullingPasses->cascade_record(backBufferIndex); });
+
+	addPass(m_shadowdepthPasses,"CascadeShadowDepth",[&](PassBuilder& builder)
+	{
+		for(const auto& handles : cascadeIndirect)
+		{
+			readIndirect(builder,handles);
+		}
+		for(const auto& handles : cascadeDynamicIndirect)
+		{
+			readIndirect(builder,handles);
+		}
+		readIndirect(builder,virtualShadowIndirect);
+		builder.read(meshObjects,EResourceAccess::VertexShaderRead);
+		builder.read(cascadeSetup,EResourceAccess::VertexShaderRead);
+		builder.write(cascadeShadowCache,EResourceAccess::DepthStencilWrite);
+		builder.write(cascadeShadow,EResourceAccess::DepthStencilWrite);
+		builder.write(virtualShadowPool,EResourceAccess::DepthStencilWrite);
+	},[=](){ m_shadowdepthPasses->dynamicRecord(backBufferIndex); });
+
+	addPass(m_lightingPass,"Lighting",[&](PassBuilder& builder)
+	{
+		builder.read(baseColorRoughness,EResourceAccess::GraphicsShaderRead);
+		builder.read(normalMetal,EResourceAccess::GraphicsShaderRead);
+		builder.read(emissiveAo,EResourceAccess::GraphicsShaderRead);
+		builder.read(depth,EResourceAccess::GraphicsShaderRead);
+		builder.read(cascadeShadow,EResourceAccess::GraphicsShaderRead);
+		builder.read(cascadeSetup,EResourceAccess::GraphicsShaderRead);
+		builder.read(virtualShadowPool,EResourceAccess::GraphicsShaderRead);
+		builder.write(sceneColor,EResourceAccess::ColorAttachmentWrite);
+	},[=](){ m_lightingPass->dynamicRecord(backBufferIndex); });
+
+	addPass(m_pmxPass,"PMX",[&](PassBuilder& builder)
+	{
+		builder.write(sceneColor,EResourceAccess::ColorAttachmentWrite);
+		builder.write(velocity,EResourceAccess::ColorAttachmentWrite);
+		builder.write(depth,EResourceAccess::DepthStencilWrite);
+	},[=](){ m_pmxPass->dynamicRecord(backBufferIndex); });
+
+	addPass(m_downsamplePass,"Downsample",[&](PassBuilder& builder)
+	{
+		builder.read(sceneColor,EResourceAccess::ComputeShaderRead);
+		builder.write(downsampleChain,EResourceAccess::ComputeShaderWrite);
+		builder.setQueue(EQueueType::AsyncCompute);
+	},[=](){ m_downsamplePass->record(backBufferIndex); });
+
+	addPass(m_bloomPass,"Bloom",[&](PassBuilder& builder)
+	{
+		// Upsampling samples the lower mip, the downsample barrier no longer reaches fragment shaders.
+		builder.read(downsampleChain,EResourceAccess::GraphicsShaderRead);
+		builder.write(downsampleChain,EResourceAccess::ColorAttachmentWrite);
+		builder.write(sceneColor,EResourceAccess::ColorAttachmentWrite);
+	},[=](){ m_bloomPass->dynamicRecord(backBufferIndex); });
+
+	addPass(m_taaPass,"TAA",[&](PassBuilder& builder)
+	{
+		builder.read(depth,EResourceAccess::ComputeShaderRead);
+		builder.read(velocity,EResourceAccess::ComputeShaderRead);
+		builder.read(normalMetal,EResourceAccess::ComputeShaderRead);
+		builder.write(sceneColor,EResourceAccess::ComputeShaderReadWrite);
+		builder.write(history,EResourceAccess::ComputeShaderReadWrite);
+		builder.write(taa,EResourceAccess::ComputeShaderReadWrite);
+		builder.setQueue(EQueueType::AsyncCompute);
+	},[=](){ m_taaPass->record(backBufferIndex); });
+
+	addPass(m_tonemapperPass,"Tonemapper",[&](PassBuilder& builder)
+	{
+		builder.read(sceneColor,EResourceAccess::GraphicsShaderRead);
+		builder.write(tonemapper,EResourceAccess::ColorAttachmentWrite);
+	},[=](){ m_tonemapperPass->dynamicRecord(backBufferIndex); });
+
+	m_passRecordMs.assign(m_frameGraphPasses.size(),0.0f);
+}
+
+void Renderer::updateRecordStats(float wallMs,uint32 jobCount)
+{
+	constexpr float smooth = 0.1f;
+
+	const auto& passes = m_frameGraph.getPasses();
+	if(m_recordStats.passes.size() != passes.size())
+	{
+		m_recordStats.passes.assign(passes.size(),{});
+	}
+
+	for(size_t i = 0; i < passes.size(); i++)
+	{
+		auto& stat = m_recordStats.passes[i];
+		if(stat.name != passes[i].name)
+		{
+			stat.name = passes[i].name;
+			stat.recordMs = m_passRecordMs[i];
+		}
+		stat.recordMs = glm::mix(stat.recordMs,m_passRecordMs[i],smooth);
+	}
+	m_recordStats.wallMs = glm::mix(m_recordStats.wallMs,wallMs,smooth);
+	m_recordStats.jobCount = jobCount;
+}
+
 void Renderer::UpdateScreenSize(uint32 width,uint32 height)
 {
 	const uint32 renderSceneWidth = glm::max(width,ScreenTextureInitSize);
@@ -4,6 +4,9 @@
 #include "render_scene.h"
 #include "../shader_compiler/shader_compiler.h"
 #include "frame_data.h"
+#include "frame_graph/frame_graph.h"
+#include "command_recorder.h"
+#include "rendertarget_pool.h"
 
 
 namespace engine{
@@ -15,10 +18,13 @@ extern VkCompareOp getEngineZTestFunc();
 extern float getExposure();
 extern bool TAAOpen();
 
+class PassCommon;
 class GraphicsPass;
 class GpuCullingPass;
 class ShadowDepthPass;
 class GpuDepthEvaluateMinMaxPass;
+class GpuVirtualShadowMarkPass;
+class GpuPMXSkinningPass;
 class GpuCascadeSetupPass;
 class TAAPass;
 class DownSamplePass;
@@ -49,7 +55,23 @@ public:
 
 	void UpdateScreenSize(uint32 width,uint32 height);
 	RenderScene& getRenderScene() { return *m_renderScene; }
+	RenderTargetPool& getRenderTargetPool() { return m_renderTargetPool; }
 	PerFrameData& getFrameData() { return m_frameData; }
+	const GPUFrameData& getGPUFrameData() const { return m_gpuFrameData; }
+
+	struct PassRecordStat
+	{
+		std::string name;
+		float recordMs = 0.0f; // smoothed cpu time spent in the pass' record callback.
+	};
+
+	struct RecordStats
+	{
+		std::vector<PassRecordStat> passes = {};
+		float wallMs = 0.0f; // smoothed time from first to last recorded pass.
+		uint32 jobCount = 1;
+	};
+	const RecordStats& getRecordStats() const { return m_recordStats; }
 
 private:
 	ImguiPass* m_uiPass;
@@ -92,9 +114,16 @@ public:
 
 public:
 
+	GpuPMXSkinningPass* m_pmxSkinningPass;
 	GpuCullingPass* m_gbufferCullingPass;
 	GraphicsPass*   m_gbufferPass;
+
+	// Late occlusion phase, see EOcclusionPhase.
+	DownSamplePass* m_hzbPass;
+	GpuCullingPass* m_gbufferCullingLatePass;
+	GraphicsPass*   m_gbufferLatePass;
 	GpuDepthEvaluateMinMaxPass* m_depthEvaluateMinMaxPass;
+	GpuVirtualShadowMarkPass* m_virtualShadowMarkPass;
 	GpuCascadeSetupPass* m_cascadeSetupPass;
 
 	GpuCullingPass* m_cascasdeCullingPasses;
@@ -110,6 +139,45 @@ public:
 
 private:
 	void prepareBasicTextures();
+
+	// NOTE: Rebuilt every frame from the passes above, drives pass recording and the submit chain.
+	frame_graph::FrameGraph m_frameGraph;
+	frame_graph::FrameGraphTransientCache m_frameGraphTransientCache;
+	std::vector<PassCommon*> m_frameGraphPasses {};
+	frame_graph::ResourceHandle m_frameGraphDepthMinMax = frame_graph::INVALID_RESOURCE;
+
+	// NOTE: Scene textures and pass owned targets, reused across resizes without waiting for idle.
+	RenderTargetPool m_renderTargetPool {};
+
+	// NOTE: Batched submit mode records every scene pass into one of these, one per back buffer,
+	//       or into per pass buffers of the parallel recorder when more than one record job is used.
+	std::vector<VulkanCommandBuffer*> m_sceneCommandBufs {};
+	ParallelCommandRecorder m_commandRecorder {};
+
+	// NOTE: One timeline semaphore per queue the graph submits to. Every submit batch signals the next
+	//       value of its queue, batches on the other queue wait on that value.
+	std::array<VkSemaphore,size_t(frame_graph::EQueueType::Count)> m_queueTimelines {};
+	std::array<uint64,size_t(frame_graph::EQueueType::Count)> m_queueTimelineValues {};
+	void createQueueTimelines();
+	void releaseQueueTimelines();
+
+	std::vector<float> m_passRecordMs {};
+	RecordStats m_recordStats {};
+	void updateRecordStats(float wallMs,uint32 jobCount);
+
+	struct SubmitStats
+	{
+		uint32 frameCount = 0;
+		uint32 submitCount = 0;
+		uint32 semaphoreCount = 0;
+		double recordAndSubmitMs = 0.0;
+	} m_submitStats;
+
+	void buildFrameGraph(uint32 backBufferIndex);
+	void exportTrace();
+	void submitPerPass(uint32 backBufferIndex,VkCommandBuffer dynamicBuf);
+	void submitBatched(uint32 backBufferIndex,VkCommandBuffer dynamicBuf);
+	void submitAsyncBatches(const std::vector<std::vector<VkCommandBuffer>>& batchCmdBufs);
 };
 
 }
\ No newline at end of file
@@ -1,3 +1,297 @@
 #include "rendertarget_pool.h"
 
-using namespace engine;
+namespace engine{
+
+static AutoCVarInt32 cVarUnusedFrames(
+	"r.RenderTargetPool.UnusedFrames",
+	"Frames a released render target stays in the pool before it is destroyed.",
+	"RenderTargetPool",
+	60,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarAlias(
+	"r.RenderTargetPool.Alias",
+	"Let render targets with non overlapping lifetimes share memory. 0 gives every target its own allocation.",
+	"RenderTargetPool",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+RenderTargetDesc RenderTargetDesc::color(uint32 width,uint32 height,VkFormat format,VkImageUsageFlags usage)
+{
+	RenderTargetDesc desc { };
+	desc.type = ERenderTargetType::Color;
+	desc.format = format;
+	desc.width = width;
+	desc.height = height;
+	desc.usage = usage;
+	return desc;
+}
+
+RenderTargetDesc RenderTargetDesc::depth(uint32 width,uint32 height)
+{
+	RenderTargetDesc desc { };
+	desc.type = ERenderTargetType::Depth;
+	desc.format = VulkanRHI::get()->getVulkanDevice()->findDepthOnlyFormat();
+	desc.width = width;
+	desc.height = height;
+	desc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	return desc;
+}
+
+RenderTargetDesc RenderTargetDesc::depthArray(uint32 width,uint32 height,uint32 arrayLayers)
+{
+	RenderTargetDesc desc = depth(width,height);
+	desc.type = ERenderTargetType::DepthArray;
+	desc.arrayLayers = arrayLayers;
+	desc.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	return desc;
+}
+
+void RenderTargetPool::init()
+{
+	release();
+}
+
+void RenderTargetPool::release()
+{
+	for(auto& entry : m_entries)
+	{
+		CHECK(entry->refCount == 0 && "Render target still in use when the pool is released.");
+		destroyEntry(*entry);
+	}
+	m_entries.clear();
+	m_frame = 0;
+	m_stats = {};
+}
+
+void RenderTargetPool::tick()
+{
+	m_frame++;
+
+	// NOTE: The present image was acquired, so every frame older than the frames in flight is finished
+	//       and entries released back then can be destroyed right away.
+	const uint64 framesInFlight = VulkanRHI::get()->getMaxFramesInFlight();
+	const uint64 unusedFrames = glm::max((uint64)glm::max(cVarUnusedFrames.get(),0),framesInFlight);
+
+	bool bChange = false;
+	for(size_t i = 0; i < m_entries.size();)
+	{
+		auto& entry = *m_entries[i];
+		if(entry.refCount == 0 && m_frame - entry.lastUsedFrame > unusedFrames)
+		{
+			destroyEntry(entry);
+			m_entries[i] = std::move(m_entries.back());
+			m_entries.pop_back();
+			m_stats.freedEntries++;
+			bChange = true;
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	if(bChange)
+	{
+		updateStats();
+	}
+}
+
+VulkanImage* RenderTargetPool::acquire(const RenderTargetDesc& desc)
+{
+	return acquireAliased({ desc })[0];
+}
+
+std::vector<VulkanImage*> RenderTargetPool::acquireAliased(const std::vector<RenderTargetDesc>& descs)
+{
+	CHECK(!descs.empty());
+
+	Entry* entry = findFreeEntry(descs);
+	if(entry)
+	{
+		m_stats.reusedEntries++;
+	}
+	else
+	{
+		entry = createEntry(descs,descs.size() > 1 && cVarAlias.get() != 0);
+		m_stats.createdEntries++;
+	}
+
+	entry->refCount = (uint32)entry->targets.size();
+	entry->lastUsedFrame = m_frame;
+	updateStats();
+
+	std::vector<VulkanImage*> targets(entry->targets.size());
+	for(size_t i = 0; i < targets.size(); i++)
+	{
+		targets[i] = entry->targets[i].get();
+	}
+	return targets;
+}
+
+void RenderTargetPool::release(VulkanImage* target)
+{
+	if(target == nullptr)
+	{
+		return;
+	}
+
+	for(auto& entry : m_entries)
+	{
+		for(auto& owned : entry->targets)
+		{
+			if(owned.get() == target)
+			{
+				CHECK(entry->refCount > 0);
+				entry->refCount--;
+				entry->lastUsedFrame = m_frame;
+				updateStats();
+				return;
+			}
+		}
+	}
+
+	CHECK(false && "Render target was not acquired from this pool.");
+}
+
+RenderTargetPool::Entry* RenderTargetPool::findFreeEntry(const std::vector<RenderTargetDesc>& descs)
+{
+	// NOTE: Frames still in flight may use a target released this frame or the ones before it.
+	const uint64 framesInFlight = VulkanRHI::get()->getMaxFramesInFlight();
+
+	for(auto& entry : m_entries)
+	{
+		if(entry->refCount == 0 && m_frame - entry->lastUsedFrame >= framesInFlight && entry->descs == descs)
+		{
+			return entry.get();
+		}
+	}
+	return nullptr;
+}
+
+RenderTargetPool::Entry* RenderTargetPool::createEntry(const std::vector<RenderTargetDesc>& descs,bool bAlias)
+{
+	auto entry = std::make_unique<Entry>();
+	entry->descs = descs;
+
+	if(bAlias)
+	{
+		VkDevice device = VulkanRHI::get()->getDevice();
+
+		// NOTE: Requirements only depend on the create info, so query them with throwaway images.
+		VkMemoryRequirements requirements { 0, 1, ~0u };
+		for(const auto& desc : descs)
+		{
+			CHECK(desc.type == ERenderTargetType::Color && "Only color targets can alias.");
+
+			auto info = getImageCreateInfo(desc);
+			VkImage image;
+			vkCheck(vkCreateImage(device,&info,nullptr,&image));
+
+			VkMemoryRequirements imageRequirements;
+			vkGetImageMemoryRequirements(device,image,&imageRequirements);
+			vkDestroyImage(device,image,nullptr);
+
+			requirements.size = glm::max(requirements.size,imageRequirements.size);
+			requirements.alignment = glm::max(requirements.alignment,imageRequirements.alignment);
+			requirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+		}
+
+		if(requirements.memoryTypeBits == 0)
+		{
+			LOG_GRAPHICS_WARN("Render targets have no memory type in common, created without aliasing.");
+		}
+		else
+		{
+			VmaAllocationCreateInfo allocInfo { };
+			allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+			allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			vkCheck(vmaAllocateMemory(VulkanRHI::get()->getVmaAllocator(),&requirements,&allocInfo,&entry->aliasAllocation,nullptr));
+			entry->bytes = requirements.size;
+		}
+	}
+
+	for(const auto& desc : descs)
+	{
+		entry->targets.emplace_back(createTarget(desc,entry->aliasAllocation));
+		if(entry->aliasAllocation == nullptr)
+		{
+			entry->bytes += entry->targets.back()->getSize();
+		}
+	}
+
+	m_entries.push_back(std::move(entry));
+	return m_entries.back().get();
+}
+
+void RenderTargetPool::destroyEntry(Entry& entry)
+{
+	// Images first, they are bound to the alias allocation.
+	entry.targets.clear();
+	if(entry.aliasAllocation != nullptr)
+	{
+		vmaFreeMemory(VulkanRHI::get()->getVmaAllocator(),entry.aliasAllocation);
+		entry.aliasAllocation = nullptr;
+	}
+}
+
+void RenderTargetPool::updateStats()
+{
+	m_stats.entryCount = (uint32)m_entries.size();
+	m_stats.freeEntryCount = 0;
+	m_stats.bytes = 0;
+	m_stats.aliasedBytes = 0;
+	for(const auto& entry : m_entries)
+	{
+		m_stats.freeEntryCount += entry->refCount == 0 ? 1 : 0;
+		m_stats.bytes += entry->bytes;
+		if(entry->aliasAllocation != nullptr)
+		{
+			VkDeviceSize separateBytes = 0;
+			for(const auto& target : entry->targets)
+			{
+				separateBytes += target->getSize();
+			}
+			m_stats.aliasedBytes += separateBytes - entry->bytes;
+		}
+	}
+}
+
+VkImageCreateInfo RenderTargetPool::getImageCreateInfo(const RenderTargetDesc& desc)
+{
+	// Matches RenderTexture::create.
+	VkImageCreateInfo info { };
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	info.imageType = VK_IMAGE_TYPE_2D;
+	info.format = desc.format;
+	info.extent = { desc.width, desc.height, 1 };
+	info.mipLevels = desc.mipLevels;
+	info.arrayLayers = desc.arrayLayers;
+	info.samples = VK_SAMPLE_COUNT_1_BIT;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.usage = desc.usage;
+	info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VulkanRHI::get()->getVulkanDevice()->setSharingMode(info);
+	return info;
+}
+
+VulkanImage* RenderTargetPool::createTarget(const RenderTargetDesc& desc,VmaAllocation aliasAllocation)
+{
+	auto* device = VulkanRHI::get()->getVulkanDevice();
+	switch(desc.type)
+	{
+	case ERenderTargetType::Color:
+		return RenderTexture::create(device,desc.width,desc.height,desc.mipLevels,desc.bMipViews,desc.format,desc.usage,aliasAllocation);
+	case ERenderTargetType::Depth:
+		return DepthOnlyImage::create(device,desc.width,desc.height);
+	case ERenderTargetType::DepthArray:
+		return DepthOnlyTextureArray::create(device,desc.width,desc.height,desc.arrayLayers);
+	}
+
+	CHECK(false && "Unknown render target type.");
+	return nullptr;
+}
+
+}
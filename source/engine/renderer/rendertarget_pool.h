@@ -1,11 +1,104 @@
 #pragma once
+#include "../vk/vk_rhi.h"
+#include <memory>
 
 namespace engine{
 
+enum class ERenderTargetType : uint8
+{
+	Color,      // RenderTexture.
+	Depth,      // DepthOnlyImage, format and usage come from the device.
+	DepthArray, // DepthOnlyTextureArray, format and usage come from the device.
+};
+
+struct RenderTargetDesc
+{
+	ERenderTargetType type = ERenderTargetType::Color;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32 width = 0;
+	uint32 height = 0;
+	uint32 mipLevels = 1;
+	uint32 arrayLayers = 1;
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	// Per mip views, see RenderTexture::getMipmapView.
+	bool bMipViews = false;
+
+	bool operator==(const RenderTargetDesc& other) const
+	{
+		return type == other.type && format == other.format && width == other.width && height == other.height &&
+			mipLevels == other.mipLevels && arrayLayers == other.arrayLayers && usage == other.usage && bMipViews == other.bMipViews;
+	}
+
+	static RenderTargetDesc color(uint32 width,uint32 height,VkFormat format,VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	static RenderTargetDesc depth(uint32 width,uint32 height);
+	static RenderTargetDesc depthArray(uint32 width,uint32 height,uint32 arrayLayers);
+};
+
+// NOTE: Hands out render targets by descriptor and keeps released ones around for reuse. A released
+//       target is only handed out again once every frame in flight which may still use it finished,
+//       and it is destroyed after r.RenderTargetPool.UnusedFrames frames without use, so reallocating
+//       never has to wait for the device. Content of an acquired target is undefined.
 class RenderTargetPool
 {
-	
+public:
+	struct Stats
+	{
+		uint32 entryCount = 0;        // alive entries, a group of aliased targets is one entry.
+		uint32 freeEntryCount = 0;    // alive entries waiting for reuse.
+		VkDeviceSize bytes = 0;       // memory of alive entries.
+		VkDeviceSize aliasedBytes = 0;// memory aliasing saved compared to one allocation per target.
+		uint32 createdEntries = 0;    // since init.
+		uint32 reusedEntries = 0;     // since init.
+		uint32 freedEntries = 0;      // since init.
+	};
+
+	void init();
+	void release();
+
+	// NOTE: Call once per frame after the present image was acquired.
+	void tick();
+
+	VulkanImage* acquire(const RenderTargetDesc& desc);
+
+	// NOTE: Color targets whose lifetimes don't overlap share one allocation sized for the biggest of them.
+	//       The caller must never use two of them at the same time, must order the last access of one
+	//       before the first access of the next with a barrier and must treat the content as undefined
+	//       (initial layout VK_IMAGE_LAYOUT_UNDEFINED) every time one of them is written again.
+	//       Frame graph transients are placed again on every compile, these keep their memory until
+	//       released, so passes can build framebuffers and descriptor sets on them once per resize.
+	std::vector<VulkanImage*> acquireAliased(const std::vector<RenderTargetDesc>& descs);
+
+	// NOTE: An aliased group goes back to the pool once all of its targets are released.
+	void release(VulkanImage* target);
+
+	const Stats& getStats() const { return m_stats; }
+
+private:
+	struct Entry
+	{
+		std::vector<RenderTargetDesc> descs = {};
+		std::vector<std::unique_ptr<VulkanImage>> targets = {};
+
+		// Shared memory of an aliased group, nullptr when every target owns its memory.
+		VmaAllocation aliasAllocation = nullptr;
+		VkDeviceSize bytes = 0;
+
+		uint32 refCount = 0;
+		uint64 lastUsedFrame = 0;
+	};
+
+	Entry* findFreeEntry(const std::vector<RenderTargetDesc>& descs);
+	Entry* createEntry(const std::vector<RenderTargetDesc>& descs,bool bAlias);
+	void destroyEntry(Entry& entry);
+	void updateStats();
+
+	static VkImageCreateInfo getImageCreateInfo(const RenderTargetDesc& desc);
+	static VulkanImage* createTarget(const RenderTargetDesc& desc,VmaAllocation aliasAllocation);
 
+	std::vector<std::unique_ptr<Entry>> m_entries = {};
+	uint64 m_frame = 0;
+	Stats m_stats = {};
 };
 
-}
\ No newline at end of file
+}
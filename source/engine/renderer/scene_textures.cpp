@@ -50,18 +50,20 @@ VkSampler SceneTextures::getCascadeShadowDepthMapArraySampler()
     return VulkanRHI::get()->createSampler(ci);
 }
 
-void SceneTextures::allocate(uint32 width,uint32 height,bool forceAllocate)
+void SceneTextures::allocate(RenderTargetPool& pool,uint32 width,uint32 height,bool forceAllocate)
 {
     if(!forceAllocate && m_init && width == m_cacheSceneWidth && height == m_cacheSceneHeight)
     {
         return;
     }
-    
-    VulkanRHI::get()->waitIdle();
+
+    // NOTE: No wait for idle here, the pool keeps released targets alive until the frames in flight
+    //       are done with them and passes release their framebuffers and pipelines the same way.
+    m_pool = &pool;
     
     if(m_init)
     {
-        release(); // ͷţȻȫ
+        release(); // Return the old targets to the pool.
         for(auto& callBackPair : m_callbackBeforeSceneTextureRecreate)
         {
             callBackPair.second();
@@ -70,85 +72,32 @@ void SceneTextures::allocate(uint32 width,uint32 height,bool forceAllocate)
 
     m_cacheSceneWidth = width;
     m_cacheSceneHeight = height;
-        
-	m_sceneColorTexture = RenderTexture::create(
-        VulkanRHI::get()->getVulkanDevice(),
-        width,
-        height,
-        getHDRSceneColorFormat(),
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT|VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_STORAGE_BIT
-    );
-
-    m_depthStencilTexture = DepthOnlyImage::create(
-        VulkanRHI::get()->getVulkanDevice(),
-        width,
-        height
-    );
-
-    m_tonemapper = RenderTexture::create(
-        VulkanRHI::get()->getVulkanDevice(),
-        width,
-        height,
-        getToneMapperFormat() 
-    );
-
-    m_gbufferBaseColorRoughness = RenderTexture::create(
-        VulkanRHI::get()->getVulkanDevice(),
-        width,
-        height,
-        getGbufferBaseColorRoughnessFormat()
-    );
-
-    m_gbufferEmissiveAo = RenderTexture::create(
-        VulkanRHI::get()->getVulkanDevice(),
-        width,
-        height,
-        getGbufferEmissiveAoFormat()
-    );
-
-    m_gbufferNormalMetal = RenderTexture::create(
-        VulkanRHI::get()->getVulkanDevice(),
-        width,
-        height,
-        getGbufferNormalMetalFormat(),
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT
-    );
-
-	m_historyTexture = RenderTexture::create(
-		VulkanRHI::get()->getVulkanDevice(),
-		width,
-        height,
-		getHistoryFormat(),
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT
-	);
-
-    m_velocityTexture = RenderTexture::create(
-		VulkanRHI::get()->getVulkanDevice(),
-		width,
-        height,
-		getVelocityFormat(),
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT
-    );
-
-    m_taaTexture = RenderTexture::create(
-        VulkanRHI::get()->getVulkanDevice(),
-        width,
-        height,
-        getTAAFormat(),
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT
-    );
-
-    m_downsampleChainTexture = RenderTexture::create(
-		VulkanRHI::get()->getVulkanDevice(),
-		std::max(1u, width   / 2), // 0Ӱֱʿʼ
-        std::max(1u, height  / 2), // 0Ӱֱʿʼ
-        g_downsampleCount,
-        true,
-		getDownSampleFormat(),
-		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT
-    );
-
-    m_downsampleChainTexture->transitionLayoutImmediately(VulkanRHI::get()->getGraphicsCommandPool(),VulkanRHI::get()->getGraphicsQueue(),VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    const VkImageUsageFlags storageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+
+    m_sceneColorTexture = pool.acquire(RenderTargetDesc::color(width,height,getHDRSceneColorFormat(),storageUsage));
+    m_depthStencilTexture = pool.acquire(RenderTargetDesc::depth(width,height));
+    m_tonemapper = pool.acquire(RenderTargetDesc::color(width,height,getToneMapperFormat()));
+    m_gbufferBaseColorRoughness = pool.acquire(RenderTargetDesc::color(width,height,getGbufferBaseColorRoughnessFormat()));
+    m_gbufferEmissiveAo = pool.acquire(RenderTargetDesc::color(width,height,getGbufferEmissiveAoFormat()));
+    m_gbufferNormalMetal = pool.acquire(RenderTargetDesc::color(width,height,getGbufferNormalMetalFormat(),storageUsage));
+    m_historyTexture = pool.acquire(RenderTargetDesc::color(width,height,getHistoryFormat(),storageUsage));
+    m_velocityTexture = pool.acquire(RenderTargetDesc::color(width,height,getVelocityFormat(),storageUsage));
+    m_taaTexture = pool.acquire(RenderTargetDesc::color(width,height,getTAAFormat(),storageUsage));
+
+    // Mip #0 starts at half resolution.
+    auto downsampleDesc = RenderTargetDesc::color(std::max(1u,width / 2),std::max(1u,height / 2),getDownSampleFormat(),storageUsage);
+    downsampleDesc.mipLevels = g_downsampleCount;
+    downsampleDesc.bMipViews = true;
+    m_downsampleChainTexture = pool.acquire(downsampleDesc);
+
+    auto hzbDesc = RenderTargetDesc::color(std::max(1u,width / 2),std::max(1u,height / 2),getHZBFormat(),storageUsage);
+    hzbDesc.mipLevels = uint32(std::floor(std::log2(float(std::max(hzbDesc.width,hzbDesc.height))))) + 1;
+    hzbDesc.bMipViews = true;
+    m_hzbTexture = pool.acquire(hzbDesc);
+
+    // NOTE: Passes expect the chains in shader read, recorded at frame begin instead of a blocking submit.
+    m_bMipChainsNeedTransition = true;
 
     if(m_needPrepareTexture)
     {
@@ -185,12 +134,11 @@ void SceneTextures::allocate(uint32 width,uint32 height,bool forceAllocate)
     uint32 singleShadowMapHeight = uint32(*singleShadowMapSizePtr);
 	uint32 cascadeNum = CASCADE_MAX_COUNT;
 
-    m_cascadeShadowDepthMapArray = DepthOnlyTextureArray::create(
-		VulkanRHI::get()->getVulkanDevice(),
-        singleShadowMapWidth,
-        singleShadowMapHeight,
-        cascadeNum
-    );
+    m_cascadeShadowDepthMapArray = static_cast<DepthOnlyTextureArray*>(pool.acquire(RenderTargetDesc::depthArray(singleShadowMapWidth,singleShadowMapHeight,cascadeNum)));
+    m_cascadeShadowStaticCache = static_cast<DepthOnlyTextureArray*>(pool.acquire(RenderTargetDesc::depthArray(singleShadowMapWidth,singleShadowMapHeight,cascadeNum)));
+
+    const uint32 virtualShadowPoolSize = VirtualShadowMap::getPoolTextureSize();
+    m_virtualShadowPool = static_cast<DepthOnlyTextureArray*>(pool.acquire(RenderTargetDesc::depthArray(virtualShadowPoolSize,virtualShadowPoolSize,1)));
 
     for(auto& callBackPair : m_callbackAfterSceneTextureRecreate)
     {
@@ -223,18 +171,22 @@ void SceneTextures::release(bool bAll)
         return;
     }
 
-    delete m_depthStencilTexture;
-    delete m_sceneColorTexture;
-    delete m_tonemapper;
-
-    delete m_gbufferBaseColorRoughness;
-    delete m_gbufferEmissiveAo;
-    delete m_gbufferNormalMetal;
-    delete m_cascadeShadowDepthMapArray;
-    delete m_historyTexture;
-    delete m_velocityTexture;
-    delete m_taaTexture;
-    delete m_downsampleChainTexture;
+    CHECK(m_pool);
+    m_pool->release(m_depthStencilTexture);
+    m_pool->release(m_sceneColorTexture);
+    m_pool->release(m_tonemapper);
+
+    m_pool->release(m_gbufferBaseColorRoughness);
+    m_pool->release(m_gbufferEmissiveAo);
+    m_pool->release(m_gbufferNormalMetal);
+    m_pool->release(m_cascadeShadowDepthMapArray);
+    m_pool->release(m_cascadeShadowStaticCache);
+    m_pool->release(m_virtualShadowPool);
+    m_pool->release(m_historyTexture);
+    m_pool->release(m_velocityTexture);
+    m_pool->release(m_taaTexture);
+    m_pool->release(m_downsampleChainTexture);
+    m_pool->release(m_hzbTexture);
 
     m_init = false;
 }
@@ -249,9 +201,39 @@ Ref<VulkanImage> SceneTextures::getTAA()
    return m_taaTexture;
 }
 
-void SceneTextures::frameBegin()
+void SceneTextures::frameBegin(VkCommandBuffer cmd)
 {
+    if(m_bMipChainsNeedTransition)
+    {
+        // Content is rewritten every frame, so a reused chain is discarded as well.
+        // The hzb is only read after this frame's build, never the discarded content.
+        VkImageSubresourceRange range { };
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.levelCount = VK_REMAINING_MIP_LEVELS;
+        range.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+        const std::array<VulkanImage*,2> chains = { m_downsampleChainTexture, m_hzbTexture };
+        std::array<VkImageMemoryBarrier,2> barriers { };
+        for(size_t i = 0; i < chains.size(); i++)
+        {
+            barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[i].image = chains[i]->getImage();
+            barriers[i].subresourceRange = range;
+            barriers[i].srcAccessMask = 0;
+            barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
 
+        vkCmdPipelineBarrier(cmd,VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,0,0,nullptr,0,nullptr,(uint32)barriers.size(),barriers.data());
+        for(auto* chain : chains)
+        {
+            chain->setCurrentLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
+        m_bMipChainsNeedTransition = false;
+    }
 }
 
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "../vk/vk_rhi.h"
+#include "rendertarget_pool.h"
 
 namespace engine{
 
@@ -32,6 +33,10 @@ private:
 	//       maybe i should put it on bloom pass.
 	// note: after bloom pass, all downsample chain texture will blend with blur.
 	VulkanImage* m_downsampleChainTexture;
+
+	// Hierarchical depth for occlusion culling, mip #0 at half resolution down to 1x1.
+	// Every texel holds the farthest depth of the pixels it covers.
+	VulkanImage* m_hzbTexture;
 	
 	// full screen r16g16
 	VulkanImage* m_velocityTexture; //  R16G16
@@ -39,8 +44,18 @@ private:
 	// Cascade shadow texture array.
 	DepthOnlyTextureArray* m_cascadeShadowDepthMapArray;
 
+	// Static caster depth of every cascade, copied into the cascade array before the dynamic casters.
+	DepthOnlyTextureArray* m_cascadeShadowStaticCache;
+
+	// Physical pages of the virtual shadow map, one layer of VirtualShadowMap::POOL_SIZE pages per side.
+	DepthOnlyTextureArray* m_virtualShadowPool;
+
 	bool m_init = false;
 	bool m_needPrepareTexture = true;
+	bool m_bMipChainsNeedTransition = false;
+
+	// Scene size targets come from the renderer's pool, the global caches above are owned here.
+	RenderTargetPool* m_pool = nullptr;
 
 	uint32 m_cacheSceneWidth = ScreenTextureInitSize;
 	uint32 m_cacheSceneHeight = ScreenTextureInitSize;
@@ -63,6 +78,7 @@ public:
 	static VkFormat getBRDFLutFormat() { return VK_FORMAT_R16G16_SFLOAT; }
 
 	static VkFormat getDownSampleFormat() { return VK_FORMAT_R16G16B16A16_SFLOAT; }
+	static VkFormat getHZBFormat() { return VK_FORMAT_R32_SFLOAT; }
 
 	static VkFormat getHistoryFormat() { return VK_FORMAT_R16G16B16A16_SFLOAT; }
 	static VkFormat getVelocityFormat() { return VK_FORMAT_R16G16_SFLOAT; }
@@ -73,9 +89,11 @@ public:
 	static uint32 getSpecularPrefilterCubeDim() { return 1024; }
 
 	DepthOnlyTextureArray* getCascadeShadowDepthMapArray(){return m_cascadeShadowDepthMapArray;}
+	DepthOnlyTextureArray* getCascadeShadowStaticCache(){return m_cascadeShadowStaticCache;}
+	DepthOnlyTextureArray* getVirtualShadowPool(){return m_virtualShadowPool;}
 	VkSampler getCascadeShadowDepthMapArraySampler();
 
-	void allocate(uint32 width,uint32 height,bool forceAllocate = false);
+	void allocate(RenderTargetPool& pool,uint32 width,uint32 height,bool forceAllocate = false);
 	void release(bool bAll = false);
 
 	Ref<VulkanImage> getHDRSceneColor() { return m_sceneColorTexture; }
@@ -88,6 +106,7 @@ public:
 	Ref<VulkanImage> getIrradiancePrefilterCube() { return m_irradiancePrefilterTextureCube; }
 	Ref<VulkanImage> getSpecularPrefilterCube() { return m_specularPrefilterTextureCube; }
 	Ref<VulkanImage> getDownSampleChain() { return m_downsampleChainTexture; }
+	Ref<VulkanImage> getHZB() { return m_hzbTexture; }
 
 	Ref<VulkanImage> getHistory();
 	Ref<VulkanImage> getVelocity() { return m_velocityTexture; }
@@ -122,7 +141,8 @@ public:
 		this->m_callbackAfterSceneTextureRecreate.erase(name);
 	}
 
-	void frameBegin();
+	// NOTE: Records pending layout transitions of new targets, cmd runs before the scene passes.
+	void frameBegin(VkCommandBuffer cmd);
 };
 
 }
\ No newline at end of file
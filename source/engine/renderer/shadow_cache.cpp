@@ -0,0 +1,281 @@
+#include "shadow_cache.h"
+#include <algorithm>
+#include <bitset>
+#include <vector>
+
+namespace engine{
+
+static AutoCVarInt32 cVarShadowCacheEnable(
+	"r.Shadow.Cache.Enable",
+	"Cache the static caster depth of the cascades and only redraw dynamic casters every frame. 0 is off, 1 is on.",
+	"Shadow",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarShadowCacheFarInterval(
+	"r.Shadow.Cache.FarInterval",
+	"Frames between refreshes of the cascades past the first one while the camera moves.",
+	"Shadow",
+	4,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarShadowCacheMaxUpdates(
+	"r.Shadow.Cache.MaxUpdates",
+	"Cascades refreshed per frame at most, cascades without valid content are refreshed past the budget.",
+	"Shadow",
+	2,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarShadowCacheSettleFrames(
+	"r.Shadow.Cache.SettleFrames",
+	"Frames a caster has to stay still before it goes back into the static cache.",
+	"Shadow",
+	30,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarShadowCacheStats(
+	"r.Shadow.Cache.Stats",
+	"Log cascade refreshes and composites since the last log once.",
+	"Shadow",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+// NOTE: About 0.25 degree, a turning sun invalidates the cache every few frames.
+constexpr float LIGHT_DIR_CACHE_THRESHOLD = 0.99999f;
+
+constexpr uint64 FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64 FNV_PRIME = 1099511628211ull;
+
+static uint64 hashBytes(uint64 hash,const void* data,size_t size)
+{
+	const uint8* bytes = static_cast<const uint8*>(data);
+	for(size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+// NOTE: Settings baked into the cached depth.
+static uint64 getShadowSettingsHash()
+{
+	static int32* fixCascade = CVarSystem::get()->getInt32CVar("r.Shadow.FixCascade");
+	static float* depthSlope = CVarSystem::get()->getFloatCVar("r.Shadow.DepthHardwareSlope");
+	static float* depthBias = CVarSystem::get()->getFloatCVar("r.Shadow.DepthHardwareBias");
+	static int32* lodShadowBias = CVarSystem::get()->getInt32CVar("r.Lod.ShadowBias");
+	static int32* lodEnable = CVarSystem::get()->getInt32CVar("r.Lod.Enable");
+	CHECK(fixCascade && depthSlope && depthBias && lodShadowBias && lodEnable);
+
+	uint64 hash = FNV_OFFSET;
+	hash = hashBytes(hash,fixCascade,sizeof(int32));
+	hash = hashBytes(hash,depthSlope,sizeof(float));
+	hash = hashBytes(hash,depthBias,sizeof(float));
+	hash = hashBytes(hash,lodShadowBias,sizeof(int32));
+	hash = hashBytes(hash,lodEnable,sizeof(int32));
+	return hash;
+}
+
+void CascadeShadowCache::beginCasters()
+{
+	m_frame++;
+	m_staticHash = FNV_OFFSET;
+	m_bDynamicCasters = false;
+}
+
+bool CascadeShadowCache::updateCaster(const SceneNode* node,const glm::mat4& model,uint32 firstIndex,uint32 indexCount)
+{
+	const uint32 settleFrames = (uint32)glm::max(cVarShadowCacheSettleFrames.get(),1);
+
+	auto [it,bInserted] = m_casters.try_emplace(node);
+	CasterState& state = it->second;
+	if(bInserted)
+	{
+		// NOTE: New casters start settled, they change the static hash anyway.
+		state.model = model;
+		state.stillFrames = settleFrames;
+		state.lastSeenFrame = m_frame;
+		state.bDynamic = false;
+	}
+	else if(state.lastSeenFrame != m_frame) // later submeshes of the node share its state.
+	{
+		state.lastSeenFrame = m_frame;
+		if(state.model != model)
+		{
+			state.model = model;
+			state.stillFrames = 0;
+		}
+		else
+		{
+			state.stillFrames = glm::min(state.stillFrames + 1,settleFrames);
+		}
+		state.bDynamic = state.stillFrames < settleFrames;
+	}
+
+	if(state.bDynamic)
+	{
+		m_bDynamicCasters = true;
+		return true;
+	}
+
+	m_staticHash = hashBytes(m_staticHash,&model,sizeof(model));
+	m_staticHash = hashBytes(m_staticHash,&firstIndex,sizeof(firstIndex));
+	m_staticHash = hashBytes(m_staticHash,&indexCount,sizeof(indexCount));
+	return false;
+}
+
+void CascadeShadowCache::endCasters(bool bPMXCasters)
+{
+	for(auto it = m_casters.begin(); it != m_casters.end();)
+	{
+		if(it->second.lastSeenFrame != m_frame)
+		{
+			it = m_casters.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	// NOTE: Pmx meshes are skinned every frame, they are always dynamic.
+	m_bDynamicCasters |= bPMXCasters;
+}
+
+void CascadeShadowCache::update(const glm::vec3& lightDir,const glm::mat4& camViewProj,uint32 cascadeCount)
+{
+	CHECK(cascadeCount <= MAX_CASCADE_COUNT);
+	const uint32 allMask = (1u << cascadeCount) - 1;
+
+	m_plan = {};
+	m_plan.bEnable = cVarShadowCacheEnable.get() != 0;
+	m_plan.bDynamicCasters = m_bDynamicCasters;
+
+	const uint64 settingsHash = getShadowSettingsHash();
+	if(!m_plan.bEnable)
+	{
+		// every cascade draws every caster, the cache is rebuilt once turned on again.
+		m_plan.refreshMask = allMask;
+		m_lastStaticHash = m_staticHash;
+		m_settingsHash = settingsHash;
+		m_bInvalid = true;
+		return;
+	}
+
+	const glm::vec3 dir = glm::normalize(lightDir);
+	const bool bDirty =
+		m_staticHash != m_lastStaticHash ||
+		settingsHash != m_settingsHash ||
+		glm::dot(dir,m_lightDir) < LIGHT_DIR_CACHE_THRESHOLD;
+
+	if(bDirty || m_bInvalid)
+	{
+		m_stats.invalidateCount++;
+	}
+
+	m_lastStaticHash = m_staticHash;
+	m_settingsHash = settingsHash;
+	m_lightDir = dir;
+
+	for(uint32 i = 0; i < cascadeCount; i++)
+	{
+		auto& state = m_cascades[i];
+		state.bValid &= !m_bInvalid;
+		state.bDirty |= bDirty;
+	}
+	m_bInvalid = false;
+
+	// NOTE: Cascades without valid content are always refreshed. The others compete for the budget,
+	//       dirty ones first, then by frames waited over their interval. The first cascade follows
+	//       the camera every frame, the far ones every r.Shadow.Cache.FarInterval frames.
+	struct Candidate
+	{
+		uint32 cascadeIndex;
+		float priority;
+	};
+	std::vector<Candidate> candidates;
+	uint32 refreshMask = 0;
+
+	const uint64 farInterval = (uint64)glm::max(cVarShadowCacheFarInterval.get(),1);
+	for(uint32 i = 0; i < cascadeCount; i++)
+	{
+		const auto& state = m_cascades[i];
+		if(!state.bValid)
+		{
+			refreshMask |= 1u << i;
+			continue;
+		}
+
+		const uint64 interval = i == 0 ? 1 : farInterval;
+		const uint64 age = m_frame - state.lastRefreshFrame;
+		const float overdue = float(age) / float(interval);
+		if(state.bDirty)
+		{
+			candidates.push_back({ i, 1e6f + overdue });
+		}
+		else if(age >= interval && state.camViewProj != camViewProj)
+		{
+			candidates.push_back({ i, overdue });
+		}
+	}
+
+	std::stable_sort(candidates.begin(),candidates.end(),[](const Candidate& a,const Candidate& b)
+	{
+		return a.priority > b.priority;
+	});
+
+	const uint32 budget = (uint32)glm::max(cVarShadowCacheMaxUpdates.get(),1);
+	uint32 refreshCount = (uint32)std::bitset<32>(refreshMask).count();
+	for(const auto& candidate : candidates)
+	{
+		if(refreshCount >= budget)
+		{
+			break;
+		}
+		refreshMask |= 1u << candidate.cascadeIndex;
+		refreshCount++;
+	}
+
+	// NOTE: A refreshed cascade copies its new cache. The others copy it again when they have to draw
+	//       dynamic casters or drop the ones of the last frame, otherwise they keep their content.
+	for(uint32 i = 0; i < cascadeCount; i++)
+	{
+		auto& state = m_cascades[i];
+		const bool bRefresh = (refreshMask & (1u << i)) != 0;
+		if(bRefresh)
+		{
+			state.bValid = true;
+			state.bDirty = false;
+			state.lastRefreshFrame = m_frame;
+			state.camViewProj = camViewProj;
+		}
+
+		if(bRefresh || m_bDynamicCasters || state.bHasDynamic)
+		{
+			m_plan.compositeMask |= 1u << i;
+			state.bHasDynamic = m_bDynamicCasters;
+		}
+	}
+	m_plan.refreshMask = refreshMask;
+
+	m_stats.frameCount++;
+	m_stats.refreshCount += (uint32)std::bitset<32>(m_plan.refreshMask).count();
+	m_stats.compositeCount += (uint32)std::bitset<32>(m_plan.compositeMask).count();
+	if(cVarShadowCacheStats.get() != 0)
+	{
+		LOG_INFO("Shadow cache: {0} cascade refreshes and {1} composites over {2} frames, {3} invalidations, {4} tracked casters.",
+			m_stats.refreshCount,
+			m_stats.compositeCount,
+			m_stats.frameCount,
+			m_stats.invalidateCount,
+			m_casters.size());
+		m_stats = {};
+		cVarShadowCacheStats.set(0);
+	}
+}
+
+}
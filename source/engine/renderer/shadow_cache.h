@@ -0,0 +1,88 @@
+#pragma once
+#include "../core/core.h"
+#include <array>
+#include <unordered_map>
+
+namespace engine{
+
+class SceneNode;
+
+// NOTE: Keeps the static caster depth of every cascade in a cache array and only redraws it when the
+//       cascade gets new matrices. Cascades keep their matrices between refreshes, the lighting picks
+//       the first cascade containing the pixel, so a stale cascade only covers a shifted area.
+//       Casters which moved within the last r.Shadow.Cache.SettleFrames frames are dynamic, they are
+//       drawn every frame over a copy of the static depth. Static casters moving, appearing or
+//       settling, the light turning or shadow settings changing invalidate every cascade.
+class CascadeShadowCache
+{
+public:
+	static constexpr uint32 MAX_CASCADE_COUNT = 4;
+
+	// What the shadow passes do this frame, the masks hold one bit per cascade.
+	struct Plan
+	{
+		bool bEnable = false;     // false draws every caster into every cascade like before.
+		uint32 refreshMask = 0;   // new matrices, static casters redrawn into the cache.
+		uint32 compositeMask = 0; // cache copied into the cascade, dynamic casters drawn over it.
+		bool bDynamicCasters = false;
+	};
+
+	struct Stats
+	{
+		uint32 refreshCount = 0;    // cascade refreshes since the last log.
+		uint32 compositeCount = 0;
+		uint32 invalidateCount = 0;
+		uint32 frameCount = 0;
+	};
+
+	// Caster classification, called by RenderScene::meshCollect for every submesh.
+	void beginCasters();
+	bool updateCaster(const SceneNode* node,const glm::mat4& model,uint32 firstIndex,uint32 indexCount);
+	void endCasters(bool bPMXCasters);
+
+	// Once per frame after the casters, lightDir and camViewProj of the frame.
+	void update(const glm::vec3& lightDir,const glm::mat4& camViewProj,uint32 cascadeCount);
+
+	// Cache and cascade content is undefined, e.g. the shadow maps were recreated.
+	void invalidate() { m_bInvalid = true; }
+
+	const Plan& getPlan() const { return m_plan; }
+
+	// Static casters and shadow settings of the last update, the virtual shadow map keys its pages on them.
+	uint64 getStaticHash() const { return m_lastStaticHash; }
+	uint64 getSettingsHash() const { return m_settingsHash; }
+
+private:
+	struct CascadeState
+	{
+		bool bValid = false;
+		bool bDirty = true;
+		bool bHasDynamic = false; // cascade holds dynamic casters over the static depth.
+		uint64 lastRefreshFrame = 0;
+		glm::mat4 camViewProj = glm::mat4(1.0f);
+	};
+
+	struct CasterState
+	{
+		glm::mat4 model;
+		uint32 stillFrames;
+		uint64 lastSeenFrame;
+		bool bDynamic;
+	};
+
+	std::array<CascadeState,MAX_CASCADE_COUNT> m_cascades = {};
+	std::unordered_map<const SceneNode*,CasterState> m_casters = {};
+
+	uint64 m_frame = 0;
+	uint64 m_staticHash = 0;
+	uint64 m_lastStaticHash = 0;
+	uint64 m_settingsHash = 0;
+	glm::vec3 m_lightDir = glm::vec3(0.0f);
+	bool m_bDynamicCasters = false;
+	bool m_bInvalid = true;
+
+	Plan m_plan = {};
+	Stats m_stats = {};
+};
+
+}
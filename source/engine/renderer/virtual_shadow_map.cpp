@@ -0,0 +1,439 @@
+#include "virtual_shadow_map.h"
+#include "renderer.h"
+#include <algorithm>
+
+namespace engine{
+
+static AutoCVarInt32 cVarVirtualShadowEnable(
+	"r.Shadow.Virtual.Enable",
+	"Shadow the directional light with the virtual shadow map, pixels without a resident page use the cascades. 0 is off, 1 is on.",
+	"Shadow",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarFloat cVarVirtualShadowExtent(
+	"r.Shadow.Virtual.Extent",
+	"World size of the finest clipmap level, every further level doubles it.",
+	"Shadow",
+	16.0f,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarFloat cVarVirtualShadowLodBias(
+	"r.Shadow.Virtual.LodBias",
+	"Levels added to the one selected by the pixel footprint, positive values use coarser pages.",
+	"Shadow",
+	0.0f,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarVirtualShadowMaxPageRenders(
+	"r.Shadow.Virtual.MaxPageRenders",
+	"Pages rendered per frame at most, the other requested pages wait for the next frames.",
+	"Shadow",
+	16,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarFloat cVarVirtualShadowDepthRange(
+	"r.Shadow.Virtual.DepthRange",
+	"World size of the depth range of the pages along the light, centered on the camera.",
+	"Shadow",
+	1000.0f,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarFloat cVarVirtualShadowFilterTexels(
+	"r.Shadow.Virtual.FilterTexels",
+	"Pcf radius in texels of the sampled level.",
+	"Shadow",
+	1.5f,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarFloat cVarVirtualShadowSkinnedRadius(
+	"r.Shadow.Virtual.SkinnedRadius",
+	"Model space radius around the origin of skinned meshes, pages under it are rendered again every frame.",
+	"Shadow",
+	20.0f,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarVirtualShadowStats(
+	"r.Shadow.Virtual.Stats",
+	"Log page requests and renders since the last log once.",
+	"Shadow",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+// NOTE: Same threshold as the cascade cache.
+constexpr float LIGHT_DIR_VIRTUAL_THRESHOLD = 0.99999f;
+
+uint64 VirtualShadowMap::getPageKey(uint32 level,const glm::ivec2& page)
+{
+	return (uint64(level) << 56) | (uint64(uint32(page.y) & 0xFFFFFFu) << 24) | uint64(uint32(page.x) & 0xFFFFFFu);
+}
+
+bool VirtualShadowMap::inWindow(uint32 level,const glm::ivec2& page) const
+{
+	const glm::ivec2 local = page - m_origins[level];
+	return local.x >= 0 && local.y >= 0 && local.x < int32(PAGE_TABLE_SIZE) && local.y < int32(PAGE_TABLE_SIZE);
+}
+
+glm::mat4 VirtualShadowMap::getPageViewProj(uint32 level,const glm::ivec2& page) const
+{
+	const float pageWorldSize = getPageWorldSize(level);
+	const float halfRange = m_info.depthRange * 0.5f;
+	const float nearZ = m_depthCenter - halfRange;
+	const float farZ = m_depthCenter + halfRange;
+
+	const bool bReverseZ = reverseZOpen();
+	const glm::mat4 proj = glm::ortho(
+		float(page.x) * pageWorldSize,
+		float(page.x + 1) * pageWorldSize,
+		float(page.y) * pageWorldSize,
+		float(page.y + 1) * pageWorldSize,
+		bReverseZ ? farZ : nearZ,
+		bReverseZ ? nearZ : farZ
+	);
+	return proj * m_lightView;
+}
+
+void VirtualShadowMap::beginCasters()
+{
+	m_lastDynamicCasters.swap(m_dynamicCasters);
+	m_dynamicCasters.clear();
+}
+
+void VirtualShadowMap::addDynamicCaster(const glm::vec3& center,float radius)
+{
+	m_dynamicCasters.push_back(glm::vec4(center,radius));
+}
+
+void VirtualShadowMap::addSkinnedCaster(const glm::mat4& modelMatrix)
+{
+	const float scale = glm::max(
+		glm::length(glm::vec3(modelMatrix[0])),
+		glm::max(glm::length(glm::vec3(modelMatrix[1])),glm::length(glm::vec3(modelMatrix[2]))));
+	addDynamicCaster(glm::vec3(modelMatrix[3]),cVarVirtualShadowSkinnedRadius.get() * scale);
+}
+
+void VirtualShadowMap::dropPages()
+{
+	m_residentPages.clear();
+	m_freePages.clear();
+	for(uint32 i = 0; i < POOL_PAGE_COUNT; i++)
+	{
+		m_pool[i] = {};
+
+		// pop_back hands out the first pages first.
+		m_freePages.push_back(POOL_PAGE_COUNT - 1 - i);
+	}
+}
+
+void VirtualShadowMap::markDirtyPages(const glm::vec4& sphere)
+{
+	const glm::vec2 center = glm::vec2(m_lightView * glm::vec4(glm::vec3(sphere),1.0f));
+	const float radius = sphere.w;
+
+	for(auto& page : m_pool)
+	{
+		if(!page.bResident || page.bDirty)
+		{
+			continue;
+		}
+
+		const float pageWorldSize = getPageWorldSize(page.level);
+		const glm::vec2 pageMin = glm::vec2(page.page) * pageWorldSize;
+		const glm::vec2 pageMax = pageMin + pageWorldSize;
+		if(center.x + radius >= pageMin.x && center.x - radius <= pageMax.x &&
+		   center.y + radius >= pageMin.y && center.y - radius <= pageMax.y)
+		{
+			page.bDirty = true;
+		}
+	}
+}
+
+void VirtualShadowMap::buildPageTable()
+{
+	m_pageTable.assign(PAGE_COUNT,INVALID_PAGE);
+	for(const auto& [key,physicalPage] : m_residentPages)
+	{
+		const auto& page = m_pool[physicalPage];
+		if(!inWindow(page.level,page.page))
+		{
+			continue;
+		}
+
+		const uint32 slot =
+			page.level * LEVEL_PAGE_COUNT +
+			(uint32(page.page.y) & (PAGE_TABLE_SIZE - 1)) * PAGE_TABLE_SIZE +
+			(uint32(page.page.x) & (PAGE_TABLE_SIZE - 1));
+		m_pageTable[slot] = physicalPage;
+	}
+}
+
+void VirtualShadowMap::update(
+	const glm::vec3& lightDir,
+	const glm::vec3& camPos,
+	float pixelAngle,
+	uint64 staticHash,
+	uint64 settingsHash,
+	const uint32* requests,
+	uint32 backBufferIndex)
+{
+	m_frame++;
+
+	m_plan = {};
+	m_plan.bEnable = cVarVirtualShadowEnable.get() != 0;
+
+	// NOTE: The lighting samples the pool every frame, its first pass clears it even when turned off.
+	m_plan.bClearPool = m_bPoolUndefined;
+	m_bPoolUndefined = false;
+
+	if(backBufferIndex >= m_requestWindows.size())
+	{
+		m_requestWindows.resize(backBufferIndex + 1);
+	}
+
+	if(!m_plan.bEnable)
+	{
+		// casters may move while we don't track them, the pages are rendered again once turned on.
+		m_info.bEnable = 0;
+		m_bInvalid = true;
+		m_requestWindows[backBufferIndex].bValid = false;
+		return;
+	}
+
+	const glm::vec3 dir = glm::normalize(lightDir);
+	const glm::vec3 up = glm::abs(dir.y) > 0.99f ? glm::vec3(0.0f,0.0f,1.0f) : glm::vec3(0.0f,1.0f,0.0f);
+
+	const float depthRange = glm::max(cVarVirtualShadowDepthRange.get(),1.0f);
+	const float depthStep = depthRange * 0.25f;
+	const float depthCenter = glm::floor(glm::dot(dir,camPos) / depthStep + 0.5f) * depthStep;
+	const float pageWorldSize = glm::max(cVarVirtualShadowExtent.get(),0.01f) / float(PAGE_TABLE_SIZE);
+
+	// NOTE: Pages hold depth of a fixed light space grid, anything changing the grid, the depth window
+	//       or the static casters drops them all.
+	const bool bDrop =
+		m_bInvalid ||
+		glm::dot(dir,m_lightDir) < LIGHT_DIR_VIRTUAL_THRESHOLD ||
+		staticHash != m_staticHash ||
+		settingsHash != m_settingsHash ||
+		depthCenter != m_depthCenter ||
+		depthRange != m_info.depthRange ||
+		pageWorldSize != m_info.pageWorldSize;
+
+	bool bTableDirty = m_pageTable.empty();
+	if(bDrop)
+	{
+		dropPages();
+		m_epoch++;
+		m_stats.invalidateCount++;
+		bTableDirty = true;
+
+		m_lightDir = dir;
+		m_lightView = glm::lookAt(glm::vec3(0.0f),dir,up);
+		m_staticHash = staticHash;
+		m_settingsHash = settingsHash;
+		m_depthCenter = depthCenter;
+		m_info.depthRange = depthRange;
+		m_info.pageWorldSize = pageWorldSize;
+		m_bInvalid = false;
+	}
+
+	const glm::vec2 camLight = glm::vec2(m_lightView * glm::vec4(camPos,1.0f));
+	for(uint32 level = 0; level < LEVEL_COUNT; level++)
+	{
+		const glm::ivec2 origin = glm::ivec2(glm::floor(camLight / getPageWorldSize(level))) - int32(PAGE_TABLE_SIZE / 2);
+		bTableDirty |= origin != m_origins[level];
+		m_origins[level] = origin;
+	}
+
+	// Moving casters and the place they left.
+	for(const auto& sphere : m_dynamicCasters)
+	{
+		markDirtyPages(sphere);
+	}
+	for(const auto& sphere : m_lastDynamicCasters)
+	{
+		markDirtyPages(sphere);
+	}
+
+	// NOTE: Decode the marks against the windows they were made with, windows move by whole pages
+	//       and the table wraps, so a slot maps back to one page of the window.
+	std::vector<uint32> dirtyRequests;
+	std::vector<std::pair<uint32,glm::ivec2>> missingRequests;
+	auto& window = m_requestWindows[backBufferIndex];
+	if(requests && window.bValid && window.epoch == m_epoch)
+	{
+		for(uint32 word = 0; word < REQUEST_WORD_COUNT; word++)
+		{
+			uint32 bits = requests[word];
+			while(bits != 0)
+			{
+				const uint32 bit = glm::findLSB(bits);
+				bits &= bits - 1;
+
+				const uint32 slot = word * 32 + bit;
+				const uint32 level = slot / LEVEL_PAGE_COUNT;
+				const glm::ivec2 wrapped = glm::ivec2(slot % PAGE_TABLE_SIZE,(slot / PAGE_TABLE_SIZE) % PAGE_TABLE_SIZE);
+				const glm::ivec2 origin = window.origins[level];
+				const glm::ivec2 page = origin + ((wrapped - origin) & int32(PAGE_TABLE_SIZE - 1));
+				if(!inWindow(level,page))
+				{
+					continue;
+				}
+				m_stats.requestCount++;
+
+				auto it = m_residentPages.find(getPageKey(level,page));
+				if(it != m_residentPages.end())
+				{
+					auto& physicalPage = m_pool[it->second];
+					physicalPage.lastRequestFrame = m_frame;
+					if(physicalPage.bDirty)
+					{
+						dirtyRequests.push_back(it->second);
+					}
+				}
+				else
+				{
+					missingRequests.push_back({ level, page });
+				}
+			}
+		}
+	}
+	window.bValid = true;
+	window.epoch = m_epoch;
+	window.origins = m_origins;
+
+	// NOTE: Fine levels first, they are the ones next to the camera.
+	std::stable_sort(missingRequests.begin(),missingRequests.end(),[](const auto& a,const auto& b)
+	{
+		return a.first < b.first;
+	});
+
+	const uint32 budget = (uint32)glm::clamp(cVarVirtualShadowMaxPageRenders.get(),1,int32(MAX_PAGE_RENDERS));
+	auto addRender = [&](uint32 physicalPage)
+	{
+		const auto& page = m_pool[physicalPage];
+		PageRender render {};
+		render.physicalPage = physicalPage;
+		render.viewProj = getPageViewProj(page.level,page.page);
+		m_plan.renders.push_back(render);
+	};
+
+	for(uint32 physicalPage : dirtyRequests)
+	{
+		if(m_plan.renders.size() >= budget)
+		{
+			m_stats.deferredCount++;
+			continue;
+		}
+		m_pool[physicalPage].bDirty = false;
+		addRender(physicalPage);
+		m_stats.dirtyCount++;
+	}
+
+	// Pages not requested this frame, least recently requested first.
+	std::vector<uint32> evictable;
+	bool bEvictableSorted = false;
+	size_t evictCursor = 0;
+
+	for(const auto& [level,page] : missingRequests)
+	{
+		if(m_plan.renders.size() >= budget)
+		{
+			m_stats.deferredCount++;
+			continue;
+		}
+
+		uint32 physicalPage = INVALID_PAGE;
+		if(!m_freePages.empty())
+		{
+			physicalPage = m_freePages.back();
+			m_freePages.pop_back();
+		}
+		else
+		{
+			if(!bEvictableSorted)
+			{
+				for(uint32 i = 0; i < POOL_PAGE_COUNT; i++)
+				{
+					if(m_pool[i].bResident && m_pool[i].lastRequestFrame != m_frame)
+					{
+						evictable.push_back(i);
+					}
+				}
+				std::sort(evictable.begin(),evictable.end(),[&](uint32 a,uint32 b)
+				{
+					return m_pool[a].lastRequestFrame < m_pool[b].lastRequestFrame;
+				});
+				bEvictableSorted = true;
+			}
+
+			if(evictCursor >= evictable.size())
+			{
+				m_stats.deferredCount++;
+				continue;
+			}
+
+			physicalPage = evictable[evictCursor++];
+			m_residentPages.erase(getPageKey(m_pool[physicalPage].level,m_pool[physicalPage].page));
+			m_stats.evictCount++;
+		}
+
+		auto& newPage = m_pool[physicalPage];
+		newPage.bResident = true;
+		newPage.bDirty = false;
+		newPage.level = level;
+		newPage.page = page;
+		newPage.lastRequestFrame = m_frame;
+		m_residentPages[getPageKey(level,page)] = physicalPage;
+		bTableDirty = true;
+
+		addRender(physicalPage);
+	}
+
+	m_plan.bPageTableDirty = bTableDirty;
+	if(bTableDirty)
+	{
+		buildPageTable();
+	}
+
+	const bool bReverseZ = reverseZOpen();
+	const float halfRange = m_info.depthRange * 0.5f;
+	m_info.lightMatrix = glm::ortho(
+		-1.0f,1.0f,-1.0f,1.0f,
+		bReverseZ ? m_depthCenter + halfRange : m_depthCenter - halfRange,
+		bReverseZ ? m_depthCenter - halfRange : m_depthCenter + halfRange) * m_lightView;
+	for(uint32 level = 0; level < LEVEL_COUNT; level++)
+	{
+		m_info.levelOrigins[level] = glm::ivec4(m_origins[level],0,0);
+	}
+	m_info.pixelAngle = pixelAngle;
+	m_info.lodBias = cVarVirtualShadowLodBias.get();
+	m_info.filterTexels = glm::max(cVarVirtualShadowFilterTexels.get(),0.0f);
+	m_info.bEnable = 1;
+
+	m_stats.frameCount++;
+	m_stats.renderCount += (uint32)m_plan.renders.size();
+	if(cVarVirtualShadowStats.get() != 0)
+	{
+		LOG_INFO("Virtual shadow: {0} page requests, {1} renders ({2} dirty), {3} deferred and {4} evictions over {5} frames, {6} invalidations, {7} resident pages.",
+			m_stats.requestCount,
+			m_stats.renderCount,
+			m_stats.dirtyCount,
+			m_stats.deferredCount,
+			m_stats.evictCount,
+			m_stats.frameCount,
+			m_stats.invalidateCount,
+			m_residentPages.size());
+		m_stats = {};
+		cVarVirtualShadowStats.set(0);
+	}
+}
+
+}
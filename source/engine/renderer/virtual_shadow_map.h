@@ -0,0 +1,158 @@
+#pragma once
+#include "../core/core.h"
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+namespace engine{
+
+// NOTE: Same layout as VirtualShadowInfo in common_vsm.glsl.
+struct GPUVirtualShadowInfo
+{
+	glm::mat4 lightMatrix;          // .xy light space position in world units, .z page depth.
+	glm::ivec4 levelOrigins[8];     // .xy first page of the level window, see VirtualShadowMap::LEVEL_COUNT.
+
+	float pageWorldSize;            // world size of a level #0 page.
+	float pixelAngle;               // world size of a screen pixel at distance one.
+	float lodBias;                  // levels added to the selected one.
+	float depthRange;               // world size of the page depth range.
+
+	float filterTexels;             // pcf radius in texels of the sampled level.
+	uint32 bEnable;
+	uint32 pad0;
+	uint32 pad1;
+};
+
+// NOTE: Virtual shadow map of the directional light. LEVEL_COUNT clipmap levels of PAGE_TABLE_SIZE
+//       pages per side follow the camera in light space, each level covers twice the extent of the one
+//       below at the same virtual resolution. Pages sit on a fixed light space grid, so a page keeps its
+//       content while the level windows move with the camera.
+//       The lighting picks a level by the pixel footprint. A compute pass marks the pages it will read
+//       from the depth buffer, the marks come back some frames late and the marked pages get a physical
+//       page of the pool atlas. Only new pages and resident pages under moving casters are rendered, at
+//       most r.Shadow.Virtual.MaxPageRenders per frame. Pixels without a resident page use the cascades.
+//       The light turning, static casters or shadow settings changing drop every page.
+class VirtualShadowMap
+{
+public:
+	static constexpr uint32 PAGE_SIZE = 128;       // texels per page side.
+	static constexpr uint32 PAGE_TABLE_SIZE = 128; // pages per level side, 16k virtual texels.
+	static constexpr uint32 LEVEL_COUNT = 8;
+	static constexpr uint32 POOL_SIZE = 32;        // physical pages per atlas side.
+	static constexpr uint32 MAX_PAGE_RENDERS = 256;
+
+	static constexpr uint32 LEVEL_PAGE_COUNT = PAGE_TABLE_SIZE * PAGE_TABLE_SIZE;
+	static constexpr uint32 PAGE_COUNT = LEVEL_PAGE_COUNT * LEVEL_COUNT;
+	static constexpr uint32 REQUEST_WORD_COUNT = PAGE_COUNT / 32; // one request bit per page.
+	static constexpr uint32 POOL_PAGE_COUNT = POOL_SIZE * POOL_SIZE;
+	static constexpr uint32 INVALID_PAGE = ~0u;
+
+	static uint32 getPoolTextureSize() { return POOL_SIZE * PAGE_SIZE; }
+
+	struct PageRender
+	{
+		uint32 physicalPage; // x + y * POOL_SIZE in the atlas.
+		glm::mat4 viewProj;
+	};
+
+	// What the shadow passes do this frame.
+	struct Plan
+	{
+		bool bEnable = false;
+		bool bClearPool = false; // atlas content is undefined, cleared as a whole before the renders.
+		bool bPageTableDirty = false;
+		std::vector<PageRender> renders = {};
+	};
+
+	struct Stats
+	{
+		uint32 requestCount = 0;  // requested pages since the last log.
+		uint32 renderCount = 0;
+		uint32 dirtyCount = 0;    // renders of resident pages under moving casters.
+		uint32 deferredCount = 0; // requests over the render budget or without a free page.
+		uint32 evictCount = 0;
+		uint32 invalidateCount = 0;
+		uint32 frameCount = 0;
+	};
+
+	// Moving casters, their pages are rendered again. Called by RenderScene::meshCollect.
+	void beginCasters();
+	void addDynamicCaster(const glm::vec3& center,float radius);
+
+	// Skinned meshes without bounds, r.Shadow.Virtual.SkinnedRadius around the model origin.
+	void addSkinnedCaster(const glm::mat4& modelMatrix);
+
+	// Once per frame after the casters. requests holds the marks of the last frame which used this back
+	// buffer, pixelAngle is the world size of a pixel at distance one.
+	void update(
+		const glm::vec3& lightDir,
+		const glm::vec3& camPos,
+		float pixelAngle,
+		uint64 staticHash,
+		uint64 settingsHash,
+		const uint32* requests,
+		uint32 backBufferIndex);
+
+	// Atlas content is undefined, e.g. the pool texture was recreated.
+	void invalidatePool() { m_bPoolUndefined = true; m_bInvalid = true; }
+
+	const Plan& getPlan() const { return m_plan; }
+	const GPUVirtualShadowInfo& getInfo() const { return m_info; }
+
+	// Physical page of every virtual page of the level windows, INVALID_PAGE without one.
+	const std::vector<uint32>& getPageTable() const { return m_pageTable; }
+
+private:
+	struct PhysicalPage
+	{
+		bool bResident = false;
+		bool bDirty = false;         // a moving caster touched it since its last render.
+		uint32 level = 0;
+		glm::ivec2 page = glm::ivec2(0); // on the light space grid of the level.
+		uint64 lastRequestFrame = 0;
+	};
+
+	// Level windows the marks of a back buffer were made against.
+	struct RequestWindow
+	{
+		bool bValid = false;
+		uint64 epoch = 0;
+		std::array<glm::ivec2,LEVEL_COUNT> origins = {};
+	};
+
+	static uint64 getPageKey(uint32 level,const glm::ivec2& page);
+	float getPageWorldSize(uint32 level) const { return m_info.pageWorldSize * float(1u << level); }
+	bool inWindow(uint32 level,const glm::ivec2& page) const;
+	glm::mat4 getPageViewProj(uint32 level,const glm::ivec2& page) const;
+
+	void dropPages();
+	void markDirtyPages(const glm::vec4& sphere);
+	void buildPageTable();
+
+	std::array<PhysicalPage,POOL_PAGE_COUNT> m_pool = {};
+	std::unordered_map<uint64,uint32> m_residentPages = {}; // page key to physical page.
+	std::vector<uint32> m_freePages = {};
+
+	std::vector<glm::vec4> m_dynamicCasters = {};     // world space spheres.
+	std::vector<glm::vec4> m_lastDynamicCasters = {}; // their shadows of the last frame are cleared as well.
+
+	std::vector<RequestWindow> m_requestWindows = {};
+	std::array<glm::ivec2,LEVEL_COUNT> m_origins = {};
+
+	glm::mat4 m_lightView = glm::mat4(1.0f);
+	glm::vec3 m_lightDir = glm::vec3(0.0f);
+	float m_depthCenter = 0.0f;
+	uint64 m_staticHash = 0;
+	uint64 m_settingsHash = 0;
+	uint64 m_epoch = 0;
+	uint64 m_frame = 0;
+	bool m_bInvalid = true;
+	bool m_bPoolUndefined = true;
+
+	GPUVirtualShadowInfo m_info = {};
+	std::vector<uint32> m_pageTable = {};
+	Plan m_plan = {};
+	Stats m_stats = {};
+};
+
+}
@@ -15,6 +15,7 @@ public:
 
 private:
 	friend class cereal::access;
+	friend class SceneBinaryArchive;
 
 	template <class Archive>
 	void serialize(Archive& ar)
@@ -2,6 +2,7 @@
 #include "../../renderer/pmx_mesh.h"
 #include "../../renderer/render_passes/pmx_pass.h"
 #include "../../renderer/render_passes/cascade_shadowdepth_pass.h"
+#include "../../renderer/compute_passes/pmx_skinning.h"
 
 void engine::PMXMeshComponent::preparePMX()
 {
@@ -12,15 +13,8 @@ void engine::PMXMeshComponent::preparePMX()
 		if(m_vertexBuffer != nullptr)
 		{
 			VulkanRHI::get()->waitIdle();
-			delete m_vertexBuffer;
-			m_vertexBuffer = nullptr;
-		}
-		if(m_stageBuffer != nullptr)
-		{
-			VulkanRHI::get()->waitIdle();
-			delete m_stageBuffer;
-			m_stageBuffer = nullptr;
 		}
+		releaseBuffers();
 
 		auto* pmxMesh = PMXManager::get()->getPMX(m_pmxPath);
 		if(pmxMesh)
@@ -34,15 +28,30 @@ void engine::PMXMeshComponent::preparePMX()
 				true 
 			);
 
-			m_stageBuffer = VulkanBuffer::create(
-				VulkanRHI::get()->getVulkanDevice(),
-				VulkanRHI::get()->getGraphicsCommandPool(),
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-				VMA_MEMORY_USAGE_CPU_TO_GPU,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				pmxMesh->getTotalVertexSize(),
-				nullptr
-			);
+			// prepare skinning input, zero sized storage buffers are invalid.
+			auto createHostBuffer = [](VkDeviceSize size)
+			{
+				return VulkanBuffer::create(
+					VulkanRHI::get()->getVulkanDevice(),
+					VulkanRHI::get()->getGraphicsCommandPool(),
+					VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+					VMA_MEMORY_USAGE_CPU_TO_GPU,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					size,
+					nullptr
+				);
+			};
+			const size_t backBufferCount = VulkanRHI::get()->getSwapchainImageViews().size();
+			m_boneBuffers.resize(backBufferCount);
+			m_morphWeightBuffers.resize(backBufferCount);
+			for(size_t i = 0; i < backBufferCount; i++)
+			{
+				m_boneBuffers[i] = createHostBuffer(sizeof(GPUPMXBone) * glm::max(pmxMesh->getBoneCount(),1u));
+				m_morphWeightBuffers[i] = createHostBuffer(sizeof(float) * glm::max(pmxMesh->getMorphCount(),1u));
+			}
+
+			// bind pose.
+			pmxMesh->getAnimation().initPose(m_pose);
 
 			// prepare reference.
 			m_pmxRef = pmxMesh;
@@ -62,7 +71,6 @@ void engine::PMXMeshComponent::OnRenderCollect(VkCommandBuffer cmd,VkPipelineLay
 		}
 
 		CHECK(m_vertexBuffer);
-		CHECK(m_stageBuffer);
 
 		auto modelMatrix = node->getTransform()->getWorldMatrix();
 
@@ -109,7 +117,6 @@ void engine::PMXMeshComponent::OnShadowRenderCollect(VkCommandBuffer cmd,VkPipel
 		}
 
 		CHECK(m_vertexBuffer);
-		CHECK(m_stageBuffer);
 		auto modelMatrix = node->getTransform()->getWorldMatrix();
 
 		// bind index buffer
@@ -142,7 +149,53 @@ void engine::PMXMeshComponent::OnShadowRenderCollect(VkCommandBuffer cmd,VkPipel
 	}
 }
 
-void engine::PMXMeshComponent::OnRenderTick(VkCommandBuffer cmd)
+void engine::PMXMeshComponent::OnSkinningCollect(VkCommandBuffer cmd,VkPipelineLayout pipelinelayout,uint32_t backBufferIndex)
+{
+	if(m_pmxRef == nullptr)
+	{
+		// do nothing if no pmx init.
+		return;
+	}
+	CHECK(m_vertexBuffer);
+	CHECK(backBufferIndex < m_boneBuffers.size());
+
+	auto bufferInfo = [](VulkanBuffer* buffer)
+	{
+		VkDescriptorBufferInfo info = {};
+		info.buffer = buffer->GetVkBuffer();
+		info.offset = 0;
+		info.range = buffer->getSize();
+		return info;
+	};
+	VkDescriptorBufferInfo bindVertexInfo = bufferInfo(m_pmxRef->m_bindVertexBuffer);
+	VkDescriptorBufferInfo skinVertexInfo = bufferInfo(m_pmxRef->m_skinVertexBuffer);
+	VkDescriptorBufferInfo morphVertexInfo = bufferInfo(m_pmxRef->m_morphVertexBuffer);
+	VkDescriptorBufferInfo boneInfo = bufferInfo(m_boneBuffers[backBufferIndex]);
+	VkDescriptorBufferInfo morphWeightInfo = bufferInfo(m_morphWeightBuffers[backBufferIndex]);
+	VkDescriptorBufferInfo outVertexInfo = bufferInfo(m_vertexBuffer->getVulkanBuffer());
+
+	VkDescriptorSet skinningSet = VK_NULL_HANDLE;
+	const bool bBuilt = VulkanRHI::get()->vkFrameDescriptorFactoryBegin()
+		.bindBuffer(0,&bindVertexInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.bindBuffer(1,&skinVertexInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.bindBuffer(2,&morphVertexInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.bindBuffer(3,&boneInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.bindBuffer(4,&morphWeightInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.bindBuffer(5,&outVertexInfo,VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,VK_SHADER_STAGE_COMPUTE_BIT)
+		.build(&skinningSet);
+	CHECK(bBuilt);
+
+	GPUPMXSkinningPushConstants pushConstants {};
+	pushConstants.vertexCount = m_pmxRef->getVertexCount();
+	pushConstants.boneCount = m_pmxRef->getBoneCount();
+	pushConstants.morphCount = m_pmxRef->getMorphCount();
+
+	vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_COMPUTE,pipelinelayout,0,1,&skinningSet,0,nullptr);
+	vkCmdPushConstants(cmd,pipelinelayout,VK_SHADER_STAGE_COMPUTE_BIT,0,sizeof(GPUPMXSkinningPushConstants),&pushConstants);
+	vkCmdDispatch(cmd,getGroupCount(pushConstants.vertexCount,64),1,1);
+}
+
+void engine::PMXMeshComponent::OnRenderTick(uint32_t backBufferIndex)
 {
 	if(auto node = m_node.lock())
 	{
@@ -151,23 +204,21 @@ void engine::PMXMeshComponent::OnRenderTick(VkCommandBuffer cmd)
 			// do nothing if no pmx init.
 			return;
 		}
-		CHECK(m_vertexBuffer);
-		CHECK(m_stageBuffer);
-
-		// copy vertex buffer gpu. 
-		VkDeviceSize bufferSize = m_pmxRef->getTotalVertexSize();
-		auto readySize = getComponentVertexSize();
-		CHECK(bufferSize == readySize);
-		m_stageBuffer->map();
-		m_stageBuffer->copyTo(m_readyVertexData.data(),readySize);
-		m_stageBuffer->unmap();
-
-		// copy to gpu
-		VkBufferCopy copyRegion{};
-		copyRegion.srcOffset = 0; 
-		copyRegion.dstOffset = 0; 
-		copyRegion.size = bufferSize;
-		vkCmdCopyBuffer(cmd, m_stageBuffer->GetVkBuffer(), m_vertexBuffer->getBuffer(), 1, &copyRegion);
+		CHECK(backBufferIndex < m_boneBuffers.size());
+		VulkanBuffer* boneBuffer = m_boneBuffers[backBufferIndex];
+		VulkanBuffer* morphWeightBuffer = m_morphWeightBuffers[backBufferIndex];
+
+		// NOTE: Evaluated straight into the host visible buffers, a few kb instead of the full vertex data.
+		//       Acquire waited for the last frame of this back buffer, no skinning dispatch reads them.
+		boneBuffer->map();
+		morphWeightBuffer->map();
+		m_pmxRef->evaluatePose(
+			m_pose,
+			static_cast<GPUPMXBone*>(boneBuffer->mapped),
+			static_cast<float*>(morphWeightBuffer->mapped)
+		);
+		morphWeightBuffer->unmap();
+		boneBuffer->unmap();
 	}
 }
 
@@ -176,59 +227,65 @@ void engine::PMXMeshComponent::OnSceneTick()
 	if(auto node = m_node.lock())
 	{
 		preparePMX();
-		if(m_pmxRef == nullptr)
-		{
-			// do nothing if no pmx init.
-			return;
-		}
-		CHECK(m_vertexBuffer);
-		CHECK(m_stageBuffer);
-
-		prepareCurrentFrameVertexData();
 	}
 }
 
-VkDeviceSize engine::PMXMeshComponent::getComponentVertexSize() const
+int32_t engine::PMXMeshComponent::findBone(const std::string& name) const
 {
-	VkDeviceSize perDataDeviceSize = VkDeviceSize(sizeof(float));
-	return perDataDeviceSize * m_readyVertexData.size();
+	return m_pmxRef ? m_pmxRef->findBone(name) : -1;
 }
 
-void engine::PMXMeshComponent::prepareCurrentFrameVertexData()
+int32_t engine::PMXMeshComponent::findMorph(const std::string& name) const
 {
-	CHECK(m_pmxRef);
-
-	size_t vertexCount = m_pmxRef->m_positions.size() / 3;
+	return m_pmxRef ? m_pmxRef->findMorph(name) : -1;
+}
 
-	size_t perVertexFloatCount = 0;
-	auto attris = getPMXMeshAttributes();
-	for(const auto& attri : attris)
+void engine::PMXMeshComponent::setBoneLocalTransform(uint32_t boneIndex,const glm::vec3& translation,const glm::quat& rotation)
+{
+	if(boneIndex < m_pose.rotations.size())
 	{
-		perVertexFloatCount += getVertexAttributeElementCount(attri);
+		m_pose.translations[boneIndex] = translation;
+		m_pose.rotations[boneIndex] = rotation;
 	}
+}
 
-	m_readyVertexData.resize(vertexCount * perVertexFloatCount);
-	for(auto index = 0; index < vertexCount; index++)
+void engine::PMXMeshComponent::setMorphWeight(uint32_t morphIndex,float weight)
+{
+	if(morphIndex < m_pose.morphWeights.size())
 	{
-		size_t readyDataIndexBase = index * perVertexFloatCount;
-
-		size_t normalIndexBase = index * 3;
-		size_t posIndexBase = index * 3;
-		size_t uvIndexBase = index * 2;
-		
+		m_pose.morphWeights[morphIndex] = weight;
+	}
+}
 
-		m_readyVertexData[readyDataIndexBase + 0] = m_pmxRef->m_positions[posIndexBase + 0];
-		m_readyVertexData[readyDataIndexBase + 1] = m_pmxRef->m_positions[posIndexBase + 1];
-		m_readyVertexData[readyDataIndexBase + 2] = m_pmxRef->m_positions[posIndexBase + 2];
+uint32_t engine::PMXMeshComponent::getSkinVertexCount() const
+{
+	return m_pmxRef ? m_pmxRef->getVertexCount() : 0;
+}
 
-		m_readyVertexData[readyDataIndexBase + 3] = m_pmxRef->m_normals[normalIndexBase + 0];
-		m_readyVertexData[readyDataIndexBase + 4] = m_pmxRef->m_normals[normalIndexBase + 1];
-		m_readyVertexData[readyDataIndexBase + 5] = m_pmxRef->m_normals[normalIndexBase + 2];
+VkDeviceSize engine::PMXMeshComponent::getFrameUploadSize() const
+{
+	if(m_pmxRef == nullptr)
+	{
+		return 0;
+	}
+	return m_boneBuffers[0]->getSize() + m_morphWeightBuffers[0]->getSize();
+}
 
-		m_readyVertexData[readyDataIndexBase + 6] = m_pmxRef->m_uvs[uvIndexBase + 0];
-		m_readyVertexData[readyDataIndexBase + 7] = m_pmxRef->m_uvs[uvIndexBase + 1];
+void engine::PMXMeshComponent::releaseBuffers()
+{
+	for(auto* buffers : { &m_boneBuffers, &m_morphWeightBuffers })
+	{
+		for(VulkanBuffer* buffer : *buffers)
+		{
+			delete buffer;
+		}
+		buffers->clear();
+	}
 
-		CHECK(perVertexFloatCount == 8);
+	if(m_vertexBuffer != nullptr)
+	{
+		delete m_vertexBuffer;
+		m_vertexBuffer = nullptr;
 	}
 }
 
@@ -241,18 +298,7 @@ engine::PMXMeshComponent::PMXMeshComponent()
 engine::PMXMeshComponent::~PMXMeshComponent()
 {
 	m_pmxRef = nullptr;
-
-	if(m_vertexBuffer != nullptr)
-	{
-		delete m_vertexBuffer;
-		m_vertexBuffer = nullptr;
-	}
-
-	if(m_stageBuffer!=nullptr)
-	{
-		delete m_stageBuffer;
-		m_stageBuffer = nullptr;
-	}
+	releaseBuffers();
 }
 
 void engine::PMXMeshComponent::setNode(std::shared_ptr<SceneNode> node)
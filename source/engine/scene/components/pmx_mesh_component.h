@@ -2,6 +2,7 @@
 #include "../component.h"
 #include "../scene.h"
 #include "../../vk/vk_rhi.h"
+#include "../../renderer/pmx_animation.h"
 
 namespace engine{
 
@@ -15,17 +16,22 @@ private:
 
 private:
 	bool bPMXMeshChange = false;
-	VulkanVertexBuffer* m_vertexBuffer = nullptr;
-	VulkanBuffer* m_stageBuffer = nullptr;
+	VulkanVertexBuffer* m_vertexBuffer = nullptr; // skinned by pmx_skinning.comp every frame.
 	Ref<PMXMesh> m_pmxRef = nullptr;
 
-	std::vector<float> m_readyVertexData {};
-	VkDeviceSize getComponentVertexSize() const;
+	// per back buffer skinning input, written in OnRenderTick. Frames in flight still skin from
+	// the buffers of their own back buffer.
+	std::vector<VulkanBuffer*> m_boneBuffers {};        // GPUPMXBone per bone.
+	std::vector<VulkanBuffer*> m_morphWeightBuffers {}; // float per morph.
 
-	void prepareCurrentFrameVertexData();
+	// local pose relative to the bind pose, ik and append are solved in OnRenderTick.
+	PMXPose m_pose {};
+
+	void releaseBuffers();
 
 private:
 	friend class cereal::access;
+	friend class SceneBinaryArchive;
 
 	template <class Archive>
 	void serialize(Archive& ar)
@@ -44,13 +50,26 @@ public:
 
 	virtual size_t getType() override { return EComponentType::PMXMeshComponent; }
 	void setNode(std::shared_ptr<SceneNode> node);
+	std::shared_ptr<SceneNode> getNode() const { return m_node.lock(); }
 	std::string getPath() const;
 
 	void setPath(std::string path);
 
+	// -1 if not found or no pmx loaded.
+	int32_t findBone(const std::string& name) const;
+	int32_t findMorph(const std::string& name) const;
+
+	// Pose of the next frames, bones keep their bind pose and morphs zero weight until set.
+	void setBoneLocalTransform(uint32_t boneIndex,const glm::vec3& translation,const glm::quat& rotation);
+	void setMorphWeight(uint32_t morphIndex,float weight);
+
 	void OnRenderCollect(VkCommandBuffer cmd,VkPipelineLayout pipelinelayout);
 	void OnShadowRenderCollect(VkCommandBuffer cmd,VkPipelineLayout pipelinelayout, uint32_t cascadeIndex);
-	void OnRenderTick(VkCommandBuffer cmd);
+	void OnSkinningCollect(VkCommandBuffer cmd,VkPipelineLayout pipelinelayout,uint32_t backBufferIndex);
+	void OnRenderTick(uint32_t backBufferIndex);
+
+	uint32_t getSkinVertexCount() const;
+	VkDeviceSize getFrameUploadSize() const; // bone and morph weight bytes written every frame.
 
 	void OnSceneTick();
 };
@@ -25,6 +25,7 @@ private:
 
 private:
 	friend class cereal::access;
+	friend class SceneBinaryArchive;
 
 	template <class Archive>
 	void serialize(Archive& ar)
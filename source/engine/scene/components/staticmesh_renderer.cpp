@@ -38,8 +38,8 @@ std::vector<RenderSubMesh> engine::StaticMeshComponent::getRenderMesh(Ref<Render
 
 		auto transform = node->getComponent<Transform>();
 
-		CHECK(mesh.indexCount > 0 && mesh.indexStartPosition >= 0);
-		CHECK(mesh.vertexCount > 0 && mesh.vertexStartPosition >= 0);
+		CHECK(mesh.indexCount + mesh.index16Count > 0);
+		CHECK(mesh.vertexCount > 0);
 
 		glm::mat4 modelMatrix = transform->getWorldMatrix();
 
@@ -59,7 +59,13 @@ std::vector<RenderSubMesh> engine::StaticMeshComponent::getRenderMesh(Ref<Render
 
 				renderSubMesh.bCullingResult = true;
 				renderSubMesh.indexCount = subMesh.indexCount;
-				renderSubMesh.indexStartPosition = subMesh.indexStartPosition;
+				renderSubMesh.indexStartPosition = (subMesh.bIndex16 ? mesh.index16StartPosition : mesh.indexStartPosition) + subMesh.indexStartPosition;
+				renderSubMesh.vertexOffset = mesh.vertexStartPosition + subMesh.baseVertex;
+				renderSubMesh.bIndex16 = subMesh.bIndex16;
+				renderSubMesh.meshletStart = mesh.meshletStartPosition + subMesh.meshletStart;
+				renderSubMesh.meshletCount = subMesh.meshletCount;
+				renderSubMesh.lodCount = subMesh.lodCount;
+				renderSubMesh.lods = subMesh.lods;
 				renderSubMesh.renderBounds = subMesh.renderBounds;
 				renderSubMesh.preModelMatrix = transform->getPreWorldMatrix();
 				renderSubMesh.modelMatrix = modelMatrix;
@@ -9,9 +9,73 @@
 #include "../core/file_system.h"
 #include "components/sceneview_camera.h"
 #include "components/pmx_mesh_component.h"
+#include "components/staticmesh_renderer.h"
+#include "scene_binary.h"
+#include "../core/job_system.h"
+#include "../renderer/mesh.h"
+#include "../renderer/material.h"
+#include <chrono>
+#include <filesystem>
+#include <thread>
 
 namespace engine{
 
+static AutoCVarInt32 cVarSceneLoadBenchmark(
+	"r.Scene.LoadBenchmark",
+	"Run binary vs json scene save/load benchmark once. 0 is off, other is the node count, e.g. 100000.",
+	"Scene",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarSceneInstanceStress(
+	"r.Scene.InstanceStress",
+	"Add a grid of static meshes to the active scene once, used to stress instance batching. 0 is off, other is the mesh count(renderer keeps 50000 objects at most).",
+	"Scene",
+	0,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarSceneStreaming(
+	"r.Scene.Streaming",
+	"Stream sub scenes in and out around the camera. 0 is off, 1 is on.",
+	"Scene",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarSceneUnloadUnusedMeshes(
+	"r.Scene.UnloadUnusedMeshes",
+	"Unload meshes no static mesh of the active scene references after a scene or sub scene went away. 0 keeps them.",
+	"Scene",
+	1,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarFloat cVarSceneStreamingDistance(
+	"r.Scene.Streaming.Distance",
+	"Sub scenes closer than this distance to the camera are streamed in, unloaded beyond 1.25 times of it.",
+	"Scene",
+	200.0f,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarSceneStreamingBudget(
+	"r.Scene.Streaming.Budget",
+	"Memory budget(mb) for resident sub scenes, the farthest streamed sub scenes are unloaded first.",
+	"Scene",
+	512,
+	CVarFlags::ReadAndWrite
+);
+
+static AutoCVarInt32 cVarSceneStreamingMaxLoading(
+	"r.Scene.Streaming.MaxLoading",
+	"Max sub scenes loading at the same time.",
+	"Scene",
+	2,
+	CVarFlags::ReadAndWrite
+);
+
 Scene::Scene()
 {
 	m_root = SceneNode::create(usageNodeIndex::root,"Root");
@@ -119,6 +183,70 @@ bool Scene::setParent(std::shared_ptr<SceneNode> parent,std::shared_ptr<SceneNod
 	return false;
 }
 
+std::shared_ptr<SceneNode> Scene::mergeSubScene(Scene& subScene,const std::string& name)
+{
+	auto subSceneRoot = createNode(name);
+	subSceneRoot->setParent(m_root);
+	m_root->addChild(subSceneRoot);
+
+	auto children = subScene.m_root->getChildren();
+	subScene.m_root->m_children.clear();
+	for(auto& child : children)
+	{
+		child->setParent(subSceneRoot);
+		subSceneRoot->addChild(child);
+
+		// ids of the sub scene collide with this scene.
+		loopNodeTopToDown([this](std::shared_ptr<SceneNode> node)
+		{
+			node->m_id = requireId();
+		},child);
+	}
+
+	for(auto& [type,components] : subScene.m_components)
+	{
+		if(type == getTypeId<SceneViewCamera>())
+		{
+			continue;
+		}
+
+		auto& dest = m_components[type];
+		for(auto& component : components)
+		{
+			if(!component.expired()) dest.push_back(component);
+		}
+	}
+	subScene.m_components.clear();
+
+	return subSceneRoot;
+}
+
+void Scene::detachSubScene(std::shared_ptr<SceneNode> subSceneRoot)
+{
+	if(auto parent = subSceneRoot->getParent())
+	{
+		parent->removeChild(subSceneRoot);
+	}
+	subSceneRoot->m_parent.reset();
+}
+
+void Scene::attachSubScene(std::shared_ptr<SceneNode> subSceneRoot)
+{
+	subSceneRoot->setParent(m_root);
+	m_root->addChild(subSceneRoot);
+}
+
+void Scene::removeExpiredComponents()
+{
+	for(auto& [type,components] : m_components)
+	{
+		components.erase(std::remove_if(components.begin(),components.end(),[](const std::weak_ptr<Component>& component)
+		{
+			return component.expired();
+		}),components.end());
+	}
+}
+
 std::shared_ptr<SceneNode> Scene::findNode(const std::string &node_name)
 {
 	for (auto& root_node : m_root->getChildren())
@@ -146,6 +274,187 @@ std::shared_ptr<SceneNode> Scene::findNode(const std::string &node_name)
 }
 
 
+// NOTE: Build a synthetic scene, round trip it through both formats and log the timings.
+static void sceneLoadBenchmark(uint32 nodeCount)
+{
+	using Clock = std::chrono::steady_clock;
+	auto elapsedMs = [](Clock::time_point begin)
+	{
+		return std::chrono::duration<double,std::milli>(Clock::now() - begin).count();
+	};
+
+	Scene scene("LoadBenchmark");
+	{
+		// 64 nodes under root, then an 8-ary tree below them. half of the nodes carry a static mesh.
+		std::vector<std::shared_ptr<SceneNode>> nodes;
+		nodes.reserve(nodeCount);
+		for(uint32 i = 0; i < nodeCount; i++)
+		{
+			auto node = scene.createNode("Node_" + std::to_string(i));
+			auto parent = i < 64 ? scene.getRootNode() : nodes[(i - 64) / 8];
+			scene.setParent(parent,node);
+			node->getTransform()->setTranslation(glm::vec3(float(i % 97),float(i % 13),float(i % 31)));
+
+			if(i % 2 == 0)
+			{
+				auto mesh = std::make_shared<StaticMeshComponent>();
+				mesh->m_meshName = "Box";
+				scene.addComponent<StaticMeshComponent>(mesh,node);
+			}
+			nodes.push_back(node);
+		}
+	}
+
+	const auto tempDir = std::filesystem::temp_directory_path();
+	const std::string binaryPath = (tempDir / "flower_scene_benchmark.flower").string();
+	const std::string jsonPath = (tempDir / "flower_scene_benchmark.json").string();
+
+	auto timePoint = Clock::now();
+	SceneBinaryArchive::save(scene,binaryPath);
+	const double binarySaveMs = elapsedMs(timePoint);
+
+	timePoint = Clock::now();
+	auto binaryScene = SceneBinaryArchive::load(binaryPath);
+	const double binaryLoadMs = elapsedMs(timePoint);
+
+	timePoint = Clock::now();
+	{
+		std::ofstream os(jsonPath);
+		cereal::JSONOutputArchive archive(os);
+		archive(scene);
+	}
+	const double jsonSaveMs = elapsedMs(timePoint);
+
+	timePoint = Clock::now();
+	{
+		std::ifstream is(jsonPath);
+		cereal::JSONInputArchive archive(is);
+		auto jsonScene = std::make_unique<Scene>();
+		archive(*jsonScene);
+	}
+	const double jsonLoadMs = elapsedMs(timePoint);
+
+	const auto binarySize = std::filesystem::file_size(binaryPath);
+	const auto jsonSize = std::filesystem::file_size(jsonPath);
+	std::filesystem::remove(binaryPath);
+	std::filesystem::remove(jsonPath);
+
+	LOG_INFO("Scene benchmark {0} nodes: binary save {1:.2f}ms, load {2:.2f}ms, {3} bytes, {4}.",
+		nodeCount,binarySaveMs,binaryLoadMs,binarySize,binaryScene ? "ok" : "failed");
+	LOG_INFO("Scene benchmark {0} nodes: json save {1:.2f}ms, load {2:.2f}ms, {3} bytes.",
+		nodeCount,jsonSaveMs,jsonLoadMs,jsonSize);
+}
+
+// NOTE: Many copies of a handful of meshes, so nearly every draw can merge into a few instanced draws.
+static void buildInstanceStressScene(Scene& scene,uint32 count)
+{
+	std::vector<std::string> meshNames = { toString(EPrimitiveMesh::Box) };
+	{
+		const auto& staticMeshList = MeshLibrary::get()->getStaticMeshList();
+		std::vector<std::string> projectMeshes(staticMeshList.begin(),staticMeshList.end());
+		std::sort(projectMeshes.begin(),projectMeshes.end());
+		for(size_t i = 0; i < projectMeshes.size() && meshNames.size() < 4; i++)
+		{
+			meshNames.push_back(projectMeshes[i]);
+		}
+	}
+
+	auto stressRoot = scene.createNode("InstanceStress");
+	scene.setParent(scene.getRootNode(),stressRoot);
+
+	const uint32 gridSize = (uint32)glm::ceil(glm::sqrt(float(count)));
+	constexpr float spacing = 3.0f;
+	for(uint32 i = 0; i < count; i++)
+	{
+		auto node = scene.createNode("Instance_" + std::to_string(i));
+		scene.setParent(stressRoot,node);
+
+		const float x = float(i % gridSize) - gridSize * 0.5f;
+		const float z = float(i / gridSize) - gridSize * 0.5f;
+		node->getTransform()->setTranslation(glm::vec3(x * spacing,0.0f,z * spacing));
+
+		auto mesh = std::make_shared<StaticMeshComponent>();
+		mesh->m_meshName = meshNames[i % meshNames.size()];
+		scene.addComponent<StaticMeshComponent>(mesh,node);
+	}
+
+	LOG_INFO("Instance stress scene add {0} static meshes using {1} meshes.",count,meshNames.size());
+}
+
+static std::unique_ptr<Scene> parseSceneFile(const std::string& path)
+{
+	if(SceneBinaryArchive::isBinaryScene(path))
+	{
+		auto scene = SceneBinaryArchive::load(path);
+		if(scene == nullptr)
+		{
+			LOG_ERROR("Fail to load binary scene {0}!",path);
+		}
+		return scene;
+	}
+
+	std::ifstream os(path);
+	if(!os)
+	{
+		LOG_ERROR("Fail to open scene {0}!",path);
+		return nullptr;
+	}
+
+	cereal::JSONInputArchive iarchive(os);
+	auto scene = std::make_unique<Scene>();
+	iarchive(*scene);
+	return scene;
+}
+
+// NOTE: Runs on the loading thread. Meshes are decoded and materials parsed here, so the
+//       commit on the main thread only appends vertex data and queues the textures.
+static void prefetchSceneAssets(const Scene& scene)
+{
+	std::vector<std::string> materials;
+	for(auto& weakComponent : scene.getComponents<StaticMeshComponent>())
+	{
+		if(auto component = weakComponent.lock())
+		{
+			const auto& meshName = component->m_customMesh ? component->m_customMeshName : component->m_meshName;
+			MeshLibrary::get()->prefetchMesh(meshName,&materials);
+			materials.insert(materials.end(),component->m_materials.begin(),component->m_materials.end());
+		}
+	}
+
+	std::sort(materials.begin(),materials.end());
+	materials.erase(std::unique(materials.begin(),materials.end()),materials.end());
+	for(const auto& material : materials)
+	{
+		MaterialLibrary::get()->prefetchMaterial(material);
+	}
+}
+
+// NOTE: Main thread after the prefetch flush. Scene graph plus the geometry the sub scene references,
+//       shared meshes are counted by every sub scene that uses them.
+static uint64 estimateResidentBytes(Scene& scene)
+{
+	uint64 bytes = 0;
+	scene.loopNodeTopToDown([&bytes](std::shared_ptr<SceneNode> node)
+	{
+		bytes += sizeof(SceneNode) + sizeof(Transform);
+	},scene.getRootNode());
+
+	std::unordered_set<std::string> meshes;
+	for(auto& weakComponent : scene.getComponents<StaticMeshComponent>())
+	{
+		if(auto component = weakComponent.lock())
+		{
+			const auto& meshName = component->m_customMesh ? component->m_customMeshName : component->m_meshName;
+			if(meshes.insert(meshName).second)
+			{
+				const Mesh& mesh = component->getMesh();
+				bytes += mesh.getByteSize();
+			}
+		}
+	}
+	return bytes;
+}
+
 SceneManager::SceneManager(Ref<ModuleManager> in)
 : IRuntimeModule(in)
 {
@@ -161,6 +470,14 @@ bool SceneManager::init()
 
 void SceneManager::tick(float dt)
 {
+	// NOTE: Frame boundary, nothing of this frame has seen the scene yet.
+	commitPendingScenes();
+	updateStreaming();
+	if(m_bReleaseMeshes)
+	{
+		releaseUnusedMeshes();
+	}
+
 	std::string sceneTile;
 	if(m_activeScene->isDirty())
 	{
@@ -182,6 +499,18 @@ void SceneManager::tick(float dt)
 	// NOTE: ˢڵTransformںĶ߳ռ
 	m_activeScene->flushSceneNodeTransform();
 
+	if(cVarSceneLoadBenchmark.get() > 0)
+	{
+		sceneLoadBenchmark((uint32)cVarSceneLoadBenchmark.get());
+		cVarSceneLoadBenchmark.set(0);
+	}
+
+	if(cVarSceneInstanceStress.get() > 0)
+	{
+		buildInstanceStressScene(*m_activeScene,(uint32)cVarSceneInstanceStress.get());
+		cVarSceneInstanceStress.set(0);
+	}
+
 	// tick all pmx component.
 	auto cachePMXMeshComponents = m_activeScene->getComponents<PMXMeshComponent>();
 	for(auto& weakPmxComp:cachePMXMeshComponents)
@@ -195,6 +524,14 @@ void SceneManager::tick(float dt)
 
 void SceneManager::release()
 {
+	// NOTE: Loading jobs hold this module.
+	while(m_loadingJobs.load() > 0)
+	{
+		std::this_thread::yield();
+	}
+	m_pendingScenes.clear();
+	m_subScenes.clear();
+
 	if(m_activeScene) m_activeScene.reset();
 }
 
@@ -206,22 +543,305 @@ bool SceneManager::loadScene(const std::string& path)
 		return false;
 	}
 
-	std::ifstream os(path);
-	cereal::JSONInputArchive iarchive(os);
-	std::unique_ptr<Scene> loadScene = std::make_unique<Scene>();
-	iarchive(*loadScene);
+	std::unique_ptr<Scene> loadScene = parseSceneFile(path);
+	if(loadScene == nullptr)
+	{
+		return false;
+	}
 
+	// a sync load wins over a pending async one.
+	m_sceneLoadRequest = 0;
+	clearSubScenes();
 	m_activeScene = std::move(loadScene);
+	m_bReleaseMeshes = true;
 
 	return true;
 }
 
 bool SceneManager::unloadScene()
 {
+	m_sceneLoadRequest = 0;
+	clearSubScenes();
 	m_activeScene.reset();
+	m_bReleaseMeshes = true;
 	return true;
 }
 
+bool SceneManager::loadSceneAsync(const std::string& path)
+{
+	if(!FileSystem::endWith(path,s_projectSuffix))
+	{
+		LOG_ERROR("Loading scene path {0} no end with scene suffix!",path);
+		return false;
+	}
+
+	m_sceneLoadRequest = requestLoad(path);
+	return true;
+}
+
+uint64 SceneManager::requestLoad(const std::string& path)
+{
+	const uint64 requestId = ++m_requestId;
+
+	m_loadingJobs ++;
+	jobsystem::execute([this,path,requestId]()
+	{
+		auto scene = parseSceneFile(path);
+		if(scene)
+		{
+			prefetchSceneAssets(*scene);
+		}
+
+		{
+			std::lock_guard lock(m_pendingMutex);
+			m_pendingScenes.push_back(PendingScene{ requestId, std::move(scene) });
+		}
+		m_loadingJobs --;
+	});
+
+	return requestId;
+}
+
+void SceneManager::commitPendingScenes()
+{
+	std::vector<PendingScene> pendingScenes;
+	{
+		std::lock_guard lock(m_pendingMutex);
+		pendingScenes.swap(m_pendingScenes);
+	}
+
+	if(pendingScenes.empty())
+	{
+		return;
+	}
+
+	MeshLibrary::get()->flushPrefetchMeshes();
+	MaterialLibrary::get()->flushPrefetchMaterials();
+
+	for(auto& pending : pendingScenes)
+	{
+		if(pending.requestId == m_sceneLoadRequest)
+		{
+			m_sceneLoadRequest = 0;
+			if(pending.scene)
+			{
+				clearSubScenes();
+				m_activeScene = std::move(pending.scene);
+				m_bReleaseMeshes = true;
+				LOG_INFO("Loaded scene {0}.",m_activeScene->getName());
+			}
+			continue;
+		}
+
+		// stale result, the sub scene was removed or unloaded before the job finished.
+		auto it = std::find_if(m_subScenes.begin(),m_subScenes.end(),[&](const SubScene& subScene)
+		{
+			return subScene.state == ESubSceneState::Loading && subScene.requestId == pending.requestId;
+		});
+		if(it == m_subScenes.end())
+		{
+			continue;
+		}
+
+		if(pending.scene == nullptr)
+		{
+			LOG_ERROR("Remove sub scene {0} which fail to load.",it->path);
+			m_subScenes.erase(it);
+			continue;
+		}
+
+		it->residentBytes = estimateResidentBytes(*pending.scene);
+		it->root = m_activeScene->mergeSubScene(*pending.scene,"SubScene_" + FileSystem::getFileNameWithoutSuffix(it->path));
+		it->state = ESubSceneState::Loaded;
+	}
+}
+
+uint32 SceneManager::addSubScene(const std::string& path,const glm::vec3& center,float radius)
+{
+	if(!FileSystem::endWith(path,s_projectSuffix))
+	{
+		LOG_ERROR("Sub scene path {0} no end with scene suffix!",path);
+		return 0;
+	}
+
+	SubScene subScene {};
+	subScene.id = ++m_subSceneId;
+	subScene.path = path;
+	subScene.center = center;
+	subScene.radius = radius;
+	m_subScenes.push_back(subScene);
+
+	// resident sub scenes load right away, streamed ones wait for updateStreaming.
+	if(!subScene.isStreaming())
+	{
+		loadSubScene(m_subScenes.back());
+	}
+	return subScene.id;
+}
+
+void SceneManager::removeSubScene(uint32 id)
+{
+	auto it = std::find_if(m_subScenes.begin(),m_subScenes.end(),[id](const SubScene& subScene){ return subScene.id == id; });
+	if(it != m_subScenes.end())
+	{
+		unloadSubScene(*it);
+		m_subScenes.erase(it);
+	}
+}
+
+uint64 SceneManager::getSubSceneResidentBytes() const
+{
+	uint64 bytes = 0;
+	for(const auto& subScene : m_subScenes)
+	{
+		if(subScene.state == ESubSceneState::Loaded) bytes += subScene.residentBytes;
+	}
+	return bytes;
+}
+
+void SceneManager::loadSubScene(SubScene& subScene)
+{
+	CHECK(subScene.state == ESubSceneState::Unloaded);
+	subScene.requestId = requestLoad(subScene.path);
+	subScene.state = ESubSceneState::Loading;
+}
+
+void SceneManager::unloadSubScene(SubScene& subScene)
+{
+	if(subScene.state == ESubSceneState::Loaded && m_activeScene)
+	{
+		m_activeScene->detachSubScene(subScene.root);
+		subScene.root = nullptr;
+		m_activeScene->removeExpiredComponents();
+		m_bReleaseMeshes = true;
+	}
+
+	// NOTE: Keep residentBytes, it is the estimate used to admit the next load under budget.
+	subScene.root = nullptr;
+	subScene.requestId = 0;
+	subScene.state = ESubSceneState::Unloaded;
+}
+
+// NOTE: Gives the geometry heap ranges of meshes the active scene no longer references back.
+void SceneManager::releaseUnusedMeshes()
+{
+	m_bReleaseMeshes = false;
+	if(cVarSceneUnloadUnusedMeshes.get() == 0)
+	{
+		return;
+	}
+
+	std::unordered_set<std::string> usedMeshes;
+	if(m_activeScene)
+	{
+		for(auto& weakComponent : m_activeScene->getComponents<StaticMeshComponent>())
+		{
+			if(auto component = weakComponent.lock())
+			{
+				usedMeshes.insert(component->m_customMesh ? component->m_customMeshName : component->m_meshName);
+			}
+		}
+	}
+
+	const uint32 unloadCount = MeshLibrary::get()->unloadUnusedMeshes(usedMeshes);
+	if(unloadCount > 0)
+	{
+		LOG_INFO("Unload {0} meshes no longer referenced by the scene.",unloadCount);
+	}
+}
+
+void SceneManager::clearSubScenes()
+{
+	for(auto& subScene : m_subScenes)
+	{
+		unloadSubScene(subScene);
+	}
+	m_subScenes.clear();
+}
+
+void SceneManager::updateStreaming()
+{
+	if(m_subScenes.empty() || cVarSceneStreaming.get() == 0)
+	{
+		return;
+	}
+
+	auto camera = m_activeScene->getSceneViewCameraNode()->getComponent<SceneViewCamera>();
+	if(camera == nullptr)
+	{
+		return;
+	}
+
+	const glm::vec3 cameraPos = camera->getPosition();
+	const float loadDistance = cVarSceneStreamingDistance.get();
+	const float unloadDistance = loadDistance * 1.25f;
+	const uint64 budget = uint64(cVarSceneStreamingBudget.get()) * 1024 * 1024;
+
+	auto distance = [&](const SubScene& subScene)
+	{
+		return glm::max(0.0f,glm::distance(cameraPos,subScene.center) - subScene.radius);
+	};
+
+	// 1. out of range.
+	uint32 loadingCount = 0;
+	for(auto& subScene : m_subScenes)
+	{
+		if(subScene.isStreaming() && subScene.state != ESubSceneState::Unloaded && distance(subScene) > unloadDistance)
+		{
+			unloadSubScene(subScene);
+		}
+		loadingCount += subScene.state == ESubSceneState::Loading ? 1 : 0;
+	}
+
+	// 2. over budget, drop the farthest streamed sub scenes first.
+	uint64 residentBytes = getSubSceneResidentBytes();
+	if(residentBytes > budget)
+	{
+		std::vector<SubScene*> loaded;
+		for(auto& subScene : m_subScenes)
+		{
+			if(subScene.isStreaming() && subScene.state == ESubSceneState::Loaded) loaded.push_back(&subScene);
+		}
+		std::sort(loaded.begin(),loaded.end(),[&](const SubScene* a,const SubScene* b){ return distance(*a) > distance(*b); });
+
+		for(auto* subScene : loaded)
+		{
+			if(residentBytes <= budget) break;
+
+			residentBytes -= subScene->residentBytes;
+			unloadSubScene(*subScene);
+		}
+	}
+
+	// 3. request the closest sub scenes in range.
+	std::vector<SubScene*> candidates;
+	for(auto& subScene : m_subScenes)
+	{
+		if(subScene.isStreaming() && subScene.state == ESubSceneState::Unloaded && distance(subScene) <= loadDistance)
+		{
+			candidates.push_back(&subScene);
+		}
+	}
+	std::sort(candidates.begin(),candidates.end(),[&](const SubScene* a,const SubScene* b){ return distance(*a) < distance(*b); });
+
+	for(auto* subScene : candidates)
+	{
+		if(loadingCount >= (uint32)cVarSceneStreamingMaxLoading.get())
+		{
+			break;
+		}
+
+		// residentBytes is 0 until the sub scene was loaded once.
+		if(residentBytes + subScene->residentBytes > budget)
+		{
+			break;
+		}
+
+		loadSubScene(*subScene);
+		loadingCount ++;
+	}
+}
+
 bool SceneManager::saveScene(const std::string& path)
 {
 	if(!FileSystem::endWith(path,s_projectSuffix))
@@ -230,13 +850,34 @@ bool SceneManager::saveScene(const std::string& path)
 		return false;
 	}
 
+	m_activeScene->setName(FileSystem::getFileNameWithoutSuffix(path));
+
+	// NOTE: Sub scenes live in their own files, keep them out of the level file.
+	for(auto& subScene : m_subScenes)
+	{
+		if(subScene.root) m_activeScene->detachSubScene(subScene.root);
+	}
+	const bool bSaved = SceneBinaryArchive::save(*m_activeScene,path);
+	for(auto& subScene : m_subScenes)
+	{
+		if(subScene.root) m_activeScene->attachSubScene(subScene.root);
+	}
+
+	if(!bSaved)
+	{
+		return false;
+	}
+	m_activeScene->setDirty(false);
+
+	return true;
+}
+
+bool SceneManager::exportScene(const std::string& path)
+{
 	std::ofstream os(path);
 	cereal::JSONOutputArchive archive(os);
 
-	m_activeScene->setName(FileSystem::getFileNameWithoutSuffix(path));
-
 	archive(*m_activeScene);
-	m_activeScene->setDirty(false);
 
 	return true;
 }
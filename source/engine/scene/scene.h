@@ -3,6 +3,8 @@
 #include "../core/runtime_module.h"
 #include "component.h"
 #include <list>
+#include <mutex>
+#include <atomic>
 #include "scene_node.h"
 
 namespace engine{
@@ -33,6 +35,7 @@ private:
 
 private:
 	friend class cereal::access;
+	friend class SceneBinaryArchive;
 
 	template <class Archive>
 	void serialize(Archive& ar)
@@ -106,6 +109,15 @@ public:
 		}
 	}
 
+	// NOTE: Move all nodes of a loaded sub scene under a new root child named name,
+	//       node ids are reassigned from this scene. The sub scene camera is dropped.
+	std::shared_ptr<SceneNode> mergeSubScene(Scene& subScene,const std::string& name);
+
+	// NOTE: Take a merged sub scene root in or out of the tree without touching the dirty flag.
+	void detachSubScene(std::shared_ptr<SceneNode> subSceneRoot);
+	void attachSubScene(std::shared_ptr<SceneNode> subSceneRoot);
+	void removeExpiredComponents();
+
 	// NOTE: ӹϵ
 	bool setParent(std::shared_ptr<SceneNode> parent,std::shared_ptr<SceneNode> son);
 
@@ -176,6 +188,30 @@ public:
 	}
 };
 
+enum class ESubSceneState
+{
+	Unloaded,
+	Loading,
+	Loaded,
+};
+
+// NOTE: Additive level chunk. Streamed in and out around the camera when radius > 0,
+//       otherwise it stays resident until removed.
+struct SubScene
+{
+	uint32 id;
+	std::string path;
+	glm::vec3 center;
+	float radius;
+
+	ESubSceneState state = ESubSceneState::Unloaded;
+	uint64 requestId = 0;
+	uint64 residentBytes = 0;
+	std::shared_ptr<SceneNode> root = nullptr;
+
+	bool isStreaming() const { return radius > 0.0f; }
+};
+
 class SceneManager: public IRuntimeModule
 {
 public:
@@ -187,10 +223,27 @@ public:
 	virtual void release() override;
 
 public:
+	// NOTE: Loads binary scenes, falls back to cereal json for legacy files.
 	bool loadScene(const std::string& path);
 	bool unloadScene();
+
+	// NOTE: Parse and prefetch referenced meshes and materials on a worker thread,
+	//       the active scene is swapped at the start of the next tick after it finished.
+	bool loadSceneAsync(const std::string& path);
+	bool isSceneLoading() const { return m_sceneLoadRequest != 0; }
+
+	// NOTE: Sub scenes belong to the active scene and are cleared when it is replaced.
+	uint32 addSubScene(const std::string& path,const glm::vec3& center = glm::vec3(0.0f),float radius = 0.0f);
+	void removeSubScene(uint32 id);
+	const std::vector<SubScene>& getSubScenes() const { return m_subScenes; }
+	uint64 getSubSceneResidentBytes() const;
+
+	// NOTE: Saves the binary scene format.
 	bool saveScene(const std::string& path);
 
+	// NOTE: Cereal json export, used for diff and debug.
+	bool exportScene(const std::string& path);
+
 	Scene& getActiveScene()
 	{
 		return *m_activeScene;
@@ -199,8 +252,37 @@ public:
 private:
 	void createEmptyScene();
 	std::string originalTile;
+
+	struct PendingScene
+	{
+		uint64 requestId;
+		std::unique_ptr<Scene> scene;
+	};
+
+	uint64 requestLoad(const std::string& path);
+	void commitPendingScenes();
+	void updateStreaming();
+	void loadSubScene(SubScene& subScene);
+	void unloadSubScene(SubScene& subScene);
+	void clearSubScenes();
+	void releaseUnusedMeshes();
+
 private:
 	std::unique_ptr<Scene> m_activeScene = nullptr;
+
+	std::vector<SubScene> m_subScenes;
+	uint32 m_subSceneId = 0;
+
+	uint64 m_requestId = 0;
+	uint64 m_sceneLoadRequest = 0;
+
+	// NOTE: Set when scene content goes away, meshes nothing references are unloaded at the next tick.
+	bool m_bReleaseMeshes = false;
+
+	// NOTE: Written by loading jobs, consumed on the main thread.
+	std::mutex m_pendingMutex;
+	std::vector<PendingScene> m_pendingScenes;
+	std::atomic<uint32> m_loadingJobs = 0;
 };
 
 }
\ No newline at end of file
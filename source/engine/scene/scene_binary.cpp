@@ -0,0 +1,539 @@
+#include "scene_binary.h"
+#include "scene.h"
+#include "scene_node.h"
+#include "components/staticmesh_renderer.h"
+#include "components/directionalLight.h"
+#include "components/sceneview_camera.h"
+#include "components/pmx_mesh_component.h"
+#include <fstream>
+#include <queue>
+#include <type_traits>
+
+namespace engine{
+
+static_assert(std::is_trivially_copyable_v<SceneBinaryHeader>);
+static_assert(std::is_trivially_copyable_v<SceneBinaryNode>);
+static_assert(sizeof(SceneBinaryHeader) == 72);
+static_assert(sizeof(SceneBinaryNode) == 64);
+
+class SceneBinaryWriter
+{
+public:
+	std::vector<uint8> data;
+
+	template<typename T>
+	void write(const T& v)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		const size_t pos = data.size();
+		data.resize(pos + sizeof(T));
+		memcpy(data.data() + pos,&v,sizeof(T));
+	}
+
+	void writeBytes(const void* src,size_t size)
+	{
+		const size_t pos = data.size();
+		data.resize(pos + size);
+		memcpy(data.data() + pos,src,size);
+	}
+
+	template<typename T>
+	void patch(size_t pos,const T& v)
+	{
+		memcpy(data.data() + pos,&v,sizeof(T));
+	}
+};
+
+// NOTE: Every read is bounds checked, a truncated file flips m_bOk instead of reading past the end.
+class SceneBinaryReader
+{
+public:
+	SceneBinaryReader(const uint8* data,size_t size) : m_data(data),m_size(size) { }
+
+	template<typename T>
+	bool read(T& v)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		if(!m_bOk || m_size - m_pos < sizeof(T))
+		{
+			m_bOk = false;
+			v = {};
+			return false;
+		}
+		memcpy(&v,m_data + m_pos,sizeof(T));
+		m_pos += sizeof(T);
+		return true;
+	}
+
+	const uint8* readBytes(size_t size)
+	{
+		if(!m_bOk || m_size - m_pos < size)
+		{
+			m_bOk = false;
+			return nullptr;
+		}
+		const uint8* ptr = m_data + m_pos;
+		m_pos += size;
+		return ptr;
+	}
+
+	void seek(size_t pos)
+	{
+		if(pos > m_size) m_bOk = false;
+		else m_pos = pos;
+	}
+
+	bool ok() const { return m_bOk; }
+	size_t remaining() const { return m_bOk ? m_size - m_pos : 0; }
+
+private:
+	const uint8* m_data;
+	size_t m_size;
+	size_t m_pos = 0;
+	bool m_bOk = true;
+};
+
+class SceneBinaryStringTable
+{
+public:
+	uint32 add(const std::string& str)
+	{
+		auto it = m_lookup.find(str);
+		if(it != m_lookup.end()) return it->second;
+
+		const uint32 id = (uint32)m_strings.size();
+		m_strings.push_back(str);
+		m_lookup[str] = id;
+		return id;
+	}
+
+	void write(SceneBinaryWriter& writer) const
+	{
+		uint32 offset = 0;
+		for(const auto& str : m_strings)
+		{
+			writer.write(offset);
+			offset += (uint32)str.size();
+		}
+		writer.write(offset);
+
+		for(const auto& str : m_strings)
+		{
+			writer.writeBytes(str.data(),str.size());
+		}
+	}
+
+	uint32 size() const { return (uint32)m_strings.size(); }
+
+private:
+	std::vector<std::string> m_strings;
+	std::unordered_map<std::string,uint32> m_lookup;
+};
+
+// NOTE: Per component payload. Keep field order in sync with the cereal serialize() of each component,
+//       and bump sceneBinary::VERSION when a payload changes.
+bool SceneBinaryArchive::saveComponent(const std::shared_ptr<Component>& component,SceneBinaryWriter& writer,SceneBinaryStringTable& strings)
+{
+	switch(component->getType())
+	{
+	case EComponentType::StaticMeshComponent:
+	{
+		auto comp = std::static_pointer_cast<StaticMeshComponent>(component);
+		writer.write(strings.add(comp->m_meshName));
+		writer.write(uint32(comp->m_customMesh ? 1 : 0));
+		writer.write(strings.add(comp->m_customMeshName));
+		writer.write((uint32)comp->m_materials.size());
+		for(const auto& material : comp->m_materials)
+		{
+			writer.write(strings.add(material));
+		}
+		return true;
+	}
+	case EComponentType::DirectionalLight:
+	{
+		auto comp = std::static_pointer_cast<DirectionalLight>(component);
+		writer.write(comp->m_color);
+		writer.write(strings.add(comp->m_lightName));
+		return true;
+	}
+	case EComponentType::SceneViewCamera:
+	{
+		auto comp = std::static_pointer_cast<SceneViewCamera>(component);
+		writer.write(strings.add(comp->m_cameraName));
+		writer.write(comp->m_viewMatrix);
+		writer.write(comp->m_projectMatrix);
+		writer.write(comp->m_zNear);
+		writer.write(comp->m_zFar);
+		writer.write(comp->m_fovY);
+		return true;
+	}
+	case EComponentType::PMXMeshComponent:
+	{
+		auto comp = std::static_pointer_cast<PMXMeshComponent>(component);
+		writer.write(strings.add(comp->m_pmxPath));
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+bool SceneBinaryArchive::loadComponent(
+	uint32 type,
+	SceneBinaryReader& reader,
+	const std::vector<std::string>& strings,
+	const std::shared_ptr<SceneNode>& node,
+	Scene& scene)
+{
+	auto readString = [&](std::string& out)
+	{
+		uint32 id;
+		if(!reader.read(id) || id >= strings.size()) return false;
+		out = strings[id];
+		return true;
+	};
+
+	switch(type)
+	{
+	case EComponentType::StaticMeshComponent:
+	{
+		auto comp = std::make_shared<StaticMeshComponent>();
+		uint32 bCustomMesh;
+		uint32 materialCount;
+		readString(comp->m_meshName);
+		reader.read(bCustomMesh);
+		readString(comp->m_customMeshName);
+		reader.read(materialCount);
+
+		// every material is a string id, a count past the payload is corrupt and must not allocate.
+		if(!reader.ok() || materialCount > reader.remaining() / sizeof(uint32)) return false;
+
+		comp->m_customMesh = bCustomMesh != 0;
+		comp->m_materials.resize(materialCount);
+		for(auto& material : comp->m_materials)
+		{
+			if(!readString(material)) return false;
+		}
+		scene.addComponent<StaticMeshComponent>(comp,node);
+		return true;
+	}
+	case EComponentType::DirectionalLight:
+	{
+		auto comp = std::make_shared<DirectionalLight>();
+		reader.read(comp->m_color);
+		if(!readString(comp->m_lightName)) return false;
+		scene.addComponent<DirectionalLight>(comp,node);
+		return true;
+	}
+	case EComponentType::SceneViewCamera:
+	{
+		auto comp = std::make_shared<SceneViewCamera>();
+		readString(comp->m_cameraName);
+		reader.read(comp->m_viewMatrix);
+		reader.read(comp->m_projectMatrix);
+		reader.read(comp->m_zNear);
+		reader.read(comp->m_zFar);
+		reader.read(comp->m_fovY);
+		if(!reader.ok()) return false;
+		scene.addComponent<SceneViewCamera>(comp,node);
+		return true;
+	}
+	case EComponentType::PMXMeshComponent:
+	{
+		auto comp = std::make_shared<PMXMeshComponent>();
+		if(!readString(comp->m_pmxPath)) return false;
+		scene.addComponent<PMXMeshComponent>(comp,node);
+		return true;
+	}
+	default:
+		LOG_WARN("Binary scene skip unknown component type {0}.",type);
+		return true;
+	}
+}
+
+bool SceneBinaryArchive::isBinaryScene(const std::string& path)
+{
+	std::ifstream is(path,std::ios::binary);
+	uint32 magic = 0;
+	if(!is.read(reinterpret_cast<char*>(&magic),sizeof(magic))) return false;
+	return magic == sceneBinary::MAGIC;
+}
+
+bool SceneBinaryArchive::save(Scene& scene,const std::string& path)
+{
+	// NOTE: Breadth first walk so every parent is written before its children.
+	//       Parent index comes from the children lists, which is what defines the tree.
+	std::vector<std::shared_ptr<SceneNode>> nodes;
+	std::vector<uint32> parents;
+	auto collect = [&](const std::shared_ptr<SceneNode>& root)
+	{
+		std::queue<std::pair<std::shared_ptr<SceneNode>,uint32>> queue;
+		queue.push({ root, sceneBinary::INVALID_INDEX });
+		while(!queue.empty())
+		{
+			auto [node,parent] = queue.front();
+			queue.pop();
+
+			const uint32 index = (uint32)nodes.size();
+			nodes.push_back(node);
+			parents.push_back(parent);
+			for(auto& child : node->getChildren())
+			{
+				queue.push({ child, index });
+			}
+		}
+	};
+
+	// scene view camera node is not parented to root, store it as a second root.
+	collect(scene.m_root);
+	const uint32 cameraIndex = (uint32)nodes.size();
+	collect(scene.m_sceneViewCameraNode);
+
+	SceneBinaryStringTable strings;
+	std::vector<SceneBinaryNode> nodeRecords(nodes.size());
+	for(size_t i = 0; i < nodes.size(); i++)
+	{
+		const auto& node = nodes[i];
+		auto& record = nodeRecords[i];
+
+		auto transform = node->m_transform;
+
+		record.id = (uint64)node->m_id;
+		record.name = strings.add(node->m_name);
+		record.parent = parents[i];
+		record.depth = (uint32)node->m_depth;
+		record.childCount = (uint32)node->m_children.size();
+		memcpy(record.translation,&transform->m_translation,sizeof(record.translation));
+		record.rotation[0] = transform->m_rotation.x;
+		record.rotation[1] = transform->m_rotation.y;
+		record.rotation[2] = transform->m_rotation.z;
+		record.rotation[3] = transform->m_rotation.w;
+		memcpy(record.scale,&transform->m_scale,sizeof(record.scale));
+	}
+
+	// component blobs first, the string table has to be complete before it is written.
+	SceneBinaryWriter componentWriter;
+	uint32 componentCount = 0;
+	for(size_t i = 0; i < nodes.size(); i++)
+	{
+		std::vector<std::shared_ptr<Component>> components;
+		for(auto& pair : nodes[i]->m_components)
+		{
+			if(pair.first != EComponentType::Transform) components.push_back(pair.second);
+		}
+		std::sort(components.begin(),components.end(),[](const auto& a,const auto& b){ return a->getType() < b->getType(); });
+
+		for(auto& component : components)
+		{
+			const size_t headerPos = componentWriter.data.size();
+			componentWriter.write((uint32)component->getType());
+			componentWriter.write((uint32)i);
+			componentWriter.write(uint32(0));
+
+			const size_t payloadBegin = componentWriter.data.size();
+			if(!saveComponent(component,componentWriter,strings))
+			{
+				LOG_WARN("Binary scene skip unsupported component type {0}.",component->getType());
+				componentWriter.data.resize(headerPos);
+				continue;
+			}
+			componentWriter.patch(headerPos + 2 * sizeof(uint32),uint32(componentWriter.data.size() - payloadBegin));
+			componentCount ++;
+		}
+	}
+
+	SceneBinaryHeader header{};
+	header.magic = sceneBinary::MAGIC;
+	header.version = sceneBinary::VERSION;
+	header.currentId = (uint64)scene.m_CurrentId;
+	header.sceneName = strings.add(scene.m_name);
+	header.nodeCount = (uint32)nodes.size();
+	header.sceneViewCameraNode = cameraIndex;
+	header.componentCount = componentCount;
+	header.stringCount = strings.size();
+
+	SceneBinaryWriter writer;
+	writer.write(header);
+
+	header.stringTableOffset = writer.data.size();
+	strings.write(writer);
+
+	// keep node records 8 byte aligned so loaders may map them in place.
+	while(writer.data.size() % 8 != 0) writer.write(uint8(0));
+	header.nodeOffset = writer.data.size();
+	writer.writeBytes(nodeRecords.data(),nodeRecords.size() * sizeof(SceneBinaryNode));
+
+	header.componentOffset = writer.data.size();
+	writer.writeBytes(componentWriter.data.data(),componentWriter.data.size());
+
+	header.fileSize = writer.data.size();
+	writer.patch(0,header);
+
+	std::ofstream os(path,std::ios::binary | std::ios::trunc);
+	if(!os.write(reinterpret_cast<const char*>(writer.data.data()),writer.data.size()))
+	{
+		LOG_ERROR("Fail to write binary scene {0}.",path);
+		return false;
+	}
+	return true;
+}
+
+std::unique_ptr<Scene> SceneBinaryArchive::load(const std::string& path)
+{
+	std::ifstream is(path,std::ios::binary | std::ios::ate);
+	if(!is)
+	{
+		LOG_ERROR("Fail to open binary scene {0}.",path);
+		return nullptr;
+	}
+
+	const size_t size = (size_t)is.tellg();
+	std::vector<uint8> data(size);
+	is.seekg(0);
+	if(!is.read(reinterpret_cast<char*>(data.data()),size))
+	{
+		LOG_ERROR("Fail to read binary scene {0}.",path);
+		return nullptr;
+	}
+
+	return load(data.data(),data.size());
+}
+
+std::unique_ptr<Scene> SceneBinaryArchive::load(const uint8* data,size_t size)
+{
+	SceneBinaryReader reader(data,size);
+
+	SceneBinaryHeader header;
+	if(!reader.read(header) || header.magic != sceneBinary::MAGIC)
+	{
+		LOG_ERROR("Binary scene magic mismatch.");
+		return nullptr;
+	}
+	if(header.version != sceneBinary::VERSION)
+	{
+		LOG_ERROR("Binary scene version {0} is not supported, current version is {1}.",header.version,sceneBinary::VERSION);
+		return nullptr;
+	}
+	if(header.fileSize != size || header.nodeCount == 0 || header.sceneViewCameraNode >= header.nodeCount)
+	{
+		LOG_ERROR("Binary scene header is corrupted.");
+		return nullptr;
+	}
+
+	// string table, counts are only trusted once their bytes are known to be in the file.
+	std::vector<std::string> strings;
+	{
+		reader.seek(header.stringTableOffset);
+		const uint8* offsetBytes = reader.readBytes(sizeof(uint32) * (size_t(header.stringCount) + 1));
+		if(offsetBytes == nullptr)
+		{
+			LOG_ERROR("Binary scene string table is truncated.");
+			return nullptr;
+		}
+
+		std::vector<uint32> offsets(size_t(header.stringCount) + 1);
+		memcpy(offsets.data(),offsetBytes,offsets.size() * sizeof(uint32));
+
+		const uint8* chars = reader.readBytes(offsets.back());
+		if(chars == nullptr) return nullptr;
+
+		strings.resize(header.stringCount);
+
+		for(uint32 i = 0; i < header.stringCount; i++)
+		{
+			if(offsets[i] > offsets[i + 1] || offsets[i + 1] > offsets.back())
+			{
+				LOG_ERROR("Binary scene string table is corrupted.");
+				return nullptr;
+			}
+			strings[i].assign(reinterpret_cast<const char*>(chars + offsets[i]),offsets[i + 1] - offsets[i]);
+		}
+	}
+
+	// node records, copied in one block.
+	std::vector<SceneBinaryNode> nodeRecords;
+	{
+		reader.seek(header.nodeOffset);
+		const uint8* nodeBytes = reader.readBytes(sizeof(SceneBinaryNode) * size_t(header.nodeCount));
+		if(nodeBytes == nullptr)
+		{
+			LOG_ERROR("Binary scene node array is truncated.");
+			return nullptr;
+		}
+		nodeRecords.resize(header.nodeCount);
+		memcpy(nodeRecords.data(),nodeBytes,nodeRecords.size() * sizeof(SceneBinaryNode));
+	}
+
+	std::unique_ptr<Scene> scene = std::make_unique<Scene>();
+	scene->m_components.clear();
+
+	std::vector<std::shared_ptr<SceneNode>> nodes(header.nodeCount);
+	for(uint32 i = 0; i < header.nodeCount; i++)
+	{
+		const auto& record = nodeRecords[i];
+		if(record.name >= strings.size() || record.childCount >= header.nodeCount ||
+			(record.parent != sceneBinary::INVALID_INDEX && record.parent >= i))
+		{
+			LOG_ERROR("Binary scene node {0} is corrupted.",i);
+			return nullptr;
+		}
+
+		auto node = SceneNode::create((size_t)record.id,strings[record.name]);
+		node->m_depth = record.depth;
+		node->m_children.reserve(record.childCount);
+
+		auto& transform = node->m_transform;
+		transform->m_translation = glm::vec3(record.translation[0],record.translation[1],record.translation[2]);
+		transform->m_rotation = glm::quat(record.rotation[3],record.rotation[0],record.rotation[1],record.rotation[2]);
+		transform->m_scale = glm::vec3(record.scale[0],record.scale[1],record.scale[2]);
+
+		// parents are stored first, so linking never needs a second pass.
+		if(record.parent != sceneBinary::INVALID_INDEX)
+		{
+			node->m_parent = nodes[record.parent];
+			nodes[record.parent]->m_children.push_back(node);
+		}
+		nodes[i] = std::move(node);
+	}
+
+	if(nodeRecords[0].parent != sceneBinary::INVALID_INDEX || nodeRecords[header.sceneViewCameraNode].parent != sceneBinary::INVALID_INDEX)
+	{
+		LOG_ERROR("Binary scene roots are corrupted.");
+		return nullptr;
+	}
+
+	reader.seek(header.componentOffset);
+	for(uint32 i = 0; i < header.componentCount; i++)
+	{
+		uint32 type;
+		uint32 nodeIndex;
+		uint32 payloadSize;
+		reader.read(type);
+		reader.read(nodeIndex);
+		reader.read(payloadSize);
+
+		const uint8* payload = reader.readBytes(payloadSize);
+		if(payload == nullptr || nodeIndex >= header.nodeCount)
+		{
+			LOG_ERROR("Binary scene component {0} is corrupted.",i);
+			return nullptr;
+		}
+
+		SceneBinaryReader payloadReader(payload,payloadSize);
+		if(!loadComponent(type,payloadReader,strings,nodes[nodeIndex],*scene))
+		{
+			LOG_ERROR("Binary scene component {0} payload is corrupted.",i);
+			return nullptr;
+		}
+	}
+
+	scene->m_root = nodes[0];
+	scene->m_sceneViewCameraNode = nodes[header.sceneViewCameraNode];
+	scene->m_CurrentId = (size_t)header.currentId;
+	if(header.sceneName < strings.size()) scene->m_name = strings[header.sceneName];
+	scene->setDirty(false);
+
+	return scene;
+}
+
+}
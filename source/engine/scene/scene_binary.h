@@ -0,0 +1,80 @@
+#pragma once
+#include "../core/core.h"
+#include <memory>
+#include <string>
+
+namespace engine{
+
+class Scene;
+class SceneNode;
+class Component;
+class SceneBinaryWriter;
+class SceneBinaryReader;
+class SceneBinaryStringTable;
+
+// NOTE: Binary scene layout (little endian):
+//       SceneBinaryHeader
+//       string table: uint32 offsets[stringCount + 1], then utf8 chars without terminator
+//       SceneBinaryNode[nodeCount], parents always come before their children (depth order)
+//       component blobs: { uint32 type, uint32 node, uint32 size, uint8 payload[size] } * componentCount
+//       Unknown component types are skipped by size so older builds can open newer files.
+namespace sceneBinary
+{
+	constexpr uint32 MAGIC   = 0x42534C46; // "FLSB"
+	constexpr uint32 VERSION = 1;
+	constexpr uint32 INVALID_INDEX = ~0u;
+}
+
+struct SceneBinaryHeader
+{
+	uint32 magic;
+	uint32 version;
+	uint64 currentId;
+	uint32 sceneName;
+	uint32 nodeCount;
+	uint32 sceneViewCameraNode;
+	uint32 componentCount;
+	uint32 stringCount;
+	uint32 reserved;
+	uint64 stringTableOffset;
+	uint64 nodeOffset;
+	uint64 componentOffset;
+	uint64 fileSize;
+};
+
+struct SceneBinaryNode
+{
+	uint64 id;
+	uint32 name;
+	uint32 parent;
+	uint32 depth;
+	uint32 childCount;
+	float translation[3];
+	float rotation[4]; // x y z w
+	float scale[3];
+};
+
+class SceneBinaryArchive
+{
+public:
+	// NOTE: Sniff the magic only, used to keep loading legacy json scenes.
+	static bool isBinaryScene(const std::string& path);
+
+	static bool save(Scene& scene,const std::string& path);
+
+	// NOTE: Reads the file with one call and builds the node graph in bulk.
+	static std::unique_ptr<Scene> load(const std::string& path);
+	static std::unique_ptr<Scene> load(const uint8* data,size_t size);
+
+private:
+	static bool saveComponent(const std::shared_ptr<Component>& component,SceneBinaryWriter& writer,SceneBinaryStringTable& strings);
+	static bool loadComponent(
+		uint32 type,
+		SceneBinaryReader& reader,
+		const std::vector<std::string>& strings,
+		const std::shared_ptr<SceneNode>& node,
+		Scene& scene
+	);
+};
+
+}
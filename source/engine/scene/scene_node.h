@@ -28,6 +28,7 @@ private:
 
 private:
     friend class cereal::access;
+    friend class SceneBinaryArchive;
 
     friend class cereal::access;
     template <class Archive>
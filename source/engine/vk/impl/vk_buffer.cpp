@@ -148,7 +148,7 @@ bool VulkanBuffer::CreateBuffer(
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
 	bufferInfo.usage = usageFlags;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	m_device->setSharingMode(bufferInfo);
 
 	if(!isHeap())
 	{
@@ -140,6 +140,12 @@ enum class EVertexAttribute : uint32
 	tangent,        // vec4
 	color,          // vec3
 	alpha,          // float
+
+	// NOTE: Quantized static mesh attributes, see PackedMeshVertex.
+	packedPos,      // unorm16x4, xyz inside the submesh bounds, w the bitangent sign.
+	packedUv0,      // half2
+	packedNormal,   // snorm16x2 octahedral
+	packedTangent,  // snorm16x2 octahedral
 	count,
 };
 
@@ -148,9 +154,16 @@ inline int32 getVertexAttributeSize(EVertexAttribute va)
 	switch(va)
 	{
 	case EVertexAttribute::alpha:
+	case EVertexAttribute::packedUv0:
+	case EVertexAttribute::packedNormal:
+	case EVertexAttribute::packedTangent:
 		return sizeof(float);
 		break;
 
+	case EVertexAttribute::packedPos:
+		return 4 * sizeof(uint16);
+		break;
+
 	case EVertexAttribute::uv0:
 	case EVertexAttribute::uv1:
 		return 2 * sizeof(float);
@@ -205,6 +218,19 @@ inline VkFormat toVkFormat(EVertexAttribute va)
 		format = VK_FORMAT_R32G32B32A32_SFLOAT;
 		break;
 
+	case EVertexAttribute::packedPos:
+		format = VK_FORMAT_R16G16B16A16_UNORM;
+		break;
+
+	case EVertexAttribute::packedUv0:
+		format = VK_FORMAT_R16G16_SFLOAT;
+		break;
+
+	case EVertexAttribute::packedNormal:
+	case EVertexAttribute::packedTangent:
+		format = VK_FORMAT_R16G16_SNORM;
+		break;
+
 	case EVertexAttribute::none:
 	case EVertexAttribute::count:
 	default:
@@ -34,9 +34,10 @@ void VulkanDescriptorAllocator::resetPools()
         vkResetDescriptorPool(*m_device,p,0);
     }
 
-    m_freePools = m_usedPools;
+    m_freePools.insert(m_freePools.end(),m_usedPools.begin(),m_usedPools.end());
     m_usedPools.clear();
     m_currentPool = VK_NULL_HANDLE;
+    m_setCount = 0;
 }
 
 bool VulkanDescriptorAllocator::allocate(VkDescriptorSet* set,VkDescriptorSetLayout layout)
@@ -62,6 +63,7 @@ bool VulkanDescriptorAllocator::allocate(VkDescriptorSet* set,VkDescriptorSetLay
     switch(allocResult)
     {
     case VK_SUCCESS:
+        m_setCount++;
         return true;
         break;
 
@@ -83,6 +85,7 @@ bool VulkanDescriptorAllocator::allocate(VkDescriptorSet* set,VkDescriptorSetLay
         allocResult = vkAllocateDescriptorSets(*m_device,&allocInfo,set);
         if(allocResult == VK_SUCCESS)
         {
+            m_setCount++;
             return true;
         }
     }
@@ -124,6 +127,136 @@ VkDescriptorPool VulkanDescriptorAllocator::requestPool()
     }
 }
 
+std::vector<VkDescriptorPool> VulkanDescriptorAllocator::releaseUsedPools()
+{
+    std::vector<VkDescriptorPool> pools = std::move(m_usedPools);
+    m_usedPools.clear();
+    m_currentPool = VK_NULL_HANDLE;
+    m_setCount = 0;
+    return pools;
+}
+
+void VulkanDescriptorAllocator::recyclePools(const std::vector<VkDescriptorPool>& pools)
+{
+    for(auto p : pools)
+    {
+        vkResetDescriptorPool(*m_device,p,0);
+        m_freePools.push_back(p);
+    }
+}
+
+void VulkanFrameDescriptorAllocator::init(VulkanDevice* device,uint32 frameCount)
+{
+    m_device = device;
+    m_allocators.resize(frameCount);
+    for(auto& allocator : m_allocators)
+    {
+        allocator.init(device);
+    }
+}
+
+void VulkanFrameDescriptorAllocator::cleanup()
+{
+    for(auto& allocator : m_allocators)
+    {
+        allocator.cleanup();
+    }
+    m_allocators.clear();
+}
+
+void VulkanFrameDescriptorAllocator::beginFrame(uint32 frameIndex)
+{
+    std::lock_guard lock(m_mutex);
+
+    // The frame recorded last is complete on the cpu side, keep its usage for stats.
+    m_lastFrameStats = m_allocators[m_frameIndex].getStats();
+
+    m_frameIndex = frameIndex;
+    m_allocators[m_frameIndex].resetPools();
+}
+
+bool VulkanFrameDescriptorAllocator::allocate(VkDescriptorSet* set,VkDescriptorSetLayout layout)
+{
+    std::lock_guard lock(m_mutex);
+    return m_allocators[m_frameIndex].allocate(set,layout);
+}
+
+VulkanDescriptorAllocator::Stats VulkanFrameDescriptorAllocator::getStats() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_lastFrameStats;
+}
+
+size_t VulkanDescriptorSetCache::Key::hash() const
+{
+    size_t result = std::hash<uint64>()((uint64)layout);
+    for(uint64 word : words)
+    {
+        result ^= std::hash<uint64>()(word) + 0x9e3779b9 + (result << 6) + (result >> 2);
+    }
+    return result;
+}
+
+void VulkanDescriptorSetCache::init(VulkanDevice* device)
+{
+    m_allocator.init(device);
+}
+
+void VulkanDescriptorSetCache::cleanup()
+{
+    std::lock_guard lock(m_mutex);
+    m_sets.clear();
+    m_allocator.cleanup();
+}
+
+bool VulkanDescriptorSetCache::getOrCreate(const Key& key,const std::function<void(VkDescriptorSet)>& write,VkDescriptorSet* set)
+{
+    std::lock_guard lock(m_mutex);
+
+    auto it = m_sets.find(key);
+    if(it != m_sets.end())
+    {
+        m_hitCount++;
+        *set = it->second;
+        return true;
+    }
+
+    m_missCount++;
+    if(!m_allocator.allocate(set,key.layout))
+    {
+        return false;
+    }
+
+    write(*set);
+    m_sets.emplace(key,*set);
+    return true;
+}
+
+std::vector<VkDescriptorPool> VulkanDescriptorSetCache::clear()
+{
+    std::lock_guard lock(m_mutex);
+    m_sets.clear();
+    return m_allocator.releaseUsedPools();
+}
+
+void VulkanDescriptorSetCache::recyclePools(const std::vector<VkDescriptorPool>& pools)
+{
+    std::lock_guard lock(m_mutex);
+    m_allocator.recyclePools(pools);
+}
+
+VulkanDescriptorSetCache::Stats VulkanDescriptorSetCache::getStats() const
+{
+    std::lock_guard lock(m_mutex);
+    const auto allocatorStats = m_allocator.getStats();
+
+    Stats stats { };
+    stats.setCount = (uint32)m_sets.size();
+    stats.poolCount = allocatorStats.usedPoolCount + allocatorStats.freePoolCount;
+    stats.hitCount = m_hitCount;
+    stats.missCount = m_missCount;
+    return stats;
+}
 
 void VulkanDescriptorLayoutCache::init(VulkanDevice* newDevice)
 {
@@ -134,6 +267,7 @@ VkDescriptorSetLayout VulkanDescriptorLayoutCache::createDescriptorLayout(VkDesc
 {
     DescriptorLayoutInfo layoutinfo;
     layoutinfo.bindings.reserve(info->bindingCount);
+    layoutinfo.flags = info->flags;
     bool isSorted = true;
     int32_t lastBinding = -1;
 
@@ -191,10 +325,29 @@ VulkanDescriptorFactory VulkanDescriptorFactory::begin(VulkanDescriptorLayoutCac
 {
     VulkanDescriptorFactory builder;
     builder.m_cache = layoutCache;
+    builder.m_device = allocator->getDevice();
     builder.m_allocator = allocator;
     return builder;
 }
 
+VulkanDescriptorFactory VulkanDescriptorFactory::begin(VulkanDescriptorLayoutCache* layoutCache,VulkanFrameDescriptorAllocator* allocator)
+{
+    VulkanDescriptorFactory builder;
+    builder.m_cache = layoutCache;
+    builder.m_device = allocator->getDevice();
+    builder.m_frameAllocator = allocator;
+    return builder;
+}
+
+VulkanDescriptorFactory VulkanDescriptorFactory::begin(VulkanDescriptorLayoutCache* layoutCache,VulkanDescriptorSetCache* setCache)
+{
+    VulkanDescriptorFactory builder;
+    builder.m_cache = layoutCache;
+    builder.m_device = setCache->getDevice();
+    builder.m_setCache = setCache;
+    return builder;
+}
+
 VulkanDescriptorFactory& VulkanDescriptorFactory::bindBuffer(uint32_t binding,VkDescriptorBufferInfo* bufferInfo,VkDescriptorType type,VkShaderStageFlags stageFlags)
 {
     VkDescriptorSetLayoutBinding newBinding{};
@@ -266,46 +419,100 @@ VulkanDescriptorFactory& VulkanDescriptorFactory::bindImages(uint32_t binding,ui
     return *this;
 }
 
-bool VulkanDescriptorFactory::build(VulkanDescriptorSetReference& set,VulkanDescriptorLayoutReference& layout)
+VkDescriptorSetLayout VulkanDescriptorFactory::createLayout(VkDescriptorSetLayoutCreateFlags flags)
 {
     // VkDescriptorSetLayout浽Cache
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.pNext = nullptr;
+    layoutInfo.flags = flags;
     layoutInfo.pBindings = m_bindings.data();
     layoutInfo.bindingCount = static_cast<uint32_t>(m_bindings.size());
-    layout.layout = m_cache->createDescriptorLayout(&layoutInfo);
-    bool success = m_allocator->allocate(&set.set,layout.layout);
-
-    if(!success)
-    {
-        return false;
-    };
+    return m_cache->createDescriptorLayout(&layoutInfo);
+}
 
-    std::vector<VkWriteDescriptorSet> writes{};
+void VulkanDescriptorFactory::collectWrites(VkDescriptorSet set,std::vector<VkWriteDescriptorSet>& writes) const
+{
+    writes.reserve(m_descriptorWriteBufInfos.size());
     for(auto& dc : m_descriptorWriteBufInfos)
     {
         VkWriteDescriptorSet newWrite{};
         newWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         newWrite.pNext = nullptr;
         newWrite.descriptorCount = dc.count;
-
         newWrite.descriptorType = dc.type;
 
         if(dc.isImg)
+        {
             newWrite.pImageInfo = dc.imgInfo;
+        }
         else
+        {
             newWrite.pBufferInfo = dc.bufInfo;
+        }
 
         newWrite.dstBinding = dc.binding;
-        newWrite.dstSet = set.set;
+        newWrite.dstSet = set;
         writes.push_back(newWrite);
     }
+}
+
+VulkanDescriptorSetCache::Key VulkanDescriptorFactory::makeCacheKey(VkDescriptorSetLayout layout) const
+{
+    VulkanDescriptorSetCache::Key key { };
+    key.layout = layout;
+    for(const auto& dc : m_descriptorWriteBufInfos)
+    {
+        key.words.push_back(uint64(dc.binding) | uint64(dc.type) << 32);
+        for(uint32 i = 0; i < dc.count; i++)
+        {
+            if(dc.isImg)
+            {
+                key.words.push_back((uint64)dc.imgInfo[i].imageView);
+                key.words.push_back((uint64)dc.imgInfo[i].sampler);
+                key.words.push_back((uint64)dc.imgInfo[i].imageLayout);
+            }
+            else
+            {
+                key.words.push_back((uint64)dc.bufInfo[i].buffer);
+                key.words.push_back((uint64)dc.bufInfo[i].offset);
+                key.words.push_back((uint64)dc.bufInfo[i].range);
+            }
+        }
+    }
+    return key;
+}
+
+bool VulkanDescriptorFactory::allocateAndWrite(VkDescriptorSet* set,VkDescriptorSetLayout layout)
+{
+    const auto write = [&](VkDescriptorSet newSet)
+    {
+        std::vector<VkWriteDescriptorSet> writes{};
+        collectWrites(newSet,writes);
+        vkUpdateDescriptorSets(*m_device,static_cast<uint32_t>(writes.size()),writes.data(),0,nullptr);
+    };
+
+    if(m_setCache != nullptr)
+    {
+        return m_setCache->getOrCreate(makeCacheKey(layout),write,set);
+    }
+
+    const bool success = m_frameAllocator != nullptr ? m_frameAllocator->allocate(set,layout) : m_allocator->allocate(set,layout);
+    if(!success)
+    {
+        return false;
+    }
 
-    vkUpdateDescriptorSets(*m_allocator->m_device,static_cast<uint32_t>(writes.size()),writes.data(),0,nullptr);
+    write(*set);
     return true;
 }
 
+bool VulkanDescriptorFactory::build(VulkanDescriptorSetReference& set,VulkanDescriptorLayoutReference& layout)
+{
+    layout.layout = createLayout(0);
+    return allocateAndWrite(&set.set,layout.layout);
+}
+
 bool VulkanDescriptorFactory::build(VulkanDescriptorSetReference& set)
 {
     // layoutCacheл沢ͳһ
@@ -315,51 +522,31 @@ bool VulkanDescriptorFactory::build(VulkanDescriptorSetReference& set)
 
 bool VulkanDescriptorFactory::build(VkDescriptorSet* set)
 {
-    VulkanDescriptorLayoutReference layout;
-    // VkDescriptorSetLayout浽Cache
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.pNext = nullptr;
-    layoutInfo.pBindings = m_bindings.data();
-    layoutInfo.bindingCount = static_cast<uint32_t>(m_bindings.size());
-    layout.layout = m_cache->createDescriptorLayout(&layoutInfo);
-    bool success = m_allocator->allocate(set,layout.layout);
-
-    if(!success)
-    {
-        return false;
-    };
-
-    std::vector<VkWriteDescriptorSet> writes{};
-    for(auto& dc : m_descriptorWriteBufInfos)
-    {
-        VkWriteDescriptorSet newWrite{};
-        newWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        newWrite.pNext = nullptr;
-        newWrite.descriptorCount = dc.count;
-        newWrite.descriptorType = dc.type;
+    return allocateAndWrite(set,createLayout(0));
+}
 
-        if(dc.isImg)
-        {
-            newWrite.pImageInfo = dc.imgInfo;
-        }
-        else
-        {
-            newWrite.pBufferInfo = dc.bufInfo;
-        }
+void VulkanDescriptorFactory::buildLayout(VulkanDescriptorLayoutReference& layout,bool bPushDescriptor)
+{
+    layout.layout = createLayout(bPushDescriptor ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0);
+}
 
-        newWrite.dstBinding = dc.binding;
-        newWrite.dstSet = *set;
-        writes.push_back(newWrite);
-    }
+void VulkanDescriptorFactory::push(VkCommandBuffer cmd,VkPipelineBindPoint bindPoint,VkPipelineLayout pipelineLayout,uint32 setIndex)
+{
+    CHECK(m_device->vkCmdPushDescriptorSet != nullptr);
 
-    vkUpdateDescriptorSets(*m_allocator->m_device,static_cast<uint32_t>(writes.size()),writes.data(),0,nullptr);
-    return true;
+    std::vector<VkWriteDescriptorSet> writes{};
+    collectWrites(VK_NULL_HANDLE,writes);
+    m_device->vkCmdPushDescriptorSet(cmd,bindPoint,pipelineLayout,setIndex,static_cast<uint32_t>(writes.size()),writes.data());
 }
 
 // صĵȺCacheеĹϣ
 bool VulkanDescriptorLayoutCache::DescriptorLayoutInfo::operator==(const DescriptorLayoutInfo& other) const
 {
+    if(other.flags != flags)
+    {
+        return false;
+    }
+
     if(other.bindings.size() != bindings.size())
     {
         // bindingĿֱͬӷ
@@ -396,7 +583,7 @@ size_t VulkanDescriptorLayoutCache::DescriptorLayoutInfo::hash() const
     using std::size_t;
     using std::hash;
 
-    size_t result = hash<size_t>()(bindings.size());
+    size_t result = hash<size_t>()(bindings.size()) ^ hash<size_t>()(flags);
 
     for(const VkDescriptorSetLayoutBinding& b:bindings)
     {
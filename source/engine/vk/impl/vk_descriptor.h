@@ -1,5 +1,7 @@
 #pragma once
 #include "vk_device.h"
+#include <functional>
+#include <unordered_map>
 
 namespace engine{
 
@@ -38,12 +40,20 @@ public:
         };
     };
 
+    struct Stats
+    {
+        uint32 setCount = 0; // sets allocated since the last reset.
+        uint32 usedPoolCount = 0;
+        uint32 freePoolCount = 0;
+    };
+
 private:
     VulkanDevice* m_device;
     VkDescriptorPool m_currentPool = VK_NULL_HANDLE;
     PoolSizes m_descriptorSizes;
     std::vector<VkDescriptorPool> m_usedPools;
     std::vector<VkDescriptorPool> m_freePools;
+    uint32 m_setCount = 0;
 
     // ȡ
     VkDescriptorPool requestPool();
@@ -59,6 +69,93 @@ public:
 
     // е
     void cleanup();
+
+    // NOTE: Hands the used pools over without resetting them, sets in them may still be in flight.
+    //       They come back through recyclePools once they are not.
+    std::vector<VkDescriptorPool> releaseUsedPools();
+    void recyclePools(const std::vector<VkDescriptorPool>& pools);
+
+    Stats getStats() const { return { m_setCount,(uint32)m_usedPools.size(),(uint32)m_freePools.size() }; }
+    VulkanDevice* getDevice() const { return m_device; }
+};
+
+// NOTE: Linear allocator for sets that only live one frame, one allocator per frame in flight. Sets are
+//       never freed one by one, the allocator of a frame is reset as a whole once its fence signaled.
+//       Passes record on several threads so allocation takes a lock.
+class VulkanFrameDescriptorAllocator
+{
+public:
+    void init(VulkanDevice* device,uint32 frameCount);
+    void cleanup();
+
+    // NOTE: Call after the fence of frameIndex was waited, every set allocated in that frame is gone then.
+    void beginFrame(uint32 frameIndex);
+
+    [[nodiscard]]bool allocate(VkDescriptorSet* set,VkDescriptorSetLayout layout);
+
+    // Usage of the last frame that was reset, the frame recording now is still growing.
+    VulkanDescriptorAllocator::Stats getStats() const;
+    VulkanDevice* getDevice() const { return m_device; }
+
+private:
+    VulkanDevice* m_device = nullptr;
+    std::vector<VulkanDescriptorAllocator> m_allocators = {};
+    uint32 m_frameIndex = 0;
+    VulkanDescriptorAllocator::Stats m_lastFrameStats = {};
+    mutable std::mutex m_mutex;
+};
+
+// NOTE: Sets that are written once and never change, shared by everyone binding the same resources through
+//       the same layout. The key holds the raw handles of every descriptor, so it must be cleared whenever
+//       the resources behind them are recreated or a new object could alias an old handle.
+class VulkanDescriptorSetCache
+{
+public:
+    struct Key
+    {
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+        std::vector<uint64> words = {};
+
+        bool operator==(const Key& other) const { return layout == other.layout && words == other.words; }
+        size_t hash() const;
+    };
+
+    struct Stats
+    {
+        uint32 setCount = 0;
+        uint32 poolCount = 0;
+        uint64 hitCount = 0;
+        uint64 missCount = 0;
+    };
+
+    void init(VulkanDevice* device);
+    void cleanup();
+
+    // Existing set of key, or a new one written by write. False when allocation failed.
+    [[nodiscard]]bool getOrCreate(const Key& key,const std::function<void(VkDescriptorSet)>& write,VkDescriptorSet* set);
+
+    // NOTE: Forgets every set and returns their pools, give them back through recyclePools when the
+    //       frames in flight are done with them.
+    std::vector<VkDescriptorPool> clear();
+    void recyclePools(const std::vector<VkDescriptorPool>& pools);
+
+    Stats getStats() const;
+    VulkanDevice* getDevice() const { return m_allocator.getDevice(); }
+
+private:
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& k) const
+        {
+            return k.hash();
+        }
+    };
+
+    VulkanDescriptorAllocator m_allocator = {};
+    std::unordered_map<Key,VkDescriptorSet,KeyHash> m_sets = {};
+    uint64 m_hitCount = 0;
+    uint64 m_missCount = 0;
+    mutable std::mutex m_mutex;
 };
 
 class VulkanDescriptorLayoutCache
@@ -67,6 +164,7 @@ public:
     struct DescriptorLayoutInfo
     {
         std::vector<VkDescriptorSetLayoutBinding> bindings;
+        VkDescriptorSetLayoutCreateFlags flags = 0;
         bool operator==(const DescriptorLayoutInfo& other) const;
         size_t hash() const;
     };
@@ -97,6 +195,8 @@ class VulkanDescriptorFactory
 public:
     // һĹ
     static VulkanDescriptorFactory begin(VulkanDescriptorLayoutCache* layoutCache,VulkanDescriptorAllocator* allocator);
+    static VulkanDescriptorFactory begin(VulkanDescriptorLayoutCache* layoutCache,VulkanFrameDescriptorAllocator* allocator);
+    static VulkanDescriptorFactory begin(VulkanDescriptorLayoutCache* layoutCache,VulkanDescriptorSetCache* setCache);
 
     VulkanDescriptorFactory& bindBuffer(uint32_t binding,VkDescriptorBufferInfo* bufferInfo,VkDescriptorType type,VkShaderStageFlags stageFlags);
     VulkanDescriptorFactory& bindImage(uint32_t binding,VkDescriptorImageInfo*,VkDescriptorType type,VkShaderStageFlags stageFlags);
@@ -104,6 +204,15 @@ public:
     bool build(VulkanDescriptorSetReference& set,VulkanDescriptorLayoutReference& layout);
     bool build(VulkanDescriptorSetReference& set);
     bool build(VkDescriptorSet* set);
+
+    // NOTE: Layout only, no set is allocated. Push descriptor layouts are what push expects, the written
+    //       infos may be null here.
+    void buildLayout(VulkanDescriptorLayoutReference& layout,bool bPushDescriptor = false);
+
+    // NOTE: Writes the bindings straight into cmd through VK_KHR_push_descriptor, setIndex of pipelineLayout
+    //       must use a layout built with bPushDescriptor.
+    void push(VkCommandBuffer cmd,VkPipelineBindPoint bindPoint,VkPipelineLayout pipelineLayout,uint32 setIndex);
+
 private:
     struct DescriptorWriteContainer
     {
@@ -115,11 +224,21 @@ private:
         bool isImg = false;
     };
 
+    VkDescriptorSetLayout createLayout(VkDescriptorSetLayoutCreateFlags flags);
+    bool allocateAndWrite(VkDescriptorSet* set,VkDescriptorSetLayout layout);
+    void collectWrites(VkDescriptorSet set,std::vector<VkWriteDescriptorSet>& writes) const;
+    VulkanDescriptorSetCache::Key makeCacheKey(VkDescriptorSetLayout layout) const;
+
     std::vector<DescriptorWriteContainer> m_descriptorWriteBufInfos{ };
     std::vector<VkDescriptorSetLayoutBinding> m_bindings;
 
     VulkanDescriptorLayoutCache* m_cache;
-    VulkanDescriptorAllocator* m_allocator;
+    VulkanDevice* m_device = nullptr;
+
+    // Exactly one of them is set by begin.
+    VulkanDescriptorAllocator* m_allocator = nullptr;
+    VulkanFrameDescriptorAllocator* m_frameAllocator = nullptr;
+    VulkanDescriptorSetCache* m_setCache = nullptr;
 };
 
 }
\ No newline at end of file
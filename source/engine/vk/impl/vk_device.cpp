@@ -1,5 +1,6 @@
 #include "vk_device.h"
 #include <set>
+#include <cstring>
 
 namespace engine{
 
@@ -8,7 +9,9 @@ void VulkanDevice::init(
 	VkSurfaceKHR surface,
 	VkPhysicalDeviceFeatures features,
 	const std::vector<const char*>& device_request_extens,
-	void* nextChain)
+	void* nextChain,
+	const std::vector<const char*>& device_optional_extens,
+	VkPhysicalDeviceFeatures optionalFeatures)
 {
 	this->m_instance = instance;
 	this->m_surface = surface;
@@ -19,10 +22,49 @@ void VulkanDevice::init(
 
 	// 2. ߼豸
 	this->m_deviceExtensions = device_request_extens;
+	for(const char* extension : device_optional_extens)
+	{
+		// Optional extensions don't take part in picking the gpu, they are enabled when the picked one has them.
+		if(checkDeviceExtensionSupport({ extension }))
+		{
+			this->m_deviceExtensions.push_back(extension);
+		}
+		else
+		{
+			LOG_GRAPHICS_INFO("Optional device extension {0} is not supported.",extension);
+		}
+	}
+
+	// Optional features are enabled when the picked gpu has them, device creation fails on the others.
+	VkPhysicalDeviceFeatures supportedFeatures = {};
+	vkGetPhysicalDeviceFeatures(physicalDevice,&supportedFeatures);
+	const VkBool32* supported = reinterpret_cast<const VkBool32*>(&supportedFeatures);
+	const VkBool32* optional = reinterpret_cast<const VkBool32*>(&optionalFeatures);
+	VkBool32* enabled = reinterpret_cast<VkBool32*>(&features);
+	for(size_t i = 0; i < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); i++)
+	{
+		if(optional[i] == VK_TRUE && supported[i] == VK_TRUE)
+		{
+			enabled[i] = VK_TRUE;
+		}
+	}
+
 	this->m_openFeatures = features;
 	createLogicDevice();
 }
 
+bool VulkanDevice::isExtensionEnabled(const char* name) const
+{
+	for(const char* extension : m_deviceExtensions)
+	{
+		if(strcmp(extension,name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 void VulkanDevice::destroy()
 {
 	if (device != VK_NULL_HANDLE)
@@ -40,6 +82,12 @@ void VulkanDevice::createLogicDevice()
 	computeFamily  = indices.computeFaimly;
 	copyFamily = indices.graphicsFamily;
 
+	sharedFamilies.clear();
+	if(computeFamily != graphicsFamily)
+	{
+		sharedFamilies = { graphicsFamily,computeFamily };
+	}
+
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
 	// ȷPresentλһ
@@ -114,6 +162,11 @@ void VulkanDevice::createLogicDevice()
 		LOG_GRAPHICS_FATAL("Create vulkan logic device.");
 	}
 
+	if(isExtensionEnabled(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME))
+	{
+		vkCmdPushDescriptorSet = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(vkGetDeviceProcAddr(device,"vkCmdPushDescriptorSetKHR"));
+	}
+
 	// ȡ
 	vkGetDeviceQueue(device,indices.graphicsFamily,0, &graphicsQueue);
 	vkGetDeviceQueue(device,indices.computeFaimly, 0, &computeQueue);
@@ -65,11 +65,17 @@ public:
 	uint32_t copyFamily;
 	uint32_t computeFamily;
 
+	// Families persistent images and buffers are shared by, empty when compute runs on the graphics family.
+	std::vector<uint32_t> sharedFamilies;
+
 	// ʣĶ
 	std::vector<AsyncQueue> asyncTransferQueues;    // пõĴ 
 	std::vector<AsyncQueue> asyncComputeQueues;     // пõļ
 	std::vector<AsyncQueue> asyncGraphicsQueues;    // пõͼζ
 
+	// Loaded when VK_KHR_push_descriptor is enabled, null otherwise.
+	PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSet = nullptr;
+
 private:
 	VkInstance m_instance = VK_NULL_HANDLE;
 	VkSurfaceKHR m_surface = VK_NULL_HANDLE;
@@ -87,15 +93,28 @@ public:
 		VkSurfaceKHR surface,
 		VkPhysicalDeviceFeatures features = {},
 		const std::vector<const char*>& device_request_extens= {},
-		void* nextChain = nullptr
+		void* nextChain = nullptr,
+		const std::vector<const char*>& device_optional_extens = {},
+		VkPhysicalDeviceFeatures optionalFeatures = {}
 	);
 
 	void destroy();
 	VulkanQueueFamilyIndices findQueueFamilies();
+
+	// NOTE: Resources used on both the graphics and the async compute queue are created concurrent, so they
+	//       don't need an ownership transfer every time they change queue.
+	template<typename CreateInfo>
+	void setSharingMode(CreateInfo& info) const
+	{
+		info.sharingMode = sharedFamilies.empty() ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT;
+		info.queueFamilyIndexCount = (uint32_t)sharedFamilies.size();
+		info.pQueueFamilyIndices = sharedFamilies.empty() ? nullptr : sharedFamilies.data();
+	}
 	uint32 findMemoryType(uint32 typeFilter,VkMemoryPropertyFlags properties);
 	VulkanSwapchainSupportDetails querySwapchainSupportDetail();
 	void printAllQueueFamiliesInfo();
 	const auto& getDeviceExtensions() const { return m_deviceExtensions; }
+	bool isExtensionEnabled(const char* name) const;
 	const auto& getDeviceFeatures()   const { return m_openFeatures; }
 
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates,VkImageTiling tiling,VkFormatFeatureFlags features);
@@ -1,4 +1,5 @@
 #include "vk_factory.h"
+#include "../vk_rhi.h"
 
 using namespace engine;
 
@@ -56,16 +57,8 @@ VkPipeline engine::VulkanGraphicsPipelineFactory::buildMeshDrawPipeline(VkDevice
     dynamicState.dynamicStateCount = (uint32_t)dynamicStates.size();
     pipelineInfo.pDynamicState = &dynamicState;
 
-    VkPipeline newPipeline;
-    if(vkCreateGraphicsPipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&newPipeline) != VK_SUCCESS)
-    {
-        LOG_GRAPHICS_FATAL("Fail to create graphics pipeline!");
-        return VK_NULL_HANDLE;
-    }
-    else
-    {
-        return newPipeline;
-    }
+    // NOTE: Equal pipelines, like the ones built for every back buffer, share one handle.
+    return VulkanRHI::get()->createGraphicsPipeline(pipelineInfo);
 }
 
 VkPipeline engine::VulkanGraphicsPipelineFactory::buildMeshDrawPipeline(VkDevice device,VkRenderPass pass,VkPipelineColorBlendStateCreateInfo cb)
@@ -119,14 +112,6 @@ VkPipeline engine::VulkanGraphicsPipelineFactory::buildMeshDrawPipeline(VkDevice
     dynamicState.dynamicStateCount = (uint32_t)dynamicStates.size();
     pipelineInfo.pDynamicState = &dynamicState;
 
-    VkPipeline newPipeline;
-    if(vkCreateGraphicsPipelines(device,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&newPipeline) != VK_SUCCESS)
-    {
-        LOG_GRAPHICS_FATAL("Fail to create graphics pipeline!");
-        return VK_NULL_HANDLE;
-    }
-    else
-    {
-        return newPipeline;
-    }
+    // NOTE: Equal pipelines, like the ones built for every back buffer, share one handle.
+    return VulkanRHI::get()->createGraphicsPipeline(pipelineInfo);
 }
@@ -345,7 +345,11 @@ void VulkanImage::create(
     this->m_size = memRequirements.size;
 
     static const auto* cVarUseVma = CVarSystem::get()->getInt32CVar("r.RHI.EnableVma");
-    if(*cVarUseVma != 0)
+    if(m_aliasAllocation != nullptr)
+    {
+        vkCheck(vmaBindImageMemory2(VulkanRHI::get()->getVmaAllocator(),m_aliasAllocation,0,m_image,nullptr));
+    }
+    else if(*cVarUseVma != 0)
     {
         VmaAllocationCreateInfo vmaAllocInfo = {};
 
@@ -484,9 +488,7 @@ DepthStencilImage* DepthStencilImage::create(VulkanDevice* device,uint32_t width
     info.samples = VK_SAMPLE_COUNT_1_BIT;
     info.tiling = VK_IMAGE_TILING_OPTIMAL;
     info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    info.queueFamilyIndexCount = 0;
-    info.pQueueFamilyIndices = nullptr;
+    device->setSharingMode(info);
     info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     ret->VulkanImage::create(device, info,viewType, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, false);
 
@@ -535,9 +537,7 @@ DepthOnlyImage* DepthOnlyImage::create(VulkanDevice* device,uint32_t width,uint3
     info.samples = VK_SAMPLE_COUNT_1_BIT;
     info.tiling = VK_IMAGE_TILING_OPTIMAL;
     info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    info.queueFamilyIndexCount = 0;
-    info.pQueueFamilyIndices = nullptr;
+    device->setSharingMode(info);
     info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     ret->VulkanImage::create(device, info,viewType,  VK_IMAGE_ASPECT_DEPTH_BIT, false);
 
@@ -560,10 +560,10 @@ DepthOnlyTextureArray* DepthOnlyTextureArray::create(VulkanDevice* device,uint32
     info.arrayLayers = layerCount; // Padding texture array layers here.
     info.samples = VK_SAMPLE_COUNT_1_BIT;
     info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    info.queueFamilyIndexCount = 0;
-    info.pQueueFamilyIndices = nullptr;
+
+    // Transfer for the cascade shadow cache copies.
+    info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    device->setSharingMode(info);
     info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     // All layer views will be create here.
@@ -609,18 +609,17 @@ RenderTexture* RenderTexture::create(VulkanDevice* device,uint32_t width,uint32_
     info.samples = VK_SAMPLE_COUNT_1_BIT;
     info.tiling = VK_IMAGE_TILING_OPTIMAL;
     info.usage = usage;
-    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    info.queueFamilyIndexCount = 0;
-    info.pQueueFamilyIndices = nullptr;
+    device->setSharingMode(info);
     info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     ret->VulkanImage::create(device, info,VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, false);
 
     return ret;
 }
 
-RenderTexture* RenderTexture::create(VulkanDevice* device,uint32_t width,uint32_t height,uint32_t mipmapCount,bool bCreateMipmaps,VkFormat format,VkImageUsageFlags usage)
+RenderTexture* RenderTexture::create(VulkanDevice* device,uint32_t width,uint32_t height,uint32_t mipmapCount,bool bCreateMipmaps,VkFormat format,VkImageUsageFlags usage,VmaAllocation aliasAllocation)
 {
     RenderTexture* ret = new RenderTexture();
+    ret->m_aliasAllocation = aliasAllocation;
 
     VkImageCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -635,9 +634,7 @@ RenderTexture* RenderTexture::create(VulkanDevice* device,uint32_t width,uint32_
     info.samples = VK_SAMPLE_COUNT_1_BIT;
     info.tiling = VK_IMAGE_TILING_OPTIMAL;
     info.usage = usage;
-    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    info.queueFamilyIndexCount = 0;
-    info.pQueueFamilyIndices = nullptr;
+    device->setSharingMode(info);
     info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     ret->VulkanImage::create(device, info,VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, false);
 
@@ -18,6 +18,9 @@ namespace engine{
         VkDeviceSize m_size = {};
         VkImageLayout m_currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         VkImageCreateInfo m_createInfo = {};
+
+        // NOTE: Memory owned by someone else, the image is bound to it at offset zero and never frees it.
+        VmaAllocation m_aliasAllocation = nullptr;
     public:
         VulkanImage() = default;
 
@@ -44,6 +47,7 @@ namespace engine{
         VkExtent3D getExtent() const { return m_createInfo.extent; }
         const VkImageCreateInfo& getInfo() const { return m_createInfo; }
         VkImageLayout getCurentLayout() const { return m_currentLayout; }
+        VkDeviceSize getSize() const { return m_size; }
         void clear(VkCommandBuffer cb, glm::vec4 colour = {0, 0, 0, 0});
         void upload(std::vector<uint8>& bytes,VkCommandPool pool,VkQueue queue,VkImageAspectFlagBits flag = VK_IMAGE_ASPECT_COLOR_BIT);
         void release();
@@ -163,7 +167,7 @@ namespace engine{
         }
 
         static RenderTexture* create(VulkanDevice*device,uint32_t width,uint32_t height,VkFormat format,VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-        static RenderTexture* create(VulkanDevice*device,uint32_t width,uint32_t height,uint32_t mipmapCount,bool bCreateMipmaps,VkFormat format,VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+        static RenderTexture* create(VulkanDevice*device,uint32_t width,uint32_t height,uint32_t mipmapCount,bool bCreateMipmaps,VkFormat format,VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,VmaAllocation aliasAllocation = nullptr);
        
         VkImageView getMipmapView(uint32 level);
     };
@@ -0,0 +1,475 @@
+#include "vk_pipeline.h"
+#include <filesystem>
+#include <fstream>
+
+namespace engine{
+
+// Header every VK_PIPELINE_CACHE_HEADER_VERSION_ONE cache starts with.
+struct PipelineCacheHeader
+{
+	uint32 headerSize;
+	uint32 headerVersion;
+	uint32 vendorID;
+	uint32 deviceID;
+	uint8 pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+template<typename T>
+static void writeValue(std::string& key,const T& value)
+{
+	key.append(reinterpret_cast<const char*>(&value),sizeof(T));
+}
+
+void VulkanPipelineRegistry::init(VulkanDevice* device,VulkanShaderCache* shaderCache,const std::string& cachePath)
+{
+	m_device = device;
+	m_shaderCache = shaderCache;
+	m_cachePath = cachePath;
+	m_stats = {};
+
+	std::vector<uint8> data;
+	if(loadPipelineCache(data))
+	{
+		m_stats.loadedCacheSize = data.size();
+	}
+	else
+	{
+		data.clear();
+	}
+
+	VkPipelineCacheCreateInfo info { };
+	info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	info.initialDataSize = data.size();
+	info.pInitialData = data.empty() ? nullptr : data.data();
+	vkCheck(vkCreatePipelineCache(*m_device,&info,nullptr,&m_pipelineCache));
+
+	LOG_INFO("Pipeline cache {0} loaded {1} bytes.",m_cachePath,m_stats.loadedCacheSize);
+}
+
+void VulkanPipelineRegistry::release()
+{
+	if(m_pipelineCache == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	if(!m_pipelines.empty() || !m_layouts.empty())
+	{
+		LOG_WARN("Pipeline registry released with {0} pipelines and {1} layouts still referenced.",m_pipelines.size(),m_layouts.size());
+	}
+	for(auto& pair : m_pipelines)
+	{
+		vkDestroyPipeline(*m_device,pair.second.handle,nullptr);
+	}
+	for(auto& pair : m_layouts)
+	{
+		vkDestroyPipelineLayout(*m_device,pair.second.handle,nullptr);
+	}
+	m_pipelines.clear();
+	m_pipelineKeys.clear();
+	m_layouts.clear();
+	m_layoutKeys.clear();
+
+	LOG_INFO("Pipeline registry built {0} pipelines and reused {1}.",m_stats.createdPipelines,m_stats.reusedPipelines);
+
+	savePipelineCache();
+	vkDestroyPipelineCache(*m_device,m_pipelineCache,nullptr);
+	m_pipelineCache = VK_NULL_HANDLE;
+}
+
+VkPipelineLayout VulkanPipelineRegistry::createPipelineLayout(const VkPipelineLayoutCreateInfo& info)
+{
+	std::lock_guard lock(m_mutex);
+	return acquire(m_layouts,m_layoutKeys,makeKey(info),[&]()
+	{
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		vkCheck(vkCreatePipelineLayout(*m_device,&info,nullptr,&layout));
+		return layout;
+	});
+}
+
+VkPipeline VulkanPipelineRegistry::createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& info)
+{
+	std::lock_guard lock(m_mutex);
+	return acquire(m_pipelines,m_pipelineKeys,makeKey(info),[&]()
+	{
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		if(vkCreateGraphicsPipelines(*m_device,m_pipelineCache,1,&info,nullptr,&pipeline) != VK_SUCCESS)
+		{
+			LOG_GRAPHICS_FATAL("Fail to create graphics pipeline!");
+			return (VkPipeline)VK_NULL_HANDLE;
+		}
+		return pipeline;
+	});
+}
+
+VkPipeline VulkanPipelineRegistry::createComputePipeline(const VkComputePipelineCreateInfo& info)
+{
+	std::lock_guard lock(m_mutex);
+	return acquire(m_pipelines,m_pipelineKeys,makeKey(info),[&]()
+	{
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		vkCheck(vkCreateComputePipelines(*m_device,m_pipelineCache,1,&info,nullptr,&pipeline));
+		return pipeline;
+	});
+}
+
+bool VulkanPipelineRegistry::releasePipelineLayout(VkPipelineLayout layout)
+{
+	std::lock_guard lock(m_mutex);
+	return releaseHandle(m_layouts,m_layoutKeys,layout);
+}
+
+bool VulkanPipelineRegistry::releasePipeline(VkPipeline pipeline)
+{
+	std::lock_guard lock(m_mutex);
+	return releaseHandle(m_pipelines,m_pipelineKeys,pipeline);
+}
+
+template<typename Handle,typename Create>
+Handle VulkanPipelineRegistry::acquire(std::unordered_map<Key,Entry<Handle>>& entries,std::unordered_map<Handle,Key>& keys,Key&& key,Create&& create)
+{
+	auto it = entries.find(key);
+	if(it != entries.end())
+	{
+		it->second.refCount++;
+		if constexpr(std::is_same_v<Handle,VkPipeline>)
+		{
+			m_stats.reusedPipelines++;
+		}
+		return it->second.handle;
+	}
+
+	Handle handle = create();
+	if(handle == VK_NULL_HANDLE)
+	{
+		return handle;
+	}
+
+	keys[handle] = key;
+	entries[std::move(key)] = { handle,1 };
+	if constexpr(std::is_same_v<Handle,VkPipeline>)
+	{
+		m_stats.createdPipelines++;
+		m_stats.pipelineCount = (uint32)entries.size();
+	}
+	else
+	{
+		m_stats.layoutCount = (uint32)entries.size();
+	}
+	return handle;
+}
+
+// NOTE: Handles which were not created by the registry are always handed back for destruction.
+template<typename Handle>
+bool VulkanPipelineRegistry::releaseHandle(std::unordered_map<Key,Entry<Handle>>& entries,std::unordered_map<Handle,Key>& keys,Handle handle)
+{
+	if(handle == VK_NULL_HANDLE)
+	{
+		return false;
+	}
+
+	auto keyIt = keys.find(handle);
+	if(keyIt == keys.end())
+	{
+		return true;
+	}
+
+	auto it = entries.find(keyIt->second);
+	CHECK(it != entries.end() && it->second.refCount > 0);
+	bool bLastReference = false;
+	if(--it->second.refCount == 0)
+	{
+		entries.erase(it);
+		keys.erase(keyIt);
+		bLastReference = true;
+	}
+
+	m_stats.pipelineCount = (uint32)m_pipelines.size();
+	m_stats.layoutCount = (uint32)m_layouts.size();
+	return bLastReference;
+}
+
+VulkanPipelineRegistry::Key VulkanPipelineRegistry::makeKey(const VkPipelineLayoutCreateInfo& info) const
+{
+	Key key;
+	writeValue(key,info.flags);
+	writeValue(key,info.setLayoutCount);
+	for(uint32 i = 0; i < info.setLayoutCount; i++)
+	{
+		// Set layouts come from the descriptor layout cache, equal layouts share one handle.
+		writeValue(key,info.pSetLayouts[i]);
+	}
+	writeValue(key,info.pushConstantRangeCount);
+	for(uint32 i = 0; i < info.pushConstantRangeCount; i++)
+	{
+		writeValue(key,info.pPushConstantRanges[i].stageFlags);
+		writeValue(key,info.pPushConstantRanges[i].offset);
+		writeValue(key,info.pPushConstantRanges[i].size);
+	}
+	return key;
+}
+
+void VulkanPipelineRegistry::writeStage(Key& key,const VkPipelineShaderStageCreateInfo& stage) const
+{
+	writeValue(key,stage.flags);
+	writeValue(key,stage.stage);
+
+	const uint64 codeHash = m_shaderCache->findCodeHash(stage.module);
+	if(codeHash != 0)
+	{
+		writeValue(key,codeHash);
+	}
+	else
+	{
+		writeValue(key,stage.module);
+	}
+	key.append(stage.pName != nullptr ? stage.pName : "");
+	key.push_back('\0');
+
+	const VkSpecializationInfo* spec = stage.pSpecializationInfo;
+	writeValue(key,spec != nullptr ? spec->mapEntryCount : 0u);
+	if(spec != nullptr)
+	{
+		for(uint32 i = 0; i < spec->mapEntryCount; i++)
+		{
+			writeValue(key,spec->pMapEntries[i].constantID);
+			writeValue(key,spec->pMapEntries[i].offset);
+			writeValue(key,spec->pMapEntries[i].size);
+		}
+		writeValue(key,spec->dataSize);
+		key.append(reinterpret_cast<const char*>(spec->pData),spec->dataSize);
+	}
+}
+
+VulkanPipelineRegistry::Key VulkanPipelineRegistry::makeKey(const VkComputePipelineCreateInfo& info) const
+{
+	Key key = "C";
+	writeValue(key,info.flags);
+	writeStage(key,info.stage);
+	writeValue(key,info.layout);
+	return key;
+}
+
+// NOTE: pNext chains are not part of the key, none of the engine pipelines use one.
+VulkanPipelineRegistry::Key VulkanPipelineRegistry::makeKey(const VkGraphicsPipelineCreateInfo& info) const
+{
+	Key key = "G";
+	writeValue(key,info.flags);
+	writeValue(key,info.stageCount);
+	for(uint32 i = 0; i < info.stageCount; i++)
+	{
+		writeStage(key,info.pStages[i]);
+	}
+
+	if(const auto* vertexInput = info.pVertexInputState)
+	{
+		writeValue(key,vertexInput->vertexBindingDescriptionCount);
+		for(uint32 i = 0; i < vertexInput->vertexBindingDescriptionCount; i++)
+		{
+			writeValue(key,vertexInput->pVertexBindingDescriptions[i].binding);
+			writeValue(key,vertexInput->pVertexBindingDescriptions[i].stride);
+			writeValue(key,vertexInput->pVertexBindingDescriptions[i].inputRate);
+		}
+		writeValue(key,vertexInput->vertexAttributeDescriptionCount);
+		for(uint32 i = 0; i < vertexInput->vertexAttributeDescriptionCount; i++)
+		{
+			writeValue(key,vertexInput->pVertexAttributeDescriptions[i].location);
+			writeValue(key,vertexInput->pVertexAttributeDescriptions[i].binding);
+			writeValue(key,vertexInput->pVertexAttributeDescriptions[i].format);
+			writeValue(key,vertexInput->pVertexAttributeDescriptions[i].offset);
+		}
+	}
+
+	if(const auto* inputAssembly = info.pInputAssemblyState)
+	{
+		writeValue(key,inputAssembly->topology);
+		writeValue(key,inputAssembly->primitiveRestartEnable);
+	}
+
+	if(const auto* tessellation = info.pTessellationState)
+	{
+		writeValue(key,tessellation->patchControlPoints);
+	}
+
+	if(const auto* viewport = info.pViewportState)
+	{
+		writeValue(key,viewport->viewportCount);
+		for(uint32 i = 0; viewport->pViewports != nullptr && i < viewport->viewportCount; i++)
+		{
+			writeValue(key,viewport->pViewports[i].x);
+			writeValue(key,viewport->pViewports[i].y);
+			writeValue(key,viewport->pViewports[i].width);
+			writeValue(key,viewport->pViewports[i].height);
+			writeValue(key,viewport->pViewports[i].minDepth);
+			writeValue(key,viewport->pViewports[i].maxDepth);
+		}
+		writeValue(key,viewport->scissorCount);
+		for(uint32 i = 0; viewport->pScissors != nullptr && i < viewport->scissorCount; i++)
+		{
+			writeValue(key,viewport->pScissors[i].offset.x);
+			writeValue(key,viewport->pScissors[i].offset.y);
+			writeValue(key,viewport->pScissors[i].extent.width);
+			writeValue(key,viewport->pScissors[i].extent.height);
+		}
+	}
+
+	if(const auto* raster = info.pRasterizationState)
+	{
+		writeValue(key,raster->depthClampEnable);
+		writeValue(key,raster->rasterizerDiscardEnable);
+		writeValue(key,raster->polygonMode);
+		writeValue(key,raster->cullMode);
+		writeValue(key,raster->frontFace);
+		writeValue(key,raster->depthBiasEnable);
+		writeValue(key,raster->depthBiasConstantFactor);
+		writeValue(key,raster->depthBiasClamp);
+		writeValue(key,raster->depthBiasSlopeFactor);
+		writeValue(key,raster->lineWidth);
+	}
+
+	if(const auto* multisample = info.pMultisampleState)
+	{
+		writeValue(key,multisample->rasterizationSamples);
+		writeValue(key,multisample->sampleShadingEnable);
+		writeValue(key,multisample->minSampleShading);
+		writeValue(key,multisample->pSampleMask != nullptr ? multisample->pSampleMask[0] : ~0u);
+		writeValue(key,multisample->alphaToCoverageEnable);
+		writeValue(key,multisample->alphaToOneEnable);
+	}
+
+	if(const auto* depthStencil = info.pDepthStencilState)
+	{
+		writeValue(key,depthStencil->flags);
+		writeValue(key,depthStencil->depthTestEnable);
+		writeValue(key,depthStencil->depthWriteEnable);
+		writeValue(key,depthStencil->depthCompareOp);
+		writeValue(key,depthStencil->depthBoundsTestEnable);
+		writeValue(key,depthStencil->stencilTestEnable);
+		for(const VkStencilOpState& op : { depthStencil->front,depthStencil->back })
+		{
+			writeValue(key,op.failOp);
+			writeValue(key,op.passOp);
+			writeValue(key,op.depthFailOp);
+			writeValue(key,op.compareOp);
+			writeValue(key,op.compareMask);
+			writeValue(key,op.writeMask);
+			writeValue(key,op.reference);
+		}
+		writeValue(key,depthStencil->minDepthBounds);
+		writeValue(key,depthStencil->maxDepthBounds);
+	}
+
+	if(const auto* colorBlend = info.pColorBlendState)
+	{
+		writeValue(key,colorBlend->logicOpEnable);
+		writeValue(key,colorBlend->logicOp);
+		writeValue(key,colorBlend->attachmentCount);
+		for(uint32 i = 0; i < colorBlend->attachmentCount; i++)
+		{
+			const VkPipelineColorBlendAttachmentState& attachment = colorBlend->pAttachments[i];
+			writeValue(key,attachment.blendEnable);
+			writeValue(key,attachment.srcColorBlendFactor);
+			writeValue(key,attachment.dstColorBlendFactor);
+			writeValue(key,attachment.colorBlendOp);
+			writeValue(key,attachment.srcAlphaBlendFactor);
+			writeValue(key,attachment.dstAlphaBlendFactor);
+			writeValue(key,attachment.alphaBlendOp);
+			writeValue(key,attachment.colorWriteMask);
+		}
+		for(float constant : colorBlend->blendConstants)
+		{
+			writeValue(key,constant);
+		}
+	}
+
+	if(const auto* dynamicState = info.pDynamicState)
+	{
+		writeValue(key,dynamicState->dynamicStateCount);
+		for(uint32 i = 0; i < dynamicState->dynamicStateCount; i++)
+		{
+			writeValue(key,dynamicState->pDynamicStates[i]);
+		}
+	}
+
+	writeValue(key,info.layout);
+	writeValue(key,info.renderPass);
+	writeValue(key,info.subpass);
+	return key;
+}
+
+// NOTE: Drivers are meant to reject foreign cache data themselves, some crash on it instead. Only
+//       data written by the same driver on the same device is handed over.
+bool VulkanPipelineRegistry::loadPipelineCache(std::vector<uint8>& data) const
+{
+	std::ifstream is(m_cachePath,std::ios::binary | std::ios::ate);
+	if(!is)
+	{
+		return false;
+	}
+
+	const std::streamsize size = is.tellg();
+	if(size < (std::streamsize)sizeof(PipelineCacheHeader))
+	{
+		LOG_WARN("Pipeline cache {0} is truncated, ignore it.",m_cachePath);
+		return false;
+	}
+
+	data.resize((size_t)size);
+	is.seekg(0,std::ios::beg);
+	if(!is.read(reinterpret_cast<char*>(data.data()),size))
+	{
+		LOG_WARN("Fail to read pipeline cache {0}.",m_cachePath);
+		return false;
+	}
+
+	PipelineCacheHeader header { };
+	memcpy(&header,data.data(),sizeof(header));
+
+	const VkPhysicalDeviceProperties& properties = m_device->physicalDeviceProperties;
+	if(header.headerSize < sizeof(header) ||
+	   header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+	   header.vendorID != properties.vendorID ||
+	   header.deviceID != properties.deviceID ||
+	   memcmp(header.pipelineCacheUUID,properties.pipelineCacheUUID,VK_UUID_SIZE) != 0)
+	{
+		LOG_INFO("Pipeline cache {0} was written by another device or driver, rebuild it.",m_cachePath);
+		return false;
+	}
+	return true;
+}
+
+void VulkanPipelineRegistry::savePipelineCache() const
+{
+	size_t size = 0;
+	vkCheck(vkGetPipelineCacheData(*m_device,m_pipelineCache,&size,nullptr));
+
+	std::vector<uint8> data(size);
+	vkCheck(vkGetPipelineCacheData(*m_device,m_pipelineCache,&size,data.data()));
+	data.resize(size);
+
+	// Write next to the cache and rename, a crash mid write keeps the old file.
+	std::error_code ec;
+	const std::filesystem::path path(m_cachePath);
+	std::filesystem::create_directories(path.parent_path(),ec);
+
+	const std::filesystem::path tmpPath = path.string() + ".tmp";
+	{
+		std::ofstream os(tmpPath,std::ios::binary | std::ios::trunc);
+		if(!os.write(reinterpret_cast<const char*>(data.data()),data.size()))
+		{
+			LOG_WARN("Fail to write pipeline cache {0}.",tmpPath.string());
+			return;
+		}
+	}
+
+	std::filesystem::rename(tmpPath,path,ec);
+	if(ec)
+	{
+		LOG_WARN("Fail to replace pipeline cache {0}: {1}.",m_cachePath,ec.message());
+		return;
+	}
+	LOG_INFO("Pipeline cache {0} saved {1} bytes.",m_cachePath,data.size());
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "vk_device.h"
+#include "vk_shader.h"
+#include <mutex>
+
+namespace engine{
+
+// NOTE: Hash-consed pipelines and pipeline layouts. Identical create infos return the same handle
+//       with one more reference, the object is handed back for destruction with the last reference.
+//       Shader modules are keyed by the hash of their code, so a reloaded but unchanged shader still
+//       hits. Every pipeline is built through one VkPipelineCache which is saved to disk on release
+//       and only loaded back when its header matches this device.
+class VulkanPipelineRegistry
+{
+public:
+	struct Stats
+	{
+		uint32 pipelineCount = 0;       // alive unique pipelines.
+		uint32 layoutCount = 0;         // alive unique pipeline layouts.
+		uint32 createdPipelines = 0;    // built since init.
+		uint32 reusedPipelines = 0;     // requests served by an alive pipeline since init.
+		size_t loadedCacheSize = 0;     // bytes of pipeline cache loaded at init.
+	};
+
+	void init(VulkanDevice* device,VulkanShaderCache* shaderCache,const std::string& cachePath);
+	void release();
+
+	VkPipelineLayout createPipelineLayout(const VkPipelineLayoutCreateInfo& info);
+	VkPipeline createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& info);
+	VkPipeline createComputePipeline(const VkComputePipelineCreateInfo& info);
+
+	// NOTE: Drop one reference. Returns true when the handle is no longer shared and the caller must
+	//       destroy it, the gpu may still use it so the rhi defers that to the end of the frame.
+	bool releasePipelineLayout(VkPipelineLayout layout);
+	bool releasePipeline(VkPipeline pipeline);
+
+	VkPipelineCache getPipelineCache() const { return m_pipelineCache; }
+	const Stats& getStats() const { return m_stats; }
+
+private:
+	template<typename Handle>
+	struct Entry
+	{
+		Handle handle = VK_NULL_HANDLE;
+		uint32 refCount = 0;
+	};
+
+	// Serialized create info, compared byte wise.
+	using Key = std::string;
+
+	Key makeKey(const VkPipelineLayoutCreateInfo& info) const;
+	Key makeKey(const VkGraphicsPipelineCreateInfo& info) const;
+	Key makeKey(const VkComputePipelineCreateInfo& info) const;
+	void writeStage(Key& key,const VkPipelineShaderStageCreateInfo& stage) const;
+
+	bool loadPipelineCache(std::vector<uint8>& data) const;
+	void savePipelineCache() const;
+
+	template<typename Handle,typename Create>
+	Handle acquire(std::unordered_map<Key,Entry<Handle>>& entries,std::unordered_map<Handle,Key>& keys,Key&& key,Create&& create);
+
+	template<typename Handle>
+	bool releaseHandle(std::unordered_map<Key,Entry<Handle>>& entries,std::unordered_map<Handle,Key>& keys,Handle handle);
+
+	VulkanDevice* m_device = nullptr;
+	VulkanShaderCache* m_shaderCache = nullptr;
+	std::string m_cachePath = {};
+	VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+
+	std::mutex m_mutex;
+	std::unordered_map<Key,Entry<VkPipeline>> m_pipelines = {};
+	std::unordered_map<VkPipeline,Key> m_pipelineKeys = {};
+	std::unordered_map<Key,Entry<VkPipelineLayout>> m_layouts = {};
+	std::unordered_map<VkPipelineLayout,Key> m_layoutKeys = {};
+
+	Stats m_stats = {};
+};
+
+}
@@ -19,6 +19,7 @@ private:
     struct State
     {
         std::vector<uint32_t> opcodes = {};
+        uint64 codeHash = 0;
         VkShaderModule shaderModule = VK_NULL_HANDLE;
         bool ok = false;
     };
@@ -60,6 +61,13 @@ public:
         file.seekg(0,std::ios::beg);
         file.read((char*)res->s.opcodes.data(),res->s.opcodes.size()*4);
 
+        // FNV-1a over the code, pipelines are keyed by it instead of the module handle.
+        res->s.codeHash = 14695981039346656037ull;
+        for(uint32_t word : res->s.opcodes)
+        {
+            res->s.codeHash = (res->s.codeHash ^ word) * 1099511628211ull;
+        }
+
         VkShaderModuleCreateInfo ci{};
         ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         ci.codeSize = res->s.opcodes.size() * 4;
@@ -84,6 +92,11 @@ public:
     {
         return s.shaderModule;
     }
+
+    uint64 GetCodeHash() const
+    {
+        return s.codeHash;
+    }
 };
 
 class VulkanShaderCache
@@ -107,6 +120,19 @@ public:
         return m_moduleCache[path];
     }
 
+    // NOTE: Returns 0 for modules which don't come from this cache.
+    uint64 findCodeHash(VkShaderModule module) const
+    {
+        for(const auto& shader : m_moduleCache)
+        {
+            if(shader.second->GetModule() == module)
+            {
+                return shader.second->GetCodeHash();
+            }
+        }
+        return 0;
+    }
+
     void release()
     {
         for (auto shaders : m_moduleCache)
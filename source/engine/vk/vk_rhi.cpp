@@ -1,5 +1,6 @@
 #include "vk_rhi.h"
 #include "../core/timer.h"
+#include "../core/file_system.h"
 
 namespace engine{
 
@@ -7,6 +8,22 @@ constexpr auto MAX_TEXTURE_LOD = 24;
 
 VulkanRHI* VulkanRHI::s_RHI = new VulkanRHI();
 
+static AutoCVarInt32 cVarFramesInFlight(
+    "r.RHI.FramesInFlight",
+    "Frames the cpu may record ahead of the gpu, clamped to [1,3]. Fewer frames means less latency but less overlap.",
+    "RHI",
+    2,
+    CVarFlags::ReadOnly | CVarFlags::InitOnce
+);
+
+static AutoCVarInt32 cVarPushDescriptors(
+    "r.RHI.PushDescriptors",
+    "Enable VK_KHR_push_descriptor when the gpu has it, small compute passes push their bindings instead of allocating sets.",
+    "RHI",
+    1,
+    CVarFlags::ReadOnly | CVarFlags::InitOnce
+);
+
 void VulkanRHI::init(GLFWwindow* window,
     std::vector<const char*> instanceLayerNames,
     std::vector<const char*> instanceExtensionNames,
@@ -43,9 +60,12 @@ void VulkanRHI::init(GLFWwindow* window,
     m_enable12GpuFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
     m_enable12GpuFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
     m_enable12GpuFeatures.timelineSemaphore = VK_TRUE;
+    m_enable12GpuFeatures.hostQueryReset = VK_TRUE; // Gpu profiler resets its queries after readback.
     m_enable12GpuFeatures.pNext = nullptr;
 
     m_window = window;
+    m_maxFramesInFlight = (uint32)glm::clamp(cVarFramesInFlight.get(),1,3);
+    m_frameInputTimes.resize(m_maxFramesInFlight);
     m_instance.init(m_instanceExtensionNames,m_instanceLayerNames);
     m_deletionQueue.push([&]()
     {
@@ -65,7 +85,14 @@ void VulkanRHI::init(GLFWwindow* window,
     });
 
     m_deviceExtensionNames.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
-    m_device.init(m_instance,m_surface,m_enableGpuFeatures,m_deviceExtensionNames, &m_enable12GpuFeatures);
+    std::vector<const char*> optionalDeviceExtensionNames = {};
+    if(cVarPushDescriptors.get() != 0)
+    {
+        optionalDeviceExtensionNames.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+    }
+    VkPhysicalDeviceFeatures optionalGpuFeatures = {};
+    optionalGpuFeatures.pipelineStatisticsQuery = VK_TRUE; // Gpu profiler pass statistics, skipped where unsupported.
+    m_device.init(m_instance,m_surface,m_enableGpuFeatures,m_deviceExtensionNames, &m_enable12GpuFeatures,optionalDeviceExtensionNames,optionalGpuFeatures);
     vkGetPhysicalDeviceProperties(m_device.physicalDevice, &m_physicalDeviceProperties);
     LOG_GRAPHICS_INFO("Gpu min align memory size{0}.",m_physicalDeviceProperties.limits.minUniformBufferOffsetAlignment);
 
@@ -93,13 +120,21 @@ void VulkanRHI::init(GLFWwindow* window,
     m_shaderCache.init(m_device.device);
     m_descriptorLayoutCache.init(&m_device);
     m_staticDescriptorAllocator.init(&m_device);
+    m_frameDescriptorAllocator.init(&m_device,m_maxFramesInFlight);
+    m_descriptorSetCache.init(&m_device);
     m_fencePool.init(m_device.device);
+    m_pipelineRegistry.init(&m_device,&m_shaderCache,s_enginePipelineCache);
 
     createVmaAllocator();
+    m_frameDeletionQueues.resize(m_maxFramesInFlight);
     m_deletionQueue.push([&]()
     {
+        flushFrameDeletions();
+        m_pipelineRegistry.release();
         releaseVmaAllocator();
         m_staticDescriptorAllocator.cleanup();
+        m_frameDescriptorAllocator.cleanup();
+        m_descriptorSetCache.cleanup();
         m_descriptorLayoutCache.cleanup();
         m_shaderCache.release(); 
         m_samplerCache.cleanup();
@@ -167,6 +202,9 @@ uint32 VulkanRHI::acquireNextPresentImage()
     m_swapchainChange |= swapchainRebuild();
 
     vkWaitForFences(m_device,1,&m_inFlightFences[m_currentFrame],VK_TRUE,UINT64_MAX);
+    m_frameDeletionQueues[m_currentFrame].flush();
+    m_frameDescriptorAllocator.beginFrame(m_currentFrame);
+
     VkResult result = vkAcquireNextImageKHR(
         m_device,m_swapchain,UINT64_MAX,
         m_semaphoresImageAvailable[m_currentFrame],
@@ -217,9 +255,40 @@ void VulkanRHI::present()
         LOG_GRAPHICS_FATAL("Fail to present image.");
     }
 
+    // Input to present of this frame, the present call returns once the image is queued.
+    const auto presentTime = std::chrono::steady_clock::now();
+    if(m_frameInputTimes[m_currentFrame] != std::chrono::steady_clock::time_point{})
+    {
+        m_inputToPresentMs = std::chrono::duration<float,std::milli>(presentTime - m_frameInputTimes[m_currentFrame]).count();
+        m_smoothInputToPresentMs = m_smoothInputToPresentMs * 0.9f + m_inputToPresentMs * 0.1f;
+    }
+
     m_currentFrame = (m_currentFrame +1) % m_maxFramesInFlight;
 }
 
+void VulkanRHI::clearDescriptorSetCache()
+{
+    auto pools = m_descriptorSetCache.clear();
+    if(!pools.empty())
+    {
+        pushFrameDeletion([this,pools]()
+        {
+            m_descriptorSetCache.recyclePools(pools);
+        });
+    }
+}
+
+void VulkanRHI::waitForPreviousFrame()
+{
+    const uint32 previousFrame = (m_currentFrame + m_maxFramesInFlight - 1) % m_maxFramesInFlight;
+    vkWaitForFences(m_device,1,&m_inFlightFences[previousFrame],VK_TRUE,UINT64_MAX);
+}
+
+void VulkanRHI::markInputSampled()
+{
+    m_frameInputTimes[m_currentFrame] = std::chrono::steady_clock::now();
+}
+
 void VulkanRHI::submit(VkSubmitInfo& info)
 {
     vkCheck(vkQueueSubmit(getGraphicsQueue(),1,&info,m_inFlightFences[m_currentFrame]));
@@ -303,9 +372,17 @@ VkRenderPass VulkanRHI::createRenderpass(const VkRenderPassCreateInfo& info)
 
 VkPipelineLayout VulkanRHI::createPipelineLayout(const VkPipelineLayoutCreateInfo& info)
 {
-    VkPipelineLayout layout;
-    vkCheck(vkCreatePipelineLayout(m_device,&info,nullptr,&layout));
-    return layout;
+    return m_pipelineRegistry.createPipelineLayout(info);
+}
+
+VkPipeline VulkanRHI::createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& info)
+{
+    return m_pipelineRegistry.createGraphicsPipeline(info);
+}
+
+VkPipeline VulkanRHI::createComputePipeline(const VkComputePipelineCreateInfo& info)
+{
+    return m_pipelineRegistry.createComputePipeline(info);
 }
 
 void VulkanRHI::destroyRenderpass(VkRenderPass pass)
@@ -315,17 +392,48 @@ void VulkanRHI::destroyRenderpass(VkRenderPass pass)
 
 void VulkanRHI::destroyFramebuffer(VkFramebuffer fb)
 {
-    vkDestroyFramebuffer(m_device,fb,nullptr);
+    if(fb == VK_NULL_HANDLE) return;
+    pushFrameDeletion([this,fb]()
+    {
+        vkDestroyFramebuffer(m_device,fb,nullptr);
+    });
 }
 
 void VulkanRHI::destroyPipeline(VkPipeline pipe)
 {
-    vkDestroyPipeline(m_device,pipe,nullptr);
+    if(m_pipelineRegistry.releasePipeline(pipe))
+    {
+        pushFrameDeletion([this,pipe]()
+        {
+            vkDestroyPipeline(m_device,pipe,nullptr);
+        });
+    }
 }
 
 void VulkanRHI::destroyPipelineLayout(VkPipelineLayout layout)
 {
-    vkDestroyPipelineLayout(m_device,layout,nullptr);
+    if(m_pipelineRegistry.releasePipelineLayout(layout))
+    {
+        pushFrameDeletion([this,layout]()
+        {
+            vkDestroyPipelineLayout(m_device,layout,nullptr);
+        });
+    }
+}
+
+void VulkanRHI::pushFrameDeletion(std::function<void()>&& func)
+{
+    // NOTE: The current frame signals m_inFlightFences[m_currentFrame] when it finishes, the queue
+    //       is flushed right after the next wait on that fence.
+    m_frameDeletionQueues[m_currentFrame].push(std::move(func));
+}
+
+void VulkanRHI::flushFrameDeletions()
+{
+    for(auto& queue : m_frameDeletionQueues)
+    {
+        queue.flush();
+    }
 }
 
 size_t VulkanRHI::packUniformBufferOffsetAlignment(size_t originalSize) const
@@ -527,7 +635,8 @@ void VulkanRHI::createCommandPool()
 
 void VulkanRHI::createSyncObjects()
 {
-    const auto imageNums = m_swapchain.getImageViews().size();
+    // NOTE: Indexed by frame in flight, the swapchain may have fewer images than that.
+    const auto imageNums = glm::max(m_swapchain.getImageViews().size(),(size_t)m_maxFramesInFlight);
     m_semaphoresImageAvailable.resize(imageNums);
     m_semaphoresRenderFinished.resize(imageNums);
     m_staticGraphicsCommandExecuteSemaphores.resize(imageNums);
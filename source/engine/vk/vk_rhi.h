@@ -11,7 +11,9 @@
 #include "impl/vk_shader.h"
 #include "impl/vk_swapchain.h"
 #include "impl/vk_fence.h"
+#include "impl/vk_pipeline.h"
 #include "../core/deletion_queue.h"
+#include <chrono>
 
 namespace engine{
 
@@ -60,19 +62,36 @@ private: // cache
     VulkanSamplerCache m_samplerCache = {};
     VulkanShaderCache m_shaderCache = {};
     VulkanFencePool m_fencePool = {};
+    VulkanPipelineRegistry m_pipelineRegistry = {};
 
     // ־Ե
     VulkanDescriptorAllocator m_staticDescriptorAllocator = {};
     VulkanDescriptorLayoutCache m_descriptorLayoutCache = {};
 
+    // Sets of the frame recording now, reset with its fence.
+    VulkanFrameDescriptorAllocator m_frameDescriptorAllocator = {};
+
+    // Write once sets shared by content, cleared when scene textures are recreated.
+    VulkanDescriptorSetCache m_descriptorSetCache = {};
+
 private:
     uint32 m_imageIndex;
     uint32 m_currentFrame = 0;
-    const int m_maxFramesInFlight = 2;
+
+    // r.RHI.FramesInFlight, latched at init.
+    uint32 m_maxFramesInFlight = 2;
     std::vector<VkSemaphore> m_semaphoresImageAvailable;
     std::vector<VkSemaphore> m_semaphoresRenderFinished;
     std::vector<VkFence> m_inFlightFences;
     std::vector<VkFence> m_imagesInFlight;
+
+    // NOTE: One queue per frame in flight, flushed once that frame's fence is signaled again.
+    std::vector<DeletionQueue> m_frameDeletionQueues;
+
+    // Input sample time of every frame in flight and the latency of the last presented frame.
+    std::vector<std::chrono::steady_clock::time_point> m_frameInputTimes;
+    float m_inputToPresentMs = 0.0f;
+    float m_smoothInputToPresentMs = 0.0f;
     VkPhysicalDeviceDescriptorIndexingFeaturesEXT m_physicalDeviceDescriptorIndexingFeatures{};
     VkPhysicalDeviceDescriptorIndexingPropertiesEXT m_descriptorIndexingProperties{};
 
@@ -146,11 +165,45 @@ public:
     VulkanCommandBuffer* createCopyCommandBuffer(VkCommandBufferLevel level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_PRIMARY);
     VkRenderPass createRenderpass(const VkRenderPassCreateInfo& info);
     VkPipelineLayout createPipelineLayout(const VkPipelineLayoutCreateInfo& info);
+    VkPipeline createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& info);
+    VkPipeline createComputePipeline(const VkComputePipelineCreateInfo& info);
+    VulkanPipelineRegistry& getPipelineRegistry() { return m_pipelineRegistry; }
     VulkanDescriptorFactory vkDescriptorFactoryBegin() { return VulkanDescriptorFactory::begin(&m_descriptorLayoutCache,&m_staticDescriptorAllocator); }
+
+    // NOTE: Sets built here are only valid for the frame recording now, build them while recording.
+    VulkanDescriptorFactory vkFrameDescriptorFactoryBegin() { return VulkanDescriptorFactory::begin(&m_descriptorLayoutCache,&m_frameDescriptorAllocator); }
+
+    // NOTE: Sets built here are shared with every other build of the same layout and resources, never update them.
+    VulkanDescriptorFactory vkCachedDescriptorFactoryBegin() { return VulkanDescriptorFactory::begin(&m_descriptorLayoutCache,&m_descriptorSetCache); }
+
+    // NOTE: Drops every cached set, their pools are reset once the frames in flight finished.
+    void clearDescriptorSetCache();
+
+    // r.RHI.PushDescriptors and the device supports VK_KHR_push_descriptor.
+    bool isPushDescriptorEnabled() const { return m_device.vkCmdPushDescriptorSet != nullptr; }
+
+    VulkanDescriptorAllocator::Stats getStaticDescriptorStats() const { return m_staticDescriptorAllocator.getStats(); }
+    VulkanDescriptorAllocator::Stats getFrameDescriptorStats() const { return m_frameDescriptorAllocator.getStats(); }
+    VulkanDescriptorSetCache::Stats getDescriptorSetCacheStats() const { return m_descriptorSetCache.getStats(); }
     void destroyRenderpass(VkRenderPass pass);
     void destroyFramebuffer(VkFramebuffer fb);
     void destroyPipeline(VkPipeline pipe);
     void destroyPipelineLayout(VkPipelineLayout layout);
+
+    // NOTE: Runs func once the gpu finished every frame submitted so far, objects the frames
+    //       in flight may still use are released this way instead of waiting for idle.
+    void pushFrameDeletion(std::function<void()>&& func);
+    void flushFrameDeletions();
+    uint32 getMaxFramesInFlight() const { return m_maxFramesInFlight; }
+
+    // NOTE: Low latency mode, blocks until the gpu finished the frame presented last so the next
+    //       frame samples its input as late as possible instead of queueing up behind the gpu.
+    void waitForPreviousFrame();
+
+    // NOTE: Call right after the input of the next frame was sampled, present measures from here.
+    void markInputSampled();
+    float getInputToPresentMs() const { return m_inputToPresentMs; }
+    float getSmoothInputToPresentMs() const { return m_smoothInputToPresentMs; }
     VkPhysicalDeviceProperties getPhysicalDeviceProperties() const { return m_physicalDeviceProperties; }
     size_t packUniformBufferOffsetAlignment(size_t originalSize) const;
     template <typename T> size_t getUniformBufferPadSize() const{ return PackUniformBufferOffsetAlignment(sizeof(T)); }